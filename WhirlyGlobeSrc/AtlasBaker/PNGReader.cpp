@@ -0,0 +1,177 @@
+/*
+ *  PNGReader.cpp
+ *  AtlasBaker
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <zlib.h>
+#include "PNGReader.h"
+
+static unsigned int GetBE32(const unsigned char *data)
+{
+    return ((unsigned int)data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+}
+
+// Paeth predictor from the PNG spec
+static unsigned char Paeth(int a,int b,int c)
+{
+    int p = a + b - c;
+    int pa = abs(p-a), pb = abs(p-b), pc = abs(p-c);
+    if (pa <= pb && pa <= pc)
+        return a;
+    if (pb <= pc)
+        return b;
+    return c;
+}
+
+bool ReadPNG(const std::string &fileName,int &width,int &height,std::vector<unsigned char> &pixels,std::string &err)
+{
+    FILE *fp = fopen(fileName.c_str(),"rb");
+    if (!fp)
+    {
+        err = "can't open file";
+        return false;
+    }
+    std::vector<unsigned char> file;
+    unsigned char buf[65536];
+    size_t got;
+    while ((got = fread(buf,1,sizeof(buf),fp)) > 0)
+        file.insert(file.end(),buf,buf+got);
+    fclose(fp);
+    
+    static const unsigned char sig[8] = {137,80,78,71,13,10,26,10};
+    if (file.size() < 8 || memcmp(&file[0],sig,8))
+    {
+        err = "not a PNG";
+        return false;
+    }
+    
+    // Run through the chunks
+    int bitDepth = 0, colorType = 0, interlace = 0;
+    std::vector<unsigned char> idat,palette,trans;
+    width = height = 0;
+    for (size_t pos = 8; pos + 12 <= file.size();)
+    {
+        unsigned int len = GetBE32(&file[pos]);
+        if (pos + 12 + len > file.size())
+            break;
+        const unsigned char *type = &file[pos+4];
+        const unsigned char *data = &file[pos+8];
+        if (!memcmp(type,"IHDR",4) && len >= 13)
+        {
+            width = GetBE32(data);
+            height = GetBE32(data+4);
+            bitDepth = data[8];
+            colorType = data[9];
+            interlace = data[12];
+        } else if (!memcmp(type,"PLTE",4))
+            palette.assign(data,data+len);
+        else if (!memcmp(type,"tRNS",4))
+            trans.assign(data,data+len);
+        else if (!memcmp(type,"IDAT",4))
+            idat.insert(idat.end(),data,data+len);
+        else if (!memcmp(type,"IEND",4))
+            break;
+        pos += 12 + len;
+    }
+    
+    int channels = 0;
+    switch (colorType)
+    {
+        case 0: channels = 1; break;
+        case 2: channels = 3; break;
+        case 3: channels = 1; break;
+        case 4: channels = 2; break;
+        case 6: channels = 4; break;
+    }
+    if (width <= 0 || height <= 0 || channels == 0 || bitDepth != 8 || interlace != 0 || (colorType == 3 && palette.empty()))
+    {
+        err = "unsupported PNG (needs 8 bit, non-interlaced)";
+        return false;
+    }
+    
+    // Inflate all the image data
+    size_t stride = (size_t)width*channels;
+    std::vector<unsigned char> raw((stride+1)*height);
+    uLongf rawLen = raw.size();
+    if (idat.empty() || uncompress(&raw[0],&rawLen,&idat[0],idat.size()) != Z_OK || rawLen != raw.size())
+    {
+        err = "corrupt image data";
+        return false;
+    }
+    
+    // Undo the filters in place
+    std::vector<unsigned char> prevRow(stride,0);
+    for (int iy=0;iy<height;iy++)
+    {
+        unsigned char filter = raw[iy*(stride+1)];
+        unsigned char *row = &raw[iy*(stride+1)+1];
+        for (size_t ix=0;ix<stride;ix++)
+        {
+            int a = (ix >= (size_t)channels) ? row[ix-channels] : 0;
+            int b = prevRow[ix];
+            int c = (ix >= (size_t)channels) ? prevRow[ix-channels] : 0;
+            switch (filter)
+            {
+                case 0: break;
+                case 1: row[ix] += a; break;
+                case 2: row[ix] += b; break;
+                case 3: row[ix] += (a+b)/2; break;
+                case 4: row[ix] += Paeth(a,b,c); break;
+                default:
+                    err = "bad filter";
+                    return false;
+            }
+        }
+        memcpy(&prevRow[0],row,stride);
+    }
+    
+    // And expand to RGBA
+    pixels.resize((size_t)width*height*4);
+    for (int iy=0;iy<height;iy++)
+    {
+        const unsigned char *row = &raw[iy*(stride+1)+1];
+        unsigned char *out = &pixels[(size_t)iy*width*4];
+        for (int ix=0;ix<width;ix++,out+=4)
+        {
+            const unsigned char *in = row + ix*channels;
+            switch (colorType)
+            {
+                case 0: out[0] = out[1] = out[2] = in[0]; out[3] = 255; break;
+                case 2: out[0] = in[0]; out[1] = in[1]; out[2] = in[2]; out[3] = 255; break;
+                case 4: out[0] = out[1] = out[2] = in[0]; out[3] = in[1]; break;
+                case 6: memcpy(out,in,4); break;
+                case 3:
+                {
+                    unsigned int idx = in[0];
+                    if (idx*3+2 < palette.size())
+                    {
+                        out[0] = palette[idx*3];  out[1] = palette[idx*3+1];  out[2] = palette[idx*3+2];
+                    } else
+                        out[0] = out[1] = out[2] = 0;
+                    out[3] = (idx < trans.size()) ? trans[idx] : 255;
+                }
+                    break;
+            }
+        }
+    }
+    
+    return true;
+}
@@ -0,0 +1,27 @@
+/*
+ *  PNGReader.h
+ *  AtlasBaker
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#include <string>
+#include <vector>
+
+/// Read a PNG file into 8 bit RGBA, top row first.
+/// Handles non-interlaced 8 bit gray, gray+alpha, RGB, RGBA and palette images.
+/// Returns false, with a reason, if it can't.
+bool ReadPNG(const std::string &fileName,int &width,int &height,std::vector<unsigned char> &pixels,std::string &err);
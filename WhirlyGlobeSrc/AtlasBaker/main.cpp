@@ -0,0 +1,106 @@
+/*
+ *  main.cpp
+ *  AtlasBaker
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+/*  The atlas baker packs a pile of PNGs into texture atlas pages ahead of time
+    and writes them out in the format BakedTextureAtlas loads.  It's plain C++
+    and only needs zlib.  To build it:
+ 
+        c++ -O2 -I../WhirlyGlobeLib/include -x c++ ../WhirlyGlobeLib/src/RectPacker.mm \
+            -x c++ ../WhirlyGlobeLib/src/BakedAtlas.mm -x c++ PNGReader.cpp main.cpp -lz -o atlasbaker
+ 
+    Images are named by their file name, minus the directory and extension.
+  */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "BakedAtlas.h"
+#include "PNGReader.h"
+
+using namespace WhirlyKit;
+
+static void Usage(const char *prog)
+{
+    fprintf(stderr,"usage: %s [-size texSize] [-cell cellSize] -o out.wkat image.png ...\n",prog);
+    exit(1);
+}
+
+static std::string ImageName(const std::string &fileName)
+{
+    std::string name = fileName;
+    size_t slash = name.find_last_of("/\\");
+    if (slash != std::string::npos)
+        name = name.substr(slash+1);
+    size_t dot = name.find_last_of('.');
+    if (dot != std::string::npos)
+        name = name.substr(0,dot);
+    return name;
+}
+
+int main(int argc,char *argv[])
+{
+    int texSize = 2048, cellSize = 8;
+    const char *outFile = NULL;
+    std::vector<std::string> inFiles;
+    for (int ii=1;ii<argc;ii++)
+    {
+        if (!strcmp(argv[ii],"-size") && ii+1 < argc)
+            texSize = atoi(argv[++ii]);
+        else if (!strcmp(argv[ii],"-cell") && ii+1 < argc)
+            cellSize = atoi(argv[++ii]);
+        else if (!strcmp(argv[ii],"-o") && ii+1 < argc)
+            outFile = argv[++ii];
+        else if (argv[ii][0] == '-')
+            Usage(argv[0]);
+        else
+            inFiles.push_back(argv[ii]);
+    }
+    if (!outFile || inFiles.empty() || texSize <= 0 || (texSize & (texSize-1)) || cellSize <= 0)
+        Usage(argv[0]);
+    
+    std::vector<BakedAtlasImage> images(inFiles.size());
+    for (unsigned int ii=0;ii<inFiles.size();ii++)
+    {
+        BakedAtlasImage &image = images[ii];
+        std::string err;
+        if (!ReadPNG(inFiles[ii],image.width,image.height,image.pixels,err))
+        {
+            fprintf(stderr,"%s: %s\n",inFiles[ii].c_str(),err.c_str());
+            return 1;
+        }
+        image.name = ImageName(inFiles[ii]);
+    }
+    
+    BakedAtlas atlas;
+    if (!atlas.bake(images,texSize,cellSize))
+    {
+        fprintf(stderr,"Failed to pack the images.  Is one of them bigger than %d?\n",texSize);
+        return 1;
+    }
+    if (!atlas.write(outFile))
+    {
+        fprintf(stderr,"Failed to write %s\n",outFile);
+        return 1;
+    }
+    
+    printf("Packed %d images into %d %dx%d pages\n",(int)images.size(),(int)atlas.pages.size(),texSize,texSize);
+    
+    return 0;
+}
@@ -0,0 +1,154 @@
+/*
+ *  BakedAtlasTest.cpp
+ *  HeadlessTests
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+/*  Bakes a few images, writes the atlas out and parses it back, checking
+    the texels land where the table says.  Then feeds parse() damaged
+    headers and entries, which it should turn down rather than trust.
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "BakedAtlas.h"
+#include "TestUtils.h"
+
+using namespace WhirlyKit;
+
+static const int TexSize = 256;
+
+static void PutU32(std::vector<unsigned char> &data,size_t offset,unsigned int val)
+{
+    for (unsigned int ii=0;ii<4;ii++)
+        data[offset+ii] = (val >> (8*ii)) & 0xff;
+}
+
+static void PutU16(std::vector<unsigned char> &data,size_t offset,unsigned int val)
+{
+    data[offset] = val & 0xff;
+    data[offset+1] = (val >> 8) & 0xff;
+}
+
+static bool ReadFile(const char *fileName,std::vector<unsigned char> &data)
+{
+    FILE *fp = fopen(fileName,"rb");
+    if (!fp)
+        return false;
+    fseek(fp,0,SEEK_END);
+    data.resize(ftell(fp));
+    fseek(fp,0,SEEK_SET);
+    bool ok = fread(&data[0],1,data.size(),fp) == data.size();
+    fclose(fp);
+    return ok;
+}
+
+// Parse a copy of the data, after a change to the header or first entry
+static bool ParseWith(const std::vector<unsigned char> &good,size_t offset,unsigned int val,bool shortVal)
+{
+    std::vector<unsigned char> data = good;
+    if (shortVal)
+        PutU16(data,offset,val);
+    else
+        PutU32(data,offset,val);
+    BakedAtlas atlas;
+    return atlas.parse(&data[0],data.size());
+}
+
+int main(int argc,char *argv[])
+{
+    // Images filled with their index, so we can find them again
+    std::vector<BakedAtlasImage> images;
+    srand(1);
+    for (int ii=0;ii<40;ii++)
+    {
+        BakedAtlasImage image;
+        char name[32];
+        sprintf(name,"image%d",ii);
+        image.name = name;
+        image.width = 8 + rand() % 60;
+        image.height = 8 + rand() % 60;
+        image.pixels.resize(image.width*image.height*4,ii+1);
+        images.push_back(image);
+    }
+    BakedAtlas baked;
+    TEST_CHECK(baked.bake(images,TexSize));
+    TEST_CHECK(baked.pages.size() > 1);
+
+    const char *fileName = "build/BakedAtlasTest.atlas";
+    TEST_CHECK(baked.write(fileName));
+    std::vector<unsigned char> data;
+    TEST_CHECK(ReadFile(fileName,data));
+    remove(fileName);
+    if (data.size() < 64)
+        return TestResult("BakedAtlasTest");
+
+    // Parse it back and look at the texels in place
+    BakedAtlas atlas;
+    TEST_CHECK(atlas.parse(&data[0],data.size()));
+    TEST_CHECK(atlas.texSize == TexSize);
+    TEST_CHECK(atlas.entries.size() == images.size());
+    TEST_CHECK(atlas.pageOffsets.size() == baked.pages.size());
+    for (unsigned int ii=0;ii<atlas.entries.size();ii++)
+    {
+        const BakedAtlasEntry &entry = atlas.entries[ii];
+        TEST_CHECK(entry.name == images[ii].name);
+        TEST_CHECK(entry.width == images[ii].width && entry.height == images[ii].height);
+        const unsigned char *page = &data[atlas.pageOffsets[entry.page]];
+        bool match = true;
+        for (int iy=0;iy<entry.height;iy++)
+            for (int ix=0;ix<entry.width*4;ix++)
+                if (page[((entry.y+iy)*TexSize + entry.x)*4 + ix] != ii+1)
+                    match = false;
+        TEST_CHECK(match);
+    }
+
+    // Header: texSize, numPages, numEntries, namesSize, pagesStart
+    TEST_CHECK(!ParseWith(data,8,0,false));
+    TEST_CHECK(!ParseWith(data,8,16384,false));
+    TEST_CHECK(!ParseWith(data,8,0xffffffff,false));
+    TEST_CHECK(!ParseWith(data,12,atlas.pageOffsets.size()+1,false));
+    TEST_CHECK(!ParseWith(data,12,0xffffffff,false));
+    TEST_CHECK(!ParseWith(data,16,0xffffffff,false));
+    TEST_CHECK(!ParseWith(data,16,0x10000000,false));
+    TEST_CHECK(!ParseWith(data,20,0xffffffff,false));
+    TEST_CHECK(!ParseWith(data,24,0,false));
+    TEST_CHECK(!ParseWith(data,24,0xffffffff,false));
+
+    // First entry: name offset, page, x, y, width, height
+    TEST_CHECK(!ParseWith(data,32,0xffffffff,false));
+    TEST_CHECK(!ParseWith(data,36,atlas.pageOffsets.size(),true));
+    TEST_CHECK(!ParseWith(data,38,TexSize-atlas.entries[0].width+1,true));
+    TEST_CHECK(!ParseWith(data,40,TexSize-atlas.entries[0].height+1,true));
+    TEST_CHECK(!ParseWith(data,42,0,true));
+    TEST_CHECK(!ParseWith(data,42,0xffff,true));
+    TEST_CHECK(!ParseWith(data,44,0xffff,true));
+    // Right up against the edge is fine
+    TEST_CHECK(ParseWith(data,38,TexSize-atlas.entries[0].width,true));
+
+    // Truncated anywhere
+    for (size_t len=0;len<data.size();len+=data.size()/7)
+    {
+        BakedAtlas truncAtlas;
+        TEST_CHECK(!truncAtlas.parse(&data[0],len));
+        TEST_CHECK(truncAtlas.entries.empty());
+    }
+
+    return TestResult("BakedAtlasTest");
+}
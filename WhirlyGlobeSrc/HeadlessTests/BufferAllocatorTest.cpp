@@ -0,0 +1,160 @@
+/*
+ *  BufferAllocatorTest.cpp
+ *  HeadlessTests
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+/*  Drives the slab allocator with a fake backend that just hands out
+    numbers.  Random allocations and frees, mostly drawable sized with
+    some near the limit, then checks that nothing overlaps, everything
+    stays aligned and in bounds, and that the slabs go back to the
+    backend when they empty out.
+  */
+
+#include <stdlib.h>
+#include <algorithm>
+#include <map>
+#include <vector>
+#include "BufferAllocator.h"
+#include "TestUtils.h"
+
+using namespace WhirlyKit;
+
+static const unsigned int SlabSize = 1024*1024;
+static const unsigned int MaxAlloc = 64*1024;
+
+// Hands out buffer numbers and keeps count
+class FakeSlabBackend : public BufferSlabBackend
+{
+public:
+    FakeSlabBackend() : nextId(1), numLive(0), numCreated(0) { }
+
+    unsigned int createBuffer(unsigned int size)
+    {
+        TEST_CHECK(size == SlabSize);
+        numLive++;
+        numCreated++;
+        return nextId++;
+    }
+
+    void deleteBuffer(unsigned int bufID)
+    {
+        TEST_CHECK(bufID > 0 && bufID < nextId);
+        numLive--;
+    }
+
+    unsigned int nextId;
+    int numLive,numCreated;
+};
+
+// Make sure none of the allocations overlap and they all fit in their slabs
+static bool CheckAllocations(const std::vector<BufferAllocation> &allocs)
+{
+    std::map<unsigned int,std::vector<std::pair<unsigned int,unsigned int> > > bySlab;
+    for (unsigned int ii=0;ii<allocs.size();ii++)
+    {
+        const BufferAllocation &alloc = allocs[ii];
+        if (alloc.offset % BufferSlabAllocator::Granule != 0 || alloc.offset + alloc.size > SlabSize)
+            return false;
+        bySlab[alloc.bufferId].push_back(std::make_pair(alloc.offset,alloc.size));
+    }
+    for (std::map<unsigned int,std::vector<std::pair<unsigned int,unsigned int> > >::iterator it = bySlab.begin();
+         it != bySlab.end(); ++it)
+    {
+        std::vector<std::pair<unsigned int,unsigned int> > &blocks = it->second;
+        std::sort(blocks.begin(),blocks.end());
+        for (unsigned int ii=1;ii<blocks.size();ii++)
+            if (blocks[ii-1].first + blocks[ii-1].second > blocks[ii].first)
+                return false;
+    }
+
+    return true;
+}
+
+static void PrintStats(const char *label,BufferSlabAllocator &allocator)
+{
+    BufferSlabStats stats;
+    allocator.getStats(stats);
+    printf("  %s: %u slabs, %u allocs, %u KB used, %u KB free in %u blocks, fragmentation %.3f\n",
+           label,stats.numSlabs,stats.numAllocs,stats.usedBytes/1024,stats.freeBytes/1024,stats.numFreeBlocks,stats.fragmentation());
+}
+
+int main(int argc,char *argv[])
+{
+    FakeSlabBackend backend;
+    std::vector<BufferAllocation> live;
+    {
+        BufferSlabAllocator allocator(&backend,SlabSize,MaxAlloc);
+        srand(3);
+
+        // Simple cases first
+        BufferAllocation alloc;
+        TEST_CHECK(!allocator.allocate(0,alloc));
+        TEST_CHECK(!allocator.allocate(MaxAlloc+1,alloc));
+        TEST_CHECK(allocator.allocate(1,alloc));
+        TEST_CHECK(alloc.size == BufferSlabAllocator::Granule && alloc.offset == 0);
+        TEST_CHECK(allocator.isSlabBuffer(alloc.bufferId));
+        allocator.free(alloc);
+
+        // Churn, a bit heavier on allocations so things build up
+        const int NumOps = 200000;
+        double startTime = TestTime();
+        for (int ii=0;ii<NumOps;ii++)
+        {
+            if (live.empty() || rand() % 100 < 55)
+            {
+                unsigned int size = 1 + rand() % ((rand() % 4 == 0) ? (MaxAlloc-1000) : 4000);
+                if (!allocator.allocate(size,alloc))
+                {
+                    TEST_CHECK(false);
+                    break;
+                }
+                TEST_CHECK(alloc.size >= size);
+                live.push_back(alloc);
+            } else {
+                int which = rand() % live.size();
+                allocator.free(live[which]);
+                live[which] = live.back();
+                live.pop_back();
+            }
+            if (ii == NumOps/2)
+                PrintStats("halfway",allocator);
+        }
+        double churnTime = TestTime() - startTime;
+        PrintStats("end",allocator);
+        printf("  %d operations in %.2f ms, %d slabs created\n",NumOps,churnTime*1000,backend.numCreated);
+        TEST_CHECK(CheckAllocations(live));
+
+        BufferSlabStats stats;
+        allocator.getStats(stats);
+        TEST_CHECK(stats.numAllocs == live.size());
+        TEST_CHECK(stats.usedBytes + stats.freeBytes == stats.totalBytes);
+        TEST_CHECK(stats.numSlabs == (unsigned int)backend.numLive);
+
+        // Free everything and we should be down to the one slab we keep
+        for (unsigned int ii=0;ii<live.size();ii++)
+            allocator.free(live[ii]);
+        allocator.getStats(stats);
+        TEST_CHECK(stats.numAllocs == 0 && stats.usedBytes == 0);
+        TEST_CHECK(stats.numSlabs == 1 && stats.numFreeBlocks == 1);
+        TEST_CHECK(backend.numLive == 1);
+    }
+    // And the destructor gives that one back
+    TEST_CHECK(backend.numLive == 0);
+
+    return TestResult("BufferAllocatorTest");
+}
@@ -0,0 +1,228 @@
+/*
+ *  ChangeQueueBench.cpp
+ *  HeadlessTests
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+/*  Several layer threads handing batches of change requests to one
+    renderer thread.  Compares the ChangeQueue with the mutex protected
+    list the Scene used to have, where the renderer held the lock while
+    it ran the changes.  Reports how long the producers spend in add,
+    on average and at worst, and checks that every request arrives once
+    and in the order its thread added it.
+  */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <vector>
+#include "ChangeQueue.h"
+#include "TestUtils.h"
+
+using namespace WhirlyKit;
+
+static const int NumBatches = 20000;
+static const int BatchSize = 16;
+// Work per request, standing in for execute()
+static const int WorkPerRequest = 200;
+
+// Remembers who made it and when, and does a bit of busy work
+class BenchRequest : public ChangeRequest
+{
+public:
+    BenchRequest(int producer,int seq) : producer(producer), seq(seq) { }
+
+    void execute(Scene *scene,WhirlyKitSceneRendererES *renderer,WhirlyKitView *view)
+    {
+        volatile int val = 0;
+        for (int ii=0;ii<WorkPerRequest;ii++)
+            val += ii*seq;
+    }
+
+    int producer,seq;
+};
+
+// The old way: add under a lock, renderer runs the changes while holding it
+class LockedList
+{
+public:
+    LockedList() { pthread_mutex_init(&lock,NULL); }
+    ~LockedList() { pthread_mutex_destroy(&lock); }
+
+    void add(ChangeSet &newChanges)
+    {
+        pthread_mutex_lock(&lock);
+        changes.insert(changes.end(),newChanges.begin(),newChanges.end());
+        pthread_mutex_unlock(&lock);
+        newChanges.clear();
+    }
+
+    pthread_mutex_t lock;
+    ChangeSet changes;
+};
+
+class BenchRun;
+
+// What each producer thread gets
+class ProducerInfo
+{
+public:
+    BenchRun *run;
+    int which;
+    double totalWait,maxWait;
+};
+
+class BenchRun
+{
+public:
+    BenchRun(int numProducers,bool useQueue) : numProducers(numProducers), useQueue(useQueue), numDone(0)
+    {
+        pthread_mutex_init(&doneLock,NULL);
+    }
+    ~BenchRun() { pthread_mutex_destroy(&doneLock); }
+
+    static void *produce(void *data)
+    {
+        ProducerInfo *info = (ProducerInfo *)data;
+        BenchRun *run = info->run;
+        int numBatches = NumBatches / run->numProducers;
+        int seq = 0;
+        for (int bi=0;bi<numBatches;bi++)
+        {
+            ChangeSet changes;
+            for (int ii=0;ii<BatchSize;ii++)
+                changes.push_back(new BenchRequest(info->which,seq++));
+            double startTime = TestTime();
+            if (run->useQueue)
+                run->queue.addAndClear(changes);
+            else
+                run->locked.add(changes);
+            double wait = TestTime() - startTime;
+            info->totalWait += wait;
+            if (wait > info->maxWait)
+                info->maxWait = wait;
+        }
+        pthread_mutex_lock(&run->doneLock);
+        run->numDone++;
+        pthread_mutex_unlock(&run->doneLock);
+        return NULL;
+    }
+
+    bool allDone()
+    {
+        pthread_mutex_lock(&doneLock);
+        bool done = numDone == numProducers;
+        pthread_mutex_unlock(&doneLock);
+        return done;
+    }
+
+    // Run the changes and check they're in order for each producer
+    void consume(ChangeSet &changes)
+    {
+        for (unsigned int ii=0;ii<changes.size();ii++)
+        {
+            BenchRequest *req = (BenchRequest *)changes[ii];
+            req->execute(NULL,NULL,NULL);
+            if (req->seq != lastSeq[req->producer]+1)
+                outOfOrder++;
+            lastSeq[req->producer] = req->seq;
+            delete req;
+        }
+        numExecuted += changes.size();
+    }
+
+    void run()
+    {
+        lastSeq.clear();
+        lastSeq.resize(numProducers,-1);
+        outOfOrder = 0;
+        numExecuted = 0;
+        std::vector<ProducerInfo> infos(numProducers);
+        std::vector<pthread_t> threads(numProducers);
+        double startTime = TestTime();
+        for (int ii=0;ii<numProducers;ii++)
+        {
+            infos[ii].run = this;
+            infos[ii].which = ii;
+            infos[ii].totalWait = infos[ii].maxWait = 0.0;
+            pthread_create(&threads[ii],NULL,&BenchRun::produce,&infos[ii]);
+        }
+
+        // The renderer thread, more or less
+        while (true)
+        {
+            bool done = allDone();
+            if (useQueue)
+            {
+                ChangeSet changes;
+                queue.takeAll(changes);
+                consume(changes);
+                if (done && queue.empty())
+                    break;
+            } else {
+                bool empty = false;
+                if (!pthread_mutex_trylock(&locked.lock))
+                {
+                    consume(locked.changes);
+                    locked.changes.clear();
+                    empty = true;
+                    pthread_mutex_unlock(&locked.lock);
+                }
+                if (done && empty)
+                    break;
+            }
+        }
+        for (int ii=0;ii<numProducers;ii++)
+            pthread_join(threads[ii],NULL);
+        double runTime = TestTime() - startTime;
+
+        double totalWait = 0.0, maxWait = 0.0;
+        for (int ii=0;ii<numProducers;ii++)
+        {
+            totalWait += infos[ii].totalWait;
+            if (infos[ii].maxWait > maxWait)
+                maxWait = infos[ii].maxWait;
+        }
+        int numBatches = (NumBatches / numProducers) * numProducers;
+        printf("  %d producers %-5s: %7.1f ms total, add %6.2f us average, %8.1f us worst, %d executed\n",
+               numProducers,useQueue ? "queue" : "mutex",runTime*1000,totalWait*1e6/numBatches,maxWait*1e6,numExecuted);
+        fflush(stdout);
+        TEST_CHECK(numExecuted == numBatches*BatchSize);
+        TEST_CHECK(outOfOrder == 0);
+    }
+
+    int numProducers;
+    bool useQueue;
+    ChangeQueue queue;
+    LockedList locked;
+    pthread_mutex_t doneLock;
+    int numDone;
+    std::vector<int> lastSeq;
+    int outOfOrder,numExecuted;
+};
+
+int main(int argc,char *argv[])
+{
+    int producers[4] = {1,2,4,8};
+    for (unsigned int pi=0;pi<4;pi++)
+        for (int which=0;which<2;which++)
+        {
+            BenchRun run(producers[pi],which == 1);
+            run.run();
+        }
+
+    return TestResult("ChangeQueueBench");
+}
@@ -0,0 +1,340 @@
+/*
+ *  ChangeSchedulerTest.cpp
+ *  HeadlessTests
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+/*  Feeds the change scheduler a burst like a big layer update makes: a
+    pile of slow bulk adds, then urgent removes, one of which touches an
+    add still waiting, and a request that can't say what it touches.
+    With no budget everything has to run in one frame, in the order it
+    was added.  With a budget the frames stay short, the unrelated
+    removes go first, and nothing jumps a request it depends on.
+    Then runs the change coalescer over small batches: adds cancelled by
+    removes, repeated updates merged into the last one, and nothing folded
+    across a request that refers to a target or won't say what it touches.
+  */
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include "ChangeQueue.h"
+#include "TestUtils.h"
+
+using namespace WhirlyKit;
+
+static const int NumAdds = 400;
+
+// Order the requests ran in, by sequence number
+static std::vector<int> execLog;
+
+class TestRequest : public ChangeRequest
+{
+public:
+    TestRequest(int seq,SimpleIdentity theId,ChangePriority pri,double cost,bool knownIDs=true)
+    : seq(seq), theId(theId), pri(pri), cost(cost), knownIDs(knownIDs) { }
+
+    // Spin for a while, like a real add would
+    void execute(Scene *scene,WhirlyKitSceneRendererES *renderer,WhirlyKitView *view)
+    {
+        double startTime = TestTime();
+        while (TestTime() - startTime < cost) ;
+        execLog.push_back(seq);
+    }
+
+    ChangePriority getPriority() { return pri; }
+
+    bool getIDs(std::vector<SimpleIdentity> &ids)
+    {
+        if (!knownIDs)
+            return false;
+        ids.push_back(theId);
+        return true;
+    }
+
+    int seq;
+    SimpleIdentity theId;
+    ChangePriority pri;
+    double cost;
+    bool knownIDs;
+};
+
+// Number of coalescing requests that haven't been deleted
+static int NumLive = 0;
+
+// Adds, removes or updates its targets and might refer to other IDs along the way
+class CoalesceRequest : public ChangeRequest
+{
+public:
+    CoalesceRequest(int seq,ChangeCoalesceType type,SimpleIdentity target,double until=0.0)
+    : seq(seq), type(type), until(until), knownIDs(true) { targets.push_back(target);  NumLive++; }
+    virtual ~CoalesceRequest() { NumLive--; }
+
+    void execute(Scene *scene,WhirlyKitSceneRendererES *renderer,WhirlyKitView *view) { execLog.push_back(seq); }
+
+    bool getIDs(std::vector<SimpleIdentity> &ids)
+    {
+        if (!knownIDs)
+            return false;
+        ids.insert(ids.end(),targets.begin(),targets.end());
+        ids.insert(ids.end(),refs.begin(),refs.end());
+        return true;
+    }
+
+    ChangeCoalesceType getCoalesceType() { return type; }
+    void getCoalesceIDs(std::vector<SimpleIdentity> &ids) { ids.insert(ids.end(),targets.begin(),targets.end()); }
+
+    bool dropTargets(const std::set<SimpleIdentity> &ids)
+    {
+        unsigned int numKept = 0;
+        for (unsigned int ii=0;ii<targets.size();ii++)
+            if (ids.find(targets[ii]) == ids.end())
+                targets[numKept++] = targets[ii];
+        targets.resize(numKept);
+        return targets.empty();
+    }
+
+    // Stands in for the renderUntil a fade carries over
+    void takeOverTarget(ChangeRequest *earlier,SimpleIdentity targetID)
+    {
+        until = std::max(until,((CoalesceRequest *)earlier)->until);
+    }
+
+    int seq;
+    ChangeCoalesceType type;
+    std::vector<SimpleIdentity> targets,refs;
+    double until;
+    bool knownIDs;
+};
+
+// Two kinds of update, which shouldn't merge with each other
+class UpdateRequest : public CoalesceRequest
+{
+public:
+    UpdateRequest(int seq,SimpleIdentity target,double until=0.0) : CoalesceRequest(seq,ChangeCoalesceUpdate,target,until) { }
+};
+class OtherUpdateRequest : public CoalesceRequest
+{
+public:
+    OtherUpdateRequest(int seq,SimpleIdentity target) : CoalesceRequest(seq,ChangeCoalesceUpdate,target) { }
+};
+
+// Sequence numbers of the requests left in a batch, like "0 2 3"
+static std::string Kept(const ChangeSet &changes)
+{
+    std::string kept;
+    for (unsigned int ii=0;ii<changes.size();ii++)
+    {
+        char str[32];
+        sprintf(str,"%s%d",(ii == 0 ? "" : " "),((CoalesceRequest *)changes[ii])->seq);
+        kept += str;
+    }
+    return kept;
+}
+
+static void Clear(ChangeSet &changes)
+{
+    for (unsigned int ii=0;ii<changes.size();ii++)
+        delete changes[ii];
+    changes.clear();
+}
+
+static void TestCoalescer()
+{
+    ChangeCoalescer coalescer;
+    ChangeSet changes;
+
+    // An add and remove in the same batch take the updates in between with them
+    changes.push_back(new CoalesceRequest(0,ChangeCoalesceAdd,1));
+    changes.push_back(new UpdateRequest(1,1));
+    changes.push_back(new OtherUpdateRequest(2,1));
+    changes.push_back(new CoalesceRequest(3,ChangeCoalesceRemove,1));
+    changes.push_back(new CoalesceRequest(4,ChangeCoalesceAdd,2));
+    coalescer.coalesce(changes);
+    TEST_CHECK(Kept(changes) == "4");
+    const ChangeCoalesceStats &stats = coalescer.getStats();
+    TEST_CHECK(stats.numChanges == 5);
+    TEST_CHECK(stats.numRemoved == 4);
+    TEST_CHECK(stats.numCancelled == 1);
+    TEST_CHECK(stats.numMerged == 2);
+    Clear(changes);
+
+    // A remove of something already there just drops the updates before it
+    coalescer.resetStats();
+    changes.push_back(new UpdateRequest(0,3));
+    changes.push_back(new CoalesceRequest(1,ChangeCoalesceRemove,3));
+    coalescer.coalesce(changes);
+    TEST_CHECK(Kept(changes) == "1");
+    TEST_CHECK(coalescer.getStats().numCancelled == 0);
+    Clear(changes);
+
+    // Updates of the same kind merge into the last one, which picks up what the others
+    //  would have done.  Different kinds of update are left alone.
+    changes.push_back(new UpdateRequest(0,4,10.0));
+    changes.push_back(new UpdateRequest(1,4,30.0));
+    changes.push_back(new OtherUpdateRequest(2,4));
+    changes.push_back(new UpdateRequest(3,4,20.0));
+    coalescer.coalesce(changes);
+    TEST_CHECK(Kept(changes) == "2 3");
+    TEST_CHECK(changes.size() == 2 && ((CoalesceRequest *)changes[1])->until == 30.0);
+    Clear(changes);
+
+    // A request with several targets loses the merged ones and keeps the rest
+    {
+        CoalesceRequest *multi = new UpdateRequest(0,5,40.0);
+        multi->targets.push_back(6);
+        changes.push_back(multi);
+        changes.push_back(new UpdateRequest(1,5));
+        coalescer.coalesce(changes);
+        TEST_CHECK(Kept(changes) == "0 1");
+        TEST_CHECK(multi->targets.size() == 1 && multi->targets[0] == 6);
+        TEST_CHECK(((CoalesceRequest *)changes[1])->until == 40.0);
+        Clear(changes);
+    }
+
+    // Nothing folds across a request that won't say what it touches
+    {
+        changes.push_back(new CoalesceRequest(0,ChangeCoalesceAdd,7));
+        changes.push_back(new UpdateRequest(1,8));
+        CoalesceRequest *barrier = new CoalesceRequest(2,ChangeCoalesceNone,99);
+        barrier->knownIDs = false;
+        changes.push_back(barrier);
+        changes.push_back(new CoalesceRequest(3,ChangeCoalesceRemove,7));
+        changes.push_back(new UpdateRequest(4,8));
+        coalescer.coalesce(changes);
+        TEST_CHECK(Kept(changes) == "0 1 2 3 4");
+        Clear(changes);
+    }
+
+    // Or across one that refers to the target, like a drawable using a texture
+    {
+        changes.push_back(new CoalesceRequest(0,ChangeCoalesceAdd,9));
+        CoalesceRequest *user = new CoalesceRequest(1,ChangeCoalesceAdd,10);
+        user->refs.push_back(9);
+        changes.push_back(user);
+        changes.push_back(new CoalesceRequest(2,ChangeCoalesceRemove,9));
+        coalescer.coalesce(changes);
+        TEST_CHECK(Kept(changes) == "0 1 2");
+        Clear(changes);
+    }
+
+    TEST_CHECK(NumLive == 0);
+    printf("  coalescer: cancelled, merged and blocked as expected\n");
+}
+
+// Returns the number of frames it took and fills in which frame each request ran in
+static int RunBurst(double budget,std::map<int,int> &frameOf,double &worstFrame)
+{
+    ChangeQueue queue;
+    ChangeScheduler scheduler;
+    scheduler.setTimeBudget(budget);
+    execLog.clear();
+
+    // Adds for 0 through 399, a remove of 5, unrelated removes, a barrier, then another remove
+    ChangeSet changes;
+    int seq = 0;
+    for (int ii=0;ii<NumAdds;ii++)
+        changes.push_back(new TestRequest(seq++,ii,ChangePriorityBulk,0.0002));
+    changes.push_back(new TestRequest(seq++,5,ChangePriorityUrgent,0.00005));
+    for (int ii=0;ii<20;ii++)
+        changes.push_back(new TestRequest(seq++,1000+ii,ChangePriorityUrgent,0.00005));
+    changes.push_back(new TestRequest(seq++,77,ChangePriorityNormal,0.0001,false));
+    changes.push_back(new TestRequest(seq++,2000,ChangePriorityUrgent,0.00005));
+    queue.addAndClear(changes);
+
+    int frame = 0;
+    worstFrame = 0.0;
+    while (true)
+    {
+        unsigned int before = execLog.size();
+        double startTime = TestTime();
+        scheduler.process(queue,NULL,NULL,NULL);
+        double frameTime = TestTime() - startTime;
+        if (frameTime > worstFrame)
+            worstFrame = frameTime;
+        for (unsigned int ii=before;ii<execLog.size();ii++)
+            frameOf[execLog[ii]] = frame;
+        const ChangeStats &stats = scheduler.getStats();
+        TEST_CHECK(stats.numExecuted == (int)(execLog.size() - before));
+        TEST_CHECK(stats.numPending == NumAdds + 23 - (int)execLog.size());
+        frame++;
+        if (!scheduler.hasPending() && queue.empty())
+            break;
+        if (frame > 1000)
+        {
+            TEST_CHECK(false);
+            break;
+        }
+    }
+    TEST_CHECK(execLog.size() == NumAdds + 23);
+
+    return frame;
+}
+
+// Position of a request in the execution order
+static int Position(int seq)
+{
+    for (unsigned int ii=0;ii<execLog.size();ii++)
+        if (execLog[ii] == seq)
+            return ii;
+    return -1;
+}
+
+int main(int argc,char *argv[])
+{
+    std::map<int,int> frameOf;
+    double worstFrame;
+
+    // No budget: one frame, in the order added
+    int frames = RunBurst(0.0,frameOf,worstFrame);
+    printf("  no budget: %d frame, %.1f ms\n",frames,worstFrame*1000);
+    TEST_CHECK(frames == 1);
+    bool inOrder = true;
+    for (unsigned int ii=0;ii<execLog.size();ii++)
+        if (execLog[ii] != (int)ii)
+            inOrder = false;
+    TEST_CHECK(inOrder);
+
+    // 8ms budget: spread out, removes go early, dependencies hold
+    frameOf.clear();
+    frames = RunBurst(0.008,frameOf,worstFrame);
+    printf("  8ms budget: %d frames, worst %.1f ms, unrelated remove ran in frame %d, remove after the barrier in frame %d\n",
+           frames,worstFrame*1000,frameOf[NumAdds+1],frameOf[NumAdds+22]);
+    TEST_CHECK(frames > 1);
+    TEST_CHECK(frameOf[NumAdds+1] == 0);
+    // Remove of 5 waits for the add of 5
+    TEST_CHECK(Position(5) < Position(NumAdds));
+    // Nothing passes the request that won't say what it touches, and it doesn't pass anything
+    TEST_CHECK(Position(NumAdds-1) < Position(NumAdds+21));
+    TEST_CHECK(Position(NumAdds+21) < Position(NumAdds+22));
+    // Bulk adds stay in order
+    int last = -1;
+    bool addsInOrder = true;
+    for (unsigned int ii=0;ii<execLog.size();ii++)
+        if (execLog[ii] < NumAdds)
+        {
+            if (execLog[ii] < last)
+                addsInOrder = false;
+            last = execLog[ii];
+        }
+    TEST_CHECK(addsInOrder);
+
+    TestCoalescer();
+
+    return TestResult("ChangeSchedulerTest");
+}
@@ -0,0 +1,70 @@
+/*
+ *  CommandListBench.cpp
+ *  HeadlessTests
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+/*  How much of a frame the render thread spends with and without command
+    lists.  The replay harness draws a 4000 drawable frame on the render
+    thread, then builds it on a frame builder thread and only replays it on
+    the render thread, for light, medium and heavy culling work.  Both ways
+    have to make the same calls on the recording backend, other than the
+    extra names the command list reserves.
+  */
+
+#include "ReplayHarness.h"
+
+static const int NumDraws = 4000;
+static const int NumFrames = 60;
+
+int main(int argc,char *argv[])
+{
+    ReplayHarness harness(NumDraws,3);
+    
+    const char *names[3] = {"light","medium","heavy"};
+    int cullWork[3] = {40,400,1200};
+    for (unsigned int wi=0;wi<3;wi++)
+    {
+        harness.cullWork = cullWork[wi];
+        double immediateTime = harness.runImmediate(NumFrames);
+        RecordingGLBackend::Stats immediateStats = harness.backend.getStats();
+        double waitTime;
+        double replayTime = harness.runCommandLists(NumFrames,waitTime);
+        RecordingGLBackend::Stats replayStats = harness.backend.getStats();
+        
+        printf("  %-6s cull work: render thread %.2f ms immediate, %.2f ms replaying (%.2f ms waiting on the builder), %d commands a frame\n",
+               names[wi],immediateTime*1000,replayTime*1000,waitTime*1000,harness.cmdList.getNumCommands());
+        fflush(stdout);
+        TEST_CHECK(harness.cmdList.getNumDropped() == 0);
+        
+        // Same calls both ways, other than reserving names
+        TEST_CHECK(immediateStats.draws == replayStats.draws);
+        TEST_CHECK(immediateStats.vertices == replayStats.vertices);
+        TEST_CHECK(immediateStats.uniformUploads == replayStats.uniformUploads);
+        for (int cmd=0;cmd<RecordingGLBackend::GLCmdMax;cmd++)
+            if (cmd != RecordingGLBackend::GLCmdGenBuffers && cmd != RecordingGLBackend::GLCmdGenTextures &&
+                cmd != RecordingGLBackend::GLCmdGenVertexArrays)
+            {
+                if (immediateStats.calls[cmd] != replayStats.calls[cmd])
+                    printf("  %s: %d immediate, %d replayed\n",RecordingGLBackend::commandName((RecordingGLBackend::Command)cmd),
+                           immediateStats.calls[cmd],replayStats.calls[cmd]);
+                TEST_CHECK(immediateStats.calls[cmd] == replayStats.calls[cmd]);
+            }
+    }
+    
+    return TestResult("CommandListBench");
+}
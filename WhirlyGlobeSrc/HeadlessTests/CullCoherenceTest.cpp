@@ -0,0 +1,158 @@
+/*
+ *  CullCoherenceTest.cpp
+ *  HeadlessTests
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+/*  Replays camera paths through two cull trees holding the same drawables,
+    one reusing earlier frames' results and one testing everything fresh,
+    and checks they hand back exactly the same drawables every frame.
+    The paths cover a slow orbit, a fast pan, zooming down to the surface, skimming
+    along near the surface with horizon culling doing the work, jumps
+    that should start the cache over, and a change of screen size.
+  */
+
+#include <vector>
+#include "CullTestView.h"
+#include "TestUtils.h"
+
+using namespace WhirlyKit;
+
+static const int NumDraws = 30000;
+static const int TreeDepth = 8;
+
+// A camera path, one view per frame
+typedef std::vector<CullTestView> CameraPath;
+
+// Go around the equator a bit at a time
+static void OrbitPath(CameraPath &path)
+{
+    for (int ii=0;ii<600;ii++)
+        path.push_back(CullTestView(0.002*ii,0.1,1.4));
+}
+
+// Zoom from far out down to just over the surface, drifting as we go
+static void ZoomPath(CameraPath &path)
+{
+    for (int ii=0;ii<600;ii++)
+    {
+        double height = 2.0 * pow(0.005,ii/599.0);
+        path.push_back(CullTestView(1.0+0.0005*ii,0.5-0.0003*ii,1.0+height));
+    }
+}
+
+// Pan quickly at a low height, as fast as coherence will follow
+static void PanPath(CameraPath &path)
+{
+    for (int ii=0;ii<600;ii++)
+        path.push_back(CullTestView(0.01*ii,0.4*sin(ii*0.01),1.1));
+}
+
+// Skim along close to the surface, going up and down a little
+static void SkimPath(CameraPath &path)
+{
+    for (int ii=0;ii<600;ii++)
+        path.push_back(CullTestView(-2.0+0.0004*ii,-0.3+0.0002*ii,1.01+0.005*sin(ii*0.05)));
+}
+
+// Slow moves broken up by jumps to the other side of the globe and back,
+//  with the screen changing shape partway through
+static void JumpPath(CameraPath &path)
+{
+    for (int ii=0;ii<600;ii++)
+    {
+        double lon = 0.001*ii + ((ii/100) % 2 ? M_PI : 0.0);
+        if (ii < 300)
+            path.push_back(CullTestView(lon,0.3,1.2));
+        else
+            path.push_back(CullTestView(lon,0.3,1.2,768,1024));
+    }
+}
+
+// Run the path through both trees and count the frames that differ
+static int ReplayPath(const char *name,const CameraPath &path,CullTree &freshTree,CullTree &coherentTree)
+{
+    int numDiffer = 0;
+    long numTested = 0, numReused = 0, numReturned = 0;
+    std::vector<Drawable *> fresh,coherent;
+    for (unsigned int fi=0;fi<path.size();fi++)
+    {
+        CullTestView view = path[fi];
+        CullParams params;
+        view.setupParams(params);
+
+        fresh.clear();
+        int considered = 0;
+        params.useCoherence = false;
+        freshTree.findDrawables(params,fresh,&considered);
+
+        coherent.clear();
+        params.useCoherence = true;
+        coherentTree.findDrawables(params,coherent,&considered);
+        numTested += coherentTree.getNodesTested();
+        numReused += coherentTree.getNodesReused();
+        numReturned += fresh.size();
+
+        // Same drawables in the same trees come back in the same order
+        if (fresh != coherent)
+            numDiffer++;
+    }
+
+    printf("  %s: %d frames, %ld drawables a frame, %.0f%% of nodes reused, %d frames differ\n",
+           name,(int)path.size(),numReturned/(long)path.size(),100.0*numReused/std::max(numTested+numReused,1L),numDiffer);
+    return numDiffer;
+}
+
+int main(int argc,char *argv[])
+{
+    FakeGeocentricDisplayAdapter adapter;
+    std::vector<DrawableRef> draws;
+    MakeCullDrawables(NumDraws,draws);
+
+    CullTree freshTree(&adapter,CullWorldMbr(),TreeDepth);
+    CullTree coherentTree(&adapter,CullWorldMbr(),TreeDepth);
+    for (unsigned int ii=0;ii<draws.size();ii++)
+    {
+        freshTree.addDrawable(draws[ii]->getLocalMbr(),draws[ii]);
+        coherentTree.addDrawable(draws[ii]->getLocalMbr(),draws[ii]);
+    }
+
+    CameraPath orbit,pan,zoom,skim,jump;
+    OrbitPath(orbit);
+    PanPath(pan);
+    ZoomPath(zoom);
+    SkimPath(skim);
+    JumpPath(jump);
+    TEST_CHECK(ReplayPath("orbit",orbit,freshTree,coherentTree) == 0);
+    TEST_CHECK(ReplayPath("pan",pan,freshTree,coherentTree) == 0);
+    TEST_CHECK(ReplayPath("zoom",zoom,freshTree,coherentTree) == 0);
+    TEST_CHECK(ReplayPath("skim",skim,freshTree,coherentTree) == 0);
+    TEST_CHECK(ReplayPath("jump",jump,freshTree,coherentTree) == 0);
+
+    // Coherence has to actually kick in for any of that to mean much
+    CullParams params;
+    orbit[1].setupParams(params);
+    params.useCoherence = true;
+    std::vector<Drawable *> toDraw;
+    int considered = 0;
+    coherentTree.findDrawables(params,toDraw,&considered);
+    toDraw.clear();
+    coherentTree.findDrawables(params,toDraw,&considered);
+    TEST_CHECK(coherentTree.getNodesReused() > 0);
+
+    return TestResult("CullCoherenceTest");
+}
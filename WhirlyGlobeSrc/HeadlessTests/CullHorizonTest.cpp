@@ -0,0 +1,204 @@
+/*
+ *  CullHorizonTest.cpp
+ *  HeadlessTests
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+/*  Checks horizon culling, from the eye just over the surface on out.
+    IsBelowHorizon has to get points just over and just under the horizon
+    right, on the surface and sticking up off it.  A point from
+    CalcHorizonCullPoint can only be hidden if the whole patch is.
+    Then the cull tree, with the screen and backface checks out of the way,
+    has to keep a tile that's partly over the limb and anything else we can
+    see any of, and toss tiles that are all the way behind the globe.
+  */
+
+#include <set>
+#include <vector>
+#include "CullTestView.h"
+#include "TestUtils.h"
+
+using namespace WhirlyKit;
+
+// Eye distances from the center, down to just over the surface
+static const int NumEyeDists = 6;
+static const double EyeDists[NumEyeDists] = {1.0001,1.001,1.01,1.05,1.5,4.0};
+
+static const int NumDraws = 20000;
+static const int TreeDepth = 8;
+
+// A point on the unit sphere (times radius) at the given angle from +x, toward +y
+static Point3d PointAtAngle(double angle,double radius=1.0)
+{
+    return Point3d(radius*cos(angle),radius*sin(angle),0.0);
+}
+
+// Points just over and just under the horizon, on the surface and up off it
+static void TestIsBelowHorizon()
+{
+    for (int di=0;di<NumEyeDists;di++)
+    {
+        Point3d eye(EyeDists[di],0,0);
+        // Angle from the eye direction to the horizon on the surface
+        double horizon = acos(1.0/EyeDists[di]);
+        double eps = horizon * 1e-4;
+        TEST_CHECK(!IsBelowHorizon(eye,PointAtAngle(horizon-eps)));
+        TEST_CHECK(IsBelowHorizon(eye,PointAtAngle(horizon+eps)));
+        TEST_CHECK(!IsBelowHorizon(eye,PointAtAngle(0.0)));
+        TEST_CHECK(IsBelowHorizon(eye,PointAtAngle(M_PI)));
+
+        // Something higher up can be seen further around
+        double height = 1.01;
+        double over = horizon + acos(1.0/height);
+        TEST_CHECK(!IsBelowHorizon(eye,PointAtAngle(over-eps,height)));
+        TEST_CHECK(IsBelowHorizon(eye,PointAtAngle(over+eps,height)));
+
+        // Up off the surface and between us and the horizon is never hidden
+        TEST_CHECK(!IsBelowHorizon(eye,PointAtAngle(horizon/2,(1.0+EyeDists[di])/2)));
+    }
+
+    // From inside the sphere there's no horizon
+    TEST_CHECK(!IsBelowHorizon(Point3d(0.5,0,0),PointAtAngle(M_PI)));
+}
+
+// A cull point is only hidden if everything in its patch is
+static void TestCullPoint()
+{
+    // Too big a patch doesn't get one
+    Point3d cullPt;
+    TEST_CHECK(!CalcHorizonCullPoint(Point3d(1,0,0),M_PI/2,1.0,cullPt));
+
+    srand(11);
+    int numHidden = 0;
+    for (int ii=0;ii<2000;ii++)
+    {
+        double angle = 0.001 + 0.3*CullRandom();
+        double maxRadius = 1.0 + 0.02*CullRandom();
+        Point3d dir(1,0,0);
+        if (!CalcHorizonCullPoint(dir,angle,maxRadius,cullPt))
+            continue;
+        TEST_CHECK(cullPt.norm() >= maxRadius);
+
+        // Eyes all around, close in and far out
+        double eyeAngle = M_PI*CullRandom(), eyeDist = EyeDists[ii % NumEyeDists];
+        Point3d eye(eyeDist*cos(eyeAngle),eyeDist*sin(eyeAngle)*cos(0.3*ii),eyeDist*sin(eyeAngle)*sin(0.3*ii));
+        if (!IsBelowHorizon(eye,cullPt))
+            continue;
+        numHidden++;
+
+        // Edge of the patch in all directions, on the surface and at the top
+        bool allHidden = true;
+        for (int si=0;si<16;si++)
+        {
+            double around = 2*M_PI*si/16;
+            Point3d pt(cos(angle),sin(angle)*cos(around),sin(angle)*sin(around));
+            if (!IsBelowHorizon(eye,pt) || !IsBelowHorizon(eye,pt*maxRadius))
+                allHidden = false;
+        }
+        TEST_CHECK(allHidden);
+    }
+    // And it has to be good for something
+    TEST_CHECK(numHidden > 100);
+}
+
+// Make a tile drawable covering the given longitudes, straddling the equator
+static DrawableRef MakeTile(double minLon,double maxLon)
+{
+    double halfHeight = (maxLon-minLon)/2;
+    return DrawableRef(new Drawable(Mbr(Point2f(minLon,-halfHeight),Point2f(maxLon,halfHeight))));
+}
+
+// True if any part of the tile can be seen from the eye
+static bool CanSee(CoordSystemDisplayAdapter *adapter,const Point3d &eye,const Drawable *draw)
+{
+    Mbr mbr = draw->getLocalMbr();
+    for (int iy=0;iy<3;iy++)
+        for (int ix=0;ix<3;ix++)
+        {
+            Point3d loc(mbr.ll().x() + (mbr.ur().x()-mbr.ll().x())*ix/2,mbr.ll().y() + (mbr.ur().y()-mbr.ll().y())*iy/2,0.0);
+            if (adapter->localToDisplay(loc).dot(eye) > 1.0)
+                return true;
+        }
+    return false;
+}
+
+// The cull tree against the horizon alone
+static void TestCullTree()
+{
+    FakeGeocentricDisplayAdapter adapter;
+    std::vector<DrawableRef> draws;
+    MakeCullDrawables(NumDraws,draws);
+
+    for (int di=0;di<NumEyeDists;di++)
+    {
+        CullTree tree(&adapter,CullWorldMbr(),TreeDepth);
+        for (unsigned int ii=0;ii<draws.size();ii++)
+            tree.addDrawable(draws[ii]->getLocalMbr(),draws[ii]);
+
+        // Tiles right at the limb, one just this side of it, and some well behind the globe
+        double horizon = acos(1.0/EyeDists[di]);
+        double width = std::min(horizon/2,0.05);
+        DrawableRef straddle = MakeTile(horizon-width/2,horizon+width/2);
+        DrawableRef inside = MakeTile(horizon-1.5*width,horizon-0.5*width);
+        DrawableRef behind = MakeTile(horizon+0.6,horizon+0.6+width);
+        DrawableRef farSide = MakeTile(M_PI-0.1,M_PI-0.05);
+        DrawableRef tiles[4] = {straddle,inside,behind,farSide};
+        for (unsigned int ti=0;ti<4;ti++)
+            tree.addDrawable(tiles[ti]->getLocalMbr(),tiles[ti]);
+
+        // Look from over the equator at longitude zero.  The limb is off screen,
+        //  so take the screen and backface checks out of it.
+        CullTestView view(0.0,0.0,EyeDists[di]);
+        CullParams params;
+        view.setupParams(params);
+        params.checkBackface = false;
+        params.screenMbr = Mbr(Point2f(-1e9,-1e9),Point2f(1e9,1e9));
+        std::vector<Drawable *> toDraw;
+        int considered = 0;
+        tree.findDrawables(params,toDraw,&considered);
+        std::set<Drawable *> found(toDraw.begin(),toDraw.end());
+
+        TEST_CHECK(found.find(straddle.get()) != found.end());
+        TEST_CHECK(found.find(inside.get()) != found.end());
+        TEST_CHECK(found.find(behind.get()) == found.end());
+        TEST_CHECK(found.find(farSide.get()) == found.end());
+
+        // Nothing we can see any of goes missing
+        int numVisible = 0, numMissed = 0;
+        for (unsigned int ii=0;ii<draws.size();ii++)
+            if (CanSee(&adapter,view.eyePos,draws[ii].get()))
+            {
+                numVisible++;
+                if (found.find(draws[ii].get()) == found.end())
+                    numMissed++;
+            }
+        TEST_CHECK(numMissed == 0);
+        TEST_CHECK(toDraw.size() < draws.size());
+
+        printf("  eye at %.4f: %d of %d tiles visible, %d returned, %d missed\n",
+               EyeDists[di],numVisible,NumDraws,(int)toDraw.size(),numMissed);
+    }
+}
+
+int main(int argc,char *argv[])
+{
+    TestIsBelowHorizon();
+    TestCullPoint();
+    TestCullTree();
+
+    return TestResult("CullHorizonTest");
+}
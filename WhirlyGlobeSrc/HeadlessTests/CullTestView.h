@@ -0,0 +1,135 @@
+/*
+ *  CullTestView.h
+ *  HeadlessTests
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+#include "Cullable.h"
+#include "GlobeMath.h"
+
+/** Globe views and drawables for the culling tests and benchmarks.
+    The drawables are spread over the globe like tiles from a range of levels.
+    The views look straight down at the unit sphere from various heights,
+    set up the way SceneRendererES does it for a WhirlyGlobeView.
+  */
+
+using namespace WhirlyKit;
+
+/// A random number between 0 and 1
+static inline float CullRandom()
+{
+    return rand() / (float)RAND_MAX;
+}
+
+/// Make tile sized drawables from levels 3 through 12, in local coordinates (radians)
+static inline void MakeCullDrawables(int numDraws,std::vector<DrawableRef> &draws)
+{
+    srand(7);
+    for (int ii=0;ii<numDraws;ii++)
+    {
+        int level = 3 + (int)(CullRandom()*9.99);
+        float width = 2*M_PI/(1<<level), height = M_PI/(1<<level);
+        float x = -M_PI + CullRandom()*(2*M_PI-width), y = -M_PI/2 + CullRandom()*(M_PI-height);
+        draws.push_back(DrawableRef(new Drawable(Mbr(Point2f(x,y),Point2f(x+width,y+height)))));
+    }
+}
+
+/// Local bounds for the whole globe
+static inline Mbr CullWorldMbr()
+{
+    return Mbr(Point2f(-M_PI,-M_PI/2),Point2f(M_PI,M_PI/2));
+}
+
+/// A view looking at the center of the globe
+class CullTestView
+{
+public:
+    /// Longitude and latitude of the eye, in radians, and distance from the center
+    CullTestView(double lon,double lat,double dist,float width=1024,float height=768)
+    : frameWidth(width), frameHeight(height), nearPlane(0.01)
+    {
+        eyePos = Eigen::Vector3d(dist*cos(lat)*cos(lon),dist*cos(lat)*sin(lon),dist*sin(lat));
+        Eigen::Vector3d fwd = (-eyePos).normalized(), up(0,0,1);
+        if (fabs(fwd.dot(up)) > 0.99)
+            up = Eigen::Vector3d(0,1,0);
+        Eigen::Vector3d side = fwd.cross(up).normalized(), camUp = side.cross(fwd);
+        modelMat = Eigen::Matrix4d::Identity();
+        modelMat.block<1,3>(0,0) = side.transpose();
+        modelMat.block<1,3>(1,0) = camUp.transpose();
+        modelMat.block<1,3>(2,0) = -fwd.transpose();
+        modelMat(0,3) = -side.dot(eyePos);
+        modelMat(1,3) = -camUp.dot(eyePos);
+        modelMat(2,3) = fwd.dot(eyePos);
+        eyeVec = eyePos.normalized().cast<float>();
+        
+        // 60 degree field of view, like the globe view
+        ur.y() = nearPlane*tan(M_PI/6);
+        ll.y() = -ur.y();
+        ur.x() = ur.y()*frameWidth/frameHeight;
+        ll.x() = -ur.x();
+    }
+    
+    /// Fill in the cull parameters the way SceneRendererES does
+    void setupParams(CullParams &params)
+    {
+        params.checkBackface = true;
+        params.checkScreen = true;
+        params.eyeVec = eyeVec;
+        params.checkHorizon = true;
+        params.eyePos = eyePos;
+        params.modelMat = modelMat.cast<float>();
+        params.scaleX = -nearPlane * frameWidth / (ur.x() - ll.x());
+        params.offsetX = -ll.x() * frameWidth / (ur.x() - ll.x());
+        params.scaleY = nearPlane * frameHeight / (ur.y() - ll.y());
+        params.offsetY = frameHeight * (1.0 + ll.y() / (ur.y() - ll.y()));
+        params.screenMbr = Mbr(Point2f(-0.1*frameWidth,-0.1*frameHeight),Point2f(1.1*frameWidth,1.1*frameHeight));
+    }
+    
+    /// True if the middle of the drawable is on screen, facing us and over the horizon,
+    ///  so culling had better keep it
+    bool mustDraw(CoordSystemDisplayAdapter *adapter,const Drawable *draw)
+    {
+        Point2f mid = draw->getLocalMbr().mid();
+        Point3d pt = adapter->localToDisplay(Point3d(mid.x(),mid.y(),0.0));
+        if (pt.dot(eyeVec.cast<double>()) <= 0.2 || pt.dot(eyePos) <= 1.001)
+            return false;
+        Eigen::Vector4d camPt = modelMat * Eigen::Vector4d(pt.x(),pt.y(),pt.z(),1.0);
+        if (camPt.z() >= 0.0)
+            return false;
+        Eigen::Vector3d ray = camPt.head<3>() * (-nearPlane / camPt.z());
+        double screenX = (ray.x() - ll.x()) / (ur.x() - ll.x()) * frameWidth;
+        double screenY = (1.0 - (ray.y() - ll.y()) / (ur.y() - ll.y())) * frameHeight;
+        return screenX >= 0 && screenY >= 0 && screenX <= frameWidth && screenY <= frameHeight;
+    }
+    
+    float frameWidth,frameHeight;
+    double nearPlane;
+    Point2d ll,ur;
+    Eigen::Matrix4d modelMat;
+    Eigen::Vector3d eyePos;
+    Eigen::Vector3f eyeVec;
+};
+
+/// Views from all around the globe, some close and some far
+static inline void MakeCullViews(int numViews,std::vector<CullTestView> &views)
+{
+    for (int ii=0;ii<numViews;ii++)
+        views.push_back(CullTestView(-M_PI+2*M_PI*ii/numViews,0.6*sin((double)ii),1.05+(ii%6)*0.4));
+}
@@ -0,0 +1,121 @@
+/*
+ *  CullThreadsBench.cpp
+ *  HeadlessTests
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+/*  Culling throughput with the work split over a worker pool, the way
+    SceneRendererES2 does it, but with no GL anywhere.  Runs the same
+    views with no pool and then with more and more threads, and checks
+    every run hands back exactly what the first one did, in the same
+    order, with nothing repeated.  Give it a drawable count to try a
+    bigger scene than the default.
+  */
+
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+#include "WorkerPool.h"
+#include "CullTestView.h"
+#include "TestUtils.h"
+
+using namespace WhirlyKit;
+
+static const int TreeDepth = 8;
+static const int NumViews = 48;
+static const int NumReps = 10;
+
+int main(int argc,char *argv[])
+{
+    int numDraws = (argc > 1) ? atoi(argv[1]) : 200000;
+    
+    FakeGeocentricDisplayAdapter adapter;
+    std::vector<DrawableRef> draws;
+    MakeCullDrawables(numDraws,draws);
+    CullTree tree(&adapter,CullWorldMbr(),TreeDepth);
+    for (unsigned int ii=0;ii<draws.size();ii++)
+    {
+        // Some are off, so the isOn() checks have something to do
+        draws[ii]->on = (ii % 5) != 0;
+        tree.addDrawable(draws[ii]->getLocalMbr(),draws[ii]);
+    }
+    // A few get added twice, like drawables split on the date line
+    for (int ii=0;ii<numDraws/100;ii++)
+    {
+        DrawableRef draw = draws[(ii*37) % numDraws];
+        tree.addDrawable(draw->getLocalMbr(),draw);
+    }
+    
+    std::vector<CullTestView> views;
+    for (int ii=0;ii<NumViews;ii++)
+        views.push_back(CullTestView(-M_PI+2*M_PI*ii/NumViews,0.6*sin((double)ii),1.05+(ii%6)*0.6,2048,1536));
+    
+    // -1 is no pool at all.  0 is a pool where the caller does all the work.
+    int threadCounts[6] = {-1,0,1,3,7,15};
+    std::vector<std::vector<Drawable *> > firstRun;
+    for (unsigned int ti=0;ti<6;ti++)
+    {
+        int numThreads = threadCounts[ti];
+        WorkerPool *pool = (numThreads >= 0) ? new WorkerPool(numThreads) : NULL;
+        double cullTime = 0.0;
+        long numReturned = 0;
+        bool same = true, noRepeats = true, allOn = true;
+        for (unsigned int vi=0;vi<views.size();vi++)
+        {
+            CullParams params;
+            views[vi].setupParams(params);
+            params.workerPool = pool;
+            std::vector<Drawable *> toDraw;
+            for (int rep=0;rep<NumReps;rep++)
+            {
+                toDraw.clear();
+                int considered = 0;
+                double startTime = TestTime();
+                tree.findDrawables(params,toDraw,&considered);
+                cullTime += TestTime() - startTime;
+            }
+            numReturned += toDraw.size();
+            
+            if (firstRun.size() < views.size())
+                firstRun.push_back(toDraw);
+            else if (toDraw != firstRun[vi])
+                same = false;
+            std::vector<Drawable *> sorted(toDraw);
+            std::sort(sorted.begin(),sorted.end());
+            if (std::unique(sorted.begin(),sorted.end()) != sorted.end())
+                noRepeats = false;
+            for (unsigned int ii=0;ii<toDraw.size();ii++)
+                if (!toDraw[ii]->on)
+                    allOn = false;
+        }
+        
+        if (numThreads < 0)
+            printf("  no pool   : ");
+        else
+            printf("  %2d threads: ",numThreads+1);
+        printf("cull %.3f ms a frame, %ld drawables a frame, same as the first run: %s\n",
+               cullTime*1000/(NumViews*NumReps),numReturned/NumViews,same ? "yes" : "no");
+        fflush(stdout);
+        TEST_CHECK(same);
+        TEST_CHECK(noRepeats);
+        TEST_CHECK(allOn);
+        
+        delete pool;
+    }
+    
+    return TestResult("CullThreadsBench");
+}
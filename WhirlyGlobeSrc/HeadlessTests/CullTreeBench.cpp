@@ -0,0 +1,108 @@
+/*
+ *  CullTreeBench.cpp
+ *  HeadlessTests
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+/*  Times the cull tree with 10k to 100k tile sized drawables spread over
+    the globe: adding them all, removing and adding back a tenth of them,
+    and culling for views from all around.  Reports the memory the tree
+    uses and checks that nothing on screen and facing us gets culled.
+  */
+
+#include <set>
+#include <vector>
+#include "CullTestView.h"
+#include "TestUtils.h"
+
+using namespace WhirlyKit;
+
+static const int TreeDepth = 8;
+static const int NumViews = 40;
+static const int NumReps = 5;
+
+int main(int argc,char *argv[])
+{
+    FakeGeocentricDisplayAdapter adapter;
+    std::vector<CullTestView> views;
+    MakeCullViews(NumViews,views);
+    
+    int drawCounts[3] = {10000,50000,100000};
+    for (unsigned int di=0;di<3;di++)
+    {
+        int numDraws = drawCounts[di];
+        std::vector<DrawableRef> draws;
+        MakeCullDrawables(numDraws,draws);
+        
+        double startTime = TestTime();
+        CullTree tree(&adapter,CullWorldMbr(),TreeDepth);
+        for (unsigned int ii=0;ii<draws.size();ii++)
+            tree.addDrawable(draws[ii]->getLocalMbr(),draws[ii]);
+        double addTime = TestTime() - startTime;
+        
+        // Churn a tenth of them, like tiles coming and going
+        int numChurn = numDraws/10;
+        startTime = TestTime();
+        for (int ii=0;ii<numChurn;ii++)
+        {
+            DrawableRef draw = draws[(ii*7919) % numDraws];
+            tree.remDrawable(draw);
+            tree.addDrawable(draw->getLocalMbr(),draw);
+        }
+        double churnTime = TestTime() - startTime;
+        
+        double cullTime = 0.0;
+        long numReturned = 0, numConsidered = 0, numVisible = 0, numMissed = 0;
+        for (unsigned int vi=0;vi<views.size();vi++)
+        {
+            CullParams params;
+            views[vi].setupParams(params);
+            std::vector<Drawable *> toDraw;
+            int considered = 0;
+            for (int rep=0;rep<NumReps;rep++)
+            {
+                toDraw.clear();
+                considered = 0;
+                startTime = TestTime();
+                tree.findDrawables(params,toDraw,&considered);
+                cullTime += TestTime() - startTime;
+            }
+            numReturned += toDraw.size();
+            numConsidered += considered;
+            
+            std::set<Drawable *> found(toDraw.begin(),toDraw.end());
+            TEST_CHECK(found.size() == toDraw.size());
+            for (unsigned int ii=0;ii<draws.size();ii++)
+                if (views[vi].mustDraw(&adapter,draws[ii].get()))
+                {
+                    numVisible++;
+                    if (found.find(draws[ii].get()) == found.end())
+                        numMissed++;
+                }
+        }
+        
+        printf("  %6d drawables: add %.1f ms, remove and add %.2f us, cull %.3f ms a frame, %ld returned of %ld considered, %ld must draw, %ld missed, %d nodes, %.2f MB\n",
+               numDraws,addTime*1000,churnTime*1e6/numChurn,cullTime*1000/(NumViews*NumReps),
+               numReturned/NumViews,numConsidered/NumViews,numVisible/NumViews,numMissed,
+               tree.getCount(),tree.getMemoryUsage()/(1024.0*1024.0));
+        fflush(stdout);
+        TEST_CHECK(numMissed == 0);
+        TEST_CHECK(numReturned < (long)numDraws*NumViews);
+    }
+    
+    return TestResult("CullTreeBench");
+}
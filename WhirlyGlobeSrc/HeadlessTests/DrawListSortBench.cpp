@@ -0,0 +1,173 @@
+/*
+ *  DrawListSortBench.cpp
+ *  HeadlessTests
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+/*  Sorts draw lists of 2k to 100k drawables with the radix sorter and with
+    the stable_sort on a comparator the renderer used before.  Checks the
+    radix sort agrees with the old order on everything the old sort cared
+    about, then counts the program, texture and depth state changes a draw
+    loop would make with each.
+  */
+
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+#include "DrawListSorter.h"
+#include "TestUtils.h"
+
+using namespace WhirlyKit;
+
+// The comparator the renderer used to sort with
+class OldDrawListSort
+{
+public:
+    OldDrawListSort(bool useAlpha,bool useZBuffer) : useAlpha(useAlpha), useZBuffer(useZBuffer) { }
+    
+    bool operator()(Drawable *a,Drawable *b)
+    {
+        if (useAlpha)
+            if (a->hasAlpha(NULL) != b->hasAlpha(NULL))
+                return !a->hasAlpha(NULL);
+        if (a->getDrawPriority() == b->getDrawPriority())
+        {
+            if (useZBuffer)
+            {
+                bool bufferA = a->getRequestZBuffer();
+                bool bufferB = b->getRequestZBuffer();
+                if (bufferA != bufferB)
+                    return !bufferA;
+            }
+        }
+        return a->getDrawPriority() < b->getDrawPriority();
+    }
+    
+    bool useAlpha,useZBuffer;
+};
+
+// Count the state changes the draw loop would make going through the list
+class StateCounter
+{
+public:
+    StateCounter() : numPrograms(0), numTextures(0), numDepth(0) { }
+    
+    void run(const std::vector<Drawable *> &drawList)
+    {
+        SimpleIdentity curProgram = EmptyIdentity, curTex = EmptyIdentity;
+        int curDepth = -1;
+        bool depthOn = true;
+        for (unsigned int ii=0;ii<drawList.size();ii++)
+        {
+            Drawable *draw = drawList[ii];
+            if (depthOn && draw->hasAlpha(NULL))
+            {
+                depthOn = false;
+                numDepth++;
+            }
+            int depth = draw->getRequestZBuffer() ? 1 : 0;
+            if (depth != curDepth)
+            {
+                curDepth = depth;
+                numDepth++;
+            }
+            if (draw->getProgram() != curProgram)
+            {
+                curProgram = draw->getProgram();
+                numPrograms++;
+            }
+            if (draw->getTexId() != curTex)
+            {
+                curTex = draw->getTexId();
+                numTextures++;
+            }
+        }
+    }
+    
+    int numPrograms,numTextures,numDepth;
+};
+
+int main(int argc,char *argv[])
+{
+    srand(3);
+    int drawCounts[3] = {2000,20000,100000};
+    for (unsigned int di=0;di<3;di++)
+    {
+        int numDraws = drawCounts[di];
+        // Mostly the default priority, some layers with a handful of priorities, and a few all over
+        std::vector<Drawable> draws(numDraws);
+        for (int ii=0;ii<numDraws;ii++)
+        {
+            Drawable &draw = draws[ii];
+            if (rand() % 100 < 70)
+                draw.drawPriority = 0;
+            else
+                draw.drawPriority = (rand() % 100 < 70) ? 1000 + rand() % 4 : rand() % 100000;
+            draw.programId = 1 + rand() % 12;
+            draw.texId = (rand() % 10 == 0) ? EmptyIdentity : 100 + rand() % 600;
+            draw.alpha = rand() % 10 == 0;
+            draw.zBuffer = rand() % 5 == 0;
+        }
+        std::vector<Drawable *> drawList;
+        for (int ii=0;ii<numDraws;ii++)
+            drawList.push_back(&draws[ii]);
+        std::random_shuffle(drawList.begin(),drawList.end());
+        
+        int numReps = numDraws >= 100000 ? 20 : 200;
+        std::vector<Drawable *> oldList,newList;
+        double oldTime = 0.0, newTime = 0.0;
+        for (int rep=0;rep<numReps;rep++)
+        {
+            oldList = drawList;
+            double startTime = TestTime();
+            std::stable_sort(oldList.begin(),oldList.end(),OldDrawListSort(true,true));
+            oldTime += TestTime() - startTime;
+        }
+        DrawListSorter sorter;
+        for (int rep=0;rep<numReps;rep++)
+        {
+            newList = drawList;
+            double startTime = TestTime();
+            sorter.sort(newList,true,true,NULL,NULL);
+            newTime += TestTime() - startTime;
+        }
+        
+        // Nothing out of order as far as the old sort is concerned
+        OldDrawListSort oldSort(true,true);
+        bool inOrder = true;
+        for (unsigned int ii=1;ii<newList.size();ii++)
+            if (oldSort(newList[ii],newList[ii-1]))
+                inOrder = false;
+        TEST_CHECK(inOrder);
+        std::vector<Drawable *> sortedOld(oldList),sortedNew(newList);
+        std::sort(sortedOld.begin(),sortedOld.end());
+        std::sort(sortedNew.begin(),sortedNew.end());
+        TEST_CHECK(sortedOld == sortedNew);
+        
+        StateCounter oldCount,newCount;
+        oldCount.run(oldList);
+        newCount.run(newList);
+        printf("  %6d drawables: stable_sort %.3f ms, radix %.3f ms (%.1fx)\n",numDraws,oldTime*1000/numReps,newTime*1000/numReps,oldTime/newTime);
+        printf("    state changes before: %d program, %d texture, %d depth.  after: %d program, %d texture, %d depth\n",
+               oldCount.numPrograms,oldCount.numTextures,oldCount.numDepth,newCount.numPrograms,newCount.numTextures,newCount.numDepth);
+        fflush(stdout);
+        TEST_CHECK(newCount.numPrograms <= oldCount.numPrograms);
+        TEST_CHECK(newCount.numTextures <= oldCount.numTextures);
+    }
+    
+    return TestResult("DrawListSortBench");
+}
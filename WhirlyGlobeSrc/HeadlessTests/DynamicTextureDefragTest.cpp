@@ -0,0 +1,335 @@
+/*
+ *  DynamicTextureDefragTest.cpp
+ *  HeadlessTests
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+/*  Runs the dynamic texture defragmenter against a fake texture backend.
+    Each fake page is a grid of cells labelled with the sub texture sitting
+    there, so a copy that lands on something live or a sub texture that
+    comes out scrambled shows up.  The atlas side follows what
+    DynamicTextureAtlas does: first page with room, a new page when nothing
+    fits, pages released as they empty, and moves carried out in plan order
+    before the emptied pages go away.
+  */
+
+#include <stdlib.h>
+#include <map>
+#include <vector>
+#include "DynamicTextureDefrag.h"
+#include "TestUtils.h"
+
+using namespace WhirlyKit;
+
+// Cells on a side of a page
+static const int PageCells = 128;
+
+// A dynamic texture: the packer and what's in each cell
+class FakePage
+{
+public:
+    FakePage() : packer(PageCells,PageCells), cells(PageCells*PageCells,EmptyIdentity) { }
+
+    RectPacker packer;
+    std::vector<SimpleIdentity> cells;
+    std::map<SimpleIdentity,RectPacker::Rect> subTexes;
+};
+
+// The atlas bookkeeping from DynamicTextureAtlas, on fake pages
+class FakeAtlas
+{
+public:
+    FakeAtlas() : nextPageId(1000), nextSubTexId(1), cellsMoved(0) { }
+    ~FakeAtlas()
+    {
+        for (std::map<SimpleIdentity,FakePage *>::iterator it = pages.begin(); it != pages.end(); ++it)
+            delete it->second;
+    }
+
+    // DynamicTextureAtlas::addTexture
+    SimpleIdentity add(int width,int height)
+    {
+        RectPacker::Rect rect;
+        FakePage *page = NULL;
+        SimpleIdentity pageId = EmptyIdentity;
+        for (std::map<SimpleIdentity,FakePage *>::iterator it = pages.begin(); it != pages.end() && !page; ++it)
+            if (it->second->packer.findSpot(width,height,rect))
+            {
+                page = it->second;
+                pageId = it->first;
+            }
+        if (!page)
+        {
+            page = new FakePage();
+            pageId = nextPageId++;
+            pages[pageId] = page;
+            if (!page->packer.findSpot(width,height,rect))
+                return EmptyIdentity;
+        }
+        page->packer.reserve(rect);
+        SimpleIdentity subTexId = nextSubTexId++;
+        page->subTexes[subTexId] = rect;
+        subTexPages[subTexId] = pageId;
+        fill(page,rect,subTexId);
+        return subTexId;
+    }
+
+    // DynamicTextureAtlas::removeTexture
+    void remove(SimpleIdentity subTexId)
+    {
+        SimpleIdentity pageId = subTexPages[subTexId];
+        FakePage *page = pages[pageId];
+        page->packer.release(page->subTexes[subTexId]);
+        page->subTexes.erase(subTexId);
+        subTexPages.erase(subTexId);
+        if (page->subTexes.empty())
+        {
+            delete page;
+            pages.erase(pageId);
+        }
+    }
+
+    // DynamicTextureAtlas::defragment.  Returns the number of moves.
+    int defragment(const DynamicTextureDefragParams &params,int &numEmptied)
+    {
+        std::vector<DynamicTextureDefragPlanner::Page> planPages;
+        for (std::map<SimpleIdentity,FakePage *>::iterator it = pages.begin(); it != pages.end(); ++it)
+        {
+            DynamicTextureDefragPlanner::Page planPage;
+            planPage.pageId = it->first;
+            planPage.packer = &it->second->packer;
+            for (std::map<SimpleIdentity,RectPacker::Rect>::iterator sit = it->second->subTexes.begin();
+                 sit != it->second->subTexes.end(); ++sit)
+                planPage.entries.push_back(DynamicTextureDefragPlanner::Entry(sit->first,sit->second));
+            planPages.push_back(planPage);
+        }
+        std::vector<DynamicTextureDefragPlanner::Move> moves;
+        std::vector<SimpleIdentity> emptiedPages;
+        DynamicTextureDefragPlanner planner(params);
+        planner.plan(planPages,moves,emptiedPages);
+
+        int passCells = 0;
+        for (unsigned int ii=0;ii<moves.size();ii++)
+        {
+            const DynamicTextureDefragPlanner::Move &move = moves[ii];
+            FakePage *srcPage = pages[move.fromPage], *destPage = pages[move.toPage];
+            TEST_CHECK(move.fromRect.width == move.toRect.width && move.fromRect.height == move.toRect.height);
+            TEST_CHECK(srcPage->subTexes[move.subTexId].x == move.fromRect.x && srcPage->subTexes[move.subTexId].y == move.fromRect.y);
+            // DynamicTextureCopyRegion.  Nothing live should be sitting where we're copying to.
+            for (int iy=0;iy<move.toRect.height;iy++)
+                for (int ix=0;ix<move.toRect.width;ix++)
+                {
+                    SimpleIdentity &dest = destPage->cells[(move.toRect.y+iy)*PageCells + move.toRect.x+ix];
+                    TEST_CHECK(dest == EmptyIdentity || destPage->subTexes.find(dest) == destPage->subTexes.end());
+                    dest = srcPage->cells[(move.fromRect.y+iy)*PageCells + move.fromRect.x+ix];
+                }
+            srcPage->subTexes.erase(move.subTexId);
+            destPage->subTexes[move.subTexId] = move.toRect;
+            subTexPages[move.subTexId] = move.toPage;
+            passCells += move.fromRect.width * move.fromRect.height;
+        }
+        TEST_CHECK(passCells <= params.maxCellsPerPass);
+        cellsMoved += passCells;
+
+        // RemTextureReq for the emptied pages
+        for (unsigned int ii=0;ii<emptiedPages.size();ii++)
+        {
+            FakePage *page = pages[emptiedPages[ii]];
+            TEST_CHECK(page->subTexes.empty());
+            delete page;
+            pages.erase(emptiedPages[ii]);
+        }
+        numEmptied = emptiedPages.size();
+
+        return moves.size();
+    }
+
+    // Every live sub texture should be where we think it is with its cells intact
+    bool check()
+    {
+        for (std::map<SimpleIdentity,SimpleIdentity>::iterator it = subTexPages.begin(); it != subTexPages.end(); ++it)
+        {
+            std::map<SimpleIdentity,FakePage *>::iterator pit = pages.find(it->second);
+            if (pit == pages.end())
+                return false;
+            FakePage *page = pit->second;
+            const RectPacker::Rect &rect = page->subTexes[it->first];
+            for (int iy=rect.y;iy<rect.y+rect.height;iy++)
+                for (int ix=rect.x;ix<rect.x+rect.width;ix++)
+                    if (page->cells[iy*PageCells+ix] != it->first)
+                        return false;
+        }
+        return true;
+    }
+
+    // Average fraction of the pages in use
+    float utilization()
+    {
+        long long used = 0;
+        for (std::map<SimpleIdentity,FakePage *>::iterator it = pages.begin(); it != pages.end(); ++it)
+        {
+            RectPackerStats stats;
+            it->second->packer.getStats(stats);
+            used += stats.usedArea;
+        }
+        return pages.empty() ? 0.0 : used / ((double)pages.size() * PageCells * PageCells);
+    }
+
+    std::map<SimpleIdentity,FakePage *> pages;
+    std::map<SimpleIdentity,SimpleIdentity> subTexPages;
+    SimpleIdentity nextPageId,nextSubTexId;
+    long long cellsMoved;
+
+protected:
+    void fill(FakePage *page,const RectPacker::Rect &rect,SimpleIdentity subTexId)
+    {
+        for (int iy=rect.y;iy<rect.y+rect.height;iy++)
+            for (int ix=rect.x;ix<rect.x+rect.width;ix++)
+                page->cells[iy*PageCells+ix] = subTexId;
+    }
+};
+
+// Glyphs mostly, with the occasional tile
+static SimpleIdentity AddRandom(FakeAtlas &atlas)
+{
+    if (rand() % 100 < 95)
+        return atlas.add(1 + rand() % 3,1 + rand() % 2);
+    int size = 8 + rand() % 9;
+    return atlas.add(size,size);
+}
+
+// Fill up a bunch of pages, then remove most of what's in them, like a long session would
+static void FillAndThin(FakeAtlas &atlas,int numAdds,int percentRemoved)
+{
+    std::vector<SimpleIdentity> subTexIds;
+    for (int ii=0;ii<numAdds;ii++)
+    {
+        SimpleIdentity subTexId = AddRandom(atlas);
+        TEST_CHECK(subTexId != EmptyIdentity);
+        subTexIds.push_back(subTexId);
+    }
+    for (unsigned int ii=0;ii<subTexIds.size();ii++)
+        if (rand() % 100 < percentRemoved)
+            atlas.remove(subTexIds[ii]);
+}
+
+// Run passes until there's nothing left to do
+static int DefragAll(FakeAtlas &atlas,const DynamicTextureDefragParams &params)
+{
+    int passes = 0;
+    while (true)
+    {
+        int numEmptied = 0;
+        int numMoves = atlas.defragment(params,numEmptied);
+        if (numMoves == 0 && numEmptied == 0)
+            break;
+        passes++;
+        TEST_CHECK(atlas.check());
+        if (passes > 1000)
+        {
+            TEST_CHECK(false);
+            break;
+        }
+    }
+    return passes;
+}
+
+// Empty out the sparse pages, a little at a time
+static void TestSparse()
+{
+    srand(3);
+    FakeAtlas atlas;
+    FillAndThin(atlas,40000,80);
+    TEST_CHECK(atlas.check());
+    int numBefore = atlas.pages.size();
+    float useBefore = atlas.utilization();
+
+    DynamicTextureDefragParams params;
+    params.sparseUtilization = 0.5;
+    params.maxCellsPerPass = 4096;
+    double startTime = TestTime();
+    int passes = DefragAll(atlas,params);
+    double defragTime = TestTime() - startTime;
+
+    printf("  sparse: %d pages at %.1f%% -> %d pages at %.1f%%, %d passes, %lld cells moved, %.2f ms\n",
+           numBefore,100*useBefore,(int)atlas.pages.size(),100*atlas.utilization(),passes,atlas.cellsMoved,defragTime*1000);
+    TEST_CHECK(passes > 0);
+    TEST_CHECK((int)atlas.pages.size() < numBefore);
+    TEST_CHECK(atlas.utilization() > useBefore);
+
+    // And everything still works afterwards
+    for (int ii=0;ii<2000;ii++)
+        TEST_CHECK(AddRandom(atlas) != EmptyIdentity);
+    TEST_CHECK(atlas.check());
+}
+
+// Squeeze down to a page target, even when the pages aren't all that sparse
+static void TestTarget()
+{
+    srand(5);
+    FakeAtlas atlas;
+    FillAndThin(atlas,40000,50);
+    int numBefore = atlas.pages.size();
+
+    float useBefore = atlas.utilization();
+
+    // Without a target none of these are sparse enough to bother with
+    DynamicTextureDefragParams params;
+    params.sparseUtilization = 0.0;
+    params.maxCellsPerPass = PageCells*PageCells;
+    TEST_CHECK(DefragAll(atlas,params) == 0);
+
+    // Half the pages is more than will fit, so it should get as close as it can
+    params.targetPages = numBefore/2;
+    int passes = DefragAll(atlas,params);
+
+    printf("  target %d: %d pages at %.1f%% -> %d pages at %.1f%%, %d passes\n",
+           params.targetPages,numBefore,100*useBefore,(int)atlas.pages.size(),100*atlas.utilization(),passes);
+    TEST_CHECK((int)atlas.pages.size() < numBefore);
+    TEST_CHECK(atlas.utilization() > 0.8);
+    TEST_CHECK(atlas.check());
+}
+
+// Nothing to do for a single page or dense pages
+static void TestNothingToDo()
+{
+    srand(7);
+    FakeAtlas atlas;
+    DynamicTextureDefragParams params;
+    int numEmptied = 0;
+    TEST_CHECK(atlas.defragment(params,numEmptied) == 0 && numEmptied == 0);
+    for (int ii=0;ii<100;ii++)
+        AddRandom(atlas);
+    TEST_CHECK(atlas.pages.size() == 1);
+    TEST_CHECK(atlas.defragment(params,numEmptied) == 0 && numEmptied == 0);
+
+    // Two full pages don't move
+    FakeAtlas fullAtlas;
+    for (int ii=0;ii<2*PageCells*PageCells;ii++)
+        fullAtlas.add(1,1);
+    TEST_CHECK(fullAtlas.pages.size() == 2);
+    TEST_CHECK(fullAtlas.defragment(params,numEmptied) == 0 && numEmptied == 0);
+}
+
+int main(int argc,char *argv[])
+{
+    TestSparse();
+    TestTarget();
+    TestNothingToDo();
+
+    return TestResult("DynamicTextureDefragTest");
+}
@@ -0,0 +1,205 @@
+/*
+ *  ElementPatchBench.cpp
+ *  HeadlessTests
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+/*  Bytes written to a BigDrawable's element buffers per swap, patching
+    chunks in place versus rebuilding the whole buffer every time.
+
+    BigDrawable keeps its element data in NSData, so it won't build here.
+    ElementBuffer below does the same bookkeeping it does for element chunks.
+    It uses the same RegionAllocator for the slots, and the same repack rules
+    and thresholds.  Keep the two in sync.  The churn is what
+    DynamicDrawableAtlas hands a big drawable as tiles page in and out:
+    addDrawable, removeDrawable and setEnableDrawable between swaps.
+  */
+
+#include <stdlib.h>
+#include <map>
+#include <vector>
+#include "RegionAllocator.h"
+#include "TestUtils.h"
+
+using namespace WhirlyKit;
+
+static const int SingleElementSize = 2;
+static const int NumElementBytes = 1024*1024;
+static const int NumLive = 64;
+static const int NumSwaps = 2000;
+static const int ReplacementsPerSwap = 2;
+static const int TogglesPerSwap = 4;
+
+// From BigDrawable.mm
+static const float BigDrawableRepackFraction = 0.25;
+static const unsigned int BigDrawableRepackMin = 16384;
+
+// Element chunk bookkeeping from BigDrawable, counting bytes instead of copying them
+class ElementBuffer
+{
+public:
+    ElementBuffer() : allocator(NumElementBytes/SingleElementSize), chunkSize(0), nextId(1), rebuild(false),
+        patchBytes(0), rebuildBytes(0), numRebuilds(0) { }
+
+    class Chunk
+    {
+    public:
+        int len;
+        bool enabled;
+        int elRegion;
+    };
+
+    // BigDrawable::addRegion
+    int add(int len,bool enabled)
+    {
+        int elRegion = allocator.allocate(len/SingleElementSize);
+        if (elRegion < 0 && len + chunkSize < NumElementBytes)
+        {
+            repack();
+            elRegion = allocator.allocate(len/SingleElementSize);
+        }
+        if (elRegion < 0)
+            return -1;
+        Chunk chunk;
+        chunk.len = len;
+        chunk.enabled = enabled;
+        chunk.elRegion = elRegion;
+        int chunkId = nextId++;
+        chunks[chunkId] = chunk;
+        chunkSize += len;
+        // A patch for each buffer, either the elements or zeros
+        patchBytes += 2*len;
+        return chunkId;
+    }
+
+    // BigDrawable::setEnableRegion
+    void setEnable(int chunkId,bool enabled)
+    {
+        Chunk &chunk = chunks[chunkId];
+        if (chunk.enabled == enabled)
+            return;
+        chunk.enabled = enabled;
+        patchBytes += 2*chunk.len;
+    }
+
+    // BigDrawable::clearRegion
+    void remove(int chunkId)
+    {
+        Chunk &chunk = chunks[chunkId];
+        allocator.free(chunk.elRegion);
+        if (chunk.enabled)
+            patchBytes += 2*chunk.len;
+        chunkSize -= chunk.len;
+        chunks.erase(chunkId);
+    }
+
+    // BigDrawable::swap and executeFlush for both buffers
+    void swap()
+    {
+        unsigned int highWater = allocator.getHighWater();
+        unsigned int used = chunkSize/SingleElementSize;
+        if (highWater > BigDrawableRepackMin && highWater - used > highWater * BigDrawableRepackFraction)
+            repack();
+        if (rebuild)
+        {
+            rebuildBytes += 2 * allocator.getHighWater() * SingleElementSize;
+            numRebuilds++;
+            rebuild = false;
+        }
+    }
+
+    // What the old flush wrote: every enabled chunk, to both buffers
+    long long fullRebuildBytes() const
+    {
+        long long bytes = 0;
+        for (std::map<int,Chunk>::const_iterator it = chunks.begin(); it != chunks.end(); ++it)
+            if (it->second.enabled)
+                bytes += it->second.len;
+        return 2*bytes;
+    }
+
+    std::map<int,Chunk> chunks;
+    RegionAllocator allocator;
+    int chunkSize;
+    int nextId;
+    bool rebuild;
+    long long patchBytes,rebuildBytes;
+    int numRebuilds;
+
+protected:
+    // BigDrawable::repackElements.  A rebuild replaces any patches still waiting.
+    void repack()
+    {
+        allocator = RegionAllocator(NumElementBytes/SingleElementSize);
+        for (std::map<int,Chunk>::iterator it = chunks.begin(); it != chunks.end(); ++it)
+            it->second.elRegion = allocator.allocate(it->second.len/SingleElementSize);
+        rebuild = true;
+    }
+};
+
+// Size of a tile's elements in bytes
+static int ChunkLen()
+{
+    return (1000 + rand() % 4000) * SingleElementSize;
+}
+
+int main(int argc,char *argv[])
+{
+    srand(1);
+    ElementBuffer elBuffer;
+    std::vector<int> live;
+    for (int ii=0;ii<NumLive;ii++)
+    {
+        int chunkId = elBuffer.add(ChunkLen(),true);
+        TEST_CHECK(chunkId > 0);
+        live.push_back(chunkId);
+    }
+    elBuffer.swap();
+    elBuffer.patchBytes = elBuffer.rebuildBytes = 0;
+
+    long long oldBytes = 0;
+    double startTime = TestTime();
+    for (int si=0;si<NumSwaps;si++)
+    {
+        for (int ii=0;ii<ReplacementsPerSwap;ii++)
+        {
+            int which = rand() % live.size();
+            elBuffer.remove(live[which]);
+            int chunkId = elBuffer.add(ChunkLen(),true);
+            TEST_CHECK(chunkId > 0);
+            live[which] = chunkId;
+        }
+        for (int ii=0;ii<TogglesPerSwap;ii++)
+        {
+            int chunkId = live[rand() % live.size()];
+            elBuffer.setEnable(chunkId,!elBuffer.chunks[chunkId].enabled);
+        }
+        elBuffer.swap();
+        oldBytes += elBuffer.fullRebuildBytes();
+    }
+    double runTime = TestTime() - startTime;
+
+    long long newBytes = elBuffer.patchBytes + elBuffer.rebuildBytes;
+    printf("  %d live chunks, %d replacements and %d toggles per swap, %d swaps\n",NumLive,ReplacementsPerSwap,TogglesPerSwap,NumSwaps);
+    printf("  full rebuild: %.1f KB per swap\n",oldBytes / 1024.0 / NumSwaps);
+    printf("  patches:      %.1f KB per swap (%.1f KB patches, %.1f KB from %d repacks)\n",
+           newBytes / 1024.0 / NumSwaps,elBuffer.patchBytes / 1024.0 / NumSwaps,elBuffer.rebuildBytes / 1024.0 / NumSwaps,elBuffer.numRebuilds);
+    printf("  bookkeeping:  %.2f us per swap\n",runTime*1e6/NumSwaps);
+    TEST_CHECK(newBytes < oldBytes);
+
+    return TestResult("ElementPatchBench");
+}
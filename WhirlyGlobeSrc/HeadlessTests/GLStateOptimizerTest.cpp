@@ -0,0 +1,389 @@
+/*
+ *  GLStateOptimizerTest.cpp
+ *  HeadlessTests
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+/*  Drives the state optimizer the renderer uses through the recording backend.
+    Frames go the way SceneRendererES2 and BasicDrawable draw them: beginFrame,
+    blend and depth state, then a mix of drawables with their own vertex arrays
+    and ones pointing at buffers directly, then endFrame.  Between frames the
+    scene changes bind things behind the optimizer's back, like setting up
+    resources does.  Every draw has to see the bindings it asked for, even
+    though the optimizer skipped the calls it thought were redundant.
+    VAO 0 has to be bound after every frame, so nothing lands in a drawable's
+    vertex array, and changing vertex arrays has to forget the element buffer.
+    Prints how many calls the optimizer skipped.
+  */
+
+#include <vector>
+#include "GLStateOptimizer.h"
+#include "RecordingGLBackend.h"
+#include "TestUtils.h"
+
+using namespace WhirlyKit;
+
+static const int NumDraws = 2000;
+static const int NumFrames = 30;
+static const int NumPrograms = 3;
+static const int NumTextures = 40;
+
+// One thing to draw, like a BasicDrawable
+class TestDrawable
+{
+public:
+    int program;
+    GLuint texId;
+    // Set up the first time we draw, if we're using one
+    bool useVAO;
+    GLuint vertArrayObj;
+    GLuint pointBuffer,triBuffer;
+};
+
+// Calls we ask the optimizer for or make directly, to compare with what got through
+class CallCounts
+{
+public:
+    CallCounts() { for (unsigned int ii=0;ii<RecordingGLBackend::GLCmdMax;ii++) calls[ii] = 0; }
+    int calls[RecordingGLBackend::GLCmdMax];
+};
+
+static GLint BoundValue(GLenum pname)
+{
+    GLint val = -1;
+    GetGLBackend()->getIntegerv(pname,&val);
+    return val;
+}
+
+class StateOptimizerHarness
+{
+public:
+    StateOptimizerHarness()
+    {
+        SetGLBackend(&backend);
+        GLBackend *gl = GetGLBackend();
+        for (unsigned int ii=0;ii<NumPrograms;ii++)
+            programs.push_back(gl->createProgram());
+        textures.resize(NumTextures);
+        gl->genTextures(NumTextures,&textures[0]);
+
+        draws.resize(NumDraws);
+        for (unsigned int ii=0;ii<NumDraws;ii++)
+        {
+            TestDrawable &draw = draws[ii];
+            draw.program = (ii / 200) % NumPrograms;
+            draw.texId = textures[(ii / 7) % NumTextures];
+            draw.useVAO = (ii % 3) != 0;
+            draw.vertArrayObj = 0;
+            gl->genBuffers(1,&draw.pointBuffer);
+            gl->genBuffers(1,&draw.triBuffer);
+        }
+    }
+
+    ~StateOptimizerHarness()
+    {
+        SetGLBackend(NULL);
+    }
+
+    // Make the vertex array, binding things directly the way setupVAO does
+    void setupVAO(TestDrawable &draw)
+    {
+        GLBackend *gl = GetGLBackend();
+        direct.calls[RecordingGLBackend::GLCmdBindVertexArray] += 2;
+        direct.calls[RecordingGLBackend::GLCmdBindBuffer] += 4;
+        gl->genVertexArrays(1,&draw.vertArrayObj);
+        gl->bindVertexArray(draw.vertArrayObj);
+        gl->bindBuffer(GL_ARRAY_BUFFER,draw.pointBuffer);
+        gl->enableVertexAttribArray(0);
+        gl->bindBuffer(GL_ELEMENT_ARRAY_BUFFER,draw.triBuffer);
+        gl->bindVertexArray(0);
+        gl->bindBuffer(GL_ARRAY_BUFFER,0);
+        gl->bindBuffer(GL_ELEMENT_ARRAY_BUFFER,0);
+    }
+
+    // Draw one, checking the bindings it sees
+    void drawOne(TestDrawable &draw)
+    {
+        GLBackend *gl = GetGLBackend();
+        req.calls[RecordingGLBackend::GLCmdActiveTexture]++;
+        stateOpt.setActiveTexture(GL_TEXTURE0);
+        req.calls[RecordingGLBackend::GLCmdBindTexture]++;
+        stateOpt.setBoundTexture(draw.texId);
+
+        if (draw.useVAO)
+        {
+            if (draw.vertArrayObj == 0)
+            {
+                setupVAO(draw);
+                // That bound things behind the state optimizer's back
+                stateOpt.resetBindings();
+            }
+            req.calls[RecordingGLBackend::GLCmdBindVertexArray]++;
+            stateOpt.setVertexArray(draw.vertArrayObj);
+        } else {
+            // The last drawable may have left its VAO bound
+            req.calls[RecordingGLBackend::GLCmdBindVertexArray]++;
+            stateOpt.setVertexArray(0);
+            req.calls[RecordingGLBackend::GLCmdBindBuffer] += 2;
+            stateOpt.setArrayBuffer(draw.pointBuffer);
+            stateOpt.setElementArrayBuffer(draw.triBuffer);
+            gl->vertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,0,0);
+            gl->enableVertexAttribArray(0);
+        }
+
+        // What the draw call is going to use
+        TEST_CHECK(BoundValue(GL_CURRENT_PROGRAM) == (GLint)programs[draw.program]);
+        TEST_CHECK(BoundValue(GL_ACTIVE_TEXTURE) == GL_TEXTURE0);
+        TEST_CHECK(BoundValue(GL_TEXTURE_BINDING_2D) == (GLint)draw.texId);
+        TEST_CHECK(BoundValue(GL_VERTEX_ARRAY_BINDING_OES) == (GLint)draw.vertArrayObj);
+        TEST_CHECK(BoundValue(GL_ELEMENT_ARRAY_BUFFER_BINDING) == (GLint)draw.triBuffer);
+        if (!draw.useVAO)
+            TEST_CHECK(BoundValue(GL_ARRAY_BUFFER_BINDING) == (GLint)draw.pointBuffer);
+        gl->drawElements(GL_TRIANGLES,300,GL_UNSIGNED_SHORT,0);
+
+        if (!draw.useVAO)
+            gl->disableVertexAttribArray(0);
+    }
+
+    // Draw a frame the way SceneRendererES2 does
+    void drawFrame(int frame)
+    {
+        GLBackend *gl = GetGLBackend();
+        stateOpt.beginFrame();
+        req.calls[RecordingGLBackend::GLCmdBlendFunc]++;
+        stateOpt.setBlendFunc(GL_ONE,GL_ONE_MINUS_SRC_ALPHA);
+        req.calls[RecordingGLBackend::GLCmdEnable]++;
+        stateOpt.setEnableBlend(true);
+        req.calls[RecordingGLBackend::GLCmdDepthMask]++;
+        stateOpt.setDepthMask(GL_TRUE);
+        req.calls[RecordingGLBackend::GLCmdEnable]++;
+        stateOpt.setEnableDepthTest(true);
+        req.calls[RecordingGLBackend::GLCmdDepthFunc]++;
+        stateOpt.setDepthFunc(GL_LESS);
+        gl->clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        // A different slice of the drawables each frame, in program order
+        int curProgram = -1;
+        for (unsigned int ii=frame*37;ii<NumDraws;ii+=1+frame%3)
+        {
+            TestDrawable &draw = draws[ii];
+            if (draw.program != curProgram)
+            {
+                curProgram = draw.program;
+                req.calls[RecordingGLBackend::GLCmdUseProgram]++;
+                stateOpt.setUseProgram(programs[curProgram]);
+            }
+            drawOne(draw);
+        }
+
+        // The 2D pass turns off the depth test
+        req.calls[RecordingGLBackend::GLCmdDisable]++;
+        stateOpt.setEnableDepthTest(false);
+
+        req.calls[RecordingGLBackend::GLCmdBindVertexArray]++;
+        stateOpt.endFrame();
+        TEST_CHECK(BoundValue(GL_VERTEX_ARRAY_BINDING_OES) == 0);
+    }
+
+    // Scene changes between frames, binding whatever they like directly
+    void changeScene(int frame)
+    {
+        GLBackend *gl = GetGLBackend();
+        direct.calls[RecordingGLBackend::GLCmdBindBuffer] += 2;
+        direct.calls[RecordingGLBackend::GLCmdActiveTexture]++;
+        direct.calls[RecordingGLBackend::GLCmdBindTexture]++;
+        direct.calls[RecordingGLBackend::GLCmdUseProgram]++;
+        GLuint newBuffers[2];
+        gl->genBuffers(2,newBuffers);
+        gl->bindBuffer(GL_ARRAY_BUFFER,newBuffers[0]);
+        gl->bufferData(GL_ARRAY_BUFFER,1024,NULL,GL_STATIC_DRAW);
+        // This lands in whatever vertex array is bound
+        gl->bindBuffer(GL_ELEMENT_ARRAY_BUFFER,newBuffers[1]);
+        gl->bufferData(GL_ELEMENT_ARRAY_BUFFER,512,NULL,GL_STATIC_DRAW);
+        gl->activeTexture(GL_TEXTURE0);
+        gl->bindTexture(GL_TEXTURE_2D,textures[(frame*3) % NumTextures]);
+        gl->useProgram(programs[(frame+1) % NumPrograms]);
+    }
+
+    RecordingGLBackend backend;
+    OpenGLStateOptimizer stateOpt;
+    std::vector<GLuint> programs;
+    std::vector<GLuint> textures;
+    std::vector<TestDrawable> draws;
+    CallCounts req,direct;
+};
+
+// Frames with scene changes in between, and the calls the optimizer saved
+static void TestFrames()
+{
+    StateOptimizerHarness harness;
+    harness.backend.reset();
+    for (int frame=0;frame<NumFrames;frame++)
+    {
+        harness.drawFrame(frame);
+        harness.changeScene(frame);
+    }
+
+    RecordingGLBackend::Stats stats = harness.backend.getStats();
+    const RecordingGLBackend::Command cmds[] = {RecordingGLBackend::GLCmdUseProgram,RecordingGLBackend::GLCmdActiveTexture,RecordingGLBackend::GLCmdBindTexture,
+        RecordingGLBackend::GLCmdBindVertexArray,RecordingGLBackend::GLCmdBindBuffer,RecordingGLBackend::GLCmdEnable,RecordingGLBackend::GLCmdDisable,
+        RecordingGLBackend::GLCmdDepthMask,RecordingGLBackend::GLCmdDepthFunc,RecordingGLBackend::GLCmdBlendFunc};
+    int totalAsked = 0, totalSkipped = 0;
+    int skipped[RecordingGLBackend::GLCmdMax];
+    printf("  %d frames, %d draws:\n",NumFrames,stats.draws);
+    for (unsigned int ci=0;ci<sizeof(cmds)/sizeof(cmds[0]);ci++)
+    {
+        RecordingGLBackend::Command cmd = cmds[ci];
+        int asked = harness.req.calls[cmd];
+        // The optimizer only ever drops calls.  Setup and scene changes make their own.
+        int fromOpt = stats.calls[cmd] - harness.direct.calls[cmd];
+        TEST_CHECK(fromOpt >= 0 && fromOpt <= asked);
+        skipped[cmd] = asked - fromOpt;
+        totalAsked += asked;
+        totalSkipped += asked - fromOpt;
+        printf("    %-24s %6d asked for, %6d skipped\n",RecordingGLBackend::commandName(cmd),asked,asked-fromOpt);
+    }
+    printf("  %d of %d state calls skipped (%.0f%%), %d redundant ones still sent\n",
+           totalSkipped,totalAsked,100.0*totalSkipped/totalAsked,stats.redundantStateChanges);
+    // The texture unit and fixed function state only go out once, since nobody else touches them.
+    // Drawables share textures, so a good part of those binds get skipped too.
+    TEST_CHECK(skipped[RecordingGLBackend::GLCmdActiveTexture] == harness.req.calls[RecordingGLBackend::GLCmdActiveTexture] - 1);
+    TEST_CHECK(skipped[RecordingGLBackend::GLCmdDepthFunc] == NumFrames - 1);
+    TEST_CHECK(skipped[RecordingGLBackend::GLCmdBindTexture] > harness.req.calls[RecordingGLBackend::GLCmdBindTexture] / 2);
+
+    // Every drawable got drawn at least once, so every VAO got set up
+    for (unsigned int ii=0;ii<NumDraws;ii++)
+        if (harness.draws[ii].useVAO)
+            TEST_CHECK(harness.draws[ii].vertArrayObj != 0);
+}
+
+// beginFrame has to forget bindings made behind the optimizer's back
+static void TestBeginFrame()
+{
+    StateOptimizerHarness harness;
+    GLBackend *gl = GetGLBackend();
+    OpenGLStateOptimizer &stateOpt = harness.stateOpt;
+
+    stateOpt.beginFrame();
+    stateOpt.setUseProgram(harness.programs[0]);
+    stateOpt.setActiveTexture(GL_TEXTURE0);
+    stateOpt.setBoundTexture(harness.textures[0]);
+    stateOpt.setArrayBuffer(harness.draws[0].pointBuffer);
+    stateOpt.endFrame();
+
+    // Someone else binds things between frames
+    gl->useProgram(harness.programs[1]);
+    gl->bindTexture(GL_TEXTURE_2D,harness.textures[1]);
+    gl->bindBuffer(GL_ARRAY_BUFFER,harness.draws[1].pointBuffer);
+
+    // Same requests next frame have to get through
+    harness.backend.reset();
+    stateOpt.beginFrame();
+    stateOpt.setUseProgram(harness.programs[0]);
+    stateOpt.setBoundTexture(harness.textures[0]);
+    stateOpt.setArrayBuffer(harness.draws[0].pointBuffer);
+    RecordingGLBackend::Stats stats = harness.backend.getStats();
+    TEST_CHECK(stats.calls[RecordingGLBackend::GLCmdUseProgram] == 1);
+    TEST_CHECK(stats.calls[RecordingGLBackend::GLCmdBindTexture] == 1);
+    TEST_CHECK(stats.calls[RecordingGLBackend::GLCmdBindBuffer] == 1);
+    TEST_CHECK(BoundValue(GL_CURRENT_PROGRAM) == (GLint)harness.programs[0]);
+    TEST_CHECK(BoundValue(GL_TEXTURE_BINDING_2D) == (GLint)harness.textures[0]);
+    TEST_CHECK(BoundValue(GL_ARRAY_BUFFER_BINDING) == (GLint)harness.draws[0].pointBuffer);
+
+    // Within a frame they're skipped
+    harness.backend.reset();
+    stateOpt.setUseProgram(harness.programs[0]);
+    stateOpt.setBoundTexture(harness.textures[0]);
+    stateOpt.setArrayBuffer(harness.draws[0].pointBuffer);
+    TEST_CHECK(harness.backend.getStats().totalCalls() == 0);
+    stateOpt.endFrame();
+}
+
+// endFrame leaves VAO 0 bound, so buffers bound after it stay out of the drawables' VAOs
+static void TestEndFrame()
+{
+    StateOptimizerHarness harness;
+    GLBackend *gl = GetGLBackend();
+    OpenGLStateOptimizer &stateOpt = harness.stateOpt;
+    TestDrawable &draw = harness.draws[1];
+    harness.setupVAO(draw);
+
+    stateOpt.beginFrame();
+    stateOpt.setVertexArray(draw.vertArrayObj);
+    stateOpt.endFrame();
+    TEST_CHECK(BoundValue(GL_VERTEX_ARRAY_BINDING_OES) == 0);
+
+    // Ending a frame with nothing bound doesn't cost anything
+    harness.backend.reset();
+    stateOpt.endFrame();
+    TEST_CHECK(harness.backend.getStats().totalCalls() == 0);
+
+    // Upload an element buffer, then draw with the VAO again
+    GLuint newBuffer;
+    gl->genBuffers(1,&newBuffer);
+    gl->bindBuffer(GL_ELEMENT_ARRAY_BUFFER,newBuffer);
+    stateOpt.beginFrame();
+    stateOpt.setVertexArray(draw.vertArrayObj);
+    TEST_CHECK(BoundValue(GL_ELEMENT_ARRAY_BUFFER_BINDING) == (GLint)draw.triBuffer);
+    stateOpt.endFrame();
+}
+
+// Changing the vertex array forgets the element buffer, since it's part of the VAO
+static void TestElementBufferForgotten()
+{
+    StateOptimizerHarness harness;
+    OpenGLStateOptimizer &stateOpt = harness.stateOpt;
+    TestDrawable &drawA = harness.draws[1], &drawB = harness.draws[2];
+    harness.setupVAO(drawA);
+    harness.setupVAO(drawB);
+    GLuint elBuffer = harness.draws[0].triBuffer;
+
+    stateOpt.beginFrame();
+    stateOpt.setVertexArray(drawA.vertArrayObj);
+    stateOpt.setElementArrayBuffer(elBuffer);
+    TEST_CHECK(BoundValue(GL_ELEMENT_ARRAY_BUFFER_BINDING) == (GLint)elBuffer);
+
+    // Same VAO, same buffer, nothing to do
+    harness.backend.reset();
+    stateOpt.setVertexArray(drawA.vertArrayObj);
+    stateOpt.setElementArrayBuffer(elBuffer);
+    TEST_CHECK(harness.backend.getStats().totalCalls() == 0);
+
+    // New VAO has its own element buffer, so ours has to be bound again
+    stateOpt.setVertexArray(drawB.vertArrayObj);
+    TEST_CHECK(BoundValue(GL_ELEMENT_ARRAY_BUFFER_BINDING) == (GLint)drawB.triBuffer);
+    harness.backend.reset();
+    stateOpt.setElementArrayBuffer(elBuffer);
+    TEST_CHECK(harness.backend.getStats().calls[RecordingGLBackend::GLCmdBindBuffer] == 1);
+    TEST_CHECK(BoundValue(GL_ELEMENT_ARRAY_BUFFER_BINDING) == (GLint)elBuffer);
+
+    // And the same going back to no VAO at all
+    stateOpt.setVertexArray(0);
+    stateOpt.setElementArrayBuffer(elBuffer);
+    TEST_CHECK(BoundValue(GL_ELEMENT_ARRAY_BUFFER_BINDING) == (GLint)elBuffer);
+    stateOpt.endFrame();
+}
+
+int main(int argc,char *argv[])
+{
+    TestFrames();
+    TestBeginFrame();
+    TestEndFrame();
+    TestElementBufferForgotten();
+
+    return TestResult("GLStateOptimizerTest");
+}
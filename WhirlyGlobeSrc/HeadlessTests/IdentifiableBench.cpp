@@ -0,0 +1,111 @@
+/*
+ *  IdentifiableBench.cpp
+ *  HeadlessTests
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+/*  How fast IDs come out of genId with 1, 4 and 16 threads at it.
+    Compares the per thread blocks against the plain static counter it
+    replaced, which hands out duplicates once there's more than one
+    thread, and against a single shared atomic counter.
+  */
+
+#include <pthread.h>
+#include <algorithm>
+#include <vector>
+#include "Identifiable.h"
+#include "TestUtils.h"
+
+using namespace WhirlyKit;
+
+static const int IDsPerThread = 2000000;
+
+// The old way: an unprotected increment
+static SimpleIdentity curId = 0;
+static SimpleIdentity PlainGenId()
+{
+    return ++curId;
+}
+
+// One counter everyone fights over
+static volatile SimpleIdentity atomicId = 0;
+static SimpleIdentity AtomicGenId()
+{
+    return __sync_add_and_fetch(&atomicId,1);
+}
+
+typedef SimpleIdentity (*GenIdFunc)();
+
+class ThreadInfo
+{
+public:
+    GenIdFunc genFunc;
+    std::vector<SimpleIdentity> ids;
+};
+
+static void *MakeIDs(void *data)
+{
+    ThreadInfo *info = (ThreadInfo *)data;
+    info->ids.resize(IDsPerThread);
+    GenIdFunc genFunc = info->genFunc;
+    for (int ii=0;ii<IDsPerThread;ii++)
+        info->ids[ii] = genFunc();
+    return NULL;
+}
+
+// Returns millions of IDs a second and counts the duplicates
+static double Run(int numThreads,GenIdFunc genFunc,unsigned int &numDups)
+{
+    std::vector<ThreadInfo> infos(numThreads);
+    std::vector<pthread_t> threads(numThreads);
+    double startTime = TestTime();
+    for (int ii=0;ii<numThreads;ii++)
+    {
+        infos[ii].genFunc = genFunc;
+        pthread_create(&threads[ii],NULL,&MakeIDs,&infos[ii]);
+    }
+    for (int ii=0;ii<numThreads;ii++)
+        pthread_join(threads[ii],NULL);
+    double runTime = TestTime() - startTime;
+
+    std::vector<SimpleIdentity> all;
+    for (int ii=0;ii<numThreads;ii++)
+        all.insert(all.end(),infos[ii].ids.begin(),infos[ii].ids.end());
+    std::sort(all.begin(),all.end());
+    numDups = (unsigned int)(all.end() - std::unique(all.begin(),all.end()));
+
+    return numThreads * (double)IDsPerThread / runTime / 1e6;
+}
+
+int main(int argc,char *argv[])
+{
+    int threadCounts[3] = {1,4,16};
+    for (unsigned int ti=0;ti<3;ti++)
+    {
+        int numThreads = threadCounts[ti];
+        unsigned int blockDups,plainDups,atomicDups;
+        double blockRate = Run(numThreads,&Identifiable::genId,blockDups);
+        double plainRate = Run(numThreads,&PlainGenId,plainDups);
+        double atomicRate = Run(numThreads,&AtomicGenId,atomicDups);
+        printf("  %2d threads: blocks %5.0f M IDs/s, %u dups | plain static %5.0f M/s, %u dups | shared atomic %5.0f M/s\n",
+               numThreads,blockRate,blockDups,plainRate,plainDups,atomicRate);
+        TEST_CHECK(blockDups == 0);
+        TEST_CHECK(atomicDups == 0);
+    }
+
+    return TestResult("IdentifiableBench");
+}
@@ -0,0 +1,99 @@
+/*
+ *  IdentifiableTest.cpp
+ *  HeadlessTests
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+/*  Lots of threads making IDs at once, some through the Identifiable
+    constructor and some through genId, the way the layer threads and
+    the main thread do.  Every ID has to be unique, none can be
+    EmptyIdentity, and each thread's have to go up.  Threads come and go
+    in waves so blocks get leased by threads that then exit.
+  */
+
+#include <pthread.h>
+#include <algorithm>
+#include <vector>
+#include "Identifiable.h"
+#include "TestUtils.h"
+
+using namespace WhirlyKit;
+
+static const int NumThreads = 16;
+static const int NumWaves = 4;
+static const int IDsPerThread = 50000;
+
+class ThreadInfo
+{
+public:
+    int which;
+    std::vector<SimpleIdentity> ids;
+};
+
+static void *MakeIDs(void *data)
+{
+    ThreadInfo *info = (ThreadInfo *)data;
+    info->ids.reserve(IDsPerThread);
+    for (int ii=0;ii<IDsPerThread;ii++)
+    {
+        if ((ii + info->which) % 3 == 0)
+            info->ids.push_back(Identifiable::genId());
+        else {
+            Identifiable obj;
+            info->ids.push_back(obj.getId());
+        }
+    }
+    return NULL;
+}
+
+int main(int argc,char *argv[])
+{
+    std::vector<SimpleIdentity> all;
+    bool monotonic = true;
+    for (int wave=0;wave<NumWaves;wave++)
+    {
+        std::vector<ThreadInfo> infos(NumThreads);
+        std::vector<pthread_t> threads(NumThreads);
+        for (int ii=0;ii<NumThreads;ii++)
+        {
+            infos[ii].which = ii;
+            pthread_create(&threads[ii],NULL,&MakeIDs,&infos[ii]);
+        }
+        for (int ii=0;ii<NumThreads;ii++)
+        {
+            pthread_join(threads[ii],NULL);
+            const std::vector<SimpleIdentity> &ids = infos[ii].ids;
+            for (unsigned int ji=1;ji<ids.size();ji++)
+                if (ids[ji] <= ids[ji-1])
+                    monotonic = false;
+            all.insert(all.end(),ids.begin(),ids.end());
+        }
+    }
+    // And a few from the main thread for good measure
+    for (int ii=0;ii<1000;ii++)
+        all.push_back(Identifiable::genId());
+
+    std::sort(all.begin(),all.end());
+    unsigned int numDups = (unsigned int)(all.end() - std::unique(all.begin(),all.end()));
+    printf("  %d waves of %d threads, %d IDs: %u duplicates, smallest %llu\n",
+           NumWaves,NumThreads,(int)all.size(),numDups,all.front());
+    TEST_CHECK(numDups == 0);
+    TEST_CHECK(all.front() != EmptyIdentity);
+    TEST_CHECK(monotonic);
+
+    return TestResult("IdentifiableTest");
+}
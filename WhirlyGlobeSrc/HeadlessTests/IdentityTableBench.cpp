@@ -0,0 +1,200 @@
+/*
+ *  IdentityTableBench.cpp
+ *  HeadlessTests
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+/*  Checks the identity table against std::map under random inserts,
+    erases and finds.  Then times the lookups the Scene does against the
+    sets it used to keep: getDrawable, which built a dummy shared_ptr to
+    search with, and the per drawable texture lookup in the renderer,
+    which took a lock and searched a set of pointers.
+  */
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <vector>
+#include "IdentityTable.h"
+#include "TestUtils.h"
+
+using namespace WhirlyKit;
+
+static const int NumDrawables = 50000;
+static const int NumReps = 20;
+
+// Stands in for a drawable or texture, about as big as one
+class TestIdent
+{
+public:
+    TestIdent() : myId(++curId) { }
+    TestIdent(SimpleIdentity theId) : myId(theId) { }
+    virtual ~TestIdent() { }
+
+    SimpleIdentity getId() const { return myId; }
+
+    static SimpleIdentity curId;
+    SimpleIdentity myId;
+    char pad[200];
+};
+SimpleIdentity TestIdent::curId = 0;
+
+typedef boost::shared_ptr<TestIdent> TestIdentRef;
+
+// How the Scene sorted its drawables and textures
+class RefSorter
+{
+public:
+    bool operator()(const TestIdentRef &a,const TestIdentRef &b) const { return a->getId() < b->getId(); }
+};
+class PtrSorter
+{
+public:
+    bool operator()(const TestIdent *a,const TestIdent *b) const { return a->getId() < b->getId(); }
+};
+
+// Random operations, checked against std::map
+static void TestAgainstMap()
+{
+    IdentityTable<int> table;
+    std::map<SimpleIdentity,int> check;
+    srand(1);
+    for (int op=0;op<2000000;op++)
+    {
+        SimpleIdentity theId = 1 + rand() % 5000;
+        switch (rand() % 3)
+        {
+            case 0:
+                table.insert(theId,op);
+                check[theId] = op;
+                break;
+            case 1:
+                TEST_CHECK(table.erase(theId) == (check.erase(theId) > 0));
+                break;
+            default:
+            {
+                int *val = table.find(theId);
+                std::map<SimpleIdentity,int>::iterator it = check.find(theId);
+                TEST_CHECK((val != NULL) == (it != check.end()));
+                if (val && it != check.end())
+                    TEST_CHECK(*val == it->second);
+            }
+                break;
+        }
+        // Walk the dense array every so often
+        if (op % 100000 == 0)
+        {
+            TEST_CHECK(table.size() == check.size());
+            for (unsigned int ii=0;ii<table.size();ii++)
+                TEST_CHECK(check[table[ii].id] == table[ii].val);
+        }
+    }
+    printf("  random operations match std::map, %u entries at the end\n",table.size());
+}
+
+int main(int argc,char *argv[])
+{
+    TestAgainstMap();
+
+    std::set<TestIdentRef,RefSorter> drawSet;
+    IdentityTable<TestIdentRef> drawTable;
+    std::set<TestIdent *,PtrSorter> texSet;
+    IdentityTable<TestIdent *> texTable;
+    std::vector<SimpleIdentity> drawIds,texIds;
+    for (int ii=0;ii<NumDrawables;ii++)
+    {
+        TestIdentRef draw(new TestIdent());
+        drawSet.insert(draw);
+        drawTable.insert(draw->getId(),draw);
+        drawIds.push_back(draw->getId());
+        if (ii % 10 == 0)
+        {
+            TestIdent *tex = new TestIdent();
+            texSet.insert(tex);
+            texTable.insert(tex->getId(),tex);
+            texIds.push_back(tex->getId());
+        }
+    }
+    std::vector<SimpleIdentity> order(drawIds);
+    std::random_shuffle(order.begin(),order.end());
+    pthread_mutex_t lock;
+    pthread_mutex_init(&lock,NULL);
+    SimpleIdentity sum = 0, tableSum = 0;
+
+    // getDrawable: a dummy to search with, then the set
+    double startTime = TestTime();
+    for (int rep=0;rep<NumReps;rep++)
+        for (unsigned int ii=0;ii<order.size();ii++)
+        {
+            TestIdentRef dumbDraw(new TestIdent(order[ii]));
+            std::set<TestIdentRef,RefSorter>::iterator it = drawSet.find(dumbDraw);
+            if (it != drawSet.end())
+                sum += (*it)->getId();
+        }
+    double setDrawTime = (TestTime() - startTime) / (NumReps*order.size());
+    startTime = TestTime();
+    for (int rep=0;rep<NumReps;rep++)
+        for (unsigned int ii=0;ii<order.size();ii++)
+        {
+            TestIdentRef *draw = drawTable.find(order[ii]);
+            if (draw)
+                tableSum += (*draw)->getId();
+        }
+    double tableDrawTime = (TestTime() - startTime) / (NumReps*order.size());
+    TEST_CHECK(sum == tableSum);
+
+    // Texture per drawable per frame: lock, dummy on the stack, then the set
+    std::vector<SimpleIdentity> texPerDraw;
+    for (int ii=0;ii<NumDrawables;ii++)
+        texPerDraw.push_back(texIds[rand() % texIds.size()]);
+    sum = tableSum = 0;
+    startTime = TestTime();
+    for (int rep=0;rep<NumReps;rep++)
+        for (unsigned int ii=0;ii<texPerDraw.size();ii++)
+        {
+            pthread_mutex_lock(&lock);
+            TestIdent dumbTex(texPerDraw[ii]);
+            std::set<TestIdent *,PtrSorter>::iterator it = texSet.find(&dumbTex);
+            if (it != texSet.end())
+                sum += (*it)->getId();
+            pthread_mutex_unlock(&lock);
+        }
+    double setTexTime = (TestTime() - startTime) / (NumReps*texPerDraw.size());
+    startTime = TestTime();
+    for (int rep=0;rep<NumReps;rep++)
+        for (unsigned int ii=0;ii<texPerDraw.size();ii++)
+        {
+            TestIdent **tex = texTable.find(texPerDraw[ii]);
+            if (tex)
+                tableSum += (*tex)->getId();
+        }
+    double tableTexTime = (TestTime() - startTime) / (NumReps*texPerDraw.size());
+    TEST_CHECK(sum == tableSum);
+
+    printf("  getDrawable, %d drawables: set %.1f ns, table %.1f ns (%.1fx)\n",
+           NumDrawables,setDrawTime*1e9,tableDrawTime*1e9,setDrawTime/tableDrawTime);
+    printf("  texture lookup, %d drawables on %d textures: set and lock %.1f ns, table %.1f ns (%.1fx), %.2f ms -> %.2f ms a frame\n",
+           NumDrawables,(int)texIds.size(),setTexTime*1e9,tableTexTime*1e9,setTexTime/tableTexTime,setTexTime*NumDrawables*1e3,tableTexTime*NumDrawables*1e3);
+
+    for (std::set<TestIdent *,PtrSorter>::iterator it = texSet.begin(); it != texSet.end(); ++it)
+        delete *it;
+    pthread_mutex_destroy(&lock);
+
+    return TestResult("IdentityTableBench");
+}
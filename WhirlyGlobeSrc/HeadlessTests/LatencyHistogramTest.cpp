@@ -0,0 +1,193 @@
+/*
+ *  LatencyHistogramTest.cpp
+ *  HeadlessTests
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+/*  Checks the latency histogram's percentiles against exact ones on a
+    couple hundred thousand values spread over several orders of magnitude,
+    and that splitting the values up and merging gives the same answers as
+    one histogram.  Then has several threads record while snapshots are
+    taken, to make sure nothing gets lost, and checks the scope timer and
+    the snapshot interval.
+  */
+
+#include <math.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include <algorithm>
+#include <vector>
+#include "LatencyHistogram.h"
+#include "TestUtils.h"
+
+using namespace WhirlyKit;
+
+static LatencyMetric TestBuildMetric("Tile build");
+static LatencyMetric TestFrameMetric("Frame");
+
+static const int NumThreads = 8;
+static const int ValuesPerThread = 100000;
+
+// Exact percentile, the way the histogram defines it
+static uint64_t ExactPercentile(std::vector<uint64_t> vals,double percentile)
+{
+    std::sort(vals.begin(),vals.end());
+    size_t which = (size_t)std::max(1.0,ceil(percentile/100.0*vals.size()));
+    return vals[which-1];
+}
+
+class RecordInfo
+{
+public:
+    int seed;
+    int numValues;
+};
+
+// Record a pile of values, with the odd big one, like a layer thread would
+static void *RecordValues(void *data)
+{
+    RecordInfo *info = (RecordInfo *)data;
+    unsigned int seed = info->seed;
+    for (int ii=0;ii<info->numValues;ii++)
+        LatencyMetrics::record(TestBuildMetric,(uint64_t)(rand_r(&seed)%20000) + (ii%1000 == 0 ? 500000 : 0));
+    return NULL;
+}
+
+static void Sleep(long nanos)
+{
+    struct timespec ts;
+    ts.tv_sec = 0;
+    ts.tv_nsec = nanos;
+    nanosleep(&ts,NULL);
+}
+
+int main(int argc,char *argv[])
+{
+    // Mostly spread out exponentially, with some clumped up in the tens of milliseconds
+    LatencyHistogram hist;
+    std::vector<uint64_t> vals;
+    srand(1);
+    for (int ii=0;ii<200000;ii++)
+    {
+        uint64_t val = (uint64_t)exp(rand()/(double)RAND_MAX*12);
+        if (ii % 997 == 0)
+            val = 16000 + rand() % 50000;
+        vals.push_back(val);
+        hist.record(val);
+    }
+    double percentiles[6] = {50,90,95,99,99.9,100};
+    double worstErr = 0.0;
+    for (unsigned int pi=0;pi<6;pi++)
+    {
+        uint64_t exact = ExactPercentile(vals,percentiles[pi]);
+        uint64_t val = hist.valueAtPercentile(percentiles[pi]);
+        double err = exact ? fabs((double)val - exact) / exact : 0.0;
+        worstErr = std::max(worstErr,err);
+        TEST_CHECK(val >= exact);
+    }
+    printf("  worst percentile error on %d values: %.2f%%\n",(int)vals.size(),worstErr*100);
+    TEST_CHECK(worstErr <= 1.0/64 + 1e-9);
+    TEST_CHECK(hist.getMax() == *std::max_element(vals.begin(),vals.end()));
+    TEST_CHECK(hist.getMin() == *std::min_element(vals.begin(),vals.end()));
+    
+    // Small values are exact and big ones get clamped
+    LatencyHistogram small;
+    for (unsigned int ii=0;ii<128;ii++)
+        small.record(ii);
+    TEST_CHECK(small.valueAtPercentile(50) == 63);
+    TEST_CHECK(small.getMax() == 127);
+    LatencyHistogram big;
+    big.record(~0ULL);
+    TEST_CHECK(big.getMax() == LatencyHistogram::MaxValue);
+    
+    // Split up and merged is the same as all at once
+    LatencyHistogram hist1,hist2,histAll;
+    for (unsigned int ii=0;ii<vals.size();ii++)
+    {
+        (ii % 3 ? hist1 : hist2).record(vals[ii]);
+        histAll.record(vals[ii]);
+    }
+    hist1.merge(hist2);
+    for (unsigned int pi=0;pi<6;pi++)
+        TEST_CHECK(hist1.valueAtPercentile(percentiles[pi]) == histAll.valueAtPercentile(percentiles[pi]));
+    TEST_CHECK(hist1.getCount() == histAll.getCount());
+    TEST_CHECK(hist1.getMin() == histAll.getMin() && hist1.getMax() == histAll.getMax());
+    
+    // Threads recording while we take snapshots
+    pthread_t threads[NumThreads];
+    RecordInfo infos[NumThreads];
+    for (int ii=0;ii<NumThreads;ii++)
+    {
+        infos[ii].seed = ii;
+        infos[ii].numValues = ValuesPerThread;
+        pthread_create(&threads[ii],NULL,&RecordValues,&infos[ii]);
+    }
+    for (unsigned int ii=0;ii<20;ii++)
+        LatencyMetrics::snapshot();
+    for (int ii=0;ii<NumThreads;ii++)
+        pthread_join(threads[ii],NULL);
+    LatencyMetrics::snapshot();
+    LatencyHistogram total;
+    TEST_CHECK(LatencyMetrics::getHistogram("Tile build",LatencyMetrics::SinceStart,total));
+    printf("  %d threads recorded %llu values, want %d\n",NumThreads,(unsigned long long)total.getCount(),NumThreads*ValuesPerThread);
+    TEST_CHECK(total.getCount() == (uint64_t)NumThreads*ValuesPerThread);
+    TEST_CHECK(total.getMax() >= 500000);
+    
+    // New threads pick up the histograms the old ones left behind
+    for (int ii=0;ii<NumThreads;ii++)
+    {
+        infos[ii].numValues = 10;
+        pthread_create(&threads[ii],NULL,&RecordValues,&infos[ii]);
+    }
+    for (int ii=0;ii<NumThreads;ii++)
+        pthread_join(threads[ii],NULL);
+    LatencyMetrics::snapshot();
+    LatencyHistogram interval;
+    TEST_CHECK(LatencyMetrics::getHistogram("Tile build",LatencyMetrics::LastInterval,interval));
+    TEST_CHECK(interval.getCount() == NumThreads*10);
+    std::vector<LatencySummary> summaries;
+    LatencyMetrics::getSummaries(LatencyMetrics::SinceStart,summaries);
+    TEST_CHECK(summaries.size() == 1 && summaries[0].count == (uint64_t)NumThreads*(ValuesPerThread+10));
+    
+    // Scoped timing and snapshots on an interval
+    LatencyMetrics::setSnapshotInterval(0.05);
+    LatencyMetrics::reset();
+    TEST_CHECK(!LatencyMetrics::snapshotIfDue());
+    {
+        LatencyScope scope(TestFrameMetric);
+        Sleep(2000000);
+    }
+    Sleep(60000000);
+    TEST_CHECK(LatencyMetrics::snapshotIfDue());
+    LatencyHistogram frame;
+    TEST_CHECK(LatencyMetrics::getHistogram("Frame",LatencyMetrics::LastInterval,frame));
+    TEST_CHECK(frame.getCount() == 1 && frame.getMax() >= 2000);
+    TEST_CHECK(LatencyMetrics::getLastIntervalLength() >= 0.05);
+    
+    // Nothing recorded when it's off
+    LatencyMetrics::setEnabled(false);
+    {
+        LatencyScope scope(TestFrameMetric);
+    }
+    LatencyMetrics::record(TestFrameMetric,100);
+    LatencyMetrics::snapshot();
+    LatencyMetrics::setEnabled(true);
+    TEST_CHECK(!LatencyMetrics::getHistogram("Frame",LatencyMetrics::LastInterval,frame) || frame.getCount() == 0);
+    
+    return TestResult("LatencyHistogramTest");
+}
@@ -0,0 +1,116 @@
+/*
+ *  MeshOptimizerTest.cpp
+ *  HeadlessTests
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+/*  Runs the vertex cache and fetch optimizers over grids like the tile
+    loader builds, with the triangles shuffled.  Checks that the same
+    triangles (with the same winding) come out the other end and that
+    the cache miss ratio gets close to what a well ordered grid gets.
+  */
+
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+#include "MeshOptimizer.h"
+#include "TestUtils.h"
+
+using namespace WhirlyKit;
+
+// A triangle rotated so the smallest index comes first, keeping the winding
+static std::vector<GLuint> CanonicalTris(const std::vector<GLuint> &indices,const std::vector<GLuint> *newToOld)
+{
+    std::vector<GLuint> ret;
+    std::vector<std::vector<GLuint> > tris;
+    for (unsigned int ii=0;ii+2<indices.size();ii+=3)
+    {
+        std::vector<GLuint> tri(3);
+        for (unsigned int jj=0;jj<3;jj++)
+            tri[jj] = newToOld ? (*newToOld)[indices[ii+jj]] : indices[ii+jj];
+        while (tri[0] > tri[1] || tri[0] > tri[2])
+            std::rotate(tri.begin(),tri.begin()+1,tri.end());
+        tris.push_back(tri);
+    }
+    std::sort(tris.begin(),tris.end());
+    for (unsigned int ii=0;ii<tris.size();ii++)
+        ret.insert(ret.end(),tris[ii].begin(),tris[ii].end());
+    return ret;
+}
+
+static void TestGrid(int size)
+{
+    int width = size+1;
+    std::vector<GLuint> grid;
+    for (int iy=0;iy<size;iy++)
+        for (int ix=0;ix<size;ix++)
+        {
+            GLuint a = iy*width+ix, b = a+1, c = a+width, d = c+1;
+            grid.push_back(a);  grid.push_back(b);  grid.push_back(c);
+            grid.push_back(b);  grid.push_back(d);  grid.push_back(c);
+        }
+
+    // Shuffle the triangles
+    std::vector<GLuint> shuffled = grid;
+    int numTris = (int)shuffled.size()/3;
+    for (int ii=numTris-1;ii>0;ii--)
+    {
+        int which = rand() % (ii+1);
+        for (int jj=0;jj<3;jj++)
+            std::swap(shuffled[3*ii+jj],shuffled[3*which+jj]);
+    }
+
+    double startTime = TestTime();
+    std::vector<GLuint> optimized = shuffled;
+    OptimizeVertexCache(optimized,width*width);
+    double cacheTime = TestTime() - startTime;
+    std::vector<GLuint> fetched = optimized;
+    std::vector<GLuint> newToOld;
+    OptimizeVertexFetch(fetched,width*width,newToOld);
+
+    float gridACMR = CalcACMR(grid), shuffledACMR = CalcACMR(shuffled), optACMR = CalcACMR(optimized);
+    printf("  %dx%d grid: ACMR rows %.3f, shuffled %.3f, optimized %.3f in %.2f ms\n",size,size,gridACMR,shuffledACMR,optACMR,cacheTime*1000);
+
+    // Same triangles, same winding
+    TEST_CHECK(CanonicalTris(optimized,NULL) == CanonicalTris(grid,NULL));
+    TEST_CHECK(CanonicalTris(fetched,&newToOld) == CanonicalTris(grid,NULL));
+    // Fetch order doesn't change the cache behavior
+    TEST_CHECK(CalcACMR(fetched) == optACMR);
+    TEST_CHECK(newToOld.size() == (unsigned int)(width*width));
+    // The first triangle uses the first three vertices
+    TEST_CHECK(fetched[0] == 0 && fetched[1] == 1 && fetched[2] == 2);
+    // Better than the shuffle and no worse than rows
+    TEST_CHECK(optACMR < shuffledACMR);
+    if (size > 16)
+        TEST_CHECK(optACMR <= gridACMR);
+}
+
+int main(int argc,char *argv[])
+{
+    srand(1);
+    TestGrid(10);
+    TestGrid(64);
+    TestGrid(256);
+
+    // Degenerate input shouldn't hurt
+    std::vector<GLuint> empty;
+    OptimizeVertexCache(empty,0);
+    TEST_CHECK(empty.empty());
+    TEST_CHECK(CalcACMR(empty) == 0.0);
+
+    return TestResult("MeshOptimizerTest");
+}
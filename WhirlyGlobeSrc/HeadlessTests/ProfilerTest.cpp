@@ -0,0 +1,213 @@
+/*
+ *  ProfilerTest.cpp
+ *  HeadlessTests
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+/*  Captures a Chrome trace from the replay harness running command lists
+    with a worker pool, then reads the JSON back.  Every begin has to have
+    a matching end on the same thread, properly nested, with time going
+    forward.  The render, frame builder and worker threads all need names,
+    and the zones and counters the harness uses need to show up on the
+    threads they ran on.  With the profiler off nothing gets recorded.
+  */
+
+#include <stdio.h>
+#include <string.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "ReplayHarness.h"
+
+static const int NumFrames = 20;
+
+// One event we read back out of the trace
+class TraceEvent
+{
+public:
+    std::string name;
+    char phase;
+    double time;
+    int tid;
+    int value;
+};
+
+// Pull a quoted string out after the given key
+static bool TraceString(const std::string &line,const char *key,std::string &str)
+{
+    size_t pos = line.find(key);
+    if (pos == std::string::npos)
+        return false;
+    pos += strlen(key);
+    size_t end = line.find('"',pos);
+    if (end == std::string::npos)
+        return false;
+    str = line.substr(pos,end-pos);
+    return true;
+}
+
+// Read the events back, one per line, the way exportChromeTrace writes them
+static bool ParseTrace(const std::string &json,std::vector<TraceEvent> &events,std::map<int,std::string> &threadNames)
+{
+    const char *header = "{\"traceEvents\":[\n";
+    const char *footer = "\n],\"displayTimeUnit\":\"ms\"}\n";
+    if (json.compare(0,strlen(header),header) != 0 || json.size() < strlen(footer) ||
+        json.compare(json.size()-strlen(footer),strlen(footer),footer) != 0)
+        return false;
+    
+    size_t pos = strlen(header);
+    size_t end = json.size() - strlen(footer);
+    while (pos < end)
+    {
+        size_t lineEnd = json.find('\n',pos);
+        if (lineEnd == std::string::npos || lineEnd > end)
+            lineEnd = end;
+        std::string line = json.substr(pos,lineEnd-pos);
+        pos = lineEnd+1;
+        if (!line.empty() && line[line.size()-1] == ',')
+            line.erase(line.size()-1);
+        if (line.size() < 2 || line[0] != '{' || line[line.size()-1] != '}')
+            return false;
+        
+        TraceEvent event;
+        std::string phase;
+        if (!TraceString(line,"{\"name\":\"",event.name) || !TraceString(line,"\"ph\":\"",phase) || phase.size() != 1)
+            return false;
+        event.phase = phase[0];
+        size_t tidPos = line.find("\"tid\":");
+        if (tidPos == std::string::npos || sscanf(line.c_str()+tidPos+6,"%d",&event.tid) != 1)
+            return false;
+        if (event.phase == 'M')
+        {
+            std::string threadName;
+            if (!TraceString(line,"\"args\":{\"name\":\"",threadName))
+                return false;
+            threadNames[event.tid] = threadName;
+            continue;
+        }
+        size_t tsPos = line.find("\"ts\":");
+        if (tsPos == std::string::npos || sscanf(line.c_str()+tsPos+5,"%lf",&event.time) != 1)
+            return false;
+        event.value = 0;
+        if (event.phase == 'C')
+        {
+            size_t valuePos = line.find("\"value\":");
+            if (valuePos == std::string::npos || sscanf(line.c_str()+valuePos+8,"%d",&event.value) != 1)
+                return false;
+        }
+        events.push_back(event);
+    }
+    
+    return true;
+}
+
+int main(int argc,char *argv[])
+{
+    ReplayHarness harness(4000,3);
+    harness.cullWork = 40;
+    Profiler::setThreadName("Render");
+    
+    // Off, nothing but thread names
+    Profiler::clear();
+    double waitTime;
+    harness.runCommandLists(2,waitTime);
+    std::string json;
+    Profiler::exportChromeTrace(json);
+    std::vector<TraceEvent> events;
+    std::map<int,std::string> threadNames;
+    TEST_CHECK(ParseTrace(json,events,threadNames));
+    TEST_CHECK(events.empty());
+    
+    // On, for a run of frames
+    Profiler::setEnabled(true);
+    harness.runCommandLists(NumFrames,waitTime);
+    Profiler::setEnabled(false);
+    TEST_CHECK(Profiler::writeChromeTrace("build/ProfilerTest.json"));
+    Profiler::exportChromeTrace(json);
+    events.clear();
+    threadNames.clear();
+    bool parsed = ParseTrace(json,events,threadNames);
+    TEST_CHECK(parsed);
+    
+    // Begins and ends pair up on each thread and time doesn't go backwards
+    std::map<int,std::vector<std::string> > stacks;
+    std::map<int,double> lastTime;
+    std::map<std::string,std::set<std::string> > zoneThreads;
+    int maxDepth = 0, numReplayCounts = 0;
+    bool nested = true, inOrder = true, named = true;
+    for (unsigned int ii=0;ii<events.size();ii++)
+    {
+        const TraceEvent &event = events[ii];
+        if (lastTime.find(event.tid) != lastTime.end() && event.time < lastTime[event.tid])
+            inOrder = false;
+        lastTime[event.tid] = event.time;
+        if (threadNames.find(event.tid) == threadNames.end())
+            named = false;
+        std::string threadName = threadNames[event.tid];
+        // Worker threads are numbered
+        if (threadName.compare(0,7,"Worker ") == 0)
+            threadName = "Worker";
+        zoneThreads[event.name].insert(threadName);
+        
+        std::vector<std::string> &stack = stacks[event.tid];
+        switch (event.phase)
+        {
+            case 'B':
+                stack.push_back(event.name);
+                maxDepth = std::max(maxDepth,(int)stack.size());
+                break;
+            case 'E':
+                if (stack.empty() || stack.back() != event.name)
+                    nested = false;
+                else
+                    stack.pop_back();
+                break;
+            case 'C':
+                if (event.name == "Commands replayed" && event.value == harness.cmdList.getNumCommands())
+                    numReplayCounts++;
+                break;
+            default:
+                nested = false;
+                break;
+        }
+    }
+    for (std::map<int,std::vector<std::string> >::iterator it = stacks.begin(); it != stacks.end(); ++it)
+        if (!it->second.empty())
+            nested = false;
+    
+    std::set<std::string> names;
+    for (std::map<int,std::string>::iterator it = threadNames.begin(); it != threadNames.end(); ++it)
+        names.insert(it->second.compare(0,7,"Worker ") == 0 ? "Worker" : it->second);
+    printf("  %d frames: %d events on %d threads, %d bytes of JSON, nested %d deep\n",
+           NumFrames,(int)events.size(),(int)threadNames.size(),(int)json.size(),maxDepth);
+    
+    TEST_CHECK(events.size() > (size_t)NumFrames*10);
+    TEST_CHECK(nested);
+    TEST_CHECK(inOrder);
+    TEST_CHECK(named);
+    TEST_CHECK(maxDepth >= 3);
+    TEST_CHECK(names.count("Render") && names.count("Frame Builder") && names.count("Worker"));
+    TEST_CHECK(zoneThreads["Render Frame"].count("Render") == 1);
+    TEST_CHECK(zoneThreads["Replay Command List"].count("Render") == 1);
+    TEST_CHECK(zoneThreads["Build Frame"].count("Frame Builder") == 1);
+    TEST_CHECK(zoneThreads["Build Frame"].count("Render") == 0);
+    TEST_CHECK(zoneThreads["Cull piece"].count("Worker") == 1);
+    TEST_CHECK(numReplayCounts == NumFrames);
+    
+    return TestResult("ProfilerTest");
+}
@@ -0,0 +1,188 @@
+/*
+ *  RectPackerBench.cpp
+ *  HeadlessTests
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+/*  Fills a dynamic texture's cell grid to 85% with glyph and tile sized
+    regions, then churns it with removes and inserts.  Compares RectPacker
+    with the cell by cell scan DynamicTexture::findRegion used to do, and
+    checks that RectPacker never hands out overlapping space.
+  */
+
+#include <stdlib.h>
+#include <vector>
+#include "RectPacker.h"
+#include "TestUtils.h"
+
+using namespace WhirlyKit;
+
+static const float TargetOccupancy = 0.85;
+static const int NumChurnOps = 100000;
+
+// The old layout grid search: scan every cell for a free rectangle
+class GridScan
+{
+public:
+    GridScan(int size) : size(size), cells(size*size,false) { }
+
+    bool findSpot(int width,int height,RectPacker::Rect &rect)
+    {
+        for (int iy=0;iy<=size-height;iy++)
+            for (int ix=0;ix<=size-width;ix++)
+            {
+                bool clear = true;
+                for (int ty=0;ty<height && clear;ty++)
+                    for (int tx=0;tx<width && clear;tx++)
+                        if (cells[(iy+ty)*size+ix+tx])
+                            clear = false;
+                if (clear)
+                {
+                    rect = RectPacker::Rect(ix,iy,width,height);
+                    return true;
+                }
+            }
+        return false;
+    }
+
+    void set(const RectPacker::Rect &rect,bool used)
+    {
+        for (int iy=rect.y;iy<rect.y+rect.height;iy++)
+            for (int ix=rect.x;ix<rect.x+rect.width;ix++)
+                cells[iy*size+ix] = used;
+    }
+
+    // True if any of the cells are taken
+    bool anySet(const RectPacker::Rect &rect) const
+    {
+        for (int iy=rect.y;iy<rect.y+rect.height;iy++)
+            for (int ix=rect.x;ix<rect.x+rect.width;ix++)
+                if (cells[iy*size+ix])
+                    return true;
+        return false;
+    }
+
+    int size;
+    std::vector<bool> cells;
+};
+
+// 95% glyph sized (1-3 by 1-2 cells), 5% tile sized (8-16 cells square)
+static void RegionSize(int &width,int &height)
+{
+    if (rand() % 100 < 95)
+    {
+        width = 1 + rand() % 3;
+        height = 1 + rand() % 2;
+    } else
+        width = height = 8 + rand() % 9;
+}
+
+class PackRun
+{
+public:
+    PackRun(int size,bool useMaxRects) : size(size), useMaxRects(useMaxRects), packer(size,size), grid(size), used(0), fails(0), inserts(0) { }
+
+    void insert()
+    {
+        int width,height;
+        RegionSize(width,height);
+        RectPacker::Rect rect;
+        inserts++;
+        bool found = useMaxRects ? packer.findSpot(width,height,rect) : grid.findSpot(width,height,rect);
+        if (!found)
+        {
+            fails++;
+            return;
+        }
+        if (useMaxRects)
+        {
+            // The grid is just for checking
+            TEST_CHECK(rect.x >= 0 && rect.y >= 0 && rect.x+width <= size && rect.y+height <= size);
+            TEST_CHECK(!grid.anySet(rect));
+            packer.reserve(rect);
+        }
+        grid.set(rect,true);
+        live.push_back(rect);
+        used += width*height;
+    }
+
+    void remove()
+    {
+        int which = rand() % live.size();
+        RectPacker::Rect rect = live[which];
+        live[which] = live.back();
+        live.pop_back();
+        used -= rect.width*rect.height;
+        grid.set(rect,false);
+        if (useMaxRects)
+            packer.release(rect);
+    }
+
+    void run()
+    {
+        srand(7);
+        double startTime = TestTime();
+        while (used < size*size*TargetOccupancy && fails < 50)
+            insert();
+        double fillTime = TestTime() - startTime;
+        int fillInserts = inserts;
+        fails = 0;  inserts = 0;
+
+        startTime = TestTime();
+        for (int ii=0;ii<NumChurnOps;ii++)
+        {
+            if (used > size*size*TargetOccupancy)
+                remove();
+            else
+                insert();
+        }
+        double churnTime = TestTime() - startTime;
+
+        printf("  %3d cells %-9s fill %7.2f us/insert, churn %7.2f us/op, %d/%d inserts failed, occupancy %.1f%%",
+               size,useMaxRects ? "maxrects" : "grid scan",fillTime*1e6/fillInserts,churnTime*1e6/NumChurnOps,fails,inserts,100.0*used/(size*size));
+        if (useMaxRects)
+        {
+            RectPackerStats stats;
+            packer.getStats(stats);
+            printf(", %d free rects, fragmentation %.2f",stats.numFreeRects,stats.fragmentation());
+            TEST_CHECK(stats.usedArea == used);
+            TEST_CHECK(stats.numRects == (int)live.size());
+        }
+        printf("\n");
+        fflush(stdout);
+    }
+
+    int size;
+    bool useMaxRects;
+    RectPacker packer;
+    GridScan grid;
+    std::vector<RectPacker::Rect> live;
+    int used,fails,inserts;
+};
+
+int main(int argc,char *argv[])
+{
+    int sizes[3] = {64,128,256};
+    for (unsigned int si=0;si<3;si++)
+        for (int which=0;which<2;which++)
+        {
+            PackRun packRun(sizes[si],which == 1);
+            packRun.run();
+        }
+
+    return TestResult("RectPackerBench");
+}
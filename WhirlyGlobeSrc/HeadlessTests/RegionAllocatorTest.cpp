@@ -0,0 +1,248 @@
+/*
+ *  RegionAllocatorTest.cpp
+ *  HeadlessTests
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+/*  Churns the region allocator with tile sized allocations the way a
+    DynamicDrawableAtlas sees them as the user pans around.  Checks that
+    regions never overlap, the stats and high water mark stay right, and
+    that compacting with moveDown() gathers the free space in one block.
+    Also compares fragmentation against the first fit search BigDrawable
+    used before.
+  */
+
+#include <stdlib.h>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <vector>
+#include "RegionAllocator.h"
+#include "TestUtils.h"
+
+using namespace WhirlyKit;
+
+static const unsigned int TotalSize = 1<<20;
+static const int NumOps = 1000000;
+static const unsigned int MinLive = 1800;
+
+// Size of a tile drawable in vertices: a 10x10 to 20x20 grid, maybe with skirts
+static unsigned int TileSize()
+{
+    unsigned int side = 11 + rand() % 10;
+    return side*side + (rand() % 2) * 4*side;
+}
+
+// A live region: handle (or offset, for first fit) and size
+typedef std::pair<int,unsigned int> LiveRegion;
+
+// The free list search BigDrawable used before
+class FirstFit
+{
+public:
+    FirstFit(unsigned int size) { free[0] = size; }
+
+    int allocate(unsigned int size)
+    {
+        for (std::map<unsigned int,unsigned int>::iterator it = free.begin(); it != free.end(); ++it)
+            if (it->second >= size)
+            {
+                unsigned int offset = it->first, blockSize = it->second;
+                free.erase(it);
+                if (blockSize > size)
+                    free[offset+size] = blockSize-size;
+                return offset;
+            }
+        return -1;
+    }
+
+    void release(unsigned int offset,unsigned int size)
+    {
+        std::map<unsigned int,unsigned int>::iterator next = free.lower_bound(offset);
+        if (next != free.end() && offset+size == next->first)
+        {
+            size += next->second;
+            free.erase(next);
+        }
+        next = free.lower_bound(offset);
+        if (next != free.begin())
+        {
+            std::map<unsigned int,unsigned int>::iterator prev = next;
+            --prev;
+            if (prev->first + prev->second == offset)
+            {
+                offset = prev->first;
+                size += prev->second;
+                free.erase(prev);
+            }
+        }
+        free[offset] = size;
+    }
+
+    float fragmentation() const
+    {
+        unsigned int freeSize = 0, largest = 0;
+        for (std::map<unsigned int,unsigned int>::const_iterator it = free.begin(); it != free.end(); ++it)
+        {
+            freeSize += it->second;
+            largest = std::max(largest,it->second);
+        }
+        return freeSize ? 1.0 - (float)largest / freeSize : 0.0;
+    }
+
+    std::map<unsigned int,unsigned int> free;
+};
+
+// Check the live regions don't overlap and the high water mark is right
+static bool CheckRegions(const RegionAllocator &alloc,const std::vector<LiveRegion> &live)
+{
+    std::vector<std::pair<unsigned int,unsigned int> > spans;
+    unsigned int highWater = 0;
+    for (unsigned int ii=0;ii<live.size();ii++)
+    {
+        unsigned int offset = alloc.getOffset(live[ii].first), size = alloc.getSize(live[ii].first);
+        if (size != live[ii].second || offset + size > TotalSize)
+            return false;
+        spans.push_back(std::make_pair(offset,size));
+        highWater = std::max(highWater,offset+size);
+    }
+    std::sort(spans.begin(),spans.end());
+    for (unsigned int ii=1;ii<spans.size();ii++)
+        if (spans[ii-1].first + spans[ii-1].second > spans[ii].first)
+            return false;
+
+    return highWater == alloc.getHighWater();
+}
+
+static void TestChurn()
+{
+    RegionAllocator alloc(TotalSize);
+    std::vector<LiveRegion> live;
+    srand(7);
+    int fails = 0;
+    unsigned int liveSize = 0;
+    double startTime = TestTime();
+    for (int ii=0;ii<NumOps;ii++)
+    {
+        if (live.size() < MinLive || rand() % 2)
+        {
+            unsigned int size = TileSize();
+            int handle = alloc.allocate(size);
+            if (handle < 0)
+            {
+                fails++;
+                continue;
+            }
+            live.push_back(LiveRegion(handle,size));
+            liveSize += size;
+        } else {
+            int which = rand() % live.size();
+            alloc.free(live[which].first);
+            liveSize -= live[which].second;
+            live[which] = live.back();
+            live.pop_back();
+        }
+        // Every so often check everything, which is slow
+        if (ii % 100000 == 0)
+            TEST_CHECK(CheckRegions(alloc,live));
+    }
+    double churnTime = TestTime() - startTime;
+    TEST_CHECK(CheckRegions(alloc,live));
+
+    RegionAllocatorStats stats;
+    alloc.getStats(stats);
+    TEST_CHECK(stats.usedSize == liveSize);
+    TEST_CHECK(stats.numRegions == live.size());
+    printf("  TLSF:      %.1f ns/op, %d live regions, %u free blocks, fragmentation %.3f, %d failed\n",
+           churnTime*1e9/NumOps,(int)live.size(),stats.numFreeBlocks,stats.fragmentation(),fails);
+
+    // Slide everything down, lowest first, and the free space should all be at the end
+    std::map<unsigned int,int> byOffset;
+    for (unsigned int ii=0;ii<live.size();ii++)
+        byOffset[alloc.getOffset(live[ii].first)] = ii;
+    int numMoved = 0;
+    for (std::map<unsigned int,int>::iterator it = byOffset.begin(); it != byOffset.end(); ++it)
+        if (alloc.moveDown(live[it->second].first))
+            numMoved++;
+    TEST_CHECK(CheckRegions(alloc,live));
+    alloc.getStats(stats);
+    printf("  compacted: moved %d regions, %u free blocks, fragmentation %.3f\n",numMoved,stats.numFreeBlocks,stats.fragmentation());
+    TEST_CHECK(stats.numFreeBlocks == 1);
+    TEST_CHECK(alloc.getHighWater() == liveSize);
+
+    // Free everything and we're back to one block
+    for (unsigned int ii=0;ii<live.size();ii++)
+        alloc.free(live[ii].first);
+    alloc.getStats(stats);
+    TEST_CHECK(stats.usedSize == 0 && stats.numRegions == 0 && stats.numFreeBlocks == 1);
+    TEST_CHECK(alloc.getHighWater() == 0);
+}
+
+// Same churn against the first fit search for comparison
+static void TestFirstFit()
+{
+    FirstFit alloc(TotalSize);
+    std::vector<LiveRegion> live;
+    srand(7);
+    double startTime = TestTime();
+    for (int ii=0;ii<NumOps;ii++)
+    {
+        if (live.size() < MinLive || rand() % 2)
+        {
+            unsigned int size = TileSize();
+            int offset = alloc.allocate(size);
+            if (offset >= 0)
+                live.push_back(LiveRegion(offset,size));
+        } else {
+            int which = rand() % live.size();
+            alloc.release(live[which].first,live[which].second);
+            live[which] = live.back();
+            live.pop_back();
+        }
+    }
+    double churnTime = TestTime() - startTime;
+    printf("  first fit: %.1f ns/op, %d live regions, %d free blocks, fragmentation %.3f\n",
+           churnTime*1e9/NumOps,(int)live.size(),(int)alloc.free.size(),alloc.fragmentation());
+}
+
+// Bad handles shouldn't hurt anything
+static void TestBadHandles()
+{
+    RegionAllocator alloc(1000);
+    int handle = alloc.allocate(100);
+    TEST_CHECK(handle >= 0);
+    alloc.free(-1);
+    alloc.free(1000);
+    TEST_CHECK(!alloc.moveDown(-1));
+    TEST_CHECK(!alloc.moveDown(1000));
+    TEST_CHECK(alloc.allocate(2000) < 0);
+    alloc.free(handle);
+    // Twice is fine too
+    alloc.free(handle);
+    RegionAllocatorStats stats;
+    alloc.getStats(stats);
+    TEST_CHECK(stats.usedSize == 0 && stats.numFreeBlocks == 1);
+}
+
+int main(int argc,char *argv[])
+{
+    TestChurn();
+    TestFirstFit();
+    TestBadHandles();
+
+    return TestResult("RegionAllocatorTest");
+}
@@ -0,0 +1,252 @@
+/*
+ *  ReplayHarness.h
+ *  HeadlessTests
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <algorithm>
+#include <vector>
+#include "RecordingGLBackend.h"
+#include "GLCommandList.h"
+#include "WorkerPool.h"
+#include "Profiler.h"
+#include "TestUtils.h"
+
+/** A stand-in for a SceneRendererES2 frame, with no GL underneath.
+    Culling is split over a worker pool and then the draw loop binds a program,
+    sets uniforms, binds a texture and draws, for a few thousand drawables.
+    The frame can be drawn straight into a RecordingGLBackend on the render
+    thread, or recorded into a GLCommandList on a frame builder thread while
+    the render thread replays the last one, which is what buildCommandLists does.
+    The cull work is a busy loop per drawable, so you can dial in a scene
+    that's as expensive as you like.  Used by CommandListBench and ProfilerTest.
+  */
+
+using namespace WhirlyKit;
+
+static ProfileZone ReplayRenderZone("Render Frame");
+static ProfileZone ReplayBuildZone("Build Frame");
+static ProfileZone ReplayCullZone("Culling");
+static ProfileZone ReplayCullPieceZone("Cull piece");
+static ProfileZone ReplayDrawZone("Draw Execution");
+static ProfileZone ReplayReplayZone("Replay Command List");
+static ProfileZone ReplayCommandsCount("Commands replayed");
+
+// Where the answers go so the cull loops aren't optimized out
+static volatile float ReplaySink;
+
+/// One thing to draw
+class ReplayObject
+{
+public:
+    float x,y,rad;
+    GLuint vertArray,texId;
+    int program;
+    unsigned short tris[6];
+};
+
+class ReplayHarness;
+
+// Culls a hundred objects per piece on the worker pool
+class ReplayCullTask : public WorkerTask
+{
+public:
+    ReplayCullTask(ReplayHarness *harness) : harness(harness) { }
+    void runPiece(int which,int thread);
+    
+    ReplayHarness *harness;
+};
+
+class ReplayHarness
+{
+public:
+    /// Set up the scene on the recording backend, which becomes the global one
+    ReplayHarness(int numDraws,int numWorkers)
+    : cullWork(0), builderFrame(0), numNames(1)
+    {
+        pool = new WorkerPool(numWorkers);
+        SetGLBackend(&backend);
+        GLBackend *gl = GetGLBackend();
+        for (unsigned int ii=0;ii<2;ii++)
+            programs.push_back(gl->createProgram());
+        objects.resize(numDraws);
+        for (int ii=0;ii<numDraws;ii++)
+        {
+            ReplayObject &obj = objects[ii];
+            obj.x = ii*0.1;
+            obj.y = ii*0.3;
+            obj.rad = 1 + ii%7;
+            gl->genVertexArrays(1,&obj.vertArray);
+            gl->genTextures(1,&obj.texId);
+            obj.program = ii%2;
+            for (unsigned int ti=0;ti<6;ti++)
+                obj.tris[ti] = ti;
+        }
+    }
+    
+    ~ReplayHarness()
+    {
+        SetGLBackend(NULL);
+        delete pool;
+    }
+    
+    /// Cull, sort and draw one frame into whatever backend this thread has
+    void drawScene(int frame)
+    {
+        ProfileScope buildScope(ReplayBuildZone);
+        GLBackend *gl = GetGLBackend();
+        {
+            ProfileScope cullScope(ReplayCullZone);
+            ReplayCullTask task(this);
+            pool->run(&task,((int)objects.size()+99)/100);
+        }
+        
+        Profiler::begin(ReplayDrawZone);
+        gl->clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        std::vector<int> drawList;
+        float rotCos = cosf(frame*0.01), rotSin = sinf(frame*0.01);
+        for (unsigned int ii=0;ii<objects.size();ii++)
+        {
+            const ReplayObject &obj = objects[ii];
+            float dist = 0.0;
+            for (int wi=0;wi<cullWork;wi++)
+                dist += fabsf(obj.x*rotCos - obj.y*rotSin + wi*0.001) * obj.rad;
+            if (dist > -1.0)
+                drawList.push_back(ii);
+            ReplaySink = dist;
+        }
+        std::sort(drawList.begin(),drawList.end());
+        
+        // A drawable that makes and tosses a vertex array, like a first time setup
+        GLuint tmpArray;
+        gl->genVertexArrays(1,&tmpArray);
+        gl->bindVertexArray(tmpArray);
+        gl->bindVertexArray(0);
+        gl->deleteVertexArrays(1,&tmpArray);
+        
+        float mvpMat[16] = {1,0,0,0, 0,1,0,0, 0,0,1,0, 0,0,0,1};
+        for (unsigned int ii=0;ii<drawList.size();ii++)
+        {
+            const ReplayObject &obj = objects[drawList[ii]];
+            gl->useProgram(programs[obj.program]);
+            mvpMat[12] = obj.x;
+            gl->uniformMatrix4fv(0,1,GL_FALSE,mvpMat);
+            gl->uniform1f(1,obj.rad);
+            gl->activeTexture(GL_TEXTURE0);
+            gl->bindTexture(GL_TEXTURE_2D,obj.texId);
+            gl->uniform1i(2,0);
+            gl->bindVertexArray(obj.vertArray);
+            gl->drawElements(GL_TRIANGLES,600,GL_UNSIGNED_SHORT,0);
+            gl->bindVertexArray(0);
+            // Client side indices now and then, which the list has to copy
+            if (ii % 100 == 0)
+                gl->drawElements(GL_TRIANGLES,6,GL_UNSIGNED_SHORT,obj.tris);
+        }
+        Profiler::end(ReplayDrawZone);
+    }
+    
+    /// Draw frames on the render thread.  Returns the time a frame.
+    double runImmediate(int numFrames)
+    {
+        backend.reset();
+        double startTime = TestTime();
+        for (int frame=0;frame<numFrames;frame++)
+        {
+            ProfileScope frameScope(ReplayRenderZone);
+            drawScene(frame);
+        }
+        
+        return (TestTime() - startTime) / numFrames;
+    }
+    
+    /// Build each frame on another thread while the render thread replays the
+    ///  one before.  Returns the render thread's time a frame, not counting
+    ///  waiting on the builder, which is returned in waitTime.
+    double runCommandLists(int numFrames,double &waitTime)
+    {
+        backend.reset();
+        double renderTime = 0.0;
+        waitTime = 0.0;
+        pthread_t builderThread;
+        bool pending = false;
+        for (int frame=0;frame<=numFrames;frame++)
+        {
+            double startTime = TestTime();
+            ProfileScope frameScope(ReplayRenderZone);
+            if (pending)
+            {
+                ProfileScope replayScope(ReplayReplayZone);
+                double waitStart = TestTime();
+                pthread_join(builderThread,NULL);
+                waitTime += TestTime() - waitStart;
+                cmdList.replay(&backend);
+                Profiler::count(ReplayCommandsCount,cmdList.getNumCommands());
+                pending = false;
+                if (cmdList.ranOutOfNames())
+                    numNames *= 2;
+            }
+            if (frame < numFrames)
+            {
+                cmdList.clear();
+                cmdList.reserveNames(&backend,numNames);
+                builderFrame = frame;
+                pthread_create(&builderThread,NULL,&ReplayHarness::builderMain,this);
+                pending = true;
+            }
+            renderTime += TestTime() - startTime;
+        }
+        waitTime /= numFrames;
+        
+        return renderTime / numFrames - waitTime;
+    }
+    
+    /// Busy work per drawable when culling
+    int cullWork;
+    
+    RecordingGLBackend backend;
+    GLCommandList cmdList;
+    WorkerPool *pool;
+    std::vector<GLuint> programs;
+    std::vector<ReplayObject> objects;
+    
+protected:
+    static void *builderMain(void *data)
+    {
+        ReplayHarness *harness = (ReplayHarness *)data;
+        Profiler::setThreadName("Frame Builder");
+        SetThreadGLBackend(&harness->cmdList);
+        harness->drawScene(harness->builderFrame);
+        SetThreadGLBackend(NULL);
+        return NULL;
+    }
+    
+    int builderFrame;
+    int numNames;
+};
+
+inline void ReplayCullTask::runPiece(int which,int thread)
+{
+    ProfileScope pieceScope(ReplayCullPieceZone);
+    float total = 0.0;
+    int end = std::min((which+1)*100,(int)harness->objects.size());
+    for (int ii=which*100;ii<end;ii++)
+        for (unsigned int wi=0;wi<20;wi++)
+            total += harness->objects[ii].x*wi;
+    ReplaySink = total;
+}
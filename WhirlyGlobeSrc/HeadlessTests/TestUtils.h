@@ -0,0 +1,51 @@
+/*
+ *  TestUtils.h
+ *  HeadlessTests
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#include <stdio.h>
+#include <sys/time.h>
+
+/** A few things the headless tests and benchmarks share.
+    Tests count their failures with TEST_CHECK and return TestResult() from main,
+    so runtests.sh can tell if they passed.
+  */
+
+static int TestFailures = 0;
+
+/// Note a failure, with where it happened, if the condition isn't true
+#define TEST_CHECK(cond) \
+    do { if (!(cond)) { printf("FAILED %s:%d: %s\n",__FILE__,__LINE__,#cond); TestFailures++; } } while (0)
+
+/// Wall clock time in seconds, for benchmarks
+static inline double TestTime()
+{
+    struct timeval tv;
+    gettimeofday(&tv,NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/// Print a pass/fail line and return what main should
+static inline int TestResult(const char *name)
+{
+    if (TestFailures)
+        printf("%s: %d check(s) failed\n",name,TestFailures);
+    else
+        printf("%s: passed\n",name);
+    return TestFailures ? 1 : 0;
+}
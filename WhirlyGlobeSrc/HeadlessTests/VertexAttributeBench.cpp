@@ -0,0 +1,156 @@
+/*
+ *  VertexAttributeBench.cpp
+ *  HeadlessTests
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+/*  Builds a 65k vertex drawable's worth of data the two ways BasicDrawable can:
+    one vertex at a time through the VertexAttribute convenience calls, copying
+    each vertex into the interleaved buffer through addressForElement() the way
+    addPointToBuffer used to, or in spans through addValues() and interleave().
+    Checks that both produce the same buffer and reports how long each took.
+  */
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "VertexAttribute.h"
+#include "TestUtils.h"
+
+using namespace Eigen;
+using namespace WhirlyKit;
+
+static const int NumVerts = 65535;
+static const int NumRuns = 50;
+
+// What a BasicDrawable holds for a textured, lit, colored mesh
+class DrawableData
+{
+public:
+    DrawableData()
+        : texCoords(BDFloat2Type,"a_texCoord"), normals(BDFloat3Type,"a_normal"), colors(BDChar4Type,"a_color")
+    {
+        attrs.push_back(&texCoords);
+        attrs.push_back(&normals);
+        attrs.push_back(&colors);
+        // Same layout setupGL works out: points first, then each attribute
+        vertexSize = 3*sizeof(GLfloat);
+        for (unsigned int ii=0;ii<attrs.size();ii++)
+        {
+            attrs[ii]->buffer = vertexSize;
+            vertexSize += attrs[ii]->size();
+        }
+    }
+    
+    void clear()
+    {
+        points.clear();
+        for (unsigned int ii=0;ii<attrs.size();ii++)
+            attrs[ii]->clear();
+    }
+    
+    std::vector<Vector3f> points;
+    VertexAttribute texCoords,normals,colors;
+    std::vector<VertexAttribute *> attrs;
+    int vertexSize;
+};
+
+// Source data, as a shape builder would have it
+static std::vector<Vector3f> srcPts,srcNorms;
+static std::vector<Vector2f> srcTex;
+static std::vector<RGBAColor> srcColors;
+
+// One vertex at a time, the way things worked before the typed storage
+static void BuildPerVertex(DrawableData &draw,std::vector<unsigned char> &buf)
+{
+    draw.clear();
+    // BasicDrawable reserves up front when it's told how big it'll be
+    draw.points.reserve(NumVerts);
+    for (unsigned int ii=0;ii<draw.attrs.size();ii++)
+        draw.attrs[ii]->reserve(NumVerts);
+    for (int ii=0;ii<NumVerts;ii++)
+    {
+        draw.points.push_back(srcPts[ii]);
+        draw.texCoords.addVector2f(srcTex[ii]);
+        draw.normals.addVector3f(srcNorms[ii]);
+        draw.colors.addColor(srcColors[ii]);
+    }
+    
+    buf.resize(NumVerts*draw.vertexSize);
+    unsigned char *basePtr = &buf[0];
+    for (int ii=0;ii<NumVerts;ii++,basePtr+=draw.vertexSize)
+    {
+        memcpy(basePtr, &draw.points[ii].x(), 3*sizeof(GLfloat));
+        for (unsigned int ai=0;ai<draw.attrs.size();ai++)
+        {
+            VertexAttribute *attr = draw.attrs[ai];
+            memcpy(basePtr+attr->buffer, attr->addressForElement(ii), attr->size());
+        }
+    }
+}
+
+// Whole spans at once, then one pass per attribute
+static void BuildSpans(DrawableData &draw,std::vector<unsigned char> &buf)
+{
+    draw.clear();
+    draw.points.insert(draw.points.end(),srcPts.begin(),srcPts.end());
+    draw.texCoords.addValues(&srcTex[0],NumVerts);
+    draw.normals.addValues(&srcNorms[0],NumVerts);
+    draw.colors.addValues(&srcColors[0],NumVerts);
+    
+    buf.resize(NumVerts*draw.vertexSize);
+    unsigned char *ptPtr = &buf[0];
+    for (int ii=0;ii<NumVerts;ii++,ptPtr+=draw.vertexSize)
+        memcpy(ptPtr, &draw.points[ii].x(), 3*sizeof(GLfloat));
+    for (unsigned int ai=0;ai<draw.attrs.size();ai++)
+        draw.attrs[ai]->interleave(&buf[0], draw.vertexSize, 0, NumVerts);
+}
+
+int main(int argc,char **argv)
+{
+    srand(1);
+    for (int ii=0;ii<NumVerts;ii++)
+    {
+        srcPts.push_back(Vector3f(drand48(),drand48(),drand48()));
+        srcNorms.push_back(Vector3f(drand48(),drand48(),drand48()).normalized());
+        srcTex.push_back(Vector2f(drand48(),drand48()));
+        srcColors.push_back(RGBAColor(rand()%256,rand()%256,rand()%256,255));
+    }
+    
+    DrawableData perVertexDraw,spanDraw;
+    std::vector<unsigned char> perVertexBuf,spanBuf;
+    BuildPerVertex(perVertexDraw,perVertexBuf);
+    BuildSpans(spanDraw,spanBuf);
+    TEST_CHECK(perVertexBuf.size() == spanBuf.size());
+    TEST_CHECK(!memcmp(&perVertexBuf[0], &spanBuf[0], spanBuf.size()));
+    
+    double t0 = TestTime();
+    for (int ii=0;ii<NumRuns;ii++)
+        BuildPerVertex(perVertexDraw,perVertexBuf);
+    double perVertex = (TestTime()-t0)/NumRuns;
+    
+    t0 = TestTime();
+    for (int ii=0;ii<NumRuns;ii++)
+        BuildSpans(spanDraw,spanBuf);
+    double spans = (TestTime()-t0)/NumRuns;
+    
+    printf("%d vertices, %d bytes each\n",NumVerts,spanDraw.vertexSize);
+    printf("  per vertex: %.3f ms\n",perVertex*1e3);
+    printf("  spans:      %.3f ms (%.1fx)\n",spans*1e3,perVertex/spans);
+    
+    return TestResult("VertexAttributeBench");
+}
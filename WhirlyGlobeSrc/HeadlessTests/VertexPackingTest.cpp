@@ -0,0 +1,236 @@
+/*
+ *  VertexPackingTest.cpp
+ *  HeadlessTests
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+/*  Round trips random values through the compact vertex formats and checks
+    the error against what we can live with on the globe.  Then packs a vertex
+    through VertexAttribute::interleave() to make sure the buffer holds what the
+    helpers produce, and prints the per vertex sizes for the layouts we use.
+  */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "VertexAttribute.h"
+#include "VertexPacking.h"
+#include "TestUtils.h"
+
+using namespace Eigen;
+using namespace WhirlyKit;
+
+static const int NumSamples = 100000;
+
+static float RandRange(float minVal,float maxVal)
+{
+    return minVal + (maxVal-minVal) * (rand() / (float)RAND_MAX);
+}
+
+static void TestHalfFloat()
+{
+    float maxRelErr = 0.0;
+    for (int ii=0;ii<NumSamples;ii++)
+    {
+        float val = RandRange(-4.0,4.0);
+        float err = fabsf(HalfToFloat(FloatToHalf(val)) - val) / std::max(fabsf(val),1e-3f);
+        maxRelErr = std::max(maxRelErr,err);
+    }
+    printf("  half float:       max relative error %g\n",maxRelErr);
+    // 10 bits of mantissa, rounded
+    TEST_CHECK(maxRelErr < 1.0/1024);
+    TEST_CHECK(HalfToFloat(FloatToHalf(1.0)) == 1.0);
+    TEST_CHECK(HalfToFloat(FloatToHalf(0.5)) == 0.5);
+    TEST_CHECK(HalfToFloat(FloatToHalf(0.0)) == 0.0);
+}
+
+static void TestNormShorts()
+{
+    float maxErr = 0.0, maxUErr = 0.0;
+    for (int ii=0;ii<NumSamples;ii++)
+    {
+        float val = RandRange(-1.0,1.0);
+        maxErr = std::max(maxErr,fabsf(UnpackNormShort(PackNormShort(val)) - val));
+        float uval = RandRange(0.0,1.0);
+        maxUErr = std::max(maxUErr,fabsf(UnpackNormUShort(PackNormUShort(uval)) - uval));
+    }
+    printf("  norm short:       max error %g\n",maxErr);
+    printf("  norm ushort:      max error %g\n",maxUErr);
+    TEST_CHECK(maxErr <= 0.5/32767 + 1e-7);
+    TEST_CHECK(maxUErr <= 0.5/65535 + 1e-7);
+    // Ends of the range come back exactly
+    TEST_CHECK(UnpackNormShort(PackNormShort(1.0)) == 1.0);
+    TEST_CHECK(UnpackNormShort(PackNormShort(-1.0)) == -1.0);
+    TEST_CHECK(UnpackNormUShort(PackNormUShort(1.0)) == 1.0);
+    TEST_CHECK(UnpackNormUShort(PackNormUShort(0.0)) == 0.0);
+    // And out of range values clamp
+    TEST_CHECK(UnpackNormUShort(PackNormUShort(1.5)) == 1.0);
+}
+
+static void TestOctNormals()
+{
+    float maxAngle = 0.0;
+    for (int ii=0;ii<NumSamples;ii++)
+    {
+        Vector3f norm(RandRange(-1.0,1.0),RandRange(-1.0,1.0),RandRange(-1.0,1.0));
+        if (norm.norm() < 1e-3)
+            continue;
+        norm.normalize();
+        signed char packed[2];
+        PackOctNormal(norm,packed);
+        float dot = UnpackOctNormal(packed).dot(norm);
+        maxAngle = std::max(maxAngle,(float)(acosf(std::min(1.0f,dot)) * 180.0 / M_PI));
+    }
+    printf("  octahedral:       max angular error %g degrees\n",maxAngle);
+    TEST_CHECK(maxAngle < 1.0);
+
+    // The axes, which are what flat areas of the globe mostly hit
+    Vector3f axes[6] = {Vector3f(1,0,0),Vector3f(-1,0,0),Vector3f(0,1,0),Vector3f(0,-1,0),Vector3f(0,0,1),Vector3f(0,0,-1)};
+    for (unsigned int ii=0;ii<6;ii++)
+    {
+        signed char packed[2];
+        PackOctNormal(axes[ii],packed);
+        TEST_CHECK((UnpackOctNormal(packed) - axes[ii]).norm() < 1e-2);
+    }
+}
+
+static void TestPositions()
+{
+    // Roughly a level 10 tile on the unit globe
+    const float extent = 0.01;
+    std::vector<Vector3f> pts;
+    for (int ii=0;ii<65535;ii++)
+        pts.push_back(Vector3f(0.7+RandRange(0.0,extent),0.2+RandRange(0.0,extent),0.6+RandRange(0.0,extent)));
+    PositionQuantizer quant(&pts[0],(int)pts.size());
+    float maxErr = 0.0;
+    for (unsigned int ii=0;ii<pts.size();ii++)
+    {
+        short packed[4];
+        quant.pack(pts[ii],packed);
+        maxErr = std::max(maxErr,(quant.unpack(packed) - pts[ii]).norm());
+    }
+    printf("  positions:        max error %g over a %g extent\n",maxErr,extent);
+    // Half a step in each of three dimensions, plus float slop
+    TEST_CHECK(maxErr < extent / 32767 + 1e-6);
+
+    // A single point shouldn't blow up the scale
+    PositionQuantizer single(&pts[0],1);
+    short packed[4];
+    single.pack(pts[0],packed);
+    TEST_CHECK((single.unpack(packed) - pts[0]).norm() < 1e-6);
+}
+
+// Pack a few vertices through VertexAttribute and compare with the helpers
+static void TestInterleave()
+{
+    VertexAttribute texCoords(BDFloat2Type,"a_texCoord");
+    VertexAttribute norms(BDFloat3Type,"a_normal");
+    TEST_CHECK(texCoords.setPacking(BDPackHalfFloat));
+    TEST_CHECK(norms.setPacking(BDPackOctahedral));
+    // Octahedral normals only make sense for 3D vectors
+    VertexAttribute colors(BDChar4Type,"a_color");
+    TEST_CHECK(!colors.setPacking(BDPackOctahedral));
+    TEST_CHECK(norms.glName() == "a_normalOct");
+    TEST_CHECK(texCoords.glName() == "a_texCoord");
+
+    const int numVerts = 16;
+    for (int ii=0;ii<numVerts;ii++)
+    {
+        texCoords.addVector2f(Vector2f(ii/(float)numVerts,1.0-ii/(float)numVerts));
+        norms.addVector3f(Vector3f(RandRange(-1.0,1.0),RandRange(-1.0,1.0),1.0).normalized());
+    }
+
+    texCoords.buffer = 0;
+    norms.buffer = texCoords.size();
+    int stride = texCoords.size() + norms.size();
+    TEST_CHECK(texCoords.size() == 4);
+    TEST_CHECK(norms.size() == 4);
+    std::vector<unsigned char> buf(numVerts*stride);
+    texCoords.interleave(&buf[0],stride,0,numVerts);
+    norms.interleave(&buf[0],stride,0,numVerts);
+
+    for (int ii=0;ii<numVerts;ii++)
+    {
+        const unsigned char *vert = &buf[ii*stride];
+        const Vector2f &tc = *(Vector2f *)texCoords.addressForElement(ii);
+        unsigned short half[2];
+        memcpy(half,vert,sizeof(half));
+        TEST_CHECK(half[0] == FloatToHalf(tc.x()) && half[1] == FloatToHalf(tc.y()));
+
+        const Vector3f &norm = *(Vector3f *)norms.addressForElement(ii);
+        signed char oct[2];
+        PackOctNormal(norm,oct);
+        TEST_CHECK(memcmp(oct,vert+norms.buffer,2) == 0);
+    }
+
+    // What we tell GL about the data as packed and as stored
+    TEST_CHECK(norms.glType() == GL_BYTE && norms.glEntryComponents() == 2 && norms.glNormalize());
+    TEST_CHECK(norms.glType(false) == GL_FLOAT && norms.glEntryComponents(false) == 3 && !norms.glNormalize(false));
+    TEST_CHECK(texCoords.glType() == GL_HALF_FLOAT_OES && texCoords.glType(false) == GL_FLOAT);
+}
+
+// Bytes per vertex in the layouts the builders use
+static int VertexSize(bool shortPos,BDAttributePacking normPacking,BDAttributePacking texPacking,bool tex,bool norm,bool color)
+{
+    int size = shortPos ? 4*sizeof(short) : 3*sizeof(float);
+    if (tex)
+    {
+        VertexAttribute attr(BDFloat2Type,"a_texCoord");
+        attr.setPacking(texPacking);
+        size += attr.size();
+    }
+    if (norm)
+    {
+        VertexAttribute attr(BDFloat3Type,"a_normal");
+        attr.setPacking(normPacking);
+        size += attr.size();
+    }
+    if (color)
+        size += 4;
+    return size;
+}
+
+static void ReportSizes()
+{
+    int tileFull = VertexSize(false,BDPackNone,BDPackNone,true,true,false);
+    int tileCompact = VertexSize(true,BDPackOctahedral,BDPackNormShort,true,true,false);
+    int tileAtlas = VertexSize(false,BDPackOctahedral,BDPackNormShort,true,true,false);
+    int vecFull = VertexSize(false,BDPackNone,BDPackNone,false,true,true);
+    int vecCompact = VertexSize(false,BDPackOctahedral,BDPackNone,false,true,true);
+    printf("  bytes per vertex (float -> compact):\n");
+    printf("    tile:            %d -> %d\n",tileFull,tileCompact);
+    printf("    tile in atlas:   %d -> %d\n",tileFull,tileAtlas);
+    printf("    vector:          %d -> %d\n",vecFull,vecCompact);
+    printf("    65k vertex tile: %d KB -> %d KB\n",tileFull*65535/1024,tileCompact*65535/1024);
+    TEST_CHECK(tileCompact < tileFull);
+    TEST_CHECK(vecCompact < vecFull);
+}
+
+int main(int argc,char *argv[])
+{
+    srand(12345);
+    TestHalfFloat();
+    TestNormShorts();
+    TestOctNormals();
+    TestPositions();
+    TestInterleave();
+    ReportSizes();
+
+    return TestResult("VertexPackingTest");
+}
@@ -0,0 +1,109 @@
+/*
+ *  Drawable.h
+ *  HeadlessTests
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#include <stddef.h>
+#include <sys/time.h>
+#include <vector>
+#include <set>
+#import "Identifiable.h"
+#import "WhirlyVector.h"
+
+/** Stands in for WhirlyGlobeLib's Drawable.h when building ChangeQueue.mm,
+    Cullable.mm or DrawListSorter.mm headless.  The real one pulls in UIKit and
+    the drawables, but those only need the ChangeRequest interface and the parts
+    of Drawable that culling and sorting look at.  Both are copied from the real
+    header, so keep them in step.  Programs that use this put mock/ ahead of the
+    library includes.
+  */
+
+// Objective-C bits the library sources use in passing
+#define nil NULL
+#define __unsafe_unretained
+#define NSLog(...)
+
+class WhirlyKitRendererFrameInfo;
+
+/// CoreFoundation's clock, near enough
+static inline double CFAbsoluteTimeGetCurrent()
+{
+    struct timeval tv;
+    gettimeofday(&tv,NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+namespace WhirlyKit
+{
+
+class Scene;
+typedef void *WhirlyKitSceneRendererES;
+typedef void *WhirlyKitView;
+
+typedef enum {ChangePriorityUrgent=0,ChangePriorityNormal,ChangePriorityBulk} ChangePriority;
+static const int ChangePriorityCount = 3;
+
+typedef enum {ChangeCoalesceNone,ChangeCoalesceAdd,ChangeCoalesceRemove,ChangeCoalesceUpdate} ChangeCoalesceType;
+
+/// The change request interface from Drawable.h, minus the OpenGL setup
+class ChangeRequest
+{
+public:
+	ChangeRequest() { }
+	virtual ~ChangeRequest() { }
+    
+    virtual bool needsFlush() { return false; }
+	virtual void execute(Scene *scene,WhirlyKitSceneRendererES *renderer,WhirlyKitView *view) = 0;
+    virtual ChangePriority getPriority() { return ChangePriorityNormal; }
+    virtual bool getIDs(std::vector<SimpleIdentity> &ids) { return false; }
+    virtual ChangeCoalesceType getCoalesceType() { return ChangeCoalesceNone; }
+    virtual void getCoalesceIDs(std::vector<SimpleIdentity> &ids) { }
+    virtual bool dropTargets(const std::set<SimpleIdentity> &ids) { return false; }
+    virtual void takeOverTarget(ChangeRequest *earlier,SimpleIdentity targetID) { }
+};
+
+typedef std::vector<ChangeRequest *> ChangeSet;
+
+/// Just what culling and draw list sorting look at in a drawable
+class Drawable : public Identifiable
+{
+public:
+    Drawable() : on(true), drawPriority(0), programId(EmptyIdentity), texId(EmptyIdentity), alpha(false), zBuffer(false) { }
+    Drawable(const Mbr &localMbr) : localMbr(localMbr), on(true), drawPriority(0), programId(EmptyIdentity), texId(EmptyIdentity), alpha(false), zBuffer(false) { }
+    virtual ~Drawable() { }
+    
+    virtual Mbr getLocalMbr() const { return localMbr; }
+    virtual bool isOn(WhirlyKitRendererFrameInfo *frameInfo) const { return on; }
+    virtual const Eigen::Matrix4d *getMatrix() const { return NULL; }
+    
+    virtual unsigned int getDrawPriority() const { return drawPriority; }
+    virtual SimpleIdentity getProgram() const { return programId; }
+    virtual SimpleIdentity getTexId() const { return texId; }
+    virtual bool hasAlpha(WhirlyKitRendererFrameInfo *frameInfo) const { return alpha; }
+    virtual bool getRequestZBuffer() const { return zBuffer; }
+    
+    Mbr localMbr;
+    bool on;
+    unsigned int drawPriority;
+    SimpleIdentity programId,texId;
+    bool alpha,zBuffer;
+};
+
+typedef boost::shared_ptr<Drawable> DrawableRef;
+
+}
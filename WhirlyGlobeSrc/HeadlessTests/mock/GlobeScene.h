@@ -0,0 +1,27 @@
+/*
+ *  GlobeScene.h
+ *  HeadlessTests
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+/** Stands in for WhirlyGlobeLib's GlobeScene.h when building Cullable.mm headless.
+    Cullable.mm only wants the headers it pulls in, not the Scene.
+  */
+
+#import "Drawable.h"
+#import "Cullable.h"
+#import "GlobeMath.h"
@@ -0,0 +1,104 @@
+#!/bin/bash
+#
+#  runtests.sh
+#  HeadlessTests
+#
+#  Builds and runs the headless tests and benchmarks.  These cover the parts of
+#  WhirlyGlobeLib that are plain C++ underneath the .mm extension, so they'll build
+#  with any C++ compiler on Linux or OS X.  The OpenGL ES, mach and proj.4 headers come
+#  from shim/ and nothing talks to a GPU.  Headers that drag in UIKit get a stand-in from
+#  mock/ for the programs that ask for it.  You need Eigen and boost, either checked out
+#  in third-party/ or installed where the compiler can find them.  shim/EigenCompat.h
+#  papers over what newer versions of Eigen dropped.  The library should build without
+#  warnings, apart from gcc's complaints about #import and unused parameters.
+#
+#    ./runtests.sh            Build everything and run the tests
+#    ./runtests.sh bench      Run the benchmarks as well
+#    ./runtests.sh <name>     Build and run just the one
+#
+
+cd "$(dirname "$0")"
+
+LIB=../WhirlyGlobeLib
+THIRD=../../third-party
+BUILD=build
+CXX=${CXX:-c++}
+CXXFLAGS=${CXXFLAGS:--O2 -Wall -Wextra -Wno-deprecated -Wno-unused-parameter}
+INCLUDES="-Ishim -I$LIB/include -I$THIRD/eigen -I$THIRD/boost -I/usr/include/eigen3 -include shim/EigenCompat.h"
+
+WHICH=$1
+FAILED=""
+mkdir -p $BUILD
+
+# Build a program from its sources and run it.
+# The first argument is test or bench.  Benchmarks only run if asked for.
+run()
+{
+    kind=$1; name=$2; shift 2
+    if [ -n "$WHICH" ] && [ "$WHICH" != "bench" ] && [ "$WHICH" != "$name" ]; then
+        return
+    fi
+    if [ "$kind" = "bench" ] && [ -z "$WHICH" ]; then
+        return
+    fi
+    
+    srcs=""
+    extra=""
+    for src in "$@"; do
+        case $src in
+            # A library source built against the stand-ins in mock/.  Its header is copied
+            #  next to them, so its quoted includes find those before the real ones.
+            mock:*)
+                base=${src#mock:}
+                mkdir -p $BUILD/mock/$name
+                cp mock/*.h $LIB/include/$base.h $BUILD/mock/$name/
+                extra="-I$BUILD/mock/$name"
+                srcs="$srcs -x c++ $LIB/src/$base.mm -x none" ;;
+            # The library sources are Objective-C++ in name only
+            *.mm) srcs="$srcs -x c++ $src -x none" ;;
+            *) srcs="$srcs $src" ;;
+        esac
+    done
+    
+    echo "---$name---"
+    if ! $CXX $CXXFLAGS $extra $INCLUDES $srcs -lpthread -o $BUILD/$name; then
+        FAILED="$FAILED $name"
+        return
+    fi
+    if ! $BUILD/$name; then
+        FAILED="$FAILED $name"
+    fi
+}
+
+GLSTUBS="shim/GLStubs.cpp $LIB/src/GLBackend.mm"
+GLOBEMATH="shim/ProjStubs.cpp $LIB/src/GlobeMath.mm $LIB/src/WhirlyVector.mm"
+
+run test VertexPackingTest VertexPackingTest.cpp $LIB/src/VertexAttribute.mm $LIB/src/VertexPacking.mm $GLSTUBS
+run test MeshOptimizerTest MeshOptimizerTest.cpp $LIB/src/MeshOptimizer.mm
+run test BufferAllocatorTest BufferAllocatorTest.cpp $LIB/src/BufferAllocator.mm
+run test RegionAllocatorTest RegionAllocatorTest.cpp $LIB/src/RegionAllocator.mm
+run test DynamicTextureDefragTest DynamicTextureDefragTest.cpp $LIB/src/DynamicTextureDefrag.mm $LIB/src/RectPacker.mm
+run test BakedAtlasTest BakedAtlasTest.cpp $LIB/src/BakedAtlas.mm $LIB/src/RectPacker.mm
+run test ChangeSchedulerTest ChangeSchedulerTest.cpp mock:ChangeQueue
+run test IdentifiableTest IdentifiableTest.cpp $LIB/src/Identifiable.mm
+run test ProfilerTest ProfilerTest.cpp $LIB/src/RecordingGLBackend.mm $LIB/src/GLCommandList.mm $LIB/src/WorkerPool.mm $LIB/src/Profiler.mm $GLSTUBS
+run test LatencyHistogramTest LatencyHistogramTest.cpp $LIB/src/LatencyHistogram.mm
+run test CullCoherenceTest CullCoherenceTest.cpp mock:Cullable $LIB/src/WorkerPool.mm $LIB/src/Profiler.mm $LIB/src/Identifiable.mm $GLOBEMATH
+run test CullHorizonTest CullHorizonTest.cpp mock:Cullable $LIB/src/WorkerPool.mm $LIB/src/Profiler.mm $LIB/src/Identifiable.mm $GLOBEMATH
+run test GLStateOptimizerTest GLStateOptimizerTest.cpp $LIB/src/GLStateOptimizer.mm $LIB/src/RecordingGLBackend.mm $GLSTUBS
+run bench VertexAttributeBench VertexAttributeBench.cpp $LIB/src/VertexAttribute.mm $LIB/src/VertexPacking.mm $GLSTUBS
+run bench ElementPatchBench ElementPatchBench.cpp $LIB/src/RegionAllocator.mm
+run bench RectPackerBench RectPackerBench.cpp $LIB/src/RectPacker.mm
+run bench ChangeQueueBench ChangeQueueBench.cpp mock:ChangeQueue
+run bench IdentityTableBench IdentityTableBench.cpp
+run bench IdentifiableBench IdentifiableBench.cpp $LIB/src/Identifiable.mm
+run bench CullTreeBench CullTreeBench.cpp mock:Cullable $LIB/src/WorkerPool.mm $LIB/src/Profiler.mm $LIB/src/Identifiable.mm $GLOBEMATH
+run bench CullThreadsBench CullThreadsBench.cpp mock:Cullable $LIB/src/WorkerPool.mm $LIB/src/Profiler.mm $LIB/src/Identifiable.mm $GLOBEMATH
+run bench DrawListSortBench DrawListSortBench.cpp mock:DrawListSorter $LIB/src/WorkerPool.mm $LIB/src/Profiler.mm $LIB/src/Identifiable.mm
+run bench CommandListBench CommandListBench.cpp $LIB/src/RecordingGLBackend.mm $LIB/src/GLCommandList.mm $LIB/src/WorkerPool.mm $LIB/src/Profiler.mm $GLSTUBS
+
+if [ -n "$FAILED" ]; then
+    echo "Failed:$FAILED"
+    exit 1
+fi
+echo "All passed"
@@ -0,0 +1,32 @@
+/*
+ *  EigenCompat.h
+ *  HeadlessTests
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+// The Eigen checked out in third-party still has internal::sqrt, which
+//  WhirlyVector.mm uses.  Newer ones, like the system's, dropped it.
+#include <math.h>
+#include <Eigen/Core>
+
+namespace Eigen
+{
+namespace internal
+{
+    using ::sqrt;
+}
+}
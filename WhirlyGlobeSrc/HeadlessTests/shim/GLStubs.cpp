@@ -0,0 +1,110 @@
+/*
+ *  GLStubs.cpp
+ *  HeadlessTests
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+// Entry points the default OpenGL ES backend calls.  The headless tests
+//  always swap in the RecordingGLBackend, so these never do anything.
+//  They're here so we can link without a GL library.
+
+#include <OpenGLES/ES2/gl.h>
+#include <OpenGLES/ES2/glext.h>
+
+extern "C"
+{
+void glActiveTexture(GLenum texture) { }
+void glAttachShader(GLuint program, GLuint shader) { }
+void glBindBuffer(GLenum target, GLuint buffer) { }
+void glBindFramebuffer(GLenum target, GLuint framebuffer) { }
+void glBindRenderbuffer(GLenum target, GLuint renderbuffer) { }
+void glBindTexture(GLenum target, GLuint texture) { }
+void glBindVertexArrayOES(GLuint array) { }
+void glBlendFunc(GLenum sfactor, GLenum dfactor) { }
+void glBufferData(GLenum target, GLsizeiptr size, const void *data, GLenum usage) { }
+void glBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void *data) { }
+GLenum glCheckFramebufferStatus(GLenum target) { return 0; }
+void glClear(GLbitfield mask) { }
+void glClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha) { }
+void glCompileShader(GLuint shader) { }
+void glCompressedTexImage2D(GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height, GLint border, GLsizei imageSize, const void *data) { }
+void glCompressedTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLsizei imageSize, const void *data) { }
+void glCopyTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint x, GLint y, GLsizei width, GLsizei height) { }
+GLuint glCreateProgram(void) { return 0; }
+GLuint glCreateShader(GLenum type) { return 0; }
+void glDeleteBuffers(GLsizei n, const GLuint *buffers) { }
+void glDeleteFramebuffers(GLsizei n, const GLuint *framebuffers) { }
+void glDeleteProgram(GLuint program) { }
+void glDeleteRenderbuffers(GLsizei n, const GLuint *renderbuffers) { }
+void glDeleteShader(GLuint shader) { }
+void glDeleteTextures(GLsizei n, const GLuint *textures) { }
+void glDeleteVertexArraysOES(GLsizei n, const GLuint *arrays) { }
+void glDepthFunc(GLenum func) { }
+void glDepthMask(GLboolean flag) { }
+void glDisable(GLenum cap) { }
+void glDisableVertexAttribArray(GLuint index) { }
+void glDiscardFramebufferEXT(GLenum target, GLsizei numAttachments, const GLenum *attachments) { }
+void glDrawArrays(GLenum mode, GLint first, GLsizei count) { }
+void glDrawElements(GLenum mode, GLsizei count, GLenum type, const void *indices) { }
+void glEnable(GLenum cap) { }
+void glEnableVertexAttribArray(GLuint index) { }
+void glFinish(void) { }
+void glFlush(void) { }
+void glFramebufferRenderbuffer(GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer) { }
+void glFramebufferTexture2D(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level) { }
+void glGenBuffers(GLsizei n, GLuint *buffers) { }
+void glGenFramebuffers(GLsizei n, GLuint *framebuffers) { }
+void glGenRenderbuffers(GLsizei n, GLuint *renderbuffers) { }
+void glGenTextures(GLsizei n, GLuint *textures) { }
+void glGenVertexArraysOES(GLsizei n, GLuint *arrays) { }
+void glGenerateMipmap(GLenum target) { }
+void glGetActiveAttrib(GLuint program, GLuint index, GLsizei bufSize, GLsizei *length, GLint *size, GLenum *type, GLchar *name) { }
+void glGetActiveUniform(GLuint program, GLuint index, GLsizei bufSize, GLsizei *length, GLint *size, GLenum *type, GLchar *name) { }
+GLint glGetAttribLocation(GLuint program, const GLchar *name) { return 0; }
+GLenum glGetError(void) { return 0; }
+void glGetIntegerv(GLenum pname, GLint *data) { }
+void glGetProgramInfoLog(GLuint program, GLsizei bufSize, GLsizei *length, GLchar *infoLog) { }
+void glGetProgramiv(GLuint program, GLenum pname, GLint *params) { }
+void glGetRenderbufferParameteriv(GLenum target, GLenum pname, GLint *params) { }
+void glGetShaderInfoLog(GLuint shader, GLsizei bufSize, GLsizei *length, GLchar *infoLog) { }
+void glGetShaderiv(GLuint shader, GLenum pname, GLint *params) { }
+const GLubyte *glGetString(GLenum name) { return 0; }
+GLint glGetUniformLocation(GLuint program, const GLchar *name) { return 0; }
+void glLineWidth(GLfloat width) { }
+void glLinkProgram(GLuint program) { }
+void *glMapBufferOES(GLenum target, GLenum access) { return 0; }
+void glRenderbufferStorage(GLenum target, GLenum internalformat, GLsizei width, GLsizei height) { }
+void glShaderSource(GLuint shader, GLsizei count, const GLchar *const*string, const GLint *length) { }
+void glTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void *pixels) { }
+void glTexParameteri(GLenum target, GLenum pname, GLint param) { }
+void glTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const void *pixels) { }
+void glUniform1f(GLint location, GLfloat v0) { }
+void glUniform1i(GLint location, GLint v0) { }
+void glUniform2f(GLint location, GLfloat v0, GLfloat v1) { }
+void glUniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2) { }
+void glUniform4f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3) { }
+void glUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value) { }
+GLboolean glUnmapBufferOES(GLenum target) { return 0; }
+void glUseProgram(GLuint program) { }
+void glValidateProgram(GLuint program) { }
+void glVertexAttrib1f(GLuint index, GLfloat x) { }
+void glVertexAttrib2f(GLuint index, GLfloat x, GLfloat y) { }
+void glVertexAttrib3f(GLuint index, GLfloat x, GLfloat y, GLfloat z) { }
+void glVertexAttrib4f(GLuint index, GLfloat x, GLfloat y, GLfloat z, GLfloat w) { }
+void glVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer) { }
+void glViewport(GLint x, GLint y, GLsizei width, GLsizei height) { }
+}
@@ -0,0 +1,40 @@
+/*
+ *  mach_time.h
+ *  HeadlessTests
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+// Stands in for the bits of mach_time the profiler and latency code use.
+// Ticks are nanoseconds here, so the timebase is 1/1.
+#include <stdint.h>
+#include <time.h>
+
+typedef struct { uint32_t numer, denom; } mach_timebase_info_data_t;
+
+static inline uint64_t mach_absolute_time()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return (uint64_t)ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+static inline int mach_timebase_info(mach_timebase_info_data_t *info)
+{
+    info->numer = 1;
+    info->denom = 1;
+    return 0;
+}
@@ -0,0 +1,29 @@
+/*
+ *  proj_api.h
+ *  HeadlessTests
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+// Just the parts of proj.4 that GlobeMath.mm calls.  The stubs are in ProjStubs.cpp.
+
+typedef void *projPJ;
+
+extern "C"
+{
+projPJ pj_init_plus(const char *definition);
+int pj_transform(projPJ src, projPJ dst, long point_count, int point_offset, double *x, double *y, double *z);
+}
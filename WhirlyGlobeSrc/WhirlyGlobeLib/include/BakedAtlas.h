@@ -0,0 +1,88 @@
+/*
+ *  BakedAtlas.h
+ *  WhirlyGlobeLib
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <string>
+#import <vector>
+
+namespace WhirlyKit
+{
+
+/// An image to be baked into an atlas.  RGBA, 8 bits per channel, top row first.
+class BakedAtlasImage
+{
+public:
+    BakedAtlasImage() : width(0), height(0) { }
+    
+    std::string name;
+    int width,height;
+    std::vector<unsigned char> pixels;
+};
+
+/// Where an image wound up in a baked atlas (in texels)
+class BakedAtlasEntry
+{
+public:
+    BakedAtlasEntry() : page(0), x(0), y(0), width(0), height(0) { }
+    
+    std::string name;
+    int page;
+    int x,y,width,height;
+};
+
+/** A baked atlas is a set of texture atlas pages packed ahead of time,
+    along with a table saying where each image went.  It's built
+    offline by the atlas baker and loaded at runtime without any image
+    decoding or repacking.  Everything here is plain C++.
+ 
+    The file is little endian:
+        header (32 bytes): 'WKAT', version, texSize, numPages, numEntries,
+            size of the name table, offset to the first page, reserved
+        entries (16 bytes each): name offset, page, x, y, width, height, padding
+        name table: NUL terminated strings
+        pages: texSize*texSize RGBA texels each, starting on a 4k boundary
+  */
+class BakedAtlas
+{
+public:
+    BakedAtlas() : texSize(0) { }
+    
+    /// Pack the images into pages of the given (square, power of two) size.
+    /// Images are placed on a grid of the given cell size, like TextureAtlasBuilder.
+    /// Returns false if an image won't fit on a page at all.
+    bool bake(const std::vector<BakedAtlasImage> &images,int texSize,int cellSize=8);
+    
+    /// Write out the pages and table.  Only works after bake().
+    bool write(const std::string &fileName) const;
+    
+    /// Parse a baked atlas sitting in memory, presumably a mapped file.
+    /// This fills in the entries and the page offsets, but doesn't copy any texels.
+    bool parse(const unsigned char *data,size_t len);
+    
+    /// Size of the pages
+    int texSize;
+    /// Where all the images went
+    std::vector<BakedAtlasEntry> entries;
+    /// Page texels after a bake()
+    std::vector<std::vector<unsigned char> > pages;
+    /// Offsets of the pages in the data after a parse()
+    std::vector<size_t> pageOffsets;
+};
+
+}
@@ -20,6 +20,7 @@
 
 #import "Drawable.h"
 #import "CoordSystem.h"
+#import "RegionAllocator.h"
 
 namespace WhirlyKit
 {
@@ -99,9 +100,19 @@ public:
     /// Enable/Disable a given region
     void setEnableRegion(SimpleIdentity elementChunkId,bool enabled);
     
-    /// Clear the region referred to by position and size (in bytes)
+    /// Clear the region referred to by position and size (in bytes).
+    /// The region may have moved if we're compacting, so it's the element chunk ID that counts.
     void clearRegion(int vertPos,int vertSize,SimpleIdentity elementChunkId);
     
+    /// If set, we'll slide regions down to fill in holes a bit at a time as we swap.
+    /// This keeps a copy of the vertex data around, so it costs memory.
+    /// Set this before adding any regions.
+    void setCompaction(bool newVal) { compaction = newVal; }
+    
+    /// Move up to this many bytes of vertex data to close up holes.
+    /// The moves go out with the next flush to each buffer.  Returns the bytes moved.
+    int compact(int maxBytes);
+    
     /// Flush out changes to the inactive buffer and request a switch
     void swap(ChangeSet &changes,BigDrawableSwap *swapRequest);
     
@@ -126,6 +137,12 @@ public:
     /// Count the size of vertex and element buffers we're representing
     void getUtilization(int &vertSize,int &elSize);
     
+    /// Fragmentation stats for the vertex buffer (in vertices)
+    void getVertexStats(RegionAllocatorStats &stats);
+    
+    /// Total bytes we've written to the element buffers so far
+    long long getElementBytesCopied() { return elementBytesCopied; }
+    
 protected:
     GLuint programId;
     SimpleIdentity texId;
@@ -139,7 +156,9 @@ protected:
     /// Called when a new VAO is bound.  Set up your VAO-related state here.
     virtual void setupAdditionalVAO(OpenGLES2Program *prog,GLuint vertArrayObj) { }
     
-    typedef enum {ChangeAdd,ChangeClear,ChangeElements} ChangeType;
+    /// Add and Clear work on the vertex buffer.  Elements rebuilds the whole element buffer.
+    /// ElementPatch writes a single chunk's elements and ElementClear zeros out a range.
+    typedef enum {ChangeAdd,ChangeClear,ChangeElements,ChangeElementPatch,ChangeElementClear} ChangeType;
     /// Used to represent an outstanding change to the buffer
     class Change
     {
@@ -151,7 +170,7 @@ protected:
         
         // Type of the change we'll make
         ChangeType type;
-        // Location (in bytes) in the vertex pool
+        // Location (in bytes) in the vertex pool (or element pool for element patches)
         int whereVert;
         // For an add, the actual data
         NSData *vertData;
@@ -191,35 +210,46 @@ protected:
     bool waitingOnSwap;
     pthread_mutex_t useMutex;
     
-    // Free region within the vertex buffer
-    class Region
-    {
-    public:
-        Region(int pos,int len) : pos(pos), len(len) { }
-        // Comparison operator
-        bool operator < (const Region &that) const { return pos < that.pos; }
-        // Position and length of a free buffer region
-        int pos,len;
-    };
-    typedef std::set<Region> RegionSet;
-        
-    // Remove the given region from the given region set
-    void removeRegion(RegionSet &regions,int pos,int size);
-    
-    RegionSet vertexRegions;
+    // Vertex buffer space, in units of vertices
+    RegionAllocator vertexAllocator;
+    // Element buffer space, in units of elements.
+    // Each chunk has a fixed spot so we can patch it in place.
+    RegionAllocator elementAllocator;
+    // Zeros for clearing element ranges
+    NSMutableData *zeroElements;
+    long long elementBytesCopied;
+    // Set if we're compacting as we go
+    bool compaction;
+    // Vertex position (in bytes) to element chunk, for compaction
+    std::map<int,SimpleIdentity> regionsByPos;
 
     // A chunk of renderable element data.
     // We consolidate these during a flush to for a coherent element buffer
     class ElementChunk : public Identifiable
     {
     public:
-        ElementChunk(NSData *elementData) : elementData(elementData), enabled(true) { }
-        ElementChunk(SimpleIdentity theId) : Identifiable(theId) { }
-        NSData *elementData;
+        ElementChunk(NSMutableData *elementData) : elementData(elementData), enabled(true), region(-1), vertPos(0), vertData(nil), elRegion(-1), elPos(0) { }
+        ElementChunk(SimpleIdentity theId) : Identifiable(theId), elementData(nil), enabled(true), region(-1), vertPos(0), vertData(nil), elRegion(-1), elPos(0) { }
+        NSMutableData *elementData;
         bool enabled;
+        // Region handle and position (in bytes) in the vertex buffer
+        int region;
+        int vertPos;
+        // Copy of the vertex data, if we're compacting
+        NSData *vertData;
+        // Region handle and position (in bytes) in the element buffer
+        int elRegion;
+        int elPos;
     };
     typedef std::set<ElementChunk> ElementChunkSet;
     
+    // Queue up a write of the chunk's elements (or zeros, if it's disabled) to both buffers
+    void patchElements(const ElementChunk &chunk);
+    // Queue up zeros for a range of the element buffers
+    void clearElements(int elPos,int len);
+    // Lay out the element chunks again with no holes and ask for a full rebuild
+    void repackElements();
+    
     // Total size of elements we already have
     int elementChunkSize;
     ElementChunkSet elementChunks;
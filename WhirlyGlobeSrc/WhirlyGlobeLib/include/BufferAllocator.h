@@ -0,0 +1,163 @@
+/*
+ *  BufferAllocator.h
+ *  WhirlyGlobeLib
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <vector>
+#import <set>
+#import <map>
+
+namespace WhirlyKit
+{
+
+/** The slab allocator doesn't talk to OpenGL directly.  It asks one of
+    these for the big buffers, so you can swap in a fake one to test
+    the allocation logic without a GPU.
+    Buffers are plain integer handles.  For OpenGL they're buffer names.
+  */
+class BufferSlabBackend
+{
+public:
+    virtual ~BufferSlabBackend() { }
+    
+    /// Create a buffer of the given size and return its ID
+    virtual unsigned int createBuffer(unsigned int size) = 0;
+    
+    /// Get rid of a buffer we created earlier
+    virtual void deleteBuffer(unsigned int bufID) = 0;
+};
+
+/// A chunk of a shared buffer handed out by the slab allocator
+class BufferAllocation
+{
+public:
+    BufferAllocation() : bufferId(0), offset(0), size(0) { }
+    
+    /// Buffer the chunk lives in
+    unsigned int bufferId;
+    /// Offset within that buffer, in bytes
+    unsigned int offset;
+    /// Size of the chunk (rounded up), in bytes
+    unsigned int size;
+};
+
+/// Fragmentation and usage stats for the slab allocator
+class BufferSlabStats
+{
+public:
+    BufferSlabStats() : numSlabs(0), numAllocs(0), totalBytes(0), usedBytes(0), freeBytes(0), numFreeBlocks(0), largestFreeBlock(0) { }
+    
+    /// Fraction of the free space that isn't in the largest free block.
+    /// 0 means the free space is all in one piece.
+    float fragmentation() const { return (freeBytes == 0) ? 0.0 : 1.0 - (float)largestFreeBlock / freeBytes; }
+    
+    unsigned int numSlabs;
+    unsigned int numAllocs;
+    unsigned int totalBytes;
+    unsigned int usedBytes;
+    unsigned int freeBytes;
+    unsigned int numFreeBlocks;
+    unsigned int largestFreeBlock;
+};
+
+/** The slab allocator carves small allocations out of a few large buffers.
+    Allocations are rounded up to a granule and free space is tracked in
+    lists bucketed by size (powers of two), so we can find a block quickly.
+    Freed blocks are merged with free neighbors and a slab that empties
+    out is handed back to the backend (we keep one around).
+    This is not thread safe.  The caller is expected to lock.
+  */
+class BufferSlabAllocator
+{
+public:
+    /// Construct with the backend, the size of each slab and the largest
+    ///  allocation we'll satisfy.  Anything bigger should get its own buffer.
+    BufferSlabAllocator(BufferSlabBackend *backend,unsigned int slabSize,unsigned int maxAllocSize);
+    ~BufferSlabAllocator();
+    
+    /// Allocate a chunk of the given size.  Returns false if it's too big.
+    bool allocate(unsigned int size,BufferAllocation &alloc);
+    
+    /// Hand back a chunk we allocated earlier
+    void free(const BufferAllocation &alloc);
+    
+    /// Returns true if this buffer is one of our slabs
+    bool isSlabBuffer(unsigned int bufID) const;
+    
+    /// Largest allocation we'll satisfy
+    unsigned int getMaxAllocSize() const { return maxAllocSize; }
+    
+    /// Fill in usage and fragmentation stats
+    void getStats(BufferSlabStats &stats) const;
+    
+    /// Hand all the slabs back to the backend.  Outstanding allocations are invalid after this.
+    void clear();
+    
+    /// Allocations are rounded up to this many bytes.  Keeps attributes aligned, too.
+    static const unsigned int Granule = 256;
+    
+protected:
+    // A single big buffer we're carving up
+    class Slab
+    {
+    public:
+        unsigned int bufferId;
+        unsigned int size;
+        unsigned int usedBytes;
+        unsigned int numAllocs;
+        // Free blocks in this slab, offset to size
+        std::map<unsigned int,unsigned int> freeBlocks;
+    };
+    
+    // A free block, sorted by size first so we can do a best fit within a bucket
+    class FreeBlock
+    {
+    public:
+        FreeBlock(unsigned int size,Slab *slab,unsigned int offset) : size(size), slab(slab), offset(offset) { }
+        bool operator < (const FreeBlock &that) const
+        {
+            if (size != that.size)
+                return size < that.size;
+            if (slab != that.slab)
+                return slab < that.slab;
+            return offset < that.offset;
+        }
+        
+        unsigned int size;
+        Slab *slab;
+        unsigned int offset;
+    };
+    
+    // Size bucket a block falls in
+    int bucketForSize(unsigned int size) const;
+    // Add and remove a free block in both the slab and the buckets
+    void addFreeBlock(Slab *slab,unsigned int offset,unsigned int size);
+    void removeFreeBlock(Slab *slab,unsigned int offset,unsigned int size);
+    // Make a new slab and add it to the free lists
+    Slab *addSlab();
+    // Hand a slab back to the backend
+    void removeSlab(Slab *slab);
+    
+    BufferSlabBackend *backend;
+    unsigned int slabSize;
+    unsigned int maxAllocSize;
+    std::map<unsigned int,Slab *> slabs;
+    std::vector<std::set<FreeBlock> > buckets;
+};
+
+}
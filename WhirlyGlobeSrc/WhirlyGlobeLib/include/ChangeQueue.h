@@ -0,0 +1,185 @@
+/*
+ *  ChangeQueue.h
+ *  WhirlyGlobeLib
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <vector>
+#import <set>
+#import <map>
+#import "Drawable.h"
+
+namespace WhirlyKit
+{
+
+/** The change queue is how change requests get from the layer threads (or anywhere else)
+    over to the renderer.  Any number of threads can add to it and they never wait
+    on each other or on the renderer.  Only one thread (the renderer) takes things out.
+    Each add is a batch that goes onto a lock free list with a single compare and swap.
+    The renderer swaps the whole list out at once and puts it back in order.
+  */
+class ChangeQueue
+{
+public:
+    ChangeQueue();
+    /// Anything still in the queue is deleted
+    ~ChangeQueue();
+    
+    /// Add a single change request.  Any thread.
+    void add(ChangeRequest *change);
+    
+    /// Add a batch of change requests, in order.  Any thread.
+    void add(const ChangeSet &changes);
+    
+    /// Add a batch of change requests and leave the set empty.
+    /// This skips copying the set.  Any thread.
+    void addAndClear(ChangeSet &changes);
+    
+    /// Take everything that's been added so far, in the order it was added.
+    /// Only one thread should call this.
+    void takeAll(ChangeSet &changes);
+    
+    /// True if there's nothing waiting.  This is only a hint if other threads are adding.
+    bool empty() const { return head == NULL; }
+    
+    /// Number of change requests waiting.  Also just a hint.
+    int size() const { return numChanges; }
+    
+protected:
+    // A batch of changes added together
+    class Batch
+    {
+    public:
+        ChangeSet changes;
+        Batch *next;
+    };
+    
+    // Push a batch onto the list
+    void push(Batch *batch);
+    
+    // Most recently added batch.  Each one points to the one before it.
+    Batch * volatile head;
+    volatile int numChanges;
+};
+
+/// What the change scheduler got done in the last frame
+class ChangeStats
+{
+public:
+    ChangeStats();
+    
+    /// Number of change requests run
+    int numExecuted;
+    /// Number left over for later frames
+    int numPending;
+    /// Time spent running them (seconds)
+    double execTime;
+    /// Number run in each priority class
+    int numExecutedByPriority[ChangePriorityCount];
+};
+
+/** The change scheduler runs change requests in the renderer, but only as many
+    as fit into a time budget for the frame.  The rest wait for the next frame.
+    Urgent requests (removals, visibility) go ahead of bulk ones (adds) that came in
+    earlier, unless they touch the same IDs or the earlier one can't say what it touches.
+    Requests in the same class always run in the order they were added.
+    With no budget nothing waits, so everything just runs in the order it was added.
+  */
+class ChangeScheduler
+{
+public:
+    ChangeScheduler();
+    /// Anything still pending is deleted
+    ~ChangeScheduler();
+    
+    /// Time we're allowed to spend on changes per frame (seconds).  0 means no limit, which is the default.
+    void setTimeBudget(double budget) { timeBudget = budget; }
+    double getTimeBudget() { return timeBudget; }
+    
+    /// Pull in everything from the queue and run what we can.  Renderer thread only.
+    void process(ChangeQueue &queue,Scene *scene,WhirlyKitSceneRendererES *renderer,WhirlyKitView *view);
+    
+    /// True if there are changes left over from an earlier frame
+    bool hasPending() { return !pending.empty(); }
+    
+    /// Stats for the last call to process()
+    const ChangeStats &getStats() { return stats; }
+    
+protected:
+    // Start time for the budget check
+    double startTime;
+    double timeBudget;
+    // Changes we've taken off the queue but haven't run, in order
+    ChangeSet pending;
+    // Number of pending requests in each class
+    int numPending[ChangePriorityCount];
+    ChangeStats stats;
+};
+
+/// What the change coalescer managed to get rid of
+class ChangeCoalesceStats
+{
+public:
+    ChangeCoalesceStats();
+    
+    /// Change requests we looked at
+    int numChanges;
+    /// Change requests that went away entirely
+    int numRemoved;
+    /// Targets added and then removed before anything ran
+    int numCancelled;
+    /// Target updates made pointless by a later update or remove
+    int numMerged;
+};
+
+/** The change coalescer folds a batch of change requests together before any
+    of them run, or have their OpenGL setup done.  An add followed by a remove
+    of the same target drops both, along with any updates in between.
+    Repeated updates of the same kind on a target collapse into the last one,
+    which takes over anything else the earlier ones would have done.
+    Requests that report their IDs but don't coalesce just reset what we know
+    about those IDs.  Requests that can't report their IDs reset everything.
+  */
+class ChangeCoalescer
+{
+public:
+    ChangeCoalescer();
+    
+    /// Fold the changes together, deleting the ones that aren't needed.
+    /// Order is preserved and NULL entries are left alone.
+    void coalesce(ChangeSet &changes);
+    
+    /// Totals since the last reset
+    const ChangeCoalesceStats &getStats() { return stats; }
+    void resetStats() { stats = ChangeCoalesceStats(); }
+    
+protected:
+    // What we know about a target in the batch so far
+    class TargetInfo
+    {
+    public:
+        TargetInfo() : addIndex(-1) { }
+        // Request that added it or -1 if it was there already
+        int addIndex;
+        // Requests that have updated it since
+        std::vector<int> updates;
+    };
+    
+    ChangeCoalesceStats stats;
+};
+
+}
@@ -110,6 +110,10 @@ public:
     /// False for others, like geographic.
     virtual bool isFlat() = 0;
     
+    /// For a globe, this returns true and the radii of the ellipsoid
+    ///  the surface sits on, in display units.  Flat systems return false.
+    virtual bool getEllipsoidRadii(Point3d &radii) { return false; }
+    
 protected:
     CoordSystem *coordSys;
 };
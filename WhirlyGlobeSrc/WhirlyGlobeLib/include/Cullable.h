@@ -20,104 +20,256 @@
 
 #import "Drawable.h"
 #import "CoordSystem.h"
+#import "IdentityTable.h"
+#import "WorkerPool.h"
 
 namespace WhirlyKit
-{	
+{
     
-class Cullable;
+/// Number of "corners" we used to define things in world space.
+#define WhirlyKitCullableCorners 8
+/// Number of samples along each side of a node when we work out its bounds.
+#define WhirlyKitCullableSamples 5
+    
+/** What the renderer knows about the current frame that culling needs.
+    The projection to the screen is the one pointOnScreenFromSphere does,
+    boiled down to a matrix multiply, a divide by z and a scale and offset.
+  */
+class CullParams
+{
+public:
+    CullParams();
+    
+    /// If not set, we just hand back everything
+    bool doCulling;
+    /// Set for a globe.  We'll do the backface check on the node normals.
+    bool checkBackface;
+    /// Set if we can project to the screen (there's a globe view)
+    bool checkScreen;
+    /// Eye vector in model space for the backface check
+    Eigen::Vector3f eyeVec;
+    /// Set for a globe with a real eye position.  We'll toss nodes hidden behind the horizon.
+    bool checkHorizon;
+    /// Eye position in model space for the horizon check
+    Eigen::Vector3d eyePos;
+    /// Model transform
+    Eigen::Matrix4f modelMat;
+    /// Screen x = scaleX * (x/z) + offsetX, with x and z after the model transform.  Same for y.
+    float scaleX,offsetX,scaleY,offsetY;
+    /// Screen area we care about
+    Mbr screenMbr;
+    /// Used for the drawable isOn() check.  Not retained, since workers read it all at once.
+    WhirlyKitRendererFrameInfo * __unsafe_unretained frameInfo;
+    /// If set, the tree walk and isOn() checks are split up over these threads
+    WorkerPool *workerPool;
+    /// If set, reuse what we found out about nodes in earlier frames
+    ///  when the view hasn't moved enough to change it.
+    bool useCoherence;
+};
 
-/** This is the top level of the culling tree, represented by Cullables.
-    In general, you should see this.  It's used by the Scene represented
-    for scenegraph culling.
+/** The cull tree sorts drawables by where they are so the renderer
+    can quickly toss out the ones that aren't visible.
+    It's a loose quad tree over the scene's local coordinates, kept in flat arrays.
+    Each drawable lives in exactly one node, picked by its size and center.
+    Nodes are expanded by half their size on each side, so a drawable no bigger
+    than a node fits in the one its center falls in.
+    Children are always made four at a time and sit next to each other,
+    so culling can test them as a batch.  Node bounds are stored as structures
+    of arrays for the same reason.
+    Drawables are kept in node order (depth first) so a node's own drawables and
+    everything below it are both just ranges in one array.
+    Culling can be split over a worker pool.  The top of the tree is walked first,
+    then the subtrees below that and the isOn() checks are handed out in pieces.
+    The pieces are put back together in a fixed order, so the result is the same
+    no matter how many threads there are.
+    With coherence turned on, each node remembers what the screen and backface tests
+    found and how far the view can move before that might change.  We add up a bound on how far the view
+    moves each frame and only test nodes again when they run out of room.
+    Anything that changes the projection (or a big jump) starts over.
+    On a globe, each node also gets a point that's only hidden behind the horizon
+    if the whole node is.  That one test gets rid of most of the far side of
+    the globe when we're down close to the surface.
+    In general, you shouldn't need to see this.  The Scene uses it.
   */
 class CullTree
 { 
-    friend class Cullable;
 public:
-    CullTree(WhirlyKit::CoordSystemDisplayAdapter *coordAdapter,Mbr localMbr,int depth,int maxDrawPerNode = 8);
+    /// Construct with the coordinate adapter, local bounds and maximum depth
+    CullTree(WhirlyKit::CoordSystemDisplayAdapter *coordAdapter,Mbr localMbr,int depth);
     ~CullTree();
     
-    Cullable *getTopCullable() { return topCullable; }
-    int getCount() { return numCullables; }
+    /// Add a drawable covering the given local bounds.
+    /// You can add the same drawable more than once with different bounds.
+    void addDrawable(Mbr localMbr,DrawableRef draw);
+    
+    /// Remove the drawable (every time it was added)
+    void remDrawable(DrawableRef draw);
+    
+    /// Find the drawables the renderer should consider for this frame.
+    /// They'll be turned on and won't repeat.
+    /// Don't change the tree while this is running.
+    void findDrawables(const CullParams &params,std::vector<Drawable *> &toDraw,int *drawablesConsidered);
+    
+    /// Number of nodes in use
+    int getCount();
+    
+    /// Number of nodes we tested against the view in the last findDrawables()
+    int getNodesTested() { return nodesTested; }
+    /// Number of nodes where we reused an earlier frame's result
+    int getNodesReused() { return nodesReused; }
+    
+    /// Bytes used by the nodes and the drawable arrays
+    size_t getMemoryUsage();
     
     /// Print stats out to the log
     void dumpStats();
     
 protected:
+    // Node index in the arrays for the given level and cell, making nodes as needed
+    int getNode(int level,int cellX,int cellY);
+    // Make the four children of a node
+    void addChildren(int node);
+    // Fill in the bounds for a node from its local bounding box
+    void setNodeBounds(int node,const Mbr &nodeMbr);
+    // Pick the node the given local bounds go in
+    int pickNode(const Mbr &drawMbr);
+    // Put the drawables back in depth first node order
+    void rebuild();
+    // Add a node with the given cell, returning its index
+    int addNode(const Mbr &cell);
+    
+    friend class CullGroupTask;
+    friend class CullFilterTask;
+    
+    /// What to do with a node after checking it against the view
+    typedef enum {NodeOut,NodeDescend,NodeAll} NodeResult;
+    /// What the screen and backface tests found out about a node, as bits
+    typedef enum {NodeOverlaps=1,NodeCovered=2} NodeViewFlags;
+    /// A range of entries in sortedDraws
+    class EntryRange
+    {
+    public:
+        EntryRange(int start,int end) : start(start), end(end) { }
+        int start,end;
+    };
+    /// Output from one piece of the isOn() checks
+    class FilterChunk
+    {
+    public:
+        std::vector<Drawable *> draws;
+        // Which of the draws might show up more than once
+        std::vector<int> shared;
+    };
+    
+    // Check a group of four siblings against the view
+    void testGroup(int group,const CullParams &params,const Eigen::Vector3f &eyeVec,NodeResult results[4]);
+    // Check a group of four siblings against the horizon
+    void testHorizon(int group,const CullParams &params,bool occluded[4],bool allVisible[4]);
+    // Put together what to do with a node from the view flags and the horizon test
+    NodeResult combineResult(int node,unsigned char viewFlags,bool occluded,bool allVisible);
+    // Reuse the cached results for a group if we can, otherwise test it.  Counts the nodes either way.
+    void classifyGroup(int group,const CullParams &params,const Eigen::Vector3f &eyeVec,NodeResult results[4],int &tested,int &reused);
+    // Work out how far the view moved since last frame and if we can use the cached results
+    void updateCoherence(const CullParams &params,const Eigen::Vector3f &eyeVec);
+    // Record what to draw from a group and which child groups to look at
+    void addGroupResults(int group,NodeResult results[4],std::vector<EntryRange> &ranges,std::vector<int> &groups);
+    // Walk everything under one of the frontier groups
+    void walkGroup(int which,const CullParams &params,const Eigen::Vector3f &eyeVec);
+    // Run the isOn() checks on one chunk of the ranges we're drawing
+    void filterChunk(int which,const CullParams &params);
+    
     CoordSystemDisplayAdapter *coordAdapter;
-    Cullable *topCullable;
+    Mbr localMbr;
     int depth;
-    int maxDrawPerNode;
-    int numCullables;
-};
     
-/// Number of "corners" we used to define things in world space.
-#define WhirlyKitCullableCorners 8
-/// Number of normals we'll consider for backface culling calculations.
-#define WhirlyKitCullableCornerNorms 4
-
-/** This is a representation of cullable geometry.  It has
-    geometry/direction info and a list of associated
-    Drawables.
-    Cullables are always cubes in local space.
-    In general, users shouldn't use these.  Your drawables
-     will be sorted into them behind the scenes.
- */
-class Cullable : public Identifiable
-{
-public:
-    /// Construct recursively down to the given depth
-	Cullable(CoordSystemDisplayAdapter *coordAdapter,Mbr localMbr,int depth);
-    ~Cullable();
-	
-	/// Add the given drawable to our set or the appropriate children
-	void addDrawable(CullTree *cullTree,Mbr localMbr,DrawableRef drawable);
-	
-	/// Remove a given drawable if it's there
-	void remDrawable(CullTree *cullTree,Mbr localMbr,DrawableRef drawable);
-	
-    /// Get the set of drawables associated with the cullable
-	const std::set<DrawableRef,IdentifiableRefSorter> &getDrawables() const { return drawables; }
-    
-    /// Get the set of drawables for all the children.
-    /// We cache them in the parent nodes for speed
-	const std::set<DrawableRef,IdentifiableRefSorter> &getChildDrawables() const { return childDrawables; }
-    
-    /// Return true if there are any children
-    bool hasChildren() { return children[0] || children[1] || children[2] || children[3]; }
-    
-    /// Return true if there are no drawables here (or in children)
-    bool isEmpty() { return drawables.empty() && childDrawables.empty(); }
-    
-    /// Return the Nth child.  Might be null.
-    Cullable *getChild(int which) { return children[which]; }
-    
-    /// Get the bounding box for this cullable
-	Mbr getMbr() const { return localMbr; }
-        
-    /// Count the number of nodes at and below this level
-    int countNodes() const;
-        
-public:	
-    Cullable *getOrAddChild(int which,CullTree *tree);
-    void possibleRemoveChild(int which,CullTree *tree);
-    void addDrawableToChildren(CullTree *cullTree,Mbr drawLocalMbr,DrawableRef draw);
-    void split(CullTree *);
-    
-    /// 3D locations (in model space) of the corners
-	Point3f cornerPoints[WhirlyKitCullableCorners];
-	/// Normal vectors (in model space) for the corners
-    Eigen::Vector3f cornerNorms[WhirlyKitCullableCornerNorms];
-    /// Opposite of depth.  0 means go no lower
-    int height;
-    /// Local coordinates for bounding box
-    Mbr localMbr;
-    /// Bounding boxes for each of the children
-    Mbr childMbr[4];
-	
-    Cullable *children[4];
-	std::set<DrawableRef,IdentifiableRefSorter> drawables;
-    std::set<DrawableRef,IdentifiableRefSorter> childDrawables;
+    /// Node arrays.  Each node's four children are together, starting at firstChild.
+    // Bounding box in display space
+    std::vector<float> minX,minY,minZ,maxX,maxY,maxZ;
+    // Normal in the middle of the node for the backface check.  Some part of the node
+    //  faces the eye if the normal dotted with the eye vector is over normMinDot
+    //  and all of it does if it's over normAllDot.
+    std::vector<float> normX,normY,normZ,normMinDot,normAllDot;
+    // Horizon culling point, in the space where the ellipsoid is a unit sphere.
+    //  It's the direction times horizMag, with horizMag 0 if the node doesn't have one.
+    //  The node is within an angle of the direction with the given cosine and sine.
+    std::vector<float> horizX,horizY,horizZ,horizMag,horizCos,horizSin;
+    // First of the four children or -1
+    std::vector<int> firstChild;
+    // Number of drawable entries right in the node and in it plus everything below
+    std::vector<int> numEntries,numSubEntries;
+    // Where the node's entries start in sortedDraws
+    std::vector<int> entryStart;
+    // Local bounds of the cell the node covers (before loosening)
+    std::vector<Mbr> cells;
+    // Farthest any node's bounding box gets from the origin
+    float maxRadius;
+    // Radii of the ellipsoid, if we're on a globe
+    bool hasEllipsoid;
+    Point3d ellipsoidRadii;
+    // Eye in the ellipsoid's unit sphere space for this frame
+    Eigen::Vector3d horizonEye;
+    
+    /// Cached results for coherent culling, per node.
+    // View flags from when we last tested it.  The horizon moves with the eye, so
+    //  that's cheap enough to check every frame and isn't cached.
+    std::vector<unsigned char> cacheResult;
+    // Which cache epoch the result is from.  Old ones are no good.
+    std::vector<int> cacheEpoch;
+    // How far the view can move and the eye vector can turn before the result might change
+    std::vector<float> cacheMaxMove,cacheMaxTurn;
+    // Total movement and turning when the result was cached
+    std::vector<double> cacheMoved,cacheTurned;
+    
+    /// Coherence state for the whole tree
+    int epoch;
+    // Total bounds on movement and turning since the epoch started
+    double totalMoved,totalTurned;
+    // View we saw last frame
+    bool haveLastView;
+    Eigen::Matrix4f lastModelMat;
+    Eigen::Vector3f lastEyeVec;
+    float lastScaleX,lastOffsetX,lastScaleY,lastOffsetY;
+    Mbr lastScreenMbr;
+    bool lastCheckBackface,lastCheckHorizon;
+    
+    // Stats from the last frame
+    int nodesTested,nodesReused;
+    
+    /// One drawable placed in one node
+    class Entry
+    {
+    public:
+        Entry() : node(-1), next(-1), shared(false) { }
+        DrawableRef draw;
+        // Node it's in, or -1 if the entry is free
+        int node;
+        // Next entry for the same drawable, or next free entry
+        int next;
+        // Set if the drawable has more than one entry
+        bool shared;
+    };
+    std::vector<Entry> entries;
+    int freeEntry;
+    // First entry for each drawable
+    IdentityTable<int> entriesByDrawable;
+    
+    /// Drawables sorted by node, depth first.  Rebuilt when things change.
+    bool dirty;
+    std::vector<Drawable *> sortedDraws;
+    std::vector<bool> sortedShared;
+    
+    /// Scratch space for culling, kept around between frames
+    // Groups where the top level walk stopped, to be handed out to workers
+    std::vector<int> frontier;
+    // Ranges from the top level walk, then from each frontier group
+    std::vector<EntryRange> ranges;
+    std::vector<std::vector<EntryRange> > groupRanges;
+    std::vector<std::vector<int> > groupStacks;
+    std::vector<int> groupTested,groupReused;
+    // Where each range starts if they were all laid end to end
+    std::vector<int> rangeOffsets;
+    int chunkSize;
+    std::vector<FilterChunk> chunks;
 };
 
 }
@@ -0,0 +1,65 @@
+/*
+ *  DrawListSorter.h
+ *  WhirlyGlobeLib
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <vector>
+#import "Drawable.h"
+#import "WorkerPool.h"
+
+namespace WhirlyKit
+{
+
+/** Sorts the renderer's draw list.
+    Each drawable gets a 64 bit key, once per frame, and then we radix sort the keys.
+    From most to least significant, the key holds:
+     - Alpha, if we're sorting alpha to the end
+     - Draw priority
+     - Z buffer request, if we're sorting the ones that don't want it first
+     - Program, then texture, so drawables that share them end up together within a priority
+    Programs and textures are hashed down to fit.  Two of them landing in the same
+    bucket just means a little less grouping.
+    Drawables with the same key stay in the order they came in.
+    Keep one of these around, since it hangs on to its scratch space.
+  */
+class DrawListSorter
+{
+public:
+    DrawListSorter() { }
+    
+    /// Sort the draw list.  Keys are made over the worker pool, if there is one.
+    void sort(std::vector<Drawable *> &drawList,bool useAlpha,bool useZBuffer,WhirlyKitRendererFrameInfo *frameInfo,WorkerPool *workerPool);
+    
+    /// Work out the sort key for a single drawable
+    static uint64_t sortKey(Drawable *draw,bool useAlpha,bool useZBuffer,WhirlyKitRendererFrameInfo *frameInfo);
+    
+protected:
+    friend class DrawListKeyTask;
+    
+    /// A drawable and its key, which is what we actually sort
+    class Entry
+    {
+    public:
+        uint64_t key;
+        Drawable *draw;
+    };
+    
+    std::vector<Entry> entries,scratch;
+};
+
+}
@@ -31,6 +31,8 @@
 #import "Identifiable.h"
 #import "WhirlyVector.h"
 #import "GlobeView.h"
+#import "BufferAllocator.h"
+#import "VertexAttribute.h"
 
 /// @cond
 @class WhirlyKitSceneRendererES;
@@ -62,6 +64,10 @@ class Scene;
 #define WhirlyKitOpenGLMemCacheMax 32
 /// Number of buffers we allocate at once
 #define WhirlyKitOpenGLMemCacheAllocUnit 32
+/// Size of the shared buffers we carve small drawables out of
+#define WhirlyKitOpenGLSlabSize (1024*1024)
+/// Drawables bigger than this get their own buffer
+#define WhirlyKitOpenGLSlabMaxAlloc (64*1024)
 
 /// Used to manage OpenGL buffer IDs and such.
 /// They're expensive to create and delete, so we try to do it
@@ -76,6 +82,17 @@ public:
     GLuint getBufferID(unsigned int size=0,GLenum drawType=GL_STATIC_DRAW);
     /// Toss the given buffer ID back on the list for reuse
     void removeBufferID(GLuint bufID);
+    
+    /// Carve a region out of one of the shared slab buffers.
+    /// Returns false if the size is too big, in which case use getBufferID().
+    /// The renderer may be drawing from the rest of the slab while you fill in
+    ///  the region.  See BasicDrawable::setupGL() for how that's kept safe.
+    bool getBufferRegion(unsigned int size,BufferAllocation &region);
+    /// Hand back a region we got from getBufferRegion()
+    void removeBufferRegion(const BufferAllocation &region);
+    
+    /// Usage and fragmentation for the slab buffers
+    void getSlabStats(BufferSlabStats &stats);
 
     /// Pick a texture ID off the list or ask OpenGL for one
     GLuint getTexID();
@@ -102,11 +119,24 @@ protected:
 
     std::set<GLuint> buffIDs;
     std::set<GLuint> texIDs;
+    
+    BufferSlabBackend *slabBackend;
+    BufferSlabAllocator *slabAllocator;
 };
 
 /// Mapping from Simple ID to an int
 typedef std::map<SimpleIdentity,SimpleIdentity> TextureIDMap;
 	
+/// Change requests are executed by priority class.  A request can run ahead of
+///  lower priority ones that came in before it, as long as they don't touch the same things.
+typedef enum {ChangePriorityUrgent=0,ChangePriorityNormal,ChangePriorityBulk} ChangePriority;
+static const int ChangePriorityCount = 3;
+    
+/// How a change request relates to its targets when we're folding requests together.
+/// An add and a remove of the same target cancel out.  A later update of the same kind
+///  replaces an earlier one.
+typedef enum {ChangeCoalesceNone,ChangeCoalesceAdd,ChangeCoalesceRemove,ChangeCoalesceUpdate} ChangeCoalesceType;
+    
 /** This is the base clase for a change request.  Change requests
     are how we modify things in the scene.  The renderer is running
     on the main thread and we want to keep our interaction with it
@@ -127,6 +157,27 @@ public:
 		
 	/// Make a change to the scene.  For the renderer.  Never call this.
 	virtual void execute(Scene *scene,WhirlyKitSceneRendererES *renderer,WhirlyKitView *view) = 0;
+    
+    /// Priority class.  Removals and visibility toggles are urgent, big adds are bulk.
+    virtual ChangePriority getPriority() { return ChangePriorityNormal; }
+    
+    /// Fill in the IDs of whatever this touches (drawables, textures and so on).
+    /// Return false if you're not sure, in which case nothing is reordered around this one.
+    virtual bool getIDs(std::vector<SimpleIdentity> &ids) { return false; }
+    
+    /// How this one can be folded together with others before it runs
+    virtual ChangeCoalesceType getCoalesceType() { return ChangeCoalesceNone; }
+    
+    /// The targets this one adds, removes or updates.
+    /// Anything else it reports in getIDs() is just a reference.
+    virtual void getCoalesceIDs(std::vector<SimpleIdentity> &ids) { }
+    
+    /// Stop working on the given targets.  Return true if there's nothing left to do.
+    virtual bool dropTargets(const std::set<SimpleIdentity> &ids) { return false; }
+    
+    /// An earlier update of the same kind is being folded into this one for the given target.
+    /// Pick up anything it would have done besides changing the target, like keeping the renderer going.
+    virtual void takeOverTarget(ChangeRequest *earlier,SimpleIdentity targetID) { }
 };
     
 /// Representation of a list of changes.  Might get more complex in the future.
@@ -171,6 +222,9 @@ public:
     /// Return true if the drawable has alpha.  These will be sorted last.
     virtual bool hasAlpha(WhirlyKitRendererFrameInfo *frameInfo) const = 0;
     
+    /// Return the texture we'll draw with, if there is one.  We use this for sorting.
+    virtual SimpleIdentity getTexId() const { return EmptyIdentity; }
+    
     /// Return the Matrix if there is an active one (ideally not)
     virtual const Eigen::Matrix4d *getMatrix() const { return NULL; }
 
@@ -207,6 +261,14 @@ public:
 	/// This is called by execute if there's a drawable to modify.
     /// This is the one you override.
 	virtual void execute2(Scene *scene,WhirlyKitSceneRendererES *renderer,DrawableRef draw) = 0;
+    
+    /// We just touch the one drawable
+    virtual bool getIDs(std::vector<SimpleIdentity> &ids) { ids.push_back(drawId);  return true; }
+    
+    /// The subclasses all set a value on the drawable, so the last one wins
+    virtual ChangeCoalesceType getCoalesceType() { return ChangeCoalesceUpdate; }
+    virtual void getCoalesceIDs(std::vector<SimpleIdentity> &ids) { ids.push_back(drawId); }
+    virtual bool dropTargets(const std::set<SimpleIdentity> &ids) { return ids.find(drawId) != ids.end(); }
 	
 protected:
 	SimpleIdentity drawId;
@@ -221,89 +283,26 @@ static const unsigned int MaxDrawablePoints = ((1<<16)-1);
 /// Maximum number of triangles we want in a drawable
 static const unsigned int MaxDrawableTriangles = (MaxDrawablePoints / 3);
     
-class SubTexture;
-
-/// Data types we'll accept for attributes
-typedef enum {BDFloat3Type,BDChar4Type,BDFloat2Type,BDFloatType} BDAttributeDataType;
-    
-    
-/// Used to keep track of attributes (other than points)
-class VertexAttribute
-{
-public:
-    VertexAttribute(BDAttributeDataType dataType,const std::string &name);
-    VertexAttribute(const VertexAttribute &that);
-    ~VertexAttribute();
-    
-    /// Make a copy of everything for the data
-    VertexAttribute templateCopy() const;
-    
-    /// Return the data type
-    BDAttributeDataType getDataType() const;
-    
-    /// Set the default color (if the type matches)
-    void setDefaultColor(const RGBAColor &color);
-    /// Set the default 2D vector (if the type matches)
-    void setDefaultVector2f(const Eigen::Vector2f &vec);
-    /// Set the default 3D vector (if the type matches)
-    void setDefaultVector3f(const Eigen::Vector3f &vec);
-    /// Set the default float (if the type matches)
-    void setDefaultFloat(float val);
-    
-    /// Convenience routine to add a color (if the type matches)
-    void addColor(const RGBAColor &color);
-    /// Convenience routine to add a 2D vector (if the type matches)
-    void addVector2f(const Eigen::Vector2f &vec);
-    /// Convenience routine to add a 3D vector (if the type matches)
-    void addVector3f(const Eigen::Vector3f &vec);
-    /// Convenience routine to add a float (if the type matches)
-    void addFloat(float val);
-    
-    /// Reserve size in the data array
-    void reserve(int size);
-    
-    /// Number of elements in our array
-    int numElements() const;
+/// Largest drawable we'll build if the device takes 32 bit indices.
+/// Bigger than this and we start hurting culling.
+static const unsigned int MaxLargeDrawablePoints = (1<<18);
     
-    /// Return the size of a single element
-    int size() const;
+/// The renderer sets this if the device supports 32 bit element indices (GL_OES_element_index_uint)
+void SetLargeIndicesSupported(bool supported);
     
-    /// Clean out the data array
-    void clear();
+/// True if we can use 32 bit element indices
+bool LargeIndicesSupported();
     
-    /// Return a pointer to the given element
-    void *addressForElement(int which);
+/// Most points we should put in a single drawable on this device
+unsigned int MaxDrawablePointsForDevice();
     
-    /// Return the number of components as needed by glVertexAttribPointer
-    GLuint glEntryComponents() const;
-    
-    /// Return the data type as required by glVertexAttribPointer
-    GLenum glType() const;
-    
-    /// Whether or not glVertexAttribPointer will normalize the data
-    GLboolean glNormalize() const;
-    
-    /// Calls glVertexAttrib* for the appropriate type
-    void glSetDefault(int index) const;
-        
-public:
-    /// Data type for the attribute data
-    BDAttributeDataType dataType;
-    /// Name used in the shader
-    std::string name;
-    /// Default value to pass to OpenGL if there's no data array
-    union {
-        float vec3[3];
-        float vec2[2];
-        float floatVal;
-        unsigned char color[4];
-    } defaultData;
-    /// std::vector of attribute data.  Type is known by the caller.
-    void *data;
-    /// Buffer offset within interleaved vertex
-    GLuint buffer;
-};
+class SubTexture;
+
+/// How we store positions in the interleaved vertex buffer.
+/// Short positions are relative to the center of the drawable's points with a single scale.
+typedef enum {BDPositionFloat3,BDPositionShort4} BDPositionFormat;
     
+
 /** The Basic Drawable is the one we use the most.  It's
     a general purpose container for static geometry which
     may or may not be textured.
@@ -362,14 +361,15 @@ public:
     /// Set local extents
     void setLocalMbr(Mbr mbr);
 	
-	/// Simple triangle.  Can obviously only have 2^16 vertices
+	/// Simple triangle.  We keep 32 bit indices around, but they'll go to GL
+    ///  as 16 bit if there are few enough vertices.
 	class Triangle
 	{
 	public:
 		Triangle() { }
         /// Construct with vertex IDs
-		Triangle(unsigned short v0,unsigned short v1,unsigned short v2) { verts[0] = v0;  verts[1] = v1;  verts[2] = v2; }
-		unsigned short verts[3];
+		Triangle(GLuint v0,GLuint v1,GLuint v2) { verts[0] = v0;  verts[1] = v1;  verts[2] = v2; }
+		GLuint verts[3];
 	};
 
 	/// Set the draw priority.  We sort by draw priority before rendering.
@@ -454,11 +454,28 @@ public:
     /// Add a float to the given attribute array
     void addAttributeValue(int attrId,float val);
     
+    /// Add a run of points all at once.  Returns the index of the first one.
+    unsigned int addPoints(const Point3f *pts,int numPts);
+    
+    /// Add a run of texture coordinates
+    void addTexCoords(const Eigen::Vector2f *coords,int numCoords);
+    
+    /// Add a run of colors
+    void addColors(const RGBAColor *colors,int numColors);
+    
+    /// Add a run of normals
+    void addNormals(const Point3f *norms,int numNorms);
+    
+    /// Add a run of values to the given attribute array.
+    /// The type has to match what the attribute was created with.
+    template<typename T> void addAttributeValues(int attrId,const T *vals,int numVals)
+    { vertexAttributes[attrId]->addValues(vals,numVals); }
+    
     /// Add a triangle.  Should point to the vertex IDs.
 	void addTriangle(Triangle tri);
     
     /// Return the texture ID
-    SimpleIdentity getTexId();
+    virtual SimpleIdentity getTexId() const;
     
     /// Add a new vertex related attribute.  Need a data type and the name the shader refers to
     ///  it by.  The index returned is how you will access it.
@@ -469,6 +486,12 @@ public:
     
     /// Return the number of triangles added so far
     unsigned int getNumTris() const;
+    
+    /// Element index type we'll use in GL.  Either GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
+    GLenum getElementType() const;
+    
+    /// Size of a single element index as it'll be stored in GL
+    GLuint singleElementSize() const;
         
     /// Reserve the extra space for points
     void reserveNumPoints(int numPoints);
@@ -484,6 +507,17 @@ public:
     
     /// Reserve extra space for colors
     void reserveNumColors(int numColors);
+    
+    /// Reserve extra space in the given attribute array
+    void reserveAttribute(int attrId,int numVals);
+    
+    /// Set the compact vertex formats used when we set up the vertex buffer.
+    /// Short positions don't work with the drawable atlases, which need float positions.
+    /// Do this before setupGL().
+    void setVertexFormat(BDPositionFormat posFormat,BDAttributePacking normPacking,BDAttributePacking texCoordPacking);
+    
+    /// Return the position format
+    BDPositionFormat getPositionFormat() const;
 	    
     /// Set the active transform matrix
     void setMatrix(const Eigen::Matrix4d *inMat);
@@ -506,6 +540,15 @@ public:
     /// Assuming this is a set of triangles, convert to a triangle strip
     void convertToTriStrip();
     
+    /// Reorder triangles and vertices for the post transform vertex cache
+    ///  and for vertex fetch.  If dedup is set, we'll merge vertices that
+    ///  are identical in every attribute first.
+    /// Only works on GL_TRIANGLES and only before setupGL().  Vertex order
+    ///  changes, so do things like applySubTexture() with a starting
+    ///  vertex before calling this.
+    /// This is safe to call off the rendering thread.
+    void optimizeMesh(bool dedup=true);
+    
     /// Return the vertex attributes for reference
     const std::vector<VertexAttribute *> &getVertexAttributes();
     
@@ -515,6 +558,9 @@ protected:
     /// Add a single point to the GL Buffer.
     /// Override this to add your own data to interleaved vertex buffers.
     virtual void addPointToBuffer(unsigned char *basePtr,int which);
+    /// Add a run of points to the GL Buffer, one attribute at a time.
+    /// If you override addPointToBuffer(), override this too.
+    virtual void addPointsToBuffer(unsigned char *basePtr,int start,int count);
     /// Called while a new VAO is bound.  Set up your VAO-related state here.
     virtual void setupAdditionalVAO(OpenGLES2Program *prog,GLuint vertArrayObj) { }
     /// Called after the drawable has bound all its various data, but before it actually
@@ -551,6 +597,8 @@ protected:
     bool writeZBuffer;
     // We'll nuke the data arrays when we hand over the data to GL
     unsigned int numPoints, numTris;
+    // Type of the indices once they're in a GL buffer
+    GLenum elementType;
 	std::vector<Eigen::Vector3f> points;
 	std::vector<Triangle> tris;
     
@@ -558,12 +606,19 @@ protected:
     // If the drawable has a matrix, we'll transform by that before drawing
     Eigen::Matrix4d mat;
 	
+    // How positions go in the vertex buffer and how we get them back out
+    BDPositionFormat posFormat;
+    Eigen::Vector3f posCenter;
+    float posScale;
+    
     // Size for a single vertex w/ all its data.  Used by shared buffer
     int vertexSize;
 	GLuint pointBuffer,triBuffer,sharedBuffer;
     GLuint vertArrayObj;
     GLuint sharedBufferOffset;
     bool sharedBufferIsExternal;
+    // If we're in one of the memory manager's slabs, this is where
+    BufferAllocation sharedBufferRegion;
 };
     
 /// Reference counted version of BasicDrawable
@@ -588,6 +643,9 @@ public:
 	OnOffChangeRequest(SimpleIdentity drawId,bool OnOff);
 	
 	void execute2(Scene *scene,WhirlyKitSceneRendererES *renderer,DrawableRef draw);
+    
+    /// Visibility toggles go first
+    virtual ChangePriority getPriority() { return ChangePriorityUrgent; }
 	
 protected:
 	bool newOnOff;
@@ -613,8 +671,13 @@ public:
     
     void execute2(Scene *scene,WhirlyKitSceneRendererES *renderer,DrawableRef draw);
     
+    /// Keep the renderer going as long as the fade we replaced would have
+    virtual void takeOverTarget(ChangeRequest *earlier,SimpleIdentity targetID);
+    
 protected:
     NSTimeInterval fadeUp,fadeDown;
+    // Latest fade time from the requests folded into this one
+    NSTimeInterval renderUntil;
 };
     
 /// Change the texture used by a drawable
@@ -625,6 +688,9 @@ public:
     
     void execute2(Scene *scene,WhirlyKitSceneRendererES *renderer,DrawableRef draw);
     
+    /// Touches the drawable and the texture
+    virtual bool getIDs(std::vector<SimpleIdentity> &ids) { ids.push_back(drawId);  ids.push_back(newTexId);  return true; }
+    
 protected:
     SimpleIdentity newTexId;
 };
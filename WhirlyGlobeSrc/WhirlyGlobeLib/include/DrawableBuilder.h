@@ -0,0 +1,121 @@
+/*
+ *  DrawableBuilder.h
+ *  WhirlyGlobeLib
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <vector>
+#import "Drawable.h"
+
+namespace WhirlyKit
+{
+
+/** The chunked drawable builder collects geometry in groups (a shape,
+    a vector feature) and then splits it into BasicDrawables when you're done.
+    Groups are sorted along a space filling curve by the center of their
+    bounds before they're packed, so each drawable covers a compact area
+    and culling still works.
+    Drawables are as big as the device will allow, which is bigger than
+    64k vertices if it can do 32 bit indices.  A group that's too big
+    on its own is split.
+  */
+class ChunkedDrawableBuilder
+{
+public:
+    /// Construct with the name and primitive type for the drawables we'll create
+    ChunkedDrawableBuilder(const std::string &name,GLenum type);
+    virtual ~ChunkedDrawableBuilder();
+    
+    /// Set the most points we'll put in a single drawable.
+    /// The default is MaxDrawablePointsForDevice().
+    void setMaxChunkPoints(unsigned int maxPoints);
+    
+    /// If set, we'll run BasicDrawable::optimizeMesh() on triangle drawables
+    ///  as we build them.  Off by default.
+    void setOptimizeMeshes(bool newVal) { optimizeMeshes = newVal; }
+    
+    /// Start a new group.  The bounding box is used for sorting and for
+    ///  the local MBR of the drawables.
+    void startGroup(const Mbr &mbr);
+    
+    /// Add a point and normal to the current group.  Returns the index within the group.
+    unsigned int addPoint(const Point3f &pt,const Point3f &norm);
+    
+    /// Add a point, normal and color to the current group.  Returns the index within the group.
+    unsigned int addPoint(const Point3f &pt,const Point3f &norm,RGBAColor color);
+    
+    /// Add a triangle to the current group.  The indices are relative to the start of the group.
+    void addTriangle(GLuint v0,GLuint v1,GLuint v2);
+    
+    /// Number of points added so far
+    unsigned int getNumPoints() const;
+    
+    /// Sort the groups, build the drawables and hand them back.
+    /// The builder is empty after this.
+    void buildDrawables(std::vector<BasicDrawable *> &drawables);
+    
+protected:
+    /// Called on every new drawable, so you can set things like draw priority
+    virtual void setupDrawable(BasicDrawable *draw) { }
+    
+    /// A single group of geometry
+    class Group
+    {
+    public:
+        Mbr mbr;
+        unsigned int startPoint,numPoints;
+        unsigned int startTri,numTris;
+        unsigned int sortKey;
+    };
+    
+    /// Sort groups along the space filling curve
+    static bool GroupSort(const Group *a,const Group *b);
+    
+    /// Drawable we're filling in and the area it covers
+    class Chunk
+    {
+    public:
+        Chunk() : draw(NULL) { }
+        BasicDrawable *draw;
+        Mbr mbr;
+    };
+    
+    // Start a new drawable
+    void startChunk(Chunk &chunk);
+    // Finish the current drawable, if there is one
+    void flushChunk(Chunk &chunk,std::vector<BasicDrawable *> &drawables);
+    // Copy a point from the staging area into a drawable
+    void copyPoint(BasicDrawable *draw,unsigned int which);
+    // Add a whole group to the current drawable
+    void addGroup(Chunk &chunk,const Group &group);
+    // Split a group that's too big for a drawable
+    void splitGroup(Chunk &chunk,const Group &group,std::vector<BasicDrawable *> &drawables);
+    
+    std::string name;
+    GLenum type;
+    unsigned int maxChunkPoints;
+    bool optimizeMeshes;
+    
+    // Staging area for all the geometry
+    std::vector<Point3f> points;
+    std::vector<Point3f> norms;
+    std::vector<RGBAColor> colors;
+    std::vector<BasicDrawable::Triangle> tris;
+    std::vector<Group> groups;
+};
+
+}
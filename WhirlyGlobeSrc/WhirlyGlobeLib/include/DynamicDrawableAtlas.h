@@ -66,6 +66,11 @@ public:
     /// Print some status info to the log
     void log();
     
+    /// If set, the big drawables will slide their contents down to fill
+    ///  in holes as they swap.  Costs a copy of the vertex data.  Off by default.
+    /// Set this before adding any drawables.
+    void setCompaction(bool newVal) { compaction = newVal; }
+    
 protected:
     /// Used to track where a drawable wound up in a big drawable
     class DrawRepresent : public Identifiable
@@ -89,6 +94,7 @@ protected:
     int singleVertexSize;
     int singleElementSize;
     int numVertexBytes,numElementBytes;
+    bool compaction;
     // The vertex attributes we expect to see on a drawable
     std::vector<VertexAttribute> vertexAttributes;
     
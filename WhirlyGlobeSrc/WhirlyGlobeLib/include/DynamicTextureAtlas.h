@@ -26,6 +26,8 @@
 #import "WhirlyVector.h"
 #import "Texture.h"
 #import "TextureAtlas.h"
+#import "RectPacker.h"
+#import "DynamicTextureDefrag.h"
 
 namespace WhirlyKit
 {
@@ -37,7 +39,7 @@ class DynamicTexture : public TextureBase
 {
 public:
     /// Constructor for sorting
-    DynamicTexture(SimpleIdentity myId) : TextureBase(myId), layoutGrid(NULL) { }
+    DynamicTexture(SimpleIdentity myId) : TextureBase(myId), packer(NULL) { }
     /// Construct with a name, square texture size, cell size (in texels), and the memory format
     DynamicTexture(const std::string &name,int texSize,int cellSize,GLenum format);
     ~DynamicTexture();
@@ -62,6 +64,10 @@ public:
     /// Add the data at a given location in the texture
     void addTextureData(int startX,int startY,int width,int height,NSData *data);
     
+    /// Copy texels from another dynamic texture into this one.
+    /// Render side only.  This goes through a framebuffer, so the format has to be renderable.
+    void copyTextureData(DynamicTexture *srcTex,int srcX,int srcY,int destX,int destY,int width,int height);
+    
     /// Set or clear a given region
     void setRegion(const Region &region,bool enable);
     
@@ -72,6 +78,12 @@ public:
     /// This is called by the renderer
     void addRegionToClear(const Region &region);
     
+    /// Clear out any regions the renderer has released
+    void clearReleasedRegions();
+    
+    /// The packer tracking which cells are in use
+    RectPacker *getPacker() { return packer; }
+    
     /// Return true if this isn't representing any regions
     bool empty();
     
@@ -81,6 +93,9 @@ public:
     /// Return texture cell utilization
     void getUtilization(int &numCell,int &usedCell);
     
+    /// Return texture cell utilization, along with fragmentation
+    void getUtilization(RectPackerStats &stats);
+    
 protected:
     /// Used for debugging
     std::string name;
@@ -96,8 +111,8 @@ protected:
     /// Number of cells on a side
     int numCell;
     
-    // Use to track where sub textures are
-    bool *layoutGrid;
+    // Use to track where sub textures are (in cells)
+    RectPacker *packer;
     
     pthread_mutex_t regionLock;
     /// These regions have been released by the renderer
@@ -123,6 +138,22 @@ protected:
     NSData *data;
 };
     
+/// Copy a region from one dynamic texture to another (on the main thread)
+class DynamicTextureCopyRegion : public ChangeRequest
+{
+public:
+    /// Construct with the source and destination textures and the region (in texels)
+    DynamicTextureCopyRegion(SimpleIdentity srcTexId,SimpleIdentity destTexId,int srcX,int srcY,int destX,int destY,int width,int height)
+    : srcTexId(srcTexId), destTexId(destTexId), srcX(srcX), srcY(srcY), destX(destX), destY(destY), width(width), height(height) { }
+    
+    /// Copy the texels.  Never call this.
+	void execute(Scene *scene,WhirlyKitSceneRendererES *renderer,WhirlyKitView *view);
+    
+protected:
+    SimpleIdentity srcTexId,destTexId;
+    int srcX,srcY,destX,destY,width,height;
+};
+    
 /// Tell a dynamic texture that a region has been released for use
 class DynamicTextureClearRegion : public ChangeRequest
 {
@@ -138,6 +169,21 @@ protected:
     DynamicTexture::Region region;
 };
 
+/// Point the scene's sub texture mappings at where the defragmenter moved them.
+/// This goes in the same batch as the texel copies and texture removals.
+class DynamicTextureMoveSubTextures : public ChangeRequest
+{
+public:
+    /// Construct with the sub textures in their new spots
+    DynamicTextureMoveSubTextures(const std::vector<SubTexture> &subTexes) : subTexes(subTexes) { }
+    
+    /// Replace the sub textures in the scene.  Never call this.
+	void execute(Scene *scene,WhirlyKitSceneRendererES *renderer,WhirlyKitView *view);
+    
+protected:
+    std::vector<SubTexture> subTexes;
+};
+
 /** The dynamic texture atlas manages a variable number of dynamic textures into which it will stuff
     individual textures.  You use it by adding your individual Textures and passing the
     change requests on to the layer thread (or Scene).  You can also clear your Textures later
@@ -160,7 +206,34 @@ public:
     ///  change requests.
     void shutdown(ChangeSet &changes);
     
-        /// Print out some utilization info
+    /// A sub texture the defragmenter moved to a different dynamic texture
+    class SubTextureMove
+    {
+    public:
+        /// Where it was
+        SubTexture oldSubTex;
+        /// Where it is now.  Same ID as the old one.
+        SubTexture newSubTex;
+    };
+    
+    /// True if the texture format can be copied on the GPU, which defragmenting needs
+    bool canDefragment();
+    
+    /// Number of dynamic textures we're using right now
+    int getNumTextures() { return textures.size(); }
+    
+    /// Memory used by a single dynamic texture, in bytes
+    int getTextureBytes();
+    
+    /// Move sub textures out of sparsely used dynamic textures and release the ones that empty out.
+    /// Call this every so often on the layer thread.  It'll do a little work each time.
+    /// The texel copies, the scene's sub texture mappings and the texture removals go into the change set.
+    /// Drawables built with the old sub textures have to be rebuilt (using the moves) and go in the
+    ///  same batch, since the old textures are gone once it runs.
+    /// Returns the number of dynamic textures released.
+    int defragment(const DynamicTextureDefragParams &params,ChangeSet &changes,std::vector<SubTextureMove> &moves);
+    
+    /// Print out some utilization info
     void log();
 
 protected:
@@ -0,0 +1,96 @@
+/*
+ *  DynamicTextureDefrag.h
+ *  WhirlyGlobeLib
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <vector>
+#import "Identifiable.h"
+#import "RectPacker.h"
+
+namespace WhirlyKit
+{
+
+/// Knobs for the dynamic texture defragmenter
+class DynamicTextureDefragParams
+{
+public:
+    DynamicTextureDefragParams() : targetPages(0), sparseUtilization(0.25), maxCellsPerPass(4096) { }
+    
+    /// We'll try to get down to this many pages.  0 means no target, just empty the sparse ones.
+    int targetPages;
+    /// Pages used less than this (0-1) are candidates for emptying, even when we're under the target
+    float sparseUtilization;
+    /// Move no more than this many cells in a single pass.
+    /// That's what keeps the defragmenter running a little at a time in the background.
+    int maxCellsPerPass;
+};
+
+/** The defrag planner looks at a set of dynamic texture pages and decides
+    which sub textures to move so that sparse pages can be emptied out and released.
+    It only works on the RectPackers, so it knows nothing about OpenGL and can be
+    run (or tested) anywhere.  The DynamicTextureAtlas carries out the plan.
+  */
+class DynamicTextureDefragPlanner
+{
+public:
+    /// A sub texture sitting in a page
+    class Entry
+    {
+    public:
+        Entry() : subTexId(EmptyIdentity) { }
+        Entry(SimpleIdentity subTexId,const RectPacker::Rect &rect) : subTexId(subTexId), rect(rect) { }
+        
+        SimpleIdentity subTexId;
+        RectPacker::Rect rect;
+    };
+    
+    /// One page (dynamic texture) along with what's in it
+    class Page
+    {
+    public:
+        Page() : pageId(EmptyIdentity), packer(NULL) { }
+        
+        SimpleIdentity pageId;
+        /// The page's packer.  Moves are reserved in here as they're planned.
+        RectPacker *packer;
+        std::vector<Entry> entries;
+    };
+    
+    /// Move a sub texture from one page to another
+    class Move
+    {
+    public:
+        SimpleIdentity subTexId;
+        SimpleIdentity fromPage,toPage;
+        RectPacker::Rect fromRect,toRect;
+    };
+    
+    /// Construct with the knobs
+    DynamicTextureDefragPlanner(const DynamicTextureDefragParams &params) : params(params) { }
+    
+    /// Work out which sub textures to move.  We only empty a page if everything in it
+    ///  fits somewhere else, so every page in emptiedPages can be released once the moves are done.
+    /// The destination rectangles are reserved in the destination page packers.
+    /// The source rectangles are left alone.  The caller releases them as it executes the moves.
+    void plan(std::vector<Page> &pages,std::vector<Move> &moves,std::vector<SimpleIdentity> &emptiedPages);
+    
+protected:
+    DynamicTextureDefragParams params;
+};
+
+}
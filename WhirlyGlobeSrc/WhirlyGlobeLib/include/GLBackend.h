@@ -0,0 +1,247 @@
+/*
+ *  GLBackend.h
+ *  WhirlyGlobeLib
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <OpenGLES/ES2/gl.h>
+#import <OpenGLES/ES2/glext.h>
+
+namespace WhirlyKit
+{
+
+/** Every OpenGL ES call the toolkit makes goes through one of these.
+    The methods are the OpenGL ES 2.0 calls we use, minus the gl prefix
+    (and the OES or EXT suffix for extensions).
+    The normal backend just calls OpenGL.  Others can record or count what
+    the renderer does, which lets us run the render path without a GPU.
+  */
+class GLBackend
+{
+public:
+    virtual ~GLBackend() { }
+    
+    /// Buffers
+    virtual void genBuffers(GLsizei n,GLuint *buffers) = 0;
+    virtual void deleteBuffers(GLsizei n,const GLuint *buffers) = 0;
+    virtual void bindBuffer(GLenum target,GLuint buffer) = 0;
+    virtual void bufferData(GLenum target,GLsizeiptr size,const GLvoid *data,GLenum usage) = 0;
+    virtual void bufferSubData(GLenum target,GLintptr offset,GLsizeiptr size,const GLvoid *data) = 0;
+    virtual GLvoid *mapBuffer(GLenum target,GLenum access) = 0;
+    virtual GLboolean unmapBuffer(GLenum target) = 0;
+    
+    /// Vertex array objects
+    virtual void genVertexArrays(GLsizei n,GLuint *arrays) = 0;
+    virtual void deleteVertexArrays(GLsizei n,const GLuint *arrays) = 0;
+    virtual void bindVertexArray(GLuint array) = 0;
+    
+    /// Vertex attributes
+    virtual void enableVertexAttribArray(GLuint index) = 0;
+    virtual void disableVertexAttribArray(GLuint index) = 0;
+    virtual void vertexAttribPointer(GLuint index,GLint size,GLenum type,GLboolean normalized,GLsizei stride,const GLvoid *ptr) = 0;
+    virtual void vertexAttrib1f(GLuint index,GLfloat x) = 0;
+    virtual void vertexAttrib2f(GLuint index,GLfloat x,GLfloat y) = 0;
+    virtual void vertexAttrib3f(GLuint index,GLfloat x,GLfloat y,GLfloat z) = 0;
+    virtual void vertexAttrib4f(GLuint index,GLfloat x,GLfloat y,GLfloat z,GLfloat w) = 0;
+    
+    /// Textures
+    virtual void genTextures(GLsizei n,GLuint *textures) = 0;
+    virtual void deleteTextures(GLsizei n,const GLuint *textures) = 0;
+    virtual void activeTexture(GLenum texture) = 0;
+    virtual void bindTexture(GLenum target,GLuint texture) = 0;
+    virtual void texParameteri(GLenum target,GLenum pname,GLint param) = 0;
+    virtual void texImage2D(GLenum target,GLint level,GLint internalformat,GLsizei width,GLsizei height,GLint border,GLenum format,GLenum type,const GLvoid *pixels) = 0;
+    virtual void texSubImage2D(GLenum target,GLint level,GLint xoffset,GLint yoffset,GLsizei width,GLsizei height,GLenum format,GLenum type,const GLvoid *pixels) = 0;
+    virtual void compressedTexImage2D(GLenum target,GLint level,GLenum internalformat,GLsizei width,GLsizei height,GLint border,GLsizei imageSize,const GLvoid *data) = 0;
+    virtual void compressedTexSubImage2D(GLenum target,GLint level,GLint xoffset,GLint yoffset,GLsizei width,GLsizei height,GLenum format,GLsizei imageSize,const GLvoid *data) = 0;
+    virtual void copyTexSubImage2D(GLenum target,GLint level,GLint xoffset,GLint yoffset,GLint x,GLint y,GLsizei width,GLsizei height) = 0;
+    virtual void generateMipmap(GLenum target) = 0;
+    
+    /// Shaders and programs
+    virtual GLuint createShader(GLenum type) = 0;
+    virtual void shaderSource(GLuint shader,GLsizei count,const GLchar **string,const GLint *length) = 0;
+    virtual void compileShader(GLuint shader) = 0;
+    virtual void getShaderiv(GLuint shader,GLenum pname,GLint *params) = 0;
+    virtual void getShaderInfoLog(GLuint shader,GLsizei bufsize,GLsizei *length,GLchar *infolog) = 0;
+    virtual void deleteShader(GLuint shader) = 0;
+    virtual GLuint createProgram() = 0;
+    virtual void attachShader(GLuint program,GLuint shader) = 0;
+    virtual void linkProgram(GLuint program) = 0;
+    virtual void validateProgram(GLuint program) = 0;
+    virtual void getProgramiv(GLuint program,GLenum pname,GLint *params) = 0;
+    virtual void getProgramInfoLog(GLuint program,GLsizei bufsize,GLsizei *length,GLchar *infolog) = 0;
+    virtual void deleteProgram(GLuint program) = 0;
+    virtual void useProgram(GLuint program) = 0;
+    virtual void getActiveUniform(GLuint program,GLuint index,GLsizei bufsize,GLsizei *length,GLint *size,GLenum *type,GLchar *name) = 0;
+    virtual void getActiveAttrib(GLuint program,GLuint index,GLsizei bufsize,GLsizei *length,GLint *size,GLenum *type,GLchar *name) = 0;
+    virtual int getUniformLocation(GLuint program,const GLchar *name) = 0;
+    virtual int getAttribLocation(GLuint program,const GLchar *name) = 0;
+    
+    /// Uniforms
+    virtual void uniform1i(GLint location,GLint x) = 0;
+    virtual void uniform1f(GLint location,GLfloat x) = 0;
+    virtual void uniform2f(GLint location,GLfloat x,GLfloat y) = 0;
+    virtual void uniform3f(GLint location,GLfloat x,GLfloat y,GLfloat z) = 0;
+    virtual void uniform4f(GLint location,GLfloat x,GLfloat y,GLfloat z,GLfloat w) = 0;
+    virtual void uniformMatrix4fv(GLint location,GLsizei count,GLboolean transpose,const GLfloat *value) = 0;
+    
+    /// Fixed function state
+    virtual void enable(GLenum cap) = 0;
+    virtual void disable(GLenum cap) = 0;
+    virtual void depthMask(GLboolean flag) = 0;
+    virtual void depthFunc(GLenum func) = 0;
+    virtual void blendFunc(GLenum sfactor,GLenum dfactor) = 0;
+    virtual void lineWidth(GLfloat width) = 0;
+    virtual void viewport(GLint x,GLint y,GLsizei width,GLsizei height) = 0;
+    virtual void clearColor(GLclampf red,GLclampf green,GLclampf blue,GLclampf alpha) = 0;
+    virtual void clear(GLbitfield mask) = 0;
+    
+    /// Framebuffers and renderbuffers
+    virtual void genFramebuffers(GLsizei n,GLuint *framebuffers) = 0;
+    virtual void deleteFramebuffers(GLsizei n,const GLuint *framebuffers) = 0;
+    virtual void bindFramebuffer(GLenum target,GLuint framebuffer) = 0;
+    virtual void framebufferRenderbuffer(GLenum target,GLenum attachment,GLenum renderbuffertarget,GLuint renderbuffer) = 0;
+    virtual void framebufferTexture2D(GLenum target,GLenum attachment,GLenum textarget,GLuint texture,GLint level) = 0;
+    virtual GLenum checkFramebufferStatus(GLenum target) = 0;
+    virtual void genRenderbuffers(GLsizei n,GLuint *renderbuffers) = 0;
+    virtual void deleteRenderbuffers(GLsizei n,const GLuint *renderbuffers) = 0;
+    virtual void bindRenderbuffer(GLenum target,GLuint renderbuffer) = 0;
+    virtual void renderbufferStorage(GLenum target,GLenum internalformat,GLsizei width,GLsizei height) = 0;
+    virtual void getRenderbufferParameteriv(GLenum target,GLenum pname,GLint *params) = 0;
+    virtual void discardFramebuffer(GLenum target,GLsizei numAttachments,const GLenum *attachments) = 0;
+    
+    /// Drawing
+    virtual void drawArrays(GLenum mode,GLint first,GLsizei count) = 0;
+    virtual void drawElements(GLenum mode,GLsizei count,GLenum type,const GLvoid *indices) = 0;
+    
+    /// Everything else
+    virtual void flush() = 0;
+    virtual void finish() = 0;
+    virtual GLenum getError() = 0;
+    virtual void getIntegerv(GLenum pname,GLint *params) = 0;
+    virtual const GLubyte *getString(GLenum name) = 0;
+};
+
+/// The normal backend, which just calls OpenGL ES 2.0
+class OpenGLES2Backend : public GLBackend
+{
+public:
+    void genBuffers(GLsizei n,GLuint *buffers);
+    void deleteBuffers(GLsizei n,const GLuint *buffers);
+    void bindBuffer(GLenum target,GLuint buffer);
+    void bufferData(GLenum target,GLsizeiptr size,const GLvoid *data,GLenum usage);
+    void bufferSubData(GLenum target,GLintptr offset,GLsizeiptr size,const GLvoid *data);
+    GLvoid *mapBuffer(GLenum target,GLenum access);
+    GLboolean unmapBuffer(GLenum target);
+    void genVertexArrays(GLsizei n,GLuint *arrays);
+    void deleteVertexArrays(GLsizei n,const GLuint *arrays);
+    void bindVertexArray(GLuint array);
+    void enableVertexAttribArray(GLuint index);
+    void disableVertexAttribArray(GLuint index);
+    void vertexAttribPointer(GLuint index,GLint size,GLenum type,GLboolean normalized,GLsizei stride,const GLvoid *ptr);
+    void vertexAttrib1f(GLuint index,GLfloat x);
+    void vertexAttrib2f(GLuint index,GLfloat x,GLfloat y);
+    void vertexAttrib3f(GLuint index,GLfloat x,GLfloat y,GLfloat z);
+    void vertexAttrib4f(GLuint index,GLfloat x,GLfloat y,GLfloat z,GLfloat w);
+    void genTextures(GLsizei n,GLuint *textures);
+    void deleteTextures(GLsizei n,const GLuint *textures);
+    void activeTexture(GLenum texture);
+    void bindTexture(GLenum target,GLuint texture);
+    void texParameteri(GLenum target,GLenum pname,GLint param);
+    void texImage2D(GLenum target,GLint level,GLint internalformat,GLsizei width,GLsizei height,GLint border,GLenum format,GLenum type,const GLvoid *pixels);
+    void texSubImage2D(GLenum target,GLint level,GLint xoffset,GLint yoffset,GLsizei width,GLsizei height,GLenum format,GLenum type,const GLvoid *pixels);
+    void compressedTexImage2D(GLenum target,GLint level,GLenum internalformat,GLsizei width,GLsizei height,GLint border,GLsizei imageSize,const GLvoid *data);
+    void compressedTexSubImage2D(GLenum target,GLint level,GLint xoffset,GLint yoffset,GLsizei width,GLsizei height,GLenum format,GLsizei imageSize,const GLvoid *data);
+    void copyTexSubImage2D(GLenum target,GLint level,GLint xoffset,GLint yoffset,GLint x,GLint y,GLsizei width,GLsizei height);
+    void generateMipmap(GLenum target);
+    GLuint createShader(GLenum type);
+    void shaderSource(GLuint shader,GLsizei count,const GLchar **string,const GLint *length);
+    void compileShader(GLuint shader);
+    void getShaderiv(GLuint shader,GLenum pname,GLint *params);
+    void getShaderInfoLog(GLuint shader,GLsizei bufsize,GLsizei *length,GLchar *infolog);
+    void deleteShader(GLuint shader);
+    GLuint createProgram();
+    void attachShader(GLuint program,GLuint shader);
+    void linkProgram(GLuint program);
+    void validateProgram(GLuint program);
+    void getProgramiv(GLuint program,GLenum pname,GLint *params);
+    void getProgramInfoLog(GLuint program,GLsizei bufsize,GLsizei *length,GLchar *infolog);
+    void deleteProgram(GLuint program);
+    void useProgram(GLuint program);
+    void getActiveUniform(GLuint program,GLuint index,GLsizei bufsize,GLsizei *length,GLint *size,GLenum *type,GLchar *name);
+    void getActiveAttrib(GLuint program,GLuint index,GLsizei bufsize,GLsizei *length,GLint *size,GLenum *type,GLchar *name);
+    int getUniformLocation(GLuint program,const GLchar *name);
+    int getAttribLocation(GLuint program,const GLchar *name);
+    void uniform1i(GLint location,GLint x);
+    void uniform1f(GLint location,GLfloat x);
+    void uniform2f(GLint location,GLfloat x,GLfloat y);
+    void uniform3f(GLint location,GLfloat x,GLfloat y,GLfloat z);
+    void uniform4f(GLint location,GLfloat x,GLfloat y,GLfloat z,GLfloat w);
+    void uniformMatrix4fv(GLint location,GLsizei count,GLboolean transpose,const GLfloat *value);
+    void enable(GLenum cap);
+    void disable(GLenum cap);
+    void depthMask(GLboolean flag);
+    void depthFunc(GLenum func);
+    void blendFunc(GLenum sfactor,GLenum dfactor);
+    void lineWidth(GLfloat width);
+    void viewport(GLint x,GLint y,GLsizei width,GLsizei height);
+    void clearColor(GLclampf red,GLclampf green,GLclampf blue,GLclampf alpha);
+    void clear(GLbitfield mask);
+    void genFramebuffers(GLsizei n,GLuint *framebuffers);
+    void deleteFramebuffers(GLsizei n,const GLuint *framebuffers);
+    void bindFramebuffer(GLenum target,GLuint framebuffer);
+    void framebufferRenderbuffer(GLenum target,GLenum attachment,GLenum renderbuffertarget,GLuint renderbuffer);
+    void framebufferTexture2D(GLenum target,GLenum attachment,GLenum textarget,GLuint texture,GLint level);
+    GLenum checkFramebufferStatus(GLenum target);
+    void genRenderbuffers(GLsizei n,GLuint *renderbuffers);
+    void deleteRenderbuffers(GLsizei n,const GLuint *renderbuffers);
+    void bindRenderbuffer(GLenum target,GLuint renderbuffer);
+    void renderbufferStorage(GLenum target,GLenum internalformat,GLsizei width,GLsizei height);
+    void getRenderbufferParameteriv(GLenum target,GLenum pname,GLint *params);
+    void discardFramebuffer(GLenum target,GLsizei numAttachments,const GLenum *attachments);
+    void drawArrays(GLenum mode,GLint first,GLsizei count);
+    void drawElements(GLenum mode,GLsizei count,GLenum type,const GLvoid *indices);
+    void flush();
+    void finish();
+    GLenum getError();
+    void getIntegerv(GLenum pname,GLint *params);
+    const GLubyte *getString(GLenum name);
+};
+
+/// The backend everyone's using right now
+extern GLBackend *CurrentGLBackend;
+/// Set once any thread has its own backend
+extern bool GLThreadBackendsInUse;
+
+/// Return the calling thread's own backend or the global one
+GLBackend *GetThreadGLBackend();
+
+/// Return the backend to send OpenGL calls to.
+/// That's the global one unless a thread has been given its own.
+inline GLBackend *GetGLBackend() { return GLThreadBackendsInUse ? GetThreadGLBackend() : CurrentGLBackend; }
+
+/// Switch to a different backend, or pass NULL for the normal one.
+/// Do this before anything is set up, since GL resources don't move between backends.
+/// You keep ownership of the backend.
+void SetGLBackend(GLBackend *backend);
+
+/// Send the calling thread's OpenGL calls to the given backend, or pass NULL to
+///  go back to the global one.  Like an EAGLContext, this is per thread.
+/// This is how the renderer records a frame on a thread without a context.
+void SetThreadGLBackend(GLBackend *backend);
+
+}
@@ -0,0 +1,196 @@
+/*
+ *  GLCommandList.h
+ *  WhirlyGlobeLib
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <vector>
+#import "GLBackend.h"
+
+namespace WhirlyKit
+{
+
+/** A list of OpenGL calls saved up to replay later.
+    Recording doesn't need a GL context, so a frame can be put together on one
+    thread and then handed over to the thread with the context, which just replays it.
+    Calls that send data (uniforms, buffers, textures, client side indices) copy it.
+    Pointers to vertex arrays in client memory are kept as is, so whatever they
+    point into has to stay put until the list is replayed.
+    Calls that need an answer from OpenGL can't be recorded.  New names come out
+    of a reserve that's filled in from the context's thread ahead of time.
+    Anything else that needs an answer is dropped and counted.
+  */
+class GLCommandList : public GLBackend
+{
+public:
+    GLCommandList();
+    virtual ~GLCommandList();
+    
+    /// Get rid of the recorded calls, but keep the name reserve
+    void clear();
+    
+    /// Make sure we've got at least this many buffer, texture and vertex array names to
+    ///  hand out while recording.  Call this on the thread with the context.
+    void reserveNames(GLBackend *backend,int numNames);
+    
+    /// Give any names we didn't hand out back to the given backend
+    void releaseNames(GLBackend *backend);
+    
+    /// Make the recorded calls on the given backend
+    void replay(GLBackend *backend) const;
+    
+    /// Number of calls recorded
+    int getNumCommands() const { return (int)commands.size(); }
+    
+    /// Number of calls we couldn't record since the last clear
+    int getNumDropped() const { return numDropped; }
+    
+    /// Set if the reserve ran out of names since the last clear
+    bool ranOutOfNames() const { return outOfNames; }
+    
+    void genBuffers(GLsizei n,GLuint *buffers);
+    void deleteBuffers(GLsizei n,const GLuint *buffers);
+    void bindBuffer(GLenum target,GLuint buffer);
+    void bufferData(GLenum target,GLsizeiptr size,const GLvoid *data,GLenum usage);
+    void bufferSubData(GLenum target,GLintptr offset,GLsizeiptr size,const GLvoid *data);
+    GLvoid *mapBuffer(GLenum target,GLenum access);
+    GLboolean unmapBuffer(GLenum target);
+    void genVertexArrays(GLsizei n,GLuint *arrays);
+    void deleteVertexArrays(GLsizei n,const GLuint *arrays);
+    void bindVertexArray(GLuint array);
+    void enableVertexAttribArray(GLuint index);
+    void disableVertexAttribArray(GLuint index);
+    void vertexAttribPointer(GLuint index,GLint size,GLenum type,GLboolean normalized,GLsizei stride,const GLvoid *ptr);
+    void vertexAttrib1f(GLuint index,GLfloat x);
+    void vertexAttrib2f(GLuint index,GLfloat x,GLfloat y);
+    void vertexAttrib3f(GLuint index,GLfloat x,GLfloat y,GLfloat z);
+    void vertexAttrib4f(GLuint index,GLfloat x,GLfloat y,GLfloat z,GLfloat w);
+    void genTextures(GLsizei n,GLuint *textures);
+    void deleteTextures(GLsizei n,const GLuint *textures);
+    void activeTexture(GLenum texture);
+    void bindTexture(GLenum target,GLuint texture);
+    void texParameteri(GLenum target,GLenum pname,GLint param);
+    void texImage2D(GLenum target,GLint level,GLint internalformat,GLsizei width,GLsizei height,GLint border,GLenum format,GLenum type,const GLvoid *pixels);
+    void texSubImage2D(GLenum target,GLint level,GLint xoffset,GLint yoffset,GLsizei width,GLsizei height,GLenum format,GLenum type,const GLvoid *pixels);
+    void compressedTexImage2D(GLenum target,GLint level,GLenum internalformat,GLsizei width,GLsizei height,GLint border,GLsizei imageSize,const GLvoid *data);
+    void compressedTexSubImage2D(GLenum target,GLint level,GLint xoffset,GLint yoffset,GLsizei width,GLsizei height,GLenum format,GLsizei imageSize,const GLvoid *data);
+    void copyTexSubImage2D(GLenum target,GLint level,GLint xoffset,GLint yoffset,GLint x,GLint y,GLsizei width,GLsizei height);
+    void generateMipmap(GLenum target);
+    GLuint createShader(GLenum type);
+    void shaderSource(GLuint shader,GLsizei count,const GLchar **string,const GLint *length);
+    void compileShader(GLuint shader);
+    void getShaderiv(GLuint shader,GLenum pname,GLint *params);
+    void getShaderInfoLog(GLuint shader,GLsizei bufsize,GLsizei *length,GLchar *infolog);
+    void deleteShader(GLuint shader);
+    GLuint createProgram();
+    void attachShader(GLuint program,GLuint shader);
+    void linkProgram(GLuint program);
+    void validateProgram(GLuint program);
+    void getProgramiv(GLuint program,GLenum pname,GLint *params);
+    void getProgramInfoLog(GLuint program,GLsizei bufsize,GLsizei *length,GLchar *infolog);
+    void deleteProgram(GLuint program);
+    void useProgram(GLuint program);
+    void getActiveUniform(GLuint program,GLuint index,GLsizei bufsize,GLsizei *length,GLint *size,GLenum *type,GLchar *name);
+    void getActiveAttrib(GLuint program,GLuint index,GLsizei bufsize,GLsizei *length,GLint *size,GLenum *type,GLchar *name);
+    int getUniformLocation(GLuint program,const GLchar *name);
+    int getAttribLocation(GLuint program,const GLchar *name);
+    void uniform1i(GLint location,GLint x);
+    void uniform1f(GLint location,GLfloat x);
+    void uniform2f(GLint location,GLfloat x,GLfloat y);
+    void uniform3f(GLint location,GLfloat x,GLfloat y,GLfloat z);
+    void uniform4f(GLint location,GLfloat x,GLfloat y,GLfloat z,GLfloat w);
+    void uniformMatrix4fv(GLint location,GLsizei count,GLboolean transpose,const GLfloat *value);
+    void enable(GLenum cap);
+    void disable(GLenum cap);
+    void depthMask(GLboolean flag);
+    void depthFunc(GLenum func);
+    void blendFunc(GLenum sfactor,GLenum dfactor);
+    void lineWidth(GLfloat width);
+    void viewport(GLint x,GLint y,GLsizei width,GLsizei height);
+    void clearColor(GLclampf red,GLclampf green,GLclampf blue,GLclampf alpha);
+    void clear(GLbitfield mask);
+    void genFramebuffers(GLsizei n,GLuint *framebuffers);
+    void deleteFramebuffers(GLsizei n,const GLuint *framebuffers);
+    void bindFramebuffer(GLenum target,GLuint framebuffer);
+    void framebufferRenderbuffer(GLenum target,GLenum attachment,GLenum renderbuffertarget,GLuint renderbuffer);
+    void framebufferTexture2D(GLenum target,GLenum attachment,GLenum textarget,GLuint texture,GLint level);
+    GLenum checkFramebufferStatus(GLenum target);
+    void genRenderbuffers(GLsizei n,GLuint *renderbuffers);
+    void deleteRenderbuffers(GLsizei n,const GLuint *renderbuffers);
+    void bindRenderbuffer(GLenum target,GLuint renderbuffer);
+    void renderbufferStorage(GLenum target,GLenum internalformat,GLsizei width,GLsizei height);
+    void getRenderbufferParameteriv(GLenum target,GLenum pname,GLint *params);
+    void discardFramebuffer(GLenum target,GLsizei numAttachments,const GLenum *attachments);
+    void drawArrays(GLenum mode,GLint first,GLsizei count);
+    void drawElements(GLenum mode,GLsizei count,GLenum type,const GLvoid *indices);
+    void flush();
+    void finish();
+    GLenum getError();
+    void getIntegerv(GLenum pname,GLint *params);
+    const GLubyte *getString(GLenum name);
+    
+protected:
+    /// The calls we can record
+    typedef enum {
+        CmdDeleteBuffers,CmdBindBuffer,CmdBufferData,CmdBufferSubData,
+        CmdDeleteVertexArrays,CmdBindVertexArray,
+        CmdEnableVertexAttribArray,CmdDisableVertexAttribArray,CmdVertexAttribPointer,
+        CmdVertexAttrib1f,CmdVertexAttrib2f,CmdVertexAttrib3f,CmdVertexAttrib4f,
+        CmdDeleteTextures,CmdActiveTexture,CmdBindTexture,CmdTexParameteri,CmdTexImage2D,CmdTexSubImage2D,
+        CmdCompressedTexImage2D,CmdCompressedTexSubImage2D,CmdCopyTexSubImage2D,CmdGenerateMipmap,
+        CmdDeleteShader,CmdDeleteProgram,CmdUseProgram,
+        CmdUniform1i,CmdUniform1f,CmdUniform2f,CmdUniform3f,CmdUniform4f,CmdUniformMatrix4fv,
+        CmdEnable,CmdDisable,CmdDepthMask,CmdDepthFunc,CmdBlendFunc,CmdLineWidth,CmdViewport,CmdClearColor,CmdClear,
+        CmdDeleteFramebuffers,CmdBindFramebuffer,CmdFramebufferRenderbuffer,CmdFramebufferTexture2D,
+        CmdDeleteRenderbuffers,CmdBindRenderbuffer,CmdRenderbufferStorage,CmdDiscardFramebuffer,
+        CmdDrawArrays,CmdDrawElements,CmdFlush,CmdFinish
+    } CommandType;
+    
+    /// One recorded call.  Anything that doesn't fit in the arguments goes in the payload.
+    class Command
+    {
+    public:
+        CommandType type;
+        union {
+            GLint i;
+            GLuint u;
+            GLfloat f;
+        } args[8];
+        /// Client side pointer, passed through as is
+        const GLvoid *ptr;
+    };
+    
+    // Start a new command
+    Command &add(CommandType type);
+    // Copy data into the payload and return the offset to it
+    GLuint addPayload(const void *data,size_t len);
+    // Pull a name out of the given reserve
+    void takeNames(std::vector<GLuint> &reserve,GLsizei n,GLuint *names);
+    
+    std::vector<Command> commands;
+    std::vector<unsigned char> payload;
+    int numDropped;
+    bool outOfNames;
+    
+    // Names generated ahead of time by the context's thread
+    std::vector<GLuint> bufferNames,textureNames,vertexArrayNames;
+    
+    // What we think is bound, so we can tell client side indices from buffer offsets
+    GLuint vertexArray,elementBuffer;
+};
+
+}
@@ -0,0 +1,108 @@
+/*
+ *  GLStateOptimizer.h
+ *  WhirlyGlobeLib
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import "GLBackend.h"
+
+namespace WhirlyKit
+{
+
+/** Keeps track of the OpenGL ES state we've set and skips calls that
+    would set it to what it already is.  Everything goes through GetGLBackend().
+    This is the guts of WhirlyKitOpenGLStateOptimizer, which the renderer
+    hands to the drawables.  It's plain C++ so it can be run without a GPU.
+  */
+class OpenGLStateOptimizer
+{
+public:
+    /// Texture units we'll keep track of bindings for
+    static const int MaxTrackedTextureUnits = 8;
+
+    OpenGLStateOptimizer();
+
+    /// Calls glActiveTexture
+    void setActiveTexture(GLenum activeTexture);
+
+    /// Calls glDepthMask
+    void setDepthMask(bool depthMask);
+
+    /// Calls glEnable(GL_DEPTH_TEST) or glDisable(GL_DEPTH_TEST)
+    void setEnableDepthTest(bool enable);
+
+    /// Calls glDepthFunc
+    void setDepthFunc(GLenum depthFunc);
+
+    /// Calls glUseProgram
+    void setUseProgram(GLuint progId);
+
+    /// Calls glLineWidth
+    void setLineWidth(GLfloat lineWidth);
+
+    /// Calls glBindTexture(GL_TEXTURE_2D) for the active texture unit
+    void setBoundTexture(GLuint texId);
+
+    /// Calls glBindVertexArrayOES
+    void setVertexArray(GLuint vertArrayObj);
+
+    /// Calls glBindBuffer(GL_ARRAY_BUFFER)
+    void setArrayBuffer(GLuint bufferId);
+
+    /// Calls glBindBuffer(GL_ELEMENT_ARRAY_BUFFER).
+    /// This is part of the vertex array state, so it's forgotten when that changes.
+    void setElementArrayBuffer(GLuint bufferId);
+
+    /// Calls glEnable(GL_BLEND) or glDisable(GL_BLEND)
+    void setEnableBlend(bool enable);
+
+    /// Calls glBlendFunc
+    void setBlendFunc(GLenum srcFactor,GLenum dstFactor);
+
+    /// Forget everything we've set
+    void reset();
+
+    /// Forget the program, texture, buffer and vertex array bindings.
+    /// Anything that binds those directly (like setting up resources) throws
+    ///  us off, so call this after doing that.
+    void resetBindings();
+
+    /// Called by the renderer before it draws a frame.
+    /// Changes may have bound things since the last one, so this resets the bindings.
+    void beginFrame();
+
+    /// Called by the renderer once it's drawn a frame.
+    /// Drawables leave their VAO bound.  Scene changes bind element buffers,
+    ///  which would land in that VAO, so this puts VAO 0 back.
+    void endFrame();
+
+protected:
+    int activeTexture;
+    int depthMask;
+    int depthTest;
+    int progId;
+    int depthFunc;
+    GLfloat lineWidth;
+    int boundTextures[MaxTrackedTextureUnits];
+    int vertArrayObj;
+    int arrayBuffer;
+    int elementArrayBuffer;
+    int blend;
+    int blendSrc,blendDst;
+};
+
+}
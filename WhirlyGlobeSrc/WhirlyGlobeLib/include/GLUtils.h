@@ -22,6 +22,7 @@
 #import <OpenGLES/ES1/glext.h>
 #import <OpenGLES/ES2/gl.h>
 #import <OpenGLES/ES2/glext.h>
+#import "GLBackend.h"
 
 /// Check for a GL error and print (NSLog) a message
 bool CheckGLError(const char *msg);
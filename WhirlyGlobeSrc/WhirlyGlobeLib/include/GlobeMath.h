@@ -96,6 +96,9 @@ public:
     /// This system is round
     bool isFlat() { return false; }
     
+    /// It's a sphere of radius 1.0
+    bool getEllipsoidRadii(Point3d &radii) { radii = Point3d(1.0,1.0,1.0);  return true; }
+    
 protected:
     GeoCoordSystem geoCoordSys;
 };
@@ -136,6 +139,9 @@ public:
     
     /// This system is round
     bool isFlat() { return false; }
+    
+    /// WGS84, scaled down by EarthRadius like everything else
+    bool getEllipsoidRadii(Point3d &radii);
 
 protected:
     GeoCoordSystem geoCoordSys;
@@ -145,4 +151,17 @@ protected:
 // Returns negative if the given location (with its normal) is currently facing away from the viewer
 float CheckPointAndNormFacing(const Point3f &dispLoc,const Point3f &norm,const Eigen::Matrix4f &viewAndModelMat,const Eigen::Matrix4f &viewModelNormalMat);
 
+/** Horizon culling works in a scaled space where the ellipsoid is a unit sphere.
+    Divide display coordinates by the ellipsoid radii to get there.
+    A patch of the globe gets a single point that's hidden behind the
+    horizon only if the whole patch is.  This works out that point for a patch
+    that's within maxAngle of the given direction (in scaled space) and
+    no more than maxRadius from the center.
+    Returns false if there's no such point, which happens when the patch is too big.
+  */
+bool CalcHorizonCullPoint(const Point3d &dir,double maxAngle,double maxRadius,Point3d &cullPt);
+
+/// Returns true if the point is behind the horizon as seen from the eye.  Both are in scaled space.
+bool IsBelowHorizon(const Point3d &eyePt,const Point3d &pt);
+
 }
@@ -64,6 +64,7 @@ public:
 	/// Generate a new ID without an object.
     /// We use this in cases where we're going to be creating an
     ///  Identifiable subclass, but haven't yet.
+    /// This is safe from any thread.  IDs are unique, but only increase within a thread.
 	static SimpleIdentity genId();
     
     /// Used for sorting
@@ -0,0 +1,181 @@
+/*
+ *  IdentityTable.h
+ *  WhirlyGlobeLib
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <vector>
+#import "Identifiable.h"
+
+namespace WhirlyKit
+{
+
+/** The identity table maps SimpleIdentity to a value in constant time.
+    Values live in a dense array, so walking through them is cheap, and
+    an open addressed hash index (linear probing) points into that array.
+    A lookup is a hash and usually one probe, with no allocation.
+    IDs are never reused, so a stale ID just comes back empty.
+    There's no locking in here.  If more than one thread is involved, that's up to you.
+  */
+template<typename T> class IdentityTable
+{
+public:
+    /// One entry in the dense array
+    class Entry
+    {
+    public:
+        SimpleIdentity id;
+        T val;
+    };
+
+    IdentityTable() : numSlotBits(0) { resizeIndex(6); }
+
+    /// Number of entries
+    unsigned int size() const { return (unsigned int)entries.size(); }
+    bool empty() const { return entries.empty(); }
+
+    /// Entries in no particular order.  The order changes when you erase.
+    Entry &operator[](unsigned int which) { return entries[which]; }
+    const Entry &operator[](unsigned int which) const { return entries[which]; }
+
+    /// Add or replace the value for the given ID
+    void insert(SimpleIdentity id,const T &val)
+    {
+        int slot = findSlot(id);
+        if (slots[slot].which >= 0)
+        {
+            entries[slots[slot].which].val = val;
+            return;
+        }
+
+        Entry entry;
+        entry.id = id;
+        entry.val = val;
+        entries.push_back(entry);
+        slots[slot].id = id;
+        slots[slot].which = (int)entries.size()-1;
+
+        // Keep the load under 1/2 so probes stay short
+        if (2*entries.size() > slots.size())
+            resizeIndex(numSlotBits+1);
+    }
+
+    /// Look for the value.  Returns NULL if it's not here.
+    /// The pointer is good until the next insert or erase.
+    T *find(SimpleIdentity id)
+    {
+        int which = slots[findSlot(id)].which;
+        return which >= 0 ? &entries[which].val : NULL;
+    }
+    const T *find(SimpleIdentity id) const
+    {
+        int which = slots[findSlot(id)].which;
+        return which >= 0 ? &entries[which].val : NULL;
+    }
+
+    /// Remove the entry for the ID.  Returns false if it wasn't here.
+    bool erase(SimpleIdentity id)
+    {
+        int slot = findSlot(id);
+        int which = slots[slot].which;
+        if (which < 0)
+            return false;
+
+        // Move the last entry into the hole
+        int last = (int)entries.size()-1;
+        if (which != last)
+        {
+            entries[which] = entries[last];
+            slots[findSlot(entries[which].id)].which = which;
+        }
+        entries.pop_back();
+
+        // Shift back anything in the probe run that can move up, so we don't need tombstones
+        unsigned int mask = (unsigned int)slots.size()-1;
+        unsigned int hole = slot;
+        for (unsigned int next = (hole+1) & mask; slots[next].which >= 0; next = (next+1) & mask)
+        {
+            unsigned int home = hashSlot(slots[next].id);
+            // Can this one go in the hole?  Only if the hole is between its home and where it is now.
+            if (((next - home) & mask) >= ((next - hole) & mask))
+            {
+                slots[hole] = slots[next];
+                hole = next;
+            }
+        }
+        slots[hole].id = EmptyIdentity;
+        slots[hole].which = -1;
+
+        return true;
+    }
+
+    /// Bytes we're using for the entries and index
+    size_t getMemoryUsage() const { return slots.capacity()*sizeof(Slot) + entries.capacity()*sizeof(Entry); }
+
+    /// Get rid of everything
+    void clear()
+    {
+        entries.clear();
+        resizeIndex(6);
+    }
+
+protected:
+    // One slot in the hash index
+    class Slot
+    {
+    public:
+        Slot() : id(EmptyIdentity), which(-1) { }
+        SimpleIdentity id;
+        int which;
+    };
+
+    // Fibonacci hash.  IDs are mostly sequential so we need to spread them out.
+    unsigned int hashSlot(SimpleIdentity id) const
+    {
+        return (unsigned int)((id * 11400714819323198485ULL) >> (64 - numSlotBits));
+    }
+
+    // Slot holding the ID or the empty one where it would go
+    int findSlot(SimpleIdentity id) const
+    {
+        unsigned int mask = (unsigned int)slots.size()-1;
+        unsigned int slot = hashSlot(id);
+        while (slots[slot].which >= 0 && slots[slot].id != id)
+            slot = (slot+1) & mask;
+        return slot;
+    }
+
+    // Rebuild the index with 2^bits slots
+    void resizeIndex(int bits)
+    {
+        numSlotBits = bits;
+        slots.clear();
+        slots.resize(1<<bits);
+        for (unsigned int ii=0;ii<entries.size();ii++)
+        {
+            int slot = findSlot(entries[ii].id);
+            slots[slot].id = entries[ii].id;
+            slots[slot].which = ii;
+        }
+    }
+
+    int numSlotBits;
+    std::vector<Slot> slots;
+    std::vector<Entry> entries;
+};
+
+}
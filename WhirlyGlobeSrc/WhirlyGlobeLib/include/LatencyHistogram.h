@@ -0,0 +1,166 @@
+/*
+ *  LatencyHistogram.h
+ *  WhirlyGlobeLib
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <pthread.h>
+#import <stdint.h>
+#import <string>
+#import <vector>
+
+namespace WhirlyKit
+{
+
+/** A histogram of durations in microseconds, laid out the way HDR histograms are.
+    Each power of two range gets the same number of buckets, so we keep
+    about 1% precision from a microsecond out to an hour in a fixed amount of memory.
+    Two histograms merge by adding their buckets, so each thread can keep its own.
+    Not thread safe on its own.
+  */
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+    
+    /// Largest value we'll track, in microseconds.  Anything bigger lands here.
+    static const uint64_t MaxValue = 0xffffffffULL;
+    
+    /// Add a duration in microseconds
+    void record(uint64_t micros);
+    
+    /// Add all of another histogram's values to this one
+    void merge(const LatencyHistogram &that);
+    
+    /// Toss everything
+    void clear();
+    
+    /// Number of values recorded
+    uint64_t getCount() const { return totalCount; }
+    /// Smallest value recorded.  0 if there's nothing.
+    uint64_t getMin() const { return totalCount ? minValue : 0; }
+    /// Largest value recorded
+    uint64_t getMax() const { return maxValue; }
+    /// Average of the values recorded
+    double getMean() const;
+    
+    /// The value at or below which the given percentage (0-100) of values fall.
+    /// Reported as the top of the bucket it's in, but never more than the max.
+    uint64_t valueAtPercentile(double percentile) const;
+    
+protected:
+    static int countsIndex(uint64_t value);
+    static uint64_t highestEquivalentValue(int index);
+    
+    std::vector<uint64_t> counts;
+    uint64_t totalCount;
+    uint64_t minValue,maxValue;
+    double total;
+};
+
+/** A named duration we keep a histogram for.
+    Like a ProfileZone, declare these static, at file scope, with a literal for the name.
+  */
+class LatencyMetric
+{
+public:
+    LatencyMetric(const char *name);
+    
+    /// Name we'll report it under
+    const char *name;
+    /// Index into the table of metrics
+    int metricId;
+};
+
+/// Percentiles and such for one metric, all in microseconds
+typedef struct
+{
+    std::string name;
+    uint64_t count;
+    double mean;
+    uint64_t min,p50,p95,p99,max;
+} LatencySummary;
+
+/** Collects latency histograms from all the threads.
+    Each thread records into its own histograms.  Every so often those are
+    merged into a snapshot of the interval that just ended and into a running
+    total since we started (or were last reset).  Pull either one out with
+    getHistogram() or getSummaries().
+  */
+class LatencyMetrics
+{
+public:
+    /// Which set of data we want
+    typedef enum {LastInterval,SinceStart} Window;
+    
+    /// Turn recording on or off.  It's on by default.
+    static void setEnabled(bool enable);
+    /// True if we're recording
+    static bool isEnabled() { return enabled; }
+    
+    /// Current time in the units startTime() and recordSince() use
+    static uint64_t startTime();
+    /// Add a duration in microseconds for the given metric
+    static void record(const LatencyMetric &metric,uint64_t micros) { if (enabled) recordAlways(metric.metricId,micros); }
+    /// Add the time since startTime() was called
+    static void recordSince(const LatencyMetric &metric,uint64_t start);
+    
+    /// How often snapshotIfDue() closes out an interval, in seconds.  Defaults to 5s.
+    static void setSnapshotInterval(double seconds);
+    /// Close out the current interval, if it's been long enough.
+    /// The renderer calls this every frame.
+    static bool snapshotIfDue();
+    /// Close out the current interval now
+    static void snapshot();
+    /// Length in seconds of the last interval we closed out
+    static double getLastIntervalLength();
+    
+    /// Copy out the histogram for a metric.  Returns false if there isn't one.
+    static bool getHistogram(const char *name,Window window,LatencyHistogram &hist);
+    /// Summarize every metric that has data
+    static void getSummaries(Window window,std::vector<LatencySummary> &summaries);
+    
+    /// Toss everything, including the running total
+    static void reset();
+    
+    /// Per thread storage.  Internal.
+    class ThreadHistograms;
+    
+protected:
+    static void recordAlways(int metricId,uint64_t micros);
+    static ThreadHistograms *getThreadHistograms();
+    
+    static volatile bool enabled;
+};
+
+/// Records the time from construction to the end of the enclosing scope
+class LatencyScope
+{
+public:
+    LatencyScope(const LatencyMetric &metric) : metric(metric), start(LatencyMetrics::isEnabled() ? LatencyMetrics::startTime() : 0) { }
+    ~LatencyScope()
+    {
+        if (start)
+            LatencyMetrics::recordSince(metric,start);
+    }
+    
+protected:
+    const LatencyMetric &metric;
+    uint64_t start;
+};
+
+}
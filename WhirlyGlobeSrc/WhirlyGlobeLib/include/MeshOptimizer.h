@@ -0,0 +1,48 @@
+/*
+ *  MeshOptimizer.h
+ *  WhirlyGlobeLib
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <vector>
+#import <OpenGLES/ES2/gl.h>
+
+namespace WhirlyKit
+{
+
+/** These routines reorder triangle meshes so the GPU does less work.
+    They operate on plain triangle lists (three indices per triangle)
+    and don't care where the vertex data lives.
+    Look to BasicDrawable::optimizeMesh() to run them on a drawable.
+  */
+
+/// Reorder the triangles for post transform vertex cache reuse.
+/// This is Tom Forsyth's linear speed algorithm.  The winding of
+///  each triangle is preserved.
+void OptimizeVertexCache(std::vector<GLuint> &indices,unsigned int numVerts);
+
+/// Renumber the vertices in the order the triangles first use them.
+/// The indices are rewritten and newToOld comes back with the old vertex
+///  for each new one.  Vertices that aren't used go at the end.
+void OptimizeVertexFetch(std::vector<GLuint> &indices,unsigned int numVerts,std::vector<GLuint> &newToOld);
+
+/// Simulate a FIFO post transform cache of the given size and return
+///  the average cache miss ratio: transformed vertices per triangle.
+/// 3.0 is the worst, around 0.5 is very good for a regular grid.
+float CalcACMR(const std::vector<GLuint> &indices,unsigned int cacheSize=16);
+
+}
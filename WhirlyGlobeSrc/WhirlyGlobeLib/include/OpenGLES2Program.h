@@ -101,6 +101,10 @@ typedef struct
 } AttributeNameSortStruct;
 
 
+/// Uniforms the standard drawables set on every draw.
+/// The program looks these up once, when it's built.
+typedef enum {StdUniformMVPMatrix,StdUniformMVMatrix,StdUniformMVNormalMatrix,StdUniformOctNormals,StdUniformFade,StdUniformHasTexture,StdUniformEyeVec,StdUniformBaseMap,StdUniformNumLights,StdUniformMax} StandardUniform;
+
 /** Representation of an OpenGL ES 2.0 program.  It's an identifiable so we can
     point to it generically.  Otherwise, pretty basic.
  */
@@ -111,7 +115,7 @@ public:
     virtual ~OpenGLES2Program();
     
     /// Used only for comparison
-    OpenGLES2Program(SimpleIdentity theId) : Identifiable(theId), lightsLastUpdated(0.0) { }
+    OpenGLES2Program(SimpleIdentity theId) : Identifiable(theId), lightsLastUpdated(0.0) { clearStandardUniforms(); }
 
     /// Initialize with both shader programs
     OpenGLES2Program(const std::string &name,const std::string &vShaderString,const std::string &fShaderString);
@@ -131,6 +135,26 @@ public:
     bool setUniform(const std::string &name,const Eigen::Matrix4f &mat);
     bool setUniform(const std::string &name,int val);
     
+    /// Return one of the standard uniforms.  NULL if the program doesn't have it.
+    OpenGLESUniform *getUniform(StandardUniform which) { return stdUniforms[which]; }
+
+    /// Set a uniform we've already looked up.  NULL is fine, that just returns false.
+    /// Use these in anything that runs per drawable.
+    bool setUniform(OpenGLESUniform *uni,float val);
+    bool setUniform(OpenGLESUniform *uni,const Eigen::Vector2f &vec);
+    bool setUniform(OpenGLESUniform *uni,const Eigen::Vector3f &vec);
+    bool setUniform(OpenGLESUniform *uni,const Eigen::Vector4f &vec);
+    bool setUniform(OpenGLESUniform *uni,const Eigen::Matrix4f &mat);
+    bool setUniform(OpenGLESUniform *uni,int val);
+    
+    /// Set one of the standard uniforms
+    bool setUniform(StandardUniform which,float val) { return setUniform(stdUniforms[which],val); }
+    bool setUniform(StandardUniform which,const Eigen::Vector2f &vec) { return setUniform(stdUniforms[which],vec); }
+    bool setUniform(StandardUniform which,const Eigen::Vector3f &vec) { return setUniform(stdUniforms[which],vec); }
+    bool setUniform(StandardUniform which,const Eigen::Vector4f &vec) { return setUniform(stdUniforms[which],vec); }
+    bool setUniform(StandardUniform which,const Eigen::Matrix4f &mat) { return setUniform(stdUniforms[which],mat); }
+    bool setUniform(StandardUniform which,int val) { return setUniform(stdUniforms[which],val); }
+    
     /// Check for the specific attribute associated with WhirlyKit lights
     bool hasLights();
     
@@ -151,6 +175,8 @@ public:
     void cleanUp();
 
 protected:
+    void clearStandardUniforms();
+    
     std::string name;
     GLuint program;
     GLuint vertShader;
@@ -158,6 +184,8 @@ protected:
     CFTimeInterval lightsLastUpdated;
     // Uniforms sorted for fast lookup
     std::set<OpenGLESUniform *,UniformNameSortStruct> uniforms;
+    // Standard uniforms, looked up at link time
+    OpenGLESUniform *stdUniforms[StdUniformMax];
     // Attributes sorted for fast lookup
     std::set<OpenGLESAttribute *,AttributeNameSortStruct> attrs;
 };
@@ -0,0 +1,126 @@
+/*
+ *  Profiler.h
+ *  WhirlyGlobeLib
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <pthread.h>
+#import <stdint.h>
+#import <string>
+
+namespace WhirlyKit
+{
+
+/** A named spot in the code we want to time, or a named counter.
+    Declare these static, at file scope, so they're set up once when
+    the library loads.  The name has to stick around, so use a literal.
+  */
+class ProfileZone
+{
+public:
+    ProfileZone(const char *name);
+    
+    /// Name we'll show in the trace
+    const char *name;
+    /// Index into the profiler's table of zones
+    int zoneId;
+};
+
+/** A low overhead profiler for seeing what all the threads are up to.
+    Each thread records begin/end events for zones and counter values into
+    its own ring buffer, so nobody waits on a lock.  When the buffer fills
+    up the oldest events go.  Export the lot as a Chrome trace
+    (chrome://tracing) to look at it.
+    When it's off, a zone costs a check of one flag.
+  */
+class Profiler
+{
+public:
+    /// What happened
+    typedef enum {EventBegin,EventEnd,EventCount} EventType;
+
+    /// One entry in a thread's ring buffer
+    typedef struct
+    {
+        uint64_t time;
+        int32_t value;
+        uint16_t zoneId;
+        uint8_t type;
+    } Event;
+    
+    /// Turn recording on or off
+    static void setEnabled(bool enable);
+    /// True if we're recording
+    static bool isEnabled() { return enabled; }
+    
+    /// Number of events each thread keeps.  Only affects threads that haven't recorded yet.
+    static void setEventsPerThread(int numEvents);
+    
+    /// Name the calling thread in the trace.  Threads are named after their pthread otherwise.
+    static void setThreadName(const char *name);
+    
+    /// Record the start of a zone on this thread.
+    /// Use a ProfileScope instead, unless the zone doesn't fit in one scope.
+    static void begin(const ProfileZone &zone) { if (enabled) record(zone.zoneId,EventBegin,0); }
+    /// Record the end of a zone on this thread
+    static void end(const ProfileZone &zone) { if (enabled) record(zone.zoneId,EventEnd,0); }
+    /// Record a counter value
+    static void count(const ProfileZone &zone,int value) { if (enabled) record(zone.zoneId,EventCount,value); }
+    
+    /// Toss everything recorded so far
+    static void clear();
+    
+    /// Write out everything recorded as Chrome trace JSON
+    static void exportChromeTrace(std::string &json);
+    /// Write the Chrome trace to a file.  Returns false if we couldn't.
+    static bool writeChromeTrace(const char *fileName);
+    
+    /// Per thread storage.  Internal.
+    class ThreadBuffer;
+    
+protected:
+    friend class ProfileZone;
+    friend class ProfileScope;
+    /// Ends a zone even if we were turned off since it began
+    static void endAlways(const ProfileZone &zone) { record(zone.zoneId,EventEnd,0); }
+    static void record(int zoneId,EventType type,int value);
+    static ThreadBuffer *getThreadBuffer();
+    
+    static volatile bool enabled;
+};
+    
+/// Times a zone from construction to the end of the enclosing scope
+class ProfileScope
+{
+public:
+    ProfileScope(const ProfileZone &zone) : zone(zone), active(Profiler::isEnabled())
+    {
+        if (active)
+            Profiler::begin(zone);
+    }
+    ~ProfileScope()
+    {
+        if (active)
+            Profiler::endAlways(zone);
+    }
+    
+protected:
+    const ProfileZone &zone;
+    bool active;
+};
+
+}
@@ -59,6 +59,11 @@ float ScreenImportance(WhirlyKitViewState *viewState,WhirlyKit::Point2f frameSiz
 @property (nonatomic,assign) std::vector<Eigen::Vector3d> &normals;
 /// Normals for the surface.  We use these to make sure the solid is pointing towards us.
 @property (nonatomic,assign) std::vector<Eigen::Vector3d> &surfNormals;
+/// Set if there's a horizon culling point for the solid
+@property (nonatomic,assign) bool hasHorizonPt;
+/// If this is hidden behind the horizon, so is the whole solid.
+/// It's in the space where the globe's ellipsoid is a unit sphere.
+@property (nonatomic,assign) WhirlyKit::Point3d horizonPt;
 
 /// Create a display solid, including height.
 + (WhirlyKitDisplaySolid *)displaySolidWithNodeIdent:(WhirlyKit::Quadtree::Identifier &)nodeIdent mbr:(WhirlyKit::Mbr)nodeMbr minZ:(float)minZ maxZ:(float)maxZ srcSystem:(WhirlyKit::CoordSystem *)srcSystem adapter:(WhirlyKit::CoordSystemDisplayAdapter *)coordAdapter;
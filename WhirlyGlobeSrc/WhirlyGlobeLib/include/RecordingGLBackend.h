@@ -0,0 +1,260 @@
+/*
+ *  RecordingGLBackend.h
+ *  WhirlyGlobeLib
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <pthread.h>
+#import <vector>
+#import <map>
+#import <string>
+#import "GLBackend.h"
+
+namespace WhirlyKit
+{
+
+/** A GL backend that doesn't draw anything.  It hands out names, keeps track of
+    what's bound and counts every call, optionally with timestamps.
+    getIntegerv reports the program, buffer, vertex array and texture bindings.
+    That's enough to run the whole render path without a GPU, for benchmarks or
+    to see how much state churn the renderer causes.
+    Programs report the uniforms and attributes declared in their shaders,
+    so the code looking them up works the same as it would with a real driver.
+    It's thread safe, since the layer thread sets things up while the renderer draws.
+  */
+class RecordingGLBackend : public GLBackend
+{
+public:
+    /// All the calls we know about, one for each method
+    typedef enum {
+        GLCmdGenBuffers,GLCmdDeleteBuffers,GLCmdBindBuffer,GLCmdBufferData,GLCmdBufferSubData,GLCmdMapBuffer,
+        GLCmdUnmapBuffer,GLCmdGenVertexArrays,GLCmdDeleteVertexArrays,GLCmdBindVertexArray,GLCmdEnableVertexAttribArray,GLCmdDisableVertexAttribArray,
+        GLCmdVertexAttribPointer,GLCmdVertexAttrib1f,GLCmdVertexAttrib2f,GLCmdVertexAttrib3f,GLCmdVertexAttrib4f,GLCmdGenTextures,
+        GLCmdDeleteTextures,GLCmdActiveTexture,GLCmdBindTexture,GLCmdTexParameteri,GLCmdTexImage2D,GLCmdTexSubImage2D,
+        GLCmdCompressedTexImage2D,GLCmdCompressedTexSubImage2D,GLCmdCopyTexSubImage2D,GLCmdGenerateMipmap,GLCmdCreateShader,GLCmdShaderSource,
+        GLCmdCompileShader,GLCmdGetShaderiv,GLCmdGetShaderInfoLog,GLCmdDeleteShader,GLCmdCreateProgram,GLCmdAttachShader,
+        GLCmdLinkProgram,GLCmdValidateProgram,GLCmdGetProgramiv,GLCmdGetProgramInfoLog,GLCmdDeleteProgram,GLCmdUseProgram,
+        GLCmdGetActiveUniform,GLCmdGetActiveAttrib,GLCmdGetUniformLocation,GLCmdGetAttribLocation,GLCmdUniform1i,GLCmdUniform1f,
+        GLCmdUniform2f,GLCmdUniform3f,GLCmdUniform4f,GLCmdUniformMatrix4fv,GLCmdEnable,GLCmdDisable,
+        GLCmdDepthMask,GLCmdDepthFunc,GLCmdBlendFunc,GLCmdLineWidth,GLCmdViewport,GLCmdClearColor,
+        GLCmdClear,GLCmdGenFramebuffers,GLCmdDeleteFramebuffers,GLCmdBindFramebuffer,GLCmdFramebufferRenderbuffer,GLCmdFramebufferTexture2D,
+        GLCmdCheckFramebufferStatus,GLCmdGenRenderbuffers,GLCmdDeleteRenderbuffers,GLCmdBindRenderbuffer,GLCmdRenderbufferStorage,GLCmdGetRenderbufferParameteriv,
+        GLCmdDiscardFramebuffer,GLCmdDrawArrays,GLCmdDrawElements,GLCmdFlush,GLCmdFinish,GLCmdGetError,
+        GLCmdGetIntegerv,GLCmdGetString,GLCmdMax
+    } Command;
+    
+    /// Return the GL name of a command, for printing
+    static const char *commandName(Command cmd);
+    
+    /// A single call, if we're keeping them
+    class Event
+    {
+    public:
+        Command cmd;
+        /// Seconds since the last reset
+        double time;
+    };
+    
+    /// What we've counted since the last reset
+    class Stats
+    {
+    public:
+        Stats();
+        
+        /// Total number of calls
+        int totalCalls() const;
+        
+        /// Calls of each type
+        int calls[GLCmdMax];
+        /// Draw calls and the vertices (or indices) they covered
+        int draws;
+        long vertices;
+        /// Calls that change bindings or fixed function state
+        int stateChanges;
+        /// State changes that set what was already there
+        int redundantStateChanges;
+        /// Uniform values sent and the ones that were the same as last time
+        int uniformUploads,redundantUniformUploads;
+        /// Bytes sent for buffers (including mapped ones) and textures
+        long bufferBytes,textureBytes;
+    };
+    
+    /// A uniform or attribute, as reported by the program
+    class Variable
+    {
+    public:
+        std::string name;
+        GLint size;
+        GLenum type;
+    };
+    
+    RecordingGLBackend();
+    virtual ~RecordingGLBackend();
+    
+    /// Keep a timestamped list of every call, not just the counts
+    void setKeepEvents(bool keep);
+    
+    /// Size we'll report for renderbuffers that haven't had storage set
+    void setFramebufferSize(int width,int height);
+    
+    /// Clear the counts and events.  GL objects and bindings stay.
+    void reset();
+    
+    /// Return a copy of the counts so far
+    Stats getStats();
+    
+    /// Return a copy of the events so far
+    std::vector<Event> getEvents();
+    
+    void genBuffers(GLsizei n,GLuint *buffers);
+    void deleteBuffers(GLsizei n,const GLuint *buffers);
+    void bindBuffer(GLenum target,GLuint buffer);
+    void bufferData(GLenum target,GLsizeiptr size,const GLvoid *data,GLenum usage);
+    void bufferSubData(GLenum target,GLintptr offset,GLsizeiptr size,const GLvoid *data);
+    GLvoid *mapBuffer(GLenum target,GLenum access);
+    GLboolean unmapBuffer(GLenum target);
+    void genVertexArrays(GLsizei n,GLuint *arrays);
+    void deleteVertexArrays(GLsizei n,const GLuint *arrays);
+    void bindVertexArray(GLuint array);
+    void enableVertexAttribArray(GLuint index);
+    void disableVertexAttribArray(GLuint index);
+    void vertexAttribPointer(GLuint index,GLint size,GLenum type,GLboolean normalized,GLsizei stride,const GLvoid *ptr);
+    void vertexAttrib1f(GLuint index,GLfloat x);
+    void vertexAttrib2f(GLuint index,GLfloat x,GLfloat y);
+    void vertexAttrib3f(GLuint index,GLfloat x,GLfloat y,GLfloat z);
+    void vertexAttrib4f(GLuint index,GLfloat x,GLfloat y,GLfloat z,GLfloat w);
+    void genTextures(GLsizei n,GLuint *textures);
+    void deleteTextures(GLsizei n,const GLuint *textures);
+    void activeTexture(GLenum texture);
+    void bindTexture(GLenum target,GLuint texture);
+    void texParameteri(GLenum target,GLenum pname,GLint param);
+    void texImage2D(GLenum target,GLint level,GLint internalformat,GLsizei width,GLsizei height,GLint border,GLenum format,GLenum type,const GLvoid *pixels);
+    void texSubImage2D(GLenum target,GLint level,GLint xoffset,GLint yoffset,GLsizei width,GLsizei height,GLenum format,GLenum type,const GLvoid *pixels);
+    void compressedTexImage2D(GLenum target,GLint level,GLenum internalformat,GLsizei width,GLsizei height,GLint border,GLsizei imageSize,const GLvoid *data);
+    void compressedTexSubImage2D(GLenum target,GLint level,GLint xoffset,GLint yoffset,GLsizei width,GLsizei height,GLenum format,GLsizei imageSize,const GLvoid *data);
+    void copyTexSubImage2D(GLenum target,GLint level,GLint xoffset,GLint yoffset,GLint x,GLint y,GLsizei width,GLsizei height);
+    void generateMipmap(GLenum target);
+    GLuint createShader(GLenum type);
+    void shaderSource(GLuint shader,GLsizei count,const GLchar **string,const GLint *length);
+    void compileShader(GLuint shader);
+    void getShaderiv(GLuint shader,GLenum pname,GLint *params);
+    void getShaderInfoLog(GLuint shader,GLsizei bufsize,GLsizei *length,GLchar *infolog);
+    void deleteShader(GLuint shader);
+    GLuint createProgram();
+    void attachShader(GLuint program,GLuint shader);
+    void linkProgram(GLuint program);
+    void validateProgram(GLuint program);
+    void getProgramiv(GLuint program,GLenum pname,GLint *params);
+    void getProgramInfoLog(GLuint program,GLsizei bufsize,GLsizei *length,GLchar *infolog);
+    void deleteProgram(GLuint program);
+    void useProgram(GLuint program);
+    void getActiveUniform(GLuint program,GLuint index,GLsizei bufsize,GLsizei *length,GLint *size,GLenum *type,GLchar *name);
+    void getActiveAttrib(GLuint program,GLuint index,GLsizei bufsize,GLsizei *length,GLint *size,GLenum *type,GLchar *name);
+    int getUniformLocation(GLuint program,const GLchar *name);
+    int getAttribLocation(GLuint program,const GLchar *name);
+    void uniform1i(GLint location,GLint x);
+    void uniform1f(GLint location,GLfloat x);
+    void uniform2f(GLint location,GLfloat x,GLfloat y);
+    void uniform3f(GLint location,GLfloat x,GLfloat y,GLfloat z);
+    void uniform4f(GLint location,GLfloat x,GLfloat y,GLfloat z,GLfloat w);
+    void uniformMatrix4fv(GLint location,GLsizei count,GLboolean transpose,const GLfloat *value);
+    void enable(GLenum cap);
+    void disable(GLenum cap);
+    void depthMask(GLboolean flag);
+    void depthFunc(GLenum func);
+    void blendFunc(GLenum sfactor,GLenum dfactor);
+    void lineWidth(GLfloat width);
+    void viewport(GLint x,GLint y,GLsizei width,GLsizei height);
+    void clearColor(GLclampf red,GLclampf green,GLclampf blue,GLclampf alpha);
+    void clear(GLbitfield mask);
+    void genFramebuffers(GLsizei n,GLuint *framebuffers);
+    void deleteFramebuffers(GLsizei n,const GLuint *framebuffers);
+    void bindFramebuffer(GLenum target,GLuint framebuffer);
+    void framebufferRenderbuffer(GLenum target,GLenum attachment,GLenum renderbuffertarget,GLuint renderbuffer);
+    void framebufferTexture2D(GLenum target,GLenum attachment,GLenum textarget,GLuint texture,GLint level);
+    GLenum checkFramebufferStatus(GLenum target);
+    void genRenderbuffers(GLsizei n,GLuint *renderbuffers);
+    void deleteRenderbuffers(GLsizei n,const GLuint *renderbuffers);
+    void bindRenderbuffer(GLenum target,GLuint renderbuffer);
+    void renderbufferStorage(GLenum target,GLenum internalformat,GLsizei width,GLsizei height);
+    void getRenderbufferParameteriv(GLenum target,GLenum pname,GLint *params);
+    void discardFramebuffer(GLenum target,GLsizei numAttachments,const GLenum *attachments);
+    void drawArrays(GLenum mode,GLint first,GLsizei count);
+    void drawElements(GLenum mode,GLsizei count,GLenum type,const GLvoid *indices);
+    void flush();
+    void finish();
+    GLenum getError();
+    void getIntegerv(GLenum pname,GLint *params);
+    const GLubyte *getString(GLenum name);
+    
+protected:
+    /// What we know about a program
+    class ProgramInfo
+    {
+    public:
+        std::vector<GLuint> shaders;
+        std::vector<Variable> uniforms,attrs;
+    };
+    
+    // Count a call.  The lock is held.
+    void record(Command cmd);
+    // Count a state change, noting if it was redundant
+    void recordState(Command cmd,bool same);
+    // Count a uniform upload and remember the value
+    void recordUniform(Command cmd,GLint location,const GLfloat *vals,int numVals);
+    // Set a multi-value piece of state (viewport, clear color) and count the change
+    void recordStateVec(Command cmd,GLenum which,const GLfloat *vals,int numVals);
+    // Make up some names
+    void genNames(Command cmd,GLsizei n,GLuint *names);
+    // Fill in the uniforms and attributes from the shader sources
+    void parseShaders(ProgramInfo &info);
+    // Bytes for a texture upload
+    static long textureBytes(GLsizei width,GLsizei height,GLenum format,GLenum type);
+    
+    pthread_mutex_t lock;
+    bool keepEvents;
+    double startTime;
+    Stats stats;
+    std::vector<Event> events;
+    
+    GLuint nextName;
+    int fbWidth,fbHeight;
+    // Buffer sizes and what's bound to the array and element targets
+    std::map<GLuint,long> bufferSizes;
+    GLuint arrayBuffer,elementBuffer;
+    std::vector<unsigned char> mappedData;
+    // The bound vertex array and the element buffer each one holds onto
+    GLuint vertexArray;
+    std::map<GLuint,GLuint> vertexArrayElements;
+    // Textures bound to each unit
+    GLenum activeUnit;
+    std::map<GLenum,GLuint> boundTextures;
+    // Shader sources and programs
+    std::map<GLuint,std::string> shaderSources;
+    std::map<GLuint,ProgramInfo> programs;
+    GLuint curProgram;
+    // Last value sent to each uniform location in each program
+    std::map<std::pair<GLuint,GLint>,std::vector<GLfloat> > uniformVals;
+    // Fixed function state we've seen set
+    std::map<GLenum,bool> caps;
+    std::map<GLenum,GLint> stateVals;
+    std::map<GLenum,std::vector<GLfloat> > stateVecs;
+    std::map<GLuint,std::pair<GLsizei,GLsizei> > renderbufferSizes;
+    GLuint curRenderbuffer,curFramebuffer;
+};
+
+}
@@ -0,0 +1,116 @@
+/*
+ *  RectPacker.h
+ *  WhirlyGlobeLib
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <vector>
+#import <map>
+
+namespace WhirlyKit
+{
+
+/// Occupancy and fragmentation for a rectangle packer.  Sizes are in cells.
+class RectPackerStats
+{
+public:
+    RectPackerStats() : totalArea(0), usedArea(0), numRects(0), numFreeRects(0), largestFreeArea(0) { }
+    
+    /// Fraction of the free area that isn't in the largest free rectangle.
+    /// 0 means the free space is all in one piece.
+    float fragmentation() const
+    {
+        int freeArea = totalArea - usedArea;
+        return (freeArea <= 0) ? 0.0 : 1.0 - (float)largestFreeArea / freeArea;
+    }
+
+    int totalArea;
+    int usedArea;
+    int numRects;
+    int numFreeRects;
+    int largestFreeArea;
+};
+
+/** The rect packer tracks which parts of a 2D grid are in use.
+    It keeps the maximal free rectangles (MaxRects), so finding a spot
+    is a scan of the free list rather than the whole grid.
+    Rectangles can be reserved anywhere and released in any order.
+    Released space is grown back out into maximal free rectangles,
+    along with any free rectangles bordering it.
+  */
+class RectPacker
+{
+public:
+    /// A rectangle in cells
+    class Rect
+    {
+    public:
+        Rect() : x(0), y(0), width(0), height(0) { }
+        Rect(int x,int y,int width,int height) : x(x), y(y), width(width), height(height) { }
+        
+        /// True if this one is entirely inside that one
+        bool inside(const Rect &that) const
+        { return x >= that.x && y >= that.y && x+width <= that.x+that.width && y+height <= that.y+that.height; }
+        /// True if the two overlap at all
+        bool overlaps(const Rect &that) const
+        { return x < that.x+that.width && that.x < x+width && y < that.y+that.height && that.y < y+height; }
+        
+        int x,y,width,height;
+    };
+    
+    /// Construct with the size of the grid
+    RectPacker(int width,int height);
+    
+    /// Look for a spot for the given size, using best short side fit.
+    /// This doesn't reserve it.  Returns false if there's no room.
+    bool findSpot(int width,int height,Rect &rect);
+    
+    /// Mark the given rectangle as in use
+    void reserve(const Rect &rect);
+    
+    /// Mark the given rectangle as free again.
+    /// It must be exactly the same as one passed to reserve()
+    void release(const Rect &rect);
+    
+    /// Fill in the usage stats
+    void getStats(RectPackerStats &stats) const;
+    
+protected:
+    // Cut the given rectangle out of the free list
+    void splitFree(const Rect &used);
+    // Add a released rectangle to the free list, merging it with its neighbors
+    void mergeFree(const Rect &rect);
+    // Mark cells in the occupancy grid
+    void setCells(const Rect &rect,bool used);
+    // Check if a column or row span of cells is free
+    bool colFree(int x,int y0,int y1) const;
+    bool rowFree(int y,int x0,int x1) const;
+    // Expand a free rectangle as far as it'll go, sideways or up and down first
+    Rect grow(Rect rect,bool horizFirst) const;
+    // Get rid of the new free rectangles (from startNew on) that are inside others
+    void pruneFree(unsigned int startNew);
+    
+    int width,height;
+    int usedArea;
+    std::vector<Rect> freeRects;
+    // Rectangles in use, by position
+    std::map<int,Rect> usedRects;
+    // Which cells are in use
+    std::vector<bool> cells;
+};
+
+}
@@ -0,0 +1,119 @@
+/*
+ *  RegionAllocator.h
+ *  WhirlyGlobeLib
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <vector>
+
+namespace WhirlyKit
+{
+
+/// Usage and fragmentation for a region allocator.  Sizes are in allocator units.
+class RegionAllocatorStats
+{
+public:
+    RegionAllocatorStats() : totalSize(0), usedSize(0), freeSize(0), numRegions(0), numFreeBlocks(0), largestFreeBlock(0) { }
+    
+    /// Fraction of the free space that isn't in the largest free block.
+    /// 0 means the free space is all in one piece.
+    float fragmentation() const { return (freeSize == 0) ? 0.0 : 1.0 - (float)largestFreeBlock / freeSize; }
+
+    unsigned int totalSize;
+    unsigned int usedSize;
+    unsigned int freeSize;
+    unsigned int numRegions;
+    unsigned int numFreeBlocks;
+    unsigned int largestFreeBlock;
+};
+
+/** The region allocator hands out ranges of a fixed size space.
+    It doesn't own any memory itself.  You use the offsets it hands back
+    to place things in a buffer somewhere else, like a BigDrawable.
+    This is a two level segregated fit (TLSF) allocator, so allocation
+    and free are constant time no matter how fragmented things get.
+    Sizes and offsets are in whatever units you like (e.g. vertices).
+  */
+class RegionAllocator
+{
+public:
+    /// Construct with the total size of the space we're managing
+    RegionAllocator(unsigned int totalSize);
+    
+    /// Allocate a region of the given size.  Returns a handle or -1 if there's no room.
+    int allocate(unsigned int size);
+    
+    /// Free a region by its handle
+    void free(int handle);
+    
+    /// If there's free space right before this region, slide the region down
+    ///  into it.  Returns true if the region moved.
+    /// Doing this to every region in order compacts all the free space at the end.
+    bool moveDown(int handle);
+    
+    /// Offset of the given region
+    unsigned int getOffset(int handle) const { return blocks[handle].offset; }
+    
+    /// Size of the given region
+    unsigned int getSize(int handle) const { return blocks[handle].size; }
+    
+    /// End of the last region in use.  Nothing past here is allocated.
+    unsigned int getHighWater() const;
+    
+    /// Fill in the usage stats
+    void getStats(RegionAllocatorStats &stats) const;
+    
+protected:
+    // Second level subdivisions are 1<<SLBits
+    static const int SLBits = 3;
+    static const int SLCount = 1<<SLBits;
+    static const int FLCount = 32;
+    
+    // A block is a region, either free or in use
+    class Block
+    {
+    public:
+        unsigned int offset,size;
+        bool isFree;
+        // Neighbors in the space
+        int prevPhys,nextPhys;
+        // Neighbors in the free list
+        int prevFree,nextFree;
+    };
+    
+    // Work out the free list a given size falls in
+    void mapping(unsigned int size,int &fl,int &sl) const;
+    // Find a free list with blocks at least this size
+    bool findSuitable(unsigned int size,int &fl,int &sl) const;
+    // Add and remove blocks from the free lists
+    void insertFree(int which);
+    void removeFree(int which);
+    // Get a block record from the pool
+    int newBlock();
+    
+    unsigned int totalSize,usedSize;
+    int numRegions;
+    std::vector<Block> blocks;
+    std::vector<int> unusedBlocks;
+    // Last block in the space
+    int tailBlock;
+    unsigned int flBitmap;
+    unsigned int slBitmap[FLCount];
+    int freeHeads[FLCount][SLCount];
+};
+
+}
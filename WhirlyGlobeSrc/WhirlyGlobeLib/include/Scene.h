@@ -30,6 +30,8 @@
 #import "Texture.h"
 #import "Cullable.h"
 #import "Drawable.h"
+#import "ChangeQueue.h"
+#import "IdentityTable.h"
 #import "Generator.h"
 #import "ActiveModel.h"
 #import "CoordSystem.h"
@@ -72,6 +74,17 @@ public:
 
 	/// Add to the renderer.  Never call this.
 	void execute(Scene *scene,WhirlyKitSceneRendererES *renderer,WhirlyKitView *view);
+    
+    /// Adds can wait
+    virtual ChangePriority getPriority() { return ChangePriorityBulk; }
+    
+    /// Just the texture
+    virtual bool getIDs(std::vector<SimpleIdentity> &ids);
+    
+    /// A remove of the same texture will cancel this one
+    virtual ChangeCoalesceType getCoalesceType() { return ChangeCoalesceAdd; }
+    virtual void getCoalesceIDs(std::vector<SimpleIdentity> &ids) { if (tex) ids.push_back(tex->getId()); }
+    virtual bool dropTargets(const std::set<SimpleIdentity> &ids) { return tex && ids.find(tex->getId()) != ids.end(); }
 	
     /// Only use this if you've thought it out
     TextureBase *getTex() { return tex; }
@@ -89,6 +102,14 @@ public:
 
     /// Remove from the renderer.  Never call this.
 	void execute(Scene *scene,WhirlyKitSceneRendererES *renderer,WhirlyKitView *view);
+    
+    /// Just the texture
+    virtual bool getIDs(std::vector<SimpleIdentity> &ids) { ids.push_back(texture);  return true; }
+    
+    /// Cancels out an add of the same texture
+    virtual ChangeCoalesceType getCoalesceType() { return ChangeCoalesceRemove; }
+    virtual void getCoalesceIDs(std::vector<SimpleIdentity> &ids) { ids.push_back(texture); }
+    virtual bool dropTargets(const std::set<SimpleIdentity> &ids) { return ids.find(texture) != ids.end(); }
 	
 protected:
 	SimpleIdentity texture;
@@ -111,6 +132,17 @@ public:
 
 	/// Add to the renderer.  Never call this
 	void execute(Scene *scene,WhirlyKitSceneRendererES *renderer,WhirlyKitView *view);	
+    
+    /// Adds can wait
+    virtual ChangePriority getPriority() { return ChangePriorityBulk; }
+    
+    /// The drawable and its texture
+    virtual bool getIDs(std::vector<SimpleIdentity> &ids);
+    
+    /// A remove of the same drawable will cancel this one.  The texture is just a reference.
+    virtual ChangeCoalesceType getCoalesceType() { return ChangeCoalesceAdd; }
+    virtual void getCoalesceIDs(std::vector<SimpleIdentity> &ids) { if (drawable) ids.push_back(drawable->getId()); }
+    virtual bool dropTargets(const std::set<SimpleIdentity> &ids) { return drawable && ids.find(drawable->getId()) != ids.end(); }
 	
 protected:
 	Drawable *drawable;
@@ -125,6 +157,17 @@ public:
 
     /// Remove the drawable.  Never call this
 	void execute(Scene *scene,WhirlyKitSceneRendererES *renderer,WhirlyKitView *view);
+    
+    /// Removals go first
+    virtual ChangePriority getPriority() { return ChangePriorityUrgent; }
+    
+    /// Just the drawable
+    virtual bool getIDs(std::vector<SimpleIdentity> &ids) { ids.push_back(drawable);  return true; }
+    
+    /// Cancels out an add of the same drawable
+    virtual ChangeCoalesceType getCoalesceType() { return ChangeCoalesceRemove; }
+    virtual void getCoalesceIDs(std::vector<SimpleIdentity> &ids) { ids.push_back(drawable); }
+    virtual bool dropTargets(const std::set<SimpleIdentity> &ids) { return ids.find(drawable) != ids.end(); }
 	
 protected:	
 	SimpleIdentity drawable;
@@ -224,6 +267,9 @@ protected:
 typedef std::set<Generator *,IdentifiableSorter> GeneratorSet;
     
 typedef std::set<DrawableRef,IdentifiableRefSorter> DrawableRefSet;
+    
+/// Drawables by ID
+typedef IdentityTable<DrawableRef> DrawableRefTable;
 
 typedef std::set<OpenGLES2Program *,IdentifiableSorter> OpenGLES2ProgramSet;
 typedef std::map<std::string,OpenGLES2Program *> OpenGLES2ProgramMap;
@@ -272,15 +318,19 @@ public:
     /// This is not thread safe, so do this in the main thread
     SimpleIdentity getGeneratorIDByName(const std::string &name);
 
-	/// Add a single change request.  You can call this from any thread, it locks.
+	/// Add a single change request.  You can call this from any thread and it won't block.
     /// If you have more than one, don't iterate, use the other version.
 	void addChangeRequest(ChangeRequest *newChange);
     /// Add a list of change requets.  You can call this from any thread.
     /// This is the faster option if you have more than one change request
 	void addChangeRequests(const ChangeSet &newchanges);
+    /// Add a list of change requests and clear out the list.
+    /// The whole batch goes over without being copied.
+    void addChangeRequestsAndClear(ChangeSet &newChanges);
 	
 	/// Look for a valid texture
-    /// If it's missing, we probably won't draw the associated geometry
+    /// If it's missing, we probably won't draw the associated geometry.
+    /// Rendering thread only.  This doesn't lock.
 	GLuint getGLTexture(SimpleIdentity texIdent);
 	
 	/// Process change requests
@@ -290,6 +340,13 @@ public:
     /// True if there are pending updates
     bool hasChanges();
     
+    /// Time we're allowed to spend on change requests per frame (seconds).
+    /// Whatever doesn't fit waits for the next frame.  0 means no limit (the default).
+    void setChangeTimeBudget(double budget) { changeScheduler.setTimeBudget(budget); }
+    
+    /// What processChanges() got done the last time through
+    const ChangeStats &getChangeStats() { return changeScheduler.getStats(); }
+    
     /// Add sub texture mappings.
     /// These are mappings from images to parts of texture atlases.
     /// They're here so we can use SimpleIdentity's to point into larger
@@ -297,6 +354,10 @@ public:
     void addSubTexture(const SubTexture &);
     void addSubTextures(const std::vector<SubTexture> &);
     
+    /// Replace the sub texture mappings we already have with the given ones.
+    /// This is for sub textures that moved within a texture atlas.  Ones we don't have are ignored.
+    void replaceSubTextures(const std::vector<SubTexture> &);
+    
     /// Return a sub texture by ID.  The idea being we can use these
     ///  the same way we use full texture IDs.
     SubTexture getSubTexture(SimpleIdentity subTexId);
@@ -371,24 +432,30 @@ public:
     
     /// All the drawable generators we've been handed, sorted by ID
     GeneratorSet generators;
+    /// The same generators, for lookup
+    IdentityTable<Generator *> generatorTable;
 
     /// Top level of Cullable quad tree
     CullTree *cullTree;
 	
-	/// All the drawables we've been handed, sorted by ID
-	DrawableRefSet drawables;
+	/// All the drawables we've been handed, by ID
+	DrawableRefTable drawables;
 	
-	typedef std::set<TextureBase *,IdentifiableSorter> TextureSet;
-	/// Textures, sorted by ID
-	TextureSet textures;
+	typedef IdentityTable<TextureBase *> TextureTable;
+	/// Textures, by ID
+	TextureTable textures;
     
-    /// Mutex for accessing textures
+    /// Textures are only changed in the rendering thread, which holds this while it does.
+    /// Other threads hold it to look at textures.  The rendering thread doesn't need to.
     pthread_mutex_t textureLock;
 	
-	pthread_mutex_t changeRequestLock;
-	/// We keep a list of change requests to execute
-	/// This can be accessed in multiple threads, so we lock it
-	ChangeSet changeRequests;
+	/// Change requests waiting to be executed.
+	/// Any thread can add to this without locking.
+	ChangeQueue changeRequests;
+    
+    /// Runs the change requests in priority order within the frame budget.
+    /// Holds the ones that didn't fit.
+    ChangeScheduler changeScheduler;
     
     pthread_mutex_t subTexLock;
     typedef std::set<SubTexture> SubTextureSet;
@@ -27,6 +27,7 @@
 #import "Scene.h"
 #import "PerformanceTimer.h"
 #import "Cullable.h"
+#import "WorkerPool.h"
 #import "Lighting.h"
 
 /// @cond
@@ -80,6 +81,7 @@ public:
 
 /// OpenGL ES state optimizer.  This short circuits many of the OGL state
 ///  changes that would otherwise be redundant.
+/// The work is done by an OpenGLStateOptimizer underneath.
 @interface WhirlyKitOpenGLStateOptimizer : NSObject
 
 /// Calls glActiveTextures
@@ -100,9 +102,39 @@ public:
 /// Calls glLineWidth
 - (void)setLineWidth:(GLfloat)lineWidth;
 
+/// Calls glBindTexture(GL_TEXTURE_2D) for the active texture unit
+- (void)setBoundTexture:(GLuint)texId;
+
+/// Calls glBindVertexArrayOES
+- (void)setVertexArray:(GLuint)vertArrayObj;
+
+/// Calls glBindBuffer(GL_ARRAY_BUFFER)
+- (void)setArrayBuffer:(GLuint)bufferId;
+
+/// Calls glBindBuffer(GL_ELEMENT_ARRAY_BUFFER).
+/// This is part of the vertex array state, so it's forgotten when that changes.
+- (void)setElementArrayBuffer:(GLuint)bufferId;
+
+/// Calls glEnable(GL_BLEND) or glDisable(GL_BLEND)
+- (void)setEnableBlend:(bool)enable;
+
+/// Calls glBlendFunc
+- (void)setBlendFuncSrc:(GLenum)srcFactor dst:(GLenum)dstFactor;
+
 /// Called by the render to clear state
 - (void)reset;
 
+/// Forget the program, texture, buffer and vertex array bindings.
+/// Anything that binds those directly (like setting up resources) throws
+///  us off, so the renderer calls this before it draws.
+- (void)resetBindings;
+
+/// Called by the renderer before it draws a frame.  Resets the bindings.
+- (void)beginFrame;
+
+/// Called by the renderer after it draws a frame.  Puts VAO 0 back.
+- (void)endFrame;
+
 @end
 
 /** Renderer Frame Info.
@@ -176,6 +208,9 @@ typedef enum {zBufferOn,zBufferOff,zBufferOffDefault} WhirlyKitSceneRendererZBuf
     NSTimeInterval renderUntil;
     
     WhirlyKit::RGBAColor _clearColor;
+    
+    /// Threads for culling and sorting the draw list
+    WhirlyKit::WorkerPool *workerPool;
 }
 
 /// Rendering context
@@ -189,6 +224,9 @@ typedef enum {zBufferOn,zBufferOff,zBufferOffDefault} WhirlyKitSceneRendererZBuf
 /// Set this to turn culling on or off.
 /// By default it's on, so leave it alone unless you know you want it off.
 @property (nonatomic,assign) bool doCulling;
+/// If set, culling reuses results from earlier frames for parts of the scene
+///  the view hasn't moved enough to change.  Off by default.
+@property (nonatomic,assign) bool coherentCulling;
 
 /// The pixel width of the CAEAGLLayer.
 @property (nonatomic,readonly) GLint framebufferWidth;
@@ -219,6 +257,11 @@ typedef enum {zBufferOn,zBufferOff,zBufferOffDefault} WhirlyKitSceneRendererZBuf
 /// Force a draw at the next opportunity
 @property (nonatomic,assign) bool triggerDraw;
 
+/// Number of extra threads used for culling and sorting the draw list.
+/// The render thread works on it too, so 0 means it all happens there.
+/// The default depends on the number of cores.
+@property (nonatomic,assign) int numWorkerThreads;
+
 /// Initialize with API version
 - (id) initWithOpenGLESVersion:(EAGLRenderingAPI)apiVersion;
 
@@ -244,7 +287,7 @@ typedef enum {zBufferOn,zBufferOff,zBufferOffDefault} WhirlyKitSceneRendererZBuf
 - (void)setClearColor:(UIColor *)inClearColor;
 
 /// Used by the subclasses for culling
-- (void)findDrawables:(WhirlyKit::Cullable *)cullable view:(WhirlyGlobeView *)globeView frameSize:(WhirlyKit::Point2f)frameSize modelTrans:(Eigen::Matrix4d *)modelTrans eyeVec:(Eigen::Vector3f)eyeVec frameInfo:(WhirlyKitRendererFrameInfo *)frameInfo screenMbr:(WhirlyKit::Mbr)screenMbr topLevel:(bool)isTopLevel toDraw:(std::set<WhirlyKit::DrawableRef> *) toDraw considered:(int *)drawablesConsidered;
+- (void)findDrawables:(WhirlyKit::CullTree *)cullTree view:(WhirlyGlobeView *)globeView frameSize:(WhirlyKit::Point2f)frameSize modelTrans:(Eigen::Matrix4d *)modelTrans eyeVec:(Eigen::Vector3f)eyeVec frameInfo:(WhirlyKitRendererFrameInfo *)frameInfo screenMbr:(WhirlyKit::Mbr)screenMbr toDraw:(std::vector<WhirlyKit::Drawable *> *) toDraw considered:(int *)drawablesConsidered;
 
 /// Used by the subclasses to determine if the view changed and needs to be updated
 - (bool) viewDidChange;
@@ -53,4 +53,10 @@
 ///  but it does mean you can't mess with the rendering context.
 @property (nonatomic,assign) bool dispatchRendering;
 
+/// If set, a frame builder thread culls, sorts and records the GL calls
+///  for the next frame while the render thread replays the last one.
+/// This takes most of the work off the render thread, but the display
+///  is a frame behind.
+@property (nonatomic,assign) bool buildCommandLists;
+
 @end
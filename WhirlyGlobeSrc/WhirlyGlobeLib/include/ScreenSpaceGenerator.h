@@ -144,6 +144,14 @@ public:
     ~ScreenSpaceGeneratorAddRequest();
     
     virtual void execute2(Scene *scene,WhirlyKitSceneRendererES *renderer,Generator *gen);
+    
+    /// The shapes we touch
+    virtual bool getIDs(std::vector<SimpleIdentity> &ids);
+    
+    /// A remove of the same shapes will cancel them out
+    virtual ChangeCoalesceType getCoalesceType() { return ChangeCoalesceAdd; }
+    virtual void getCoalesceIDs(std::vector<SimpleIdentity> &ids);
+    virtual bool dropTargets(const std::set<SimpleIdentity> &ids);
 
 protected:
     std::vector<ScreenSpaceGenerator::ConvexShape *> shapes;
@@ -161,6 +169,14 @@ public:
     ~ScreenSpaceGeneratorRemRequest();
     
     virtual void execute2(Scene *scene,WhirlyKitSceneRendererES *renderer,Generator *gen);    
+    
+    /// The shapes we touch
+    virtual bool getIDs(std::vector<SimpleIdentity> &ids);
+    
+    /// Cancels out adds of the same shapes
+    virtual ChangeCoalesceType getCoalesceType() { return ChangeCoalesceRemove; }
+    virtual void getCoalesceIDs(std::vector<SimpleIdentity> &ids);
+    virtual bool dropTargets(const std::set<SimpleIdentity> &ids);
 
 protected:
     std::vector<SimpleIdentity> shapeIDs;
@@ -179,10 +195,22 @@ public:
     ~ScreenSpaceGeneratorFadeRequest();
     
     virtual void execute2(Scene *scene,WhirlyKitSceneRendererES *renderer,Generator *gen);
+    
+    /// The shapes we touch
+    virtual bool getIDs(std::vector<SimpleIdentity> &ids);
+    
+    /// A later fade on the same shapes replaces this one
+    virtual ChangeCoalesceType getCoalesceType() { return ChangeCoalesceUpdate; }
+    virtual void getCoalesceIDs(std::vector<SimpleIdentity> &ids);
+    virtual bool dropTargets(const std::set<SimpleIdentity> &ids);
+    /// Keep the renderer going as long as the fade we replaced would have
+    virtual void takeOverTarget(ChangeRequest *earlier,SimpleIdentity targetID);
 
 protected:
     NSTimeInterval fadeUp,fadeDown;
     std::vector<SimpleIdentity> shapeIDs;
+    // Latest fade time from the requests folded into this one
+    NSTimeInterval renderUntil;
 };
 
 /** Enable or disable a whole mess of shapes at once.
@@ -195,6 +223,14 @@ public:
 
     virtual void execute2(Scene *scene,WhirlyKitSceneRendererES *renderer,Generator *gen);
     
+    /// The shapes we touch
+    virtual bool getIDs(std::vector<SimpleIdentity> &ids);
+    
+    /// A later enable on the same shapes replaces this one
+    virtual ChangeCoalesceType getCoalesceType() { return ChangeCoalesceUpdate; }
+    virtual void getCoalesceIDs(std::vector<SimpleIdentity> &ids);
+    virtual bool dropTargets(const std::set<SimpleIdentity> &ids);
+    
 protected:
     bool enable;
     std::vector<SimpleIdentity> shapeIDs;
@@ -220,8 +256,20 @@ public:
     
     virtual void execute2(Scene *scene,WhirlyKitSceneRendererES *renderer,Generator *gen);
     
+    /// The shapes we touch
+    virtual bool getIDs(std::vector<SimpleIdentity> &ids);
+    
+    /// A later gang change on the same shapes replaces this one
+    virtual ChangeCoalesceType getCoalesceType() { return ChangeCoalesceUpdate; }
+    virtual void getCoalesceIDs(std::vector<SimpleIdentity> &ids);
+    virtual bool dropTargets(const std::set<SimpleIdentity> &ids);
+    /// Keep the renderer going as long as the change we replaced would have
+    virtual void takeOverTarget(ChangeRequest *earlier,SimpleIdentity targetID);
+    
 protected:
     std::vector<ShapeChange> changes;
+    // Latest fade time from the requests folded into this one
+    NSTimeInterval renderUntil;
 };
 
 }
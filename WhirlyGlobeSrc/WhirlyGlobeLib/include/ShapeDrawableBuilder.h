@@ -22,6 +22,7 @@
 #import "WhirlyVector.h"
 #import "DataLayer.h"
 #import "layerThread.h"
+#import "DrawableBuilder.h"
 
 /// Used to pass shape info between the shape layer and the drawable builder
 ///  and within the threads of the shape layer
@@ -39,6 +40,7 @@
 @property (nonatomic,assign) bool zBufferWrite;
 @property (nonatomic,assign) bool enable;
 @property (nonatomic,assign) WhirlyKit::SimpleIdentity shaderID;
+@property (nonatomic,assign) bool optimizeMesh;
 
 - (id)initWithShapes:(NSArray *)shapes desc:(NSDictionary *)desc;
 
@@ -49,6 +51,9 @@
 namespace WhirlyKit
 {
     
+/// Used internally to split shapes up into drawables
+class ShapeChunkBuilder;
+    
 /** This drawable builder is associated with the shape layer.  It's
     exposed so it can be used by the active model version as well.
   */
@@ -75,8 +80,7 @@ protected:
     CoordSystemDisplayAdapter *coordAdapter;
     GLenum primType;
     WhirlyKitShapeInfo *shapeInfo;
-    Mbr drawMbr;
-    BasicDrawable *drawable;
+    ShapeChunkBuilder *chunkBuilder;
     std::vector<BasicDrawable *> drawables;
 };
 
@@ -108,13 +112,9 @@ public:
     WhirlyKitShapeInfo *getShapeInfo() { return shapeInfo; }
 
 protected:
-    // Creates a new local drawable with all the appropriate settings
-    void setupNewDrawable();
-
     CoordSystemDisplayAdapter *coordAdapter;    
-    Mbr drawMbr;
     WhirlyKitShapeInfo *shapeInfo;
-    BasicDrawable *drawable;
+    ShapeChunkBuilder *chunkBuilder;
     std::vector<BasicDrawable *> drawables;
 };
 
@@ -118,3 +118,22 @@ public:
 - (void)processIntoScene:(WhirlyKit::Scene *)scene layerThread:(WhirlyKitLayerThread *)layerThread texIDs:(std::set<WhirlyKit::SimpleIdentity> *)texIDs;
 
 @end
+
+/** A Baked Texture Atlas is a set of texture atlases that were packed offline
+    by the atlas baker (see BakedAtlas.h).  The file is mapped in and the pages go
+    straight into textures, so there's no image decoding or packing at startup.
+    You look up the sub textures by the names the images were baked with.
+  */
+@interface BakedTextureAtlas : NSObject
+
+/// Map in the baked atlas file.  Returns nil if it's not a valid baked atlas.
+- (id)initWithFile:(NSString *)fileName;
+
+/// Sub texture ID for the image baked with the given name, or EmptyIdentity
+- (WhirlyKit::SimpleIdentity)subTextureForName:(NSString *)name;
+
+/// Adds the textures to the scene, along with the sub texture mappings.
+/// Works just like the TextureAtlasBuilder's version.
+- (void)processIntoScene:(WhirlyKit::Scene *)scene layerThread:(WhirlyKitLayerThread *)layerThread texIDs:(std::set<WhirlyKit::SimpleIdentity> *)texIDs;
+
+@end
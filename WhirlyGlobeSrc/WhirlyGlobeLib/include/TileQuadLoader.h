@@ -117,6 +117,9 @@ public:
     /// Update what we're displaying based on the quad tree, particulary for children
     void updateContents(WhirlyKitQuadTileLoader *loader,WhirlyKitQuadDisplayLayer *layer,WhirlyKit::Quadtree *tree,std::vector<WhirlyKit::ChangeRequest *> &changeRequests);
     
+    /// The texture atlas moved our sub texture, so rebuild the geometry to match
+    void moveSubTexture(WhirlyKitQuadTileLoader *loader,WhirlyKitQuadDisplayLayer *layer,WhirlyKit::Quadtree *tree,const WhirlyKit::SubTexture &newSubTex,std::vector<WhirlyKit::ChangeRequest *> &changeRequests);
+    
     /// Dump out to the log
     void Print(WhirlyKit::Quadtree *tree);
     
@@ -127,6 +130,8 @@ public:
     bool placeholder;    
     /// Set if this tile is in the process of loading
     bool isLoading;
+    /// When we asked for the tile, for the tile fetch latency
+    uint64_t fetchStart;
     // DrawID for this parent tile
     WhirlyKit::SimpleIdentity drawId;
     // Optional ID for the skirts
@@ -230,6 +235,11 @@ typedef enum {WKTileScaleUp,WKTileScaleDown,WKTileScaleFixed,WKTileScaleNone} Wh
 @property (nonatomic,assign) int fixedTileSize;
 /// If set, the default texture atlas size.  Must be a power of two.
 @property (nonatomic,assign) int textureAtlasSize;
+/// If set, we'll defragment the texture atlas down to this much memory (in bytes).
+/// Sparse atlas textures are emptied out either way.
+@property (nonatomic,assign) int textureAtlasMemoryTarget;
+/// If set, we'll reorder the tile geometry for the vertex cache.  Off by default.
+@property (nonatomic,assign) bool optimizeMeshes;
 
 /// Set this up with an object that'll return an image per tile
 - (id)initWithDataSource:(NSObject<WhirlyKitQuadTileImageDataSource> *)imageSource;
@@ -0,0 +1,242 @@
+/*
+ *  VertexAttribute.h
+ *  WhirlyGlobeLib
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <OpenGLES/ES2/gl.h>
+#import <OpenGLES/ES2/glext.h>
+#import <string.h>
+#import <string>
+#import <vector>
+#import "WhirlyVector.h"
+
+namespace WhirlyKit
+{
+    
+/// Data types we'll accept for attributes
+typedef enum {BDFloat3Type,BDChar4Type,BDFloat2Type,BDFloatType} BDAttributeDataType;
+    
+/// Compact formats an attribute can be packed into for the interleaved vertex buffer.
+/// Half floats and normalized shorts are for 2D vectors (e.g. texture coordinates),
+///  normalized shorts only work for values in [0,1].
+/// Octahedral encoding is for 3D unit normals.  The shader needs to decode those.
+typedef enum {BDPackNone,BDPackHalfFloat,BDPackNormShort,BDPackOctahedral} BDAttributePacking;
+    
+/// Maps a C++ element type to the attribute data type it's stored as
+template<typename T> struct VertexAttributeType { };
+template<> struct VertexAttributeType<Eigen::Vector3f> { static const BDAttributeDataType dataType = BDFloat3Type; };
+template<> struct VertexAttributeType<Eigen::Vector2f> { static const BDAttributeDataType dataType = BDFloat2Type; };
+template<> struct VertexAttributeType<RGBAColor> { static const BDAttributeDataType dataType = BDChar4Type; };
+template<> struct VertexAttributeType<float> { static const BDAttributeDataType dataType = BDFloatType; };
+
+/** The storage behind a vertex attribute.  The element type is only
+    known at run time by the VertexAttribute, so this is the interface
+    it talks to.  The actual storage is the typed version below.
+  */
+class VertexAttributeData
+{
+public:
+    virtual ~VertexAttributeData() { }
+    
+    /// Number of elements in the array
+    virtual int numElements() const = 0;
+    
+    /// Size of a single element in bytes
+    virtual int elementSize() const = 0;
+    
+    /// Reserve space for the given number of elements
+    virtual void reserve(int count) = 0;
+    
+    /// Return a pointer to the given element
+    virtual void *addressForElement(int which) = 0;
+    
+    /// Copy count elements, starting at start, into an interleaved buffer.
+    /// basePtr should already point to this attribute's slot in the first vertex.
+    virtual void interleave(unsigned char *basePtr,int stride,int start,int count) const = 0;
+    
+    /// Rearrange the elements.  New element i is old element newToOld[i].
+    virtual void remap(const std::vector<GLuint> &newToOld) = 0;
+};
+
+/** Typed storage for vertex attribute data.  If you know what you're
+    putting in at compile time, go through this and skip the run time checks.
+  */
+template<typename T>
+class TypedVertexAttributeData : public VertexAttributeData
+{
+public:
+    TypedVertexAttributeData() { }
+    
+    /// Number of elements in the array
+    int numElements() const { return (int)vals.size(); }
+    
+    /// Size of a single element in bytes
+    int elementSize() const { return sizeof(T); }
+    
+    /// Reserve space for the given number of elements
+    void reserve(int count) { vals.reserve(count); }
+    
+    /// Return a pointer to the given element
+    void *addressForElement(int which) { return &vals[which]; }
+    
+    /// Add a single value
+    void add(const T &val) { vals.push_back(val); }
+    
+    /// Add a run of values all at once
+    void add(const T *newVals,int count) { vals.insert(vals.end(),newVals,newVals+count); }
+
+    /// Copy count elements, starting at start, into an interleaved buffer
+    void interleave(unsigned char *basePtr,int stride,int start,int count) const
+    {
+        const T *src = &vals[start];
+        for (int ii=0;ii<count;ii++,basePtr+=stride)
+            memcpy(basePtr, &src[ii], sizeof(T));
+    }
+    
+    /// Rearrange the elements.  New element i is old element newToOld[i].
+    void remap(const std::vector<GLuint> &newToOld)
+    {
+        std::vector<T> newVals;
+        newVals.reserve(newToOld.size());
+        for (unsigned int ii=0;ii<newToOld.size();ii++)
+            newVals.push_back(vals[newToOld[ii]]);
+        vals.swap(newVals);
+    }
+    
+    /// The actual values
+    std::vector<T> vals;
+};
+    
+/// Used to keep track of attributes (other than points)
+class VertexAttribute
+{
+public:
+    VertexAttribute(BDAttributeDataType dataType,const std::string &name);
+    VertexAttribute(const VertexAttribute &that);
+    ~VertexAttribute();
+    
+    /// Make a copy of everything for the data
+    VertexAttribute templateCopy() const;
+    
+    /// Return the data type
+    BDAttributeDataType getDataType() const;
+    
+    /// Set the packing used in the interleaved vertex buffer.
+    /// Returns false if that packing doesn't make sense for our data type.
+    bool setPacking(BDAttributePacking packing);
+    
+    /// Return the packing used in the interleaved vertex buffer
+    BDAttributePacking getPacking() const;
+    
+    /// Name the shader uses for the attribute in its buffered form.
+    /// Octahedral normals come in as a separate attribute.
+    std::string glName() const;
+    
+    /// Set the default color (if the type matches)
+    void setDefaultColor(const RGBAColor &color);
+    /// Set the default 2D vector (if the type matches)
+    void setDefaultVector2f(const Eigen::Vector2f &vec);
+    /// Set the default 3D vector (if the type matches)
+    void setDefaultVector3f(const Eigen::Vector3f &vec);
+    /// Set the default float (if the type matches)
+    void setDefaultFloat(float val);
+    
+    /// Convenience routine to add a color (if the type matches)
+    void addColor(const RGBAColor &color);
+    /// Convenience routine to add a 2D vector (if the type matches)
+    void addVector2f(const Eigen::Vector2f &vec);
+    /// Convenience routine to add a 3D vector (if the type matches)
+    void addVector3f(const Eigen::Vector3f &vec);
+    /// Convenience routine to add a float (if the type matches)
+    void addFloat(float val);
+    
+    /// Reserve size in the data array
+    void reserve(int size);
+    
+    /// Number of elements in our array
+    int numElements() const;
+    
+    /// Return the size of a single element, as packed
+    int size() const;
+    
+    /// Clean out the data array
+    void clear();
+    
+    /// Return a pointer to the given element
+    void *addressForElement(int which);
+    
+    /// Return the typed storage, creating it if need be.
+    /// Returns NULL if T doesn't match the data type.
+    template<typename T> TypedVertexAttributeData<T> *typedData()
+    {
+        if (dataType != VertexAttributeType<T>::dataType)
+            return NULL;
+        if (!data)
+            data = new TypedVertexAttributeData<T>();
+        return (TypedVertexAttributeData<T> *)data;
+    }
+    
+    /// Add a run of values, if the type matches
+    template<typename T> void addValues(const T *vals,int count)
+    {
+        TypedVertexAttributeData<T> *typed = typedData<T>();
+        if (typed)
+            typed->add(vals,count);
+    }
+    
+    /// Copy count elements, starting at start, into an interleaved vertex buffer.
+    /// Uses the buffer offset we've already calculated.
+    void interleave(unsigned char *basePtr,int stride,int start,int count) const;
+    
+    /// Rearrange the elements.  New element i is old element newToOld[i].
+    void remap(const std::vector<GLuint> &newToOld);
+    
+    /// Return the number of components as needed by glVertexAttribPointer.
+    /// Pass in false for the data as we store it, rather than packed in a buffer.
+    GLuint glEntryComponents(bool packed=true) const;
+    
+    /// Return the data type as required by glVertexAttribPointer
+    GLenum glType(bool packed=true) const;
+    
+    /// Whether or not glVertexAttribPointer will normalize the data
+    GLboolean glNormalize(bool packed=true) const;
+    
+    /// Calls glVertexAttrib* for the appropriate type
+    void glSetDefault(int index) const;
+        
+public:
+    /// Data type for the attribute data
+    BDAttributeDataType dataType;
+    /// Packing used in the interleaved vertex buffer
+    BDAttributePacking packing;
+    /// Name used in the shader
+    std::string name;
+    /// Default value to pass to OpenGL if there's no data array
+    union {
+        float vec3[3];
+        float vec2[2];
+        float floatVal;
+        unsigned char color[4];
+    } defaultData;
+    /// Attribute data.  Use typedData() to get at the actual values.
+    VertexAttributeData *data;
+    /// Buffer offset within interleaved vertex
+    GLuint buffer;
+};
+
+}
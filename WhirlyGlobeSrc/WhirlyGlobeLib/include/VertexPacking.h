@@ -0,0 +1,81 @@
+/*
+ *  VertexPacking.h
+ *  WhirlyGlobeLib
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <Eigen/Eigen>
+
+namespace WhirlyKit
+{
+    
+/** These are the conversions we use to pack vertex data into compact
+    formats for the interleaved vertex buffers.  The unpacking side
+    matches what OpenGL ES 2.0 does for normalized data, so you can
+    use it to check precision on the CPU.
+  */
+
+/// Convert a float to a 16 bit half float (round to nearest)
+unsigned short FloatToHalf(float val);
+/// Convert a 16 bit half float back to a float
+float HalfToFloat(unsigned short val);
+
+/// Pack a value in [-1,1] into a normalized signed short
+short PackNormShort(float val);
+/// Unpack a normalized signed short the way OpenGL ES 2.0 does
+float UnpackNormShort(short val);
+    
+/// Pack a value in [0,1] into a normalized unsigned short
+unsigned short PackNormUShort(float val);
+/// Unpack a normalized unsigned short the way OpenGL ES 2.0 does
+float UnpackNormUShort(unsigned short val);
+
+/// Pack a value in [-1,1] into a normalized signed byte
+signed char PackNormByte(float val);
+/// Unpack a normalized signed byte the way OpenGL ES 2.0 does
+float UnpackNormByte(signed char val);
+
+/// Octahedral encoding of a unit normal into two signed bytes
+void PackOctNormal(const Eigen::Vector3f &norm,signed char *ret);
+/// Decode an octahedral normal back into a unit vector
+Eigen::Vector3f UnpackOctNormal(const signed char *vals);
+
+/** Positions are stored as normalized shorts relative to a center
+    with a single scale.  You decode with center + scale * value.
+  */
+class PositionQuantizer
+{
+public:
+    /// Construct with the center and scale
+    PositionQuantizer(const Eigen::Vector3f &center,float scale);
+    
+    /// Calculate the center and scale for a set of points
+    PositionQuantizer(const Eigen::Vector3f *pts,int numPts);
+    
+    /// Pack a point into 4 shorts.  The last is padding.
+    void pack(const Eigen::Vector3f &pt,short *ret) const;
+    
+    /// Unpack a point the way the GPU will see it
+    Eigen::Vector3f unpack(const short *vals) const;
+    
+    /// Center of the points
+    Eigen::Vector3f center;
+    /// Scale applied to the normalized values
+    float scale;
+};
+
+}
@@ -0,0 +1,82 @@
+/*
+ *  WorkerPool.h
+ *  WhirlyGlobeLib
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <pthread.h>
+#import <vector>
+
+namespace WhirlyKit
+{
+
+/** A task that can be split into pieces for the worker pool.
+    Pieces may run on any of the pool's threads, in any order,
+    so they shouldn't write to anything they share.
+  */
+class WorkerTask
+{
+public:
+    virtual ~WorkerTask() { }
+    
+    /// Do one piece of the work.  The thread number is for picking per-thread scratch space.
+    virtual void runPiece(int which,int thread) = 0;
+};
+
+/** A small pool of threads for splitting up per-frame work, like culling.
+    The thread calling run() pitches in too, so a pool with no extra threads
+    just does everything in place.  Pieces are handed out one at a time,
+    so a few slow ones don't hold everyone else up.
+    Only one thread should call run() at once.
+  */
+class WorkerPool
+{
+public:
+    /// Construct with the number of extra threads to start
+    WorkerPool(int numExtraThreads);
+    /// Waits for the threads to exit
+    ~WorkerPool();
+    
+    /// Number of threads that'll work on a task, including the caller
+    int getNumThreads() { return (int)threads.size()+1; }
+    
+    /// Run all the pieces of the task and return when they're done
+    void run(WorkerTask *task,int numPieces);
+    
+    /// A reasonable number of extra threads for this device.
+    /// We leave a core for the render thread and another for the layer threads.
+    static int defaultNumThreads(int maxThreads);
+    
+protected:
+    static void *threadMain(void *arg);
+    void workerLoop(int thread);
+    void runPieces(int thread);
+    
+    pthread_mutex_t lock;
+    pthread_cond_t startCond,doneCond;
+    std::vector<pthread_t> threads;
+    bool shutdown;
+    // Bumped for every task so the workers know there's something new
+    int generation;
+    // Workers still on the current task
+    int numBusy;
+    WorkerTask *task;
+    int numPieces;
+    volatile int nextPiece;
+};
+
+}
@@ -0,0 +1,233 @@
+/*
+ *  BakedAtlas.mm
+ *  WhirlyGlobeLib
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <algorithm>
+#import <cstdio>
+#import <cstring>
+#import "BakedAtlas.h"
+#import "RectPacker.h"
+
+namespace WhirlyKit
+{
+
+static const unsigned int BakedAtlasMagic = 0x54414b57;  // 'WKAT'
+static const unsigned int BakedAtlasVersion = 1;
+static const unsigned int BakedAtlasHeaderSize = 32;
+static const unsigned int BakedAtlasEntrySize = 16;
+static const unsigned int BakedAtlasPageAlign = 4096;
+// Nothing we'd load is bigger than this, and it keeps the size math well away from overflowing
+static const unsigned int BakedAtlasMaxTexSize = 8192;
+    
+// Little endian readers and writers
+static void PutU32(std::vector<unsigned char> &buf,unsigned int val)
+{
+    for (unsigned int ii=0;ii<4;ii++)
+        buf.push_back((val >> (8*ii)) & 0xff);
+}
+    
+static void PutU16(std::vector<unsigned char> &buf,unsigned int val)
+{
+    buf.push_back(val & 0xff);
+    buf.push_back((val >> 8) & 0xff);
+}
+    
+static unsigned int GetU32(const unsigned char *data)
+{
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((unsigned int)data[3] << 24);
+}
+
+static unsigned int GetU16(const unsigned char *data)
+{
+    return data[0] | (data[1] << 8);
+}
+    
+// Pack the biggest images first, it works out better
+class ImageOrder
+{
+public:
+    ImageOrder(const std::vector<BakedAtlasImage> &images) : images(images) { }
+    bool operator()(int a,int b) const
+    {
+        int areaA = images[a].width*images[a].height, areaB = images[b].width*images[b].height;
+        if (areaA == areaB)
+            return a < b;
+        return areaA > areaB;
+    }
+    const std::vector<BakedAtlasImage> &images;
+};
+
+bool BakedAtlas::bake(const std::vector<BakedAtlasImage> &images,int inTexSize,int cellSize)
+{
+    texSize = inTexSize;
+    entries.clear();
+    pages.clear();
+    if (texSize <= 0 || cellSize <= 0)
+        return false;
+    int numCell = texSize/cellSize;
+
+    std::vector<int> order(images.size());
+    for (unsigned int ii=0;ii<images.size();ii++)
+        order[ii] = ii;
+    std::sort(order.begin(),order.end(),ImageOrder(images));
+    
+    std::vector<RectPacker> packers;
+    entries.resize(images.size());
+    for (unsigned int oi=0;oi<order.size();oi++)
+    {
+        const BakedAtlasImage &image = images[order[oi]];
+        if (image.width <= 0 || image.height <= 0 || image.width > texSize || image.height > texSize ||
+            image.pixels.size() < (size_t)image.width*image.height*4)
+            return false;
+        int cellsX = (image.width+cellSize-1)/cellSize, cellsY = (image.height+cellSize-1)/cellSize;
+        
+        // Look for a page it'll fit on, or start a new one
+        RectPacker::Rect rect;
+        int page = -1;
+        for (unsigned int pi=0;pi<packers.size() && page < 0;pi++)
+            if (packers[pi].findSpot(cellsX,cellsY,rect))
+                page = pi;
+        if (page < 0)
+        {
+            packers.push_back(RectPacker(numCell,numCell));
+            pages.push_back(std::vector<unsigned char>((size_t)texSize*texSize*4,0));
+            page = packers.size()-1;
+            if (!packers[page].findSpot(cellsX,cellsY,rect))
+                return false;
+        }
+        packers[page].reserve(rect);
+        
+        BakedAtlasEntry &entry = entries[order[oi]];
+        entry.name = image.name;
+        entry.page = page;
+        entry.x = rect.x*cellSize;  entry.y = rect.y*cellSize;
+        entry.width = image.width;  entry.height = image.height;
+        
+        // Copy the texels in, a row at a time
+        std::vector<unsigned char> &pageData = pages[page];
+        for (int iy=0;iy<image.height;iy++)
+            memcpy(&pageData[((size_t)(entry.y+iy)*texSize + entry.x)*4], &image.pixels[(size_t)iy*image.width*4], image.width*4);
+    }
+    
+    return true;
+}
+    
+bool BakedAtlas::write(const std::string &fileName) const
+{
+    // Everything but the pages goes into one buffer
+    std::vector<unsigned char> names;
+    std::vector<unsigned char> table;
+    for (unsigned int ii=0;ii<entries.size();ii++)
+    {
+        const BakedAtlasEntry &entry = entries[ii];
+        PutU32(table,names.size());
+        PutU16(table,entry.page);
+        PutU16(table,entry.x);
+        PutU16(table,entry.y);
+        PutU16(table,entry.width);
+        PutU16(table,entry.height);
+        PutU16(table,0);
+        names.insert(names.end(),entry.name.begin(),entry.name.end());
+        names.push_back(0);
+    }
+    size_t pagesStart = BakedAtlasHeaderSize + table.size() + names.size();
+    pagesStart = (pagesStart + BakedAtlasPageAlign-1) / BakedAtlasPageAlign * BakedAtlasPageAlign;
+    
+    std::vector<unsigned char> header;
+    PutU32(header,BakedAtlasMagic);
+    PutU32(header,BakedAtlasVersion);
+    PutU32(header,texSize);
+    PutU32(header,pages.size());
+    PutU32(header,entries.size());
+    PutU32(header,names.size());
+    PutU32(header,pagesStart);
+    PutU32(header,0);
+    header.insert(header.end(),table.begin(),table.end());
+    header.insert(header.end(),names.begin(),names.end());
+    header.resize(pagesStart,0);
+    
+    FILE *fp = fopen(fileName.c_str(),"wb");
+    if (!fp)
+        return false;
+    bool ok = fwrite(&header[0],1,header.size(),fp) == header.size();
+    for (unsigned int ii=0;ii<pages.size() && ok;ii++)
+        ok = fwrite(&pages[ii][0],1,pages[ii].size(),fp) == pages[ii].size();
+    fclose(fp);
+    
+    return ok;
+}
+    
+bool BakedAtlas::parse(const unsigned char *data,size_t len)
+{
+    entries.clear();
+    pageOffsets.clear();
+    if (!data || len < BakedAtlasHeaderSize || GetU32(data) != BakedAtlasMagic || GetU32(data+4) != BakedAtlasVersion)
+        return false;
+    unsigned int fileTexSize = GetU32(data+8);
+    unsigned int numPages = GetU32(data+12);
+    unsigned int numEntries = GetU32(data+16);
+    unsigned int namesSize = GetU32(data+20);
+    size_t pagesStart = GetU32(data+24);
+    if (fileTexSize == 0 || fileTexSize > BakedAtlasMaxTexSize)
+        return false;
+    texSize = fileTexSize;
+    
+    // Check the sizes by dividing, so nothing can wrap around
+    size_t pageSize = (size_t)fileTexSize*fileTexSize*4;
+    if (numEntries > (len - BakedAtlasHeaderSize) / BakedAtlasEntrySize)
+        return false;
+    size_t tableEnd = BakedAtlasHeaderSize + (size_t)numEntries*BakedAtlasEntrySize;
+    if (pagesStart < tableEnd || pagesStart > len || namesSize > pagesStart - tableEnd ||
+        numPages > (len - pagesStart) / pageSize)
+        return false;
+    
+    const char *names = (const char *)(data + tableEnd);
+    entries.resize(numEntries);
+    for (unsigned int ii=0;ii<numEntries;ii++)
+    {
+        const unsigned char *entryData = data + BakedAtlasHeaderSize + (size_t)ii*BakedAtlasEntrySize;
+        unsigned int nameOffset = GetU32(entryData);
+        if (nameOffset >= namesSize)
+        {
+            entries.clear();
+            return false;
+        }
+        unsigned int page = GetU16(entryData+4);
+        unsigned int x = GetU16(entryData+6), y = GetU16(entryData+8);
+        unsigned int width = GetU16(entryData+10), height = GetU16(entryData+12);
+        // Each image has to sit entirely within its page
+        if (page >= numPages || width == 0 || height == 0 || x + width > fileTexSize || y + height > fileTexSize)
+        {
+            entries.clear();
+            return false;
+        }
+        BakedAtlasEntry &entry = entries[ii];
+        entry.name = std::string(names + nameOffset,strnlen(names + nameOffset,namesSize - nameOffset));
+        entry.page = page;
+        entry.x = x;  entry.y = y;
+        entry.width = width;  entry.height = height;
+    }
+    
+    for (unsigned int ii=0;ii<numPages;ii++)
+        pageOffsets.push_back(pagesStart + (size_t)ii*pageSize);
+    
+    return true;
+}
+
+}
@@ -38,15 +38,14 @@ BigDrawable::Buffer::Buffer()
 
 BigDrawable::BigDrawable(const std::string &name,int singleVertexSize,const std::vector<VertexAttribute> &templateAttributes,int singleElementSize,int numVertexBytes,int numElementBytes)
     : Drawable(name), singleVertexSize(singleVertexSize), vertexAttributes(templateAttributes), singleElementSize(singleElementSize), numVertexBytes(numVertexBytes), numElementBytes(numElementBytes), texId(0), drawPriority(0), requestZBuffer(false),
-    waitingOnSwap(false), programId(0), elementChunkSize(0), minVis(DrawVisibleInvalid), maxVis(DrawVisibleInvalid), minVisibleFadeBand(0.0), maxVisibleFadeBand(0.0)
+    waitingOnSwap(false), programId(0), elementChunkSize(0), minVis(DrawVisibleInvalid), maxVis(DrawVisibleInvalid), minVisibleFadeBand(0.0), maxVisibleFadeBand(0.0),
+    vertexAllocator(numVertexBytes/singleVertexSize), compaction(false),
+    elementAllocator(numElementBytes/singleElementSize), zeroElements(nil), elementBytesCopied(0)
 {
     activeBuffer = -1;
     
     pthread_mutex_init(&useMutex, nil);
     pthread_cond_init(&useCondition, nil);
-    
-    // Start with one region that covers the whole thing
-    vertexRegions.insert(Region(0,numVertexBytes));
 
     buffers[1].numElement = buffers[0].numElement = 0;
 }
@@ -123,7 +122,7 @@ void BigDrawable::teardownGL(OpenGLMemManager *memManager)
         theBuffer.elementBufferId = 0;
         theBuffer.changes.clear();
         if (theBuffer.vertexArrayObj)
-            glDeleteVertexArraysOES(1,&buffers[ii].vertexArrayObj);
+            GetGLBackend()->deleteVertexArrays(1,&buffers[ii].vertexArrayObj);
         theBuffer.vertexArrayObj = 0;
     }
 }
@@ -142,7 +141,7 @@ bool BigDrawable::isOn(WhirlyKitRendererFrameInfo *frameInfo) const
     if (minVis == DrawVisibleInvalid)
         return true;
     
-    float visVal = [frameInfo.theView heightAboveSurface];
+    float visVal = frameInfo.heightAboveSurface;
     
     return ((minVis <= visVal && visVal <= maxVis) ||
             (minVis <= visVal && visVal <= maxVis));
@@ -197,24 +196,32 @@ void BigDrawable::draw(WhirlyKitRendererFrameInfo *frameInfo,Scene *scene)
     }
 
     // Model/View/Projection matrix
-    prog->setUniform("u_mvpMatrix", frameInfo.mvpMat);
+    prog->setUniform(StdUniformMVPMatrix, frameInfo.mvpMat);
     
     // Fade is always mixed in
-    prog->setUniform("u_fade", fade);
+    prog->setUniform(StdUniformFade, fade);
     
     // Let the shaders know if we even have a texture
-    prog->setUniform("u_hasTexture", (glTexID != 0));
+    prog->setUniform(StdUniformHasTexture, (glTexID != 0));
+    
+    // Octahedral normals come in through their own attribute
+    bool octNormals = false;
+    for (unsigned int ii=0;ii<vertexAttributes.size();ii++)
+        if (vertexAttributes[ii].getPacking() == BDPackOctahedral)
+            octNormals = true;
+    prog->setUniform(StdUniformOctNormals, octNormals);
 
     // Texture
-    const OpenGLESUniform *texUni = prog->findUniform("s_baseMap");
+    // This stays bound after we draw, since the next drawable probably wants it too
+    const OpenGLESUniform *texUni = prog->getUniform(StdUniformBaseMap);
     bool hasTexture = glTexID != 0 && texUni;
+    [frameInfo.stateOpt setActiveTexture:GL_TEXTURE0];
+    CheckGLError("BigDrawable::draw() setActiveTexture");
+    [frameInfo.stateOpt setBoundTexture:(hasTexture ? glTexID : 0)];
+    CheckGLError("BigDrawable::draw() glBindTexture");
     if (hasTexture)
     {
-        [frameInfo.stateOpt setActiveTexture:GL_TEXTURE0];
-        CheckGLError("BigDrawable::draw() setActiveTexture");
-        glBindTexture(GL_TEXTURE_2D, glTexID);
-        CheckGLError("BigDrawable::draw() glBindTexture");
-        prog->setUniform("s_baseMap", 0);
+        prog->setUniform(StdUniformBaseMap, 0);
         CheckGLError("BigDrawable::draw() glUniform1i");
     }
 
@@ -224,17 +231,20 @@ void BigDrawable::draw(WhirlyKitRendererFrameInfo *frameInfo,Scene *scene)
     // Set up a VAO for this buffer, if there isn't one
     if (theBuffer.vertexArrayObj == 0)
     {
-        glGenVertexArraysOES(1,&theBuffer.vertexArrayObj);
-        glBindVertexArrayOES(theBuffer.vertexArrayObj);
+        GetGLBackend()->genVertexArrays(1,&theBuffer.vertexArrayObj);
+        // Recording a command list can run out of names.  We'll try again next frame.
+        if (!theBuffer.vertexArrayObj)
+            return;
+        GetGLBackend()->bindVertexArray(theBuffer.vertexArrayObj);
 
-        glBindBuffer(GL_ARRAY_BUFFER,theBuffer.vertexBufferId);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, theBuffer.elementBufferId);
+        GetGLBackend()->bindBuffer(GL_ARRAY_BUFFER,theBuffer.vertexBufferId);
+        GetGLBackend()->bindBuffer(GL_ELEMENT_ARRAY_BUFFER, theBuffer.elementBufferId);
 
         // Vertex array
         if (vertAttr)
         {
-            glVertexAttribPointer(vertAttr->index, 3, GL_FLOAT, GL_FALSE, singleVertexSize, 0);
-            glEnableVertexAttribArray ( vertAttr->index );
+            GetGLBackend()->vertexAttribPointer(vertAttr->index, 3, GL_FLOAT, GL_FALSE, singleVertexSize, 0);
+            GetGLBackend()->enableVertexAttribArray( vertAttr->index );
         }
         
         const OpenGLESAttribute *progAttrs[vertexAttributes.size()];
@@ -242,7 +252,7 @@ void BigDrawable::draw(WhirlyKitRendererFrameInfo *frameInfo,Scene *scene)
         {
             progAttrs[ii] = NULL;
             VertexAttribute &attr = vertexAttributes[ii];
-            const OpenGLESAttribute *progAttr = prog->findAttribute(attr.name);
+            const OpenGLESAttribute *progAttr = prog->findAttribute(attr.glName());
             // The program is looking for this one, so we need to set up something
             if (progAttr)
             {
@@ -250,26 +260,28 @@ void BigDrawable::draw(WhirlyKitRendererFrameInfo *frameInfo,Scene *scene)
                 if (attr.buffer != 0)
                 {
                     progAttrs[ii] = progAttr;
-                    glVertexAttribPointer(progAttr->index, attr.glEntryComponents(), attr.glType(), attr.glNormalize(), singleVertexSize, CALCBUFOFF(0, attr.buffer));
-                    glEnableVertexAttribArray(progAttr->index);
+                    GetGLBackend()->vertexAttribPointer(progAttr->index, attr.glEntryComponents(), attr.glType(), attr.glNormalize(), singleVertexSize, CALCBUFOFF(0, attr.buffer));
+                    GetGLBackend()->enableVertexAttribArray(progAttr->index);
                 }
             }
         }
         
-        glBindVertexArrayOES(0);
+        GetGLBackend()->bindVertexArray(0);
         
         // Let a subclass set up their own VAO state
         setupAdditionalVAO(prog,theBuffer.vertexArrayObj);
 
         // Tear it all down
         if (vertAttr)
-            glDisableVertexAttribArray(vertAttr->index);
+            GetGLBackend()->disableVertexAttribArray(vertAttr->index);
         for (unsigned int ii=0;ii<vertexAttributes.size();ii++)
             if (progAttrs[ii])
-                glDisableVertexAttribArray(progAttrs[ii]->index);
+                GetGLBackend()->disableVertexAttribArray(progAttrs[ii]->index);
         
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        GetGLBackend()->bindBuffer(GL_ARRAY_BUFFER, 0);
+        GetGLBackend()->bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        // That was all behind the state optimizer's back
+        [frameInfo.stateOpt resetBindings];
     }
     
     // For the program attributes that we're not filling in, we need to provide defaults
@@ -282,16 +294,9 @@ void BigDrawable::draw(WhirlyKitRendererFrameInfo *frameInfo,Scene *scene)
     }
     
     // Draw it
-    glBindVertexArrayOES(theBuffer.vertexArrayObj);
-    glDrawElements(GL_TRIANGLES, theBuffer.numElement, GL_UNSIGNED_SHORT, 0);
-    glBindVertexArrayOES(0);
-    
-    // Unbind any texture
-    if (hasTexture)
-    {
-        [frameInfo.stateOpt setActiveTexture:GL_TEXTURE0];
-        glBindTexture(GL_TEXTURE_2D, 0);
-}
+    // The VAO stays bound.  Anything drawing without one will unbind it.
+    [frameInfo.stateOpt setVertexArray:theBuffer.vertexArrayObj];
+    GetGLBackend()->drawElements(GL_TRIANGLES, theBuffer.numElement, GL_UNSIGNED_SHORT, 0);
 }
     
 SimpleIdentity BigDrawable::addRegion(NSMutableData *vertData,int &vertPos,NSMutableData *elementData,bool enabled)
@@ -300,35 +305,32 @@ SimpleIdentity BigDrawable::addRegion(NSMutableData *vertData,int &vertPos,NSMut
     size_t elementSize = [elementData length];
     
     // Make sure there's room for the elements
-    if (elementSize + elementChunkSize >= numElementBytes)
-        return EmptyIdentity;
-    
-    // Let's look for a region large enough to contain the new vertices
-    RegionSet::iterator vrit;
-    for (vrit = vertexRegions.begin(); vrit != vertexRegions.end(); ++vrit)
+    int elRegion = -1;
+    if (elementSize > 0)
     {
-        if ((*vrit).len >= vertexSize)
+        elRegion = elementAllocator.allocate(elementSize/singleElementSize);
+        if (elRegion < 0 && elementSize + elementChunkSize < numElementBytes)
         {
-            break;
+            // There's room, it's just in pieces
+            repackElements();
+            elRegion = elementAllocator.allocate(elementSize/singleElementSize);
         }
+        if (elRegion < 0)
+            return EmptyIdentity;
     }
+    
+    // Let's look for a region large enough to contain the new vertices
+    int region = vertexAllocator.allocate(vertexSize/singleVertexSize);
     // Not enough room
-    if (vrit == vertexRegions.end())
-        return EmptyIdentity;
-
-    // Get rid of the old vertex region
+    if (region < 0)
     {
-        Region theRegion = *vrit;
-        vertexRegions.erase(vrit);
-
-        // Set up the change and let the caller know where it wound up
-        vertPos = theRegion.pos;
-        
-        // Split up the remaining space, if there is any
-        Region newRegion(theRegion.pos + vertexSize,theRegion.len - vertexSize);
-        if (newRegion.len > 0)
-            vertexRegions.insert(newRegion);
+        if (elRegion >= 0)
+            elementAllocator.free(elRegion);
+        return EmptyIdentity;
     }
+    
+    // Let the caller know where it wound up
+    vertPos = vertexAllocator.getOffset(region)*singleVertexSize;
 
     // Set up the vertex buffer change for processing later
     ChangeRef change (new Change(ChangeAdd,vertPos,vertData));
@@ -358,8 +360,16 @@ SimpleIdentity BigDrawable::addRegion(NSMutableData *vertData,int &vertPos,NSMut
     // Toss the element chunk into the set.  It'll be dealt with during the next flush
     ElementChunk elementChunk(elementData);
     elementChunk.enabled = enabled;
+    elementChunk.region = region;
+    elementChunk.vertPos = vertPos;
+    if (compaction)
+        elementChunk.vertData = vertData;
+    elementChunk.elRegion = elRegion;
+    elementChunk.elPos = (elRegion >= 0) ? elementAllocator.getOffset(elRegion)*singleElementSize : 0;
     elementChunks.insert(elementChunk);
     elementChunkSize += elementSize;
+    regionsByPos[vertPos] = elementChunk.getId();
+    patchElements(elementChunk);
     
     return elementChunk.getId();
 }
@@ -370,63 +380,61 @@ void BigDrawable::setEnableRegion(SimpleIdentity elementChunkId, bool enabled)
     if (it == elementChunks.end())
         return;
     
+    if (it->enabled == enabled)
+        return;
+    
     ElementChunk theChunk(*it);
     elementChunks.erase(it);
     theChunk.enabled = enabled;
     elementChunks.insert(theChunk);
     
-    // We just want to force an element rebuild
-    ChangeRef change (new Change(ChangeElements,0,nil));
-    for (unsigned int ii=0;ii<2;ii++)
-        buffers[ii].changes.push_back(change);
+    // Just this chunk's spot in the element buffer needs to change
+    patchElements(theChunk);
 }
- 
-void BigDrawable::removeRegion(RegionSet &regions,int pos,int size)
-{
-//    NSLog(@"Removing vertex region (pos,size) = (%d,%d), existing regions = %ld",pos,size,regions.size());
-    
-    // Now look for where to put the region back
-    Region thisRegion(pos,size);
     
-    if (regions.empty())
+void BigDrawable::patchElements(const ElementChunk &chunk)
+{
+    if (chunk.elRegion < 0)
+        return;
+    if (!chunk.enabled)
     {
-        regions.insert(thisRegion);
+        clearElements(chunk.elPos,[chunk.elementData length]);
         return;
     }
     
-    RegionSet::iterator prevIt = regions.end();
-    RegionSet::iterator nextIt = regions.begin();
-    while (nextIt->pos < thisRegion.pos && nextIt != regions.end())
-    {
-        prevIt = nextIt;
-        nextIt++;
-    }
+    ChangeRef change (new Change(ChangeElementPatch,chunk.elPos,chunk.elementData));
+    for (unsigned int ii=0;ii<2;ii++)
+        buffers[ii].changes.push_back(change);
+}
     
-    // Possibly merge with previous region
-    if (prevIt != regions.end())
-    {
-        const Region &prevRegion = *prevIt;
-        if (prevRegion.pos + prevRegion.len == thisRegion.pos)
-        {
-            thisRegion.pos = prevRegion.pos;
-            thisRegion.len = thisRegion.len + prevRegion.len;
-            regions.erase(prevIt);
-        }
-    }
-    // Possibly merge with the next region
-    if (nextIt != regions.end())
+void BigDrawable::clearElements(int elPos,int len)
+{
+    ChangeRef change (new Change(ChangeElementClear,elPos,nil,len));
+    for (unsigned int ii=0;ii<2;ii++)
+        buffers[ii].changes.push_back(change);
+}
+    
+void BigDrawable::repackElements()
+{
+    // Chunks are sorted by ID, which is more or less the order they came in
+    elementAllocator = RegionAllocator(numElementBytes/singleElementSize);
+    ElementChunkSet newChunks;
+    for (ElementChunkSet::iterator it = elementChunks.begin();
+         it != elementChunks.end(); ++it)
     {
-        const Region &nextRegion = *nextIt;
-        if (thisRegion.pos + thisRegion.len == nextRegion.pos)
-        {
-            thisRegion.len = thisRegion.len + nextRegion.len;
-            regions.erase(nextIt);
-        }
+        ElementChunk theChunk(*it);
+        theChunk.elRegion = elementAllocator.allocate([theChunk.elementData length]/singleElementSize);
+        theChunk.elPos = (theChunk.elRegion >= 0) ? elementAllocator.getOffset(theChunk.elRegion)*singleElementSize : 0;
+        newChunks.insert(theChunk);
     }
+    elementChunks.swap(newChunks);
     
-    regions.insert(thisRegion);
+    // Everything moved, so both buffers need a full rebuild
+    ChangeRef change (new Change(ChangeElements,0,nil));
+    for (unsigned int ii=0;ii<2;ii++)
+        buffers[ii].changes.push_back(change);
 }
-
+ 
 void BigDrawable::clearRegion(int vertPos,int vertSize,SimpleIdentity elementChunkId)
 {
     if (vertPos+vertSize > numVertexBytes)
@@ -441,12 +449,19 @@ void BigDrawable::clearRegion(int vertPos,int vertSize,SimpleIdentity elementChu
 //    for (unsigned int ii=0;ii<2;ii++)
 //        buffers[ii].changes.push_back(change);
 
-    removeRegion(vertexRegions,vertPos,vertSize);
-
-    // Remove the element chunk.  The next flush will pick it up.
+    // Remove the element chunk and free up its vertices.  The next flush will pick it up.
     ElementChunkSet::iterator it = elementChunks.find(ElementChunk(elementChunkId));
     if (it != elementChunks.end())
     {
+        vertexAllocator.free(it->region);
+        regionsByPos.erase(it->vertPos);
+        if (it->elRegion >= 0)
+        {
+            elementAllocator.free(it->elRegion);
+            // Degenerate out the elements.  Anything below the high water mark gets drawn.
+            if (it->enabled)
+                clearElements(it->elPos,[it->elementData length]);
+        }
         elementChunkSize -= [it->elementData length];
         elementChunks.erase(it);
     } else
@@ -459,83 +474,151 @@ void BigDrawable::clearRegion(int vertPos,int vertSize,SimpleIdentity elementChu
 
 void BigDrawable::getUtilization(int &vertSize,int &elSize)
 {
-    vertSize = numVertexBytes;
+    RegionAllocatorStats stats;
+    vertexAllocator.getStats(stats);
+    vertSize = stats.usedSize*singleVertexSize;
     elSize = elementChunkSize;
-    for (RegionSet::iterator it = vertexRegions.begin();
-         it != vertexRegions.end(); ++it)
+}
+    
+void BigDrawable::getVertexStats(RegionAllocatorStats &stats)
+{
+    vertexAllocator.getStats(stats);
+}
+    
+int BigDrawable::compact(int maxBytes)
+{
+    if (!compaction)
+        return 0;
+    
+    // Walk the regions in order, sliding each one down into any hole before it.
+    // Both buffers get a copy of the data at the new spot and the element data
+    //  is adjusted to match.  Each buffer picks up the move along with its
+    //  element rebuild in its next flush, so the active buffer is never out of sync.
+    std::vector<std::pair<int,SimpleIdentity> > regions(regionsByPos.begin(),regionsByPos.end());
+    int movedBytes = 0;
+    for (unsigned int ii=0;ii<regions.size() && movedBytes < maxBytes;ii++)
     {
-        vertSize -= it->len;
+        ElementChunkSet::iterator it = elementChunks.find(ElementChunk(regions[ii].second));
+        if (it == elementChunks.end() || !it->vertData)
+            continue;
+        if (!vertexAllocator.moveDown(it->region))
+            continue;
+        
+        ElementChunk theChunk(*it);
+        elementChunks.erase(it);
+        int newVertPos = vertexAllocator.getOffset(theChunk.region)*singleVertexSize;
+        int vertOffset = (theChunk.vertPos - newVertPos)/singleVertexSize;
+        
+        size_t elementSize = [theChunk.elementData length];
+        if (singleElementSize == sizeof(GLushort))
+        {
+            GLushort *elPtr = (GLushort *)[theChunk.elementData mutableBytes];
+            for (unsigned int jj=0;jj<elementSize/2;jj++,elPtr++)
+                *elPtr -= vertOffset;
+        } else {
+            GLuint *elPtr = (GLuint *)[theChunk.elementData mutableBytes];
+            for (unsigned int jj=0;jj<elementSize/4;jj++,elPtr++)
+                *elPtr -= vertOffset;
+        }
+        
+        ChangeRef change (new Change(ChangeAdd,newVertPos,theChunk.vertData));
+        for (unsigned int jj=0;jj<2;jj++)
+            buffers[jj].changes.push_back(change);
+        
+        regionsByPos.erase(theChunk.vertPos);
+        theChunk.vertPos = newVertPos;
+        regionsByPos[newVertPos] = theChunk.getId();
+        elementChunks.insert(theChunk);
+        if (theChunk.enabled)
+            patchElements(theChunk);
+        
+        movedBytes += [theChunk.vertData length];
     }
+    
+    return movedBytes;
 }
 
 void BigDrawable::executeFlush(int whichBuffer)
 {    
     Buffer &theBuffer = buffers[whichBuffer];
     
-    if (!theBuffer.changes.empty())
-    {
-        // Run the additions to the vertex buffer
-        glBindBuffer(GL_ARRAY_BUFFER, theBuffer.vertexBufferId);
-        for (unsigned int ii=0;ii<theBuffer.changes.size();ii++)
-        {
-            ChangeRef change = theBuffer.changes[ii];
-            switch (change->type)
-            {
-                case ChangeAdd:
-                    glBufferSubData(GL_ARRAY_BUFFER, change->whereVert, [change->vertData length], [change->vertData bytes]);
-//                    if (change->whereVert + [change->vertData length] > numVertexBytes)
-//                    {
-//                        NSLog(@"Exceeded vertex buffer size");
-//                    }
-//                    if (change->whereVert % singleVertexSize != 0)
-//                    {
-//                        NSLog(@"Offset problem in vertex buffer");
-//                    }
-                    break;
-                case ChangeClear:
-                    // We don't really need to clear this, just stop using it
-//                    glBufferSubData(GL_ARRAY_BUFFER, change->whereVert, [change->vertData length], [change->vertData bytes]);
-//                    if (change->whereVert + [change->vertData length] > numVertexBytes)
-//                    {
-//                        NSLog(@"Exceeded vertex buffer size");
-//                    }
-                    break;
-                case ChangeElements:
-                    // This is just here to nudge the element rebuild
-                    break;
-            }
-        }
+    if (theBuffer.changes.empty())
+        return;
 
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        theBuffer.changes.clear();
+    // A full element rebuild makes any patches before it redundant
+    int lastRebuild = -1;
+    for (unsigned int ii=0;ii<theBuffer.changes.size();ii++)
+        if (theBuffer.changes[ii]->type == ChangeElements)
+            lastRebuild = ii;
+    
+    // Run the additions to the vertex buffer
+    GetGLBackend()->bindBuffer(GL_ARRAY_BUFFER, theBuffer.vertexBufferId);
+    for (unsigned int ii=0;ii<theBuffer.changes.size();ii++)
+    {
+        ChangeRef change = theBuffer.changes[ii];
+        if (change->type == ChangeAdd)
+            GetGLBackend()->bufferSubData(GL_ARRAY_BUFFER, change->whereVert, [change->vertData length], [change->vertData bytes]);
+        // We don't really need to clear vertices, just stop using them
     }
-
-    // Redo the entire element buffer
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, theBuffer.elementBufferId);
-    GLubyte *elBuffer = (GLubyte *)glMapBufferOES(GL_ELEMENT_ARRAY_BUFFER, GL_WRITE_ONLY_OES);
-    GLubyte *elBufPtr = elBuffer;
-    int elBufferSize = 0;
-    for (ElementChunkSet::iterator it = elementChunks.begin();
-         it != elementChunks.end(); ++it)
-        if (it->enabled)
+    GetGLBackend()->bindBuffer(GL_ARRAY_BUFFER, 0);
+    
+    unsigned int elHighWater = elementAllocator.getHighWater();
+    GetGLBackend()->bindBuffer(GL_ELEMENT_ARRAY_BUFFER, theBuffer.elementBufferId);
+    if (lastRebuild >= 0)
     {
-        size_t len = [it->elementData length];
-        memcpy(elBufPtr, [it->elementData bytes], len);
-        elBufPtr += len;
-        elBufferSize += len;
+        // Redo the entire element buffer.  Holes are zeroed out into degenerates.
+        GLubyte *elBuffer = (GLubyte *)GetGLBackend()->mapBuffer(GL_ELEMENT_ARRAY_BUFFER, GL_WRITE_ONLY_OES);
+        memset(elBuffer, 0, elHighWater * singleElementSize);
+        for (ElementChunkSet::iterator it = elementChunks.begin();
+             it != elementChunks.end(); ++it)
+            if (it->enabled)
+            {
+                size_t len = [it->elementData length];
+                memcpy(elBuffer + it->elPos, [it->elementData bytes], len);
+            }
+        GetGLBackend()->unmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+        elementBytesCopied += elHighWater * singleElementSize;
     }
-    if (elBufPtr - elBuffer > numElementBytes)
+    
+    // Patch in whatever changed since the last rebuild
+    for (unsigned int ii=lastRebuild+1;ii<theBuffer.changes.size();ii++)
     {
-        NSLog(@"Exceeded element buffer size");
+        ChangeRef change = theBuffer.changes[ii];
+        switch (change->type)
+        {
+            case ChangeElementPatch:
+                GetGLBackend()->bufferSubData(GL_ELEMENT_ARRAY_BUFFER, change->whereVert, [change->vertData length], [change->vertData bytes]);
+                elementBytesCopied += [change->vertData length];
+                break;
+            case ChangeElementClear:
+                if ([zeroElements length] < change->clearLen)
+                    zeroElements = [NSMutableData dataWithLength:change->clearLen];
+                GetGLBackend()->bufferSubData(GL_ELEMENT_ARRAY_BUFFER, change->whereVert, change->clearLen, [zeroElements bytes]);
+                elementBytesCopied += change->clearLen;
+                break;
+            default:
+                break;
+        }
     }
-    glUnmapBufferOES(GL_ELEMENT_ARRAY_BUFFER);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-    theBuffer.numElement = elBufferSize / singleElementSize;
+    GetGLBackend()->bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    
+    theBuffer.changes.clear();
+    theBuffer.numElement = elHighWater;
 }
     
 // If set, we'll do the flushes on the main thread
 static const bool MainThreadFlush = false;
     
+// We'll start compacting when the free space is this fragmented
+static const float BigDrawableCompactFragmentation = 0.25;
+// And we'll move no more than this fraction of the vertex buffer per swap
+static const float BigDrawableCompactFraction = 0.05;
+// HeadlessTests/ElementPatchBench copies the next two, so change it too
+// We'll repack the element buffer when this much of it is holes
+static const float BigDrawableRepackFraction = 0.25;
+// But not if it's smaller than this (in elements)
+static const unsigned int BigDrawableRepackMin = 16384;
+    
 void BigDrawable::swap(ChangeSet &changes,BigDrawableSwap *swapRequest)
 {
     // If we're waiting on a swap, no flushing
@@ -549,6 +632,22 @@ void BigDrawable::swap(ChangeSet &changes,BigDrawableSwap *swapRequest)
     // That's the one we modify
     int whichBuffer = (activeBuffer == 0 ? 1 : 0);
     
+    // If there are too many holes in the element buffers, we're drawing a lot of
+    //  degenerates, so it's worth a full rebuild
+    unsigned int elHighWater = elementAllocator.getHighWater();
+    unsigned int elUsed = elementChunkSize/singleElementSize;
+    if (elHighWater > BigDrawableRepackMin && elHighWater - elUsed > elHighWater * BigDrawableRepackFraction)
+        repackElements();
+    
+    // Close up some of the holes, if it's gotten fragmented enough to matter
+    if (compaction)
+    {
+        RegionAllocatorStats stats;
+        vertexAllocator.getStats(stats);
+        if (stats.fragmentation() > BigDrawableCompactFragmentation)
+            compact(numVertexBytes * BigDrawableCompactFraction);
+    }
+    
     // Note: In theory we shouldn't need to swap if there are no changes.
     //       However, this doesn't work right if we turn on this optimization.
     // No changes, no work
@@ -597,16 +696,16 @@ void BigDrawable::swapBuffers(int whichBuffer)
         Buffer &theBuffer = buffers[ii];
         if (theBuffer.vertexArrayObj)
         {
-            glDeleteVertexArraysOES(1,&theBuffer.vertexArrayObj);
+            GetGLBackend()->deleteVertexArrays(1,&theBuffer.vertexArrayObj);
             theBuffer.vertexArrayObj = 0;
         }
 
         // Bind the buffer to get any new updates
         // Note: Don't think we need this
-        glBindBuffer(GL_ARRAY_BUFFER, theBuffer.vertexBufferId);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, theBuffer.elementBufferId);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        GetGLBackend()->bindBuffer(GL_ARRAY_BUFFER, theBuffer.vertexBufferId);
+        GetGLBackend()->bindBuffer(GL_ELEMENT_ARRAY_BUFFER, theBuffer.elementBufferId);
+        GetGLBackend()->bindBuffer(GL_ARRAY_BUFFER, 0);
+        GetGLBackend()->bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
     }
 }
 
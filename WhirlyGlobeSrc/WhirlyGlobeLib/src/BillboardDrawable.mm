@@ -20,6 +20,7 @@
 
 #import "BillboardDrawable.h"
 #import "OpenGLES2Program.h"
+#import "GLBackend.h"
 
 namespace WhirlyKit
 {
@@ -91,7 +92,7 @@ WhirlyKit::OpenGLES2Program *BuildBillboardProgram()
     // Set some reasonable defaults
     if (shader)
     {
-        glUseProgram(shader->getProgram());
+        GetGLBackend()->useProgram(shader->getProgram());
         
         shader->setUniform("u_eyeVec", Point3f(0,0,1));
     }
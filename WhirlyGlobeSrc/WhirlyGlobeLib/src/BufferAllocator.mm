@@ -0,0 +1,213 @@
+/*
+ *  BufferAllocator.mm
+ *  WhirlyGlobeLib
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <algorithm>
+#import "BufferAllocator.h"
+
+namespace WhirlyKit
+{
+    
+BufferSlabAllocator::BufferSlabAllocator(BufferSlabBackend *backend,unsigned int inSlabSize,unsigned int inMaxAllocSize)
+    : backend(backend)
+{
+    slabSize = (inSlabSize + Granule - 1) / Granule * Granule;
+    maxAllocSize = std::min(inMaxAllocSize,slabSize);
+    buckets.resize(bucketForSize(slabSize)+1);
+}
+    
+BufferSlabAllocator::~BufferSlabAllocator()
+{
+    clear();
+}
+    
+int BufferSlabAllocator::bucketForSize(unsigned int size) const
+{
+    int bucket = 0;
+    for (unsigned int units = size / Granule;units > 1;units >>= 1)
+        bucket++;
+    return bucket;
+}
+    
+void BufferSlabAllocator::addFreeBlock(Slab *slab,unsigned int offset,unsigned int size)
+{
+    slab->freeBlocks[offset] = size;
+    buckets[bucketForSize(size)].insert(FreeBlock(size,slab,offset));
+}
+
+void BufferSlabAllocator::removeFreeBlock(Slab *slab,unsigned int offset,unsigned int size)
+{
+    slab->freeBlocks.erase(offset);
+    buckets[bucketForSize(size)].erase(FreeBlock(size,slab,offset));
+}
+    
+BufferSlabAllocator::Slab *BufferSlabAllocator::addSlab()
+{
+    unsigned int bufId = backend->createBuffer(slabSize);
+    if (bufId == 0)
+        return NULL;
+    
+    Slab *slab = new Slab();
+    slab->bufferId = bufId;
+    slab->size = slabSize;
+    slab->usedBytes = 0;
+    slab->numAllocs = 0;
+    slabs[bufId] = slab;
+    addFreeBlock(slab,0,slabSize);
+    
+    return slab;
+}
+    
+void BufferSlabAllocator::removeSlab(Slab *slab)
+{
+    std::map<unsigned int,unsigned int> freeBlocks = slab->freeBlocks;
+    for (std::map<unsigned int,unsigned int>::iterator it = freeBlocks.begin();
+         it != freeBlocks.end(); ++it)
+        removeFreeBlock(slab,it->first,it->second);
+    slabs.erase(slab->bufferId);
+    backend->deleteBuffer(slab->bufferId);
+    delete slab;
+}
+    
+bool BufferSlabAllocator::allocate(unsigned int size,BufferAllocation &alloc)
+{
+    if (size == 0 || size > maxAllocSize)
+        return false;
+    size = (size + Granule - 1) / Granule * Granule;
+    
+    // Look for the smallest block that fits, starting in this size's bucket
+    const FreeBlock *found = NULL;
+    for (unsigned int bi=bucketForSize(size);bi<buckets.size();bi++)
+    {
+        std::set<FreeBlock>::iterator it = buckets[bi].lower_bound(FreeBlock(size,NULL,0));
+        if (it != buckets[bi].end())
+        {
+            found = &(*it);
+            break;
+        }
+    }
+    
+    FreeBlock block(0,NULL,0);
+    if (found)
+        block = *found;
+    else {
+        Slab *slab = addSlab();
+        if (!slab)
+            return false;
+        block = FreeBlock(slabSize,slab,0);
+    }
+    
+    // Take what we need off the front and put the rest back
+    removeFreeBlock(block.slab,block.offset,block.size);
+    if (block.size > size)
+        addFreeBlock(block.slab,block.offset+size,block.size-size);
+    block.slab->usedBytes += size;
+    block.slab->numAllocs++;
+    
+    alloc.bufferId = block.slab->bufferId;
+    alloc.offset = block.offset;
+    alloc.size = size;
+    
+    return true;
+}
+    
+void BufferSlabAllocator::free(const BufferAllocation &alloc)
+{
+    std::map<unsigned int,Slab *>::iterator sit = slabs.find(alloc.bufferId);
+    if (sit == slabs.end())
+        return;
+    Slab *slab = sit->second;
+    
+    unsigned int offset = alloc.offset;
+    unsigned int size = alloc.size;
+    slab->usedBytes -= size;
+    slab->numAllocs--;
+    
+    // Merge with the free block after us
+    std::map<unsigned int,unsigned int>::iterator next = slab->freeBlocks.lower_bound(offset);
+    if (next != slab->freeBlocks.end() && next->first == offset+size)
+    {
+        unsigned int nextSize = next->second;
+        removeFreeBlock(slab,next->first,nextSize);
+        size += nextSize;
+    }
+    
+    // And the one before
+    std::map<unsigned int,unsigned int>::iterator prev = slab->freeBlocks.lower_bound(offset);
+    if (prev != slab->freeBlocks.begin())
+    {
+        --prev;
+        if (prev->first + prev->second == offset)
+        {
+            unsigned int prevOffset = prev->first;
+            unsigned int prevSize = prev->second;
+            removeFreeBlock(slab,prevOffset,prevSize);
+            offset = prevOffset;
+            size += prevSize;
+        }
+    }
+    
+    addFreeBlock(slab,offset,size);
+    
+    // Give back empty slabs, but keep one around so we don't thrash
+    if (slab->numAllocs == 0)
+    {
+        for (std::map<unsigned int,Slab *>::iterator it = slabs.begin();
+             it != slabs.end(); ++it)
+            if (it->second != slab && it->second->numAllocs == 0)
+            {
+                removeSlab(slab);
+                break;
+            }
+    }
+}
+    
+bool BufferSlabAllocator::isSlabBuffer(unsigned int bufID) const
+{
+    return slabs.find(bufID) != slabs.end();
+}
+    
+void BufferSlabAllocator::getStats(BufferSlabStats &stats) const
+{
+    stats = BufferSlabStats();
+    for (std::map<unsigned int,Slab *>::const_iterator it = slabs.begin();
+         it != slabs.end(); ++it)
+    {
+        const Slab *slab = it->second;
+        stats.numSlabs++;
+        stats.numAllocs += slab->numAllocs;
+        stats.totalBytes += slab->size;
+        stats.usedBytes += slab->usedBytes;
+        for (std::map<unsigned int,unsigned int>::const_iterator fit = slab->freeBlocks.begin();
+             fit != slab->freeBlocks.end(); ++fit)
+        {
+            stats.freeBytes += fit->second;
+            stats.numFreeBlocks++;
+            stats.largestFreeBlock = std::max(stats.largestFreeBlock,fit->second);
+        }
+    }
+}
+    
+void BufferSlabAllocator::clear()
+{
+    while (!slabs.empty())
+        removeSlab(slabs.begin()->second);
+}
+
+}
@@ -36,14 +36,14 @@ void BufferBuilder::addToTotal(GLuint size)
 void BufferBuilder::addToTotal(BasicDrawable *drawable)
 {
     int vertices = drawable->getNumPoints() * drawable->singleVertexSize();
-    int tris = drawable->getNumTris() * sizeof(BasicDrawable::Triangle);
+    int tris = drawable->getNumTris() * 3 * drawable->singleElementSize();
     addToTotal(vertices+tris);
 }
     
 // Note: Turn off the clever bits for now. 11/21/12
 void BufferBuilder::setupGL(WhirlyKitGLSetupInfo *setupInfo,OpenGLMemManager *memManager,BasicDrawable *drawable)
 {
-    int thisSize = drawable->getNumPoints() * drawable->singleVertexSize() + drawable->getNumTris() * sizeof(BasicDrawable::Triangle);
+    int thisSize = drawable->getNumPoints() * drawable->singleVertexSize() + drawable->getNumTris() * 3 * drawable->singleElementSize();
     
     // Note: Disabling the buffer builder
     drawable->setupGL(setupInfo, memManager);
@@ -0,0 +1,382 @@
+/*
+ *  ChangeQueue.mm
+ *  WhirlyGlobeLib
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <typeinfo>
+#import <algorithm>
+#import "ChangeQueue.h"
+
+namespace WhirlyKit
+{
+    
+ChangeQueue::ChangeQueue()
+    : head(NULL), numChanges(0)
+{
+}
+    
+ChangeQueue::~ChangeQueue()
+{
+    ChangeSet changes;
+    takeAll(changes);
+    for (unsigned int ii=0;ii<changes.size();ii++)
+        delete changes[ii];
+}
+    
+void ChangeQueue::push(Batch *batch)
+{
+    __sync_fetch_and_add(&numChanges,(int)batch->changes.size());
+    
+    Batch *oldHead;
+    do
+    {
+        oldHead = head;
+        batch->next = oldHead;
+    } while (!__sync_bool_compare_and_swap(&head,oldHead,batch));
+}
+
+void ChangeQueue::add(ChangeRequest *change)
+{
+    Batch *batch = new Batch();
+    batch->changes.push_back(change);
+    push(batch);
+}
+    
+void ChangeQueue::add(const ChangeSet &changes)
+{
+    if (changes.empty())
+        return;
+    
+    Batch *batch = new Batch();
+    batch->changes = changes;
+    push(batch);
+}
+    
+void ChangeQueue::addAndClear(ChangeSet &changes)
+{
+    if (changes.empty())
+        return;
+    
+    Batch *batch = new Batch();
+    batch->changes.swap(changes);
+    push(batch);
+}
+    
+void ChangeQueue::takeAll(ChangeSet &changes)
+{
+    // We're the only one taking batches off, so there's no ABA problem here
+    Batch *batch = __sync_lock_test_and_set(&head,(Batch *)NULL);
+    if (!batch)
+        return;
+    
+    // The list is newest first, so flip it around
+    Batch *prev = NULL;
+    while (batch)
+    {
+        Batch *next = batch->next;
+        batch->next = prev;
+        prev = batch;
+        batch = next;
+    }
+    
+    int numTaken = 0;
+    for (batch = prev; batch; )
+    {
+        numTaken += batch->changes.size();
+        if (changes.empty())
+            changes.swap(batch->changes);
+        else
+            changes.insert(changes.end(),batch->changes.begin(),batch->changes.end());
+        Batch *next = batch->next;
+        delete batch;
+        batch = next;
+    }
+    __sync_fetch_and_sub(&numChanges,numTaken);
+}
+
+    
+ChangeStats::ChangeStats()
+    : numExecuted(0), numPending(0), execTime(0.0)
+{
+    for (unsigned int ii=0;ii<ChangePriorityCount;ii++)
+        numExecutedByPriority[ii] = 0;
+}
+    
+ChangeScheduler::ChangeScheduler()
+    : startTime(0.0), timeBudget(0.0)
+{
+    for (unsigned int ii=0;ii<ChangePriorityCount;ii++)
+        numPending[ii] = 0;
+}
+    
+ChangeScheduler::~ChangeScheduler()
+{
+    for (unsigned int ii=0;ii<pending.size();ii++)
+        delete pending[ii];
+    pending.clear();
+}
+    
+void ChangeScheduler::process(ChangeQueue &queue,Scene *scene,WhirlyKitSceneRendererES *renderer,WhirlyKitView *view)
+{
+    startTime = CFAbsoluteTimeGetCurrent();
+    stats = ChangeStats();
+    
+    // New ones go on the end, after whatever we didn't get to last time
+    ChangeSet newChanges;
+    queue.takeAll(newChanges);
+    if (pending.empty())
+        pending.swap(newChanges);
+    else
+        pending.insert(pending.end(),newChanges.begin(),newChanges.end());
+    
+    // Count up the classes and toss any empties
+    unsigned int numKept = 0;
+    for (unsigned int ii=0;ii<ChangePriorityCount;ii++)
+        numPending[ii] = 0;
+    for (unsigned int ii=0;ii<pending.size();ii++)
+    {
+        ChangeRequest *req = pending[ii];
+        if (!req)
+            continue;
+        pending[numKept++] = req;
+        numPending[req->getPriority()]++;
+    }
+    pending.resize(numKept);
+    
+    // With no budget everything runs this frame, so there's no point reordering
+    if (timeBudget <= 0.0)
+    {
+        for (unsigned int ii=0;ii<pending.size();ii++)
+        {
+            ChangeRequest *req = pending[ii];
+            ChangePriority reqPri = req->getPriority();
+            req->execute(scene,renderer,view);
+            delete req;
+            stats.numExecuted++;
+            stats.numExecutedByPriority[reqPri]++;
+        }
+        pending.clear();
+        for (unsigned int ii=0;ii<ChangePriorityCount;ii++)
+            numPending[ii] = 0;
+        stats.execTime = CFAbsoluteTimeGetCurrent() - startTime;
+        return;
+    }
+    
+    // One pass per priority class, most urgent first.
+    // Later passes pick up everything at their level or above that's still around.
+    bool outOfTime = false;
+    std::vector<SimpleIdentity> ids;
+    std::set<SimpleIdentity> blockedIDs;
+    for (int pri=0;pri<ChangePriorityCount && !outOfTime;pri++)
+    {
+        if (numPending[pri] == 0)
+            continue;
+        
+        // A request skipped in this pass blocks anything after it that touches the same IDs.
+        // One that doesn't know its IDs blocks everything after it, and can't go ahead of anything skipped.
+        blockedIDs.clear();
+        bool barrier = false, skipped = false;
+        for (unsigned int ii=0;ii<pending.size() && !barrier;ii++)
+        {
+            ChangeRequest *req = pending[ii];
+            if (!req)
+                continue;
+            
+            ids.clear();
+            bool knownIDs = req->getIDs(ids);
+            bool blocked = !knownIDs && skipped;
+            for (unsigned int jj=0;jj<ids.size() && !blocked;jj++)
+                if (blockedIDs.find(ids[jj]) != blockedIDs.end())
+                    blocked = true;
+            
+            ChangePriority reqPri = req->getPriority();
+            if (blocked || reqPri > pri)
+            {
+                skipped = true;
+                if (!knownIDs)
+                    barrier = true;
+                else
+                    blockedIDs.insert(ids.begin(),ids.end());
+                continue;
+            }
+            
+            // Always get at least one done per frame so we make progress
+            if (stats.numExecuted > 0 &&
+                CFAbsoluteTimeGetCurrent() - startTime > timeBudget)
+            {
+                outOfTime = true;
+                break;
+            }
+            
+            req->execute(scene,renderer,view);
+            delete req;
+            pending[ii] = NULL;
+            numPending[reqPri]--;
+            stats.numExecuted++;
+            stats.numExecutedByPriority[reqPri]++;
+        }
+    }
+    
+    // Squeeze out the ones we ran
+    numKept = 0;
+    for (unsigned int ii=0;ii<pending.size();ii++)
+        if (pending[ii])
+            pending[numKept++] = pending[ii];
+    pending.resize(numKept);
+    
+    stats.numPending = numKept;
+    stats.execTime = CFAbsoluteTimeGetCurrent() - startTime;
+}
+
+ChangeCoalesceStats::ChangeCoalesceStats()
+    : numChanges(0), numRemoved(0), numCancelled(0), numMerged(0)
+{
+}
+    
+ChangeCoalescer::ChangeCoalescer()
+{
+}
+
+void ChangeCoalescer::coalesce(ChangeSet &changes)
+{
+    typedef std::map<SimpleIdentity,TargetInfo> TargetMap;
+    TargetMap targets;
+    // Targets to drop from each request, by index
+    typedef std::map<int,std::set<SimpleIdentity> > DropMap;
+    DropMap drops;
+    
+    std::vector<SimpleIdentity> ids,coalesceIDs;
+    for (unsigned int ii=0;ii<changes.size();ii++)
+    {
+        ChangeRequest *req = changes[ii];
+        if (!req)
+            continue;
+        stats.numChanges++;
+        
+        // Nothing gets folded across one of these
+        ids.clear();
+        if (!req->getIDs(ids))
+        {
+            targets.clear();
+            continue;
+        }
+        
+        ChangeCoalesceType type = req->getCoalesceType();
+        coalesceIDs.clear();
+        if (type != ChangeCoalesceNone)
+            req->getCoalesceIDs(coalesceIDs);
+        
+        // Anything it only refers to, we can't fold across
+        if (ids.size() > coalesceIDs.size())
+        {
+            // Usually there's just one target, so skip the set for small ones
+            if (coalesceIDs.size() < 8)
+            {
+                for (unsigned int jj=0;jj<ids.size();jj++)
+                    if (std::find(coalesceIDs.begin(),coalesceIDs.end(),ids[jj]) == coalesceIDs.end())
+                        targets.erase(ids[jj]);
+            } else {
+                std::set<SimpleIdentity> targetIDs(coalesceIDs.begin(),coalesceIDs.end());
+                for (unsigned int jj=0;jj<ids.size();jj++)
+                    if (targetIDs.find(ids[jj]) == targetIDs.end())
+                        targets.erase(ids[jj]);
+            }
+        }
+        
+        for (unsigned int jj=0;jj<coalesceIDs.size();jj++)
+        {
+            SimpleIdentity targetID = coalesceIDs[jj];
+            switch (type)
+            {
+                case ChangeCoalesceAdd:
+                {
+                    TargetInfo &info = targets[targetID];
+                    info.addIndex = ii;
+                    info.updates.clear();
+                }
+                    break;
+                case ChangeCoalesceUpdate:
+                {
+                    // An earlier update of the same kind is replaced by this one
+                    TargetInfo &info = targets[targetID];
+                    unsigned int numKept = 0;
+                    for (unsigned int kk=0;kk<info.updates.size();kk++)
+                    {
+                        int which = info.updates[kk];
+                        if (typeid(*changes[which]) == typeid(*req))
+                        {
+                            req->takeOverTarget(changes[which],targetID);
+                            drops[which].insert(targetID);
+                            stats.numMerged++;
+                        } else
+                            info.updates[numKept++] = which;
+                    }
+                    info.updates.resize(numKept);
+                    info.updates.push_back(ii);
+                }
+                    break;
+                case ChangeCoalesceRemove:
+                {
+                    // Updates right before a remove don't matter.
+                    // If it was added in this batch, the add and remove go too.
+                    TargetMap::iterator it = targets.find(targetID);
+                    if (it != targets.end())
+                    {
+                        TargetInfo &info = it->second;
+                        for (unsigned int kk=0;kk<info.updates.size();kk++)
+                            drops[info.updates[kk]].insert(targetID);
+                        stats.numMerged += info.updates.size();
+                        if (info.addIndex >= 0)
+                        {
+                            drops[info.addIndex].insert(targetID);
+                            drops[ii].insert(targetID);
+                            stats.numCancelled++;
+                        }
+                        targets.erase(it);
+                    }
+                }
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+    
+    if (drops.empty())
+        return;
+    
+    // Trim the requests and toss any that have nothing left to do
+    std::vector<bool> removed(changes.size(),false);
+    for (DropMap::iterator it = drops.begin(); it != drops.end(); ++it)
+    {
+        ChangeRequest *req = changes[it->first];
+        if (req->dropTargets(it->second))
+        {
+            delete req;
+            removed[it->first] = true;
+            stats.numRemoved++;
+        }
+    }
+    unsigned int numKept = 0;
+    for (unsigned int ii=0;ii<changes.size();ii++)
+        if (!removed[ii])
+            changes[numKept++] = changes[ii];
+    changes.resize(numKept);
+}
+
+}
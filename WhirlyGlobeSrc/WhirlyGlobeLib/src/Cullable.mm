@@ -24,222 +24,831 @@
 namespace WhirlyKit
 {
     
-CullTree::CullTree(WhirlyKit::CoordSystemDisplayAdapter *coordAdapter,Mbr localMbr,int depth,int maxDrawPerNode)
-    : coordAdapter(coordAdapter), depth(depth), numCullables(0), maxDrawPerNode(maxDrawPerNode)
+CullParams::CullParams()
+    : doCulling(true), checkBackface(false), checkScreen(false), eyeVec(0,0,1), checkHorizon(false), eyePos(0,0,0),
+      scaleX(1.0), offsetX(0.0), scaleY(1.0), offsetY(0.0), frameInfo(nil), workerPool(NULL), useCoherence(false)
 {
-    topCullable = new Cullable(coordAdapter,localMbr,depth);
+    modelMat = Eigen::Matrix4f::Identity();
+}
+    
+CullTree::CullTree(WhirlyKit::CoordSystemDisplayAdapter *coordAdapter,Mbr localMbr,int depth)
+    : coordAdapter(coordAdapter), localMbr(localMbr), depth(depth), maxRadius(0.0), epoch(1), totalMoved(0.0),
+      totalTurned(0.0), haveLastView(false), nodesTested(0), nodesReused(0), freeEntry(-1), dirty(false), chunkSize(0)
+{
+    hasEllipsoid = !coordAdapter->isFlat() && coordAdapter->getEllipsoidRadii(ellipsoidRadii);
+    
+    // The top node isn't loose.  It's always considered anyway.
+    int top = addNode(localMbr);
+    setNodeBounds(top,localMbr);
 }
     
 CullTree::~CullTree()
 {
-    delete topCullable;
+}
+    
+int CullTree::getCount()
+{
+    return (int)firstChild.size();
+}
+    
+size_t CullTree::getMemoryUsage()
+{
+    size_t numNodes = minX.capacity();
+    size_t bytes = 17*numNodes*sizeof(float);
+    bytes += firstChild.capacity()*sizeof(int) + numEntries.capacity()*sizeof(int) + numSubEntries.capacity()*sizeof(int) + entryStart.capacity()*sizeof(int);
+    bytes += cells.capacity()*sizeof(Mbr);
+    bytes += entries.capacity()*sizeof(Entry);
+    bytes += entriesByDrawable.getMemoryUsage();
+    bytes += sortedDraws.capacity()*sizeof(Drawable *) + sortedShared.capacity()/8;
+    
+    return bytes;
 }
 
-   void CullTree::dumpStats()
+void CullTree::dumpStats()
 {
-    NSLog(@"CullTree: %d nodes",topCullable->countNodes());
+    NSLog(@"CullTree: %d nodes, %d drawables, %ld bytes",getCount(),entriesByDrawable.size(),getMemoryUsage());
 }
     
-Cullable::Cullable(WhirlyKit::CoordSystemDisplayAdapter *coordAdapter,Mbr localMbr,int depth)
-    : localMbr(localMbr)
+int CullTree::addNode(const Mbr &cell)
 {
-    height = depth;
+    int node = (int)firstChild.size();
+    minX.push_back(0.0);  minY.push_back(0.0);  minZ.push_back(0.0);
+    maxX.push_back(0.0);  maxY.push_back(0.0);  maxZ.push_back(0.0);
+    normX.push_back(0.0);  normY.push_back(0.0);  normZ.push_back(1.0);  normMinDot.push_back(-2.0);  normAllDot.push_back(-2.0);
+    horizX.push_back(0.0);  horizY.push_back(0.0);  horizZ.push_back(1.0);  horizMag.push_back(0.0);  horizCos.push_back(-1.0);  horizSin.push_back(0.0);
+    firstChild.push_back(-1);
+    numEntries.push_back(0);
+    numSubEntries.push_back(0);
+    entryStart.push_back(0);
+    cells.push_back(cell);
+    cacheResult.push_back(0);
+    cacheEpoch.push_back(0);
+    cacheMaxMove.push_back(0.0);  cacheMaxTurn.push_back(0.0);
+    cacheMoved.push_back(0.0);  cacheTurned.push_back(0.0);
     
-    for (unsigned int ii=0;ii<4;ii++)
-        children[ii] = NULL;
-    
-    // Put together the extreme points
-    Point3f pts[8];
-    pts[0] = coordAdapter->localToDisplay(Point3f(localMbr.ll().x(),localMbr.ll().y(),0.0));
-    pts[1] = coordAdapter->localToDisplay(Point3f(localMbr.ur().x(),localMbr.ll().y(),0.0));
-    pts[2] = coordAdapter->localToDisplay(Point3f(localMbr.ur().x(),localMbr.ur().y(),0.0));
-    pts[3] = coordAdapter->localToDisplay(Point3f(localMbr.ll().x(),localMbr.ur().y(),0.0));
-    Point2f halfBot = (localMbr.ll() + Point2f(localMbr.ur().x(),localMbr.ll().y()))/2.0;
-    pts[4] = coordAdapter->localToDisplay(Point3f(halfBot.x(),halfBot.y(),0.0));
-    Point2f halfTop = (Point2f(localMbr.ll().x(),localMbr.ur().y()) + localMbr.ur())/2.0;
-    pts[5] = coordAdapter->localToDisplay(Point3f(halfTop.x(),halfTop.y(),0.0));
-    Point2f halfLeft = (localMbr.ll() + Point2f(localMbr.ll().x(),localMbr.ur().y()))/2.0;
-    pts[6] = coordAdapter->localToDisplay(Point3f(halfLeft.x(),halfLeft.y(),0.0));
-    Point2f halfRight = (Point2f(localMbr.ur().x(),localMbr.ll().y()) + localMbr.ur())/2.0;
-    pts[7] = coordAdapter->localToDisplay(Point3f(halfRight.x(),halfRight.y(),0.0));
+    return node;
+}
+    
+// Drawables don't tell us how far they stick up off the globe, so the horizon check
+//  assumes nothing in a node is higher than this (as a fraction of the radius).
+// Anything higher might be tossed a little early as it goes over the horizon.
+static const double CullHorizonHeight = 0.02;
+    
+void CullTree::setNodeBounds(int node,const Mbr &nodeMbr)
+{
+    // Sample a grid over the node.  A big node on a globe curves a lot,
+    //  so the corners and edges alone don't cover it.
+    const int numSamples = WhirlyKitCullableSamples;
+    Point3f pts[WhirlyKitCullableSamples][WhirlyKitCullableSamples];
+    Point2f size = nodeMbr.ur() - nodeMbr.ll();
+    for (int iy=0;iy<numSamples;iy++)
+        for (int ix=0;ix<numSamples;ix++)
+        {
+            Point2f loc(nodeMbr.ll().x() + size.x() * ix / (numSamples-1),nodeMbr.ll().y() + size.y() * iy / (numSamples-1));
+            pts[iy][ix] = coordAdapter->localToDisplay(Point3f(loc.x(),loc.y(),0.0));
+        }
     
     // Now get the bounding box in 3-space
     Point3f minPt,maxPt;
-    minPt = maxPt = pts[0];
-    for (unsigned int ii=1;ii<8;ii++)
-    {
-        const Point3f &pt = pts[ii];
-        minPt.x() = std::min(minPt.x(),pt.x());
-        minPt.y() = std::min(minPt.y(),pt.y());
-        minPt.z() = std::min(minPt.z(),pt.z());
-        maxPt.x() = std::max(maxPt.x(),pt.x());
-        maxPt.y() = std::max(maxPt.y(),pt.y());
-        maxPt.z() = std::max(maxPt.z(),pt.z());
-    }
-//    Point3f midPt = (minPt+maxPt)/2.0;
-//    minPt += 0.1 * (minPt - midPt);
-//    maxPt += 0.1 * (maxPt - midPt);
-    
-    // Turn this into a cube for evaluation by the culling logic
-    cornerPoints[0] = Point3f(minPt.x(),minPt.y(),minPt.z());
-    cornerPoints[1] = Point3f(maxPt.x(),minPt.y(),minPt.z());
-    cornerPoints[2] = Point3f(maxPt.x(),maxPt.y(),minPt.z());
-    cornerPoints[3] = Point3f(minPt.x(),maxPt.y(),minPt.z());
-    cornerPoints[4] = Point3f(minPt.x(),minPt.y(),maxPt.z());
-    cornerPoints[5] = Point3f(maxPt.x(),minPt.y(),maxPt.z());
-    cornerPoints[6] = Point3f(maxPt.x(),maxPt.y(),maxPt.z());
-    cornerPoints[7] = Point3f(minPt.x(),maxPt.y(),maxPt.z());
-    
-    // Use just 4 of the normals
-    for (unsigned int ii=0;ii<4;ii++)
-        cornerNorms[ii] = pts[ii];
+    minPt = maxPt = pts[0][0];
+    for (int iy=0;iy<numSamples;iy++)
+        for (int ix=0;ix<numSamples;ix++)
+        {
+            const Point3f &pt = pts[iy][ix];
+            minPt.x() = std::min(minPt.x(),pt.x());
+            minPt.y() = std::min(minPt.y(),pt.y());
+            minPt.z() = std::min(minPt.z(),pt.z());
+            maxPt.x() = std::max(maxPt.x(),pt.x());
+            maxPt.y() = std::max(maxPt.y(),pt.y());
+            maxPt.z() = std::max(maxPt.z(),pt.z());
+        }
+    
+    if (coordAdapter->isFlat())
+    {
+        Point3f farPt(std::max(fabsf(minPt.x()),fabsf(maxPt.x())),std::max(fabsf(minPt.y()),fabsf(maxPt.y())),std::max(fabsf(minPt.z()),fabsf(maxPt.z())));
+        maxRadius = std::max(maxRadius,farPt.norm());
+        minX[node] = minPt.x();  minY[node] = minPt.y();  minZ[node] = minPt.z();
+        maxX[node] = maxPt.x();  maxY[node] = maxPt.y();  maxZ[node] = maxPt.z();
+        // No backface check for a flat map
+        normX[node] = 0.0;  normY[node] = 0.0;  normZ[node] = 1.0;  normMinDot[node] = -2.0;  normAllDot[node] = -2.0;
+        return;
+    }
+    
+    // The sphere bulges out between samples, by at most the sagitta of the longest
+    //  diagonal.  Going along one edge then the other can double that.
+    const Point3f &midPt = pts[numSamples/2][numSamples/2];
+    float radius = midPt.norm();
+    float maxChord = 0.0;
+    for (int iy=0;iy<numSamples-1;iy++)
+        for (int ix=0;ix<numSamples-1;ix++)
+            maxChord = std::max(maxChord,std::max((pts[iy+1][ix+1]-pts[iy][ix]).norm(),(pts[iy+1][ix]-pts[iy][ix+1]).norm()));
+    float halfSin = std::min(maxChord / (2*radius),1.0f);
+    float pad = 2 * radius * (1.0 - sqrtf(1.0 - halfSin*halfSin));
+    minX[node] = minPt.x() - pad;  minY[node] = minPt.y() - pad;  minZ[node] = minPt.z() - pad;
+    maxX[node] = maxPt.x() + pad;  maxY[node] = maxPt.y() + pad;  maxZ[node] = maxPt.z() + pad;
+    Point3f farPt(std::max(fabsf(minX[node]),fabsf(maxX[node])),std::max(fabsf(minY[node]),fabsf(maxY[node])),std::max(fabsf(minZ[node]),fabsf(maxZ[node])));
+    maxRadius = std::max(maxRadius,farPt.norm());
+    
+    // Normal in the middle and the widest angle from it to anything in the node.
+    // Some of the node faces the eye if the eye is within 90 degrees plus that angle
+    //  and all of it does if the eye is within 90 degrees minus the angle.
+    Point3f norm = midPt.normalized();
+    float minCos = 1.0;
+    for (int iy=0;iy<numSamples;iy++)
+        for (int ix=0;ix<numSamples;ix++)
+            minCos = std::min(minCos,norm.dot(pts[iy][ix].normalized()));
+    float angle = acosf(std::max(minCos,-1.0f)) + 2*asinf(halfSin);
+    normX[node] = norm.x();  normY[node] = norm.y();  normZ[node] = norm.z();
+    normMinDot[node] = (angle >= M_PI/2) ? -2.0 : -sinf(angle);
+    normAllDot[node] = (angle >= M_PI/2) ? 2.0 : sinf(angle);
+    
+    if (!hasEllipsoid)
+        return;
     
-    // Set the child bounding boxes as well
-    // We use these to check for overlap without creating a child
-    Point2f mid = (localMbr.ur()+localMbr.ll())/2.0;
-    childMbr[0] = Mbr(localMbr.ll(),mid);
-    childMbr[1] = Mbr(Point2f(mid.x(),localMbr.ll().y()),Point2f(localMbr.ur().x(),mid.y()));
-    childMbr[2] = Mbr(Point2f(localMbr.ll().x(),mid.y()),Point2f(mid.x(),localMbr.ur().y()));
-    childMbr[3] = Mbr(mid,localMbr.ur());
+    // Same thing again for the horizon point, but in the space where the ellipsoid is a unit sphere.
+    // Leave room for drawables sticking up off the surface.
+    Point3d scaled[WhirlyKitCullableSamples][WhirlyKitCullableSamples];
+    double maxScaled = 0.0;
+    for (int iy=0;iy<numSamples;iy++)
+        for (int ix=0;ix<numSamples;ix++)
+        {
+            const Point3f &pt = pts[iy][ix];
+            scaled[iy][ix] = Point3d(pt.x()/ellipsoidRadii.x(),pt.y()/ellipsoidRadii.y(),pt.z()/ellipsoidRadii.z());
+            maxScaled = std::max(maxScaled,scaled[iy][ix].norm());
+        }
+    Point3d dir = scaled[numSamples/2][numSamples/2].normalized();
+    double minScaledCos = 1.0, maxScaledChord = 0.0;
+    for (int iy=0;iy<numSamples;iy++)
+        for (int ix=0;ix<numSamples;ix++)
+        {
+            minScaledCos = std::min(minScaledCos,dir.dot(scaled[iy][ix].normalized()));
+            if (iy < numSamples-1 && ix < numSamples-1)
+                maxScaledChord = std::max(maxScaledChord,std::max((scaled[iy+1][ix+1]-scaled[iy][ix]).norm(),(scaled[iy+1][ix]-scaled[iy][ix+1]).norm()));
+        }
+    double scaledAngle = acos(std::max(minScaledCos,-1.0)) + 2*asin(std::min(maxScaledChord / 2.0,1.0));
+    Point3d cullPt;
+    if (!CalcHorizonCullPoint(dir, scaledAngle, maxScaled * (1.0 + CullHorizonHeight), cullPt))
+        return;
+    horizX[node] = dir.x();  horizY[node] = dir.y();  horizZ[node] = dir.z();
+    horizMag[node] = cullPt.norm();
+    horizCos[node] = cos(scaledAngle);  horizSin[node] = sin(scaledAngle);
 }
     
-Cullable::~Cullable()
+void CullTree::addChildren(int node)
 {
+    Mbr cell = cells[node];
+    Point2f mid = (cell.ur()+cell.ll())/2.0;
+    Mbr childCells[4];
+    childCells[0] = Mbr(cell.ll(),mid);
+    childCells[1] = Mbr(Point2f(mid.x(),cell.ll().y()),Point2f(cell.ur().x(),mid.y()));
+    childCells[2] = Mbr(Point2f(cell.ll().x(),mid.y()),Point2f(mid.x(),cell.ur().y()));
+    childCells[3] = Mbr(mid,cell.ur());
+    
+    // Note: Don't hang on to references into the arrays while we're adding
+    int first = -1;
     for (unsigned int ii=0;ii<4;ii++)
-        if (children[ii])
-            delete children[ii];
+    {
+        int child = addNode(childCells[ii]);
+        if (ii == 0)
+            first = child;
+        
+        // Loosen it by half the cell size on each side, but stay inside the whole tree
+        Point2f half = (childCells[ii].ur() - childCells[ii].ll())/2.0;
+        Mbr loose(childCells[ii].ll() - half,childCells[ii].ur() + half);
+        setNodeBounds(child,loose.intersect(localMbr));
+    }
+    firstChild[node] = first;
 }
     
-// Return an existing child if it's there or make a new one
-Cullable *Cullable::getOrAddChild(int which, CullTree *cullTree)
+int CullTree::getNode(int level,int cellX,int cellY)
 {
-    if (height == 0)
-        return NULL;
+    int node = 0;
+    for (int ii=level-1;ii>=0;ii--)
+    {
+        if (firstChild[node] < 0)
+            addChildren(node);
+        int which = ((cellX >> ii) & 1) + 2*((cellY >> ii) & 1);
+        node = firstChild[node] + which;
+    }
     
-    if (children[which])
-        return children[which];
+    return node;
+}
+    
+int CullTree::pickNode(const Mbr &inDrawMbr)
+{
+    if (!inDrawMbr.valid())
+        return 0;
+    // Anything off the edge of the tree isn't our problem
+    Mbr drawMbr = inDrawMbr.intersect(localMbr);
+    if (!drawMbr.valid())
+        return 0;
+    
+    // Deepest level with cells at least as big as the drawable
+    Point2f treeSize = localMbr.ur() - localMbr.ll();
+    float extent = std::max((drawMbr.ur().x()-drawMbr.ll().x())/treeSize.x(),(drawMbr.ur().y()-drawMbr.ll().y())/treeSize.y());
+    int level = 0;
+    float cellSize = 1.0;
+    while (level < depth && extent <= cellSize/2.0)
+    {
+        level++;
+        cellSize /= 2.0;
+    }
     
-    children[which] = new Cullable(cullTree->coordAdapter,childMbr[which],height-1);
-    cullTree->numCullables++;
+    // The cell the center is in
+    Point2f center = (drawMbr.mid() - localMbr.ll());
+    float centerX = center.x() / treeSize.x(), centerY = center.y() / treeSize.y();
+    for (;level > 0;level--)
+    {
+        int numCells = 1<<level;
+        int cellX = std::min(std::max((int)(centerX * numCells),0),numCells-1);
+        int cellY = std::min(std::max((int)(centerY * numCells),0),numCells-1);
+        
+        // Make sure the loose cell really holds it, since we may have clamped
+        Point2f cellDim(treeSize.x()/numCells,treeSize.y()/numCells);
+        Point2f cellLL(localMbr.ll().x() + cellX*cellDim.x(),localMbr.ll().y() + cellY*cellDim.y());
+        Mbr loose(cellLL - cellDim/2.0,cellLL + cellDim*1.5);
+        if (loose.ll().x() <= drawMbr.ll().x() && loose.ll().y() <= drawMbr.ll().y() &&
+            drawMbr.ur().x() <= loose.ur().x() && drawMbr.ur().y() <= loose.ur().y())
+            return getNode(level,cellX,cellY);
+    }
     
-    return children[which];
+    return 0;
 }
     
-// Remove a child if it's empty
-void Cullable::possibleRemoveChild(int which, CullTree *cullTree)
+void CullTree::addDrawable(Mbr drawLocalMbr,DrawableRef draw)
 {
-    if (children[which])
+    // If it's got a matrix, that can be changed and we have no clue where it might end up
+    // Same for drawables without a valid local MBR
+    int node = 0;
+    if (!draw->getMatrix() && drawLocalMbr.valid())
+        node = pickNode(drawLocalMbr);
+    
+    int which;
+    if (freeEntry >= 0)
     {
-        if (!children[which]->hasChildren() && children[which]->isEmpty())
-        {
-            delete children[which];
-            children[which] = NULL;
-            cullTree->numCullables--;
-        }
+        which = freeEntry;
+        freeEntry = entries[which].next;
+    } else {
+        which = (int)entries.size();
+        entries.push_back(Entry());
     }
+    Entry &entry = entries[which];
+    entry.draw = draw;
+    entry.node = node;
+    entry.next = -1;
+    entry.shared = false;
+    numEntries[node]++;
+    
+    // Chain it to any other entries for the same drawable
+    int *first = entriesByDrawable.find(draw->getId());
+    if (first)
+    {
+        entry.next = *first;
+        for (int ii = which; ii >= 0; ii = entries[ii].next)
+            entries[ii].shared = true;
+        *first = which;
+    } else
+        entriesByDrawable.insert(draw->getId(),which);
+    
+    dirty = true;
 }
     
-// Split the existing node into 4 and sort all the drawables
-void Cullable::split(CullTree *cullTree)
+void CullTree::remDrawable(DrawableRef draw)
 {
-    for (std::set<DrawableRef,IdentifiableRefSorter>::iterator it = drawables.begin();
-         it != drawables.end(); ++it)
+    int *first = entriesByDrawable.find(draw->getId());
+    if (!first)
+        return;
+    
+    for (int ii = *first; ii >= 0; )
     {
-        DrawableRef draw = *it;
-        // Note: This doesn't take the geographic case into account
-        Mbr localMbr = draw->getLocalMbr();
-        
-        addDrawableToChildren(cullTree,localMbr,draw);
+        Entry &entry = entries[ii];
+        int next = entry.next;
+        numEntries[entry.node]--;
+        entry.draw.reset();
+        entry.node = -1;
+        entry.shared = false;
+        entry.next = freeEntry;
+        freeEntry = ii;
+        ii = next;
     }
+    entriesByDrawable.erase(draw->getId());
     
-    drawables.clear();
+    dirty = true;
 }
     
-void Cullable::addDrawableToChildren(CullTree *cullTree,Mbr drawLocalMbr,DrawableRef draw)
+void CullTree::rebuild()
 {
-    for (unsigned int ii=0;ii<4;ii++)
+    int numNodes = getCount();
+    
+    // Depth first order, so everything under a node follows it
+    std::vector<int> order;
+    order.reserve(numNodes);
+    std::vector<int> stack;
+    stack.push_back(0);
+    while (!stack.empty())
     {
-        if (childMbr[ii].overlaps(drawLocalMbr))
-        {
-            Cullable *child = getOrAddChild(ii, cullTree);
-            child->addDrawable(cullTree,drawLocalMbr,draw);            
-        }
+        int node = stack.back();
+        stack.pop_back();
+        order.push_back(node);
+        if (firstChild[node] >= 0)
+            for (int ii=3;ii>=0;ii--)
+                stack.push_back(firstChild[node]+ii);
+    }
+    
+    int offset = 0;
+    for (unsigned int ii=0;ii<order.size();ii++)
+    {
+        int node = order[ii];
+        entryStart[node] = offset;
+        offset += numEntries[node];
+    }
+    // Children come after their parents, so go backwards to total them up
+    for (int ii=(int)order.size()-1;ii>=0;ii--)
+    {
+        int node = order[ii];
+        int total = numEntries[node];
+        if (firstChild[node] >= 0)
+            for (unsigned int jj=0;jj<4;jj++)
+                total += numSubEntries[firstChild[node]+jj];
+        numSubEntries[node] = total;
     }
+    
+    // Sort the drawables into place by node
+    std::vector<int> cursor(entryStart);
+    sortedDraws.resize(offset);
+    sortedShared.resize(offset);
+    for (unsigned int ii=0;ii<entries.size();ii++)
+    {
+        const Entry &entry = entries[ii];
+        if (entry.node < 0)
+            continue;
+        int pos = cursor[entry.node]++;
+        sortedDraws[pos] = entry.draw.get();
+        sortedShared[pos] = entry.shared;
+    }
+    
+    dirty = false;
 }
     
-void Cullable::addDrawable(CullTree *cullTree,Mbr drawLocalMbr,DrawableRef draw)
+// Walk the tree below each of the frontier groups
+class CullGroupTask : public WorkerTask
 {
-    // Will be present in the children (or here)
-    childDrawables.insert(draw);
+public:
+    CullGroupTask(CullTree *tree,const CullParams &params,const Eigen::Vector3f &eyeVec) : tree(tree), params(params), eyeVec(eyeVec) { }
     
-    // If it's got a matrix, that can be changed and we have no clue where it might end up
-    // Same for drawables without a valid local MBR
-    if (draw->getMatrix() || !drawLocalMbr.valid())
+    void runPiece(int which,int thread)
+    {
+        tree->walkGroup(which, params, eyeVec);
+    }
+    
+    CullTree *tree;
+    const CullParams &params;
+    const Eigen::Vector3f &eyeVec;
+};
+    
+// Check whether the drawables in one chunk are on
+class CullFilterTask : public WorkerTask
+{
+public:
+    CullFilterTask(CullTree *tree,const CullParams &params) : tree(tree), params(params) { }
+    
+    void runPiece(int which,int thread)
     {
-        drawables.insert(draw);
+        tree->filterChunk(which, params);
+    }
+    
+    CullTree *tree;
+    const CullParams &params;
+};
+    
+// Walk down to at least this many groups before handing them out.
+// This is fixed so the results don't depend on the number of threads.
+static const int CullFrontierSize = 32;
+// Minimum number of drawables we'll do isOn() checks on in one piece
+static const int CullMinChunkSize = 1024;
+    
+void CullTree::testHorizon(int group,const CullParams &params,bool occluded[4],bool allVisible[4])
+{
+    // The node is hidden if its horizon point is, which is when the point's
+    //  past the plane of the horizon and inside the cone the globe shadows.
+    // All of it is over the horizon if it's within the cap the eye can see.
+    // Done in doubles since we can get pretty close to the surface.
+    for (unsigned int lane=0;lane<4;lane++)
+    {
+        occluded[lane] = false;
+        allVisible[lane] = true;
+    }
+    if (!params.checkHorizon || !hasEllipsoid)
         return;
+    
+    const Eigen::Vector3d &eye = horizonEye;
+    double eyeDist2 = eye.squaredNorm();
+    double vhMag2 = eyeDist2 - 1.0;
+    // Cosine and sine of the angle from the eye direction to the edge of the visible cap
+    double capCos = 1.0/sqrt(eyeDist2), capSin = sqrt(std::max(1.0-capCos*capCos,0.0));
+    const float *hx = &horizX[group], *hy = &horizY[group], *hz = &horizZ[group], *hMag = &horizMag[group];
+    const float *hCos = &horizCos[group], *hSin = &horizSin[group];
+    for (unsigned int lane=0;lane<4;lane++)
+    {
+        double dirDotEye = hx[lane]*eye.x() + hy[lane]*eye.y() + hz[lane]*eye.z();
+        double ptDotEye = hMag[lane] * dirDotEye;
+        double vtDotVc = eyeDist2 - ptDotEye;
+        double vtx = hMag[lane]*hx[lane] - eye.x(), vty = hMag[lane]*hy[lane] - eye.y(), vtz = hMag[lane]*hz[lane] - eye.z();
+        double vtMag2 = vtx*vtx + vty*vty + vtz*vtz;
+        occluded[lane] = vhMag2 > 0.0 && hMag[lane] > 0.0 && 1.0 - ptDotEye > 0.0 && vtDotVc*vtDotVc > vhMag2*vtMag2;
+        // Within the cap if the angle to the eye plus the node's angle is under the cap angle
+        allVisible[lane] = vhMag2 > 0.0 && hMag[lane] > 0.0 && hCos[lane] > capCos &&
+                           dirDotEye * capCos >= capCos*hCos[lane] + capSin*hSin[lane];
     }
-
-    // Might need to split it
-    if (drawables.size() > cullTree->maxDrawPerNode && height > 0)
+}
+    
+CullTree::NodeResult CullTree::combineResult(int node,unsigned char viewFlags,bool occluded,bool allVisible)
+{
+    if (numSubEntries[node] == 0 || !(viewFlags & NodeOverlaps) || occluded)
+        return NodeOut;
+    
+    // If the whole node is on screen, facing us and over the horizon, everything under it goes.
+    // Otherwise keep going down (if we can) to toss the parts that aren't.
+    if (((viewFlags & NodeCovered) && allVisible) || firstChild[node] < 0)
+        return NodeAll;
+    return NodeDescend;
+}
+    
+void CullTree::testGroup(int group,const CullParams &params,const Eigen::Vector3f &eyeVec,NodeResult results[4])
+{
+    const Mbr &screenMbr = params.screenMbr;
+    const Eigen::Matrix4f &mat = params.modelMat;
+    
+    // Each of these loops runs over the four siblings at once, so the compiler can vectorize them
+    bool facing[4],allFacing[4];
+    float dots[4];
+    const float *nx = &normX[group], *ny = &normY[group], *nz = &normZ[group];
+    const float *minDot = &normMinDot[group], *allDot = &normAllDot[group];
+    for (unsigned int lane=0;lane<4;lane++)
     {
-        drawables.insert(draw);
-        split(cullTree);
+        dots[lane] = nx[lane]*eyeVec.x() + ny[lane]*eyeVec.y() + nz[lane]*eyeVec.z();
+        facing[lane] = !params.checkBackface || dots[lane] > minDot[lane];
+        allFacing[lane] = !params.checkBackface || dots[lane] > allDot[lane];
     }
     
-    // The drawable is bigger than this node, so just stick it here
-    if (localMbr.contained(drawLocalMbr))
-        drawables.insert(draw);
-    else {
-        // If there are children, sort it into those, maybe
-        if (hasChildren())
-            addDrawableToChildren(cullTree, drawLocalMbr, draw);
-        else
-            // This is where it nominally lives
-            drawables.insert(draw);
+    bool occluded[4],allVisible[4];
+    testHorizon(group, params, occluded, allVisible);
+    
+    // Project the corners of each bounding box to get the screen footprint
+    // Track the depth too, since the projection's no good for anything behind the eye
+    float scrMinX[4],scrMinY[4],scrMaxX[4],scrMaxY[4],nearZ[4],farZ[4];
+    for (unsigned int lane=0;lane<4;lane++)
+    {
+        scrMinX[lane] = scrMinY[lane] = nearZ[lane] = MAXFLOAT;
+        scrMaxX[lane] = scrMaxY[lane] = farZ[lane] = -MAXFLOAT;
+    }
+    for (unsigned int corner=0;corner<WhirlyKitCullableCorners;corner++)
+    {
+        const float *xs = (corner & 1) ? &maxX[group] : &minX[group];
+        const float *ys = (corner & 2) ? &maxY[group] : &minY[group];
+        const float *zs = (corner & 4) ? &maxZ[group] : &minZ[group];
+        for (unsigned int lane=0;lane<4;lane++)
+        {
+            float x = xs[lane], y = ys[lane], z = zs[lane];
+            float px = mat(0,0)*x + mat(0,1)*y + mat(0,2)*z + mat(0,3);
+            float py = mat(1,0)*x + mat(1,1)*y + mat(1,2)*z + mat(1,3);
+            float pz = mat(2,0)*x + mat(2,1)*y + mat(2,2)*z + mat(2,3);
+            float sx = params.scaleX * px / pz + params.offsetX;
+            float sy = params.scaleY * py / pz + params.offsetY;
+            scrMinX[lane] = std::min(scrMinX[lane],sx);  scrMaxX[lane] = std::max(scrMaxX[lane],sx);
+            scrMinY[lane] = std::min(scrMinY[lane],sy);  scrMaxY[lane] = std::max(scrMaxY[lane],sy);
+            nearZ[lane] = std::min(nearZ[lane],pz);  farZ[lane] = std::max(farZ[lane],pz);
+        }
+    }
+    
+    for (unsigned int lane=0;lane<4;lane++)
+    {
+        int node = group+lane;
+        unsigned char viewFlags = 0;
+        // The eye looks down -z, so if nearZ is positive it's all behind it
+        if (facing[lane] && nearZ[lane] <= 0.0)
+        {
+            // If it straddles the eye, the footprint is meaningless, so look further down
+            bool inside = false;
+            if (farZ[lane] < 0.0)
+                inside = screenMbr.ll().x() <= scrMinX[lane] && scrMaxX[lane] <= screenMbr.ur().x() &&
+                         screenMbr.ll().y() <= scrMinY[lane] && scrMaxY[lane] <= screenMbr.ur().y();
+            // If this doesn't overlap what we're viewing, we're done
+            if (farZ[lane] >= 0.0 ||
+                !(scrMinX[lane] > screenMbr.ur().x() || scrMaxX[lane] < screenMbr.ll().x() ||
+                  scrMinY[lane] > screenMbr.ur().y() || scrMaxY[lane] < screenMbr.ll().y()))
+                viewFlags = NodeOverlaps | (inside && allFacing[lane] ? NodeCovered : 0);
+        }
+        results[lane] = combineResult(node, viewFlags, occluded[lane], allVisible[lane]);
+        
+        if (!params.useCoherence)
+            continue;
+        
+        // Now for how far the view can move before any of that changes.
+        // The facing tests flip when the dot product crosses one of the thresholds.
+        float maxTurn = MAXFLOAT;
+        if (params.checkBackface)
+            maxTurn = std::min(fabsf(dots[lane]-minDot[lane]),fabsf(dots[lane]-allDot[lane]));
+        float maxMove = MAXFLOAT;
+        if (!facing[lane])
+        {
+            // Nothing else matters until it faces us
+        } else {
+            // Moving a point by d changes its depth by at most d
+            maxMove = std::min(fabsf(nearZ[lane]),fabsf(farZ[lane]));
+            if (farZ[lane] < 0.0)
+            {
+                // Screen x is scale*x/z + offset, so moving a point by d moves it on screen
+                //  by at most scale*d/|z|*(1+|x/z|).  That's first order, so we only trust it
+                //  for moves that are small next to the depth and we leave a factor of two.
+                float minDepth = -farZ[lane];
+                float ratioX = std::max(fabsf(scrMinX[lane]-params.offsetX),fabsf(scrMaxX[lane]-params.offsetX)) / fabsf(params.scaleX);
+                float ratioY = std::max(fabsf(scrMinY[lane]-params.offsetY),fabsf(scrMaxY[lane]-params.offsetY)) / fabsf(params.scaleY);
+                float pixPerMove = std::max(fabsf(params.scaleX)*(1+ratioX),fabsf(params.scaleY)*(1+ratioY)) / minDepth;
+                // The screen tests only change when an edge of the footprint crosses an edge of the screen
+                float marginPix = std::min(std::min(std::min(fabsf(scrMinX[lane]-screenMbr.ll().x()),fabsf(scrMaxX[lane]-screenMbr.ll().x())),
+                                                    std::min(fabsf(scrMinX[lane]-screenMbr.ur().x()),fabsf(scrMaxX[lane]-screenMbr.ur().x()))),
+                                           std::min(std::min(fabsf(scrMinY[lane]-screenMbr.ll().y()),fabsf(scrMaxY[lane]-screenMbr.ll().y())),
+                                                    std::min(fabsf(scrMinY[lane]-screenMbr.ur().y()),fabsf(scrMaxY[lane]-screenMbr.ur().y()))));
+                maxMove = std::min(maxMove,std::min(0.25f*minDepth,marginPix/(2*pixPerMove)));
+            }
+        }
+        cacheResult[node] = viewFlags;
+        cacheEpoch[node] = epoch;
+        cacheMaxMove[node] = maxMove;
+        cacheMaxTurn[node] = maxTurn;
+        cacheMoved[node] = totalMoved;
+        cacheTurned[node] = totalTurned;
     }
 }
     
-void Cullable::remDrawable(CullTree *cullTree,Mbr drawLocalMbr,DrawableRef draw)
+void CullTree::classifyGroup(int group,const CullParams &params,const Eigen::Vector3f &eyeVec,NodeResult results[4],int &tested,int &reused)
 {
-    // Remove it from here
-    childDrawables.erase(draw);
-    drawables.erase(draw);
+    // Empty nodes never need testing
+    if (numSubEntries[group] == 0 && numSubEntries[group+1] == 0 && numSubEntries[group+2] == 0 && numSubEntries[group+3] == 0)
+    {
+        for (unsigned int lane=0;lane<4;lane++)
+            results[lane] = NodeOut;
+        return;
+    }
     
-    // Remove from the appropriate children
-    if (height > 0)
+    if (params.useCoherence)
     {
-        for (unsigned int ii=0;ii<4;ii++)
+        bool reuse = true;
+        for (unsigned int lane=0;lane<4;lane++)
+        {
+            int node = group+lane;
+            reuse &= cacheEpoch[node] == epoch &&
+                     totalMoved - cacheMoved[node] < cacheMaxMove[node] &&
+                     totalTurned - cacheTurned[node] < cacheMaxTurn[node];
+        }
+        if (reuse)
         {
-            if (children[ii] && childMbr[ii].overlaps(drawLocalMbr))
+            bool occluded[4],allVisible[4];
+            testHorizon(group, params, occluded, allVisible);
+            for (unsigned int lane=0;lane<4;lane++)
             {
-                children[ii]->remDrawable(cullTree,drawLocalMbr,draw);            
-                possibleRemoveChild(ii, cullTree);
+                int node = group+lane;
+                results[lane] = combineResult(node, cacheResult[node], occluded[lane], allVisible[lane]);
             }
+            reused += 4;
+            return;
+        }
+    }
+    
+    testGroup(group, params, eyeVec, results);
+    tested += 4;
+}
+    
+void CullTree::updateCoherence(const CullParams &params,const Eigen::Vector3f &eyeVec)
+{
+    if (!params.useCoherence)
+        return;
+    
+    // Anything that changes the projection means starting over
+    bool startOver = !haveLastView || params.checkBackface != lastCheckBackface || params.checkHorizon != lastCheckHorizon ||
+                     params.scaleX != lastScaleX || params.offsetX != lastOffsetX ||
+                     params.scaleY != lastScaleY || params.offsetY != lastOffsetY ||
+                     !(params.screenMbr.ll() == lastScreenMbr.ll()) || !(params.screenMbr.ur() == lastScreenMbr.ur());
+    
+    if (!startOver)
+    {
+        // A point p moves by (M1-M0)p, which is at most |A1-A0|*|p| + |t1-t0|
+        //  for the rotation/scale part A and translation t
+        Eigen::Matrix4f diff = params.modelMat - lastModelMat;
+        float moved = diff.block<3,3>(0,0).norm() * maxRadius + diff.block<3,1>(0,3).norm();
+        float turned = (eyeVec - lastEyeVec).norm();
+        
+        // A big jump isn't worth trying to follow
+        if (moved > 0.25*maxRadius || turned > 0.25)
+            startOver = true;
+        else {
+            totalMoved += moved;
+            totalTurned += turned;
+        }
+    }
+    
+    if (startOver)
+    {
+        epoch++;
+        totalMoved = 0.0;
+        totalTurned = 0.0;
+    }
+    
+    haveLastView = true;
+    lastModelMat = params.modelMat;
+    lastEyeVec = eyeVec;
+    lastScaleX = params.scaleX;  lastOffsetX = params.offsetX;
+    lastScaleY = params.scaleY;  lastOffsetY = params.offsetY;
+    lastScreenMbr = params.screenMbr;
+    lastCheckBackface = params.checkBackface;
+    lastCheckHorizon = params.checkHorizon;
+}
+    
+void CullTree::addGroupResults(int group,NodeResult results[4],std::vector<EntryRange> &outRanges,std::vector<int> &groups)
+{
+    for (unsigned int lane=0;lane<4;lane++)
+    {
+        int node = group+lane;
+        switch (results[lane])
+        {
+            case NodeOut:
+                break;
+            case NodeDescend:
+                if (numEntries[node] > 0)
+                    outRanges.push_back(EntryRange(entryStart[node],entryStart[node]+numEntries[node]));
+                groups.push_back(firstChild[node]);
+                break;
+            case NodeAll:
+                outRanges.push_back(EntryRange(entryStart[node],entryStart[node]+numSubEntries[node]));
+                break;
         }
     }
+}
+    
+void CullTree::walkGroup(int which,const CullParams &params,const Eigen::Vector3f &eyeVec)
+{
+    std::vector<EntryRange> &outRanges = groupRanges[which];
+    std::vector<int> &stack = groupStacks[which];
+    groupTested[which] = 0;
+    groupReused[which] = 0;
+    outRanges.clear();
+    stack.clear();
+    stack.push_back(frontier[which]);
     
-    // Prune the children if they fall below a certain threshold
-    if (childDrawables.size() < cullTree->maxDrawPerNode)
+    // Depth first, so the output is in tree order
+    std::vector<int> children;
+    while (!stack.empty())
     {
-        drawables = childDrawables;
-        for (unsigned int ii=0;ii<4;ii++)
-            if (children[ii])
+        int group = stack.back();
+        stack.pop_back();
+        
+        NodeResult results[4];
+        classifyGroup(group, params, eyeVec, results, groupTested[which], groupReused[which]);
+        children.clear();
+        addGroupResults(group, results, outRanges, children);
+        for (int ii=(int)children.size()-1;ii>=0;ii--)
+            stack.push_back(children[ii]);
+    }
+}
+    
+void CullTree::filterChunk(int which,const CullParams &params)
+{
+    FilterChunk &chunk = chunks[which];
+    chunk.draws.clear();
+    chunk.shared.clear();
+    
+    // Find the range the chunk starts in
+    int chunkStart = which*chunkSize;
+    int chunkEnd = std::min(chunkStart+chunkSize,rangeOffsets.back());
+    int whichRange = (int)(std::upper_bound(rangeOffsets.begin(),rangeOffsets.end(),chunkStart) - rangeOffsets.begin()) - 1;
+    
+    for (int pos = chunkStart; pos < chunkEnd; whichRange++)
+    {
+        const EntryRange &range = ranges[whichRange];
+        int start = range.start + (pos - rangeOffsets[whichRange]);
+        int end = std::min(range.end,range.start + (chunkEnd - rangeOffsets[whichRange]));
+        for (int ii=start;ii<end;ii++)
+        {
+            Drawable *draw = sortedDraws[ii];
+            if (draw->isOn(params.frameInfo))
             {
-                delete children[ii];
-                children[ii] = NULL;
+                // Only drawables added more than once can show up twice
+                if (sortedShared[ii])
+                    chunk.shared.push_back((int)chunk.draws.size());
+                chunk.draws.push_back(draw);
             }
+        }
+        pos += end-start;
     }
 }
-
-int Cullable::countNodes() const
+    
+void CullTree::findDrawables(const CullParams &params,std::vector<Drawable *> &toDraw,int *drawablesConsidered)
 {
-    int count = 1;
-    for (unsigned int ii=0;ii<4;ii++)
-        if (children[ii])
-            count += children[ii]->countNodes();
+    if (dirty)
+        rebuild();
+    
+    ranges.clear();
+    frontier.clear();
+    nodesTested = 0;
+    nodesReused = 0;
     
-    return count;
+    if (!params.doCulling || !params.checkScreen)
+    {
+        // Without a way to check the screen, everything goes
+        ranges.push_back(EntryRange(0,numSubEntries[0]));
+    } else {
+        Eigen::Vector3f eyeVec = params.eyeVec.normalized();
+        updateCoherence(params, eyeVec);
+        if (hasEllipsoid)
+            horizonEye = Eigen::Vector3d(params.eyePos.x()/ellipsoidRadii.x(),params.eyePos.y()/ellipsoidRadii.y(),params.eyePos.z()/ellipsoidRadii.z());
+        
+        // The top level is always considered
+        if (numEntries[0] > 0)
+            ranges.push_back(EntryRange(entryStart[0],entryStart[0]+numEntries[0]));
+        
+        // Go through the top of the tree a level at a time until there's enough to hand out
+        if (firstChild[0] >= 0)
+            frontier.push_back(firstChild[0]);
+        unsigned int next = 0;
+        while (next < frontier.size() && frontier.size()-next < CullFrontierSize)
+        {
+            int group = frontier[next++];
+            NodeResult results[4];
+            classifyGroup(group, params, eyeVec, results, nodesTested, nodesReused);
+            addGroupResults(group, results, ranges, frontier);
+        }
+        frontier.erase(frontier.begin(),frontier.begin()+next);
+        
+        // Walk the rest of the tree under each frontier group
+        if (groupRanges.size() < frontier.size())
+        {
+            groupRanges.resize(frontier.size());
+            groupStacks.resize(frontier.size());
+            groupTested.resize(frontier.size());
+            groupReused.resize(frontier.size());
+        }
+        CullGroupTask groupTask(this,params,eyeVec);
+        if (params.workerPool)
+            params.workerPool->run(&groupTask, (int)frontier.size());
+        else
+            for (unsigned int ii=0;ii<frontier.size();ii++)
+                walkGroup(ii, params, eyeVec);
+        for (unsigned int ii=0;ii<frontier.size();ii++)
+        {
+            ranges.insert(ranges.end(),groupRanges[ii].begin(),groupRanges[ii].end());
+            nodesTested += groupTested[ii];
+            nodesReused += groupReused[ii];
+        }
+    }
+    
+    // Lay the ranges end to end and cut them up for the isOn() checks
+    rangeOffsets.resize(ranges.size()+1);
+    rangeOffsets[0] = 0;
+    for (unsigned int ii=0;ii<ranges.size();ii++)
+        rangeOffsets[ii+1] = rangeOffsets[ii] + ranges[ii].end - ranges[ii].start;
+    int total = rangeOffsets.back();
+    *drawablesConsidered += total;
+    if (total == 0)
+        return;
+    int numThreads = params.workerPool ? params.workerPool->getNumThreads() : 1;
+    chunkSize = std::max(CullMinChunkSize,total/(4*numThreads)+1);
+    int numChunks = (total+chunkSize-1)/chunkSize;
+    if ((int)chunks.size() < numChunks)
+        chunks.resize(numChunks);
+    CullFilterTask filterTask(this,params);
+    if (params.workerPool)
+        params.workerPool->run(&filterTask, numChunks);
+    else
+        for (int ii=0;ii<numChunks;ii++)
+            filterChunk(ii, params);
+    
+    // Put the pieces back together in order, tossing repeats of shared drawables
+    size_t numDraws = 0;
+    for (int ii=0;ii<numChunks;ii++)
+        numDraws += chunks[ii].draws.size();
+    toDraw.reserve(toDraw.size()+numDraws);
+    std::set<Drawable *> sharedSeen;
+    for (int ii=0;ii<numChunks;ii++)
+    {
+        const FilterChunk &chunk = chunks[ii];
+        if (chunk.shared.empty())
+        {
+            toDraw.insert(toDraw.end(),chunk.draws.begin(),chunk.draws.end());
+            continue;
+        }
+        unsigned int nextShared = 0;
+        for (unsigned int jj=0;jj<chunk.draws.size();jj++)
+        {
+            if (nextShared < chunk.shared.size() && chunk.shared[nextShared] == (int)jj)
+            {
+                nextShared++;
+                if (!sharedSeen.insert(chunk.draws[jj]).second)
+                    continue;
+            }
+            toDraw.push_back(chunk.draws[jj]);
+        }
+    }
 }
 
 }
@@ -46,27 +46,39 @@ static const char *vertexShaderTri =
 "uniform directional_light light[8];                     \n"
 "uniform material_properties material;       \n"
 "\n"
+"uniform bool u_octNormals;                   \n"
+"\n"
 "attribute vec3 a_position;                  \n"
 "attribute vec2 a_texCoord;                  \n"
 "attribute vec4 a_color;                     \n"
 "attribute vec3 a_normal;                    \n"
+"attribute vec2 a_normalOct;                 \n"
 "\n"
 "varying vec2 v_texCoord;                    \n"
 "varying vec4 v_color;                       \n"
 "\n"
+"vec3 octDecode(vec2 e)\n"
+"{\n"
+"   vec3 v = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));\n"
+"   if (v.z < 0.0)\n"
+"     v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);\n"
+"   return normalize(v);\n"
+"}\n"
+"\n"
 "void main()                                 \n"
 "{                                           \n"
 "   v_texCoord = a_texCoord;                 \n"
 "   v_color = vec4(0.0,0.0,0.0,0.0);         \n"
 "   if (u_numLights > 0)                     \n"
 "   {\n"
+"     vec3 norm = u_octNormals ? octDecode(a_normalOct) : a_normal;\n"
 "     vec4 ambient = vec4(0.0,0.0,0.0,0.0);         \n"
 "     vec4 diffuse = vec4(0.0,0.0,0.0,0.0);         \n"
 "     for (int ii=0;ii<8;ii++)                 \n"
 "     {\n"
 "        if (ii>=u_numLights)                  \n"
 "           break;                             \n"
-"        vec3 adjNorm = light[ii].viewdepend > 0.0 ? normalize((u_mvpMatrix * vec4(a_normal.xyz, 0.0)).xyz) : a_normal.xzy;\n"
+"        vec3 adjNorm = light[ii].viewdepend > 0.0 ? normalize((u_mvpMatrix * vec4(norm.xyz, 0.0)).xyz) : norm.xzy;\n"
 "        float ndotl;\n"
 //"        float ndoth;\n"
 "        ndotl = max(0.0, dot(adjNorm, light[ii].direction));\n"
@@ -108,19 +120,30 @@ static const char *vertexShaderLine =
 "uniform mat4  u_mvMatrix;"
 "uniform mat4  u_mvNormalMatrix;"
 "uniform float u_fade;"
+"uniform bool u_octNormals;"
 ""
 "attribute vec3 a_position;"
 "attribute vec4 a_color;"
 "attribute vec3 a_normal;"
+"attribute vec2 a_normalOct;"
 ""
 "varying vec4      v_color;"
 "varying float      v_dot;"
 ""
+"vec3 octDecode(vec2 e)"
+"{"
+"   vec3 v = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));"
+"   if (v.z < 0.0)"
+"     v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);"
+"   return normalize(v);"
+"}"
+""
 "void main()"
 "{"
 "   vec4 pt = u_mvMatrix * vec4(a_position,1.0);"
 "   pt /= pt.w;"
-"   vec4 testNorm = u_mvNormalMatrix * vec4(a_normal,0.0);"
+"   vec3 norm = u_octNormals ? octDecode(a_normalOct) : a_normal;"
+"   vec4 testNorm = u_mvNormalMatrix * vec4(norm,0.0);"
 "   v_dot = dot(-pt.xyz,testNorm.xyz);"
 "   v_color = a_color * u_fade;"
 "   gl_Position = u_mvpMatrix * vec4(a_position,1.0);"
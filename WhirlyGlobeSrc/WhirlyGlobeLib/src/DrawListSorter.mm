@@ -0,0 +1,135 @@
+/*
+ *  DrawListSorter.mm
+ *  WhirlyGlobeLib
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import "DrawListSorter.h"
+
+namespace WhirlyKit
+{
+    
+// Bits for each part of the key.  Priority gets all 32, so the order never changes.
+static const int DrawSortTextureBits = 15;
+static const int DrawSortProgramBits = 15;
+static const int DrawSortZBufferShift = DrawSortTextureBits + DrawSortProgramBits;
+static const int DrawSortPriorityShift = DrawSortZBufferShift + 1;
+static const int DrawSortAlphaShift = DrawSortPriorityShift + 32;
+    
+// Don't bother making keys on the worker threads for less than this
+static const int MinDrawListKeyPiece = 1024;
+    
+// Fibonacci hash of an ID down to the given number of bits
+static inline uint64_t DrawSortHash(SimpleIdentity ident,int bits)
+{
+    return (ident * 11400714819323198485ULL) >> (64 - bits);
+}
+    
+uint64_t DrawListSorter::sortKey(Drawable *draw,bool useAlpha,bool useZBuffer,WhirlyKitRendererFrameInfo *frameInfo)
+{
+    uint64_t key = 0;
+    if (useAlpha && draw->hasAlpha(frameInfo))
+        key |= (uint64_t)1 << DrawSortAlphaShift;
+    key |= (uint64_t)draw->getDrawPriority() << DrawSortPriorityShift;
+    if (useZBuffer && draw->getRequestZBuffer())
+        key |= (uint64_t)1 << DrawSortZBufferShift;
+    key |= DrawSortHash(draw->getProgram(),DrawSortProgramBits) << DrawSortTextureBits;
+    key |= DrawSortHash(draw->getTexId(),DrawSortTextureBits);
+    
+    return key;
+}
+    
+// Makes the keys for a piece of the draw list on a worker thread
+class DrawListKeyTask : public WorkerTask
+{
+public:
+    DrawListKeyTask(DrawListSorter *sorter,std::vector<Drawable *> &drawList,bool useAlpha,bool useZBuffer,WhirlyKitRendererFrameInfo *frameInfo,int pieceSize)
+    : sorter(sorter), drawList(drawList), useAlpha(useAlpha), useZBuffer(useZBuffer), frameInfo(frameInfo), pieceSize(pieceSize) { }
+    
+    void runPiece(int which,int thread)
+    {
+        int start = which*pieceSize;
+        int end = std::min(start+pieceSize,(int)drawList.size());
+        for (int ii=start;ii<end;ii++)
+        {
+            DrawListSorter::Entry &entry = sorter->entries[ii];
+            entry.draw = drawList[ii];
+            entry.key = DrawListSorter::sortKey(entry.draw, useAlpha, useZBuffer, frameInfo);
+        }
+    }
+    
+    DrawListSorter *sorter;
+    std::vector<Drawable *> &drawList;
+    bool useAlpha,useZBuffer;
+    WhirlyKitRendererFrameInfo * __unsafe_unretained frameInfo;
+    int pieceSize;
+};
+    
+void DrawListSorter::sort(std::vector<Drawable *> &drawList,bool useAlpha,bool useZBuffer,WhirlyKitRendererFrameInfo *frameInfo,WorkerPool *workerPool)
+{
+    int size = (int)drawList.size();
+    if (size < 2)
+        return;
+    entries.resize(size);
+    scratch.resize(size);
+    
+    // Make the keys.  This is where all the virtual calls are, so it's worth splitting up.
+    int numPieces = workerPool ? std::min(workerPool->getNumThreads(),size/MinDrawListKeyPiece) : 1;
+    numPieces = std::max(numPieces,1);
+    DrawListKeyTask task(this,drawList,useAlpha,useZBuffer,frameInfo,(size+numPieces-1)/numPieces);
+    if (numPieces > 1)
+        workerPool->run(&task, numPieces);
+    else
+        task.runPiece(0, 0);
+    
+    // Count up all the bytes at once
+    std::vector<int> counts(8*256,0);
+    for (int ii=0;ii<size;ii++)
+    {
+        uint64_t key = entries[ii].key;
+        for (unsigned int byte=0;byte<8;byte++)
+            counts[byte*256 + ((key >> (8*byte)) & 0xff)]++;
+    }
+    
+    // Least significant byte first.  Each pass is stable, so the whole thing is.
+    // Most keys only differ in a few bytes, so skip the passes that wouldn't move anything.
+    for (unsigned int byte=0;byte<8;byte++)
+    {
+        int *byteCounts = &counts[byte*256];
+        if (byteCounts[(entries[0].key >> (8*byte)) & 0xff] == size)
+            continue;
+        
+        int offsets[256];
+        int total = 0;
+        for (unsigned int ii=0;ii<256;ii++)
+        {
+            offsets[ii] = total;
+            total += byteCounts[ii];
+        }
+        for (int ii=0;ii<size;ii++)
+        {
+            const Entry &entry = entries[ii];
+            scratch[offsets[(entry.key >> (8*byte)) & 0xff]++] = entry;
+        }
+        entries.swap(scratch);
+    }
+    
+    for (int ii=0;ii<size;ii++)
+        drawList[ii] = entries[ii].draw;
+}
+    
+}
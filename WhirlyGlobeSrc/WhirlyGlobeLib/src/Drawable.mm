@@ -24,6 +24,8 @@
 #import "UIImage+Stuff.h"
 #import "SceneRendererES.h"
 #import "TextureAtlas.h"
+#import "VertexPacking.h"
+#import "MeshOptimizer.h"
 
 using namespace Eigen;
 
@@ -46,13 +48,57 @@ using namespace WhirlyGlobe;
 namespace WhirlyKit
 {
     
+// Set by the renderer once it's looked at the extensions
+static bool largeIndicesSupported = false;
+
+void SetLargeIndicesSupported(bool supported)
+{
+    largeIndicesSupported = supported;
+}
+
+bool LargeIndicesSupported()
+{
+    return largeIndicesSupported;
+}
+    
+unsigned int MaxDrawablePointsForDevice()
+{
+    return largeIndicesSupported ? MaxLargeDrawablePoints : MaxDrawablePoints;
+}
+    
+// Creates the big buffers for the slab allocator
+class OpenGLSlabBackend : public BufferSlabBackend
+{
+public:
+    unsigned int createBuffer(unsigned int size)
+    {
+        GLuint bufID = 0;
+        GetGLBackend()->genBuffers(1, &bufID);
+        GetGLBackend()->bindBuffer(GL_ARRAY_BUFFER, bufID);
+        GetGLBackend()->bufferData(GL_ARRAY_BUFFER, size, NULL, GL_STATIC_DRAW);
+        CheckGLError("OpenGLSlabBackend::createBuffer() glBufferData");
+        GetGLBackend()->bindBuffer(GL_ARRAY_BUFFER, 0);
+        
+        return bufID;
+    }
+    
+    void deleteBuffer(unsigned int bufID)
+    {
+        GetGLBackend()->deleteBuffers(1, &bufID);
+    }
+};
+    
 OpenGLMemManager::OpenGLMemManager()
 {
     pthread_mutex_init(&idLock,NULL);
+    slabBackend = new OpenGLSlabBackend();
+    slabAllocator = new BufferSlabAllocator(slabBackend,WhirlyKitOpenGLSlabSize,WhirlyKitOpenGLSlabMaxAlloc);
 }
     
 OpenGLMemManager::~OpenGLMemManager()
 {
+    delete slabAllocator;
+    delete slabBackend;
     pthread_mutex_destroy(&idLock);
 }
     
@@ -63,7 +109,7 @@ GLuint OpenGLMemManager::getBufferID(unsigned int size,GLenum drawType)
     if (buffIDs.empty())
     {
         GLuint newAlloc[WhirlyKitOpenGLMemCacheAllocUnit];
-        glGenBuffers(WhirlyKitOpenGLMemCacheAllocUnit, newAlloc);
+        GetGLBackend()->genBuffers(WhirlyKitOpenGLMemCacheAllocUnit, newAlloc);
         for (unsigned int ii=0;ii<WhirlyKitOpenGLMemCacheAllocUnit;ii++)
         {
             buffIDs.insert(newAlloc[ii]);
@@ -81,11 +127,11 @@ GLuint OpenGLMemManager::getBufferID(unsigned int size,GLenum drawType)
 
     if (size != 0)
     {
-        glBindBuffer(GL_ARRAY_BUFFER, which);
+        GetGLBackend()->bindBuffer(GL_ARRAY_BUFFER, which);
         CheckGLError("BasicDrawable::setupGL() glBindBuffer");
-        glBufferData(GL_ARRAY_BUFFER, size, NULL, drawType);
+        GetGLBackend()->bufferData(GL_ARRAY_BUFFER, size, NULL, drawType);
         CheckGLError("BasicDrawable::setupGL() glBufferData");
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        GetGLBackend()->bindBuffer(GL_ARRAY_BUFFER, 0);
         CheckGLError("BasicDrawable::setupGL() glBindBuffer");
     }
     
@@ -116,6 +162,29 @@ void OpenGLMemManager::removeBufferID(GLuint bufID)
         clearBufferIDs();
 }
 
+bool OpenGLMemManager::getBufferRegion(unsigned int size,BufferAllocation &region)
+{
+    pthread_mutex_lock(&idLock);
+    bool ret = slabAllocator->allocate(size,region);
+    pthread_mutex_unlock(&idLock);
+    
+    return ret;
+}
+    
+void OpenGLMemManager::removeBufferRegion(const BufferAllocation &region)
+{
+    pthread_mutex_lock(&idLock);
+    slabAllocator->free(region);
+    pthread_mutex_unlock(&idLock);
+}
+    
+void OpenGLMemManager::getSlabStats(BufferSlabStats &stats)
+{
+    pthread_mutex_lock(&idLock);
+    slabAllocator->getStats(stats);
+    pthread_mutex_unlock(&idLock);
+}
+
 // Clear out any and all buffer IDs that we may have sitting around
 void OpenGLMemManager::clearBufferIDs()
 {
@@ -127,7 +196,7 @@ void OpenGLMemManager::clearBufferIDs()
          it != buffIDs.end(); ++it)
         toRemove.push_back(*it);
     if (!toRemove.empty())
-        glDeleteBuffers(toRemove.size(), &toRemove[0]);
+        GetGLBackend()->deleteBuffers(toRemove.size(), &toRemove[0]);
     buffIDs.clear();
     
     pthread_mutex_unlock(&idLock);
@@ -140,7 +209,7 @@ GLuint OpenGLMemManager::getTexID()
     if (texIDs.empty())
     {
         GLuint newAlloc[WhirlyKitOpenGLMemCacheAllocUnit];
-        glGenTextures(WhirlyKitOpenGLMemCacheAllocUnit, newAlloc);
+        GetGLBackend()->genTextures(WhirlyKitOpenGLMemCacheAllocUnit, newAlloc);
         for (unsigned int ii=0;ii<WhirlyKitOpenGLMemCacheAllocUnit;ii++)
             texIDs.insert(newAlloc[ii]);
     }
@@ -164,8 +233,8 @@ void OpenGLMemManager::removeTexID(GLuint texID)
     pthread_mutex_lock(&idLock);
 
     // Clear out the texture data first
-    glBindTexture(GL_TEXTURE_2D, texID);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    GetGLBackend()->bindTexture(GL_TEXTURE_2D, texID);
+    GetGLBackend()->texImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
 
     texIDs.insert(texID);
     
@@ -189,7 +258,7 @@ void OpenGLMemManager::clearTextureIDs()
          it != texIDs.end(); ++it)
         toRemove.push_back(*it);
     if (!toRemove.empty())
-        glDeleteTextures(toRemove.size(), &toRemove[0]);
+        GetGLBackend()->deleteTextures(toRemove.size(), &toRemove[0]);
     texIDs.clear();
     
     pthread_mutex_unlock(&idLock);    
@@ -199,6 +268,10 @@ void OpenGLMemManager::dumpStats()
 {
     NSLog(@"MemCache: %ld buffers",buffIDs.size());
     NSLog(@"MemCache: %ld textures",texIDs.size());
+    BufferSlabStats stats;
+    getSlabStats(stats);
+    NSLog(@"MemCache: %d slabs, %d regions, %d of %d bytes used, %d free blocks, %.2f fragmentation",
+          stats.numSlabs,stats.numAllocs,stats.usedBytes,stats.totalBytes,stats.numFreeBlocks,stats.fragmentation());
 }
 		
 void OpenGLMemManager::lock()
@@ -228,344 +301,6 @@ void DrawableChangeRequest::execute(Scene *scene,WhirlyKitSceneRendererES *rende
 		execute2(scene,renderer,theDrawable);
 }
     
-VertexAttribute::VertexAttribute(BDAttributeDataType dataType,const std::string &name)
-    : dataType(dataType), name(name), data(NULL), buffer(0)
-{
-    defaultData.vec3[0] = 0.0;
-    defaultData.vec3[1] = 0.0;
-    defaultData.vec3[2] = 0.0;
-}
-    
-VertexAttribute::~VertexAttribute()
-{
-    clear();
-}
-    
-VertexAttribute::VertexAttribute(const VertexAttribute &that)
-    : dataType(that.dataType), name(that.name), data(NULL), buffer(that.buffer), defaultData(that.defaultData)
-{
-}
-    
-VertexAttribute VertexAttribute::templateCopy() const
-{
-    VertexAttribute newAttr(*this);
-    return newAttr;
-}
-    
-BDAttributeDataType VertexAttribute::getDataType() const
-{
-    return dataType;
-}
-    
-void VertexAttribute::setDefaultColor(const RGBAColor &color)
-{
-    defaultData.color[0] = color.r;
-    defaultData.color[1] = color.g;
-    defaultData.color[2] = color.b;
-    defaultData.color[3] = color.a;
-}
-
-void VertexAttribute::setDefaultVector2f(const Eigen::Vector2f &vec)
-{
-    defaultData.vec2[0] = vec.x();
-    defaultData.vec2[1] = vec.y();
-}
-
-void VertexAttribute::setDefaultVector3f(const Eigen::Vector3f &vec)
-{
-    defaultData.vec3[0] = vec.x();
-    defaultData.vec3[1] = vec.y();
-    defaultData.vec3[2] = vec.z();
-}
-
-void VertexAttribute::setDefaultFloat(float val)
-{
-    defaultData.floatVal = val;
-}
-
-void VertexAttribute::addColor(const RGBAColor &color)
-{
-    if (dataType != BDChar4Type)
-        return;
-    
-    if (!data)
-        data = new std::vector<RGBAColor>();
-    std::vector<RGBAColor> *colors = (std::vector<RGBAColor> *)data;
-    (*colors).push_back(color);
-}
-
-void VertexAttribute::addVector2f(const Eigen::Vector2f &vec)
-{
-    if (dataType != BDFloat2Type)
-        return;
-    
-    if (!data)
-        data = new std::vector<Vector2f>();
-    std::vector<Vector2f> *vecs = (std::vector<Vector2f> *)data;
-    (*vecs).push_back(vec);
-}
-
-void VertexAttribute::addVector3f(const Eigen::Vector3f &vec)
-{
-    if (dataType != BDFloat3Type)
-        return;
-    
-    if (!data)
-        data = new std::vector<Vector3f>();
-    std::vector<Vector3f> *vecs = (std::vector<Vector3f> *)data;
-    (*vecs).push_back(vec);
-}
-
-void VertexAttribute::addFloat(float val)
-{
-    if (dataType != BDFloatType)
-        return;
-    
-    if (!data)
-        data = new std::vector<float>();
-    std::vector<float> *floats = (std::vector<float> *)data;
-    (*floats).push_back(val);
-}
-    
-/// Reserve size in the data array
-void VertexAttribute::reserve(int size)
-{
-    switch (dataType)
-    {
-        case BDFloat3Type:
-        {
-            if (!data)
-                data = new std::vector<Vector3f>();
-            std::vector<Vector3f> *vecs = (std::vector<Vector3f> *)data;
-            vecs->reserve(size);
-        }
-            break;
-        case BDFloat2Type:
-        {
-            if (!data)
-                data = new std::vector<Vector2f>();
-            std::vector<Vector2f> *vecs = (std::vector<Vector2f> *)data;
-            vecs->reserve(size);
-        }
-            break;
-        case BDChar4Type:
-        {
-            if (!data)
-                data = new std::vector<RGBAColor>();
-            std::vector<RGBAColor> *colors = (std::vector<RGBAColor> *)data;
-            colors->reserve(size);
-        }
-            break;
-        case BDFloatType:
-        {
-            if (!data)
-                data = new std::vector<float>();
-            std::vector<float> *floats = (std::vector<float> *)data;
-            floats->reserve(size);
-        }
-            break;
-    }    
-}
-
-/// Number of elements in our array
-int VertexAttribute::numElements() const
-{
-    if (!data)
-        return 0;
-    
-    switch (dataType)
-    {
-        case BDFloat3Type:
-        {
-            std::vector<Vector3f> *vecs = (std::vector<Vector3f> *)data;
-            return vecs->size();
-        }
-            break;
-        case BDFloat2Type:
-        {
-            std::vector<Vector2f> *vecs = (std::vector<Vector2f> *)data;
-            return vecs->size();
-        }
-            break;
-        case BDChar4Type:
-        {
-            std::vector<RGBAColor> *colors = (std::vector<RGBAColor> *)data;
-            return colors->size();
-        }
-            break;
-        case BDFloatType:
-        {
-            std::vector<float> *floats = (std::vector<float> *)data;
-            return floats->size();
-        }
-            break;
-    }    
-}
-
-/// Return the size of a single element
-int VertexAttribute::size() const
-{
-    switch (dataType)
-    {
-        case BDFloat3Type:
-            return sizeof(GLfloat)*3;
-            break;
-        case BDFloat2Type:
-            return sizeof(GLfloat)*2;
-            break;
-        case BDChar4Type:
-            return sizeof(unsigned char)*4;
-            break;
-        case BDFloatType:
-            return sizeof(GLfloat);
-            break;
-    }    
-}
-
-/// Clean out the data array
-void VertexAttribute::clear()
-{
-    if (data)
-    {
-        switch (dataType)
-        {
-            case BDFloat3Type:
-            {
-                std::vector<Vector3f> *vecs = (std::vector<Vector3f> *)data;
-                delete vecs;
-            }
-                break;
-            case BDFloat2Type:
-            {
-                std::vector<Vector2f> *vecs = (std::vector<Vector2f> *)data;
-                delete vecs;
-            }
-                break;
-            case BDChar4Type:
-            {
-                std::vector<RGBAColor> *colors = (std::vector<RGBAColor> *)data;
-                delete colors;
-            }
-                break;
-            case BDFloatType:
-            {
-                std::vector<float> *floats = (std::vector<float> *)data;
-                delete floats;
-            }
-                break;
-        }
-    }
-    data = NULL;    
-}
-
-/// Return a pointer to the given element
-void *VertexAttribute::addressForElement(int which)
-{
-    switch (dataType)
-    {
-        case BDFloat3Type:
-        {
-            std::vector<Vector3f> *vecs = (std::vector<Vector3f> *)data;
-            return &(*vecs)[which];;
-        }
-            break;
-        case BDFloat2Type:
-        {
-            std::vector<Vector2f> *vecs = (std::vector<Vector2f> *)data;
-            return &(*vecs)[which];
-        }
-            break;
-        case BDChar4Type:
-        {
-            std::vector<RGBAColor> *colors = (std::vector<RGBAColor> *)data;
-            return &(*colors)[which];
-        }
-            break;
-        case BDFloatType:
-        {
-            std::vector<float> *floats = (std::vector<float> *)data;
-            return &(*floats)[which];
-        }
-            break;
-    }
-    
-    return NULL;
-}
-
-/// Return the number of components as needed by glVertexAttribPointer
-GLuint VertexAttribute::glEntryComponents() const
-{
-    switch (dataType)
-    {
-        case BDFloat3Type:
-            return 3;
-            break;
-        case BDFloat2Type:
-            return 2;
-            break;
-        case BDChar4Type:
-            return 4;
-            break;
-        case BDFloatType:
-            return 1;
-            break;
-    }
-    
-    return 0;
-}
-
-/// Return the data type as required by glVertexAttribPointer
-GLenum VertexAttribute::glType() const
-{
-    switch (dataType)
-    {
-        case BDFloat3Type:
-        case BDFloat2Type:
-        case BDFloatType:
-            return GL_FLOAT;
-            break;
-        case BDChar4Type:
-            return GL_UNSIGNED_BYTE;
-            break;
-    }
-    return GL_UNSIGNED_BYTE;
-}
-
-/// Whether or not glVertexAttribPointer will normalize the data
-GLboolean VertexAttribute::glNormalize() const
-{
-    switch (dataType)
-    {
-        case BDFloat3Type:
-        case BDFloat2Type:
-        case BDFloatType:
-            return GL_FALSE;
-            break;
-        case BDChar4Type:
-            return GL_TRUE;
-            break;
-    }
-}
-    
-void VertexAttribute::glSetDefault(int index) const
-{
-    switch (dataType)
-    {
-        case BDFloat3Type:
-            glVertexAttrib3f(index, defaultData.vec3[0], defaultData.vec3[1], defaultData.vec3[2]);
-            break;
-        case BDFloat2Type:
-            glVertexAttrib2f(index, defaultData.vec2[0], defaultData.vec2[1]);
-            break;
-        case BDFloatType:
-            glVertexAttrib1f(index, defaultData.floatVal);
-            break;
-        case BDChar4Type:
-            glVertexAttrib4f(index, defaultData.color[0] / 255.0, defaultData.color[1] / 255.0, defaultData.color[2] / 255.0, defaultData.color[3] / 255.0);
-            break;
-    }
-}
-	
 BasicDrawable::BasicDrawable(const std::string &name)
     : Drawable(name)
 {
@@ -586,6 +321,7 @@ BasicDrawable::BasicDrawable(const std::string &name)
     
     numTris = 0;
     numPoints = 0;
+    elementType = GL_UNSIGNED_SHORT;
     
     pointBuffer = triBuffer = 0;
     sharedBuffer = 0;
@@ -594,6 +330,9 @@ BasicDrawable::BasicDrawable(const std::string &name)
     sharedBufferIsExternal = false;
     requestZBuffer = false;
     writeZBuffer = true;
+    posFormat = BDPositionFloat3;
+    posCenter = Vector3f(0,0,0);
+    posScale = 1.0;
 
     hasMatrix = false;
     
@@ -624,12 +363,16 @@ BasicDrawable::BasicDrawable(const std::string &name,unsigned int numVert,unsign
 
     numTris = 0;
     numPoints = 0;
+    elementType = GL_UNSIGNED_SHORT;
     
     pointBuffer = triBuffer = 0;
     sharedBuffer = 0;
     vertexSize = 0;
     vertArrayObj = 0;
     sharedBufferIsExternal = false;
+    posFormat = BDPositionFloat3;
+    posCenter = Vector3f(0,0,0);
+    posScale = 1.0;
 
     hasMatrix = false;
 }
@@ -676,7 +419,7 @@ bool BasicDrawable::isOn(WhirlyKitRendererFrameInfo *frameInfo) const
     if (minVisible == DrawVisibleInvalid || !on)
         return on;
 
-    double visVal = [frameInfo.theView heightAboveSurface];
+    double visVal = frameInfo.heightAboveSurface;
     
     return ((minVisible <= visVal && visVal <= maxVisible) ||
              (maxVisible <= visVal && visVal <= minVisible));
@@ -863,10 +606,22 @@ void BasicDrawable::addAttributeValue(int attrId,RGBAColor color)
 void BasicDrawable::addAttributeValue(int attrId,float val)
 { vertexAttributes[attrId]->addFloat(val); }
 
+unsigned int BasicDrawable::addPoints(const Point3f *pts,int numPts)
+{ unsigned int start = points.size();  points.insert(points.end(),pts,pts+numPts);  return start; }
+
+void BasicDrawable::addTexCoords(const Eigen::Vector2f *coords,int numCoords)
+{ vertexAttributes[texCoordEntry]->addValues(coords,numCoords); }
+
+void BasicDrawable::addColors(const RGBAColor *colors,int numColors)
+{ vertexAttributes[colorEntry]->addValues(colors,numColors); }
+
+void BasicDrawable::addNormals(const Point3f *norms,int numNorms)
+{ vertexAttributes[normalEntry]->addValues(norms,numNorms); }
+
 void BasicDrawable::addTriangle(Triangle tri)
 { tris.push_back(tri); }
 
-SimpleIdentity BasicDrawable::getTexId()
+SimpleIdentity BasicDrawable::getTexId() const
 { return texId; }
 
 
@@ -891,12 +646,12 @@ void BasicDrawable::applySubTexture(SubTexture subTex,int startingAt)
 {
     texId = subTex.texId;
     
-    std::vector<TexCoord> *texCoords = (std::vector<TexCoord> *)vertexAttributes[texCoordEntry]->data;
+    TypedVertexAttributeData<Vector2f> *texCoords = vertexAttributes[texCoordEntry]->typedData<Vector2f>();
     
-    for (unsigned int ii=startingAt;ii<texCoords->size();ii++)
+    for (unsigned int ii=startingAt;ii<texCoords->vals.size();ii++)
     {
-        Point2f tc = (*texCoords)[ii];
-        (*texCoords)[ii] = subTex.processTexCoord(TexCoord(tc.x(),tc.y()));
+        Point2f tc = texCoords->vals[ii];
+        texCoords->vals[ii] = subTex.processTexCoord(TexCoord(tc.x(),tc.y()));
     }
 }
     
@@ -913,6 +668,20 @@ unsigned int BasicDrawable::getNumPoints() const
 
 unsigned int BasicDrawable::getNumTris() const
 { return tris.size(); }
+    
+GLenum BasicDrawable::getElementType() const
+{
+    // Once we've set up the buffers, the points are gone
+    if (usingBuffers)
+        return elementType;
+    
+    return (points.size() > MaxDrawablePoints+1) ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+}
+    
+GLuint BasicDrawable::singleElementSize() const
+{
+    return (getElementType() == GL_UNSIGNED_INT) ? sizeof(GLuint) : sizeof(GLushort);
+}
 
 void BasicDrawable::reserveNumPoints(int numPoints)
 { points.reserve(points.size()+numPoints); }
@@ -931,6 +700,19 @@ void BasicDrawable::reserveNumColors(int numColors)
     vertexAttributes[colorEntry]->reserve(numColors);
 }
     
+void BasicDrawable::reserveAttribute(int attrId,int numVals)
+{ vertexAttributes[attrId]->reserve(vertexAttributes[attrId]->numElements()+numVals); }
+    
+void BasicDrawable::setVertexFormat(BDPositionFormat inPosFormat,BDAttributePacking normPacking,BDAttributePacking texCoordPacking)
+{
+    posFormat = inPosFormat;
+    vertexAttributes[normalEntry]->setPacking(normPacking);
+    vertexAttributes[texCoordEntry]->setPacking(texCoordPacking);
+}
+
+BDPositionFormat BasicDrawable::getPositionFormat() const
+{ return posFormat; }
+    
 void BasicDrawable::setMatrix(const Eigen::Matrix4d *inMat)
 { mat = *inMat; hasMatrix = true; }
 
@@ -948,7 +730,7 @@ GLuint BasicDrawable::singleVertexSize()
     if (!points.empty())
     {
         pointBuffer = singleVertSize;
-        singleVertSize += 3*sizeof(GLfloat);
+        singleVertSize += (posFormat == BDPositionShort4) ? 4*sizeof(GLshort) : 3*sizeof(GLfloat);
     }
     
     // Now for the rest of the buffers
@@ -967,16 +749,37 @@ GLuint BasicDrawable::singleVertexSize()
 
 // Adds the basic vertex data to an interleaved vertex buffer
 void BasicDrawable::addPointToBuffer(unsigned char *basePtr,int which)
+{
+    addPointsToBuffer(basePtr,which,1);
+}
+    
+// Adds a run of vertices to an interleaved buffer, one attribute array at a time
+void BasicDrawable::addPointsToBuffer(unsigned char *basePtr,int start,int count)
 {
     if (!points.empty())
-        memcpy(basePtr+pointBuffer, &points[which].x(), 3*sizeof(GLfloat));
+    {
+        unsigned char *ptPtr = basePtr+pointBuffer;
+        if (posFormat == BDPositionShort4)
+        {
+            PositionQuantizer quant(posCenter,posScale);
+            for (int ii=0;ii<count;ii++,ptPtr+=vertexSize)
+            {
+                GLshort vals[4];
+                quant.pack(points[start+ii], vals);
+                memcpy(ptPtr, vals, sizeof(vals));
+            }
+        } else {
+            for (int ii=0;ii<count;ii++,ptPtr+=vertexSize)
+                memcpy(ptPtr, &points[start+ii].x(), 3*sizeof(GLfloat));
+        }
+    }
     
     for (unsigned int ii=0;ii<vertexAttributes.size();ii++)
     {
         VertexAttribute *attr = vertexAttributes[ii];
         if (attr->numElements() != 0)
-            memcpy(basePtr+attr->buffer, attr->addressForElement(which), attr->size());
-    }    
+            attr->interleave(basePtr, vertexSize, start, count);
+    }
 }
     
 void BasicDrawable::setupGL(WhirlyKitGLSetupInfo *setupInfo,OpenGLMemManager *memManager)
@@ -997,7 +800,7 @@ void BasicDrawable::setupGL(WhirlyKitGLSetupInfo *setupInfo,OpenGLMemManager *me
 	if (drawOffset != 0 && (points.size() == vertexAttributes[normalEntry]->numElements()))
 	{
 		float scale = setupInfo->minZres*drawOffset;
-        std::vector<Point3f> &norms = *(std::vector<Point3f> *)vertexAttributes[normalEntry]->data;
+        std::vector<Point3f> &norms = vertexAttributes[normalEntry]->typedData<Point3f>()->vals;
         
 		for (unsigned int ii=0;ii<points.size();ii++)
 		{
@@ -1009,11 +812,23 @@ void BasicDrawable::setupGL(WhirlyKitGLSetupInfo *setupInfo,OpenGLMemManager *me
 	pointBuffer = triBuffer = 0;
     sharedBuffer = 0;
     
+    // Work out the center and scale for compact positions
+    if (posFormat == BDPositionShort4 && !points.empty())
+    {
+        PositionQuantizer quant(&points[0],points.size());
+        posCenter = quant.center;
+        posScale = quant.scale;
+    }
+    
     // We'll set up a single buffer for everything.
     // The other buffer pointers are now strides
     // Size of a single vertex entry
     vertexSize = singleVertexSize();
     int numVerts = points.size();
+    elementType = getElementType();
+    int elementSize = singleElementSize();
+    if (elementType == GL_UNSIGNED_INT && !largeIndicesSupported)
+        NSLog(@"BasicDrawable::setupGL(): Too many vertices (%d) for this device.  Drawable will be corrupt.",numVerts);
     
     // We're handed an external buffer, so just use it
     if (externalSharedBuf)
@@ -1026,31 +841,70 @@ void BasicDrawable::setupGL(WhirlyKitGLSetupInfo *setupInfo,OpenGLMemManager *me
         int bufferSize = vertexSize*numVerts;
         if (!tris.empty())
         {
-                bufferSize += tris.size()*sizeof(Triangle);
+                bufferSize += tris.size()*3*elementSize;
+        }
+        // Small drawables share the slab buffers.  Big ones get their own.
+        if (memManager->getBufferRegion(bufferSize,sharedBufferRegion))
+        {
+            sharedBuffer = sharedBufferRegion.bufferId;
+            sharedBufferOffset = sharedBufferRegion.offset;
+        } else {
+            sharedBuffer = memManager->getBufferID(bufferSize,GL_STATIC_DRAW);
+            sharedBufferOffset = 0;
         }
-        sharedBuffer = memManager->getBufferID(bufferSize,GL_STATIC_DRAW);
-        sharedBufferOffset = 0;
         sharedBufferIsExternal = false;
 	}
     
     // Now copy in the data
-    glBindBuffer(GL_ARRAY_BUFFER, sharedBuffer);
-    void *glMem = glMapBufferOES(GL_ARRAY_BUFFER, GL_WRITE_ONLY_OES);
-    unsigned char *basePtr = (unsigned char *)glMem + sharedBufferOffset;
-    for (unsigned int ii=0;ii<numVerts;ii++,basePtr+=vertexSize)
-        addPointToBuffer(basePtr,ii);
+    // Other drawables may be using the slab, so we build our piece on the side
+    //  rather than mapping the whole thing.
+    // This usually runs on a layer thread, in a context that shares objects with
+    //  the renderer's.  The renderer can be drawing from other regions of the slab
+    //  while we write ours.  That's safe because:
+    //   - No one draws from our region until AddDrawableReq runs on the render thread.
+    //     AddDrawableReq::needsFlush() makes the layer thread flush before it hands
+    //     the change over, so the write has been submitted by then.
+    //   - The renderer binds the buffer again in setupVAO() when it first draws us,
+    //     which is what picks up changes made in another context.
+    //   - Regions are only freed by teardownGL() on the render thread, after the
+    //     last frame that drew from them was presented (and so flushed).
+    GetGLBackend()->bindBuffer(GL_ARRAY_BUFFER, sharedBuffer);
+    unsigned char *regionMem = NULL;
+    unsigned char *startPtr = NULL;
+    if (sharedBufferRegion.bufferId)
+    {
+        regionMem = (unsigned char *)malloc(sharedBufferRegion.size);
+        startPtr = regionMem;
+    } else
+        startPtr = (unsigned char *)GetGLBackend()->mapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY_OES) + sharedBufferOffset;
+    addPointsToBuffer(startPtr,0,numVerts);
 
     // And copy in the element buffer
 	if (tris.size())
 	{
         triBuffer = vertexSize*numVerts;
-        unsigned char *basePtr = (unsigned char *)glMem + triBuffer + sharedBufferOffset;
-        for (unsigned int ii=0;ii<tris.size();ii++,basePtr+=sizeof(Triangle))
-            memcpy(basePtr, &tris[ii], sizeof(Triangle));
+        unsigned char *basePtr = startPtr + triBuffer;
+        if (elementType == GL_UNSIGNED_INT)
+        {
+            for (unsigned int ii=0;ii<tris.size();ii++,basePtr+=3*sizeof(GLuint))
+                memcpy(basePtr, &tris[ii].verts[0], 3*sizeof(GLuint));
+        } else {
+            GLushort *elPtr = (GLushort *)basePtr;
+            for (unsigned int ii=0;ii<tris.size();ii++,elPtr+=3)
+            {
+                const Triangle &tri = tris[ii];
+                elPtr[0] = tri.verts[0];  elPtr[1] = tri.verts[1];  elPtr[2] = tri.verts[2];
+            }
+        }
 	}
-    glUnmapBufferOES(GL_ARRAY_BUFFER);
+    if (regionMem)
+    {
+        GetGLBackend()->bufferSubData(GL_ARRAY_BUFFER, sharedBufferOffset, sharedBufferRegion.size, regionMem);
+        free(regionMem);
+    } else
+        GetGLBackend()->unmapBuffer(GL_ARRAY_BUFFER);
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    GetGLBackend()->bindBuffer(GL_ARRAY_BUFFER, 0);
     
     // Clear out the arrays, since we won't need them again
     numPoints = points.size();
@@ -1095,8 +949,8 @@ NSData *BasicDrawable::asData(bool dupStart,bool dupEnd)
             addPointToBuffer(basePtr, 0);
             basePtr += vertexSize;
         }
-        for (unsigned int ii=0;ii<points.size();ii++,basePtr+=vertexSize)
-            addPointToBuffer(basePtr, ii);
+        addPointsToBuffer(basePtr, 0, points.size());
+        basePtr += vertexSize*points.size();
         if (dupEnd)
         {
             addPointToBuffer(basePtr, points.size()-1);
@@ -1117,6 +971,9 @@ void BasicDrawable::asVertexAndElementData(NSMutableData **retVertData,NSMutable
         return;
     if (points.empty() || tris.empty())
         return;
+    // The big drawables only deal in 16 bit indices
+    if (getElementType() != GL_UNSIGNED_SHORT)
+        return;
 
     // Verify that everything else (that has data) has the same amount)
     int numElements = points.size();
@@ -1133,8 +990,7 @@ void BasicDrawable::asVertexAndElementData(NSMutableData **retVertData,NSMutable
     int numVerts = points.size();
     NSMutableData *vertData = [[NSMutableData alloc] initWithBytesNoCopy:(malloc(vertexSize * numVerts)) length:vertexSize*numVerts freeWhenDone:YES];
     unsigned char *basePtr = (unsigned char *)[vertData mutableBytes];
-    for (unsigned int ii=0;ii<points.size();ii++,basePtr+=vertexSize)
-        addPointToBuffer(basePtr, ii);
+    addPointsToBuffer(basePtr, 0, numVerts);
         
     // Build up the triangles
     int triSize = singleElementSize * 3;
@@ -1147,7 +1003,7 @@ void BasicDrawable::asVertexAndElementData(NSMutableData **retVertData,NSMutable
         Triangle &tri = tris[ii];
         for (unsigned int jj=0;jj<3;jj++)
         {
-            unsigned short vertId = tri.verts[jj];
+            GLushort vertId = tri.verts[jj];
             elPtr[jj] = vertId;
         }
     }
@@ -1294,14 +1150,97 @@ void BasicDrawable::convertToTriStrip()
 }
 #endif
 
+void BasicDrawable::optimizeMesh(bool dedup)
+{
+    if (type != GL_TRIANGLES || usingBuffers || tris.empty())
+        return;
+    
+    // Every attribute has to line up with the points or we can't move them around
+    unsigned int numVerts = points.size();
+    std::vector<VertexAttribute *> activeAttrs;
+    for (unsigned int ii=0;ii<vertexAttributes.size();ii++)
+    {
+        VertexAttribute *attr = vertexAttributes[ii];
+        int numEls = attr->numElements();
+        if (numEls == 0)
+            continue;
+        if (numEls != numVerts)
+            return;
+        activeAttrs.push_back(attr);
+    }
+    
+    std::vector<GLuint> indices;
+    indices.reserve(3*tris.size());
+    for (unsigned int ii=0;ii<tris.size();ii++)
+        indices.insert(indices.end(),tris[ii].verts,tris[ii].verts+3);
+    
+    // Merge vertices that are the same in every respect
+    if (dedup)
+    {
+        std::map<std::string,GLuint> vertMap;
+        std::vector<GLuint> oldToUnique(numVerts);
+        std::string key;
+        for (unsigned int ii=0;ii<numVerts;ii++)
+        {
+            key.assign((const char *)&points[ii],sizeof(Point3f));
+            for (unsigned int ai=0;ai<activeAttrs.size();ai++)
+            {
+                VertexAttribute *attr = activeAttrs[ai];
+                key.append((const char *)attr->addressForElement(ii),attr->data->elementSize());
+            }
+            std::map<std::string,GLuint>::iterator it = vertMap.find(key);
+            if (it == vertMap.end())
+            {
+                oldToUnique[ii] = ii;
+                vertMap[key] = ii;
+            } else
+                oldToUnique[ii] = it->second;
+        }
+        // The duplicates aren't referenced after this, so the fetch pass drops them
+        if (vertMap.size() != numVerts)
+            for (unsigned int ii=0;ii<indices.size();ii++)
+                indices[ii] = oldToUnique[indices[ii]];
+    }
+    
+    OptimizeVertexCache(indices,numVerts);
+    std::vector<GLuint> newToOld;
+    OptimizeVertexFetch(indices,numVerts,newToOld);
+    
+    // Anything at the end that isn't referenced can go
+    GLuint numUsed = 0;
+    for (unsigned int ii=0;ii<indices.size();ii++)
+        numUsed = std::max(numUsed,indices[ii]+1);
+    newToOld.resize(numUsed);
+    
+    std::vector<Point3f> newPoints;
+    newPoints.reserve(numUsed);
+    for (unsigned int ii=0;ii<numUsed;ii++)
+        newPoints.push_back(points[newToOld[ii]]);
+    points.swap(newPoints);
+    for (unsigned int ai=0;ai<activeAttrs.size();ai++)
+        activeAttrs[ai]->remap(newToOld);
+    
+    for (unsigned int ii=0;ii<tris.size();ii++)
+    {
+        Triangle &tri = tris[ii];
+        for (unsigned int jj=0;jj<3;jj++)
+            tri.verts[jj] = indices[3*ii+jj];
+    }
+}
+
 // Tear down the VBOs we set up
 void BasicDrawable::teardownGL(OpenGLMemManager *memManager)
 {
     if (vertArrayObj)
-        glDeleteVertexArraysOES(1,&vertArrayObj);
+        GetGLBackend()->deleteVertexArrays(1,&vertArrayObj);
     vertArrayObj = 0;
     
-    if (sharedBuffer && !sharedBufferIsExternal)
+    if (sharedBufferRegion.bufferId)
+    {
+        memManager->removeBufferRegion(sharedBufferRegion);
+        sharedBufferRegion = BufferAllocation();
+        sharedBuffer = 0;
+    } else if (sharedBuffer && !sharedBufferIsExternal)
     {
         memManager->removeBufferID(sharedBuffer);
         sharedBuffer = 0;
@@ -1331,21 +1270,27 @@ void BasicDrawable::setupVAO(OpenGLES2Program *prog)
 {
     const OpenGLESAttribute *vertAttr = prog->findAttribute("a_position");
 
-    glGenVertexArraysOES(1, &vertArrayObj);
-    glBindVertexArrayOES(vertArrayObj);
+    GetGLBackend()->genVertexArrays(1, &vertArrayObj);
+    // Recording a command list can run out of names.  We'll try again next frame.
+    if (!vertArrayObj)
+        return;
+    GetGLBackend()->bindVertexArray(vertArrayObj);
     
     // We're using a single buffer for all of our vertex attributes
     if (sharedBuffer)
     {
-        glBindBuffer(GL_ARRAY_BUFFER,sharedBuffer);
+        GetGLBackend()->bindBuffer(GL_ARRAY_BUFFER,sharedBuffer);
         CheckGLError("BasicDrawable::drawVBO2() shared glBindBuffer");
     }
     
     // Vertex array
     if (vertAttr)
     {
-        glVertexAttribPointer(vertAttr->index, 3, GL_FLOAT, GL_FALSE, vertexSize, CALCBUFOFF(sharedBufferOffset,0));
-        glEnableVertexAttribArray ( vertAttr->index );
+        if (posFormat == BDPositionShort4)
+            GetGLBackend()->vertexAttribPointer(vertAttr->index, 3, GL_SHORT, GL_TRUE, vertexSize, CALCBUFOFF(sharedBufferOffset,0));
+        else
+            GetGLBackend()->vertexAttribPointer(vertAttr->index, 3, GL_FLOAT, GL_FALSE, vertexSize, CALCBUFOFF(sharedBufferOffset,0));
+        GetGLBackend()->enableVertexAttribArray( vertAttr->index );
     }
     
     // All the rest of the attributes
@@ -1354,11 +1299,11 @@ void BasicDrawable::setupVAO(OpenGLES2Program *prog)
     {
         progAttrs[ii] = NULL;
         VertexAttribute *attr = vertexAttributes[ii];
-        const OpenGLESAttribute *thisAttr = prog->findAttribute(attr->name);
+        const OpenGLESAttribute *thisAttr = prog->findAttribute(attr->glName());
         if (thisAttr && (attr->buffer != 0 || attr->numElements() != 0))
         {
-            glVertexAttribPointer(thisAttr->index, attr->glEntryComponents(), attr->glType(), attr->glNormalize(), vertexSize, CALCBUFOFF(sharedBufferOffset,attr->buffer));
-            glEnableVertexAttribArray(thisAttr->index);
+            GetGLBackend()->vertexAttribPointer(thisAttr->index, attr->glEntryComponents(), attr->glType(), attr->glNormalize(), vertexSize, CALCBUFOFF(sharedBufferOffset,attr->buffer));
+            GetGLBackend()->enableVertexAttribArray(thisAttr->index);
             progAttrs[ii] = thisAttr;
         }
     }
@@ -1368,25 +1313,25 @@ void BasicDrawable::setupVAO(OpenGLES2Program *prog)
     if (type == GL_TRIANGLES && triBuffer)
     {
         boundElements = true;
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sharedBuffer);
+        GetGLBackend()->bindBuffer(GL_ELEMENT_ARRAY_BUFFER, sharedBuffer);
         CheckGLError("BasicDrawable::drawVBO2() glBindBuffer");
     }    
     
-    glBindVertexArrayOES(0);
+    GetGLBackend()->bindVertexArray(0);
 
     // Let a subclass set up their own VAO state
     setupAdditionalVAO(prog,vertArrayObj);
     
     // Now tear down all that state
     if (vertAttr)
-        glDisableVertexAttribArray(vertAttr->index);
+        GetGLBackend()->disableVertexAttribArray(vertAttr->index);
     for (unsigned int ii=0;ii<vertexAttributes.size();ii++)
         if (progAttrs[ii])
-            glDisableVertexAttribArray(progAttrs[ii]->index);    
+            GetGLBackend()->disableVertexAttribArray(progAttrs[ii]->index);    
     if (boundElements)
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        GetGLBackend()->bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
     if (sharedBuffer)
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        GetGLBackend()->bindBuffer(GL_ARRAY_BUFFER, 0);
 }
         
 // Draw Vertex Buffer Objects, OpenGL 2.0
@@ -1445,34 +1390,59 @@ void BasicDrawable::drawOGL2(WhirlyKitRendererFrameInfo *frameInfo,Scene *scene)
         glTexID = scene->getGLTexture(texId);
         
     // Model/View/Projection matrix
-    prog->setUniform("u_mvpMatrix", frameInfo.mvpMat);
-    prog->setUniform("u_mvMatrix", frameInfo.viewAndModelMat);
-    prog->setUniform("u_mvNormalMatrix", frameInfo.viewModelNormalMat);
+    // Short positions are decoded by folding the center and scale into the matrices
+    if (posFormat == BDPositionShort4 && usingBuffers)
+    {
+        Matrix4f decodeMat = Matrix4f::Identity();
+        decodeMat(0,0) = decodeMat(1,1) = decodeMat(2,2) = posScale;
+        decodeMat.block<3,1>(0,3) = posCenter;
+        prog->setUniform(StdUniformMVPMatrix, (Matrix4f)(frameInfo.mvpMat * decodeMat));
+        prog->setUniform(StdUniformMVMatrix, (Matrix4f)(frameInfo.viewAndModelMat * decodeMat));
+    } else {
+        prog->setUniform(StdUniformMVPMatrix, frameInfo.mvpMat);
+        prog->setUniform(StdUniformMVMatrix, frameInfo.viewAndModelMat);
+    }
+    prog->setUniform(StdUniformMVNormalMatrix, frameInfo.viewModelNormalMat);
+    
+    // Octahedral normals come in through their own attribute, but only from the buffers
+    prog->setUniform(StdUniformOctNormals, (vertexAttributes[normalEntry]->getPacking() == BDPackOctahedral && usingBuffers));
     
     // Fade is always mixed in
-    prog->setUniform("u_fade", fade);
+    prog->setUniform(StdUniformFade, fade);
     
     // Let the shaders know if we even have a texture
-    prog->setUniform("u_hasTexture", (glTexID != 0));
+    prog->setUniform(StdUniformHasTexture, (glTexID != 0));
     
     // If this is present, the drawable wants to do something based where the viewer is looking
-    prog->setUniform("u_eyeVec", frameInfo.fullEyeVec);
+    prog->setUniform(StdUniformEyeVec, frameInfo.fullEyeVec);
     
     // Texture
-    const OpenGLESUniform *texUni = prog->findUniform("s_baseMap");
+    // This stays bound after we draw, since the next drawable probably wants it too
+    const OpenGLESUniform *texUni = prog->getUniform(StdUniformBaseMap);
     bool hasTexture = glTexID != 0 && texUni;
+    [frameInfo.stateOpt setActiveTexture:GL_TEXTURE0];
+    [frameInfo.stateOpt setBoundTexture:(hasTexture ? glTexID : 0)];
+    CheckGLError("BasicDrawable::drawVBO2() glBindTexture");
     if (hasTexture)
     {
-        [frameInfo.stateOpt setActiveTexture:GL_TEXTURE0];
-        glBindTexture(GL_TEXTURE_2D, glTexID);
-        CheckGLError("BasicDrawable::drawVBO2() glBindTexture");
-        prog->setUniform("s_baseMap", 0);
+        prog->setUniform(StdUniformBaseMap, 0);
         CheckGLError("BasicDrawable::drawVBO2() glUniform1i");
     }
     
     // If necessary, set up the VAO (once)
     if (vertArrayObj == 0 && sharedBuffer != 0)
+    {
         setupVAO(prog);
+        // That bound things behind the state optimizer's back
+        [frameInfo.stateOpt resetBindings];
+        if (!vertArrayObj)
+            return;
+    }
+    
+    // The last drawable may have left its VAO bound, and we're about to
+    //  point at our own arrays
+    if (!vertArrayObj)
+        [frameInfo.stateOpt setVertexArray:0];
 
     // Figure out what we're using
     const OpenGLESAttribute *vertAttr = prog->findAttribute("a_position");
@@ -1482,9 +1452,9 @@ void BasicDrawable::drawOGL2(WhirlyKitRendererFrameInfo *frameInfo,Scene *scene)
     if (vertAttr && !(sharedBuffer || pointBuffer))
     {
         usedLocalVertices = true;
-        glVertexAttribPointer(vertAttr->index, 3, GL_FLOAT, GL_FALSE, 0, &points[0]);
+        GetGLBackend()->vertexAttribPointer(vertAttr->index, 3, GL_FLOAT, GL_FALSE, 0, &points[0]);
         CheckGLError("BasicDrawable::drawVBO2() glVertexAttribPointer");
-        glEnableVertexAttribArray ( vertAttr->index );            
+        GetGLBackend()->enableVertexAttribArray( vertAttr->index );            
         CheckGLError("BasicDrawable::drawVBO2() glEnableVertexAttribArray");
     }
     
@@ -1501,11 +1471,12 @@ void BasicDrawable::drawOGL2(WhirlyKitRendererFrameInfo *frameInfo,Scene *scene)
             if (attr->buffer == 0)
             {
                 // We have a data array for it, so hand that over
+                // Note: Packing only happens in the buffers, so the raw data goes over unpacked
                 if (attr->numElements() != 0)
                 {
-                    glVertexAttribPointer(progAttr->index, attr->glEntryComponents(), attr->glType(), attr->glNormalize(), 0, attr->addressForElement(0));
+                    GetGLBackend()->vertexAttribPointer(progAttr->index, attr->glEntryComponents(false), attr->glType(false), attr->glNormalize(false), 0, attr->addressForElement(0));
                 CheckGLError("BasicDrawable::drawVBO2() glVertexAttribPointer");
-                    glEnableVertexAttribArray ( progAttr->index );
+                    GetGLBackend()->enableVertexAttribArray( progAttr->index );
                     CheckGLError("BasicDrawable::drawVBO2() glEnableVertexAttribArray");
                     
                     progAttrs[ii] = progAttr;
@@ -1523,13 +1494,14 @@ void BasicDrawable::drawOGL2(WhirlyKitRendererFrameInfo *frameInfo,Scene *scene)
     bindAdditionalRenderObjects(frameInfo,scene);
     
     // If we're using a vertex array object, bind it and draw
+    // The VAO stays bound.  Anything drawing without one will unbind it.
     if (vertArrayObj)
     {
-        glBindVertexArrayOES(vertArrayObj);
+        [frameInfo.stateOpt setVertexArray:vertArrayObj];
         switch (type)
         {
             case GL_TRIANGLES:
-                glDrawElements(GL_TRIANGLES, numTris*3, GL_UNSIGNED_SHORT, CALCBUFOFF(sharedBufferOffset,triBuffer));
+                GetGLBackend()->drawElements(GL_TRIANGLES, numTris*3, elementType, CALCBUFOFF(sharedBufferOffset,triBuffer));
                 CheckGLError("BasicDrawable::drawVBO2() glDrawElements");
                 break;
             case GL_POINTS:
@@ -1537,15 +1509,14 @@ void BasicDrawable::drawOGL2(WhirlyKitRendererFrameInfo *frameInfo,Scene *scene)
             case GL_LINE_STRIP:
             case GL_LINE_LOOP:
                 [frameInfo.stateOpt setLineWidth:lineWidth];
-                glDrawArrays(type, 0, numPoints);
+                GetGLBackend()->drawArrays(type, 0, numPoints);
                 CheckGLError("BasicDrawable::drawVBO2() glDrawArrays");
                 break;
             case GL_TRIANGLE_STRIP:
-                glDrawArrays(type, 0, numPoints);
+                GetGLBackend()->drawArrays(type, 0, numPoints);
                 CheckGLError("BasicDrawable::drawVBO2() glDrawArrays");
                 break;
         }
-        glBindVertexArrayOES(0);
     } else {
         // Draw without a VAO
         switch (type)
@@ -1554,13 +1525,23 @@ void BasicDrawable::drawOGL2(WhirlyKitRendererFrameInfo *frameInfo,Scene *scene)
             {
                 if (triBuffer)
                 {
-                    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, triBuffer);
+                    [frameInfo.stateOpt setElementArrayBuffer:triBuffer];
                     CheckGLError("BasicDrawable::drawVBO2() glBindBuffer");
-                    glDrawElements(GL_TRIANGLES, numTris*3, GL_UNSIGNED_SHORT, 0);
+                    GetGLBackend()->drawElements(GL_TRIANGLES, numTris*3, elementType, 0);
                     CheckGLError("BasicDrawable::drawVBO2() glDrawElements");
-                    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
                 } else {
-                    glDrawElements(GL_TRIANGLES, tris.size()*3, GL_UNSIGNED_SHORT, &tris[0]);
+                    // Indices come from our memory, so there can't be an element buffer bound
+                    [frameInfo.stateOpt setElementArrayBuffer:0];
+                    // Our local triangles are 32 bit, so they may need converting
+                    if (largeIndicesSupported)
+                        GetGLBackend()->drawElements(GL_TRIANGLES, tris.size()*3, GL_UNSIGNED_INT, &tris[0]);
+                    else {
+                        std::vector<GLushort> shortTris(tris.size()*3);
+                        for (unsigned int ii=0;ii<tris.size();ii++)
+                            for (unsigned int jj=0;jj<3;jj++)
+                                shortTris[3*ii+jj] = tris[ii].verts[jj];
+                        GetGLBackend()->drawElements(GL_TRIANGLES, shortTris.size(), GL_UNSIGNED_SHORT, &shortTris[0]);
+                    }
                     CheckGLError("BasicDrawable::drawVBO2() glDrawElements");
                 }
             }
@@ -1571,29 +1552,22 @@ void BasicDrawable::drawOGL2(WhirlyKitRendererFrameInfo *frameInfo,Scene *scene)
             case GL_LINE_LOOP:
                 [frameInfo.stateOpt setLineWidth:lineWidth];
                 CheckGLError("BasicDrawable::drawVBO2() glLineWidth");
-                glDrawArrays(type, 0, numPoints);
+                GetGLBackend()->drawArrays(type, 0, numPoints);
                 CheckGLError("BasicDrawable::drawVBO2() glDrawArrays");
                 break;
             case GL_TRIANGLE_STRIP:
-                glDrawArrays(type, 0, numPoints);
+                GetGLBackend()->drawArrays(type, 0, numPoints);
                 CheckGLError("BasicDrawable::drawVBO2() glDrawArrays");
                 break;
         }
     }
     
-    // Unbind any texture
-    if (hasTexture)
-    {
-        [frameInfo.stateOpt setActiveTexture:GL_TEXTURE0];
-        glBindTexture(GL_TEXTURE_2D, 0);
-    }
-
     // Tear down the various arrays, if we stood them up
     if (usedLocalVertices)
-        glDisableVertexAttribArray(vertAttr->index);
+        GetGLBackend()->disableVertexAttribArray(vertAttr->index);
     for (unsigned int ii=0;ii<vertexAttributes.size();ii++)
         if (progAttrs[ii])
-            glDisableVertexAttribArray(progAttrs[ii]->index);
+            GetGLBackend()->disableVertexAttribArray(progAttrs[ii]->index);
 
     // Let a subclass clean up any remaining state
     postDrawCallback(frameInfo,scene);
@@ -1638,7 +1612,7 @@ void VisibilityChangeRequest::execute2(Scene *scene,WhirlyKitSceneRendererES *re
 }
     
 FadeChangeRequest::FadeChangeRequest(SimpleIdentity drawId,NSTimeInterval fadeUp,NSTimeInterval fadeDown)
-    : DrawableChangeRequest(drawId), fadeUp(fadeUp), fadeDown(fadeDown)
+    : DrawableChangeRequest(drawId), fadeUp(fadeUp), fadeDown(fadeDown), renderUntil(0.0)
 {
     
 }
@@ -1652,6 +1626,13 @@ void FadeChangeRequest::execute2(Scene *scene,WhirlyKitSceneRendererES *renderer
     // And let the renderer know
     [renderer setRenderUntil:fadeDown];
     [renderer setRenderUntil:fadeUp];
+    [renderer setRenderUntil:renderUntil];
+}
+    
+void FadeChangeRequest::takeOverTarget(ChangeRequest *earlier,SimpleIdentity targetID)
+{
+    FadeChangeRequest *earlierFade = (FadeChangeRequest *)earlier;
+    renderUntil = std::max(renderUntil,std::max(earlierFade->renderUntil,std::max(earlierFade->fadeUp,earlierFade->fadeDown)));
 }
 
 DrawTexChangeRequest::DrawTexChangeRequest(SimpleIdentity drawId,SimpleIdentity newTexId)
@@ -0,0 +1,280 @@
+/*
+ *  DrawableBuilder.mm
+ *  WhirlyGlobeLib
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <algorithm>
+#import "DrawableBuilder.h"
+
+using namespace Eigen;
+
+namespace WhirlyKit
+{
+    
+// Spread the bottom 16 bits out to every other bit
+static unsigned int SpreadBits(unsigned int val)
+{
+    val &= 0xffff;
+    val = (val | (val << 8)) & 0x00ff00ff;
+    val = (val | (val << 4)) & 0x0f0f0f0f;
+    val = (val | (val << 2)) & 0x33333333;
+    val = (val | (val << 1)) & 0x55555555;
+    
+    return val;
+}
+
+// Morton (Z order) code for a point within the given bounds
+static unsigned int MortonCode(const Point2f &pt,const Mbr &bounds)
+{
+    Point2f span = bounds.ur() - bounds.ll();
+    float x = (span.x() > 0.0) ? (pt.x() - bounds.ll().x()) / span.x() : 0.0;
+    float y = (span.y() > 0.0) ? (pt.y() - bounds.ll().y()) / span.y() : 0.0;
+    unsigned int ix = std::min(std::max(x,0.f),1.f) * 0xffff;
+    unsigned int iy = std::min(std::max(y,0.f),1.f) * 0xffff;
+    
+    return SpreadBits(ix) | (SpreadBits(iy) << 1);
+}
+    
+ChunkedDrawableBuilder::ChunkedDrawableBuilder(const std::string &name,GLenum type)
+    : name(name), type(type), maxChunkPoints(0), optimizeMeshes(false)
+{
+    // Rounds down to an even number for lines
+    setMaxChunkPoints(MaxDrawablePointsForDevice());
+}
+    
+ChunkedDrawableBuilder::~ChunkedDrawableBuilder()
+{
+}
+    
+void ChunkedDrawableBuilder::setMaxChunkPoints(unsigned int maxPoints)
+{
+    maxChunkPoints = maxPoints;
+    // Lines need to come in pairs
+    if (type == GL_LINES && (maxChunkPoints & 1))
+        maxChunkPoints--;
+}
+    
+void ChunkedDrawableBuilder::startGroup(const Mbr &mbr)
+{
+    Group group;
+    group.mbr = mbr;
+    group.startPoint = points.size();
+    group.numPoints = 0;
+    group.startTri = tris.size();
+    group.numTris = 0;
+    group.sortKey = 0;
+    groups.push_back(group);
+}
+    
+unsigned int ChunkedDrawableBuilder::addPoint(const Point3f &pt,const Point3f &norm)
+{
+    if (groups.empty())
+        startGroup(Mbr());
+    Group &group = groups.back();
+
+    points.push_back(pt);
+    norms.push_back(norm);
+    
+    return group.numPoints++;
+}
+
+unsigned int ChunkedDrawableBuilder::addPoint(const Point3f &pt,const Point3f &norm,RGBAColor color)
+{
+    // Colors are all or nothing
+    if (colors.size() != points.size())
+        colors.resize(points.size(),RGBAColor(255,255,255,255));
+    colors.push_back(color);
+
+    return addPoint(pt,norm);
+}
+    
+void ChunkedDrawableBuilder::addTriangle(GLuint v0,GLuint v1,GLuint v2)
+{
+    if (groups.empty())
+        return;
+    Group &group = groups.back();
+    
+    tris.push_back(BasicDrawable::Triangle(v0,v1,v2));
+    group.numTris++;
+}
+    
+unsigned int ChunkedDrawableBuilder::getNumPoints() const
+{
+    return points.size();
+}
+
+bool ChunkedDrawableBuilder::GroupSort(const Group *a,const Group *b)
+{
+    return a->sortKey < b->sortKey;
+}
+    
+void ChunkedDrawableBuilder::startChunk(Chunk &chunk)
+{
+    chunk.draw = new BasicDrawable(name);
+    chunk.draw->setType(type);
+    chunk.mbr.reset();
+    setupDrawable(chunk.draw);
+}
+    
+void ChunkedDrawableBuilder::flushChunk(Chunk &chunk,std::vector<BasicDrawable *> &drawables)
+{
+    if (!chunk.draw)
+        return;
+    
+    if (chunk.draw->getNumPoints() > 0)
+    {
+        chunk.draw->setLocalMbr(chunk.mbr);
+        if (optimizeMeshes)
+            chunk.draw->optimizeMesh();
+        drawables.push_back(chunk.draw);
+    } else
+        delete chunk.draw;
+    chunk.draw = NULL;
+}
+    
+void ChunkedDrawableBuilder::copyPoint(BasicDrawable *draw,unsigned int which)
+{
+    draw->addPoint(points[which]);
+    draw->addNormal(norms[which]);
+    if (!colors.empty())
+        draw->addColor(colors[which]);
+}
+    
+void ChunkedDrawableBuilder::addGroup(Chunk &chunk,const Group &group)
+{
+    BasicDrawable *draw = chunk.draw;
+    GLuint baseVert = draw->getNumPoints();
+    draw->addPoints(&points[group.startPoint],group.numPoints);
+    draw->addNormals(&norms[group.startPoint],group.numPoints);
+    if (!colors.empty())
+        draw->addColors(&colors[group.startPoint],group.numPoints);
+    for (unsigned int ii=0;ii<group.numTris;ii++)
+    {
+        BasicDrawable::Triangle tri = tris[group.startTri+ii];
+        for (unsigned int jj=0;jj<3;jj++)
+            tri.verts[jj] += baseVert;
+        draw->addTriangle(tri);
+    }
+    if (group.mbr.valid())
+        chunk.mbr.expand(group.mbr);
+}
+    
+void ChunkedDrawableBuilder::splitGroup(Chunk &chunk,const Group &group,std::vector<BasicDrawable *> &drawables)
+{
+    if (group.numTris == 0)
+    {
+        // Points or lines, so we can just cut it up
+        for (unsigned int ii=0;ii<group.numPoints;ii++)
+        {
+            if (chunk.draw->getNumPoints() >= maxChunkPoints)
+            {
+                flushChunk(chunk,drawables);
+                startChunk(chunk);
+            }
+            copyPoint(chunk.draw,group.startPoint+ii);
+            if (group.mbr.valid())
+                chunk.mbr.expand(group.mbr);
+        }
+        return;
+    }
+    
+    // Triangles share vertices, so we remap them into each drawable as we go
+    std::vector<int> remap(group.numPoints,-1);
+    for (unsigned int ii=0;ii<group.numTris;ii++)
+    {
+        const BasicDrawable::Triangle &tri = tris[group.startTri+ii];
+        int newVerts = 0;
+        for (unsigned int jj=0;jj<3;jj++)
+            if (remap[tri.verts[jj]] < 0)
+                newVerts++;
+        if (chunk.draw->getNumPoints() + newVerts > maxChunkPoints)
+        {
+            flushChunk(chunk,drawables);
+            startChunk(chunk);
+            std::fill(remap.begin(),remap.end(),-1);
+        }
+        
+        BasicDrawable::Triangle newTri;
+        for (unsigned int jj=0;jj<3;jj++)
+        {
+            int &newVert = remap[tri.verts[jj]];
+            if (newVert < 0)
+            {
+                newVert = chunk.draw->getNumPoints();
+                copyPoint(chunk.draw,group.startPoint+tri.verts[jj]);
+            }
+            newTri.verts[jj] = newVert;
+        }
+        chunk.draw->addTriangle(newTri);
+        if (group.mbr.valid())
+            chunk.mbr.expand(group.mbr);
+    }
+}
+    
+void ChunkedDrawableBuilder::buildDrawables(std::vector<BasicDrawable *> &drawables)
+{
+    if (!colors.empty() && colors.size() != points.size())
+        colors.resize(points.size(),RGBAColor(255,255,255,255));
+    
+    // Sort the groups along a Z order curve so the drawables are spatially coherent
+    Mbr bounds;
+    for (unsigned int ii=0;ii<groups.size();ii++)
+        if (groups[ii].mbr.valid())
+            bounds.expand(groups[ii].mbr);
+    std::vector<Group *> sortedGroups;
+    sortedGroups.reserve(groups.size());
+    for (unsigned int ii=0;ii<groups.size();ii++)
+    {
+        Group &group = groups[ii];
+        if (group.numPoints == 0)
+            continue;
+        if (group.mbr.valid() && bounds.valid())
+            group.sortKey = MortonCode(group.mbr.mid(),bounds);
+        sortedGroups.push_back(&group);
+    }
+    std::stable_sort(sortedGroups.begin(),sortedGroups.end(),GroupSort);
+    
+    // Now pack them in to drawables
+    Chunk chunk;
+    for (unsigned int ii=0;ii<sortedGroups.size();ii++)
+    {
+        const Group &group = *sortedGroups[ii];
+        if (!chunk.draw)
+            startChunk(chunk);
+        if (chunk.draw->getNumPoints() + group.numPoints > maxChunkPoints)
+        {
+            if (group.numPoints > maxChunkPoints)
+            {
+                splitGroup(chunk,group,drawables);
+                continue;
+            }
+            flushChunk(chunk,drawables);
+            startChunk(chunk);
+        }
+        addGroup(chunk,group);
+    }
+    flushChunk(chunk,drawables);
+    
+    points.clear();
+    norms.clear();
+    colors.clear();
+    tris.clear();
+    groups.clear();
+}
+    
+}
@@ -26,7 +26,7 @@ namespace WhirlyKit
     
 DynamicDrawableAtlas::DynamicDrawableAtlas(const std::string &name,int singleElementSize,int numVertexBytes,int numElementBytes,OpenGLMemManager *memManager,BigDrawable *(*newBigDrawable)(BasicDrawable *draw,int singleElementSize,int numVertexBytes,int numElementBytes),
                                            SimpleIdentity shaderId)
-    : name(name), singleVertexSize(0), singleElementSize(singleElementSize), numVertexBytes(numVertexBytes), numElementBytes(numElementBytes), memManager(memManager), newBigDrawable(newBigDrawable), shaderId(shaderId)
+    : name(name), singleVertexSize(0), singleElementSize(singleElementSize), numVertexBytes(numVertexBytes), numElementBytes(numElementBytes), memManager(memManager), newBigDrawable(newBigDrawable), shaderId(shaderId), compaction(false)
 {
 }
     
@@ -52,6 +52,10 @@ bool DynamicDrawableAtlas::addDrawable(BasicDrawable *draw,ChangeSet &changes,bo
     if (draw->getType() != GL_TRIANGLES)
         return false;
     
+    // Big drawables need float positions
+    if (draw->getPositionFormat() != BDPositionFloat3)
+        return false;
+    
     // If this is the first one we've seen, we'll configure ourselves to match it
     const std::vector<VertexAttribute *> &drawVertexAttributes = draw->getVertexAttributes();
     if (singleVertexSize == 0)
@@ -71,7 +75,8 @@ bool DynamicDrawableAtlas::addDrawable(BasicDrawable *draw,ChangeSet &changes,bo
     }
     for (unsigned int ii=0;ii<drawVertexAttributes.size();ii++)
         // Note: Comparison could be more comprehensive
-        if (vertexAttributes[ii].getDataType() != drawVertexAttributes[ii]->getDataType())
+        if (vertexAttributes[ii].getDataType() != drawVertexAttributes[ii]->getDataType() ||
+            vertexAttributes[ii].getPacking() != drawVertexAttributes[ii]->getPacking())
         {
             NSLog(@"DynamicDrawableAtlas::addDrawable(): Drawable mismatch.  Punting drawable.");
             return false;
@@ -110,6 +115,7 @@ bool DynamicDrawableAtlas::addDrawable(BasicDrawable *draw,ChangeSet &changes,bo
         else
             newBigDraw = new BigDrawable(name,singleVertexSize,vertexAttributes,singleElementSize,numVertexBytes,numElementBytes);
         newBigDraw->setProgram(shaderId);
+        newBigDraw->setCompaction(compaction);
 
         newBigDraw->setModes(draw);
         newBigDraw->setupGL(NULL, memManager);
@@ -259,6 +265,8 @@ void DynamicDrawableAtlas::log()
     NSLog(@"Drawable Atlas: Big Drawables: %ld (%.2f MB + %.2f MB)\tRepresented Drawables:%ld",bigDrawables.size(),bigDrawables.size()*(numVertexBytes)/(float)(1024*1024),bigDrawables.size()*(numElementBytes)/(float)(1024*1024),
           drawables.size());
     int vertTotal = 0, elTotal = 0;
+    float maxFrag = 0.0;
+    long long elCopied = 0;
     for (BigDrawableSet::iterator it = bigDrawables.begin();
          it != bigDrawables.end(); ++it)
     {
@@ -266,8 +274,14 @@ void DynamicDrawableAtlas::log()
         (*it)->getUtilization(thisVertSize,thisElSize);
         vertTotal += thisVertSize;
         elTotal += thisElSize;
+        RegionAllocatorStats stats;
+        (*it)->getVertexStats(stats);
+        maxFrag = std::max(maxFrag,stats.fragmentation());
+        elCopied += (*it)->getElementBytesCopied();
     }
     NSLog(@"Drawable Atlas: using (%.2f MB) for vertices, (%.2f MB) for elements.",vertTotal/(float)(1024*1024),elTotal/(float)(1024*1024));
+    NSLog(@"Drawable Atlas: worst vertex fragmentation %.2f",maxFrag);
+    NSLog(@"Drawable Atlas: %.2f MB copied into element buffers",elCopied/(float)(1024*1024));
 }
     
 }
@@ -27,7 +27,7 @@ namespace WhirlyKit
 {
  
 DynamicTexture::DynamicTexture(const std::string &name,int texSize,int cellSize,GLenum inFormat)
-    : TextureBase(name), texSize(texSize), cellSize(cellSize), numCell(0), numRegions(0), compressed(false), layoutGrid(NULL)
+    : TextureBase(name), texSize(texSize), cellSize(cellSize), numCell(0), numRegions(0), compressed(false), packer(NULL)
 {
     if (texSize <= 0 || cellSize <= 0)
         return;
@@ -60,20 +60,18 @@ DynamicTexture::DynamicTexture(const std::string &name,int texSize,int cellSize,
     }
     
     numCell = texSize/cellSize;
-    layoutGrid = new bool[numCell * numCell];
-    for (unsigned int ii=0;ii<numCell * numCell;ii++)
-        layoutGrid[ii] = false;
+    packer = new RectPacker(numCell,numCell);
     
     pthread_mutex_init(&regionLock,NULL);
 }
     
 DynamicTexture::~DynamicTexture()
 {
-    if (!layoutGrid)
+    if (!packer)
         return;
     
-    delete [] layoutGrid;
-    layoutGrid = NULL;
+    delete packer;
+    packer = NULL;
     
     pthread_mutex_destroy(&regionLock);
 }
@@ -88,19 +86,19 @@ bool DynamicTexture::createInGL(OpenGLMemManager *memManager)
     glId = memManager->getTexID();
     if (!glId)
         return false;
-    glBindTexture(GL_TEXTURE_2D, glId);
+    GetGLBackend()->bindTexture(GL_TEXTURE_2D, glId);
     CheckGLError("DynamicTexture::createInGL() glBindTexture()");
     
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    GetGLBackend()->texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	GetGLBackend()->texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    GetGLBackend()->texParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    GetGLBackend()->texParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
     if (compressed)
     {
         size_t size = texSize * texSize / 2;
-		glCompressedTexImage2D(GL_TEXTURE_2D, 0, GL_COMPRESSED_RGB_PVRTC_4BPPV1_IMG, texSize, texSize, 0, size, NULL);
+		GetGLBackend()->compressedTexImage2D(GL_TEXTURE_2D, 0, GL_COMPRESSED_RGB_PVRTC_4BPPV1_IMG, texSize, texSize, 0, size, NULL);
     } else {
         // Turn this on to provide glTexImage2D with empty memory so Instruments doesn't complain
 //        size_t size = texSize*texSize*4;
@@ -108,11 +106,11 @@ bool DynamicTexture::createInGL(OpenGLMemManager *memManager)
 //        memset(zeroMem, 255, size);
 //        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, texSize, texSize, 0, GL_RGBA, format, zeroMem);
 //        free(zeroMem);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, texSize, texSize, 0, format, type, NULL);
+        GetGLBackend()->texImage2D(GL_TEXTURE_2D, 0, format, texSize, texSize, 0, format, type, NULL);
     }
     CheckGLError("DynamicTexture::createInGL() glTexImage2D()");
     
-    glBindTexture(GL_TEXTURE_2D, 0);
+    GetGLBackend()->bindTexture(GL_TEXTURE_2D, 0);
     
     return true;
 }
@@ -142,34 +140,76 @@ void DynamicTexture::addTextureData(int startX,int startY,int width,int height,N
 //        if (startX+width > texSize || startY+height > texSize)
 //            NSLog(@"Pixels outside bounds in dynamic texture.");
         
-        glBindTexture(GL_TEXTURE_2D, glId);
+        GetGLBackend()->bindTexture(GL_TEXTURE_2D, glId);
         CheckGLError("DynamicTexture::createInGL() glBindTexture()");
         if (compressed)
         {
             size_t size = width * height / 2;
-            glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, startX, startY, width, height, GL_COMPRESSED_RGB_PVRTC_4BPPV1_IMG, size, [data bytes]);
+            GetGLBackend()->compressedTexSubImage2D(GL_TEXTURE_2D, 0, startX, startY, width, height, GL_COMPRESSED_RGB_PVRTC_4BPPV1_IMG, size, [data bytes]);
         } else
-            glTexSubImage2D(GL_TEXTURE_2D, 0, startX, startY, width, height, format, type, [data bytes]);
+            GetGLBackend()->texSubImage2D(GL_TEXTURE_2D, 0, startX, startY, width, height, format, type, [data bytes]);
         CheckGLError("DynamicTexture::addTexture() glTexSubImage2D()");
-        glBindTexture(GL_TEXTURE_2D, 0);
+        GetGLBackend()->bindTexture(GL_TEXTURE_2D, 0);
     }    
 }
 
+void DynamicTexture::copyTextureData(DynamicTexture *srcTex,int srcX,int srcY,int destX,int destY,int width,int height)
+{
+    if (!srcTex || !srcTex->glId || !glId)
+        return;
+    
+    // Read from the source by way of a framebuffer
+    GLint oldFrameBuffer;
+    GetGLBackend()->getIntegerv(GL_FRAMEBUFFER_BINDING, &oldFrameBuffer);
+    GLuint frameBuffer;
+    GetGLBackend()->genFramebuffers(1, &frameBuffer);
+    GetGLBackend()->bindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
+    GetGLBackend()->framebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, srcTex->glId, 0);
+    if (GetGLBackend()->checkFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE)
+    {
+        GetGLBackend()->bindTexture(GL_TEXTURE_2D, glId);
+        GetGLBackend()->copyTexSubImage2D(GL_TEXTURE_2D, 0, destX, destY, srcX, srcY, width, height);
+        CheckGLError("DynamicTexture::copyTextureData() glCopyTexSubImage2D()");
+        GetGLBackend()->bindTexture(GL_TEXTURE_2D, 0);
+    } else
+        NSLog(@"DynamicTexture: Can't copy from texture %d",srcTex->glId);
+    GetGLBackend()->bindFramebuffer(GL_FRAMEBUFFER, oldFrameBuffer);
+    GetGLBackend()->deleteFramebuffers(1, &frameBuffer);
+}
+
 void DynamicTexture::setRegion(const Region &region, bool enable)
 {
     int sx = std::max(region.sx,0), sy = std::max(region.sy,0);
     int ex = std::min(region.ex,numCell-1), ey = std::min(region.ey,numCell-1);
+    if (ex < sx || ey < sy)
+        return;
     
-    for (unsigned int ix=sx;ix<=ex;ix++)
-        for (unsigned int iy=sy;iy<=ey;iy++)
-        {
-            layoutGrid[iy*numCell+ix] = enable;
-        }
+    RectPacker::Rect rect(sx,sy,ex-sx+1,ey-sy+1);
+    if (enable)
+        packer->reserve(rect);
+    else
+        packer->release(rect);
 }
     
 bool DynamicTexture::findRegion(int sizeX,int sizeY,Region &region)
 {
     // First thing we need to do is clear any outstanding regions
+    clearReleasedRegions();
+    
+    // Now look for a region that'll fit
+    RectPacker::Rect rect;
+    if (!packer->findSpot(sizeX, sizeY, rect))
+        return false;
+    
+    // Found one, so fill it in
+    region.sx = rect.x;  region.sy = rect.y;
+    region.ex = rect.x+sizeX-1;  region.ey = rect.y+sizeY-1;
+    
+    return true;
+}
+    
+void DynamicTexture::clearReleasedRegions()
+{
     // Don't sit on the lock, as the main thread uses it
     std::vector<Region> toClear;
     pthread_mutex_lock(&regionLock);
@@ -178,37 +218,6 @@ bool DynamicTexture::findRegion(int sizeX,int sizeY,Region &region)
     pthread_mutex_unlock(&regionLock);
     for (unsigned int ii=0;ii<toClear.size();ii++)
         setRegion(toClear[ii], false);
-    
-    // Now look for a region that'll fit
-    // Look for a spot big enough
-    bool found = false;
-    int foundX,foundY;
-    for (int iy=0;iy<=numCell-sizeY && !found;iy++)
-        for (int ix=0;ix<=numCell-sizeX && !found;ix++)
-        {
-            bool clear = true;
-            for (int testY=0;testY<sizeY && clear;testY++)
-                for (int testX=0;testX<sizeX && clear;testX++)
-                {
-                    if (layoutGrid[(testY+iy)*numCell+(testX+ix)])
-                        clear = false;
-                }
-            if (clear)
-            {
-                foundX = ix;
-                foundY = iy;
-                found = true;
-            }
-        }
-    
-    if (!found)
-        return false;
-    
-    // Found one, so fill it in
-    region.sx = foundX;  region.sy = foundY;
-    region.ex = foundX+sizeX-1;  region.ey = foundY+sizeY-1;
-    
-    return true;
 }
     
 void DynamicTexture::addRegionToClear(const Region &region)
@@ -225,13 +234,16 @@ bool DynamicTexture::empty()
 
 void DynamicTexture::getUtilization(int &outNumCell,int &usedCell)
 {
-    outNumCell = numCell*numCell;
-    usedCell = 0;
-    for (unsigned int ii=0;ii<numCell*numCell;ii++)
-    {
-        if (layoutGrid[ii])
-            usedCell++;
-    }
+    RectPackerStats stats;
+    getUtilization(stats);
+    outNumCell = stats.totalArea;
+    usedCell = stats.usedArea;
+}
+    
+void DynamicTexture::getUtilization(RectPackerStats &stats)
+{
+    if (packer)
+        packer->getStats(stats);
 }
     
 void DynamicTextureClearRegion::execute(Scene *scene,WhirlyKitSceneRendererES *renderer,WhirlyKitView *view)
@@ -244,6 +256,19 @@ void DynamicTextureClearRegion::execute(Scene *scene,WhirlyKitSceneRendererES *r
     }
 }
     
+void DynamicTextureCopyRegion::execute(Scene *scene,WhirlyKitSceneRendererES *renderer,WhirlyKitView *view)
+{
+    DynamicTexture *srcTex = dynamic_cast<DynamicTexture *>(scene->getTexture(srcTexId));
+    DynamicTexture *destTex = dynamic_cast<DynamicTexture *>(scene->getTexture(destTexId));
+    if (srcTex && destTex)
+        destTex->copyTextureData(srcTex, srcX, srcY, destX, destY, width, height);
+}
+    
+void DynamicTextureMoveSubTextures::execute(Scene *scene,WhirlyKitSceneRendererES *renderer,WhirlyKitView *view)
+{
+    scene->replaceSubTextures(subTexes);
+}
+    
 void DynamicTextureAddRegion::execute(Scene *scene,WhirlyKitSceneRendererES *renderer,WhirlyKitView *view)
 {
     TextureBase *tex = scene->getTexture(texId);
@@ -405,45 +430,155 @@ void DynamicTextureAtlas::shutdown(ChangeSet &changes)
     regions.clear();
 }
 
-void DynamicTextureAtlas::log()
+bool DynamicTextureAtlas::canDefragment()
 {
-    int numCells=0,usedCells=0;
-    for (DynamicTextureSet::iterator it = textures.begin();
-         it != textures.end(); ++it)
+    // We copy through a framebuffer, so the format needs to be renderable
+    switch (format)
+    {
+        case GL_UNSIGNED_BYTE:
+        case GL_UNSIGNED_SHORT_5_6_5:
+        case GL_UNSIGNED_SHORT_4_4_4_4:
+        case GL_UNSIGNED_SHORT_5_5_5_1:
+            return true;
+        default:
+            return false;
+    }
+}
+    
+int DynamicTextureAtlas::defragment(const DynamicTextureDefragParams &params,ChangeSet &changes,std::vector<SubTextureMove> &moves)
+{
+    if (!canDefragment() || textures.size() < 2)
+        return 0;
+    
+    // Describe the textures and what's in them for the planner
+    std::vector<DynamicTextureDefragPlanner::Page> pages;
+    std::map<SimpleIdentity,int> pageIndex;
+    for (DynamicTextureSet::iterator it = textures.begin(); it != textures.end(); ++it)
     {
         DynamicTexture *tex = *it;
-        int thisNumCells,thisUsedCells;
-        tex->getUtilization(thisNumCells,thisUsedCells);
-        numCells += thisNumCells;
-        usedCells += thisUsedCells;
+        tex->clearReleasedRegions();
+        DynamicTextureDefragPlanner::Page page;
+        page.pageId = tex->getId();
+        page.packer = tex->getPacker();
+        pageIndex[page.pageId] = pages.size();
+        pages.push_back(page);
     }
-
+    for (TextureRegionSet::iterator it = regions.begin(); it != regions.end(); ++it)
+    {
+        std::map<SimpleIdentity,int>::iterator pit = pageIndex.find(it->dynTexId);
+        if (pit == pageIndex.end())
+            continue;
+        const DynamicTexture::Region &region = it->region;
+        pages[pit->second].entries.push_back(DynamicTextureDefragPlanner::Entry(it->subTex.getId(),RectPacker::Rect(region.sx,region.sy,region.ex-region.sx+1,region.ey-region.sy+1)));
+    }
+    
+    // The planner reserves space in the destination textures as it goes
+    std::vector<DynamicTextureDefragPlanner::Move> planMoves;
+    std::vector<SimpleIdentity> emptiedPages;
+    DynamicTextureDefragPlanner planner(params);
+    planner.plan(pages, planMoves, emptiedPages);
+    
+    std::vector<SubTexture> movedSubTexes;
+    for (unsigned int ii=0;ii<planMoves.size();ii++)
+    {
+        const DynamicTextureDefragPlanner::Move &move = planMoves[ii];
+        TextureRegion texRegion;
+        texRegion.subTex.setId(move.subTexId);
+        TextureRegionSet::iterator it = regions.find(texRegion);
+        if (it == regions.end())
+            continue;
+        texRegion = *it;
+        regions.erase(it);
+        
+        // Copy the whole region, which picks up the borders too
+        changes.push_back(new DynamicTextureCopyRegion(move.fromPage,move.toPage,
+                                                       move.fromRect.x * cellSize, move.fromRect.y * cellSize,
+                                                       move.toRect.x * cellSize, move.toRect.y * cellSize,
+                                                       move.fromRect.width * cellSize, move.fromRect.height * cellSize));
+        
+        SubTextureMove subTexMove;
+        subTexMove.oldSubTex = texRegion.subTex;
+        // Same sub texture, just shifted over to the new spot
+        Point2f shift((move.toRect.x - move.fromRect.x) * cellSize / (float)texSize, (move.toRect.y - move.fromRect.y) * cellSize / (float)texSize);
+        texRegion.subTex.trans = Eigen::Translation2f(shift) * texRegion.subTex.trans;
+        texRegion.subTex.texId = move.toPage;
+        texRegion.dynTexId = move.toPage;
+        texRegion.region.sx = move.toRect.x;  texRegion.region.sy = move.toRect.y;
+        texRegion.region.ex = move.toRect.x + move.toRect.width - 1;  texRegion.region.ey = move.toRect.y + move.toRect.height - 1;
+        regions.insert(texRegion);
+        subTexMove.newSubTex = texRegion.subTex;
+        moves.push_back(subTexMove);
+        movedSubTexes.push_back(texRegion.subTex);
+        
+        DynamicTexture searchTex(move.toPage);
+        DynamicTextureSet::iterator tit = textures.find(&searchTex);
+        if (tit != textures.end())
+            (*tit)->getNumRegions()++;
+    }
+    
+    // Anyone looking up the sub textures by ID gets the new spots, before the old textures go away
+    if (!movedSubTexes.empty())
+        changes.push_back(new DynamicTextureMoveSubTextures(movedSubTexes));
+    
+    // The emptied textures go away after the copies are done
+    for (unsigned int ii=0;ii<emptiedPages.size();ii++)
+    {
+        DynamicTexture searchTex(emptiedPages[ii]);
+        DynamicTextureSet::iterator it = textures.find(&searchTex);
+        if (it != textures.end())
+        {
+            changes.push_back(new RemTextureReq((*it)->getId()));
+            textures.erase(it);
+        }
+    }
+    if (!planMoves.empty())
+        changes.push_back(NULL);
+    
+    return emptiedPages.size();
+}
+    
+int DynamicTextureAtlas::getTextureBytes()
+{
     int texelSize = 4;
     switch (format)
     {
         case GL_UNSIGNED_SHORT_5_6_5:
         case GL_UNSIGNED_SHORT_4_4_4_4:
         case GL_UNSIGNED_SHORT_5_5_5_1:
-            texelSize = 2;;
-            break;
-        case GL_UNSIGNED_BYTE:
-            texelSize = 4;
+            texelSize = 2;
             break;
         case GL_ALPHA:
             texelSize = 1;
             break;
         case GL_COMPRESSED_RGB_PVRTC_4BPPV1_IMG:
-            // Doesn't really matter.  Can't do these.
-            texelSize = 1;
+            // 4 bits per texel
+            return texSize*texSize/2;
             break;
         default:
             break;
-            
     }
     
-    NSLog(@"DynamicTextureAtlas: %ld textures, (%.2f MB)",textures.size(),textures.size() * texSize*texSize*texelSize/(float)(1024*1024));
+    return texSize*texSize*texelSize;
+}
+    
+void DynamicTextureAtlas::log()
+{
+    int numCells=0,usedCells=0;
+    float maxFrag = 0.0;
+    for (DynamicTextureSet::iterator it = textures.begin();
+         it != textures.end(); ++it)
+    {
+        DynamicTexture *tex = *it;
+        RectPackerStats stats;
+        tex->getUtilization(stats);
+        numCells += stats.totalArea;
+        usedCells += stats.usedArea;
+        maxFrag = std::max(maxFrag,stats.fragmentation());
+    }
+
+    NSLog(@"DynamicTextureAtlas: %ld textures, (%.2f MB)",textures.size(),textures.size() * getTextureBytes()/(float)(1024*1024));
     if (numCells > 0)
-        NSLog(@"DynamicTextureAtlas: using %.2f%% of the cells",100 * usedCells / (float)numCells);
+        NSLog(@"DynamicTextureAtlas: using %.2f%% of the cells, worst fragmentation %.2f",100 * usedCells / (float)numCells,maxFrag);
 }
 
 }
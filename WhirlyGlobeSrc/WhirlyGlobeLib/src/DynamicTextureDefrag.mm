@@ -0,0 +1,146 @@
+/*
+ *  DynamicTextureDefrag.mm
+ *  WhirlyGlobeLib
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <algorithm>
+#import "DynamicTextureDefrag.h"
+
+namespace WhirlyKit
+{
+
+// Used to sort pages by how much of them is in use
+class PageUsage
+{
+public:
+    bool operator < (const PageUsage &that) const
+    {
+        if (used == that.used)
+            return which < that.which;
+        return used < that.used;
+    }
+    
+    float used;
+    int which;
+};
+    
+// Sort the sub textures biggest first, which packs better
+static bool EntryBigger(const DynamicTextureDefragPlanner::Entry &a,const DynamicTextureDefragPlanner::Entry &b)
+{
+    return a.rect.width*a.rect.height > b.rect.width*b.rect.height;
+}
+    
+void DynamicTextureDefragPlanner::plan(std::vector<Page> &pages,std::vector<Move> &moves,std::vector<SimpleIdentity> &emptiedPages)
+{
+    if (pages.size() < 2)
+        return;
+    
+    // Sparsest pages first
+    std::vector<PageUsage> usage(pages.size());
+    for (unsigned int ii=0;ii<pages.size();ii++)
+    {
+        RectPackerStats stats;
+        pages[ii].packer->getStats(stats);
+        usage[ii].used = (stats.totalArea > 0) ? stats.usedArea / (float)stats.totalArea : 1.0;
+        usage[ii].which = ii;
+    }
+    std::sort(usage.begin(),usage.end());
+    
+    std::vector<bool> emptied(pages.size(),false);
+    // Pages we're moving things into can't be emptied in the same pass
+    std::vector<bool> receiving(pages.size(),false);
+    int numPages = pages.size();
+    int cellsMoved = 0;
+    for (unsigned int ui=0;ui<usage.size();ui++)
+    {
+        // Stop once we're under the target and out of sparse pages
+        bool overTarget = params.targetPages > 0 && numPages > params.targetPages;
+        if (!overTarget && usage[ui].used >= params.sparseUtilization)
+            break;
+        
+        if (receiving[usage[ui].which])
+            continue;
+        Page &srcPage = pages[usage[ui].which];
+        int pageCells = 0;
+        for (unsigned int ei=0;ei<srcPage.entries.size();ei++)
+            pageCells += srcPage.entries[ei].rect.width * srcPage.entries[ei].rect.height;
+        if (cellsMoved + pageCells > params.maxCellsPerPass)
+            continue;
+        
+        // Try fitting everything into the denser pages, working on copies of their packers
+        std::vector<Entry> entries = srcPage.entries;
+        std::sort(entries.begin(),entries.end(),EntryBigger);
+        std::vector<std::pair<int,RectPacker> > trial;
+        std::vector<Move> pageMoves;
+        bool allFit = true;
+        for (unsigned int ei=0;ei<entries.size() && allFit;ei++)
+        {
+            const Entry &entry = entries[ei];
+            bool placed = false;
+            // Densest pages first, so they fill up and the sparse ones empty out
+            for (int uj=usage.size()-1;uj>(int)ui && !placed;uj--)
+            {
+                int dst = usage[uj].which;
+                if (emptied[dst])
+                    continue;
+                
+                // Use the trial copy of this packer, if we've made one
+                RectPacker *packer = NULL;
+                for (unsigned int ti=0;ti<trial.size();ti++)
+                    if (trial[ti].first == dst)
+                        packer = &trial[ti].second;
+                if (!packer)
+                {
+                    trial.push_back(std::pair<int,RectPacker>(dst,*pages[dst].packer));
+                    packer = &trial.back().second;
+                }
+                
+                RectPacker::Rect rect;
+                if (packer->findSpot(entry.rect.width,entry.rect.height,rect))
+                {
+                    packer->reserve(rect);
+                    Move move;
+                    move.subTexId = entry.subTexId;
+                    move.fromPage = srcPage.pageId;
+                    move.toPage = pages[dst].pageId;
+                    move.fromRect = entry.rect;
+                    move.toRect = rect;
+                    pageMoves.push_back(move);
+                    placed = true;
+                }
+            }
+            allFit = placed;
+        }
+        if (!allFit)
+            continue;
+        
+        // It all fit, so make it official
+        for (unsigned int ti=0;ti<trial.size();ti++)
+        {
+            *pages[trial[ti].first].packer = trial[ti].second;
+            receiving[trial[ti].first] = true;
+        }
+        moves.insert(moves.end(),pageMoves.begin(),pageMoves.end());
+        emptied[usage[ui].which] = true;
+        emptiedPages.push_back(srcPage.pageId);
+        cellsMoved += pageCells;
+        numPages--;
+    }
+}
+
+}
@@ -0,0 +1,462 @@
+/*
+ *  GLBackend.mm
+ *  WhirlyGlobeLib
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <pthread.h>
+#import "GLBackend.h"
+
+namespace WhirlyKit
+{
+    
+static OpenGLES2Backend DefaultGLBackend;
+GLBackend *CurrentGLBackend = &DefaultGLBackend;
+    
+void SetGLBackend(GLBackend *backend)
+{
+    CurrentGLBackend = backend ? backend : &DefaultGLBackend;
+}
+    
+bool GLThreadBackendsInUse = false;
+static pthread_key_t GLThreadBackendKey;
+static pthread_once_t GLThreadBackendOnce = PTHREAD_ONCE_INIT;
+    
+static void MakeGLThreadBackendKey()
+{
+    pthread_key_create(&GLThreadBackendKey, NULL);
+}
+    
+GLBackend *GetThreadGLBackend()
+{
+    GLBackend *backend = (GLBackend *)pthread_getspecific(GLThreadBackendKey);
+    return backend ? backend : CurrentGLBackend;
+}
+    
+void SetThreadGLBackend(GLBackend *backend)
+{
+    pthread_once(&GLThreadBackendOnce, MakeGLThreadBackendKey);
+    pthread_setspecific(GLThreadBackendKey, backend);
+    // Other threads may see the flag right away, so the key has to be there first
+    if (backend && !GLThreadBackendsInUse)
+    {
+        __sync_synchronize();
+        GLThreadBackendsInUse = true;
+    }
+}
+    
+void OpenGLES2Backend::genBuffers(GLsizei n,GLuint *buffers)
+{
+    glGenBuffers(n,buffers);
+}
+    
+void OpenGLES2Backend::deleteBuffers(GLsizei n,const GLuint *buffers)
+{
+    glDeleteBuffers(n,buffers);
+}
+    
+void OpenGLES2Backend::bindBuffer(GLenum target,GLuint buffer)
+{
+    glBindBuffer(target,buffer);
+}
+    
+void OpenGLES2Backend::bufferData(GLenum target,GLsizeiptr size,const GLvoid *data,GLenum usage)
+{
+    glBufferData(target,size,data,usage);
+}
+    
+void OpenGLES2Backend::bufferSubData(GLenum target,GLintptr offset,GLsizeiptr size,const GLvoid *data)
+{
+    glBufferSubData(target,offset,size,data);
+}
+    
+GLvoid *OpenGLES2Backend::mapBuffer(GLenum target,GLenum access)
+{
+    return glMapBufferOES(target,access);
+}
+    
+GLboolean OpenGLES2Backend::unmapBuffer(GLenum target)
+{
+    return glUnmapBufferOES(target);
+}
+    
+void OpenGLES2Backend::genVertexArrays(GLsizei n,GLuint *arrays)
+{
+    glGenVertexArraysOES(n,arrays);
+}
+    
+void OpenGLES2Backend::deleteVertexArrays(GLsizei n,const GLuint *arrays)
+{
+    glDeleteVertexArraysOES(n,arrays);
+}
+    
+void OpenGLES2Backend::bindVertexArray(GLuint array)
+{
+    glBindVertexArrayOES(array);
+}
+    
+void OpenGLES2Backend::enableVertexAttribArray(GLuint index)
+{
+    glEnableVertexAttribArray(index);
+}
+    
+void OpenGLES2Backend::disableVertexAttribArray(GLuint index)
+{
+    glDisableVertexAttribArray(index);
+}
+    
+void OpenGLES2Backend::vertexAttribPointer(GLuint index,GLint size,GLenum type,GLboolean normalized,GLsizei stride,const GLvoid *ptr)
+{
+    glVertexAttribPointer(index,size,type,normalized,stride,ptr);
+}
+    
+void OpenGLES2Backend::vertexAttrib1f(GLuint index,GLfloat x)
+{
+    glVertexAttrib1f(index,x);
+}
+    
+void OpenGLES2Backend::vertexAttrib2f(GLuint index,GLfloat x,GLfloat y)
+{
+    glVertexAttrib2f(index,x,y);
+}
+    
+void OpenGLES2Backend::vertexAttrib3f(GLuint index,GLfloat x,GLfloat y,GLfloat z)
+{
+    glVertexAttrib3f(index,x,y,z);
+}
+    
+void OpenGLES2Backend::vertexAttrib4f(GLuint index,GLfloat x,GLfloat y,GLfloat z,GLfloat w)
+{
+    glVertexAttrib4f(index,x,y,z,w);
+}
+    
+void OpenGLES2Backend::genTextures(GLsizei n,GLuint *textures)
+{
+    glGenTextures(n,textures);
+}
+    
+void OpenGLES2Backend::deleteTextures(GLsizei n,const GLuint *textures)
+{
+    glDeleteTextures(n,textures);
+}
+    
+void OpenGLES2Backend::activeTexture(GLenum texture)
+{
+    glActiveTexture(texture);
+}
+    
+void OpenGLES2Backend::bindTexture(GLenum target,GLuint texture)
+{
+    glBindTexture(target,texture);
+}
+    
+void OpenGLES2Backend::texParameteri(GLenum target,GLenum pname,GLint param)
+{
+    glTexParameteri(target,pname,param);
+}
+    
+void OpenGLES2Backend::texImage2D(GLenum target,GLint level,GLint internalformat,GLsizei width,GLsizei height,GLint border,GLenum format,GLenum type,const GLvoid *pixels)
+{
+    glTexImage2D(target,level,internalformat,width,height,border,format,type,pixels);
+}
+    
+void OpenGLES2Backend::texSubImage2D(GLenum target,GLint level,GLint xoffset,GLint yoffset,GLsizei width,GLsizei height,GLenum format,GLenum type,const GLvoid *pixels)
+{
+    glTexSubImage2D(target,level,xoffset,yoffset,width,height,format,type,pixels);
+}
+    
+void OpenGLES2Backend::compressedTexImage2D(GLenum target,GLint level,GLenum internalformat,GLsizei width,GLsizei height,GLint border,GLsizei imageSize,const GLvoid *data)
+{
+    glCompressedTexImage2D(target,level,internalformat,width,height,border,imageSize,data);
+}
+    
+void OpenGLES2Backend::compressedTexSubImage2D(GLenum target,GLint level,GLint xoffset,GLint yoffset,GLsizei width,GLsizei height,GLenum format,GLsizei imageSize,const GLvoid *data)
+{
+    glCompressedTexSubImage2D(target,level,xoffset,yoffset,width,height,format,imageSize,data);
+}
+    
+void OpenGLES2Backend::copyTexSubImage2D(GLenum target,GLint level,GLint xoffset,GLint yoffset,GLint x,GLint y,GLsizei width,GLsizei height)
+{
+    glCopyTexSubImage2D(target,level,xoffset,yoffset,x,y,width,height);
+}
+    
+void OpenGLES2Backend::generateMipmap(GLenum target)
+{
+    glGenerateMipmap(target);
+}
+    
+GLuint OpenGLES2Backend::createShader(GLenum type)
+{
+    return glCreateShader(type);
+}
+    
+void OpenGLES2Backend::shaderSource(GLuint shader,GLsizei count,const GLchar **string,const GLint *length)
+{
+    glShaderSource(shader,count,string,length);
+}
+    
+void OpenGLES2Backend::compileShader(GLuint shader)
+{
+    glCompileShader(shader);
+}
+    
+void OpenGLES2Backend::getShaderiv(GLuint shader,GLenum pname,GLint *params)
+{
+    glGetShaderiv(shader,pname,params);
+}
+    
+void OpenGLES2Backend::getShaderInfoLog(GLuint shader,GLsizei bufsize,GLsizei *length,GLchar *infolog)
+{
+    glGetShaderInfoLog(shader,bufsize,length,infolog);
+}
+    
+void OpenGLES2Backend::deleteShader(GLuint shader)
+{
+    glDeleteShader(shader);
+}
+    
+GLuint OpenGLES2Backend::createProgram()
+{
+    return glCreateProgram();
+}
+    
+void OpenGLES2Backend::attachShader(GLuint program,GLuint shader)
+{
+    glAttachShader(program,shader);
+}
+    
+void OpenGLES2Backend::linkProgram(GLuint program)
+{
+    glLinkProgram(program);
+}
+    
+void OpenGLES2Backend::validateProgram(GLuint program)
+{
+    glValidateProgram(program);
+}
+    
+void OpenGLES2Backend::getProgramiv(GLuint program,GLenum pname,GLint *params)
+{
+    glGetProgramiv(program,pname,params);
+}
+    
+void OpenGLES2Backend::getProgramInfoLog(GLuint program,GLsizei bufsize,GLsizei *length,GLchar *infolog)
+{
+    glGetProgramInfoLog(program,bufsize,length,infolog);
+}
+    
+void OpenGLES2Backend::deleteProgram(GLuint program)
+{
+    glDeleteProgram(program);
+}
+    
+void OpenGLES2Backend::useProgram(GLuint program)
+{
+    glUseProgram(program);
+}
+    
+void OpenGLES2Backend::getActiveUniform(GLuint program,GLuint index,GLsizei bufsize,GLsizei *length,GLint *size,GLenum *type,GLchar *name)
+{
+    glGetActiveUniform(program,index,bufsize,length,size,type,name);
+}
+    
+void OpenGLES2Backend::getActiveAttrib(GLuint program,GLuint index,GLsizei bufsize,GLsizei *length,GLint *size,GLenum *type,GLchar *name)
+{
+    glGetActiveAttrib(program,index,bufsize,length,size,type,name);
+}
+    
+int OpenGLES2Backend::getUniformLocation(GLuint program,const GLchar *name)
+{
+    return glGetUniformLocation(program,name);
+}
+    
+int OpenGLES2Backend::getAttribLocation(GLuint program,const GLchar *name)
+{
+    return glGetAttribLocation(program,name);
+}
+    
+void OpenGLES2Backend::uniform1i(GLint location,GLint x)
+{
+    glUniform1i(location,x);
+}
+    
+void OpenGLES2Backend::uniform1f(GLint location,GLfloat x)
+{
+    glUniform1f(location,x);
+}
+    
+void OpenGLES2Backend::uniform2f(GLint location,GLfloat x,GLfloat y)
+{
+    glUniform2f(location,x,y);
+}
+    
+void OpenGLES2Backend::uniform3f(GLint location,GLfloat x,GLfloat y,GLfloat z)
+{
+    glUniform3f(location,x,y,z);
+}
+    
+void OpenGLES2Backend::uniform4f(GLint location,GLfloat x,GLfloat y,GLfloat z,GLfloat w)
+{
+    glUniform4f(location,x,y,z,w);
+}
+    
+void OpenGLES2Backend::uniformMatrix4fv(GLint location,GLsizei count,GLboolean transpose,const GLfloat *value)
+{
+    glUniformMatrix4fv(location,count,transpose,value);
+}
+    
+void OpenGLES2Backend::enable(GLenum cap)
+{
+    glEnable(cap);
+}
+    
+void OpenGLES2Backend::disable(GLenum cap)
+{
+    glDisable(cap);
+}
+    
+void OpenGLES2Backend::depthMask(GLboolean flag)
+{
+    glDepthMask(flag);
+}
+    
+void OpenGLES2Backend::depthFunc(GLenum func)
+{
+    glDepthFunc(func);
+}
+    
+void OpenGLES2Backend::blendFunc(GLenum sfactor,GLenum dfactor)
+{
+    glBlendFunc(sfactor,dfactor);
+}
+    
+void OpenGLES2Backend::lineWidth(GLfloat width)
+{
+    glLineWidth(width);
+}
+    
+void OpenGLES2Backend::viewport(GLint x,GLint y,GLsizei width,GLsizei height)
+{
+    glViewport(x,y,width,height);
+}
+    
+void OpenGLES2Backend::clearColor(GLclampf red,GLclampf green,GLclampf blue,GLclampf alpha)
+{
+    glClearColor(red,green,blue,alpha);
+}
+    
+void OpenGLES2Backend::clear(GLbitfield mask)
+{
+    glClear(mask);
+}
+    
+void OpenGLES2Backend::genFramebuffers(GLsizei n,GLuint *framebuffers)
+{
+    glGenFramebuffers(n,framebuffers);
+}
+    
+void OpenGLES2Backend::deleteFramebuffers(GLsizei n,const GLuint *framebuffers)
+{
+    glDeleteFramebuffers(n,framebuffers);
+}
+    
+void OpenGLES2Backend::bindFramebuffer(GLenum target,GLuint framebuffer)
+{
+    glBindFramebuffer(target,framebuffer);
+}
+    
+void OpenGLES2Backend::framebufferRenderbuffer(GLenum target,GLenum attachment,GLenum renderbuffertarget,GLuint renderbuffer)
+{
+    glFramebufferRenderbuffer(target,attachment,renderbuffertarget,renderbuffer);
+}
+    
+void OpenGLES2Backend::framebufferTexture2D(GLenum target,GLenum attachment,GLenum textarget,GLuint texture,GLint level)
+{
+    glFramebufferTexture2D(target,attachment,textarget,texture,level);
+}
+    
+GLenum OpenGLES2Backend::checkFramebufferStatus(GLenum target)
+{
+    return glCheckFramebufferStatus(target);
+}
+    
+void OpenGLES2Backend::genRenderbuffers(GLsizei n,GLuint *renderbuffers)
+{
+    glGenRenderbuffers(n,renderbuffers);
+}
+    
+void OpenGLES2Backend::deleteRenderbuffers(GLsizei n,const GLuint *renderbuffers)
+{
+    glDeleteRenderbuffers(n,renderbuffers);
+}
+    
+void OpenGLES2Backend::bindRenderbuffer(GLenum target,GLuint renderbuffer)
+{
+    glBindRenderbuffer(target,renderbuffer);
+}
+    
+void OpenGLES2Backend::renderbufferStorage(GLenum target,GLenum internalformat,GLsizei width,GLsizei height)
+{
+    glRenderbufferStorage(target,internalformat,width,height);
+}
+    
+void OpenGLES2Backend::getRenderbufferParameteriv(GLenum target,GLenum pname,GLint *params)
+{
+    glGetRenderbufferParameteriv(target,pname,params);
+}
+    
+void OpenGLES2Backend::discardFramebuffer(GLenum target,GLsizei numAttachments,const GLenum *attachments)
+{
+    glDiscardFramebufferEXT(target,numAttachments,attachments);
+}
+    
+void OpenGLES2Backend::drawArrays(GLenum mode,GLint first,GLsizei count)
+{
+    glDrawArrays(mode,first,count);
+}
+    
+void OpenGLES2Backend::drawElements(GLenum mode,GLsizei count,GLenum type,const GLvoid *indices)
+{
+    glDrawElements(mode,count,type,indices);
+}
+    
+void OpenGLES2Backend::flush()
+{
+    glFlush();
+}
+    
+void OpenGLES2Backend::finish()
+{
+    glFinish();
+}
+    
+GLenum OpenGLES2Backend::getError()
+{
+    return glGetError();
+}
+    
+void OpenGLES2Backend::getIntegerv(GLenum pname,GLint *params)
+{
+    glGetIntegerv(pname,params);
+}
+    
+const GLubyte *OpenGLES2Backend::getString(GLenum name)
+{
+    return glGetString(name);
+}
+    
+}
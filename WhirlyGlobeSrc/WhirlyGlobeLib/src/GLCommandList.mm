@@ -0,0 +1,924 @@
+/*
+ *  GLCommandList.mm
+ *  WhirlyGlobeLib
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <string.h>
+#import "GLCommandList.h"
+
+namespace WhirlyKit
+{
+    
+GLCommandList::GLCommandList()
+    : numDropped(0), outOfNames(false), vertexArray(0), elementBuffer(0)
+{
+}
+    
+GLCommandList::~GLCommandList()
+{
+}
+    
+void GLCommandList::clear()
+{
+    // Keep the memory, we'll be doing this again next frame
+    commands.clear();
+    payload.clear();
+    numDropped = 0;
+    outOfNames = false;
+    vertexArray = 0;
+    elementBuffer = 0;
+}
+    
+void GLCommandList::reserveNames(GLBackend *backend,int numNames)
+{
+    if ((int)bufferNames.size() < numNames)
+    {
+        int start = (int)bufferNames.size();
+        bufferNames.resize(numNames);
+        backend->genBuffers(numNames-start, &bufferNames[start]);
+    }
+    if ((int)textureNames.size() < numNames)
+    {
+        int start = (int)textureNames.size();
+        textureNames.resize(numNames);
+        backend->genTextures(numNames-start, &textureNames[start]);
+    }
+    if ((int)vertexArrayNames.size() < numNames)
+    {
+        int start = (int)vertexArrayNames.size();
+        vertexArrayNames.resize(numNames);
+        backend->genVertexArrays(numNames-start, &vertexArrayNames[start]);
+    }
+}
+    
+void GLCommandList::releaseNames(GLBackend *backend)
+{
+    if (!bufferNames.empty())
+        backend->deleteBuffers((GLsizei)bufferNames.size(), &bufferNames[0]);
+    if (!textureNames.empty())
+        backend->deleteTextures((GLsizei)textureNames.size(), &textureNames[0]);
+    if (!vertexArrayNames.empty())
+        backend->deleteVertexArrays((GLsizei)vertexArrayNames.size(), &vertexArrayNames[0]);
+    bufferNames.clear();
+    textureNames.clear();
+    vertexArrayNames.clear();
+}
+    
+GLCommandList::Command &GLCommandList::add(CommandType type)
+{
+    commands.resize(commands.size()+1);
+    Command &cmd = commands.back();
+    cmd.type = type;
+    cmd.ptr = NULL;
+    
+    return cmd;
+}
+    
+GLuint GLCommandList::addPayload(const void *data,size_t len)
+{
+    GLuint offset = (GLuint)payload.size();
+    payload.resize(offset+len);
+    if (len > 0)
+        memcpy(&payload[offset], data, len);
+    
+    return offset;
+}
+    
+void GLCommandList::takeNames(std::vector<GLuint> &reserve,GLsizei n,GLuint *names)
+{
+    for (GLsizei ii=0;ii<n;ii++)
+    {
+        if (reserve.empty())
+        {
+            names[ii] = 0;
+            outOfNames = true;
+        } else {
+            names[ii] = reserve.back();
+            reserve.pop_back();
+        }
+    }
+}
+    
+// Bytes in an uncompressed texture upload
+static size_t TextureDataSize(GLsizei width,GLsizei height,GLenum format,GLenum type)
+{
+    int pixelSize = 4;
+    if (type == GL_UNSIGNED_SHORT_5_6_5 || type == GL_UNSIGNED_SHORT_4_4_4_4 || type == GL_UNSIGNED_SHORT_5_5_5_1)
+        pixelSize = 2;
+    else {
+        switch (format)
+        {
+            case GL_RGB: pixelSize = 3; break;
+            case GL_LUMINANCE_ALPHA: pixelSize = 2; break;
+            case GL_LUMINANCE:
+            case GL_ALPHA: pixelSize = 1; break;
+            default: break;
+        }
+    }
+    
+    return (size_t)width * height * pixelSize;
+}
+    
+// Bytes for the given number of indices
+static size_t IndexDataSize(GLsizei count,GLenum type)
+{
+    switch (type)
+    {
+        case GL_UNSIGNED_BYTE:
+            return count;
+        case GL_UNSIGNED_SHORT:
+            return count * 2;
+        default:
+            return count * 4;
+    }
+}
+    
+void GLCommandList::replay(GLBackend *backend) const
+{
+    const unsigned char *data = payload.empty() ? NULL : &payload[0];
+    
+    for (unsigned int ii=0;ii<commands.size();ii++)
+    {
+        const Command &cmd = commands[ii];
+        switch (cmd.type)
+        {
+            case CmdDeleteBuffers:
+                backend->deleteBuffers(cmd.args[0].i, (const GLuint *)(data + cmd.args[1].u));
+                break;
+            case CmdBindBuffer:
+                backend->bindBuffer(cmd.args[0].u, cmd.args[1].u);
+                break;
+            case CmdBufferData:
+                backend->bufferData(cmd.args[0].u, cmd.args[1].i, cmd.ptr ? data + cmd.args[2].u : NULL, cmd.args[3].u);
+                break;
+            case CmdBufferSubData:
+                backend->bufferSubData(cmd.args[0].u, cmd.args[1].i, cmd.args[2].i, data + cmd.args[3].u);
+                break;
+            case CmdDeleteVertexArrays:
+                backend->deleteVertexArrays(cmd.args[0].i, (const GLuint *)(data + cmd.args[1].u));
+                break;
+            case CmdBindVertexArray:
+                backend->bindVertexArray(cmd.args[0].u);
+                break;
+            case CmdEnableVertexAttribArray:
+                backend->enableVertexAttribArray(cmd.args[0].u);
+                break;
+            case CmdDisableVertexAttribArray:
+                backend->disableVertexAttribArray(cmd.args[0].u);
+                break;
+            case CmdVertexAttribPointer:
+                backend->vertexAttribPointer(cmd.args[0].u, cmd.args[1].i, cmd.args[2].u, (GLboolean)cmd.args[3].u, cmd.args[4].i, cmd.ptr);
+                break;
+            case CmdVertexAttrib1f:
+                backend->vertexAttrib1f(cmd.args[0].u, cmd.args[1].f);
+                break;
+            case CmdVertexAttrib2f:
+                backend->vertexAttrib2f(cmd.args[0].u, cmd.args[1].f, cmd.args[2].f);
+                break;
+            case CmdVertexAttrib3f:
+                backend->vertexAttrib3f(cmd.args[0].u, cmd.args[1].f, cmd.args[2].f, cmd.args[3].f);
+                break;
+            case CmdVertexAttrib4f:
+                backend->vertexAttrib4f(cmd.args[0].u, cmd.args[1].f, cmd.args[2].f, cmd.args[3].f, cmd.args[4].f);
+                break;
+            case CmdDeleteTextures:
+                backend->deleteTextures(cmd.args[0].i, (const GLuint *)(data + cmd.args[1].u));
+                break;
+            case CmdActiveTexture:
+                backend->activeTexture(cmd.args[0].u);
+                break;
+            case CmdBindTexture:
+                backend->bindTexture(cmd.args[0].u, cmd.args[1].u);
+                break;
+            case CmdTexParameteri:
+                backend->texParameteri(cmd.args[0].u, cmd.args[1].u, cmd.args[2].i);
+                break;
+            case CmdTexImage2D:
+                backend->texImage2D(cmd.args[0].u, cmd.args[1].i, cmd.args[2].i, cmd.args[3].i, cmd.args[4].i, 0, cmd.args[5].u, cmd.args[6].u, cmd.ptr ? data + cmd.args[7].u : NULL);
+                break;
+            case CmdTexSubImage2D:
+                backend->texSubImage2D(cmd.args[0].u, cmd.args[1].i, cmd.args[2].i, cmd.args[3].i, cmd.args[4].i, cmd.args[5].i, cmd.args[6].u, cmd.args[7].u, data + (GLuint)(size_t)cmd.ptr);
+                break;
+            case CmdCompressedTexImage2D:
+                backend->compressedTexImage2D(cmd.args[0].u, cmd.args[1].i, cmd.args[2].u, cmd.args[3].i, cmd.args[4].i, 0, cmd.args[5].i, cmd.ptr ? data + cmd.args[6].u : NULL);
+                break;
+            case CmdCompressedTexSubImage2D:
+                backend->compressedTexSubImage2D(cmd.args[0].u, cmd.args[1].i, cmd.args[2].i, cmd.args[3].i, cmd.args[4].i, cmd.args[5].i, cmd.args[6].u, cmd.args[7].i, data + (GLuint)(size_t)cmd.ptr);
+                break;
+            case CmdCopyTexSubImage2D:
+                backend->copyTexSubImage2D(cmd.args[0].u, cmd.args[1].i, cmd.args[2].i, cmd.args[3].i, cmd.args[4].i, cmd.args[5].i, cmd.args[6].i, cmd.args[7].i);
+                break;
+            case CmdGenerateMipmap:
+                backend->generateMipmap(cmd.args[0].u);
+                break;
+            case CmdDeleteShader:
+                backend->deleteShader(cmd.args[0].u);
+                break;
+            case CmdDeleteProgram:
+                backend->deleteProgram(cmd.args[0].u);
+                break;
+            case CmdUseProgram:
+                backend->useProgram(cmd.args[0].u);
+                break;
+            case CmdUniform1i:
+                backend->uniform1i(cmd.args[0].i, cmd.args[1].i);
+                break;
+            case CmdUniform1f:
+                backend->uniform1f(cmd.args[0].i, cmd.args[1].f);
+                break;
+            case CmdUniform2f:
+                backend->uniform2f(cmd.args[0].i, cmd.args[1].f, cmd.args[2].f);
+                break;
+            case CmdUniform3f:
+                backend->uniform3f(cmd.args[0].i, cmd.args[1].f, cmd.args[2].f, cmd.args[3].f);
+                break;
+            case CmdUniform4f:
+                backend->uniform4f(cmd.args[0].i, cmd.args[1].f, cmd.args[2].f, cmd.args[3].f, cmd.args[4].f);
+                break;
+            case CmdUniformMatrix4fv:
+                backend->uniformMatrix4fv(cmd.args[0].i, cmd.args[1].i, (GLboolean)cmd.args[2].u, (const GLfloat *)(data + cmd.args[3].u));
+                break;
+            case CmdEnable:
+                backend->enable(cmd.args[0].u);
+                break;
+            case CmdDisable:
+                backend->disable(cmd.args[0].u);
+                break;
+            case CmdDepthMask:
+                backend->depthMask((GLboolean)cmd.args[0].u);
+                break;
+            case CmdDepthFunc:
+                backend->depthFunc(cmd.args[0].u);
+                break;
+            case CmdBlendFunc:
+                backend->blendFunc(cmd.args[0].u, cmd.args[1].u);
+                break;
+            case CmdLineWidth:
+                backend->lineWidth(cmd.args[0].f);
+                break;
+            case CmdViewport:
+                backend->viewport(cmd.args[0].i, cmd.args[1].i, cmd.args[2].i, cmd.args[3].i);
+                break;
+            case CmdClearColor:
+                backend->clearColor(cmd.args[0].f, cmd.args[1].f, cmd.args[2].f, cmd.args[3].f);
+                break;
+            case CmdClear:
+                backend->clear(cmd.args[0].u);
+                break;
+            case CmdDeleteFramebuffers:
+                backend->deleteFramebuffers(cmd.args[0].i, (const GLuint *)(data + cmd.args[1].u));
+                break;
+            case CmdBindFramebuffer:
+                backend->bindFramebuffer(cmd.args[0].u, cmd.args[1].u);
+                break;
+            case CmdFramebufferRenderbuffer:
+                backend->framebufferRenderbuffer(cmd.args[0].u, cmd.args[1].u, cmd.args[2].u, cmd.args[3].u);
+                break;
+            case CmdFramebufferTexture2D:
+                backend->framebufferTexture2D(cmd.args[0].u, cmd.args[1].u, cmd.args[2].u, cmd.args[3].u, cmd.args[4].i);
+                break;
+            case CmdDeleteRenderbuffers:
+                backend->deleteRenderbuffers(cmd.args[0].i, (const GLuint *)(data + cmd.args[1].u));
+                break;
+            case CmdBindRenderbuffer:
+                backend->bindRenderbuffer(cmd.args[0].u, cmd.args[1].u);
+                break;
+            case CmdRenderbufferStorage:
+                backend->renderbufferStorage(cmd.args[0].u, cmd.args[1].u, cmd.args[2].i, cmd.args[3].i);
+                break;
+            case CmdDiscardFramebuffer:
+                backend->discardFramebuffer(cmd.args[0].u, cmd.args[1].i, (const GLenum *)(data + cmd.args[2].u));
+                break;
+            case CmdDrawArrays:
+                backend->drawArrays(cmd.args[0].u, cmd.args[1].i, cmd.args[2].i);
+                break;
+            case CmdDrawElements:
+                // Indices in client memory were copied, otherwise it's an offset into the bound buffer
+                backend->drawElements(cmd.args[0].u, cmd.args[1].i, cmd.args[2].u, cmd.args[3].u ? data + cmd.args[4].u : cmd.ptr);
+                break;
+            case CmdFlush:
+                backend->flush();
+                break;
+            case CmdFinish:
+                backend->finish();
+                break;
+        }
+    }
+}
+    
+void GLCommandList::genBuffers(GLsizei n,GLuint *buffers)
+{
+    takeNames(bufferNames, n, buffers);
+}
+    
+void GLCommandList::deleteBuffers(GLsizei n,const GLuint *buffers)
+{
+    Command &cmd = add(CmdDeleteBuffers);
+    cmd.args[0].i = n;
+    cmd.args[1].u = addPayload(buffers, n*sizeof(GLuint));
+    for (GLsizei ii=0;ii<n;ii++)
+        if (elementBuffer == buffers[ii])
+            elementBuffer = 0;
+}
+    
+void GLCommandList::bindBuffer(GLenum target,GLuint buffer)
+{
+    Command &cmd = add(CmdBindBuffer);
+    cmd.args[0].u = target;
+    cmd.args[1].u = buffer;
+    // The element buffer binding is part of the vertex array object
+    if (target == GL_ELEMENT_ARRAY_BUFFER && vertexArray == 0)
+        elementBuffer = buffer;
+}
+    
+void GLCommandList::bufferData(GLenum target,GLsizeiptr size,const GLvoid *data,GLenum usage)
+{
+    Command &cmd = add(CmdBufferData);
+    cmd.args[0].u = target;
+    cmd.args[1].i = (GLint)size;
+    cmd.args[3].u = usage;
+    if (data)
+    {
+        cmd.args[2].u = addPayload(data, size);
+        // Just a flag to say there's data
+        cmd.ptr = data;
+    }
+}
+    
+void GLCommandList::bufferSubData(GLenum target,GLintptr offset,GLsizeiptr size,const GLvoid *data)
+{
+    Command &cmd = add(CmdBufferSubData);
+    cmd.args[0].u = target;
+    cmd.args[1].i = (GLint)offset;
+    cmd.args[2].i = (GLint)size;
+    cmd.args[3].u = addPayload(data, size);
+}
+    
+GLvoid *GLCommandList::mapBuffer(GLenum target,GLenum access)
+{
+    // Callers expect to write into this right away
+    numDropped++;
+    return NULL;
+}
+    
+GLboolean GLCommandList::unmapBuffer(GLenum target)
+{
+    numDropped++;
+    return GL_FALSE;
+}
+    
+void GLCommandList::genVertexArrays(GLsizei n,GLuint *arrays)
+{
+    takeNames(vertexArrayNames, n, arrays);
+}
+    
+void GLCommandList::deleteVertexArrays(GLsizei n,const GLuint *arrays)
+{
+    Command &cmd = add(CmdDeleteVertexArrays);
+    cmd.args[0].i = n;
+    cmd.args[1].u = addPayload(arrays, n*sizeof(GLuint));
+    for (GLsizei ii=0;ii<n;ii++)
+        if (vertexArray == arrays[ii])
+            vertexArray = 0;
+}
+    
+void GLCommandList::bindVertexArray(GLuint array)
+{
+    Command &cmd = add(CmdBindVertexArray);
+    cmd.args[0].u = array;
+    vertexArray = array;
+}
+    
+void GLCommandList::enableVertexAttribArray(GLuint index)
+{
+    add(CmdEnableVertexAttribArray).args[0].u = index;
+}
+    
+void GLCommandList::disableVertexAttribArray(GLuint index)
+{
+    add(CmdDisableVertexAttribArray).args[0].u = index;
+}
+    
+void GLCommandList::vertexAttribPointer(GLuint index,GLint size,GLenum type,GLboolean normalized,GLsizei stride,const GLvoid *ptr)
+{
+    Command &cmd = add(CmdVertexAttribPointer);
+    cmd.args[0].u = index;
+    cmd.args[1].i = size;
+    cmd.args[2].u = type;
+    cmd.args[3].u = normalized;
+    cmd.args[4].i = stride;
+    cmd.ptr = ptr;
+}
+    
+void GLCommandList::vertexAttrib1f(GLuint index,GLfloat x)
+{
+    Command &cmd = add(CmdVertexAttrib1f);
+    cmd.args[0].u = index;
+    cmd.args[1].f = x;
+}
+    
+void GLCommandList::vertexAttrib2f(GLuint index,GLfloat x,GLfloat y)
+{
+    Command &cmd = add(CmdVertexAttrib2f);
+    cmd.args[0].u = index;
+    cmd.args[1].f = x;  cmd.args[2].f = y;
+}
+    
+void GLCommandList::vertexAttrib3f(GLuint index,GLfloat x,GLfloat y,GLfloat z)
+{
+    Command &cmd = add(CmdVertexAttrib3f);
+    cmd.args[0].u = index;
+    cmd.args[1].f = x;  cmd.args[2].f = y;  cmd.args[3].f = z;
+}
+    
+void GLCommandList::vertexAttrib4f(GLuint index,GLfloat x,GLfloat y,GLfloat z,GLfloat w)
+{
+    Command &cmd = add(CmdVertexAttrib4f);
+    cmd.args[0].u = index;
+    cmd.args[1].f = x;  cmd.args[2].f = y;  cmd.args[3].f = z;  cmd.args[4].f = w;
+}
+    
+void GLCommandList::genTextures(GLsizei n,GLuint *textures)
+{
+    takeNames(textureNames, n, textures);
+}
+    
+void GLCommandList::deleteTextures(GLsizei n,const GLuint *textures)
+{
+    Command &cmd = add(CmdDeleteTextures);
+    cmd.args[0].i = n;
+    cmd.args[1].u = addPayload(textures, n*sizeof(GLuint));
+}
+    
+void GLCommandList::activeTexture(GLenum texture)
+{
+    add(CmdActiveTexture).args[0].u = texture;
+}
+    
+void GLCommandList::bindTexture(GLenum target,GLuint texture)
+{
+    Command &cmd = add(CmdBindTexture);
+    cmd.args[0].u = target;
+    cmd.args[1].u = texture;
+}
+    
+void GLCommandList::texParameteri(GLenum target,GLenum pname,GLint param)
+{
+    Command &cmd = add(CmdTexParameteri);
+    cmd.args[0].u = target;
+    cmd.args[1].u = pname;
+    cmd.args[2].i = param;
+}
+    
+void GLCommandList::texImage2D(GLenum target,GLint level,GLint internalformat,GLsizei width,GLsizei height,GLint border,GLenum format,GLenum type,const GLvoid *pixels)
+{
+    Command &cmd = add(CmdTexImage2D);
+    cmd.args[0].u = target;
+    cmd.args[1].i = level;
+    cmd.args[2].i = internalformat;
+    cmd.args[3].i = width;
+    cmd.args[4].i = height;
+    cmd.args[5].u = format;
+    cmd.args[6].u = type;
+    if (pixels)
+    {
+        cmd.args[7].u = addPayload(pixels, TextureDataSize(width, height, format, type));
+        cmd.ptr = pixels;
+    }
+}
+    
+void GLCommandList::texSubImage2D(GLenum target,GLint level,GLint xoffset,GLint yoffset,GLsizei width,GLsizei height,GLenum format,GLenum type,const GLvoid *pixels)
+{
+    Command &cmd = add(CmdTexSubImage2D);
+    cmd.args[0].u = target;
+    cmd.args[1].i = level;
+    cmd.args[2].i = xoffset;
+    cmd.args[3].i = yoffset;
+    cmd.args[4].i = width;
+    cmd.args[5].i = height;
+    cmd.args[6].u = format;
+    cmd.args[7].u = type;
+    // Out of arguments, so the payload offset goes in the pointer
+    cmd.ptr = (const GLvoid *)(size_t)addPayload(pixels, TextureDataSize(width, height, format, type));
+}
+    
+void GLCommandList::compressedTexImage2D(GLenum target,GLint level,GLenum internalformat,GLsizei width,GLsizei height,GLint border,GLsizei imageSize,const GLvoid *data)
+{
+    Command &cmd = add(CmdCompressedTexImage2D);
+    cmd.args[0].u = target;
+    cmd.args[1].i = level;
+    cmd.args[2].u = internalformat;
+    cmd.args[3].i = width;
+    cmd.args[4].i = height;
+    cmd.args[5].i = imageSize;
+    if (data)
+    {
+        cmd.args[6].u = addPayload(data, imageSize);
+        cmd.ptr = data;
+    }
+}
+    
+void GLCommandList::compressedTexSubImage2D(GLenum target,GLint level,GLint xoffset,GLint yoffset,GLsizei width,GLsizei height,GLenum format,GLsizei imageSize,const GLvoid *data)
+{
+    Command &cmd = add(CmdCompressedTexSubImage2D);
+    cmd.args[0].u = target;
+    cmd.args[1].i = level;
+    cmd.args[2].i = xoffset;
+    cmd.args[3].i = yoffset;
+    cmd.args[4].i = width;
+    cmd.args[5].i = height;
+    cmd.args[6].u = format;
+    cmd.args[7].i = imageSize;
+    cmd.ptr = (const GLvoid *)(size_t)addPayload(data, imageSize);
+}
+    
+void GLCommandList::copyTexSubImage2D(GLenum target,GLint level,GLint xoffset,GLint yoffset,GLint x,GLint y,GLsizei width,GLsizei height)
+{
+    Command &cmd = add(CmdCopyTexSubImage2D);
+    cmd.args[0].u = target;
+    cmd.args[1].i = level;
+    cmd.args[2].i = xoffset;
+    cmd.args[3].i = yoffset;
+    cmd.args[4].i = x;
+    cmd.args[5].i = y;
+    cmd.args[6].i = width;
+    cmd.args[7].i = height;
+}
+    
+void GLCommandList::generateMipmap(GLenum target)
+{
+    add(CmdGenerateMipmap).args[0].u = target;
+}
+    
+// Shaders and programs have to be set up with a context
+
+GLuint GLCommandList::createShader(GLenum type)
+{
+    numDropped++;
+    return 0;
+}
+    
+void GLCommandList::shaderSource(GLuint shader,GLsizei count,const GLchar **string,const GLint *length)
+{
+    numDropped++;
+}
+    
+void GLCommandList::compileShader(GLuint shader)
+{
+    numDropped++;
+}
+    
+void GLCommandList::getShaderiv(GLuint shader,GLenum pname,GLint *params)
+{
+    numDropped++;
+    *params = 0;
+}
+    
+void GLCommandList::getShaderInfoLog(GLuint shader,GLsizei bufsize,GLsizei *length,GLchar *infolog)
+{
+    numDropped++;
+    if (length)
+        *length = 0;
+    if (bufsize > 0)
+        infolog[0] = 0;
+}
+    
+void GLCommandList::deleteShader(GLuint shader)
+{
+    add(CmdDeleteShader).args[0].u = shader;
+}
+    
+GLuint GLCommandList::createProgram()
+{
+    numDropped++;
+    return 0;
+}
+    
+void GLCommandList::attachShader(GLuint program,GLuint shader)
+{
+    numDropped++;
+}
+    
+void GLCommandList::linkProgram(GLuint program)
+{
+    numDropped++;
+}
+    
+void GLCommandList::validateProgram(GLuint program)
+{
+    numDropped++;
+}
+    
+void GLCommandList::getProgramiv(GLuint program,GLenum pname,GLint *params)
+{
+    numDropped++;
+    *params = 0;
+}
+    
+void GLCommandList::getProgramInfoLog(GLuint program,GLsizei bufsize,GLsizei *length,GLchar *infolog)
+{
+    numDropped++;
+    if (length)
+        *length = 0;
+    if (bufsize > 0)
+        infolog[0] = 0;
+}
+    
+void GLCommandList::deleteProgram(GLuint program)
+{
+    add(CmdDeleteProgram).args[0].u = program;
+}
+    
+void GLCommandList::useProgram(GLuint program)
+{
+    add(CmdUseProgram).args[0].u = program;
+}
+    
+void GLCommandList::getActiveUniform(GLuint program,GLuint index,GLsizei bufsize,GLsizei *length,GLint *size,GLenum *type,GLchar *name)
+{
+    numDropped++;
+    if (length)
+        *length = 0;
+    if (bufsize > 0)
+        name[0] = 0;
+    *size = 0;
+    *type = 0;
+}
+    
+void GLCommandList::getActiveAttrib(GLuint program,GLuint index,GLsizei bufsize,GLsizei *length,GLint *size,GLenum *type,GLchar *name)
+{
+    numDropped++;
+    if (length)
+        *length = 0;
+    if (bufsize > 0)
+        name[0] = 0;
+    *size = 0;
+    *type = 0;
+}
+    
+int GLCommandList::getUniformLocation(GLuint program,const GLchar *name)
+{
+    numDropped++;
+    return -1;
+}
+    
+int GLCommandList::getAttribLocation(GLuint program,const GLchar *name)
+{
+    numDropped++;
+    return -1;
+}
+    
+void GLCommandList::uniform1i(GLint location,GLint x)
+{
+    Command &cmd = add(CmdUniform1i);
+    cmd.args[0].i = location;
+    cmd.args[1].i = x;
+}
+    
+void GLCommandList::uniform1f(GLint location,GLfloat x)
+{
+    Command &cmd = add(CmdUniform1f);
+    cmd.args[0].i = location;
+    cmd.args[1].f = x;
+}
+    
+void GLCommandList::uniform2f(GLint location,GLfloat x,GLfloat y)
+{
+    Command &cmd = add(CmdUniform2f);
+    cmd.args[0].i = location;
+    cmd.args[1].f = x;  cmd.args[2].f = y;
+}
+    
+void GLCommandList::uniform3f(GLint location,GLfloat x,GLfloat y,GLfloat z)
+{
+    Command &cmd = add(CmdUniform3f);
+    cmd.args[0].i = location;
+    cmd.args[1].f = x;  cmd.args[2].f = y;  cmd.args[3].f = z;
+}
+    
+void GLCommandList::uniform4f(GLint location,GLfloat x,GLfloat y,GLfloat z,GLfloat w)
+{
+    Command &cmd = add(CmdUniform4f);
+    cmd.args[0].i = location;
+    cmd.args[1].f = x;  cmd.args[2].f = y;  cmd.args[3].f = z;  cmd.args[4].f = w;
+}
+    
+void GLCommandList::uniformMatrix4fv(GLint location,GLsizei count,GLboolean transpose,const GLfloat *value)
+{
+    Command &cmd = add(CmdUniformMatrix4fv);
+    cmd.args[0].i = location;
+    cmd.args[1].i = count;
+    cmd.args[2].u = transpose;
+    cmd.args[3].u = addPayload(value, 16*count*sizeof(GLfloat));
+}
+    
+void GLCommandList::enable(GLenum cap)
+{
+    add(CmdEnable).args[0].u = cap;
+}
+    
+void GLCommandList::disable(GLenum cap)
+{
+    add(CmdDisable).args[0].u = cap;
+}
+    
+void GLCommandList::depthMask(GLboolean flag)
+{
+    add(CmdDepthMask).args[0].u = flag;
+}
+    
+void GLCommandList::depthFunc(GLenum func)
+{
+    add(CmdDepthFunc).args[0].u = func;
+}
+    
+void GLCommandList::blendFunc(GLenum sfactor,GLenum dfactor)
+{
+    Command &cmd = add(CmdBlendFunc);
+    cmd.args[0].u = sfactor;
+    cmd.args[1].u = dfactor;
+}
+    
+void GLCommandList::lineWidth(GLfloat width)
+{
+    add(CmdLineWidth).args[0].f = width;
+}
+    
+void GLCommandList::viewport(GLint x,GLint y,GLsizei width,GLsizei height)
+{
+    Command &cmd = add(CmdViewport);
+    cmd.args[0].i = x;  cmd.args[1].i = y;
+    cmd.args[2].i = width;  cmd.args[3].i = height;
+}
+    
+void GLCommandList::clearColor(GLclampf red,GLclampf green,GLclampf blue,GLclampf alpha)
+{
+    Command &cmd = add(CmdClearColor);
+    cmd.args[0].f = red;  cmd.args[1].f = green;  cmd.args[2].f = blue;  cmd.args[3].f = alpha;
+}
+    
+void GLCommandList::clear(GLbitfield mask)
+{
+    add(CmdClear).args[0].u = mask;
+}
+    
+void GLCommandList::genFramebuffers(GLsizei n,GLuint *framebuffers)
+{
+    // We don't keep a reserve of these, nobody makes them while drawing
+    numDropped++;
+    for (GLsizei ii=0;ii<n;ii++)
+        framebuffers[ii] = 0;
+}
+    
+void GLCommandList::deleteFramebuffers(GLsizei n,const GLuint *framebuffers)
+{
+    Command &cmd = add(CmdDeleteFramebuffers);
+    cmd.args[0].i = n;
+    cmd.args[1].u = addPayload(framebuffers, n*sizeof(GLuint));
+}
+    
+void GLCommandList::bindFramebuffer(GLenum target,GLuint framebuffer)
+{
+    Command &cmd = add(CmdBindFramebuffer);
+    cmd.args[0].u = target;
+    cmd.args[1].u = framebuffer;
+}
+    
+void GLCommandList::framebufferRenderbuffer(GLenum target,GLenum attachment,GLenum renderbuffertarget,GLuint renderbuffer)
+{
+    Command &cmd = add(CmdFramebufferRenderbuffer);
+    cmd.args[0].u = target;
+    cmd.args[1].u = attachment;
+    cmd.args[2].u = renderbuffertarget;
+    cmd.args[3].u = renderbuffer;
+}
+    
+void GLCommandList::framebufferTexture2D(GLenum target,GLenum attachment,GLenum textarget,GLuint texture,GLint level)
+{
+    Command &cmd = add(CmdFramebufferTexture2D);
+    cmd.args[0].u = target;
+    cmd.args[1].u = attachment;
+    cmd.args[2].u = textarget;
+    cmd.args[3].u = texture;
+    cmd.args[4].i = level;
+}
+    
+GLenum GLCommandList::checkFramebufferStatus(GLenum target)
+{
+    numDropped++;
+    return 0;
+}
+    
+void GLCommandList::genRenderbuffers(GLsizei n,GLuint *renderbuffers)
+{
+    numDropped++;
+    for (GLsizei ii=0;ii<n;ii++)
+        renderbuffers[ii] = 0;
+}
+    
+void GLCommandList::deleteRenderbuffers(GLsizei n,const GLuint *renderbuffers)
+{
+    Command &cmd = add(CmdDeleteRenderbuffers);
+    cmd.args[0].i = n;
+    cmd.args[1].u = addPayload(renderbuffers, n*sizeof(GLuint));
+}
+    
+void GLCommandList::bindRenderbuffer(GLenum target,GLuint renderbuffer)
+{
+    Command &cmd = add(CmdBindRenderbuffer);
+    cmd.args[0].u = target;
+    cmd.args[1].u = renderbuffer;
+}
+    
+void GLCommandList::renderbufferStorage(GLenum target,GLenum internalformat,GLsizei width,GLsizei height)
+{
+    Command &cmd = add(CmdRenderbufferStorage);
+    cmd.args[0].u = target;
+    cmd.args[1].u = internalformat;
+    cmd.args[2].i = width;
+    cmd.args[3].i = height;
+}
+    
+void GLCommandList::getRenderbufferParameteriv(GLenum target,GLenum pname,GLint *params)
+{
+    numDropped++;
+    *params = 0;
+}
+    
+void GLCommandList::discardFramebuffer(GLenum target,GLsizei numAttachments,const GLenum *attachments)
+{
+    Command &cmd = add(CmdDiscardFramebuffer);
+    cmd.args[0].u = target;
+    cmd.args[1].i = numAttachments;
+    cmd.args[2].u = addPayload(attachments, numAttachments*sizeof(GLenum));
+}
+    
+void GLCommandList::drawArrays(GLenum mode,GLint first,GLsizei count)
+{
+    Command &cmd = add(CmdDrawArrays);
+    cmd.args[0].u = mode;
+    cmd.args[1].i = first;
+    cmd.args[2].i = count;
+}
+    
+void GLCommandList::drawElements(GLenum mode,GLsizei count,GLenum type,const GLvoid *indices)
+{
+    Command &cmd = add(CmdDrawElements);
+    cmd.args[0].u = mode;
+    cmd.args[1].i = count;
+    cmd.args[2].u = type;
+    // With no element buffer the indices are in client memory, which may be temporary
+    if (vertexArray == 0 && elementBuffer == 0)
+    {
+        cmd.args[3].u = 1;
+        cmd.args[4].u = addPayload(indices, IndexDataSize(count, type));
+    } else {
+        cmd.args[3].u = 0;
+        cmd.ptr = indices;
+    }
+}
+    
+void GLCommandList::flush()
+{
+    add(CmdFlush);
+}
+    
+void GLCommandList::finish()
+{
+    add(CmdFinish);
+}
+    
+GLenum GLCommandList::getError()
+{
+    // Errors show up when we replay
+    return GL_NO_ERROR;
+}
+    
+void GLCommandList::getIntegerv(GLenum pname,GLint *params)
+{
+    numDropped++;
+    *params = 0;
+}
+    
+const GLubyte *GLCommandList::getString(GLenum name)
+{
+    numDropped++;
+    return NULL;
+}
+    
+}
@@ -0,0 +1,194 @@
+/*
+ *  GLStateOptimizer.mm
+ *  WhirlyGlobeLib
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import "GLStateOptimizer.h"
+
+namespace WhirlyKit
+{
+
+const int OpenGLStateOptimizer::MaxTrackedTextureUnits;
+
+OpenGLStateOptimizer::OpenGLStateOptimizer()
+{
+    reset();
+}
+
+void OpenGLStateOptimizer::reset()
+{
+    activeTexture = -1;
+    depthMask = 0;
+    depthTest = -1;
+    progId = -1;
+    lineWidth = -1.0;
+    depthFunc = -1;
+    blend = -1;
+    blendSrc = -1;
+    blendDst = -1;
+    resetBindings();
+}
+
+void OpenGLStateOptimizer::resetBindings()
+{
+    progId = -1;
+    for (unsigned int ii=0;ii<MaxTrackedTextureUnits;ii++)
+        boundTextures[ii] = -1;
+    vertArrayObj = -1;
+    arrayBuffer = -1;
+    elementArrayBuffer = -1;
+}
+
+void OpenGLStateOptimizer::beginFrame()
+{
+    resetBindings();
+}
+
+void OpenGLStateOptimizer::endFrame()
+{
+    setVertexArray(0);
+}
+
+void OpenGLStateOptimizer::setActiveTexture(GLenum newActiveTexture)
+{
+    if ((int)newActiveTexture != activeTexture)
+    {
+        GetGLBackend()->activeTexture(newActiveTexture);
+        activeTexture = newActiveTexture;
+    }
+}
+
+void OpenGLStateOptimizer::setDepthMask(bool newDepthMask)
+{
+    if (depthMask == -1 || (bool)depthMask != newDepthMask)
+    {
+        GetGLBackend()->depthMask(newDepthMask);
+        depthMask = newDepthMask;
+    }
+}
+
+void OpenGLStateOptimizer::setEnableDepthTest(bool newEnable)
+{
+    if (depthTest == -1 || (bool)depthTest != newEnable)
+    {
+        if (newEnable)
+            GetGLBackend()->enable(GL_DEPTH_TEST);
+        else
+            GetGLBackend()->disable(GL_DEPTH_TEST);
+        depthTest = newEnable;
+    }
+}
+
+void OpenGLStateOptimizer::setDepthFunc(GLenum newDepthFunc)
+{
+    if (depthFunc == -1 || (int)newDepthFunc != depthFunc)
+    {
+        GetGLBackend()->depthFunc(newDepthFunc);
+        depthFunc = newDepthFunc;
+    }
+}
+
+void OpenGLStateOptimizer::setUseProgram(GLuint newProgId)
+{
+    if (progId != (int)newProgId)
+    {
+        GetGLBackend()->useProgram(newProgId);
+        progId = newProgId;
+    }
+}
+
+void OpenGLStateOptimizer::setLineWidth(GLfloat newLineWidth)
+{
+    if (lineWidth != newLineWidth || lineWidth == -1.0)
+    {
+        if (newLineWidth > 0.0)
+        {
+            GetGLBackend()->lineWidth(newLineWidth);
+            lineWidth = newLineWidth;
+        }
+    }
+}
+
+void OpenGLStateOptimizer::setBoundTexture(GLuint texId)
+{
+    // Don't know which unit we're on, or it's one we don't track
+    int unit = activeTexture - GL_TEXTURE0;
+    if (activeTexture == -1 || unit < 0 || unit >= MaxTrackedTextureUnits)
+    {
+        GetGLBackend()->bindTexture(GL_TEXTURE_2D, texId);
+        return;
+    }
+
+    if (boundTextures[unit] != (int)texId)
+    {
+        GetGLBackend()->bindTexture(GL_TEXTURE_2D, texId);
+        boundTextures[unit] = texId;
+    }
+}
+
+void OpenGLStateOptimizer::setVertexArray(GLuint newVertArrayObj)
+{
+    if (vertArrayObj != (int)newVertArrayObj)
+    {
+        GetGLBackend()->bindVertexArray(newVertArrayObj);
+        vertArrayObj = newVertArrayObj;
+        elementArrayBuffer = -1;
+    }
+}
+
+void OpenGLStateOptimizer::setArrayBuffer(GLuint bufferId)
+{
+    if (arrayBuffer != (int)bufferId)
+    {
+        GetGLBackend()->bindBuffer(GL_ARRAY_BUFFER, bufferId);
+        arrayBuffer = bufferId;
+    }
+}
+
+void OpenGLStateOptimizer::setElementArrayBuffer(GLuint bufferId)
+{
+    if (elementArrayBuffer != (int)bufferId)
+    {
+        GetGLBackend()->bindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufferId);
+        elementArrayBuffer = bufferId;
+    }
+}
+
+void OpenGLStateOptimizer::setEnableBlend(bool newEnable)
+{
+    if (blend == -1 || (bool)blend != newEnable)
+    {
+        if (newEnable)
+            GetGLBackend()->enable(GL_BLEND);
+        else
+            GetGLBackend()->disable(GL_BLEND);
+        blend = newEnable;
+    }
+}
+
+void OpenGLStateOptimizer::setBlendFunc(GLenum srcFactor,GLenum dstFactor)
+{
+    if (blendSrc != (int)srcFactor || blendDst != (int)dstFactor)
+    {
+        GetGLBackend()->blendFunc(srcFactor, dstFactor);
+        blendSrc = srcFactor;
+        blendDst = dstFactor;
+    }
+}
+
+}
@@ -30,7 +30,7 @@ bool CheckGLError(const char *msg)
 {
     if (!ErrorsOn)
         return true;
-    GLenum theError = glGetError();
+    GLenum theError = WhirlyKit::GetGLBackend()->getError();
     if (theError != GL_NO_ERROR)
     {
         NSLog(@"GL Error: %d - %s",theError,msg);
@@ -283,6 +283,14 @@ Point3d GeocentricDisplayAdapter::normalForLocal(Point3d pt)
     return LocalToDisplay(pt);
 }
     
+bool GeocentricDisplayAdapter::getEllipsoidRadii(Point3d &radii)
+{
+    // WGS84 semi-major and semi-minor axes
+    radii = Point3d(6378137.0/EarthRadius,6378137.0/EarthRadius,6356752.314245/EarthRadius);
+    
+    return true;
+}
+    
 float CheckPointAndNormFacing(const Point3f &dispLoc,const Point3f &norm,const Matrix4f &viewAndModelMat,const Matrix4f &viewModelNormalMat)
 {
     Vector4f pt = viewAndModelMat * Vector4f(dispLoc.x(),dispLoc.y(),dispLoc.z(),1.0);
@@ -291,4 +299,33 @@ float CheckPointAndNormFacing(const Point3f &dispLoc,const Point3f &norm,const M
     return Vector3f(-pt.x(),-pt.y(),-pt.z()).dot(Vector3f(testDir.x(),testDir.y(),testDir.z()));
 }
     
+bool CalcHorizonCullPoint(const Point3d &dir,double maxAngle,double maxRadius,Point3d &cullPt)
+{
+    // A point on the patch is hidden if the line to the eye dips into the sphere.
+    // Something at radius r can see up to acos(1/r) past the tangent point,
+    //  so the worst case is the far edge of the patch at the highest point.
+    double beta = acos(1.0/std::max(maxRadius,1.0));
+    double total = maxAngle + beta;
+    if (total >= M_PI/2.0)
+        return false;
+    
+    cullPt = dir.normalized() / cos(total);
+    
+    return true;
+}
+    
+bool IsBelowHorizon(const Point3d &eyePt,const Point3d &pt)
+{
+    // Eye to the tangent point, squared.  If we're inside, nothing is hidden.
+    double vhMag2 = eyePt.squaredNorm() - 1.0;
+    if (vhMag2 <= 0.0)
+        return false;
+    
+    Point3d vt = pt - eyePt;
+    double vtDotVc = -vt.dot(eyePt);
+    
+    // Farther than the horizon and inside the cone the sphere shadows
+    return vtDotVc > vhMag2 && vtDotVc * vtDotVc / vt.squaredNorm() > vhMag2;
+}
+    
 }
@@ -40,7 +40,7 @@ GlobeScene::~GlobeScene()
     
 void GlobeScene::addDrawable(DrawableRef draw)
 {
-    drawables.insert(draw);
+    drawables.insert(draw->getId(),draw);
 
     // Account for the geo coordinate wrapping
     Mbr localMbr = draw->getLocalMbr();
@@ -51,22 +51,17 @@ void GlobeScene::addDrawable(DrawableRef draw)
         geoMbr.splitIntoMbrs(localMbrs);
         
         for (unsigned int ii=0;ii<localMbrs.size();ii++)
-            cullTree->getTopCullable()->addDrawable(cullTree,localMbrs[ii],draw);
+            cullTree->addDrawable(localMbrs[ii],draw);
     } else
-        cullTree->getTopCullable()->addDrawable(cullTree, localMbr, draw);
+        cullTree->addDrawable(localMbr, draw);
 }
 
 void GlobeScene::remDrawable(DrawableRef draw)
 {
-    Mbr localMbr = draw->getLocalMbr();
-    GeoMbr geoMbr(GeoCoord(localMbr.ll().x(),localMbr.ll().y()),GeoCoord(localMbr.ur().x(),localMbr.ur().y()));
-    std::vector<Mbr> localMbrs;
-    geoMbr.splitIntoMbrs(localMbrs);
-    
-    for (unsigned int ii=0;ii<localMbrs.size();ii++)
-        cullTree->getTopCullable()->remDrawable(cullTree,localMbrs[ii],draw);
+    // Takes out all the pieces
+    cullTree->remDrawable(draw);
 
-    drawables.erase(draw);
+    drawables.erase(draw->getId());
 }
 
 }
@@ -18,21 +18,69 @@
  *
  */
 
+#import <pthread.h>
 #import "Identifiable.h"
 
 namespace WhirlyKit
 {
-	
-static unsigned long curId = 0;
+    
+// IDs are leased to each thread in blocks of this size.
+// Most of the time making an ID is just an increment on the thread's own block.
+static const SimpleIdentity IDBlockSize = 1024;
+
+// Start of the next block nobody has leased.  0 is EmptyIdentity, so we skip it.
+static volatile SimpleIdentity nextBlockStart = 1;
+
+// A thread's current block of IDs
+class IDBlock
+{
+public:
+    IDBlock() : next(0), end(0) { }
+    SimpleIdentity next,end;
+};
+
+static pthread_key_t idBlockKey;
+static pthread_once_t idBlockOnce = PTHREAD_ONCE_INIT;
+
+// Whatever's left in a block goes unused when its thread exits
+static void IDBlockDestroy(void *block)
+{
+    delete (IDBlock *)block;
+}
+
+static void IDBlockKeyInit()
+{
+    pthread_key_create(&idBlockKey,IDBlockDestroy);
+}
+
+// Hand out the next ID from this thread's block, leasing a new one if it's used up
+static SimpleIdentity NextIdentity()
+{
+    pthread_once(&idBlockOnce,IDBlockKeyInit);
+    IDBlock *block = (IDBlock *)pthread_getspecific(idBlockKey);
+    if (!block)
+    {
+        block = new IDBlock();
+        pthread_setspecific(idBlockKey,block);
+    }
+    
+    if (block->next == block->end)
+    {
+        block->next = __sync_fetch_and_add(&nextBlockStart,IDBlockSize);
+        block->end = block->next + IDBlockSize;
+    }
+    
+    return block->next++;
+}
 
 Identifiable::Identifiable()
 { 
-	myId = ++curId; 
+	myId = NextIdentity();
 }
 	
 SimpleIdentity Identifiable::genId()
 {
-	return ++curId;
+	return NextIdentity();
 }
 
 }
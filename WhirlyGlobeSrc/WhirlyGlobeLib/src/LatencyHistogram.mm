@@ -0,0 +1,410 @@
+/*
+ *  LatencyHistogram.mm
+ *  WhirlyGlobeLib
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <mach/mach_time.h>
+#import <math.h>
+#import <string.h>
+#import <algorithm>
+#import "LatencyHistogram.h"
+
+namespace WhirlyKit
+{
+
+// Each power of two range is split into 64 buckets (the bottom one gets 128),
+//  which keeps us within 1/64 of the real value.
+static const int SubBucketHalfCountMagnitude = 6;
+static const int SubBucketHalfCount = 1 << SubBucketHalfCountMagnitude;
+static const uint64_t SubBucketMask = (SubBucketHalfCount << 1) - 1;
+// Enough power of two ranges to get us out to MaxValue
+static const int NumBuckets = 32 - SubBucketHalfCountMagnitude;
+static const int NumCounts = (NumBuckets + 1) * SubBucketHalfCount;
+
+const uint64_t LatencyHistogram::MaxValue;
+
+LatencyHistogram::LatencyHistogram()
+    : counts(NumCounts,0), totalCount(0), minValue(0), maxValue(0), total(0.0)
+{
+}
+    
+int LatencyHistogram::countsIndex(uint64_t value)
+{
+    int bucketIndex = 63 - __builtin_clzll(value | SubBucketMask) - SubBucketHalfCountMagnitude;
+    int subBucketIndex = (int)(value >> bucketIndex);
+    return ((bucketIndex + 1) << SubBucketHalfCountMagnitude) + subBucketIndex - SubBucketHalfCount;
+}
+    
+uint64_t LatencyHistogram::highestEquivalentValue(int index)
+{
+    int bucketIndex = (index >> SubBucketHalfCountMagnitude) - 1;
+    int subBucketIndex = (index & (SubBucketHalfCount - 1)) + SubBucketHalfCount;
+    if (bucketIndex < 0)
+    {
+        subBucketIndex -= SubBucketHalfCount;
+        bucketIndex = 0;
+    }
+    return ((uint64_t)subBucketIndex << bucketIndex) + ((uint64_t)1 << bucketIndex) - 1;
+}
+    
+void LatencyHistogram::record(uint64_t micros)
+{
+    if (micros > MaxValue)
+        micros = MaxValue;
+    counts[countsIndex(micros)]++;
+    if (totalCount == 0 || micros < minValue)
+        minValue = micros;
+    if (micros > maxValue)
+        maxValue = micros;
+    totalCount++;
+    total += micros;
+}
+    
+void LatencyHistogram::merge(const LatencyHistogram &that)
+{
+    if (that.totalCount == 0)
+        return;
+    for (int ii=0;ii<NumCounts;ii++)
+        counts[ii] += that.counts[ii];
+    if (totalCount == 0 || that.minValue < minValue)
+        minValue = that.minValue;
+    if (that.maxValue > maxValue)
+        maxValue = that.maxValue;
+    totalCount += that.totalCount;
+    total += that.total;
+}
+    
+void LatencyHistogram::clear()
+{
+    if (totalCount == 0)
+        return;
+    std::fill(counts.begin(),counts.end(),0);
+    totalCount = 0;
+    minValue = maxValue = 0;
+    total = 0.0;
+}
+    
+double LatencyHistogram::getMean() const
+{
+    return totalCount ? total / totalCount : 0.0;
+}
+    
+uint64_t LatencyHistogram::valueAtPercentile(double percentile) const
+{
+    if (totalCount == 0)
+        return 0;
+    
+    percentile = std::min(std::max(percentile,0.0),100.0);
+    uint64_t target = (uint64_t)ceil(percentile / 100.0 * totalCount);
+    if (target < 1)
+        target = 1;
+    
+    uint64_t soFar = 0;
+    for (int ii=0;ii<NumCounts;ii++)
+    {
+        soFar += counts[ii];
+        if (soFar >= target)
+            return std::min(highestEquivalentValue(ii),maxValue);
+    }
+    
+    return maxValue;
+}
+    
+// Metrics we can keep track of
+static const int MaxLatencyMetrics = 64;
+
+// Metric names by ID.  Filled in as the metrics are constructed.
+static const char *LatencyMetricNames[MaxLatencyMetrics];
+static volatile int NumLatencyMetrics = 0;
+
+LatencyMetric::LatencyMetric(const char *inName)
+    : name(inName)
+{
+    metricId = __sync_fetch_and_add(&NumLatencyMetrics, 1);
+    // Everything past the end of the table shares the last slot
+    if (metricId >= MaxLatencyMetrics)
+    {
+        metricId = MaxLatencyMetrics-1;
+        LatencyMetricNames[metricId] = "Other";
+    } else
+        LatencyMetricNames[metricId] = name;
+}
+    
+/// Histograms for one thread.  Only contended when we're taking a snapshot.
+class LatencyMetrics::ThreadHistograms
+{
+public:
+    ThreadHistograms()
+        : retired(false)
+    {
+        pthread_mutex_init(&lock, NULL);
+        memset(hists, 0, sizeof(hists));
+    }
+    
+    pthread_mutex_t lock;
+    // Allocated as the thread records them
+    LatencyHistogram *hists[MaxLatencyMetrics];
+    // Its thread exited, so another can have it
+    bool retired;
+};
+
+volatile bool LatencyMetrics::enabled = true;
+static pthread_key_t ThreadHistogramsKey;
+static pthread_once_t ThreadHistogramsOnce = PTHREAD_ONCE_INIT;
+// All the per thread histograms along with the snapshots.
+// A thread's values stick around after it exits, until the next snapshot picks them up.
+static pthread_mutex_t LatencyMetricsLock = PTHREAD_MUTEX_INITIALIZER;
+static std::vector<LatencyMetrics::ThreadHistograms *> *AllThreadHistograms = NULL;
+static LatencyHistogram *IntervalHists[MaxLatencyMetrics];
+static LatencyHistogram *TotalHists[MaxLatencyMetrics];
+static uint64_t LastSnapshotTime = 0;
+static double LastIntervalLength = 0.0;
+static double SnapshotInterval = 5.0;
+static mach_timebase_info_data_t Timebase;
+
+static void RetireThreadHistograms(void *data)
+{
+    LatencyMetrics::ThreadHistograms *threadHists = (LatencyMetrics::ThreadHistograms *)data;
+    pthread_mutex_lock(&LatencyMetricsLock);
+    threadHists->retired = true;
+    pthread_mutex_unlock(&LatencyMetricsLock);
+}
+    
+static void MakeThreadHistogramsKey()
+{
+    pthread_key_create(&ThreadHistogramsKey, RetireThreadHistograms);
+    mach_timebase_info(&Timebase);
+}
+    
+static double TicksToSeconds(uint64_t ticks)
+{
+    return (double)ticks * Timebase.numer / Timebase.denom / 1e9;
+}
+    
+void LatencyMetrics::setEnabled(bool enable)
+{
+    __sync_synchronize();
+    enabled = enable;
+}
+    
+uint64_t LatencyMetrics::startTime()
+{
+    return mach_absolute_time();
+}
+    
+void LatencyMetrics::recordSince(const LatencyMetric &metric,uint64_t start)
+{
+    if (!enabled)
+        return;
+    
+    pthread_once(&ThreadHistogramsOnce, MakeThreadHistogramsKey);
+    uint64_t ticks = mach_absolute_time() - start;
+    recordAlways(metric.metricId, ticks * Timebase.numer / Timebase.denom / 1000);
+}
+    
+LatencyMetrics::ThreadHistograms *LatencyMetrics::getThreadHistograms()
+{
+    pthread_once(&ThreadHistogramsOnce, MakeThreadHistogramsKey);
+    ThreadHistograms *threadHists = (ThreadHistograms *)pthread_getspecific(ThreadHistogramsKey);
+    if (threadHists)
+        return threadHists;
+    
+    // First value on this thread.  Take over from a thread that's gone if we can.
+    // Its values are still waiting for a snapshot, which is fine.
+    pthread_mutex_lock(&LatencyMetricsLock);
+    if (!AllThreadHistograms)
+        AllThreadHistograms = new std::vector<ThreadHistograms *>();
+    for (unsigned int ii=0;ii<AllThreadHistograms->size();ii++)
+        if ((*AllThreadHistograms)[ii]->retired)
+        {
+            threadHists = (*AllThreadHistograms)[ii];
+            threadHists->retired = false;
+            break;
+        }
+    if (!threadHists)
+    {
+        threadHists = new ThreadHistograms();
+        AllThreadHistograms->push_back(threadHists);
+    }
+    pthread_mutex_unlock(&LatencyMetricsLock);
+    
+    pthread_setspecific(ThreadHistogramsKey, threadHists);
+    return threadHists;
+}
+    
+void LatencyMetrics::recordAlways(int metricId,uint64_t micros)
+{
+    ThreadHistograms *threadHists = getThreadHistograms();
+    
+    pthread_mutex_lock(&threadHists->lock);
+    LatencyHistogram *hist = threadHists->hists[metricId];
+    if (!hist)
+    {
+        hist = new LatencyHistogram();
+        threadHists->hists[metricId] = hist;
+    }
+    hist->record(micros);
+    pthread_mutex_unlock(&threadHists->lock);
+}
+    
+void LatencyMetrics::setSnapshotInterval(double seconds)
+{
+    SnapshotInterval = seconds;
+}
+    
+bool LatencyMetrics::snapshotIfDue()
+{
+    pthread_once(&ThreadHistogramsOnce, MakeThreadHistogramsKey);
+    uint64_t now = mach_absolute_time();
+    if (LastSnapshotTime == 0)
+    {
+        // First time through just starts the clock
+        pthread_mutex_lock(&LatencyMetricsLock);
+        if (LastSnapshotTime == 0)
+            LastSnapshotTime = now;
+        pthread_mutex_unlock(&LatencyMetricsLock);
+        return false;
+    }
+    if (TicksToSeconds(now - LastSnapshotTime) < SnapshotInterval)
+        return false;
+    
+    snapshot();
+    return true;
+}
+    
+void LatencyMetrics::snapshot()
+{
+    pthread_once(&ThreadHistogramsOnce, MakeThreadHistogramsKey);
+    pthread_mutex_lock(&LatencyMetricsLock);
+    
+    for (int ii=0;ii<MaxLatencyMetrics;ii++)
+        if (IntervalHists[ii])
+            IntervalHists[ii]->clear();
+    
+    // Move each thread's values into the interval
+    if (AllThreadHistograms)
+        for (unsigned int ti=0;ti<AllThreadHistograms->size();ti++)
+        {
+            ThreadHistograms *threadHists = (*AllThreadHistograms)[ti];
+            pthread_mutex_lock(&threadHists->lock);
+            for (int ii=0;ii<MaxLatencyMetrics;ii++)
+            {
+                LatencyHistogram *hist = threadHists->hists[ii];
+                if (!hist || hist->getCount() == 0)
+                    continue;
+                if (!IntervalHists[ii])
+                    IntervalHists[ii] = new LatencyHistogram();
+                IntervalHists[ii]->merge(*hist);
+                hist->clear();
+            }
+            pthread_mutex_unlock(&threadHists->lock);
+        }
+    
+    for (int ii=0;ii<MaxLatencyMetrics;ii++)
+        if (IntervalHists[ii])
+        {
+            if (!TotalHists[ii])
+                TotalHists[ii] = new LatencyHistogram();
+            TotalHists[ii]->merge(*IntervalHists[ii]);
+        }
+    
+    uint64_t now = mach_absolute_time();
+    LastIntervalLength = LastSnapshotTime ? TicksToSeconds(now - LastSnapshotTime) : 0.0;
+    LastSnapshotTime = now;
+    
+    pthread_mutex_unlock(&LatencyMetricsLock);
+}
+    
+double LatencyMetrics::getLastIntervalLength()
+{
+    pthread_mutex_lock(&LatencyMetricsLock);
+    double len = LastIntervalLength;
+    pthread_mutex_unlock(&LatencyMetricsLock);
+    
+    return len;
+}
+    
+bool LatencyMetrics::getHistogram(const char *name,Window window,LatencyHistogram &hist)
+{
+    bool found = false;
+    
+    pthread_mutex_lock(&LatencyMetricsLock);
+    LatencyHistogram **hists = (window == LastInterval) ? IntervalHists : TotalHists;
+    int numMetrics = std::min((int)NumLatencyMetrics,MaxLatencyMetrics);
+    for (int ii=0;ii<numMetrics;ii++)
+        if (hists[ii] && !strcmp(LatencyMetricNames[ii],name))
+        {
+            hist = *hists[ii];
+            found = true;
+            break;
+        }
+    pthread_mutex_unlock(&LatencyMetricsLock);
+    
+    return found;
+}
+    
+void LatencyMetrics::getSummaries(Window window,std::vector<LatencySummary> &summaries)
+{
+    pthread_mutex_lock(&LatencyMetricsLock);
+    LatencyHistogram **hists = (window == LastInterval) ? IntervalHists : TotalHists;
+    int numMetrics = std::min((int)NumLatencyMetrics,MaxLatencyMetrics);
+    for (int ii=0;ii<numMetrics;ii++)
+    {
+        LatencyHistogram *hist = hists[ii];
+        if (!hist || hist->getCount() == 0)
+            continue;
+        LatencySummary summary;
+        summary.name = LatencyMetricNames[ii];
+        summary.count = hist->getCount();
+        summary.mean = hist->getMean();
+        summary.min = hist->getMin();
+        summary.p50 = hist->valueAtPercentile(50.0);
+        summary.p95 = hist->valueAtPercentile(95.0);
+        summary.p99 = hist->valueAtPercentile(99.0);
+        summary.max = hist->getMax();
+        summaries.push_back(summary);
+    }
+    pthread_mutex_unlock(&LatencyMetricsLock);
+}
+    
+void LatencyMetrics::reset()
+{
+    pthread_mutex_lock(&LatencyMetricsLock);
+    if (AllThreadHistograms)
+        for (unsigned int ti=0;ti<AllThreadHistograms->size();ti++)
+        {
+            ThreadHistograms *threadHists = (*AllThreadHistograms)[ti];
+            pthread_mutex_lock(&threadHists->lock);
+            for (int ii=0;ii<MaxLatencyMetrics;ii++)
+                if (threadHists->hists[ii])
+                    threadHists->hists[ii]->clear();
+            pthread_mutex_unlock(&threadHists->lock);
+        }
+    for (int ii=0;ii<MaxLatencyMetrics;ii++)
+    {
+        if (IntervalHists[ii])
+            IntervalHists[ii]->clear();
+        if (TotalHists[ii])
+            TotalHists[ii]->clear();
+    }
+    LastSnapshotTime = 0;
+    LastIntervalLength = 0.0;
+    pthread_mutex_unlock(&LatencyMetricsLock);
+}
+
+}
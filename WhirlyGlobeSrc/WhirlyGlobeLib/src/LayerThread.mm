@@ -24,9 +24,14 @@
 #import "GlobeScene.h"
 #import "MaplyScene.h"
 #import "GlobeView.h"
+#import "GLBackend.h"
+#import "Profiler.h"
 
 using namespace WhirlyKit;
 
+static ProfileZone SetupChangesZone("LayerThread::runAddChangeRequests");
+static ProfileZone SetupChangesCount("Layer thread changes");
+
 @implementation WhirlyKitLayerThread
 {
     WhirlyKitGLSetupInfo *glSetupInfo;
@@ -44,6 +49,9 @@ using namespace WhirlyKit;
     
     /// We can get change requests from other threads (!)
     pthread_mutex_t changeLock;
+    
+    /// Folds change requests together before we set them up
+    ChangeCoalescer coalescer;
 }
 
 - (id)initWithScene:(WhirlyKit::Scene *)inScene view:(WhirlyKitView *)inView renderer:(WhirlyKitSceneRendererES *)inRenderer;
@@ -162,7 +170,13 @@ using namespace WhirlyKit;
 
 - (void)runAddChangeRequests
 {
+    ProfileScope profile(SetupChangesZone);
+    Profiler::count(SetupChangesCount, (int)changeRequests.size());
+
     [EAGLContext setCurrentContext:_glContext];
+    
+    // Get rid of anything that would be undone before it ran
+    coalescer.coalesce(changeRequests);
 
     bool requiresFlush = false;
     // Set up anything that needs to be set up
@@ -182,9 +196,9 @@ using namespace WhirlyKit;
     
     // If anything needed a flush after that, let's do it
     if (requiresFlush && _allowFlush)
-        glFlush();
+        GetGLBackend()->flush();
     
-    _scene->addChangeRequests(changesToAdd);
+    _scene->addChangeRequestsAndClear(changesToAdd);
     changeRequests.clear();
 }
 
@@ -199,6 +213,11 @@ using namespace WhirlyKit;
     for (NSObject<WhirlyKitLayer> *layer in layers)
         if ([layer respondsToSelector:@selector(log)])
             [layer log];
+    
+    const ChangeCoalesceStats &stats = coalescer.getStats();
+    if (stats.numChanges > 0)
+        NSLog(@"LayerThread: Coalesced %d change requests: %d removed, %d add/remove pairs cancelled, %d updates merged",
+              stats.numChanges,stats.numRemoved,stats.numCancelled,stats.numMerged);
 }
 
 // Called to start the thread
@@ -207,6 +226,8 @@ using namespace WhirlyKit;
 {
     // This should be the default context.  If you change it yourself, change it back
     [EAGLContext setCurrentContext:_glContext];
+    
+    Profiler::setThreadName("Layer Thread");
 
     @autoreleasepool {
         _runLoop = [NSRunLoop currentRunLoop];
@@ -23,6 +23,8 @@
 #import "WhirlyGeometry.h"
 #import "GlobeMath.h"
 #import "ScreenSpaceGenerator.h"
+#import "Profiler.h"
+#import "LatencyHistogram.h"
 
 using namespace Eigen;
 
@@ -395,8 +397,14 @@ void LayoutManager::runLayoutRules(WhirlyKitViewState *viewState)
 static float const DisappearFade = 0.1;
 
 // Layout all the objects we're tracking
+static ProfileZone UpdateLayoutZone("LayoutManager::updateLayout");
+static LatencyMetric LayoutLatency("Layout");
+
 void LayoutManager::updateLayout(WhirlyKitViewState *viewState,ChangeSet &changes)
 {
+    ProfileScope profile(UpdateLayoutZone);
+    LatencyScope latency(LayoutLatency);
+    
     pthread_mutex_lock(&layoutLock);
 
     NSTimeInterval curTime = CFAbsoluteTimeGetCurrent();
@@ -61,51 +61,28 @@ using namespace WhirlyKit;
 {
     char name[200];
     sprintf(name,"light[%d].viewdepend",index);
-    const OpenGLESUniform *viewDependUni = program->findUniform(name);
+    OpenGLESUniform *viewDependUni = program->findUniform(name);
     sprintf(name,"light[%d].direction",index);
-    const OpenGLESUniform *dirUni = program->findUniform(name);
+    OpenGLESUniform *dirUni = program->findUniform(name);
     sprintf(name,"light[%d].halfplane",index);
-    const OpenGLESUniform *halfUni = program->findUniform(name);
+    OpenGLESUniform *halfUni = program->findUniform(name);
     sprintf(name,"light[%d].ambient",index);
-    const OpenGLESUniform *ambientUni = program->findUniform(name);
+    OpenGLESUniform *ambientUni = program->findUniform(name);
     sprintf(name,"light[%d].diffuse",index);
-    const OpenGLESUniform *diffuseUni = program->findUniform(name);
+    OpenGLESUniform *diffuseUni = program->findUniform(name);
     sprintf(name,"light[%d].specular",index);
-    const OpenGLESUniform *specularUni = program->findUniform(name);
+    OpenGLESUniform *specularUni = program->findUniform(name);
     
     Vector3f dir = _pos.normalized();
     Vector3f halfPlane = (dir + Vector3f(0,0,1)).normalized();
     
-    if (viewDependUni)
-    {
-        glUniform1f(viewDependUni->index, (_viewDependent ? 0.0 : 1.0));
-        CheckGLError("WhirlyKitDirectionalLight::bindToProgram glUniform1f");
-    }
-    if (dirUni)
-    {
-        glUniform3f(dirUni->index, dir.x(), dir.y(), dir.z());
-        CheckGLError("WhirlyKitDirectionalLight::bindToProgram glUniform3f");
-    }
-    if (halfUni)
-    {
-        glUniform3f(halfUni->index, halfPlane.x(), halfPlane.y(), halfPlane.z());
-        CheckGLError("WhirlyKitDirectionalLight::bindToProgram glUniform3f");        
-    }
-    if (ambientUni)
-    {
-        glUniform4f(ambientUni->index, _ambient.x(), _ambient.y(), _ambient.z(), _ambient.w());
-        CheckGLError("WhirlyKitDirectionalLight::bindToProgram glUniform4f");
-    }
-    if (diffuseUni)
-    {
-        glUniform4f(diffuseUni->index, _diffuse.x(), _diffuse.y(), _diffuse.z(), _diffuse.w());
-        CheckGLError("WhirlyKitDirectionalLight::bindToProgram glUniform4f");
-    }
-    if (specularUni)
-    {
-        glUniform4f(specularUni->index, _specular.x(), _specular.y(), _specular.z(), _specular.w());
-        CheckGLError("WhirlyKitDirectionalLight::bindToProgram glUniform4f");
-    }
+    // These go through the program's cache and skip anything that hasn't changed
+    program->setUniform(viewDependUni, (float)(_viewDependent ? 0.0 : 1.0));
+    program->setUniform(dirUni, dir);
+    program->setUniform(halfUni, halfPlane);
+    program->setUniform(ambientUni, _ambient);
+    program->setUniform(diffuseUni, _diffuse);
+    program->setUniform(specularUni, _specular);
     
     return (dirUni && halfUni && ambientUni && diffuseUni && specularUni);
 }
@@ -44,6 +44,7 @@ using namespace WhirlyKit;
     UIColor     *outlineColor;
     float       outlineWidth;
     bool        enable;
+    bool        optimizeMesh;
     NSObject<WhirlyKitLoftedPolyCache> *cache;
 }
 
@@ -97,6 +98,7 @@ using namespace WhirlyKit;
     outlineColor = [dict objectForKey:@"outlineColor" checkType:[UIColor class] default:[UIColor whiteColor]];
     outlineWidth = [dict floatForKey:@"outlineWidth" default:1.0];
     enable = [dict boolForKey:@"enable" default:true];
+    optimizeMesh = [dict boolForKey:@"optimizemesh" default:false];
     self.key = inKey;
 }
 
@@ -421,6 +423,8 @@ public:
             {
                 drawable->setLocalMbr(Mbr(Point2f(drawMbr.ll().x(),drawMbr.ll().y()),Point2f(drawMbr.ur().x(),drawMbr.ur().y())));
                 sceneRep->drawIDs.insert(drawable->getId());
+                if (primType == GL_TRIANGLES && polyInfo->optimizeMesh)
+                    drawable->optimizeMesh();
                 if (polyInfo.fade > 0)
                 {
                     NSTimeInterval curTime = CFAbsoluteTimeGetCurrent();
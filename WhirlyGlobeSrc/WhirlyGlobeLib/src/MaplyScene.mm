@@ -32,20 +32,17 @@ MapScene::MapScene(WhirlyKit::CoordSystemDisplayAdapter *coordAdapter)
     
 void MapScene::addDrawable(DrawableRef draw)
 {
-    drawables.insert(draw);
+    drawables.insert(draw->getId(),draw);
     
-    // Dump it in the top level for now
     Mbr localMbr = draw->getLocalMbr();
-    cullTree->getTopCullable()->addDrawable(cullTree, localMbr, draw);
+    cullTree->addDrawable(localMbr, draw);
 }
 
 void MapScene::remDrawable(DrawableRef draw)
 {
-    // We're expecting it to just be at the top level
-    Mbr localMbr = draw->getLocalMbr();
-    cullTree->getTopCullable()->remDrawable(cullTree, localMbr, draw);
+    cullTree->remDrawable(draw);
     
-    drawables.erase(draw);
+    drawables.erase(draw->getId());
 }
     
 }
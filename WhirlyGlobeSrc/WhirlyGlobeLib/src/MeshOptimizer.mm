@@ -0,0 +1,281 @@
+/*
+ *  MeshOptimizer.mm
+ *  WhirlyGlobeLib
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <math.h>
+#import <algorithm>
+#import "MeshOptimizer.h"
+
+namespace WhirlyKit
+{
+    
+// Tuning values from Forsyth's paper
+static const int VertexCacheSize = 32;
+static const float CacheDecayPower = 1.5;
+static const float LastTriScore = 0.75;
+static const float ValenceBoostScale = 2.0;
+static const float ValenceBoostPower = 0.5;
+// We precompute scores for valences up to this
+static const int MaxValenceTable = 32;
+
+// Score for a single vertex given its position in the cache and the
+//  number of triangles still waiting to use it
+static float VertexScore(int cachePos,int numActiveTris)
+{
+    // No tris left, so we don't care
+    if (numActiveTris == 0)
+        return -1.0;
+    
+    float score = 0.0;
+    if (cachePos >= 0)
+    {
+        // The last triangle's vertices get a fixed score so we
+        //  don't favor one of them over the others
+        if (cachePos < 3)
+            score = LastTriScore;
+        else {
+            float scaler = 1.0 / (VertexCacheSize - 3);
+            score = powf(1.0 - (cachePos - 3) * scaler, CacheDecayPower);
+        }
+    }
+    
+    // Boost vertices with only a few triangles left so we get rid of them
+    score += ValenceBoostScale * powf(numActiveTris, -ValenceBoostPower);
+    
+    return score;
+}
+    
+// Per vertex state for the cache optimizer
+typedef struct
+{
+    int cachePos;
+    int numActiveTris;
+    // Where this vertex's triangles start in the adjacency list
+    int adjStart;
+    float score;
+} OptVertex;
+    
+void OptimizeVertexCache(std::vector<GLuint> &indices,unsigned int numVerts)
+{
+    int numTris = (int)indices.size() / 3;
+    if (numTris == 0 || numVerts == 0)
+        return;
+    
+    // Precompute the scores so we're not calling powf all the time
+    float cacheScores[VertexCacheSize+1][MaxValenceTable+1];
+    for (int ci=0;ci<=VertexCacheSize;ci++)
+        for (int vi=0;vi<=MaxValenceTable;vi++)
+            cacheScores[ci][vi] = VertexScore((ci == VertexCacheSize ? -1 : ci),vi);
+    
+    std::vector<OptVertex> verts(numVerts);
+    for (unsigned int ii=0;ii<numVerts;ii++)
+    {
+        OptVertex &vert = verts[ii];
+        vert.cachePos = -1;
+        vert.numActiveTris = 0;
+        vert.adjStart = 0;
+        vert.score = 0.0;
+    }
+    for (unsigned int ii=0;ii<(unsigned int)numTris*3;ii++)
+        verts[indices[ii]].numActiveTris++;
+    
+    // Build the vertex to triangle adjacency
+    int adjSize = 0;
+    for (unsigned int ii=0;ii<numVerts;ii++)
+    {
+        verts[ii].adjStart = adjSize;
+        adjSize += verts[ii].numActiveTris;
+    }
+    std::vector<int> adjTris(adjSize);
+    std::vector<int> adjFill(numVerts,0);
+    for (int ti=0;ti<numTris;ti++)
+        for (unsigned int jj=0;jj<3;jj++)
+        {
+            GLuint vi = indices[3*ti+jj];
+            adjTris[verts[vi].adjStart + adjFill[vi]++] = ti;
+        }
+    
+    // Look up a vertex score, falling back to the slow version for big valences
+    #define OptScore(vert) ((vert).numActiveTris <= MaxValenceTable ?         cacheScores[(vert).cachePos < 0 ? VertexCacheSize : (vert).cachePos][(vert).numActiveTris] :         VertexScore((vert).cachePos,(vert).numActiveTris))
+    
+    for (unsigned int ii=0;ii<numVerts;ii++)
+        verts[ii].score = OptScore(verts[ii]);
+    
+    std::vector<float> triScores(numTris);
+    std::vector<bool> triAdded(numTris,false);
+    int bestTri = -1;
+    float bestScore = -1.0;
+    for (int ti=0;ti<numTris;ti++)
+    {
+        triScores[ti] = verts[indices[3*ti]].score + verts[indices[3*ti+1]].score + verts[indices[3*ti+2]].score;
+        if (triScores[ti] > bestScore)
+        {
+            bestScore = triScores[ti];
+            bestTri = ti;
+        }
+    }
+    
+    // The cache has room for the new triangle's vertices on top of the full size
+    std::vector<int> cache,newCache;
+    cache.reserve(VertexCacheSize+3);
+    newCache.reserve(VertexCacheSize+3);
+    
+    std::vector<GLuint> newIndices;
+    newIndices.reserve(indices.size());
+    int scanPos = 0;
+    for (int outTri=0;outTri<numTris;outTri++)
+    {
+        // Ran out of connected triangles, so look for the best remaining one
+        if (bestTri < 0)
+        {
+            bestScore = -1.0;
+            for (int ti=scanPos;ti<numTris;ti++)
+            {
+                if (triAdded[ti])
+                {
+                    if (ti == scanPos)
+                        scanPos++;
+                    continue;
+                }
+                if (triScores[ti] > bestScore)
+                {
+                    bestScore = triScores[ti];
+                    bestTri = ti;
+                }
+            }
+        }
+        
+        // Emit the triangle
+        triAdded[bestTri] = true;
+        const GLuint *tri = &indices[3*bestTri];
+        newIndices.insert(newIndices.end(),tri,tri+3);
+        
+        // Take the triangle out of its vertices' adjacency lists
+        for (unsigned int jj=0;jj<3;jj++)
+        {
+            OptVertex &vert = verts[tri[jj]];
+            int *adj = &adjTris[vert.adjStart];
+            for (int ai=0;ai<vert.numActiveTris;ai++)
+                if (adj[ai] == bestTri)
+                {
+                    adj[ai] = adj[vert.numActiveTris-1];
+                    break;
+                }
+            vert.numActiveTris--;
+        }
+        
+        // New cache has the triangle's vertices up front, then the old cache
+        newCache.clear();
+        for (unsigned int jj=0;jj<3;jj++)
+            if (std::find(newCache.begin(),newCache.end(),(int)tri[jj]) == newCache.end())
+                newCache.push_back(tri[jj]);
+        for (unsigned int ci=0;ci<cache.size();ci++)
+            if (cache[ci] != (int)tri[0] && cache[ci] != (int)tri[1] && cache[ci] != (int)tri[2])
+                newCache.push_back(cache[ci]);
+        
+        // Update the vertex positions, including the ones that fell out
+        for (unsigned int ci=0;ci<newCache.size();ci++)
+        {
+            OptVertex &vert = verts[newCache[ci]];
+            vert.cachePos = (ci < VertexCacheSize ? ci : -1);
+            vert.score = OptScore(vert);
+        }
+        
+        // Rescore the triangles touching anything that changed and find the next best
+        bestTri = -1;
+        bestScore = -1.0;
+        for (unsigned int ci=0;ci<newCache.size();ci++)
+        {
+            OptVertex &vert = verts[newCache[ci]];
+            const int *adj = &adjTris[vert.adjStart];
+            for (int ai=0;ai<vert.numActiveTris;ai++)
+            {
+                int ti = adj[ai];
+                float score = verts[indices[3*ti]].score + verts[indices[3*ti+1]].score + verts[indices[3*ti+2]].score;
+                triScores[ti] = score;
+                if (score > bestScore)
+                {
+                    bestScore = score;
+                    bestTri = ti;
+                }
+            }
+        }
+        
+        if (newCache.size() > VertexCacheSize)
+            newCache.resize(VertexCacheSize);
+        cache.swap(newCache);
+    }
+    
+    #undef OptScore
+    
+    indices.swap(newIndices);
+}
+    
+void OptimizeVertexFetch(std::vector<GLuint> &indices,unsigned int numVerts,std::vector<GLuint> &newToOld)
+{
+    static const GLuint Unassigned = (GLuint)-1;
+    std::vector<GLuint> oldToNew(numVerts,Unassigned);
+    newToOld.clear();
+    newToOld.reserve(numVerts);
+    
+    for (unsigned int ii=0;ii<indices.size();ii++)
+    {
+        GLuint &idx = indices[ii];
+        if (oldToNew[idx] == Unassigned)
+        {
+            oldToNew[idx] = (GLuint)newToOld.size();
+            newToOld.push_back(idx);
+        }
+        idx = oldToNew[idx];
+    }
+    
+    // Tack the unused ones on the end
+    for (unsigned int ii=0;ii<numVerts;ii++)
+        if (oldToNew[ii] == Unassigned)
+        {
+            oldToNew[ii] = (GLuint)newToOld.size();
+            newToOld.push_back(ii);
+        }
+}
+    
+float CalcACMR(const std::vector<GLuint> &indices,unsigned int cacheSize)
+{
+    unsigned int numTris = (unsigned int)indices.size() / 3;
+    if (numTris == 0 || cacheSize == 0)
+        return 0.0;
+    
+    // FIFO cache, which is what most mobile parts look like
+    std::vector<GLuint> cache(cacheSize,(GLuint)-1);
+    unsigned int head = 0;
+    unsigned int misses = 0;
+    for (unsigned int ii=0;ii<numTris*3;ii++)
+    {
+        GLuint idx = indices[ii];
+        if (std::find(cache.begin(),cache.end(),idx) == cache.end())
+        {
+            misses++;
+            cache[head] = idx;
+            head = (head + 1) % cacheSize;
+        }
+    }
+    
+    return (float)misses / numTris;
+}
+
+}
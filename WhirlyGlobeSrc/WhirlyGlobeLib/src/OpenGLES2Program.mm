@@ -31,6 +31,13 @@ namespace WhirlyKit
 OpenGLES2Program::OpenGLES2Program()
     : lightsLastUpdated(0.0)
 {
+    clearStandardUniforms();
+}
+    
+void OpenGLES2Program::clearStandardUniforms()
+{
+    for (unsigned int ii=0;ii<StdUniformMax;ii++)
+        stdUniforms[ii] = NULL;
 }
     
 OpenGLES2Program::~OpenGLES2Program()
@@ -45,9 +52,8 @@ OpenGLES2Program::~OpenGLES2Program()
     attrs.clear();
 }
     
-bool OpenGLES2Program::setUniform(const std::string &name,float val)
+bool OpenGLES2Program::setUniform(OpenGLESUniform *uni,float val)
 {
-    OpenGLESUniform *uni = findUniform(name);
     if (!uni)
         return false;
     
@@ -57,7 +63,7 @@ bool OpenGLES2Program::setUniform(const std::string &name,float val)
     if (uni->isSet && uni->val.fVals[0] == val)
         return true;
     
-    glUniform1f(uni->index,val);
+    GetGLBackend()->uniform1f(uni->index,val);
     CheckGLError("BigDrawable::draw() glUniform1f");
     uni->isSet = true;
     uni->val.fVals[0] = val;
@@ -65,9 +71,8 @@ bool OpenGLES2Program::setUniform(const std::string &name,float val)
     return true;
 }
 
-bool OpenGLES2Program::setUniform(const std::string &name,int val)
+bool OpenGLES2Program::setUniform(OpenGLESUniform *uni,int val)
 {
-    OpenGLESUniform *uni = findUniform(name);
     if (!uni)
         return false;
     
@@ -77,7 +82,7 @@ bool OpenGLES2Program::setUniform(const std::string &name,int val)
     if (uni->isSet && uni->val.iVals[0] == val)
         return true;
     
-    glUniform1i(uni->index,val);
+    GetGLBackend()->uniform1i(uni->index,val);
     CheckGLError("BigDrawable::draw() glUniform1i");
     uni->isSet = true;
     uni->val.iVals[0] = val;
@@ -85,9 +90,8 @@ bool OpenGLES2Program::setUniform(const std::string &name,int val)
     return true;
 }
 
-bool OpenGLES2Program::setUniform(const std::string &name,const Eigen::Vector2f &vec)
+bool OpenGLES2Program::setUniform(OpenGLESUniform *uni,const Eigen::Vector2f &vec)
 {
-    OpenGLESUniform *uni = findUniform(name);
     if (!uni)
         return false;
     
@@ -97,7 +101,7 @@ bool OpenGLES2Program::setUniform(const std::string &name,const Eigen::Vector2f
     if (uni->isSet && uni->val.fVals[0] == vec.x() && uni->val.fVals[1] == vec.y())
         return true;
     
-    glUniform2f(uni->index, vec.x(), vec.y());
+    GetGLBackend()->uniform2f(uni->index, vec.x(), vec.y());
     CheckGLError("BigDrawable::draw() glUniform2f");
     uni->isSet = true;
     uni->val.fVals[0] = vec.x();  uni->val.fVals[1] = vec.y();
@@ -105,9 +109,8 @@ bool OpenGLES2Program::setUniform(const std::string &name,const Eigen::Vector2f
     return true;
 }
 
-bool OpenGLES2Program::setUniform(const std::string &name,const Eigen::Vector3f &vec)
+bool OpenGLES2Program::setUniform(OpenGLESUniform *uni,const Eigen::Vector3f &vec)
 {
-    OpenGLESUniform *uni = findUniform(name);
     if (!uni)
         return false;
     
@@ -116,7 +119,7 @@ bool OpenGLES2Program::setUniform(const std::string &name,const Eigen::Vector3f
     if (uni->isSet && uni->val.fVals[0] == vec.x() && uni->val.fVals[1] == vec.y() && uni->val.fVals[2] == vec.z())
         return true;
     
-    glUniform3f(uni->index, vec.x(), vec.y(), vec.z());
+    GetGLBackend()->uniform3f(uni->index, vec.x(), vec.y(), vec.z());
     CheckGLError("BigDrawable::draw() glUniform3f");
     uni->isSet = true;
     uni->val.fVals[0] = vec.x();  uni->val.fVals[1] = vec.y();  uni->val.fVals[2] = vec.z();
@@ -125,9 +128,8 @@ bool OpenGLES2Program::setUniform(const std::string &name,const Eigen::Vector3f
 }
     
 
-bool OpenGLES2Program::setUniform(const std::string &name,const Eigen::Vector4f &vec)
+bool OpenGLES2Program::setUniform(OpenGLESUniform *uni,const Eigen::Vector4f &vec)
 {
-    OpenGLESUniform *uni = findUniform(name);
     if (!uni)
         return false;
     
@@ -137,7 +139,7 @@ bool OpenGLES2Program::setUniform(const std::string &name,const Eigen::Vector4f
         uni->val.fVals[2] == vec.z() && uni->val.fVals[3] == vec.w())
         return true;
     
-    glUniform4f(uni->index, vec.x(), vec.y(), vec.z(), vec.w());
+    GetGLBackend()->uniform4f(uni->index, vec.x(), vec.y(), vec.z(), vec.w());
     CheckGLError("BigDrawable::draw() glUniform4f");
     uni->isSet = true;
     uni->val.fVals[0] = vec.x();  uni->val.fVals[1] = vec.y();  uni->val.fVals[2] = vec.z(); uni->val.fVals[3] = vec.w();
@@ -145,9 +147,8 @@ bool OpenGLES2Program::setUniform(const std::string &name,const Eigen::Vector4f
     return true;
 }
 
-bool OpenGLES2Program::setUniform(const std::string &name,const Eigen::Matrix4f &mat)
+bool OpenGLES2Program::setUniform(OpenGLESUniform *uni,const Eigen::Matrix4f &mat)
 {
-    OpenGLESUniform *uni = findUniform(name);
     if (!uni)
         return false;
     
@@ -167,7 +168,7 @@ bool OpenGLES2Program::setUniform(const std::string &name,const Eigen::Matrix4f
             return true;
     }
     
-    glUniformMatrix4fv(uni->index, 1, GL_FALSE, (GLfloat *)mat.data());
+    GetGLBackend()->uniformMatrix4fv(uni->index, 1, GL_FALSE, (GLfloat *)mat.data());
     CheckGLError("BigDrawable::draw() glUniformMatrix4fv");
     uni->isSet = true;
     for (unsigned int ii=0;ii<16;ii++)
@@ -176,30 +177,60 @@ bool OpenGLES2Program::setUniform(const std::string &name,const Eigen::Matrix4f
     return true;
 }
 
+bool OpenGLES2Program::setUniform(const std::string &name,float val)
+{
+    return setUniform(findUniform(name),val);
+}
+    
+bool OpenGLES2Program::setUniform(const std::string &name,int val)
+{
+    return setUniform(findUniform(name),val);
+}
+    
+bool OpenGLES2Program::setUniform(const std::string &name,const Eigen::Vector2f &vec)
+{
+    return setUniform(findUniform(name),vec);
+}
+    
+bool OpenGLES2Program::setUniform(const std::string &name,const Eigen::Vector3f &vec)
+{
+    return setUniform(findUniform(name),vec);
+}
+    
+bool OpenGLES2Program::setUniform(const std::string &name,const Eigen::Vector4f &vec)
+{
+    return setUniform(findUniform(name),vec);
+}
+    
+bool OpenGLES2Program::setUniform(const std::string &name,const Eigen::Matrix4f &mat)
+{
+    return setUniform(findUniform(name),mat);
+}
+    
 // Helper routine to compile a shader and check return
 bool compileShader(const std::string &name,const char *shaderTypeStr,GLuint *shaderId,GLenum shaderType,const std::string &shaderStr)
 {
-    *shaderId = glCreateShader(shaderType);
+    *shaderId = GetGLBackend()->createShader(shaderType);
     const GLchar *sourceCStr = shaderStr.c_str();
-    glShaderSource(*shaderId, 1, &sourceCStr, NULL);
-    glCompileShader(*shaderId);
+    GetGLBackend()->shaderSource(*shaderId, 1, &sourceCStr, NULL);
+    GetGLBackend()->compileShader(*shaderId);
     
     GLint status;
-    glGetShaderiv(*shaderId, GL_COMPILE_STATUS, &status);
+    GetGLBackend()->getShaderiv(*shaderId, GL_COMPILE_STATUS, &status);
     
     if (status != GL_TRUE)
     {
         GLint len;
-        glGetShaderiv(*shaderId, GL_INFO_LOG_LENGTH, &len);
+        GetGLBackend()->getShaderiv(*shaderId, GL_INFO_LOG_LENGTH, &len);
         if (len > 0)
         {
             GLchar *logStr = (GLchar *)malloc(len);
-            glGetShaderInfoLog(*shaderId, len, &len, logStr);
+            GetGLBackend()->getShaderInfoLog(*shaderId, len, &len, logStr);
             NSLog(@"Compile error for %s shader %s:\n%s",shaderTypeStr,name.c_str(),logStr);
             free(logStr);
         }
         
-        glDeleteShader(*shaderId);
+        GetGLBackend()->deleteShader(*shaderId);
         *shaderId = 0;
     }
     
@@ -210,7 +241,8 @@ bool compileShader(const std::string &name,const char *shaderTypeStr,GLuint *sha
 OpenGLES2Program::OpenGLES2Program(const std::string &inName,const std::string &vShaderString,const std::string &fShaderString)
     : name(inName), lightsLastUpdated(0.0)
 {
-    program = glCreateProgram();
+    clearStandardUniforms();
+    program = GetGLBackend()->createProgram();
     
     if (!compileShader(name,"vertex",&vertShader,GL_VERTEX_SHADER,vShaderString))
     {
@@ -223,23 +255,23 @@ OpenGLES2Program::OpenGLES2Program(const std::string &inName,const std::string &
         return;
     }
 
-    glAttachShader(program, vertShader);
-    glAttachShader(program, fragShader);
+    GetGLBackend()->attachShader(program, vertShader);
+    GetGLBackend()->attachShader(program, fragShader);
     
     // Now link it
     GLint status;
-    glLinkProgram(program);
-    glValidateProgram(program);
+    GetGLBackend()->linkProgram(program);
+    GetGLBackend()->validateProgram(program);
     
-    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    GetGLBackend()->getProgramiv(program, GL_LINK_STATUS, &status);
     if (status == GL_FALSE)
     {
         GLint len;
-        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &len);
+        GetGLBackend()->getProgramiv(program, GL_INFO_LOG_LENGTH, &len);
         if (len > 0)
         {
             GLchar *logStr = (GLchar *)malloc(len);
-            glGetProgramInfoLog(program, len, &len, logStr);
+            GetGLBackend()->getProgramInfoLog(program, len, &len, logStr);
             NSLog(@"Link error for shader program %s:\n%s",name.c_str(),logStr);
             free(logStr);
         }
@@ -249,43 +281,54 @@ OpenGLES2Program::OpenGLES2Program(const std::string &inName,const std::string &
     
     if (vertShader)
     {
-        glDeleteShader(vertShader);
+        GetGLBackend()->deleteShader(vertShader);
         vertShader = 0;
     }
     if (fragShader)
     {
-        glDeleteShader(fragShader);
+        GetGLBackend()->deleteShader(fragShader);
         fragShader = 0;
     }
     
     // Convert the uniforms into a more friendly form
     GLint numUniform;
-    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &numUniform);
+    GetGLBackend()->getProgramiv(program, GL_ACTIVE_UNIFORMS, &numUniform);
     char thingName[1024];
     for (unsigned int ii=0;ii<numUniform;ii++)
     {
         OpenGLESUniform *uni = new OpenGLESUniform();
         GLint bufLen;
         thingName[0] = 0;
-        glGetActiveUniform(program, ii, 1023, &bufLen, &uni->size, &uni->type, thingName);
+        GetGLBackend()->getActiveUniform(program, ii, 1023, &bufLen, &uni->size, &uni->type, thingName);
         uni->name = thingName;
-        uni->index = glGetUniformLocation(program, thingName);
+        uni->index = GetGLBackend()->getUniformLocation(program, thingName);
         uniforms.insert(uni);
     }
     
     // Convert the attributes into a more useful form
     GLint numAttr;
-    glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &numAttr);
+    GetGLBackend()->getProgramiv(program, GL_ACTIVE_ATTRIBUTES, &numAttr);
     for (unsigned int ii=0;ii<numAttr;ii++)
     {
         OpenGLESAttribute *attr = new OpenGLESAttribute();
         GLint bufLen;
         thingName[0] = 0;
-        glGetActiveAttrib(program, ii, 1023, &bufLen, &attr->size, &attr->type, thingName);
-        attr->index = glGetAttribLocation(program, thingName);
+        GetGLBackend()->getActiveAttrib(program, ii, 1023, &bufLen, &attr->size, &attr->type, thingName);
+        attr->index = GetGLBackend()->getAttribLocation(program, thingName);
         attr->name = thingName;
         attrs.insert(attr);
     }
+    
+    // Look up the uniforms we'll be setting all the time
+    stdUniforms[StdUniformMVPMatrix] = findUniform("u_mvpMatrix");
+    stdUniforms[StdUniformMVMatrix] = findUniform("u_mvMatrix");
+    stdUniforms[StdUniformMVNormalMatrix] = findUniform("u_mvNormalMatrix");
+    stdUniforms[StdUniformOctNormals] = findUniform("u_octNormals");
+    stdUniforms[StdUniformFade] = findUniform("u_fade");
+    stdUniforms[StdUniformHasTexture] = findUniform("u_hasTexture");
+    stdUniforms[StdUniformEyeVec] = findUniform("u_eyeVec");
+    stdUniforms[StdUniformBaseMap] = findUniform("s_baseMap");
+    stdUniforms[StdUniformNumLights] = findUniform(kWKOGLNumLights);
 }
     
 // Clean up oustanding OpenGL resources
@@ -293,22 +336,23 @@ void OpenGLES2Program::cleanUp()
 {
     if (program)
     {
-        glDeleteProgram(program);
+        GetGLBackend()->deleteProgram(program);
         program = 0;
     }
     if (vertShader)
     {
-        glDeleteShader(vertShader);
+        GetGLBackend()->deleteShader(vertShader);
         vertShader = 0;
     }
     if (fragShader)
     {
-        glDeleteShader(fragShader);
+        GetGLBackend()->deleteShader(fragShader);
         fragShader = 0;
     }
     
     uniforms.clear();
     attrs.clear();
+    clearStandardUniforms();
 }
     
 bool OpenGLES2Program::isValid()
@@ -339,8 +383,7 @@ const OpenGLESAttribute *OpenGLES2Program::findAttribute(const std::string &attr
     
 bool OpenGLES2Program::hasLights()
 {
-    OpenGLESUniform *lightAttr = findUniform("u_numLights");
-    return lightAttr != NULL;
+    return stdUniforms[StdUniformNumLights] != NULL;
 }
     
 bool OpenGLES2Program::setLights(NSArray *lights,CFTimeInterval lastUpdate,WhirlyKitMaterial *mat,Eigen::Matrix4f &modelMat)
@@ -357,10 +400,8 @@ bool OpenGLES2Program::setLights(NSArray *lights,CFTimeInterval lastUpdate,Whirl
         WhirlyKitDirectionalLight *light = [lights objectAtIndex:ii];
         lightsSet &= [light bindToProgram:this index:ii modelMatrix:modelMat];
     }
-    OpenGLESUniform *lightAttr = findUniform("u_numLights");
-    if (lightAttr)
-        glUniform1i(lightAttr->index, numLights);
-    else
+    // Goes through the cache so the renderer's own setting of this stays in sync
+    if (!setUniform(stdUniforms[StdUniformNumLights], numLights))
         return false;
     
     // Bind the material
@@ -0,0 +1,328 @@
+/*
+ *  Profiler.mm
+ *  WhirlyGlobeLib
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <mach/mach_time.h>
+#import <stdio.h>
+#import <stdlib.h>
+#import <string.h>
+#import <algorithm>
+#import <vector>
+#import "Profiler.h"
+
+namespace WhirlyKit
+{
+    
+// Zones we can keep track of
+static const int MaxProfileZones = 1024;
+// Events each thread keeps unless told otherwise.  16 bytes each.
+static const int DefaultEventsPerThread = 16384;
+
+// Zone names by ID.  Filled in as the zones are constructed, so no constructor of our own.
+static const char *ProfileZoneNames[MaxProfileZones];
+static volatile int NumProfileZones = 0;
+    
+ProfileZone::ProfileZone(const char *inName)
+    : name(inName)
+{
+    zoneId = __sync_fetch_and_add(&NumProfileZones, 1);
+    // Everything past the end of the table shares the last slot
+    if (zoneId >= MaxProfileZones)
+    {
+        zoneId = MaxProfileZones-1;
+        ProfileZoneNames[zoneId] = "Other";
+    } else
+        ProfileZoneNames[zoneId] = name;
+}
+
+/// Events for one thread.  Only that thread writes, anyone can read.
+class Profiler::ThreadBuffer
+{
+public:
+    ThreadBuffer(int size,int threadIndex)
+        : events(size), written(0), readFrom(0), threadIndex(threadIndex), retired(false)
+    {
+        name[0] = 0;
+    }
+    
+    // Copy out the events since the last clear, oldest first.
+    // The writer keeps going while we do this, so we toss anything it may have lapped.
+    void copyEvents(std::vector<Event> &outEvents)
+    {
+        uint32_t size = (uint32_t)events.size();
+        uint32_t end = written;
+        __sync_synchronize();
+        uint32_t start = (end - readFrom > size) ? end - size : readFrom;
+        std::vector<Event> copied;
+        copied.reserve(end-start);
+        for (uint32_t ii=start;ii!=end;ii++)
+            copied.push_back(events[ii % size]);
+        __sync_synchronize();
+        uint32_t after = written;
+        uint32_t firstGood = (after - start > size) ? after - size : start;
+        outEvents.insert(outEvents.end(),copied.begin()+std::min(firstGood-start,end-start),copied.end());
+    }
+    
+    std::vector<Event> events;
+    // Total events written.  Wraps, which is fine.
+    volatile uint32_t written;
+    // Where the last clear left off
+    uint32_t readFrom;
+    int threadIndex;
+    char name[64];
+    // Its thread exited, so another can have it
+    bool retired;
+};
+
+volatile bool Profiler::enabled = false;
+static int EventsPerThread = DefaultEventsPerThread;
+static pthread_key_t ThreadBufferKey,ThreadNameKey;
+static pthread_once_t ThreadKeysOnce = PTHREAD_ONCE_INIT;
+// All the thread buffers we've made.  When a thread exits its events stay
+//  around until another thread takes over the buffer.
+static pthread_mutex_t ThreadBuffersLock = PTHREAD_MUTEX_INITIALIZER;
+static std::vector<Profiler::ThreadBuffer *> *ThreadBuffers = NULL;
+static int NumProfiledThreads = 0;
+
+static void RetireThreadBuffer(void *data)
+{
+    Profiler::ThreadBuffer *buffer = (Profiler::ThreadBuffer *)data;
+    pthread_mutex_lock(&ThreadBuffersLock);
+    buffer->retired = true;
+    pthread_mutex_unlock(&ThreadBuffersLock);
+}
+
+static void MakeThreadKeys()
+{
+    pthread_key_create(&ThreadBufferKey, RetireThreadBuffer);
+    pthread_key_create(&ThreadNameKey, free);
+}
+    
+void Profiler::setEnabled(bool enable)
+{
+    __sync_synchronize();
+    enabled = enable;
+}
+    
+void Profiler::setEventsPerThread(int numEvents)
+{
+    if (numEvents > 0)
+        EventsPerThread = numEvents;
+}
+    
+void Profiler::setThreadName(const char *name)
+{
+    pthread_once(&ThreadKeysOnce, MakeThreadKeys);
+    free(pthread_getspecific(ThreadNameKey));
+    pthread_setspecific(ThreadNameKey, strdup(name));
+    
+    ThreadBuffer *buffer = (ThreadBuffer *)pthread_getspecific(ThreadBufferKey);
+    if (buffer)
+    {
+        pthread_mutex_lock(&ThreadBuffersLock);
+        strncpy(buffer->name, name, sizeof(buffer->name)-1);
+        buffer->name[sizeof(buffer->name)-1] = 0;
+        pthread_mutex_unlock(&ThreadBuffersLock);
+    }
+}
+    
+Profiler::ThreadBuffer *Profiler::getThreadBuffer()
+{
+    pthread_once(&ThreadKeysOnce, MakeThreadKeys);
+    ThreadBuffer *buffer = (ThreadBuffer *)pthread_getspecific(ThreadBufferKey);
+    if (buffer)
+        return buffer;
+    
+    // First event on this thread, so set up a buffer.
+    // Dispatch queues come and go, so reuse one from a thread that's gone if we can.
+    pthread_mutex_lock(&ThreadBuffersLock);
+    if (!ThreadBuffers)
+        ThreadBuffers = new std::vector<ThreadBuffer *>();
+    for (unsigned int ii=0;ii<ThreadBuffers->size();ii++)
+        if ((*ThreadBuffers)[ii]->retired)
+        {
+            buffer = (*ThreadBuffers)[ii];
+            buffer->retired = false;
+            buffer->readFrom = buffer->written;
+            buffer->threadIndex = ++NumProfiledThreads;
+            break;
+        }
+    if (!buffer)
+    {
+        buffer = new ThreadBuffer(EventsPerThread,++NumProfiledThreads);
+        ThreadBuffers->push_back(buffer);
+    }
+    const char *name = (const char *)pthread_getspecific(ThreadNameKey);
+    if (name)
+        strncpy(buffer->name, name, sizeof(buffer->name)-1);
+    else
+        pthread_getname_np(pthread_self(), buffer->name, sizeof(buffer->name));
+    buffer->name[sizeof(buffer->name)-1] = 0;
+    if (!buffer->name[0])
+        snprintf(buffer->name, sizeof(buffer->name), "Thread %d", buffer->threadIndex);
+    pthread_mutex_unlock(&ThreadBuffersLock);
+    
+    pthread_setspecific(ThreadBufferKey, buffer);
+    return buffer;
+}
+    
+void Profiler::record(int zoneId,EventType type,int value)
+{
+    ThreadBuffer *buffer = getThreadBuffer();
+    
+    uint32_t which = buffer->written;
+    Event &event = buffer->events[which % buffer->events.size()];
+    event.time = mach_absolute_time();
+    event.value = value;
+    event.zoneId = zoneId;
+    event.type = type;
+    // The event has to be all there before readers can see it
+    __sync_synchronize();
+    buffer->written = which+1;
+}
+    
+void Profiler::clear()
+{
+    pthread_mutex_lock(&ThreadBuffersLock);
+    if (ThreadBuffers)
+        for (unsigned int ii=0;ii<ThreadBuffers->size();ii++)
+        {
+            ThreadBuffer *buffer = (*ThreadBuffers)[ii];
+            buffer->readFrom = buffer->written;
+        }
+    pthread_mutex_unlock(&ThreadBuffersLock);
+}
+    
+// Add a string to the JSON, escaping as we go
+static void AppendJSONString(std::string &json,const char *str)
+{
+    json += '"';
+    for (const char *ch = str; *ch; ch++)
+    {
+        if (*ch == '"' || *ch == '\\')
+            json += '\\';
+        if ((unsigned char)*ch < ' ')
+            continue;
+        json += *ch;
+    }
+    json += '"';
+}
+
+void Profiler::exportChromeTrace(std::string &json)
+{
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    double ticksToMicro = (double)timebase.numer / (double)timebase.denom / 1000.0;
+
+    // Copy out all the events first, so we know where time starts
+    std::vector<std::vector<Event> > threadEvents;
+    std::vector<int> threadIndices;
+    std::vector<std::string> threadNames;
+    pthread_mutex_lock(&ThreadBuffersLock);
+    if (ThreadBuffers)
+    {
+        threadEvents.resize(ThreadBuffers->size());
+        for (unsigned int ii=0;ii<ThreadBuffers->size();ii++)
+        {
+            ThreadBuffer *buffer = (*ThreadBuffers)[ii];
+            buffer->copyEvents(threadEvents[ii]);
+            threadIndices.push_back(buffer->threadIndex);
+            threadNames.push_back(buffer->name);
+        }
+    }
+    pthread_mutex_unlock(&ThreadBuffersLock);
+    
+    uint64_t startTime = 0;
+    bool haveStart = false;
+    for (unsigned int ii=0;ii<threadEvents.size();ii++)
+        if (!threadEvents[ii].empty() && (!haveStart || threadEvents[ii][0].time < startTime))
+        {
+            startTime = threadEvents[ii][0].time;
+            haveStart = true;
+        }
+    
+    json = "{\"traceEvents\":[\n";
+    bool first = true;
+    char str[256];
+    for (unsigned int ii=0;ii<threadEvents.size();ii++)
+    {
+        std::vector<Event> &events = threadEvents[ii];
+        int tid = threadIndices[ii];
+        
+        if (!first)
+            json += ",\n";
+        first = false;
+        snprintf(str, sizeof(str), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", tid);
+        json += str;
+        AppendJSONString(json, threadNames[ii].c_str());
+        json += "}}";
+        
+        // The beginnings of the oldest zones may have been overwritten
+        int depth = 0;
+        for (unsigned int jj=0;jj<events.size();jj++)
+        {
+            Event &event = events[jj];
+            const char *phase = NULL;
+            switch (event.type)
+            {
+                case EventBegin:
+                    depth++;
+                    phase = "B";
+                    break;
+                case EventEnd:
+                    if (depth == 0)
+                        continue;
+                    depth--;
+                    phase = "E";
+                    break;
+                case EventCount:
+                    phase = "C";
+                    break;
+            }
+            
+            json += ",\n{\"name\":";
+            AppendJSONString(json, ProfileZoneNames[event.zoneId]);
+            snprintf(str, sizeof(str), ",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":1,\"tid\":%d", phase, (event.time - startTime) * ticksToMicro, tid);
+            json += str;
+            if (event.type == EventCount)
+            {
+                snprintf(str, sizeof(str), ",\"args\":{\"value\":%d}", event.value);
+                json += str;
+            }
+            json += "}";
+        }
+    }
+    json += "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+    
+bool Profiler::writeChromeTrace(const char *fileName)
+{
+    std::string json;
+    exportChromeTrace(json);
+    
+    FILE *fp = fopen(fileName, "w");
+    if (!fp)
+        return false;
+    bool success = fwrite(json.c_str(), 1, json.size(), fp) == json.size();
+    fclose(fp);
+    
+    return success;
+}
+    
+}
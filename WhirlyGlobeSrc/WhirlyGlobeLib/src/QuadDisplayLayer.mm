@@ -25,11 +25,14 @@
 #import "UIImage+Stuff.h"
 #import "FlatMath.h"
 #import "VectorData.h"
+#import "Profiler.h"
 #import <boost/math/special_functions/fpclassify.hpp>
 
 using namespace Eigen;
 using namespace WhirlyKit;
 
+static ProfileZone EvalStepZone("QuadDisplayLayer::evalStep");
+
 @implementation WhirlyKitDisplaySolid
 
 // Let's not support tiles less than 10m on a side
@@ -126,6 +129,8 @@ static float const BoundsEps = 10.0 / EarthRadius;
     if (inMinZ == inMaxZ)
     dispSolid.surfNormals.reserve(srcPts.size());
 
+    std::vector<Point3d> edgeDispPts;
+    edgeDispPts.reserve(srcPts.size());
     for (unsigned int ii=0;ii<srcPts.size();ii++)
     {
 //        Point2f &planePt0 = planePts[ii], &planePt1 = planePts[(ii+1)%planePts.size()];
@@ -133,6 +138,7 @@ static float const BoundsEps = 10.0 / EarthRadius;
         Point3d edgeSrcPt = (srcPts[ii]+srcPts[(ii+1)%srcPts.size()])/2.0;
         Point3d localPt = CoordSystemConvert3d(srcSystem, displaySystem, edgeSrcPt);
         Point3d edgeDispPt = coordAdapter->localToDisplay(localPt);
+        edgeDispPts.push_back(edgeDispPt);
         Point3d dir = edgeDispPt-org;
         Point3d planePt(dir.dot(xAxis),dir.dot(yAxis),dir.dot(zAxis));
         // Update the min and max
@@ -227,6 +233,36 @@ static float const BoundsEps = 10.0 / EarthRadius;
             dispSolid.normals.push_back(norm);
         }
     }
+    
+    // Work out the horizon culling point from the samples we've got.
+    // The gaps between samples could bulge out a bit, so widen it by the biggest one.
+    Point3d radii;
+    if (!coordAdapter->isFlat() && coordAdapter->getEllipsoidRadii(radii))
+    {
+        std::vector<Point3d> scaledPts;
+        scaledPts.reserve(dispBounds.size()+edgeDispPts.size());
+        for (unsigned int ii=0;ii<dispBounds.size();ii++)
+            scaledPts.push_back(dispBounds[ii].cwiseQuotient(radii));
+        for (unsigned int ii=0;ii<edgeDispPts.size();ii++)
+            scaledPts.push_back(edgeDispPts[ii].cwiseQuotient(radii));
+        Point3d dir = dispMidPt.cwiseQuotient(radii).normalized();
+        double minCos = 1.0, maxRadius = 0.0, maxGap = 0.0;
+        for (unsigned int ii=0;ii<scaledPts.size();ii++)
+        {
+            minCos = std::min(minCos,dir.dot(scaledPts[ii].normalized()));
+            maxRadius = std::max(maxRadius,scaledPts[ii].norm());
+        }
+        for (unsigned int ii=0;ii<edgeDispPts.size();ii++)
+        {
+            Point3d edgePt = edgeDispPts[ii].cwiseQuotient(radii).normalized();
+            Point3d pt0 = dispBounds[ii].cwiseQuotient(radii).normalized();
+            Point3d pt1 = dispBounds[(ii+1)%srcPts.size()].cwiseQuotient(radii).normalized();
+            maxGap = std::max(maxGap,std::max(acos(std::min(edgePt.dot(pt0),1.0)),acos(std::min(edgePt.dot(pt1),1.0))));
+        }
+        Point3d horizonPt;
+        dispSolid.hasHorizonPt = CalcHorizonCullPoint(dir, acos(std::max(minCos,-1.0)) + maxGap, maxRadius, horizonPt);
+        dispSolid.horizonPt = horizonPt;
+    }
         
     return dispSolid;
 }
@@ -331,6 +367,12 @@ float PolyImportance(const std::vector<Point3d> &poly,const Point3d &norm,Whirly
             if (!isFacing)
                 return 0.0;
         }
+        
+        // Nothing to load if it's all behind the horizon
+        Point3d radii;
+        if (_hasHorizonPt && viewState.coordAdapter->getEllipsoidRadii(radii) &&
+            IsBelowHorizon(eyePos.cwiseQuotient(radii), _horizonPt))
+            return 0.0;
     }
     
     // Now work through the polygons and project each to the screen
@@ -550,6 +592,8 @@ float ScreenImportance(WhirlyKitViewState *viewState,WhirlyKit::Point2f frameSiz
 // Run the evaluation step for outstanding nodes
 - (void)evalStep:(id)Sender
 {
+    ProfileScope profile(EvalStepZone);
+    
     bool didSomething = false;
     
     // If the renderer hasn't been set up, punt and try again later
@@ -0,0 +1,1105 @@
+/*
+ *  RecordingGLBackend.mm
+ *  WhirlyGlobeLib
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <sys/time.h>
+#import <string.h>
+#import <stdio.h>
+#import <stdlib.h>
+#import <ctype.h>
+#import <algorithm>
+#import "RecordingGLBackend.h"
+
+namespace WhirlyKit
+{
+    
+static const char *GLCommandNames[RecordingGLBackend::GLCmdMax] = {
+    "glGenBuffers","glDeleteBuffers","glBindBuffer","glBufferData",
+    "glBufferSubData","glMapBufferOES","glUnmapBufferOES","glGenVertexArraysOES",
+    "glDeleteVertexArraysOES","glBindVertexArrayOES","glEnableVertexAttribArray","glDisableVertexAttribArray",
+    "glVertexAttribPointer","glVertexAttrib1f","glVertexAttrib2f","glVertexAttrib3f",
+    "glVertexAttrib4f","glGenTextures","glDeleteTextures","glActiveTexture",
+    "glBindTexture","glTexParameteri","glTexImage2D","glTexSubImage2D",
+    "glCompressedTexImage2D","glCompressedTexSubImage2D","glCopyTexSubImage2D","glGenerateMipmap",
+    "glCreateShader","glShaderSource","glCompileShader","glGetShaderiv",
+    "glGetShaderInfoLog","glDeleteShader","glCreateProgram","glAttachShader",
+    "glLinkProgram","glValidateProgram","glGetProgramiv","glGetProgramInfoLog",
+    "glDeleteProgram","glUseProgram","glGetActiveUniform","glGetActiveAttrib",
+    "glGetUniformLocation","glGetAttribLocation","glUniform1i","glUniform1f",
+    "glUniform2f","glUniform3f","glUniform4f","glUniformMatrix4fv",
+    "glEnable","glDisable","glDepthMask","glDepthFunc",
+    "glBlendFunc","glLineWidth","glViewport","glClearColor",
+    "glClear","glGenFramebuffers","glDeleteFramebuffers","glBindFramebuffer",
+    "glFramebufferRenderbuffer","glFramebufferTexture2D","glCheckFramebufferStatus","glGenRenderbuffers",
+    "glDeleteRenderbuffers","glBindRenderbuffer","glRenderbufferStorage","glGetRenderbufferParameteriv",
+    "glDiscardFramebufferEXT","glDrawArrays","glDrawElements","glFlush",
+    "glFinish","glGetError","glGetIntegerv","glGetString"
+};
+    
+const char *RecordingGLBackend::commandName(Command cmd)
+{
+    if (cmd < 0 || cmd >= GLCmdMax)
+        return "unknown";
+    return GLCommandNames[cmd];
+}
+    
+static double RecordingTimeNow()
+{
+    struct timeval tv;
+    gettimeofday(&tv,NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+    
+// Holds the lock for the length of a call
+class RecordingLock
+{
+public:
+    RecordingLock(pthread_mutex_t *lock) : lock(lock) { pthread_mutex_lock(lock); }
+    ~RecordingLock() { pthread_mutex_unlock(lock); }
+    pthread_mutex_t *lock;
+};
+    
+RecordingGLBackend::Stats::Stats()
+    : draws(0), vertices(0), stateChanges(0), redundantStateChanges(0), uniformUploads(0), redundantUniformUploads(0),
+      bufferBytes(0), textureBytes(0)
+{
+    for (unsigned int ii=0;ii<GLCmdMax;ii++)
+        calls[ii] = 0;
+}
+    
+int RecordingGLBackend::Stats::totalCalls() const
+{
+    int total = 0;
+    for (unsigned int ii=0;ii<GLCmdMax;ii++)
+        total += calls[ii];
+    return total;
+}
+    
+RecordingGLBackend::RecordingGLBackend()
+    : keepEvents(false), nextName(1), fbWidth(1024), fbHeight(768), arrayBuffer(0), elementBuffer(0), vertexArray(0),
+      activeUnit(GL_TEXTURE0), curProgram(0), curRenderbuffer(0), curFramebuffer(0)
+{
+    pthread_mutex_init(&lock, NULL);
+    startTime = RecordingTimeNow();
+}
+    
+RecordingGLBackend::~RecordingGLBackend()
+{
+    pthread_mutex_destroy(&lock);
+}
+    
+void RecordingGLBackend::setKeepEvents(bool keep)
+{
+    pthread_mutex_lock(&lock);
+    keepEvents = keep;
+    pthread_mutex_unlock(&lock);
+}
+    
+void RecordingGLBackend::setFramebufferSize(int width,int height)
+{
+    pthread_mutex_lock(&lock);
+    fbWidth = width;
+    fbHeight = height;
+    pthread_mutex_unlock(&lock);
+}
+    
+void RecordingGLBackend::reset()
+{
+    pthread_mutex_lock(&lock);
+    stats = Stats();
+    events.clear();
+    startTime = RecordingTimeNow();
+    pthread_mutex_unlock(&lock);
+}
+    
+RecordingGLBackend::Stats RecordingGLBackend::getStats()
+{
+    pthread_mutex_lock(&lock);
+    Stats ret = stats;
+    pthread_mutex_unlock(&lock);
+    
+    return ret;
+}
+    
+std::vector<RecordingGLBackend::Event> RecordingGLBackend::getEvents()
+{
+    pthread_mutex_lock(&lock);
+    std::vector<Event> ret = events;
+    pthread_mutex_unlock(&lock);
+    
+    return ret;
+}
+    
+void RecordingGLBackend::record(Command cmd)
+{
+    stats.calls[cmd]++;
+    if (keepEvents)
+    {
+        Event event;
+        event.cmd = cmd;
+        event.time = RecordingTimeNow() - startTime;
+        events.push_back(event);
+    }
+}
+    
+void RecordingGLBackend::recordState(Command cmd,bool same)
+{
+    record(cmd);
+    stats.stateChanges++;
+    if (same)
+        stats.redundantStateChanges++;
+}
+    
+void RecordingGLBackend::recordUniform(Command cmd,GLint location,const GLfloat *vals,int numVals)
+{
+    record(cmd);
+    stats.uniformUploads++;
+    std::vector<GLfloat> &last = uniformVals[std::pair<GLuint,GLint>(curProgram,location)];
+    if ((int)last.size() == numVals && !memcmp(&last[0],vals,numVals*sizeof(GLfloat)))
+        stats.redundantUniformUploads++;
+    else
+        last.assign(vals,vals+numVals);
+}
+    
+void RecordingGLBackend::recordStateVec(Command cmd,GLenum which,const GLfloat *vals,int numVals)
+{
+    std::vector<GLfloat> &last = stateVecs[which];
+    recordState(cmd,(int)last.size() == numVals && !memcmp(&last[0],vals,numVals*sizeof(GLfloat)));
+    last.assign(vals,vals+numVals);
+}
+    
+void RecordingGLBackend::genNames(Command cmd,GLsizei n,GLuint *names)
+{
+    record(cmd);
+    for (GLsizei ii=0;ii<n;ii++)
+        names[ii] = nextName++;
+}
+    
+long RecordingGLBackend::textureBytes(GLsizei width,GLsizei height,GLenum format,GLenum type)
+{
+    int pixelSize = 4;
+    if (type == GL_UNSIGNED_SHORT_5_6_5 || type == GL_UNSIGNED_SHORT_4_4_4_4 || type == GL_UNSIGNED_SHORT_5_5_5_1)
+        pixelSize = 2;
+    else {
+        switch (format)
+        {
+            case GL_RGB: pixelSize = 3; break;
+            case GL_LUMINANCE_ALPHA: pixelSize = 2; break;
+            case GL_LUMINANCE:
+            case GL_ALPHA: pixelSize = 1; break;
+            default: break;
+        }
+    }
+    
+    return (long)width * height * pixelSize;
+}
+    
+// Cut GLSL source up into identifiers, numbers and single punctuation characters.
+// Comments and preprocessor lines are dropped.
+static void TokenizeShader(const std::string &src,std::vector<std::string> &tokens)
+{
+    unsigned int ii = 0;
+    while (ii < src.size())
+    {
+        char c = src[ii];
+        if (c == '/' && ii+1 < src.size() && src[ii+1] == '/')
+        {
+            while (ii < src.size() && src[ii] != '\n')
+                ii++;
+        } else if (c == '/' && ii+1 < src.size() && src[ii+1] == '*') {
+            size_t end = src.find("*/",ii+2);
+            ii = (end == std::string::npos) ? (unsigned int)src.size() : (unsigned int)end+2;
+        } else if (c == '#') {
+            while (ii < src.size() && src[ii] != '\n')
+                ii++;
+        } else if (isalnum(c) || c == '_') {
+            unsigned int start = ii;
+            while (ii < src.size() && (isalnum(src[ii]) || src[ii] == '_'))
+                ii++;
+            tokens.push_back(src.substr(start,ii-start));
+        } else {
+            if (!isspace(c))
+                tokens.push_back(std::string(1,c));
+            ii++;
+        }
+    }
+}
+    
+// GL type for a GLSL type name, or 0 if it's not a basic type
+static GLenum ShaderTypeToGL(const std::string &type)
+{
+    if (type == "float") return GL_FLOAT;
+    if (type == "vec2") return GL_FLOAT_VEC2;
+    if (type == "vec3") return GL_FLOAT_VEC3;
+    if (type == "vec4") return GL_FLOAT_VEC4;
+    if (type == "mat2") return GL_FLOAT_MAT2;
+    if (type == "mat3") return GL_FLOAT_MAT3;
+    if (type == "mat4") return GL_FLOAT_MAT4;
+    if (type == "int") return GL_INT;
+    if (type == "ivec2") return GL_INT_VEC2;
+    if (type == "ivec3") return GL_INT_VEC3;
+    if (type == "ivec4") return GL_INT_VEC4;
+    if (type == "bool") return GL_BOOL;
+    if (type == "sampler2D") return GL_SAMPLER_2D;
+    if (type == "samplerCube") return GL_SAMPLER_CUBE;
+    return 0;
+}
+    
+// Add a variable, unless the other shader already declared it
+static void AddShaderVariable(std::vector<std::string> &names,std::vector<GLint> &sizes,std::vector<GLenum> &types,const std::string &name,GLint size,GLenum type)
+{
+    for (unsigned int ii=0;ii<names.size();ii++)
+        if (names[ii] == name)
+            return;
+    names.push_back(name);
+    sizes.push_back(size);
+    types.push_back(type);
+}
+    
+void RecordingGLBackend::parseShaders(ProgramInfo &info)
+{
+    // This handles the declarations our shaders use: basic types, arrays of them,
+    //  structs and arrays of structs.  Struct members get reported one by one
+    //  like a real driver does, as name[index].member.
+    std::vector<std::string> uniNames,attrNames;
+    std::vector<GLint> uniSizes,attrSizes;
+    std::vector<GLenum> uniTypes,attrTypes;
+    for (unsigned int si=0;si<info.shaders.size();si++)
+    {
+        std::vector<std::string> tokens;
+        TokenizeShader(shaderSources[info.shaders[si]],tokens);
+        std::map<std::string,std::vector<std::pair<std::string,GLenum> > > structs;
+        for (unsigned int ti=0;ti<tokens.size();ti++)
+        {
+            if (tokens[ti] == "struct" && ti+2 < tokens.size() && tokens[ti+2] == "{")
+            {
+                std::vector<std::pair<std::string,GLenum> > &members = structs[tokens[ti+1]];
+                ti += 3;
+                while (ti+2 < tokens.size() && tokens[ti] != "}")
+                {
+                    // Skip precision qualifiers
+                    while (ti < tokens.size() && (tokens[ti] == "lowp" || tokens[ti] == "mediump" || tokens[ti] == "highp"))
+                        ti++;
+                    if (ti+2 < tokens.size())
+                        members.push_back(std::pair<std::string,GLenum>(tokens[ti+1],ShaderTypeToGL(tokens[ti])));
+                    while (ti < tokens.size() && tokens[ti] != ";")
+                        ti++;
+                    ti++;
+                }
+                continue;
+            }
+            
+            bool isUniform = tokens[ti] == "uniform";
+            if (!isUniform && tokens[ti] != "attribute")
+                continue;
+            ti++;
+            while (ti < tokens.size() && (tokens[ti] == "lowp" || tokens[ti] == "mediump" || tokens[ti] == "highp"))
+                ti++;
+            if (ti+1 >= tokens.size())
+                break;
+            std::string type = tokens[ti], name = tokens[ti+1];
+            ti += 2;
+            int arraySize = 0;
+            if (ti+2 < tokens.size() && tokens[ti] == "[")
+            {
+                arraySize = atoi(tokens[ti+1].c_str());
+                ti += 3;
+            }
+            
+            std::vector<std::string> &names = isUniform ? uniNames : attrNames;
+            std::vector<GLint> &sizes = isUniform ? uniSizes : attrSizes;
+            std::vector<GLenum> &types = isUniform ? uniTypes : attrTypes;
+            if (structs.find(type) != structs.end())
+            {
+                const std::vector<std::pair<std::string,GLenum> > &members = structs[type];
+                for (int ai=0;ai<std::max(arraySize,1);ai++)
+                    for (unsigned int mi=0;mi<members.size();mi++)
+                    {
+                        char prefix[256];
+                        if (arraySize > 0)
+                            snprintf(prefix, 255, "%s[%d].", name.c_str(), ai);
+                        else
+                            snprintf(prefix, 255, "%s.", name.c_str());
+                        AddShaderVariable(names, sizes, types, prefix + members[mi].first, 1, members[mi].second);
+                    }
+            } else if (arraySize > 0)
+                AddShaderVariable(names, sizes, types, name + "[0]", arraySize, ShaderTypeToGL(type));
+            else
+                AddShaderVariable(names, sizes, types, name, 1, ShaderTypeToGL(type));
+        }
+    }
+    
+    info.uniforms.resize(uniNames.size());
+    for (unsigned int ii=0;ii<uniNames.size();ii++)
+    {
+        info.uniforms[ii].name = uniNames[ii];
+        info.uniforms[ii].size = uniSizes[ii];
+        info.uniforms[ii].type = uniTypes[ii];
+    }
+    info.attrs.resize(attrNames.size());
+    for (unsigned int ii=0;ii<attrNames.size();ii++)
+    {
+        info.attrs[ii].name = attrNames[ii];
+        info.attrs[ii].size = attrSizes[ii];
+        info.attrs[ii].type = attrTypes[ii];
+    }
+}
+    
+void RecordingGLBackend::genBuffers(GLsizei n,GLuint *buffers)
+{
+    RecordingLock locker(&lock);
+    genNames(GLCmdGenBuffers,n,buffers);
+}
+    
+void RecordingGLBackend::deleteBuffers(GLsizei n,const GLuint *buffers)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdDeleteBuffers);
+    for (GLsizei ii=0;ii<n;ii++)
+    {
+        bufferSizes.erase(buffers[ii]);
+        if (arrayBuffer == buffers[ii])
+            arrayBuffer = 0;
+        if (elementBuffer == buffers[ii])
+            elementBuffer = 0;
+        // Deleting a buffer unbinds it from the current vertex array only
+        if (vertexArrayElements[vertexArray] == buffers[ii])
+            vertexArrayElements[vertexArray] = 0;
+    }
+}
+    
+void RecordingGLBackend::bindBuffer(GLenum target,GLuint buffer)
+{
+    RecordingLock locker(&lock);
+    GLuint &bound = (target == GL_ELEMENT_ARRAY_BUFFER) ? elementBuffer : arrayBuffer;
+    recordState(GLCmdBindBuffer,bound == buffer);
+    bound = buffer;
+    if (target == GL_ELEMENT_ARRAY_BUFFER)
+        vertexArrayElements[vertexArray] = buffer;
+}
+    
+void RecordingGLBackend::bufferData(GLenum target,GLsizeiptr size,const GLvoid *data,GLenum usage)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdBufferData);
+    bufferSizes[(target == GL_ELEMENT_ARRAY_BUFFER) ? elementBuffer : arrayBuffer] = size;
+    if (data)
+        stats.bufferBytes += size;
+}
+    
+void RecordingGLBackend::bufferSubData(GLenum target,GLintptr offset,GLsizeiptr size,const GLvoid *data)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdBufferSubData);
+    stats.bufferBytes += size;
+}
+    
+GLvoid *RecordingGLBackend::mapBuffer(GLenum target,GLenum access)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdMapBuffer);
+    // Hand back somewhere to write that's as big as the buffer
+    long size = bufferSizes[(target == GL_ELEMENT_ARRAY_BUFFER) ? elementBuffer : arrayBuffer];
+    mappedData.resize(std::max(size,1L));
+    return &mappedData[0];
+}
+    
+GLboolean RecordingGLBackend::unmapBuffer(GLenum target)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdUnmapBuffer);
+    stats.bufferBytes += bufferSizes[(target == GL_ELEMENT_ARRAY_BUFFER) ? elementBuffer : arrayBuffer];
+    return GL_TRUE;
+}
+    
+void RecordingGLBackend::genVertexArrays(GLsizei n,GLuint *arrays)
+{
+    RecordingLock locker(&lock);
+    genNames(GLCmdGenVertexArrays,n,arrays);
+}
+    
+void RecordingGLBackend::deleteVertexArrays(GLsizei n,const GLuint *arrays)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdDeleteVertexArrays);
+    for (GLsizei ii=0;ii<n;ii++)
+    {
+        // The default vertex array can't be deleted
+        if (arrays[ii] == 0)
+            continue;
+        vertexArrayElements.erase(arrays[ii]);
+        if (vertexArray == arrays[ii])
+        {
+            vertexArray = 0;
+            elementBuffer = vertexArrayElements[0];
+        }
+    }
+}
+    
+void RecordingGLBackend::bindVertexArray(GLuint array)
+{
+    RecordingLock locker(&lock);
+    recordState(GLCmdBindVertexArray,vertexArray == array);
+    vertexArray = array;
+    // The element buffer binding is part of the vertex array
+    elementBuffer = vertexArrayElements[array];
+}
+    
+void RecordingGLBackend::enableVertexAttribArray(GLuint index)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdEnableVertexAttribArray);
+}
+    
+void RecordingGLBackend::disableVertexAttribArray(GLuint index)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdDisableVertexAttribArray);
+}
+    
+void RecordingGLBackend::vertexAttribPointer(GLuint index,GLint size,GLenum type,GLboolean normalized,GLsizei stride,const GLvoid *ptr)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdVertexAttribPointer);
+}
+    
+void RecordingGLBackend::vertexAttrib1f(GLuint index,GLfloat x)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdVertexAttrib1f);
+}
+    
+void RecordingGLBackend::vertexAttrib2f(GLuint index,GLfloat x,GLfloat y)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdVertexAttrib2f);
+}
+    
+void RecordingGLBackend::vertexAttrib3f(GLuint index,GLfloat x,GLfloat y,GLfloat z)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdVertexAttrib3f);
+}
+    
+void RecordingGLBackend::vertexAttrib4f(GLuint index,GLfloat x,GLfloat y,GLfloat z,GLfloat w)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdVertexAttrib4f);
+}
+    
+void RecordingGLBackend::genTextures(GLsizei n,GLuint *textures)
+{
+    RecordingLock locker(&lock);
+    genNames(GLCmdGenTextures,n,textures);
+}
+    
+void RecordingGLBackend::deleteTextures(GLsizei n,const GLuint *textures)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdDeleteTextures);
+    for (GLsizei ii=0;ii<n;ii++)
+        for (std::map<GLenum,GLuint>::iterator it = boundTextures.begin();it != boundTextures.end();++it)
+            if (it->second == textures[ii])
+                it->second = 0;
+}
+    
+void RecordingGLBackend::activeTexture(GLenum texture)
+{
+    RecordingLock locker(&lock);
+    recordState(GLCmdActiveTexture,activeUnit == texture);
+    activeUnit = texture;
+}
+    
+void RecordingGLBackend::bindTexture(GLenum target,GLuint texture)
+{
+    RecordingLock locker(&lock);
+    std::map<GLenum,GLuint>::iterator it = boundTextures.find(activeUnit);
+    recordState(GLCmdBindTexture,it != boundTextures.end() && it->second == texture);
+    boundTextures[activeUnit] = texture;
+}
+    
+void RecordingGLBackend::texParameteri(GLenum target,GLenum pname,GLint param)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdTexParameteri);
+}
+    
+void RecordingGLBackend::texImage2D(GLenum target,GLint level,GLint internalformat,GLsizei width,GLsizei height,GLint border,GLenum format,GLenum type,const GLvoid *pixels)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdTexImage2D);
+    if (pixels)
+        stats.textureBytes += textureBytes(width,height,format,type);
+}
+    
+void RecordingGLBackend::texSubImage2D(GLenum target,GLint level,GLint xoffset,GLint yoffset,GLsizei width,GLsizei height,GLenum format,GLenum type,const GLvoid *pixels)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdTexSubImage2D);
+    if (pixels)
+        stats.textureBytes += textureBytes(width,height,format,type);
+}
+    
+void RecordingGLBackend::compressedTexImage2D(GLenum target,GLint level,GLenum internalformat,GLsizei width,GLsizei height,GLint border,GLsizei imageSize,const GLvoid *data)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdCompressedTexImage2D);
+    stats.textureBytes += imageSize;
+}
+    
+void RecordingGLBackend::compressedTexSubImage2D(GLenum target,GLint level,GLint xoffset,GLint yoffset,GLsizei width,GLsizei height,GLenum format,GLsizei imageSize,const GLvoid *data)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdCompressedTexSubImage2D);
+    stats.textureBytes += imageSize;
+}
+    
+void RecordingGLBackend::copyTexSubImage2D(GLenum target,GLint level,GLint xoffset,GLint yoffset,GLint x,GLint y,GLsizei width,GLsizei height)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdCopyTexSubImage2D);
+}
+    
+void RecordingGLBackend::generateMipmap(GLenum target)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdGenerateMipmap);
+}
+    
+GLuint RecordingGLBackend::createShader(GLenum type)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdCreateShader);
+    GLuint shader = nextName++;
+    shaderSources[shader] = "";
+    return shader;
+}
+    
+void RecordingGLBackend::shaderSource(GLuint shader,GLsizei count,const GLchar **string,const GLint *length)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdShaderSource);
+    std::string &src = shaderSources[shader];
+    src.clear();
+    for (GLsizei ii=0;ii<count;ii++)
+    {
+        if (length && length[ii] >= 0)
+            src.append(string[ii],length[ii]);
+        else
+            src.append(string[ii]);
+        src.append("\n");
+    }
+}
+    
+void RecordingGLBackend::compileShader(GLuint shader)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdCompileShader);
+}
+    
+void RecordingGLBackend::getShaderiv(GLuint shader,GLenum pname,GLint *params)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdGetShaderiv);
+    switch (pname)
+    {
+        case GL_COMPILE_STATUS:
+            *params = GL_TRUE;
+            break;
+        case GL_SHADER_SOURCE_LENGTH:
+            *params = (GLint)shaderSources[shader].size()+1;
+            break;
+        default:
+            *params = 0;
+            break;
+    }
+}
+    
+void RecordingGLBackend::getShaderInfoLog(GLuint shader,GLsizei bufsize,GLsizei *length,GLchar *infolog)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdGetShaderInfoLog);
+    if (length)
+        *length = 0;
+    if (bufsize > 0)
+        infolog[0] = 0;
+}
+    
+void RecordingGLBackend::deleteShader(GLuint shader)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdDeleteShader);
+    // Programs parse the source when they link, so we can let it go
+    shaderSources.erase(shader);
+}
+    
+GLuint RecordingGLBackend::createProgram()
+{
+    RecordingLock locker(&lock);
+    record(GLCmdCreateProgram);
+    GLuint program = nextName++;
+    programs[program] = ProgramInfo();
+    return program;
+}
+    
+void RecordingGLBackend::attachShader(GLuint program,GLuint shader)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdAttachShader);
+    programs[program].shaders.push_back(shader);
+}
+    
+void RecordingGLBackend::linkProgram(GLuint program)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdLinkProgram);
+    parseShaders(programs[program]);
+}
+    
+void RecordingGLBackend::validateProgram(GLuint program)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdValidateProgram);
+}
+    
+void RecordingGLBackend::getProgramiv(GLuint program,GLenum pname,GLint *params)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdGetProgramiv);
+    const ProgramInfo &info = programs[program];
+    switch (pname)
+    {
+        case GL_LINK_STATUS:
+        case GL_VALIDATE_STATUS:
+            *params = GL_TRUE;
+            break;
+        case GL_ACTIVE_UNIFORMS:
+            *params = (GLint)info.uniforms.size();
+            break;
+        case GL_ACTIVE_ATTRIBUTES:
+            *params = (GLint)info.attrs.size();
+            break;
+        case GL_ACTIVE_UNIFORM_MAX_LENGTH:
+        case GL_ACTIVE_ATTRIBUTE_MAX_LENGTH:
+            *params = 256;
+            break;
+        default:
+            *params = 0;
+            break;
+    }
+}
+    
+void RecordingGLBackend::getProgramInfoLog(GLuint program,GLsizei bufsize,GLsizei *length,GLchar *infolog)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdGetProgramInfoLog);
+    if (length)
+        *length = 0;
+    if (bufsize > 0)
+        infolog[0] = 0;
+}
+    
+void RecordingGLBackend::deleteProgram(GLuint program)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdDeleteProgram);
+    programs.erase(program);
+    if (curProgram == program)
+        curProgram = 0;
+}
+    
+void RecordingGLBackend::useProgram(GLuint program)
+{
+    RecordingLock locker(&lock);
+    recordState(GLCmdUseProgram,curProgram == program);
+    curProgram = program;
+}
+    
+// Copy out one of the variables the way glGetActiveUniform does
+static void ReportVariable(const std::vector<RecordingGLBackend::Variable> &vars,GLuint index,GLsizei bufsize,GLsizei *length,GLint *size,GLenum *type,GLchar *name)
+{
+    if (index >= vars.size())
+    {
+        if (length)
+            *length = 0;
+        if (bufsize > 0)
+            name[0] = 0;
+        *size = 0;
+        *type = 0;
+        return;
+    }
+    
+    const RecordingGLBackend::Variable &var = vars[index];
+    GLsizei len = std::min((GLsizei)var.name.size(),bufsize-1);
+    if (len > 0)
+    {
+        memcpy(name,var.name.c_str(),len);
+        name[len] = 0;
+    }
+    if (length)
+        *length = len;
+    *size = var.size;
+    *type = var.type;
+}
+    
+void RecordingGLBackend::getActiveUniform(GLuint program,GLuint index,GLsizei bufsize,GLsizei *length,GLint *size,GLenum *type,GLchar *name)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdGetActiveUniform);
+    ReportVariable(programs[program].uniforms,index,bufsize,length,size,type,name);
+}
+    
+void RecordingGLBackend::getActiveAttrib(GLuint program,GLuint index,GLsizei bufsize,GLsizei *length,GLint *size,GLenum *type,GLchar *name)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdGetActiveAttrib);
+    ReportVariable(programs[program].attrs,index,bufsize,length,size,type,name);
+}
+    
+// Location of a variable is just its index.  Arrays can be asked for with or without the [0].
+static int FindVariable(const std::vector<RecordingGLBackend::Variable> &vars,const GLchar *name)
+{
+    std::string theName(name);
+    for (unsigned int ii=0;ii<vars.size();ii++)
+    {
+        const std::string &varName = vars[ii].name;
+        if (varName == theName ||
+            (varName.size() == theName.size()+3 && !varName.compare(0,theName.size(),theName) && !varName.compare(theName.size(),3,"[0]")))
+            return ii;
+    }
+    
+    return -1;
+}
+    
+int RecordingGLBackend::getUniformLocation(GLuint program,const GLchar *name)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdGetUniformLocation);
+    return FindVariable(programs[program].uniforms,name);
+}
+    
+int RecordingGLBackend::getAttribLocation(GLuint program,const GLchar *name)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdGetAttribLocation);
+    return FindVariable(programs[program].attrs,name);
+}
+    
+void RecordingGLBackend::uniform1i(GLint location,GLint x)
+{
+    RecordingLock locker(&lock);
+    GLfloat vals[1] = {(GLfloat)x};
+    recordUniform(GLCmdUniform1i,location,vals,1);
+}
+    
+void RecordingGLBackend::uniform1f(GLint location,GLfloat x)
+{
+    RecordingLock locker(&lock);
+    GLfloat vals[1] = {x};
+    recordUniform(GLCmdUniform1f,location,vals,1);
+}
+    
+void RecordingGLBackend::uniform2f(GLint location,GLfloat x,GLfloat y)
+{
+    RecordingLock locker(&lock);
+    GLfloat vals[2] = {x,y};
+    recordUniform(GLCmdUniform2f,location,vals,2);
+}
+    
+void RecordingGLBackend::uniform3f(GLint location,GLfloat x,GLfloat y,GLfloat z)
+{
+    RecordingLock locker(&lock);
+    GLfloat vals[3] = {x,y,z};
+    recordUniform(GLCmdUniform3f,location,vals,3);
+}
+    
+void RecordingGLBackend::uniform4f(GLint location,GLfloat x,GLfloat y,GLfloat z,GLfloat w)
+{
+    RecordingLock locker(&lock);
+    GLfloat vals[4] = {x,y,z,w};
+    recordUniform(GLCmdUniform4f,location,vals,4);
+}
+    
+void RecordingGLBackend::uniformMatrix4fv(GLint location,GLsizei count,GLboolean transpose,const GLfloat *value)
+{
+    RecordingLock locker(&lock);
+    recordUniform(GLCmdUniformMatrix4fv,location,value,16*count);
+}
+    
+void RecordingGLBackend::enable(GLenum cap)
+{
+    RecordingLock locker(&lock);
+    std::map<GLenum,bool>::iterator it = caps.find(cap);
+    recordState(GLCmdEnable,it != caps.end() && it->second);
+    caps[cap] = true;
+}
+    
+void RecordingGLBackend::disable(GLenum cap)
+{
+    RecordingLock locker(&lock);
+    std::map<GLenum,bool>::iterator it = caps.find(cap);
+    recordState(GLCmdDisable,it != caps.end() && !it->second);
+    caps[cap] = false;
+}
+    
+void RecordingGLBackend::depthMask(GLboolean flag)
+{
+    RecordingLock locker(&lock);
+    std::map<GLenum,GLint>::iterator it = stateVals.find(GL_DEPTH_WRITEMASK);
+    recordState(GLCmdDepthMask,it != stateVals.end() && it->second == flag);
+    stateVals[GL_DEPTH_WRITEMASK] = flag;
+}
+    
+void RecordingGLBackend::depthFunc(GLenum func)
+{
+    RecordingLock locker(&lock);
+    std::map<GLenum,GLint>::iterator it = stateVals.find(GL_DEPTH_FUNC);
+    recordState(GLCmdDepthFunc,it != stateVals.end() && it->second == (GLint)func);
+    stateVals[GL_DEPTH_FUNC] = func;
+}
+    
+void RecordingGLBackend::blendFunc(GLenum sfactor,GLenum dfactor)
+{
+    RecordingLock locker(&lock);
+    std::map<GLenum,GLint>::iterator src = stateVals.find(GL_BLEND_SRC_RGB);
+    std::map<GLenum,GLint>::iterator dst = stateVals.find(GL_BLEND_DST_RGB);
+    recordState(GLCmdBlendFunc,src != stateVals.end() && dst != stateVals.end() && src->second == (GLint)sfactor && dst->second == (GLint)dfactor);
+    stateVals[GL_BLEND_SRC_RGB] = sfactor;
+    stateVals[GL_BLEND_DST_RGB] = dfactor;
+}
+    
+void RecordingGLBackend::lineWidth(GLfloat width)
+{
+    RecordingLock locker(&lock);
+    // Line widths are always whole pixels on the devices we care about
+    std::map<GLenum,GLint>::iterator it = stateVals.find(GL_LINE_WIDTH);
+    GLint pixWidth = (GLint)(width*256);
+    recordState(GLCmdLineWidth,it != stateVals.end() && it->second == pixWidth);
+    stateVals[GL_LINE_WIDTH] = pixWidth;
+}
+    
+void RecordingGLBackend::viewport(GLint x,GLint y,GLsizei width,GLsizei height)
+{
+    RecordingLock locker(&lock);
+    GLfloat vals[4] = {(GLfloat)x,(GLfloat)y,(GLfloat)width,(GLfloat)height};
+    recordStateVec(GLCmdViewport,GL_VIEWPORT,vals,4);
+}
+    
+void RecordingGLBackend::clearColor(GLclampf red,GLclampf green,GLclampf blue,GLclampf alpha)
+{
+    RecordingLock locker(&lock);
+    GLfloat vals[4] = {red,green,blue,alpha};
+    recordStateVec(GLCmdClearColor,GL_COLOR_CLEAR_VALUE,vals,4);
+}
+    
+void RecordingGLBackend::clear(GLbitfield mask)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdClear);
+}
+    
+void RecordingGLBackend::genFramebuffers(GLsizei n,GLuint *framebuffers)
+{
+    RecordingLock locker(&lock);
+    genNames(GLCmdGenFramebuffers,n,framebuffers);
+}
+    
+void RecordingGLBackend::deleteFramebuffers(GLsizei n,const GLuint *framebuffers)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdDeleteFramebuffers);
+    for (GLsizei ii=0;ii<n;ii++)
+        if (curFramebuffer == framebuffers[ii])
+            curFramebuffer = 0;
+}
+    
+void RecordingGLBackend::bindFramebuffer(GLenum target,GLuint framebuffer)
+{
+    RecordingLock locker(&lock);
+    recordState(GLCmdBindFramebuffer,curFramebuffer == framebuffer);
+    curFramebuffer = framebuffer;
+}
+    
+void RecordingGLBackend::framebufferRenderbuffer(GLenum target,GLenum attachment,GLenum renderbuffertarget,GLuint renderbuffer)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdFramebufferRenderbuffer);
+}
+    
+void RecordingGLBackend::framebufferTexture2D(GLenum target,GLenum attachment,GLenum textarget,GLuint texture,GLint level)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdFramebufferTexture2D);
+}
+    
+GLenum RecordingGLBackend::checkFramebufferStatus(GLenum target)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdCheckFramebufferStatus);
+    return GL_FRAMEBUFFER_COMPLETE;
+}
+    
+void RecordingGLBackend::genRenderbuffers(GLsizei n,GLuint *renderbuffers)
+{
+    RecordingLock locker(&lock);
+    genNames(GLCmdGenRenderbuffers,n,renderbuffers);
+}
+    
+void RecordingGLBackend::deleteRenderbuffers(GLsizei n,const GLuint *renderbuffers)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdDeleteRenderbuffers);
+    for (GLsizei ii=0;ii<n;ii++)
+    {
+        renderbufferSizes.erase(renderbuffers[ii]);
+        if (curRenderbuffer == renderbuffers[ii])
+            curRenderbuffer = 0;
+    }
+}
+    
+void RecordingGLBackend::bindRenderbuffer(GLenum target,GLuint renderbuffer)
+{
+    RecordingLock locker(&lock);
+    recordState(GLCmdBindRenderbuffer,curRenderbuffer == renderbuffer);
+    curRenderbuffer = renderbuffer;
+}
+    
+void RecordingGLBackend::renderbufferStorage(GLenum target,GLenum internalformat,GLsizei width,GLsizei height)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdRenderbufferStorage);
+    renderbufferSizes[curRenderbuffer] = std::pair<GLsizei,GLsizei>(width,height);
+}
+    
+void RecordingGLBackend::getRenderbufferParameteriv(GLenum target,GLenum pname,GLint *params)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdGetRenderbufferParameteriv);
+    // Renderbuffers that came from a layer don't have storage we know about, so they're the framebuffer size
+    std::map<GLuint,std::pair<GLsizei,GLsizei> >::iterator it = renderbufferSizes.find(curRenderbuffer);
+    GLsizei width = (it != renderbufferSizes.end()) ? it->second.first : fbWidth;
+    GLsizei height = (it != renderbufferSizes.end()) ? it->second.second : fbHeight;
+    switch (pname)
+    {
+        case GL_RENDERBUFFER_WIDTH:
+            *params = width;
+            break;
+        case GL_RENDERBUFFER_HEIGHT:
+            *params = height;
+            break;
+        default:
+            *params = 0;
+            break;
+    }
+}
+    
+void RecordingGLBackend::discardFramebuffer(GLenum target,GLsizei numAttachments,const GLenum *attachments)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdDiscardFramebuffer);
+}
+    
+void RecordingGLBackend::drawArrays(GLenum mode,GLint first,GLsizei count)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdDrawArrays);
+    stats.draws++;
+    stats.vertices += count;
+}
+    
+void RecordingGLBackend::drawElements(GLenum mode,GLsizei count,GLenum type,const GLvoid *indices)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdDrawElements);
+    stats.draws++;
+    stats.vertices += count;
+}
+    
+void RecordingGLBackend::flush()
+{
+    RecordingLock locker(&lock);
+    record(GLCmdFlush);
+}
+    
+void RecordingGLBackend::finish()
+{
+    RecordingLock locker(&lock);
+    record(GLCmdFinish);
+}
+    
+GLenum RecordingGLBackend::getError()
+{
+    RecordingLock locker(&lock);
+    record(GLCmdGetError);
+    return GL_NO_ERROR;
+}
+    
+void RecordingGLBackend::getIntegerv(GLenum pname,GLint *params)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdGetIntegerv);
+    switch (pname)
+    {
+        case GL_MAX_TEXTURE_SIZE:
+            *params = 4096;
+            break;
+        case GL_FRAMEBUFFER_BINDING:
+            *params = curFramebuffer;
+            break;
+        case GL_CURRENT_PROGRAM:
+            *params = curProgram;
+            break;
+        case GL_VERTEX_ARRAY_BINDING_OES:
+            *params = vertexArray;
+            break;
+        case GL_ARRAY_BUFFER_BINDING:
+            *params = arrayBuffer;
+            break;
+        case GL_ELEMENT_ARRAY_BUFFER_BINDING:
+            *params = elementBuffer;
+            break;
+        case GL_ACTIVE_TEXTURE:
+            *params = activeUnit;
+            break;
+        case GL_TEXTURE_BINDING_2D:
+            *params = boundTextures[activeUnit];
+            break;
+        default:
+            *params = 0;
+            break;
+    }
+}
+    
+const GLubyte *RecordingGLBackend::getString(GLenum name)
+{
+    RecordingLock locker(&lock);
+    record(GLCmdGetString);
+    switch (name)
+    {
+        case GL_EXTENSIONS:
+            // The ones we'd find on any device we run on
+            return (const GLubyte *)"GL_OES_element_index_uint GL_OES_mapbuffer GL_OES_vertex_array_object GL_EXT_discard_framebuffer";
+        case GL_VERSION:
+            return (const GLubyte *)"OpenGL ES 2.0 Recording";
+        default:
+            return (const GLubyte *)"Recording";
+    }
+}
+    
+}
@@ -0,0 +1,246 @@
+/*
+ *  RectPacker.mm
+ *  WhirlyGlobeLib
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <algorithm>
+#import <climits>
+#import "RectPacker.h"
+
+namespace WhirlyKit
+{
+    
+RectPacker::RectPacker(int width,int height)
+    : width(width), height(height), usedArea(0)
+{
+    if (width > 0 && height > 0)
+    {
+        cells.resize(width*height,false);
+        freeRects.push_back(Rect(0,0,width,height));
+    }
+}
+    
+bool RectPacker::findSpot(int sizeX,int sizeY,Rect &rect)
+{
+    if (sizeX <= 0 || sizeY <= 0 || sizeX > width || sizeY > height)
+        return false;
+    if (usedArea + sizeX*sizeY > width*height)
+        return false;
+    
+    // Best short side fit
+    int bestShort = INT_MAX, bestLong = INT_MAX;
+    for (unsigned int ii=0;ii<freeRects.size();ii++)
+    {
+        const Rect &free = freeRects[ii];
+        if (free.width >= sizeX && free.height >= sizeY)
+        {
+            int leftX = free.width - sizeX, leftY = free.height - sizeY;
+            int shortSide = std::min(leftX,leftY), longSide = std::max(leftX,leftY);
+            if (shortSide < bestShort || (shortSide == bestShort && longSide < bestLong))
+            {
+                rect = Rect(free.x,free.y,sizeX,sizeY);
+                bestShort = shortSide;
+                bestLong = longSide;
+            }
+        }
+    }
+    
+    return bestShort != INT_MAX;
+}
+
+void RectPacker::reserve(const Rect &rect)
+{
+    usedRects[rect.y*width+rect.x] = rect;
+    usedArea += rect.width*rect.height;
+    setCells(rect,true);
+    splitFree(rect);
+}
+    
+void RectPacker::release(const Rect &rect)
+{
+    std::map<int,Rect>::iterator it = usedRects.find(rect.y*width+rect.x);
+    if (it == usedRects.end() || it->second.width != rect.width || it->second.height != rect.height)
+        return;
+    
+    usedRects.erase(it);
+    usedArea -= rect.width*rect.height;
+    setCells(rect,false);
+    
+    if (usedRects.empty())
+    {
+        freeRects.clear();
+        freeRects.push_back(Rect(0,0,width,height));
+    } else
+        mergeFree(rect);
+}
+    
+void RectPacker::setCells(const Rect &rect,bool used)
+{
+    for (int iy=rect.y;iy<rect.y+rect.height;iy++)
+        std::fill(cells.begin()+iy*width+rect.x,cells.begin()+iy*width+rect.x+rect.width,used);
+}
+    
+bool RectPacker::colFree(int x,int y0,int y1) const
+{
+    if (x < 0 || x >= width)
+        return false;
+    for (int iy=y0;iy<y1;iy++)
+        if (cells[iy*width+x])
+            return false;
+    return true;
+}
+
+bool RectPacker::rowFree(int y,int x0,int x1) const
+{
+    if (y < 0 || y >= height)
+        return false;
+    for (int ix=x0;ix<x1;ix++)
+        if (cells[y*width+ix])
+            return false;
+    return true;
+}
+    
+RectPacker::Rect RectPacker::grow(Rect rect,bool horizFirst) const
+{
+    for (unsigned int pass=0;pass<2;pass++)
+    {
+        if (horizFirst == (pass == 0))
+        {
+            while (colFree(rect.x-1,rect.y,rect.y+rect.height))
+            {
+                rect.x--;
+                rect.width++;
+            }
+            while (colFree(rect.x+rect.width,rect.y,rect.y+rect.height))
+                rect.width++;
+        } else {
+            while (rowFree(rect.y-1,rect.x,rect.x+rect.width))
+            {
+                rect.y--;
+                rect.height++;
+            }
+            while (rowFree(rect.y+rect.height,rect.x,rect.x+rect.width))
+                rect.height++;
+        }
+    }
+    
+    return rect;
+}
+    
+void RectPacker::splitFree(const Rect &used)
+{
+    unsigned int numOld = freeRects.size();
+    for (unsigned int ii=0;ii<numOld;)
+    {
+        Rect free = freeRects[ii];
+        if (!free.overlaps(used))
+        {
+            ii++;
+            continue;
+        }
+        
+        // Whatever's left on each of the four sides becomes a new free rectangle
+        if (used.x > free.x)
+            freeRects.push_back(Rect(free.x,free.y,used.x-free.x,free.height));
+        if (used.x+used.width < free.x+free.width)
+            freeRects.push_back(Rect(used.x+used.width,free.y,free.x+free.width-(used.x+used.width),free.height));
+        if (used.y > free.y)
+            freeRects.push_back(Rect(free.x,free.y,free.width,used.y-free.y));
+        if (used.y+used.height < free.y+free.height)
+            freeRects.push_back(Rect(free.x,used.y+used.height,free.width,free.y+free.height-(used.y+used.height)));
+        
+        // Swap in one we haven't looked at yet
+        numOld--;
+        freeRects[ii] = freeRects[numOld];
+        freeRects[numOld] = freeRects.back();
+        freeRects.pop_back();
+    }
+    
+    pruneFree(numOld);
+}
+    
+void RectPacker::mergeFree(const Rect &rect)
+{
+    // Free rectangles bordering the released one may be able to grow into it
+    unsigned int numOld = freeRects.size();
+    for (unsigned int ii=0;ii<numOld;ii++)
+    {
+        const Rect &free = freeRects[ii];
+        bool touchX = (free.x+free.width == rect.x || rect.x+rect.width == free.x) && free.y < rect.y+rect.height && rect.y < free.y+free.height;
+        bool touchY = (free.y+free.height == rect.y || rect.y+rect.height == free.y) && free.x < rect.x+rect.width && rect.x < free.x+free.width;
+        if (touchX || touchY)
+            freeRects.push_back(grow(free,touchX));
+    }
+    
+    // And the released one grows out as far as it can both ways
+    freeRects.push_back(grow(rect,true));
+    freeRects.push_back(grow(rect,false));
+    
+    // Toss the new ones that didn't get anywhere, then any old ones they've swallowed
+    pruneFree(numOld);
+    for (unsigned int ii=0;ii<numOld;)
+    {
+        bool contained = false;
+        for (unsigned int jj=numOld;jj<freeRects.size() && !contained;jj++)
+            contained = freeRects[ii].inside(freeRects[jj]);
+        if (contained)
+        {
+            // Swap in the last old one and move the new ones down
+            numOld--;
+            freeRects[ii] = freeRects[numOld];
+            freeRects.erase(freeRects.begin()+numOld);
+        } else
+            ii++;
+    }
+}
+    
+void RectPacker::pruneFree(unsigned int startNew)
+{
+    // The ones before startNew are known not to be inside anything
+    for (unsigned int ii=startNew;ii<freeRects.size();)
+    {
+        bool contained = false;
+        for (unsigned int jj=0;jj<freeRects.size() && !contained;jj++)
+            if (jj != ii && freeRects[ii].inside(freeRects[jj]))
+            {
+                // Exact duplicates need to keep one
+                const Rect &a = freeRects[ii], &b = freeRects[jj];
+                if (!(a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height) || jj < ii)
+                    contained = true;
+            }
+        if (contained)
+        {
+            freeRects[ii] = freeRects.back();
+            freeRects.pop_back();
+        } else
+            ii++;
+    }
+}
+    
+void RectPacker::getStats(RectPackerStats &stats) const
+{
+    stats.totalArea = width*height;
+    stats.usedArea = usedArea;
+    stats.numRects = usedRects.size();
+    stats.numFreeRects = freeRects.size();
+    stats.largestFreeArea = 0;
+    for (unsigned int ii=0;ii<freeRects.size();ii++)
+        stats.largestFreeArea = std::max(stats.largestFreeArea,freeRects[ii].width*freeRects[ii].height);
+}
+
+}
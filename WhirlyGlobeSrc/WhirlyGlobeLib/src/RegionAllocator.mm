@@ -0,0 +1,296 @@
+/*
+ *  RegionAllocator.mm
+ *  WhirlyGlobeLib
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <stddef.h>
+#import "RegionAllocator.h"
+
+namespace WhirlyKit
+{
+    
+// Index of the highest set bit
+static inline int HighBit(unsigned int val)
+{
+    return 31 - __builtin_clz(val);
+}
+
+// Index of the lowest set bit
+static inline int LowBit(unsigned int val)
+{
+    return __builtin_ctz(val);
+}
+    
+RegionAllocator::RegionAllocator(unsigned int totalSize)
+    : totalSize(totalSize), usedSize(0), numRegions(0), tailBlock(-1), flBitmap(0)
+{
+    for (unsigned int fi=0;fi<FLCount;fi++)
+    {
+        slBitmap[fi] = 0;
+        for (unsigned int si=0;si<SLCount;si++)
+            freeHeads[fi][si] = -1;
+    }
+    
+    // Start with one free block covering everything
+    if (totalSize > 0)
+    {
+        int which = newBlock();
+        Block &block = blocks[which];
+        block.offset = 0;
+        block.size = totalSize;
+        block.prevPhys = block.nextPhys = -1;
+        tailBlock = which;
+        insertFree(which);
+    }
+}
+
+void RegionAllocator::mapping(unsigned int size,int &fl,int &sl) const
+{
+    if (size < SLCount)
+    {
+        fl = 0;
+        sl = size;
+    } else {
+        int hb = HighBit(size);
+        sl = (size >> (hb - SLBits)) - SLCount;
+        fl = hb - SLBits + 1;
+    }
+}
+    
+bool RegionAllocator::findSuitable(unsigned int size,int &fl,int &sl) const
+{
+    // Round up to the next list so anything we find is big enough
+    if (size >= SLCount)
+        size += (1 << (HighBit(size) - SLBits)) - 1;
+    mapping(size,fl,sl);
+    if (fl >= FLCount)
+        return false;
+    
+    unsigned int slMap = slBitmap[fl] & (~0u << sl);
+    if (!slMap)
+    {
+        unsigned int flMap = (fl+1 < FLCount) ? flBitmap & (~0u << (fl+1)) : 0;
+        if (!flMap)
+            return false;
+        fl = LowBit(flMap);
+        slMap = slBitmap[fl];
+    }
+    sl = LowBit(slMap);
+    
+    return true;
+}
+    
+void RegionAllocator::insertFree(int which)
+{
+    Block &block = blocks[which];
+    int fl,sl;
+    mapping(block.size,fl,sl);
+    block.isFree = true;
+    block.prevFree = -1;
+    block.nextFree = freeHeads[fl][sl];
+    if (block.nextFree >= 0)
+        blocks[block.nextFree].prevFree = which;
+    freeHeads[fl][sl] = which;
+    flBitmap |= 1u << fl;
+    slBitmap[fl] |= 1u << sl;
+}
+
+void RegionAllocator::removeFree(int which)
+{
+    Block &block = blocks[which];
+    int fl,sl;
+    mapping(block.size,fl,sl);
+    if (block.prevFree >= 0)
+        blocks[block.prevFree].nextFree = block.nextFree;
+    else
+        freeHeads[fl][sl] = block.nextFree;
+    if (block.nextFree >= 0)
+        blocks[block.nextFree].prevFree = block.prevFree;
+    if (freeHeads[fl][sl] < 0)
+    {
+        slBitmap[fl] &= ~(1u << sl);
+        if (!slBitmap[fl])
+            flBitmap &= ~(1u << fl);
+    }
+    block.isFree = false;
+    block.prevFree = block.nextFree = -1;
+}
+    
+int RegionAllocator::newBlock()
+{
+    if (!unusedBlocks.empty())
+    {
+        int which = unusedBlocks.back();
+        unusedBlocks.pop_back();
+        return which;
+    }
+    
+    blocks.resize(blocks.size()+1);
+    return (int)blocks.size()-1;
+}
+    
+int RegionAllocator::allocate(unsigned int size)
+{
+    if (size == 0)
+        return -1;
+    
+    int fl,sl;
+    if (!findSuitable(size,fl,sl))
+        return -1;
+    int which = freeHeads[fl][sl];
+    removeFree(which);
+    
+    // Split off what we don't need into a new free block
+    if (blocks[which].size > size)
+    {
+        int rest = newBlock();
+        Block &block = blocks[which];
+        Block &restBlock = blocks[rest];
+        restBlock.offset = block.offset + size;
+        restBlock.size = block.size - size;
+        restBlock.prevPhys = which;
+        restBlock.nextPhys = block.nextPhys;
+        if (block.nextPhys >= 0)
+            blocks[block.nextPhys].prevPhys = rest;
+        else
+            tailBlock = rest;
+        block.nextPhys = rest;
+        block.size = size;
+        insertFree(rest);
+    }
+    
+    usedSize += size;
+    numRegions++;
+    
+    return which;
+}
+    
+void RegionAllocator::free(int which)
+{
+    if (which < 0 || (size_t)which >= blocks.size() || blocks[which].isFree)
+        return;
+    
+    usedSize -= blocks[which].size;
+    numRegions--;
+    
+    // Merge with the next block
+    int next = blocks[which].nextPhys;
+    if (next >= 0 && blocks[next].isFree)
+    {
+        removeFree(next);
+        Block &block = blocks[which];
+        block.size += blocks[next].size;
+        block.nextPhys = blocks[next].nextPhys;
+        if (block.nextPhys >= 0)
+            blocks[block.nextPhys].prevPhys = which;
+        else
+            tailBlock = which;
+        unusedBlocks.push_back(next);
+    }
+    
+    // And the previous one
+    int prev = blocks[which].prevPhys;
+    if (prev >= 0 && blocks[prev].isFree)
+    {
+        removeFree(prev);
+        Block &prevBlock = blocks[prev];
+        prevBlock.size += blocks[which].size;
+        prevBlock.nextPhys = blocks[which].nextPhys;
+        if (prevBlock.nextPhys >= 0)
+            blocks[prevBlock.nextPhys].prevPhys = prev;
+        else
+            tailBlock = prev;
+        unusedBlocks.push_back(which);
+        which = prev;
+    }
+    
+    insertFree(which);
+}
+    
+bool RegionAllocator::moveDown(int which)
+{
+    if (which < 0 || (size_t)which >= blocks.size() || blocks[which].isFree)
+        return false;
+    int prev = blocks[which].prevPhys;
+    if (prev < 0 || !blocks[prev].isFree)
+        return false;
+    
+    // Swap the places of the free block and the region
+    removeFree(prev);
+    Block &block = blocks[which];
+    Block &freeBlock = blocks[prev];
+    block.offset = freeBlock.offset;
+    freeBlock.offset = block.offset + block.size;
+    
+    block.prevPhys = freeBlock.prevPhys;
+    if (block.prevPhys >= 0)
+        blocks[block.prevPhys].nextPhys = which;
+    freeBlock.nextPhys = block.nextPhys;
+    if (freeBlock.nextPhys >= 0)
+        blocks[freeBlock.nextPhys].prevPhys = prev;
+    else
+        tailBlock = prev;
+    freeBlock.prevPhys = which;
+    block.nextPhys = prev;
+    
+    // The free space may now run into another free block
+    int next = freeBlock.nextPhys;
+    if (next >= 0 && blocks[next].isFree)
+    {
+        removeFree(next);
+        freeBlock.size += blocks[next].size;
+        freeBlock.nextPhys = blocks[next].nextPhys;
+        if (freeBlock.nextPhys >= 0)
+            blocks[freeBlock.nextPhys].prevPhys = prev;
+        else
+            tailBlock = prev;
+        unusedBlocks.push_back(next);
+    }
+    insertFree(prev);
+    
+    return true;
+}
+    
+unsigned int RegionAllocator::getHighWater() const
+{
+    if (tailBlock < 0)
+        return 0;
+    
+    const Block &tail = blocks[tailBlock];
+    return tail.isFree ? tail.offset : totalSize;
+}
+    
+void RegionAllocator::getStats(RegionAllocatorStats &stats) const
+{
+    stats = RegionAllocatorStats();
+    stats.totalSize = totalSize;
+    stats.usedSize = usedSize;
+    stats.freeSize = totalSize - usedSize;
+    stats.numRegions = numRegions;
+    
+    for (unsigned int fi=0;fi<FLCount;fi++)
+        for (unsigned int si=0;si<SLCount;si++)
+            for (int which = freeHeads[fi][si];which >= 0;which = blocks[which].nextFree)
+            {
+                stats.numFreeBlocks++;
+                if (blocks[which].size > stats.largestFreeBlock)
+                    stats.largestFreeBlock = blocks[which].size;
+            }
+}
+
+}
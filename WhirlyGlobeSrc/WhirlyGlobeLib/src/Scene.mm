@@ -35,6 +35,8 @@
 #import "LoftManager.h"
 #import "ParticleSystemManager.h"
 #import "BillboardManager.h"
+#import "Profiler.h"
+#import "LatencyHistogram.h"
 
 namespace WhirlyKit
 {
@@ -52,9 +54,11 @@ void Scene::Init(WhirlyKit::CoordSystemDisplayAdapter *adapter,Mbr localMbr,unsi
     ssGen = new ScreenSpaceGenerator(kScreenSpaceGeneratorShared,Point2f(0.1,0.1));
     screenSpaceGeneratorID = ssGen->getId();
     generators.insert(ssGen);
+    generatorTable.insert(ssGen->getId(),ssGen);
     // And put in a UIView placement generator for use in the main thread
     vpGen = new ViewPlacementGenerator(kViewPlacementGeneratorShared);
     generators.insert(vpGen);
+    generatorTable.insert(vpGen->getId(),vpGen);
 
     dispatchQueue = dispatch_queue_create("WhirlyKit Scene", 0);
 
@@ -85,7 +89,6 @@ void Scene::Init(WhirlyKit::CoordSystemDisplayAdapter *adapter,Mbr localMbr,unsi
     
     activeModels = [NSMutableArray array];
     
-    pthread_mutex_init(&changeRequestLock,NULL);        
     pthread_mutex_init(&subTexLock, NULL);
     pthread_mutex_init(&textureLock,NULL);
     pthread_mutex_init(&generatorLock,NULL);
@@ -105,8 +108,8 @@ Scene::~Scene()
         delete cullTree;
         cullTree = NULL;
     }
-    for (TextureSet::iterator it = textures.begin(); it != textures.end(); ++it)
-        delete *it;
+    for (unsigned int ii=0;ii<textures.size();ii++)
+        delete textures[ii].val;
     for (GeneratorSet::iterator it = generators.begin(); it != generators.end(); ++it)
         delete *it;
     
@@ -118,18 +121,16 @@ Scene::~Scene()
     fontTexManager = nil;
     
     pthread_mutex_destroy(&managerLock);
-    pthread_mutex_destroy(&changeRequestLock);
     pthread_mutex_destroy(&subTexLock);
     pthread_mutex_destroy(&textureLock);
     pthread_mutex_destroy(&generatorLock);
     pthread_mutex_destroy(&programLock);
     
-    for (unsigned int ii=0;ii<changeRequests.size();ii++)
-    {
-        // Note: Tear down change requests?
-        delete changeRequests[ii];
-    }
-    changeRequests.clear();
+    // Note: Tear down change requests?
+    ChangeSet changes;
+    changeRequests.takeAll(changes);
+    for (unsigned int ii=0;ii<changes.size();ii++)
+        delete changes[ii];
     
     activeModels = nil;
     
@@ -167,21 +168,18 @@ SimpleIdentity Scene::getGeneratorIDByName(const std::string &name)
 // Add change requests to our list
 void Scene::addChangeRequests(const ChangeSet &newChanges)
 {
-    pthread_mutex_lock(&changeRequestLock);
-    
-    changeRequests.insert(changeRequests.end(),newChanges.begin(),newChanges.end());
+    changeRequests.add(newChanges);
+}
     
-    pthread_mutex_unlock(&changeRequestLock);
+void Scene::addChangeRequestsAndClear(ChangeSet &newChanges)
+{
+    changeRequests.addAndClear(newChanges);
 }
 
 // Add a single change request
 void Scene::addChangeRequest(ChangeRequest *newChange)
 {
-    pthread_mutex_lock(&changeRequestLock);
-    
-    changeRequests.push_back(newChange);
-    
-    pthread_mutex_unlock(&changeRequestLock);
+    changeRequests.add(newChange);
 }
 
 GLuint Scene::getGLTexture(SimpleIdentity texIdent)
@@ -189,44 +187,25 @@ GLuint Scene::getGLTexture(SimpleIdentity texIdent)
     if (texIdent == EmptyIdentity)
         return 0;
     
-    GLuint ret = 0;
-    
-    pthread_mutex_lock(&textureLock);
-    TextureBase dumbTex(texIdent);
-    TextureSet::iterator it = textures.find(&dumbTex);
-    if (it != textures.end())
-    {
-        ret = (*it)->getGLId();
-    }
+    // We're in the rendering thread, which is the only one that changes textures
+    TextureBase **tex = textures.find(texIdent);
     
-    pthread_mutex_unlock(&textureLock);
-    
-    return ret;
+    return tex ? (*tex)->getGLId() : 0;
 }
 
 DrawableRef Scene::getDrawable(SimpleIdentity drawId)
 {
-    BasicDrawable *dumbDraw = new BasicDrawable("None");
-    dumbDraw->setId(drawId);
-    DrawableRefSet::iterator it = drawables.find(DrawableRef(dumbDraw));
-    if (it != drawables.end())
-        return *it;
+    DrawableRef *draw = drawables.find(drawId);
     
-    return DrawableRef();
+    return draw ? *draw : DrawableRef();
 }
 
 Generator *Scene::getGenerator(SimpleIdentity genId)
 {
     pthread_mutex_lock(&generatorLock);
     
-    Generator *retGen = NULL;
-    Generator dumbGen;
-    dumbGen.setId(genId);
-    GeneratorSet::iterator it = generators.find(&dumbGen);
-    if (it != generators.end())
-    {
-        retGen = *it;
-    }
+    Generator **gen = generatorTable.find(genId);
+    Generator *retGen = gen ? *gen : NULL;
     
     pthread_mutex_unlock(&generatorLock);
     
@@ -293,23 +272,23 @@ void Scene::teardownGL()
 {
     // Note: Tear down generators
     // Note: Tear down active models
-    for (DrawableRefSet::iterator it = drawables.begin();
-         it != drawables.end(); ++it)
-        (*it)->teardownGL(&memManager);
+    for (unsigned int ii=0;ii<drawables.size();ii++)
+        drawables[ii].val->teardownGL(&memManager);
     if (cullTree)
     {
         delete cullTree;
         cullTree = NULL;
     }
     drawables.clear();
-    for (TextureSet::iterator it = textures.begin();
-         it != textures.end(); ++it)
+    pthread_mutex_lock(&textureLock);
+    for (unsigned int ii=0;ii<textures.size();ii++)
     {
-        TextureBase *texture = *it;
+        TextureBase *texture = textures[ii].val;
         texture->destroyInGL(&memManager);
         delete texture;
     }
     textures.clear();
+    pthread_mutex_unlock(&textureLock);
     
     memManager.clearBufferIDs();
     memManager.clearTextureIDs();
@@ -319,11 +298,8 @@ TextureBase *Scene::getTexture(SimpleIdentity texId)
 {
     pthread_mutex_lock(&textureLock);
     
-    TextureBase *retTex = NULL;
-    TextureBase dumbTex(texId);
-    Scene::TextureSet::iterator it = textures.find(&dumbTex);
-    if (it != textures.end())
-        retTex = *it;
+    TextureBase **tex = textures.find(texId);
+    TextureBase *retTex = tex ? *tex : NULL;
     
     pthread_mutex_unlock(&textureLock);
     
@@ -331,36 +307,28 @@ TextureBase *Scene::getTexture(SimpleIdentity texId)
 }
 
 // Process outstanding changes.
-// We'll grab the lock and we're only expecting to be called in the rendering thread
+// We're only expecting to be called in the rendering thread
+static ProfileZone ProcessChangesZone("Scene::processChanges");
+static ProfileZone ChangesExecutedCount("Scene changes executed");
+static ProfileZone ChangesPendingCount("Scene changes pending");
+static LatencyMetric ChangeProcessingLatency("Change processing");
+
 void Scene::processChanges(WhirlyKitView *view,WhirlyKitSceneRendererES *renderer)
 {
-    // We're not willing to wait in the rendering thread
-    if (!pthread_mutex_trylock(&changeRequestLock))
-    {
-        for (unsigned int ii=0;ii<changeRequests.size();ii++)
-        {
-            ChangeRequest *req = changeRequests[ii];
-            if (req) {
-                req->execute(this,renderer,view);
-                delete req;
-            }
-        }
-        changeRequests.clear();
-        
-        pthread_mutex_unlock(&changeRequestLock);
-    }
+    ProfileScope profile(ProcessChangesZone);
+    LatencyScope latency(ChangeProcessingLatency);
+    
+    // Grab everything at once.  Other threads can keep adding while we work.
+    changeScheduler.process(changeRequests,this,renderer,view);
+    
+    const ChangeStats &stats = changeScheduler.getStats();
+    Profiler::count(ChangesExecutedCount, stats.numExecuted);
+    Profiler::count(ChangesPendingCount, stats.numPending);
 }
     
 bool Scene::hasChanges()
 {
-    bool changes = false;
-    if (!pthread_mutex_trylock(&changeRequestLock))
-    {
-        changes = !changeRequests.empty();
-        
-        pthread_mutex_unlock(&changeRequestLock);            
-    }        
-    if (changes)
+    if (!changeRequests.empty() || changeScheduler.hasPending())
         return true;
     
     // How about the active models?
@@ -368,7 +336,7 @@ bool Scene::hasChanges()
         if ([model hasUpdate])
             return true;
     
-    return changes;
+    return false;
 }
 
 // Add a single sub texture map
@@ -387,6 +355,22 @@ void Scene::addSubTextures(const std::vector<SubTexture> &subTexes)
     pthread_mutex_unlock(&subTexLock);
 }
 
+// Swap in new versions of sub textures we already have
+void Scene::replaceSubTextures(const std::vector<SubTexture> &subTexes)
+{
+    pthread_mutex_lock(&subTexLock);
+    for (unsigned int ii=0;ii<subTexes.size();ii++)
+    {
+        SubTextureSet::iterator it = subTextureMap.find(subTexes[ii]);
+        if (it != subTextureMap.end())
+        {
+            subTextureMap.erase(it);
+            subTextureMap.insert(subTexes[ii]);
+        }
+    }
+    pthread_mutex_unlock(&subTexLock);
+}
+
 // Look for a sub texture by ID
 SubTexture Scene::getSubTexture(SimpleIdentity subTexId)
 {
@@ -414,10 +398,10 @@ SimpleIdentity Scene::getScreenSpaceGeneratorID()
 
 void Scene::dumpStats()
 {
-    NSLog(@"Scene: %ld drawables",drawables.size());
+    NSLog(@"Scene: %d drawables",drawables.size());
     NSLog(@"Scene: %d active models",[activeModels count]);
     NSLog(@"Scene: %ld generators",generators.size());
-    NSLog(@"Scene: %ld textures",textures.size());
+    NSLog(@"Scene: %d textures",textures.size());
     NSLog(@"Scene: %ld sub textures",subTextureMap.size());
     cullTree->dumpStats();
     memManager.dumpStats();
@@ -562,19 +546,30 @@ void AddTextureReq::execute(Scene *scene,WhirlyKitSceneRendererES *renderer,Whir
 {
     if (!tex->getGLId())
         tex->createInGL(scene->getMemManager());
-    scene->textures.insert(tex);
+    pthread_mutex_lock(&scene->textureLock);
+    scene->textures.insert(tex->getId(),tex);
+    pthread_mutex_unlock(&scene->textureLock);
     tex = NULL;
 }
 
+bool AddTextureReq::getIDs(std::vector<SimpleIdentity> &ids)
+{
+    if (!tex)
+        return false;
+    ids.push_back(tex->getId());
+    return true;
+}
+    
 void RemTextureReq::execute(Scene *scene,WhirlyKitSceneRendererES *renderer,WhirlyKitView *view)
 {
-    TextureBase dumbTex(texture);
-    Scene::TextureSet::iterator it = scene->textures.find(&dumbTex);
-    if (it != scene->textures.end())
+    TextureBase **texPtr = scene->textures.find(texture);
+    if (texPtr)
     {
-        TextureBase *tex = *it;
+        TextureBase *tex = *texPtr;
         tex->destroyInGL(scene->getMemManager());
-        scene->textures.erase(it);
+        pthread_mutex_lock(&scene->textureLock);
+        scene->textures.erase(texture);
+        pthread_mutex_unlock(&scene->textureLock);
         delete tex;
     }
 }
@@ -594,17 +589,27 @@ void AddDrawableReq::execute(Scene *scene,WhirlyKitSceneRendererES *renderer,Whi
     drawable = NULL;
 }
 
+bool AddDrawableReq::getIDs(std::vector<SimpleIdentity> &ids)
+{
+    if (!drawable)
+        return false;
+    ids.push_back(drawable->getId());
+    // It might be waiting on a texture
+    SimpleIdentity texId = drawable->getTexId();
+    if (texId != EmptyIdentity)
+        ids.push_back(texId);
+    return true;
+}
+
 void RemDrawableReq::execute(Scene *scene,WhirlyKitSceneRendererES *renderer,WhirlyKitView *view)
 {
-    BasicDrawable *dumbDraw = new BasicDrawable("None");
-    dumbDraw->setId(drawable);
-    DrawableRefSet::iterator it = scene->drawables.find(DrawableRef(dumbDraw));
-    if (it != scene->drawables.end())
+    DrawableRef draw = scene->getDrawable(drawable);
+    if (draw)
     {
         // Teardown OpenGL foo
-        (*it)->teardownGL(scene->getMemManager());
+        draw->teardownGL(scene->getMemManager());
 
-        scene->remDrawable(*it);        
+        scene->remDrawable(draw);
     }
 }
 
@@ -612,6 +617,7 @@ void AddGeneratorReq::execute(Scene *scene,WhirlyKitSceneRendererES *renderer,Wh
 {
     // Add the generator
     scene->generators.insert(generator);
+    scene->generatorTable.insert(generator->getId(),generator);
     
     generator = NULL;
 }
@@ -625,6 +631,7 @@ void RemGeneratorReq::execute(Scene *scene,WhirlyKitSceneRendererES *renderer,Wh
     {
         Generator *theGenerator = *it;
         scene->generators.erase(it);
+        scene->generatorTable.erase(genId);
         
         delete theGenerator;
     }
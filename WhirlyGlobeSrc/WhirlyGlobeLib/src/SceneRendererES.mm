@@ -22,6 +22,7 @@
 #import "UIColor+Stuff.h"
 #import "GLUtils.h"
 #import "SelectionManager.h"
+#import "GLStateOptimizer.h"
 
 using namespace Eigen;
 using namespace WhirlyKit;
@@ -51,90 +52,87 @@ bool matrixAisSameAsB(Matrix4d &a,Matrix4d &b)
 
 @implementation WhirlyKitOpenGLStateOptimizer
 {
-    int activeTexture;
-    int depthMask;
-    int depthTest;
-    int progId;
-    int depthFunc;
-    GLfloat lineWidth;
+    OpenGLStateOptimizer stateOpt;
 }
 
-- (id)init
+- (void)reset
 {
-    self = [super init];
-    [self reset];
-    
-    return self;
+    stateOpt.reset();
 }
 
-- (void)reset
+- (void)resetBindings
+{
+    stateOpt.resetBindings();
+}
+
+- (void)beginFrame
 {
-    activeTexture = -1;
-    depthMask = 0;
-    depthTest = -1;
-    progId = -1;
-    lineWidth = -1.0;
-    depthFunc = -1;
+    stateOpt.beginFrame();
+}
+
+- (void)endFrame
+{
+    stateOpt.endFrame();
 }
 
 - (void)setActiveTexture:(GLenum)newActiveTexture
 {
-    if (newActiveTexture != activeTexture)
-    {
-        glActiveTexture(newActiveTexture);
-        activeTexture = newActiveTexture;
-    }
+    stateOpt.setActiveTexture(newActiveTexture);
 }
 
 - (void)setDepthMask:(bool)newDepthMask
 {
-    if (depthMask == -1 || (bool)depthMask != newDepthMask)
-    {
-        glDepthMask(newDepthMask);
-        depthMask = newDepthMask;
-    }
+    stateOpt.setDepthMask(newDepthMask);
 }
 
 - (void)setEnableDepthTest:(bool)newEnable
 {
-    if (depthTest == -1 || (bool)depthTest != newEnable)
-    {
-        if (newEnable)
-            glEnable(GL_DEPTH_TEST);
-        else
-            glDisable(GL_DEPTH_TEST);
-        depthTest = newEnable;
-    }
+    stateOpt.setEnableDepthTest(newEnable);
 }
 
 - (void)setDepthFunc:(GLenum)newDepthFunc
 {
-    if (depthFunc == -1 || newDepthFunc != depthFunc)
-    {
-        glDepthFunc(newDepthFunc);
-        depthFunc = newDepthFunc;
-    }
+    stateOpt.setDepthFunc(newDepthFunc);
 }
 
 - (void)setUseProgram:(GLuint)newProgId
 {
-//    if (progId != newProgId)
-//    {
-        glUseProgram(newProgId);
-        progId = newProgId;
-//    }
+    stateOpt.setUseProgram(newProgId);
 }
 
 - (void)setLineWidth:(GLfloat)newLineWidth
 {
-    if (lineWidth != newLineWidth || lineWidth == -1.0)
-    {
-        if (newLineWidth > 0.0)
-        {
-            glLineWidth(newLineWidth);
-            lineWidth = newLineWidth;
-        }
-    }
+    stateOpt.setLineWidth(newLineWidth);
+}
+
+- (void)setBoundTexture:(GLuint)texId
+{
+    stateOpt.setBoundTexture(texId);
+}
+
+- (void)setVertexArray:(GLuint)newVertArrayObj
+{
+    stateOpt.setVertexArray(newVertArrayObj);
+}
+
+- (void)setArrayBuffer:(GLuint)bufferId
+{
+    stateOpt.setArrayBuffer(bufferId);
+}
+
+- (void)setElementArrayBuffer:(GLuint)bufferId
+{
+    stateOpt.setElementArrayBuffer(bufferId);
+}
+
+- (void)setEnableBlend:(bool)newEnable
+{
+    stateOpt.setEnableBlend(newEnable);
+}
+
+- (void)setBlendFuncSrc:(GLenum)srcFactor dst:(GLenum)dstFactor
+{
+    stateOpt.setBlendFunc(srcFactor, dstFactor);
 }
 
 @end
@@ -155,6 +153,7 @@ bool matrixAisSameAsB(Matrix4d &a,Matrix4d &b)
 		frameCountStart = nil;
         _zBufferMode = zBufferOn;
         _doCulling = true;
+        _coherentCulling = false;
         _clearColor.r = 0.0;  _clearColor.g = 0.0;  _clearColor.b = 0.0;  _clearColor.a = 1.0;
         _perfInterval = -1;
         _scale = [[UIScreen mainScreen] scale];
@@ -167,24 +166,28 @@ bool matrixAisSameAsB(Matrix4d &a,Matrix4d &b)
             return nil;
         }
         
+        // See if we can use 32 bit element indices
+        const char *extensions = (const char *)GetGLBackend()->getString(GL_EXTENSIONS);
+        SetLargeIndicesSupported(extensions && strstr(extensions, "GL_OES_element_index_uint"));
+        
         // Create default framebuffer object.
-        glGenFramebuffers(1, &defaultFramebuffer);
+        GetGLBackend()->genFramebuffers(1, &defaultFramebuffer);
         CheckGLError("SceneRendererES: glGenFramebuffers");
-        glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebuffer);
+        GetGLBackend()->bindFramebuffer(GL_FRAMEBUFFER, defaultFramebuffer);
         CheckGLError("SceneRendererES: glBindFramebuffer");
         
         // Create color render buffer and allocate backing store.
-        glGenRenderbuffers(1, &colorRenderbuffer);
+        GetGLBackend()->genRenderbuffers(1, &colorRenderbuffer);
         CheckGLError("SceneRendererES: glGenRenderbuffers");
-        glBindRenderbuffer(GL_RENDERBUFFER, colorRenderbuffer);
+        GetGLBackend()->bindRenderbuffer(GL_RENDERBUFFER, colorRenderbuffer);
         CheckGLError("SceneRendererES: glBindRenderbuffer");
-        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRenderbuffer);
+        GetGLBackend()->framebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRenderbuffer);
         CheckGLError("SceneRendererES: glFramebufferRenderbuffer");
         
 		// Allocate depth buffer
-		glGenRenderbuffers(1, &depthRenderbuffer);
+		GetGLBackend()->genRenderbuffers(1, &depthRenderbuffer);
         CheckGLError("SceneRendererES: glGenRenderbuffers");
-		glBindRenderbuffer(GL_RENDERBUFFER, depthRenderbuffer);
+		GetGLBackend()->bindRenderbuffer(GL_RENDERBUFFER, depthRenderbuffer);
         CheckGLError("SceneRendererES: glBindRenderbuffer");
         
         // All the animations should work now, except for particle systems
@@ -196,6 +199,9 @@ bool matrixAisSameAsB(Matrix4d &a,Matrix4d &b)
         // Off by default.  Because duh.
         _depthBufferOffForAlpha = false;
         
+        // A small pool.  On a dual core device that's no extra threads at all.
+        workerPool = new WorkerPool(WorkerPool::defaultNumThreads(3));
+        
         [EAGLContext setCurrentContext:oldContext];        
 	}
 	
@@ -210,25 +216,44 @@ bool matrixAisSameAsB(Matrix4d &a,Matrix4d &b)
     	
 	if (defaultFramebuffer)
 	{
-		glDeleteFramebuffers(1, &defaultFramebuffer);
+		GetGLBackend()->deleteFramebuffers(1, &defaultFramebuffer);
 		defaultFramebuffer = 0;
 	}
 	
 	if (colorRenderbuffer)
 	{
-		glDeleteRenderbuffers(1, &colorRenderbuffer);
+		GetGLBackend()->deleteRenderbuffers(1, &colorRenderbuffer);
 		colorRenderbuffer = 0;
 	}
 	
 	if (depthRenderbuffer)
 	{
-		glDeleteRenderbuffers(1, &depthRenderbuffer	);
+		GetGLBackend()->deleteRenderbuffers(1, &depthRenderbuffer	);
 		depthRenderbuffer = 0;
 	}
 	
 	if (oldContext != _context)
         [EAGLContext setCurrentContext:oldContext];
 	_context = nil;	
+    
+    if (workerPool)
+        delete workerPool;
+    workerPool = NULL;
+}
+
+- (int)numWorkerThreads
+{
+    return workerPool->getNumThreads()-1;
+}
+
+// Note: Only call this when we're not rendering
+- (void)setNumWorkerThreads:(int)numWorkerThreads
+{
+    if (numWorkerThreads == workerPool->getNumThreads()-1)
+        return;
+    
+    delete workerPool;
+    workerPool = new WorkerPool(std::max(numWorkerThreads,0));
 }
 
 // We'll take the maximum requested time
@@ -263,24 +288,24 @@ bool matrixAisSameAsB(Matrix4d &a,Matrix4d &b)
     if (oldContext != _context)
         [EAGLContext setCurrentContext:_context];
     
-	glBindRenderbuffer(GL_RENDERBUFFER, colorRenderbuffer);
+	GetGLBackend()->bindRenderbuffer(GL_RENDERBUFFER, colorRenderbuffer);
     CheckGLError("SceneRendererES: glBindRenderbuffer");
 	[_context renderbufferStorage:GL_RENDERBUFFER fromDrawable:(CAEAGLLayer *)layer];
     CheckGLError("SceneRendererES: glBindRenderbuffer");
-	glGetRenderbufferParameteriv(GL_RENDERBUFFER, GL_RENDERBUFFER_WIDTH, &_framebufferWidth);
-	glGetRenderbufferParameteriv(GL_RENDERBUFFER, GL_RENDERBUFFER_HEIGHT, &_framebufferHeight);
+	GetGLBackend()->getRenderbufferParameteriv(GL_RENDERBUFFER, GL_RENDERBUFFER_WIDTH, &_framebufferWidth);
+	GetGLBackend()->getRenderbufferParameteriv(GL_RENDERBUFFER, GL_RENDERBUFFER_HEIGHT, &_framebufferHeight);
     
 	// For this sample, we also need a depth buffer, so we'll create and attach one via another renderbuffer.
-	glBindRenderbuffer(GL_RENDERBUFFER, depthRenderbuffer);
+	GetGLBackend()->bindRenderbuffer(GL_RENDERBUFFER, depthRenderbuffer);
     CheckGLError("SceneRendererES: glBindRenderbuffer");
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, _framebufferWidth, _framebufferHeight);
+	GetGLBackend()->renderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, _framebufferWidth, _framebufferHeight);
     CheckGLError("SceneRendererES: glRenderbufferStorage");
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRenderbuffer);
+	GetGLBackend()->framebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRenderbuffer);
     CheckGLError("SceneRendererES: glFramebufferRenderbuffer");
 	
-	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	if (GetGLBackend()->checkFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
 	{
-		NSLog(@"Failed to make complete framebuffer object %x", glCheckFramebufferStatus(GL_FRAMEBUFFER));
+		NSLog(@"Failed to make complete framebuffer object %x", GetGLBackend()->checkFramebufferStatus(GL_FRAMEBUFFER));
         if (oldContext != _context)
             [EAGLContext setCurrentContext:oldContext];
 		return NO;
@@ -298,89 +323,45 @@ bool matrixAisSameAsB(Matrix4d &a,Matrix4d &b)
     _clearColor = [color asRGBAColor];
 }
 
-// Calculate an acceptable MBR from world coords
-- (Mbr) calcCurvedMBR:(Point3f *)corners view:(WhirlyGlobeView *)globeView modelTrans:(Eigen::Matrix4d *)modelTrans frameSize:(Point2f)frameSize
-{
-    Mbr localScreenMbr;
-    
-    for (unsigned int ii=0;ii<WhirlyKitCullableCorners;ii++)
-    {
-        Point3d cornerPt = Point3d(corners[ii].x(),corners[ii].y(),corners[ii].z());
-        CGPoint screenPt = [globeView pointOnScreenFromSphere:cornerPt transform:modelTrans frameSize:frameSize];
-        localScreenMbr.addPoint(Point2f(screenPt.x,screenPt.y));
-    }
-    
-    return localScreenMbr;
-}
-
-- (void) mergeDrawableSet:(const std::set<DrawableRef,IdentifiableRefSorter> &)newDrawables globeView:(WhirlyGlobeView *)globeView frameSize:(Point2f)frameSize modelTrans:(Eigen::Matrix4d *)modelTrans frameInfo:(WhirlyKitRendererFrameInfo *)frameInfo screenMbr:(Mbr)screenMbr toDraw:(std::set<DrawableRef> *) toDraw considered:(int *)drawablesConsidered
-{
-    // Grab any drawables that live just at this level
-    *drawablesConsidered += newDrawables.size();
-    for (std::set<DrawableRef,IdentifiableSorter>::const_iterator it = newDrawables.begin();
-         it != newDrawables.end(); ++it)
-    {
-        DrawableRef draw = *it;
-        // Make sure we haven't added it already and it's on
-        // Note: We're doing the on check repeatedly
-        //       And we're doing the refusal check repeatedly as well, possibly
-        if ((toDraw->find(draw) == toDraw->end()) && draw->isOn(frameInfo))
-            toDraw->insert(draw);
-    }
-}
-
-- (void) findDrawables:(Cullable *)cullable view:(WhirlyGlobeView *)globeView frameSize:(Point2f)frameSize modelTrans:(Eigen::Matrix4d *)modelTrans eyeVec:(Vector3f)eyeVec frameInfo:(WhirlyKitRendererFrameInfo *)frameInfo screenMbr:(Mbr)screenMbr topLevel:(bool)isTopLevel toDraw:(std::set<DrawableRef> *) toDraw considered:(int *)drawablesConsidered
+- (void) findDrawables:(CullTree *)cullTree view:(WhirlyGlobeView *)globeView frameSize:(Point2f)frameSize modelTrans:(Eigen::Matrix4d *)modelTrans eyeVec:(Vector3f)eyeVec frameInfo:(WhirlyKitRendererFrameInfo *)frameInfo screenMbr:(Mbr)screenMbr toDraw:(std::vector<Drawable *> *) toDraw considered:(int *)drawablesConsidered
 {
     CoordSystemDisplayAdapter *coordAdapter = _scene->getCoordAdapter();
     
-    // Check the four corners of the cullable to see if they're pointed away
-    // But just for the globe case
-    bool inView = false;
-    if (coordAdapter->isFlat() || isTopLevel)
-    {
-        inView = true;
-    } else {
-        for (unsigned int ii=0;ii<WhirlyKitCullableCornerNorms;ii++)
-        {
-            Vector3f norm = cullable->cornerNorms[ii];
-            if (norm.dot(eyeVec) > 0)
-            {
-                inView = true;
-                break;
-            }
-        }
-    }
-    if (_doCulling && !inView)
-        return;
-    
-    Mbr localScreenMbr;
+    CullParams params;
+    params.doCulling = _doCulling;
+    params.checkBackface = !coordAdapter->isFlat();
+    params.eyeVec = eyeVec;
+    params.screenMbr = screenMbr;
+    params.frameInfo = frameInfo;
+    params.workerPool = workerPool;
+    params.useCoherence = _coherentCulling;
     if (globeView)
-        localScreenMbr = [self calcCurvedMBR:&cullable->cornerPoints[0] view:globeView modelTrans:modelTrans frameSize:frameSize];
-    
-    // If this doesn't overlap what we're viewing, we're done
-    if (_doCulling && !screenMbr.overlaps(localScreenMbr))
-        return;
-    
-    // If the footprint of this level on the screen is larger than
-    //  the screen area, keep going down (if we can).
-    float localScreenArea = localScreenMbr.area();
-    float screenArea = screenMbr.area();
-    if (isTopLevel || (localScreenArea > screenArea/4 && cullable->hasChildren()))
     {
-        // Grab the drawables at this level
-        [self mergeDrawableSet:cullable->getDrawables() globeView:globeView frameSize:frameSize modelTrans:modelTrans frameInfo:frameInfo screenMbr:screenMbr toDraw:toDraw considered:drawablesConsidered];
-        
-        // And recurse downward for the rest
+        // This is what pointOnScreenFromSphere does, but as a scale and offset after dividing by z
+        params.checkScreen = true;
         for (unsigned int ii=0;ii<4;ii++)
+            for (unsigned int jj=0;jj<4;jj++)
+                params.modelMat(ii,jj) = (*modelTrans)(ii,jj);
+        Point2d ll,ur;
+        double near,far;
+        [globeView calcFrustumWidth:frameSize.x() height:frameSize.y() ll:ll ur:ur near:near far:far];
+        double nearPlane = globeView.nearPlane;
+        params.scaleX = -nearPlane * frameSize.x() / (ur.x() - ll.x());
+        params.offsetX = -ll.x() * frameSize.x() / (ur.x() - ll.x());
+        params.scaleY = nearPlane * frameSize.y() / (ur.y() - ll.y());
+        params.offsetY = frameSize.y() * (1.0 + ll.y() / (ur.y() - ll.y()));
+        
+        // The eye's at the origin, so bring that back into model space for the horizon check
+        Point3d radii;
+        if (!coordAdapter->isFlat() && coordAdapter->getEllipsoidRadii(radii))
         {
-            Cullable *child = cullable->getChild(ii);
-            if (child)
-                [self findDrawables:child view:globeView frameSize:frameSize modelTrans:modelTrans eyeVec:eyeVec frameInfo:frameInfo screenMbr:screenMbr topLevel:false toDraw:toDraw considered:drawablesConsidered];
+            params.checkHorizon = true;
+            Eigen::Vector4d eyePos4 = modelTrans->inverse() * Eigen::Vector4d(0,0,0,1);
+            params.eyePos = Eigen::Vector3d(eyePos4.x(),eyePos4.y(),eyePos4.z());
         }
-    } else {
-        // If not, then just return what we found here
-        [self mergeDrawableSet:cullable->getChildDrawables() globeView:globeView frameSize:frameSize modelTrans:modelTrans frameInfo:frameInfo screenMbr:screenMbr toDraw:toDraw considered:drawablesConsidered];
     }
+    
+    cullTree->findDrawables(params, *toDraw, drawablesConsidered);
 }
 
 // Check if the view changed from the last frame
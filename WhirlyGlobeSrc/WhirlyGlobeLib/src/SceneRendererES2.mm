@@ -22,58 +22,41 @@
 #import "UIColor+Stuff.h"
 #import "GLUtils.h"
 #import "DefaultShaderPrograms.h"
+#import "DrawListSorter.h"
+#import "GLCommandList.h"
+#import "Profiler.h"
+#import "LatencyHistogram.h"
 
 using namespace Eigen;
 using namespace WhirlyKit;
 
-namespace WhirlyKit
+static ProfileZone RenderFrameZone("Render Frame");
+static ProfileZone RenderSetupZone("Render Setup");
+static ProfileZone ReplayZone("Replay Command List");
+static ProfileZone SceneProcessingZone("Scene processing");
+static ProfileZone PresentZone("Present Renderbuffer");
+static ProfileZone BuildFrameZone("Build Frame");
+static ProfileZone CullingZone("Culling");
+static ProfileZone GenerateZone("Generators - generate");
+static ProfileZone DrawZone("Draw Execution");
+static ProfileZone Draw2DZone("Generators - Draw 2D");
+static ProfileZone CommandsReplayedCount("Commands replayed");
+static ProfileZone DrawablesConsideredCount("Drawables considered");
+static ProfileZone DrawablesDrawnCount("Drawables drawn");
+static LatencyMetric FrameLatency("Frame");
+
+// Names we'll hand the frame builder to start with.  Doubles if it runs out.
+static const int FrameBuilderNameReserve = 256;
+
+// Matrices and such worked out on the render thread that drawing needs
+typedef struct
 {
-
-// Alpha stuff goes at the end
-// Otherwise sort by draw priority
-class DrawListSortStruct2
-{
-public:
-    DrawListSortStruct2(bool useAlpha,bool useZBuffer,WhirlyKitRendererFrameInfo *frameInfo) : useAlpha(useAlpha), useZBuffer(useZBuffer), frameInfo(frameInfo)
-    {
-    }
-    DrawListSortStruct2() { }
-    DrawListSortStruct2(const DrawListSortStruct &that) : useAlpha(that.useAlpha), useZBuffer(that.useZBuffer), frameInfo(that.frameInfo)
-    {
-    }
-    DrawListSortStruct2 & operator = (const DrawListSortStruct &that)
-    {
-        useAlpha = that.useAlpha;
-        useZBuffer= that.useZBuffer;
-        frameInfo = that.frameInfo;
-        return *this;
-    }
-    bool operator()(Drawable *a,Drawable *b)
-    {
-        // We may or may not sort all alpha containing drawables to the end
-        if (useAlpha)
-            if (a->hasAlpha(frameInfo) != b->hasAlpha(frameInfo))
-                return !a->hasAlpha(frameInfo);
- 
-        if (a->getDrawPriority() == b->getDrawPriority())
-        {
-            if (useZBuffer)
-            {
-                bool bufferA = a->getRequestZBuffer();
-                bool bufferB = b->getRequestZBuffer();
-                if (bufferA != bufferB)
-                    return !bufferA;
-            }
-        }
-                
-        return a->getDrawPriority() < b->getDrawPriority();
-    }
-    
-    bool useAlpha,useZBuffer;
-    WhirlyKitRendererFrameInfo * __unsafe_unretained frameInfo;
-};
-    
-}
+    Eigen::Matrix4d modelTrans4d,viewTrans4d,projMat4d;
+    Eigen::Matrix4f mvpMat;
+    Eigen::Vector3f eyeVec;
+    GLint framebufferWidth,framebufferHeight;
+    SimpleIdentity defaultTriShader;
+} RenderFrameSetup;
 
 @implementation WhirlyKitSceneRendererES2
 {
@@ -84,6 +67,16 @@ public:
     dispatch_semaphore_t frameRenderingSemaphore;
     bool renderSetup;
     WhirlyKitOpenGLStateOptimizer *renderStateOptimizer;
+    WhirlyKit::DrawListSorter drawListSorter;
+    // Frame builder records the next frame while we present the last one
+    dispatch_queue_t frameBuilderQueue;
+    dispatch_group_t frameBuilderGroup;
+    WhirlyKit::GLCommandList *commandList;
+    bool commandListPending;
+    int commandListNames;
+    std::vector<WhirlyKit::DrawableRef> commandListDrawables;
+    WhirlyKit::PerformanceTimer builderPerfTimer;
+    RenderFrameSetup builderFrameSetup;
 }
 
 - (id) init
@@ -112,25 +105,49 @@ public:
 
     // Note: Try to turn this back on at some point
     _dispatchRendering = false;
+    _buildCommandLists = false;
+    commandList = NULL;
+    commandListPending = false;
+    commandListNames = 0;
 
     return self;
 }
 
 - (void) dealloc
 {
+    if (commandList)
+    {
+        dispatch_group_wait(frameBuilderGroup, DISPATCH_TIME_FOREVER);
+        delete commandList;
+        commandList = NULL;
+    }
 #if __IPHONE_OS_VERSION_MIN_REQUIRED < 60000
     dispatch_release(contextQueue);
+    if (frameBuilderQueue)
+        dispatch_release(frameBuilderQueue);
+    if (frameBuilderGroup)
+        dispatch_release(frameBuilderGroup);
 #endif
 }
 
 - (void)forceRenderSetup
 {
     renderSetup = false;
+    // Someone else may have been at the context
+    [renderStateOptimizer reset];
 }
 
 // When the scene is set, we'll compile our shaders
 - (void)setScene:(WhirlyKit::Scene *)inScene
 {
+    // A frame being built for the old scene gets tossed
+    if (commandListPending)
+    {
+        dispatch_group_wait(frameBuilderGroup, DISPATCH_TIME_FOREVER);
+        commandListPending = false;
+        commandListDrawables.clear();
+    }
+    
     [super setScene:inScene];
     super.scene = inScene;
 
@@ -207,6 +224,57 @@ static const float ScreenOverlap = 0.1;
         [self renderAsync];
 }
 
+// Wait for the frame builder and replay what it recorded.
+// Returns false if there wasn't anything to replay.
+- (bool) replayCommandList
+{
+    if (!commandListPending)
+        return false;
+    
+    dispatch_group_wait(frameBuilderGroup, DISPATCH_TIME_FOREVER);
+    commandListPending = false;
+    
+    commandList->replay(GetGLBackend());
+    CheckGLError("SceneRendererES2: replay command list");
+    
+    // Drawables that ran out of names will try again next frame, with more of them
+    if (commandList->ranOutOfNames())
+        commandListNames *= 2;
+    if (commandList->getNumDropped() > 0)
+        NSLog(@"SceneRendererES2: %d GL calls couldn't be recorded while building the frame.",commandList->getNumDropped());
+    
+    // The generated drawables can go now that their vertex data has been used
+    commandListDrawables.clear();
+    
+    return true;
+}
+
+// Kick off the frame builder to record the next frame.
+// It's got the scene to itself until we wait for it.
+- (void) startCommandList:(WhirlyKitRendererFrameInfo *)frameInfo view:(WhirlyGlobeView *)globeView
+{
+    if (!commandList)
+    {
+        commandList = new GLCommandList();
+        commandListNames = FrameBuilderNameReserve;
+        frameBuilderQueue = dispatch_queue_create("frame builder queue",DISPATCH_QUEUE_SERIAL);
+        frameBuilderGroup = dispatch_group_create();
+    }
+    
+    // Any new names have to come from this thread, which has the context
+    commandList->clear();
+    commandList->reserveNames(GetGLBackend(), commandListNames);
+    
+    Scene *scene = super.scene;
+    commandListPending = true;
+    dispatch_group_async(frameBuilderGroup, frameBuilderQueue,
+                         ^{
+                             SetThreadGLBackend(commandList);
+                             [self drawScene:scene frameInfo:frameInfo setup:&builderFrameSetup view:globeView perfTimer:&builderPerfTimer keepDrawables:&commandListDrawables];
+                             SetThreadGLBackend(NULL);
+                         });
+}
+
 - (void) renderAsync
 {
     Scene *scene = super.scene;
@@ -225,18 +293,24 @@ static const float ScreenOverlap = 0.1;
 	[super.theView animate];
 
     // Decide if we even need to draw
-    if (!scene->hasChanges() && ![self viewDidChange])
+    // A frame the builder put together last time still has to go out
+    bool drawNewFrame = scene->hasChanges() || [self viewDidChange];
+    if (!drawNewFrame && !commandListPending)
         return;
     
     NSTimeInterval perfInterval = super.perfInterval;
     
     lastDraw = CFAbsoluteTimeGetCurrent();
         
+    ProfileScope profile(RenderFrameZone);
+    uint64_t frameStart = LatencyMetrics::startTime();
+    
     if (perfInterval > 0)
         perfTimer.startTiming("Render Frame");
     	
     if (perfInterval > 0)
         perfTimer.startTiming("Render Setup");
+    Profiler::begin(RenderSetupZone);
     
     EAGLContext *context = super.context;
     EAGLContext *oldContext = [EAGLContext currentContext];
@@ -244,13 +318,6 @@ static const float ScreenOverlap = 0.1;
         [EAGLContext setCurrentContext:context];
     CheckGLError("SceneRendererES2: setCurrentContext");
     
-    if (!renderSetup)
-    {
-        // Turn on blending
-        glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
-        glEnable(GL_BLEND);
-    }
-
     // See if we're dealing with a globe view
     WhirlyGlobeView *globeView = nil;
     if ([super.theView isKindOfClass:[WhirlyGlobeView class]])
@@ -260,66 +327,50 @@ static const float ScreenOverlap = 0.1;
     GLint framebufferHeight = super.framebufferHeight;
     if (!renderSetup)
     {
-        glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebuffer);
+        GetGLBackend()->bindFramebuffer(GL_FRAMEBUFFER, defaultFramebuffer);
         CheckGLError("SceneRendererES2: glBindFramebuffer");
-        glViewport(0, 0, framebufferWidth,framebufferHeight);
+        GetGLBackend()->viewport(0, 0, framebufferWidth,framebufferHeight);
         CheckGLError("SceneRendererES2: glViewport");
     }
-
-    // Get the model and view matrices
-    Eigen::Matrix4d modelTrans4d = [super.theView calcModelMatrix];
-    Eigen::Matrix4f modelTrans = Matrix4dToMatrix4f(modelTrans4d);
-    Eigen::Matrix4d viewTrans4d = [super.theView calcViewMatrix];
-    Eigen::Matrix4f viewTrans = Matrix4dToMatrix4f(viewTrans4d);
-    
-    // Set up a projection matrix
-    Eigen::Matrix4d projMat4d = [super.theView calcProjectionMatrix:Point2f(framebufferWidth,framebufferHeight) margin:0.0];
-    
-    Eigen::Matrix4f projMat = Matrix4dToMatrix4f(projMat4d);
-    Eigen::Matrix4f modelAndViewMat = viewTrans * modelTrans;
-    Eigen::Matrix4f mvpMat = projMat * (modelAndViewMat);
-    Eigen::Matrix4f modelAndViewNormalMat = modelAndViewMat.inverse().transpose();
-
-    switch (super.zBufferMode)
-    {
-        case zBufferOn:
-            [renderStateOptimizer setDepthMask:GL_TRUE];
-            [renderStateOptimizer setEnableDepthTest:true];
-            [renderStateOptimizer setDepthFunc:GL_LESS];
-            break;
-        case zBufferOff:
-            [renderStateOptimizer setDepthMask:GL_FALSE];
-            [renderStateOptimizer setEnableDepthTest:false];
-            break;
-        case zBufferOffDefault:
-            [renderStateOptimizer setDepthMask:GL_TRUE];
-            [renderStateOptimizer setEnableDepthTest:true];
-            [renderStateOptimizer setDepthFunc:GL_ALWAYS];
-            break;
-    }
     
     if (!renderSetup)
     {
         // Note: What happens if they change this?
-        glClearColor(_clearColor.r / 255.0, _clearColor.g / 255.0, _clearColor.b / 255.0, _clearColor.a / 255.0);
+        GetGLBackend()->clearColor(_clearColor.r / 255.0, _clearColor.g / 255.0, _clearColor.b / 255.0, _clearColor.a / 255.0);
         CheckGLError("SceneRendererES2: glClearColor");
     }
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    CheckGLError("SceneRendererES2: glClear");
 
     if (!renderSetup)
     {
-        glEnable(GL_CULL_FACE);
+        GetGLBackend()->enable(GL_CULL_FACE);
         CheckGLError("SceneRendererES2: glEnable(GL_CULL_FACE)");
     }
     
     if (perfInterval > 0)
         perfTimer.stopTiming("Render Setup");
+    Profiler::end(RenderSetupZone);
     
-	if (scene)
+    // Send out the frame the builder recorded last time.
+    // This has to happen before we process changes, since those can delete
+    //  things the recorded frame is using.
+    bool presentFrame = !_buildCommandLists;
+    if (commandListPending)
+    {
+        if (perfInterval > 0)
+            perfTimer.startTiming("Replay Command List");
+        Profiler::begin(ReplayZone);
+        presentFrame = [self replayCommandList];
+        Profiler::count(CommandsReplayedCount, commandList->getNumCommands());
+        if (perfInterval > 0)
+        {
+            perfTimer.addCount("Commands replayed", commandList->getNumCommands());
+            perfTimer.stopTiming("Replay Command List");
+        }
+        Profiler::end(ReplayZone);
+    }
+
+	if (scene && drawNewFrame)
 	{
-		int numDrawables = 0;
-        
         SimpleIdentity defaultTriShader = scene->getProgramIDBySceneName(kSceneDefaultTriShader);
         SimpleIdentity defaultLineShader = scene->getProgramIDBySceneName(kSceneDefaultLineShader);
         if ((defaultTriShader == EmptyIdentity) || (defaultLineShader == EmptyIdentity))
@@ -328,6 +379,27 @@ static const float ScreenOverlap = 0.1;
             return;
         }
         
+        // The frame builder works from its own copy
+        RenderFrameSetup localFrameSetup;
+        RenderFrameSetup &frameSetup = _buildCommandLists ? builderFrameSetup : localFrameSetup;
+        frameSetup.framebufferWidth = framebufferWidth;
+        frameSetup.framebufferHeight = framebufferHeight;
+        frameSetup.defaultTriShader = defaultTriShader;
+        
+        // Get the model and view matrices
+        frameSetup.modelTrans4d = [super.theView calcModelMatrix];
+        Eigen::Matrix4f modelTrans = Matrix4dToMatrix4f(frameSetup.modelTrans4d);
+        frameSetup.viewTrans4d = [super.theView calcViewMatrix];
+        Eigen::Matrix4f viewTrans = Matrix4dToMatrix4f(frameSetup.viewTrans4d);
+        
+        // Set up a projection matrix
+        frameSetup.projMat4d = [super.theView calcProjectionMatrix:Point2f(framebufferWidth,framebufferHeight) margin:0.0];
+        
+        Eigen::Matrix4f projMat = Matrix4dToMatrix4f(frameSetup.projMat4d);
+        Eigen::Matrix4f modelAndViewMat = viewTrans * modelTrans;
+        frameSetup.mvpMat = projMat * (modelAndViewMat);
+        Eigen::Matrix4f modelAndViewNormalMat = modelAndViewMat.inverse().transpose();
+        
         WhirlyKitRendererFrameInfo *frameInfo = [[WhirlyKitRendererFrameInfo alloc] init];
         frameInfo.oglVersion = kEAGLRenderingAPIOpenGLES2;
         frameInfo.sceneRenderer = self;
@@ -337,7 +409,7 @@ static const float ScreenOverlap = 0.1;
 //        frameInfo.frameLen = duration;
         frameInfo.currentTime = CFAbsoluteTimeGetCurrent();
         frameInfo.projMat = projMat;
-        frameInfo.mvpMat = mvpMat;
+        frameInfo.mvpMat = frameSetup.mvpMat;
         frameInfo.viewModelNormalMat = modelAndViewNormalMat;
         frameInfo.viewAndModelMat = modelAndViewMat;
         frameInfo.lights = lights;
@@ -345,269 +417,48 @@ static const float ScreenOverlap = 0.1;
 		
         if (perfInterval > 0)
             perfTimer.startTiming("Scene processing");
+        Profiler::begin(SceneProcessingZone);
         
         // Let the active models to their thing
         // That thing had better not take too long
         for (NSObject<WhirlyKitActiveModel> *activeModel in scene->activeModels)
             [activeModel updateForFrame:frameInfo];
         
-        if (perfInterval > 0)
-            perfTimer.addCount("Scene changes", scene->changeRequests.size());
-        
 		// Merge any outstanding changes into the scenegraph
-		// Or skip it if we don't acquire the lock
 		scene->processChanges(super.theView,self);
         
         if (perfInterval > 0)
-            perfTimer.stopTiming("Scene processing");
+        {
+            const ChangeStats &changeStats = scene->getChangeStats();
+            perfTimer.addCount("Scene changes", changeStats.numExecuted);
+            perfTimer.addCount("Scene changes pending", changeStats.numPending);
+        }
         
         if (perfInterval > 0)
-            perfTimer.startTiming("Culling");
+            perfTimer.stopTiming("Scene processing");
+        Profiler::end(SceneProcessingZone);
 		
 		// We need a reverse of the eye vector in model space
 		// We'll use this to determine what's pointed away
 		Eigen::Matrix4f modelTransInv = modelTrans.inverse();
 		Vector4f eyeVec4 = modelTransInv * Vector4f(0,0,1,0);
-		Vector3f eyeVec3(eyeVec4.x(),eyeVec4.y(),eyeVec4.z());
-        frameInfo.eyeVec = eyeVec3;
+		frameSetup.eyeVec = Vector3f(eyeVec4.x(),eyeVec4.y(),eyeVec4.z());
+        frameInfo.eyeVec = frameSetup.eyeVec;
         Eigen::Matrix4f fullTransInv = modelAndViewMat.inverse();
         Vector4f fullEyeVec4 = fullTransInv * Vector4f(0,0,1,0);
         Vector3f fullEyeVec3(fullEyeVec4.x(),fullEyeVec4.y(),fullEyeVec4.z());
         frameInfo.fullEyeVec = -fullEyeVec3;
-        frameInfo.heightAboveSurface = 0.0;
-        // Note: Should deal with map view as well
-        if (globeView)
-            frameInfo.heightAboveSurface = globeView.heightAboveSurface;
-		
-        // If we're looking at a globe, run the culling
-        std::set<DrawableRef> toDraw;
-        int drawablesConsidered = 0;
-        CullTree *cullTree = scene->getCullTree();
-        // Recursively search for the drawables that overlap the screen
-        Mbr screenMbr;
-        // Stretch the screen MBR a little for safety
-        screenMbr.addPoint(Point2f(-ScreenOverlap*framebufferWidth,-ScreenOverlap*framebufferHeight));
-        screenMbr.addPoint(Point2f((1+ScreenOverlap)*framebufferWidth,(1+ScreenOverlap)*framebufferHeight));
-        [self findDrawables:cullTree->getTopCullable() view:globeView frameSize:Point2f(framebufferWidth,framebufferHeight) modelTrans:&modelTrans4d eyeVec:eyeVec3 frameInfo:frameInfo screenMbr:screenMbr topLevel:true toDraw:&toDraw considered:&drawablesConsidered];
+        // Drawables check this when deciding if they're on, possibly from other threads
+        frameInfo.heightAboveSurface = [super.theView heightAboveSurface];
         
-        // Turn these drawables in to a vector
-		std::vector<Drawable *> drawList;
-        //		drawList.reserve(toDraw.size());
-		for (std::set<DrawableRef>::iterator it = toDraw.begin();
-			 it != toDraw.end(); ++it)
+        if (_buildCommandLists)
         {
-            Drawable *theDrawable = it->get();
-            if (theDrawable)
-                drawList.push_back(theDrawable);
-            else
-                NSLog(@"Bad drawable coming from cull tree.");
-        }
-        
-        if (perfInterval > 0)
-            perfTimer.stopTiming("Culling");
-        
-        if (perfInterval > 0)
-            perfTimer.startTiming("Generators - generate");
-        
-        // Now ask our generators to make their drawables
-        // Note: Not doing any culling here
-        //       And we should reuse these Drawables
-        std::vector<DrawableRef> generatedDrawables,screenDrawables;
-        const GeneratorSet *generators = scene->getGenerators();
-        for (GeneratorSet::iterator it = generators->begin();
-             it != generators->end(); ++it)
-            (*it)->generateDrawables(frameInfo, generatedDrawables, screenDrawables);
-        
-        // Add the generated drawables and sort them all together
-        for (unsigned int ii=0;ii<generatedDrawables.size();ii++)
-        {
-            Drawable *theDrawable = generatedDrawables[ii].get();
-            if (theDrawable)
-                drawList.push_back(theDrawable);
-        }
-        bool sortLinesToEnd = (super.zBufferMode == zBufferOffDefault);
-        std::sort(drawList.begin(),drawList.end(),DrawListSortStruct2(super.sortAlphaToEnd,sortLinesToEnd,frameInfo));
-        
-        if (perfInterval > 0)
-        {
-            perfTimer.addCount("Drawables considered", drawablesConsidered);
-            perfTimer.addCount("Cullables", cullTree->getCount());
-        }
-        
-        if (perfInterval > 0)
-            perfTimer.stopTiming("Generators - generate");
-        
-        if (perfInterval > 0)
-            perfTimer.startTiming("Draw Execution");
-        
-        SimpleIdentity curProgramId = EmptyIdentity;
-		
-        bool depthMaskOn = (super.zBufferMode == zBufferOn);
-		for (unsigned int ii=0;ii<drawList.size();ii++)
-		{
-			Drawable *drawable = drawList[ii];
-            
-            // The first time we hit an explicitly alpha drawable
-            //  turn off the depth buffer
-            if (super.depthBufferOffForAlpha && !(super.zBufferMode == zBufferOffDefault))
-            {
-                if (depthMaskOn && super.depthBufferOffForAlpha && drawable->hasAlpha(frameInfo))
-                {
-                    depthMaskOn = false;
-                    [renderStateOptimizer setEnableDepthTest:false];
-                }
-            }
-            
-            // For this mode we turn the z buffer off until we get a request to turn it on
-            if (super.zBufferMode == zBufferOffDefault)
-            {
-                if (drawable->getRequestZBuffer())
-                {
-                    [renderStateOptimizer setDepthFunc:GL_LESS];
-                    depthMaskOn = true;
-                } else {
-                    [renderStateOptimizer setDepthFunc:GL_ALWAYS];
-                }
-            }
-
-            // If we're drawing lines or points we don't want to update the z buffer
-            if (super.zBufferMode != zBufferOff)
-            {
-                if (drawable->getWriteZbuffer())
-                    [renderStateOptimizer setDepthMask:GL_TRUE];
-                else
-                    [renderStateOptimizer setDepthMask:GL_FALSE];
-            }
-            
-            // If it has a local transform, apply that
-            const Matrix4d *localMat = drawable->getMatrix();
-            if (localMat)
-            {
-                Eigen::Matrix4d newMvpMat = projMat4d * (viewTrans4d * (modelTrans4d * (*localMat)));
-                Eigen::Matrix4f newMvpMat4f = Matrix4dToMatrix4f(newMvpMat);
-                frameInfo.mvpMat = newMvpMat4f;
-            }
-            
-            // Figure out the program to use for drawing
-            SimpleIdentity drawProgramId = drawable->getProgram();
-            if (drawProgramId == EmptyIdentity)
-                drawProgramId = defaultTriShader;
-            if (drawProgramId != curProgramId)
-            {
-                curProgramId = drawProgramId;
-                OpenGLES2Program *program = scene->getProgram(drawProgramId);
-                if (program)
-                {
-//                    [renderStateOptimizer setUseProgram:program->getProgram()];
-                    glUseProgram(program->getProgram());
-                    // Assign the lights if we need to
-                    if (program->hasLights() && ([lights count] > 0))
-                        program->setLights(lights, lightsLastUpdated, defaultMat, frameInfo.mvpMat);
-                    // Explicitly turn the lights on
-                    program->setUniform(kWKOGLNumLights, (int)[lights count]);
-
-                    frameInfo.program = program;
-                }
-            }
-            if (drawProgramId == EmptyIdentity)
-                continue;
-            
-            // Draw using the given program
-            drawable->draw(frameInfo,scene);
-            
-            // If we had a local matrix, set the frame info back to the general one
-            if (localMat)
-                frameInfo.mvpMat = mvpMat;
-            
-            numDrawables++;
-            if (perfInterval > 0)
-            {
-                // Note: Need a better way to track buffer ID growth
-//                BasicDrawable *basicDraw = dynamic_cast<BasicDrawable *>(drawable);
-//                if (basicDraw)
-//                    perfTimer.addCount("Buffer IDs", basicDraw->getPointBuffer());
-            }
-		}
-        
-        if (perfInterval > 0)
-            perfTimer.addCount("Drawables drawn", numDrawables);
-        
-        if (perfInterval > 0)
-            perfTimer.stopTiming("Draw Execution");
-        
-        // Anything generated needs to be cleaned up
-        generatedDrawables.clear();
-        drawList.clear();
-        
-        if (perfInterval > 0)
-            perfTimer.startTiming("Generators - Draw 2D");
-        
-        // Now for the 2D display
-        if (!screenDrawables.empty())
-        {
-            curProgramId = EmptyIdentity;
-            
-            [renderStateOptimizer setEnableDepthTest:false];
-            // Sort by draw priority (and alpha, I guess)
-            for (unsigned int ii=0;ii<screenDrawables.size();ii++)
-            {
-                Drawable *theDrawable = screenDrawables[ii].get();
-                if (theDrawable)
-                    drawList.push_back(theDrawable);
-                else
-                    NSLog(@"Bad drawable coming from generator.");
-            }
-            std::sort(drawList.begin(),drawList.end(),DrawListSortStruct2(false,false,frameInfo));
-
-            // Build an orthographic projection
-            // We flip the vertical axis and spread the window out (0,0)->(width,height)
-            Eigen::Matrix4f orthoMat = Matrix4f::Identity();
-            Vector3f delta(framebufferWidth,-framebufferHeight,2.0);
-            orthoMat(0,0) = 2.0f / delta.x();
-            orthoMat(0,3) = -(framebufferWidth) / delta.x();
-            orthoMat(1,1) = 2.0f / delta.y();
-            orthoMat(1,3) = -framebufferHeight / delta.y();
-            orthoMat(2,2) = -2.0f / delta.z();
-            orthoMat(2,3) = 0.0f;
-            frameInfo.mvpMat = orthoMat;
-            // Turn off lights
-            frameInfo.lights = nil;
-            
-            for (unsigned int ii=0;ii<drawList.size();ii++)
-            {
-                Drawable *drawable = drawList[ii];
-                
-                if (drawable->isOn(frameInfo))
-                {
-                    // Figure out the program to use for drawing
-                    SimpleIdentity drawProgramId = drawable->getProgram();
-                    if (drawProgramId == EmptyIdentity)
-                        drawProgramId = defaultTriShader;
-                    if (drawProgramId != curProgramId)
-                    {
-                        curProgramId = drawProgramId;
-                        OpenGLES2Program *program = scene->getProgram(drawProgramId);
-                        if (program)
-                        {
-//                            [renderStateOptimizer setUseProgram:program->getProgram()];
-                            glUseProgram(program->getProgram());
-                            // Explicitly turn the lights off
-                            program->setUniform(kWKOGLNumLights, 0);
-                            frameInfo.program = program;
-                        }
-                    }
-
-                    drawable->draw(frameInfo,scene);
-                    numDrawables++;
-                }
-            }
-            
-            screenDrawables.clear();
-            drawList.clear();
+            // The builder records this frame while we go off and present the last one
+            [self startCommandList:frameInfo view:globeView];
+        } else {
+            std::vector<DrawableRef> keepDrawables;
+            [self drawScene:scene frameInfo:frameInfo setup:&frameSetup view:globeView perfTimer:&perfTimer keepDrawables:&keepDrawables];
         }
-        
-        if (perfInterval > 0)
-            perfTimer.stopTiming("Generators - Draw 2D");
     }
     
 //    if (perfInterval > 0)
@@ -619,28 +470,35 @@ static const float ScreenOverlap = 0.1;
 //    if (perfInterval > 0)
 //        perfTimer.stopTiming("glFinish");
     
-    if (perfInterval > 0)
-        perfTimer.startTiming("Present Renderbuffer");
-    
-    // Explicitly discard the depth buffer
-    const GLenum discards[]  = {GL_DEPTH_ATTACHMENT};
-    glDiscardFramebufferEXT(GL_FRAMEBUFFER,1,discards);
-    CheckGLError("SceneRendererES2: glDiscardFramebufferEXT");
-
-    if (!renderSetup)
+    if (presentFrame)
     {
-        glBindRenderbuffer(GL_RENDERBUFFER, colorRenderbuffer);
-        CheckGLError("SceneRendererES2: glBindRenderbuffer");
-    }
+        if (perfInterval > 0)
+            perfTimer.startTiming("Present Renderbuffer");
+        Profiler::begin(PresentZone);
+        
+        // Explicitly discard the depth buffer
+        const GLenum discards[]  = {GL_DEPTH_ATTACHMENT};
+        GetGLBackend()->discardFramebuffer(GL_FRAMEBUFFER,1,discards);
+        CheckGLError("SceneRendererES2: glDiscardFramebufferEXT");
 
-    [context presentRenderbuffer:GL_RENDERBUFFER];
-    CheckGLError("SceneRendererES2: presentRenderbuffer");
+        if (!renderSetup)
+        {
+            GetGLBackend()->bindRenderbuffer(GL_RENDERBUFFER, colorRenderbuffer);
+            CheckGLError("SceneRendererES2: glBindRenderbuffer");
+        }
 
-    if (perfInterval > 0)
-        perfTimer.stopTiming("Present Renderbuffer");
+        [context presentRenderbuffer:GL_RENDERBUFFER];
+        CheckGLError("SceneRendererES2: presentRenderbuffer");
+
+        if (perfInterval > 0)
+            perfTimer.stopTiming("Present Renderbuffer");
+        Profiler::end(PresentZone);
+    }
     
     if (perfInterval > 0)
         perfTimer.stopTiming("Render Frame");
+    LatencyMetrics::recordSince(FrameLatency, frameStart);
+    LatencyMetrics::snapshotIfDue();
     
 	// Update the frames per sec
 	if (super.perfInterval > 0 && frameCount > perfInterval)
@@ -655,6 +513,15 @@ static const float ScreenOverlap = 0.1;
         NSLog(@" Frames per sec = %.2f",super.framesPerSec);
         perfTimer.log();
         perfTimer.clear();
+        if (commandListPending)
+        {
+            // The builder's timer isn't ours to look at until it's done
+            dispatch_group_wait(frameBuilderGroup, DISPATCH_TIME_FOREVER);
+            NSLog(@"---Frame Builder Performance---");
+            builderPerfTimer.log();
+            builderPerfTimer.clear();
+        }
+        [self logLatencies];
 	}
     
     if (oldContext != context)
@@ -663,4 +530,300 @@ static const float ScreenOverlap = 0.1;
     renderSetup = true;
 }
 
+// Write out the latency percentiles from the last snapshot
+- (void) logLatencies
+{
+    std::vector<LatencySummary> summaries;
+    LatencyMetrics::getSummaries(LatencyMetrics::LastInterval, summaries);
+    if (summaries.empty())
+        return;
+    
+    NSLog(@"---Latencies (ms) over %.1fs---",LatencyMetrics::getLastIntervalLength());
+    for (unsigned int ii=0;ii<summaries.size();ii++)
+    {
+        const LatencySummary &summary = summaries[ii];
+        NSLog(@"  %s: count = %llu, p50 = %.2f, p95 = %.2f, p99 = %.2f, max = %.2f",summary.name.c_str(),summary.count,
+              summary.p50/1000.0,summary.p95/1000.0,summary.p99/1000.0,summary.max/1000.0);
+    }
+}
+
+// Set up the depth state, then cull, sort and draw everything in the scene.
+// If we're building command lists, this runs on the frame builder thread
+//  and the GL calls are being recorded for later.
+- (void) drawScene:(Scene *)scene frameInfo:(WhirlyKitRendererFrameInfo *)frameInfo setup:(RenderFrameSetup *)setup view:(WhirlyGlobeView *)globeView perfTimer:(PerformanceTimer *)timer keepDrawables:(std::vector<DrawableRef> *)keepDrawables
+{
+    ProfileScope profile(BuildFrameZone);
+    
+    NSTimeInterval perfInterval = super.perfInterval;
+    GLint framebufferWidth = setup->framebufferWidth;
+    GLint framebufferHeight = setup->framebufferHeight;
+    SimpleIdentity defaultTriShader = setup->defaultTriShader;
+    Eigen::Matrix4f mvpMat = setup->mvpMat;
+    int numDrawables = 0;
+    
+    // Changes may have bound textures and such since we last drew
+    [renderStateOptimizer beginFrame];
+    
+    // Turn on blending
+    [renderStateOptimizer setBlendFuncSrc:GL_ONE dst:GL_ONE_MINUS_SRC_ALPHA];
+    [renderStateOptimizer setEnableBlend:true];
+    
+    switch (super.zBufferMode)
+    {
+        case zBufferOn:
+            [renderStateOptimizer setDepthMask:GL_TRUE];
+            [renderStateOptimizer setEnableDepthTest:true];
+            [renderStateOptimizer setDepthFunc:GL_LESS];
+            break;
+        case zBufferOff:
+            [renderStateOptimizer setDepthMask:GL_FALSE];
+            [renderStateOptimizer setEnableDepthTest:false];
+            break;
+        case zBufferOffDefault:
+            [renderStateOptimizer setDepthMask:GL_TRUE];
+            [renderStateOptimizer setEnableDepthTest:true];
+            [renderStateOptimizer setDepthFunc:GL_ALWAYS];
+            break;
+    }
+    
+	GetGLBackend()->clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    CheckGLError("SceneRendererES2: glClear");
+    
+    if (perfInterval > 0)
+        timer->startTiming("Culling");
+    Profiler::begin(CullingZone);
+    
+    // If we're looking at a globe, run the culling
+    std::vector<Drawable *> drawList;
+    int drawablesConsidered = 0;
+    CullTree *cullTree = scene->getCullTree();
+    // Recursively search for the drawables that overlap the screen
+    Mbr screenMbr;
+    // Stretch the screen MBR a little for safety
+    screenMbr.addPoint(Point2f(-ScreenOverlap*framebufferWidth,-ScreenOverlap*framebufferHeight));
+    screenMbr.addPoint(Point2f((1+ScreenOverlap)*framebufferWidth,(1+ScreenOverlap)*framebufferHeight));
+    [self findDrawables:cullTree view:globeView frameSize:Point2f(framebufferWidth,framebufferHeight) modelTrans:&setup->modelTrans4d eyeVec:setup->eyeVec frameInfo:frameInfo screenMbr:screenMbr toDraw:&drawList considered:&drawablesConsidered];
+    
+    if (perfInterval > 0)
+        timer->stopTiming("Culling");
+    Profiler::end(CullingZone);
+    
+    if (perfInterval > 0)
+        timer->startTiming("Generators - generate");
+    Profiler::begin(GenerateZone);
+    
+    // Now ask our generators to make their drawables
+    // Note: Not doing any culling here
+    //       And we should reuse these Drawables
+    std::vector<DrawableRef> generatedDrawables,screenDrawables;
+    const GeneratorSet *generators = scene->getGenerators();
+    for (GeneratorSet::iterator it = generators->begin();
+         it != generators->end(); ++it)
+        (*it)->generateDrawables(frameInfo, generatedDrawables, screenDrawables);
+    
+    // Add the generated drawables and sort them all together
+    for (unsigned int ii=0;ii<generatedDrawables.size();ii++)
+    {
+        Drawable *theDrawable = generatedDrawables[ii].get();
+        if (theDrawable)
+            drawList.push_back(theDrawable);
+    }
+    bool sortLinesToEnd = (super.zBufferMode == zBufferOffDefault);
+    drawListSorter.sort(drawList,super.sortAlphaToEnd,sortLinesToEnd,frameInfo,workerPool);
+    
+    Profiler::count(DrawablesConsideredCount, drawablesConsidered);
+    if (perfInterval > 0)
+    {
+        timer->addCount("Drawables considered", drawablesConsidered);
+        timer->addCount("Cullables", cullTree->getCount());
+        timer->addCount("Cull nodes tested", cullTree->getNodesTested());
+        timer->addCount("Cull nodes reused", cullTree->getNodesReused());
+    }
+    
+    if (perfInterval > 0)
+        timer->stopTiming("Generators - generate");
+    Profiler::end(GenerateZone);
+    
+    if (perfInterval > 0)
+        timer->startTiming("Draw Execution");
+    Profiler::begin(DrawZone);
+    
+    SimpleIdentity curProgramId = EmptyIdentity;
+    
+    bool depthMaskOn = (super.zBufferMode == zBufferOn);
+    for (unsigned int ii=0;ii<drawList.size();ii++)
+    {
+        Drawable *drawable = drawList[ii];
+        
+        // The first time we hit an explicitly alpha drawable
+        //  turn off the depth buffer
+        if (super.depthBufferOffForAlpha && !(super.zBufferMode == zBufferOffDefault))
+        {
+            if (depthMaskOn && super.depthBufferOffForAlpha && drawable->hasAlpha(frameInfo))
+            {
+                depthMaskOn = false;
+                [renderStateOptimizer setEnableDepthTest:false];
+            }
+        }
+        
+        // For this mode we turn the z buffer off until we get a request to turn it on
+        if (super.zBufferMode == zBufferOffDefault)
+        {
+            if (drawable->getRequestZBuffer())
+            {
+                [renderStateOptimizer setDepthFunc:GL_LESS];
+                depthMaskOn = true;
+            } else {
+                [renderStateOptimizer setDepthFunc:GL_ALWAYS];
+            }
+        }
+
+        // If we're drawing lines or points we don't want to update the z buffer
+        if (super.zBufferMode != zBufferOff)
+        {
+            if (drawable->getWriteZbuffer())
+                [renderStateOptimizer setDepthMask:GL_TRUE];
+            else
+                [renderStateOptimizer setDepthMask:GL_FALSE];
+        }
+        
+        // If it has a local transform, apply that
+        const Matrix4d *localMat = drawable->getMatrix();
+        if (localMat)
+        {
+            Eigen::Matrix4d newMvpMat = setup->projMat4d * (setup->viewTrans4d * (setup->modelTrans4d * (*localMat)));
+            Eigen::Matrix4f newMvpMat4f = Matrix4dToMatrix4f(newMvpMat);
+            frameInfo.mvpMat = newMvpMat4f;
+        }
+        
+        // Figure out the program to use for drawing
+        SimpleIdentity drawProgramId = drawable->getProgram();
+        if (drawProgramId == EmptyIdentity)
+            drawProgramId = defaultTriShader;
+        if (drawProgramId != curProgramId)
+        {
+            curProgramId = drawProgramId;
+            OpenGLES2Program *program = scene->getProgram(drawProgramId);
+            if (program)
+            {
+                [renderStateOptimizer setUseProgram:program->getProgram()];
+                // Assign the lights if we need to
+                if (program->hasLights() && ([lights count] > 0))
+                    program->setLights(lights, lightsLastUpdated, defaultMat, frameInfo.mvpMat);
+                // Explicitly turn the lights on
+                program->setUniform(StdUniformNumLights, (int)[lights count]);
+
+                frameInfo.program = program;
+            }
+        }
+        if (drawProgramId == EmptyIdentity)
+            continue;
+        
+        // Draw using the given program
+        drawable->draw(frameInfo,scene);
+        
+        // If we had a local matrix, set the frame info back to the general one
+        if (localMat)
+            frameInfo.mvpMat = mvpMat;
+        
+        numDrawables++;
+        if (perfInterval > 0)
+        {
+            // Note: Need a better way to track buffer ID growth
+//            BasicDrawable *basicDraw = dynamic_cast<BasicDrawable *>(drawable);
+//            if (basicDraw)
+//                perfTimer.addCount("Buffer IDs", basicDraw->getPointBuffer());
+        }
+    }
+    
+    Profiler::count(DrawablesDrawnCount, numDrawables);
+    if (perfInterval > 0)
+        timer->addCount("Drawables drawn", numDrawables);
+    
+    if (perfInterval > 0)
+        timer->stopTiming("Draw Execution");
+    Profiler::end(DrawZone);
+    
+    drawList.clear();
+    
+    if (perfInterval > 0)
+        timer->startTiming("Generators - Draw 2D");
+    Profiler::begin(Draw2DZone);
+    
+    // Now for the 2D display
+    if (!screenDrawables.empty())
+    {
+        curProgramId = EmptyIdentity;
+        
+        [renderStateOptimizer setEnableDepthTest:false];
+        // Sort by draw priority (and alpha, I guess)
+        for (unsigned int ii=0;ii<screenDrawables.size();ii++)
+        {
+            Drawable *theDrawable = screenDrawables[ii].get();
+            if (theDrawable)
+                drawList.push_back(theDrawable);
+            else
+                NSLog(@"Bad drawable coming from generator.");
+        }
+        drawListSorter.sort(drawList,false,false,frameInfo,NULL);
+
+        // Build an orthographic projection
+        // We flip the vertical axis and spread the window out (0,0)->(width,height)
+        Eigen::Matrix4f orthoMat = Matrix4f::Identity();
+        Vector3f delta(framebufferWidth,-framebufferHeight,2.0);
+        orthoMat(0,0) = 2.0f / delta.x();
+        orthoMat(0,3) = -(framebufferWidth) / delta.x();
+        orthoMat(1,1) = 2.0f / delta.y();
+        orthoMat(1,3) = -framebufferHeight / delta.y();
+        orthoMat(2,2) = -2.0f / delta.z();
+        orthoMat(2,3) = 0.0f;
+        frameInfo.mvpMat = orthoMat;
+        // Turn off lights
+        frameInfo.lights = nil;
+        
+        for (unsigned int ii=0;ii<drawList.size();ii++)
+        {
+            Drawable *drawable = drawList[ii];
+            
+            if (drawable->isOn(frameInfo))
+            {
+                // Figure out the program to use for drawing
+                SimpleIdentity drawProgramId = drawable->getProgram();
+                if (drawProgramId == EmptyIdentity)
+                    drawProgramId = defaultTriShader;
+                if (drawProgramId != curProgramId)
+                {
+                    curProgramId = drawProgramId;
+                    OpenGLES2Program *program = scene->getProgram(drawProgramId);
+                    if (program)
+                    {
+                        [renderStateOptimizer setUseProgram:program->getProgram()];
+                        // Explicitly turn the lights off
+                        program->setUniform(StdUniformNumLights, 0);
+                        frameInfo.program = program;
+                    }
+                }
+
+                drawable->draw(frameInfo,scene);
+                numDrawables++;
+            }
+        }
+        
+        drawList.clear();
+    }
+    
+    if (perfInterval > 0)
+        timer->stopTiming("Generators - Draw 2D");
+    Profiler::end(Draw2DZone);
+    
+    // Drawables leave their VAO bound.  Scene changes bind element buffers,
+    //  which would land in that VAO, so put it back.
+    [renderStateOptimizer endFrame];
+    
+    // Generated drawables may have vertex data the GL calls point to.
+    // Hang on to them until those calls have been made.
+    keepDrawables->insert(keepDrawables->end(),generatedDrawables.begin(),generatedDrawables.end());
+    keepDrawables->insert(keepDrawables->end(),screenDrawables.begin(),screenDrawables.end());
+}
+
 @end
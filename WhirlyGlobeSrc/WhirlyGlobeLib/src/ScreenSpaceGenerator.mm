@@ -374,6 +374,35 @@ void ScreenSpaceGenerator::dumpStats()
 }
 
 
+// The shape ID behind each kind of target a request keeps
+static SimpleIdentity ShapeTargetID(SimpleIdentity shapeID) { return shapeID; }
+static SimpleIdentity ShapeTargetID(ScreenSpaceGenerator::ConvexShape *shape) { return shape->getId(); }
+static SimpleIdentity ShapeTargetID(const ScreenSpaceGeneratorGangChangeRequest::ShapeChange &change) { return change.shapeID; }
+
+// Shapes a request owns go away when they're dropped.  IDs and changes are just left out.
+static void DiscardShapeTarget(SimpleIdentity shapeID) { }
+static void DiscardShapeTarget(ScreenSpaceGenerator::ConvexShape *shape) { delete shape; }
+static void DiscardShapeTarget(const ScreenSpaceGeneratorGangChangeRequest::ShapeChange &change) { }
+
+// Drop the given shapes from a request's targets, keeping the rest in order.
+// Returns true if there's nothing left.
+template<typename TargetType> static bool DropShapeTargets(std::vector<TargetType> &targets,const std::set<SimpleIdentity> &ids)
+{
+    unsigned int numKept = 0;
+    for (unsigned int ii=0;ii<targets.size();ii++)
+    {
+        if (ids.find(ShapeTargetID(targets[ii])) != ids.end())
+        {
+            DiscardShapeTarget(targets[ii]);
+            continue;
+        }
+        targets[numKept++] = targets[ii];
+    }
+    targets.resize(numKept);
+    
+    return targets.empty();
+}
+
 ScreenSpaceGeneratorAddRequest::ScreenSpaceGeneratorAddRequest(SimpleIdentity genID,ScreenSpaceGenerator::ConvexShape *shape)
     : GeneratorChangeRequest(genID)
 {
@@ -405,6 +434,23 @@ void ScreenSpaceGeneratorAddRequest::execute2(Scene *scene,WhirlyKitSceneRendere
     shapes.clear();
 }
     
+bool ScreenSpaceGeneratorAddRequest::getIDs(std::vector<SimpleIdentity> &ids)
+{
+    getCoalesceIDs(ids);
+    return true;
+}
+    
+void ScreenSpaceGeneratorAddRequest::getCoalesceIDs(std::vector<SimpleIdentity> &ids)
+{
+    for (unsigned int ii=0;ii<shapes.size();ii++)
+        ids.push_back(shapes[ii]->getId());
+}
+    
+bool ScreenSpaceGeneratorAddRequest::dropTargets(const std::set<SimpleIdentity> &ids)
+{
+    return DropShapeTargets(shapes,ids);
+}
+    
 ScreenSpaceGeneratorRemRequest::ScreenSpaceGeneratorRemRequest(SimpleIdentity genID,SimpleIdentity shapeID)
     : GeneratorChangeRequest(genID)
 {
@@ -426,14 +472,31 @@ void ScreenSpaceGeneratorRemRequest::execute2(Scene *scene,WhirlyKitSceneRendere
     screenGen->removeConvexShapes(shapeIDs);
 }
     
+bool ScreenSpaceGeneratorRemRequest::getIDs(std::vector<SimpleIdentity> &ids)
+{
+    getCoalesceIDs(ids);
+    return true;
+}
+    
+void ScreenSpaceGeneratorRemRequest::getCoalesceIDs(std::vector<SimpleIdentity> &ids)
+{
+    for (unsigned int ii=0;ii<shapeIDs.size();ii++)
+        ids.push_back(shapeIDs[ii]);
+}
+    
+bool ScreenSpaceGeneratorRemRequest::dropTargets(const std::set<SimpleIdentity> &ids)
+{
+    return DropShapeTargets(shapeIDs,ids);
+}
+    
 ScreenSpaceGeneratorFadeRequest::ScreenSpaceGeneratorFadeRequest(SimpleIdentity genID,SimpleIdentity shapeID,NSTimeInterval fadeUp,NSTimeInterval fadeDown)
-    : GeneratorChangeRequest(genID), fadeUp(fadeUp), fadeDown(fadeDown)
+    : GeneratorChangeRequest(genID), fadeUp(fadeUp), fadeDown(fadeDown), renderUntil(0.0)
 {
     shapeIDs.push_back(shapeID);
 }
 
 ScreenSpaceGeneratorFadeRequest::ScreenSpaceGeneratorFadeRequest(SimpleIdentity genID,const std::vector<SimpleIdentity> shapeIDs,NSTimeInterval fadeUp,NSTimeInterval fadeDown)
-    : GeneratorChangeRequest(genID), fadeUp(fadeUp), fadeDown(fadeDown), shapeIDs(shapeIDs)
+    : GeneratorChangeRequest(genID), fadeUp(fadeUp), fadeDown(fadeDown), shapeIDs(shapeIDs), renderUntil(0.0)
 {
 }
 
@@ -455,7 +518,31 @@ void ScreenSpaceGeneratorFadeRequest::execute2(Scene *scene,WhirlyKitSceneRender
             [renderer setRenderUntil:fadeUp];
             [renderer setRenderUntil:fadeDown];
         }
-    }    
+    }
+    [renderer setRenderUntil:renderUntil];
+}
+    
+bool ScreenSpaceGeneratorFadeRequest::getIDs(std::vector<SimpleIdentity> &ids)
+{
+    getCoalesceIDs(ids);
+    return true;
+}
+    
+void ScreenSpaceGeneratorFadeRequest::getCoalesceIDs(std::vector<SimpleIdentity> &ids)
+{
+    for (unsigned int ii=0;ii<shapeIDs.size();ii++)
+        ids.push_back(shapeIDs[ii]);
+}
+    
+bool ScreenSpaceGeneratorFadeRequest::dropTargets(const std::set<SimpleIdentity> &ids)
+{
+    return DropShapeTargets(shapeIDs,ids);
+}
+    
+void ScreenSpaceGeneratorFadeRequest::takeOverTarget(ChangeRequest *earlier,SimpleIdentity targetID)
+{
+    ScreenSpaceGeneratorFadeRequest *earlierFade = (ScreenSpaceGeneratorFadeRequest *)earlier;
+    renderUntil = std::max(renderUntil,std::max(earlierFade->renderUntil,std::max(earlierFade->fadeUp,earlierFade->fadeDown)));
 }
     
 ScreenSpaceGeneratorEnableRequest::ScreenSpaceGeneratorEnableRequest(SimpleIdentity genID,const std::vector<SimpleIdentity> &shapeIDs,bool enable)
@@ -477,13 +564,30 @@ void ScreenSpaceGeneratorEnableRequest::execute2(Scene *scene,WhirlyKitSceneRend
     }
 }
     
+bool ScreenSpaceGeneratorEnableRequest::getIDs(std::vector<SimpleIdentity> &ids)
+{
+    getCoalesceIDs(ids);
+    return true;
+}
+    
+void ScreenSpaceGeneratorEnableRequest::getCoalesceIDs(std::vector<SimpleIdentity> &ids)
+{
+    for (unsigned int ii=0;ii<shapeIDs.size();ii++)
+        ids.push_back(shapeIDs[ii]);
+}
+    
+bool ScreenSpaceGeneratorEnableRequest::dropTargets(const std::set<SimpleIdentity> &ids)
+{
+    return DropShapeTargets(shapeIDs,ids);
+}
+    
 ScreenSpaceGeneratorGangChangeRequest::ShapeChange::ShapeChange()
  : shapeID(EmptyIdentity), fadeUp(0.0), fadeDown(0.0), offset(0.0,0.0)
 {
 }
     
 ScreenSpaceGeneratorGangChangeRequest::ScreenSpaceGeneratorGangChangeRequest(SimpleIdentity genID,const std::vector<ShapeChange> &changes)
-    : GeneratorChangeRequest(genID), changes(changes)
+    : GeneratorChangeRequest(genID), changes(changes), renderUntil(0.0)
 {
 }
     
@@ -505,6 +609,36 @@ void ScreenSpaceGeneratorGangChangeRequest::execute2(Scene *scene,WhirlyKitScene
             [renderer setRenderUntil:change.fadeDown];
         }
     }
+    [renderer setRenderUntil:renderUntil];
+}
+    
+bool ScreenSpaceGeneratorGangChangeRequest::getIDs(std::vector<SimpleIdentity> &ids)
+{
+    getCoalesceIDs(ids);
+    return true;
+}
+    
+void ScreenSpaceGeneratorGangChangeRequest::getCoalesceIDs(std::vector<SimpleIdentity> &ids)
+{
+    for (unsigned int ii=0;ii<changes.size();ii++)
+        ids.push_back(changes[ii].shapeID);
+}
+    
+bool ScreenSpaceGeneratorGangChangeRequest::dropTargets(const std::set<SimpleIdentity> &ids)
+{
+    return DropShapeTargets(changes,ids);
+}
+    
+void ScreenSpaceGeneratorGangChangeRequest::takeOverTarget(ChangeRequest *earlier,SimpleIdentity targetID)
+{
+    ScreenSpaceGeneratorGangChangeRequest *earlierGang = (ScreenSpaceGeneratorGangChangeRequest *)earlier;
+    renderUntil = std::max(renderUntil,earlierGang->renderUntil);
+    for (unsigned int ii=0;ii<earlierGang->changes.size();ii++)
+    {
+        const ShapeChange &change = earlierGang->changes[ii];
+        if (change.shapeID == targetID)
+            renderUntil = std::max(renderUntil,std::max(change.fadeUp,change.fadeDown));
+    }
 }
     
 }
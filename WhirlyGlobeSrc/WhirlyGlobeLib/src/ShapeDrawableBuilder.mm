@@ -66,6 +66,7 @@ static const int MaxShapeDrawableTris=1<<15/3;
     _zBufferWrite = [desc floatForKey:@"zbufferwrite" default:true];
     _enable = [desc boolForKey:@"enable" default:true];
     _shaderID = [desc intForKey:@"shader" default:EmptyIdentity];
+    _optimizeMesh = [desc boolForKey:@"optimizemesh" default:false];
 }
 
 @end
@@ -74,35 +75,25 @@ static const int MaxShapeDrawableTris=1<<15/3;
 namespace WhirlyKit
 {
     
-ShapeDrawableBuilder::ShapeDrawableBuilder(CoordSystemDisplayAdapter *coordAdapter,WhirlyKitShapeInfo *shapeInfo,bool linesOrPoints)
-        : coordAdapter(coordAdapter), shapeInfo(shapeInfo), drawable(NULL)
+/// Sets up each drawable with the shape info as the chunked builder creates them
+class ShapeChunkBuilder : public ChunkedDrawableBuilder
 {
-    primType = (linesOrPoints ? GL_LINES : GL_POINTS);
-}
+public:
+    ShapeChunkBuilder(WhirlyKitShapeInfo *shapeInfo,GLenum type,bool setColor)
+    : ChunkedDrawableBuilder("Shape Layer",type), shapeInfo(shapeInfo), lineWidth(1.0), setColor(setColor)
+    {
+    }
     
-ShapeDrawableBuilder::~ShapeDrawableBuilder()
-{
-    for (unsigned int ii=0;ii<drawables.size();ii++)
-        delete drawables[ii];
-}
-
-void ShapeDrawableBuilder::addPoints(std::vector<Point3f> &pts,RGBAColor color,Mbr mbr,float lineWidth,bool closed)
-{
-    // Decide if we'll appending to an existing drawable or
-    //  create a new one
-    int ptCount = 2*(pts.size()+1);
-    if (!drawable || (drawable->getNumPoints()+ptCount > MaxDrawablePoints) || (drawable->getLineWidth() != lineWidth))
+    /// Line width for the drawables we're currently building
+    float lineWidth;
+    
+protected:
+    void setupDrawable(BasicDrawable *drawable)
     {
-        // We're done with it, toss it to the scene
-        if (drawable)
-            flush();
-        
-        drawable = new BasicDrawable("Shape Layer");
-        drawMbr.reset();
-        drawable->setType(primType);
         // Adjust according to the vector info
         drawable->setDrawOffset(shapeInfo.drawOffset);
-        //            drawable->setColor([shapeInfo.color asRGBAColor]);
+        if (setColor)
+            drawable->setColor([shapeInfo.color asRGBAColor]);
         drawable->setLineWidth(lineWidth);
         drawable->setDrawPriority(shapeInfo.drawPriority);
         drawable->setVisibleRange(shapeInfo.minVis,shapeInfo.maxVis);
@@ -110,8 +101,39 @@ void ShapeDrawableBuilder::addPoints(std::vector<Point3f> &pts,RGBAColor color,M
         drawable->setWriteZBuffer(shapeInfo.zBufferWrite);
         drawable->setOnOff(shapeInfo.enable);
         drawable->setProgram(shapeInfo.shaderID);
+        
+        if (shapeInfo.fade > 0.0)
+        {
+            NSTimeInterval curTime = CFAbsoluteTimeGetCurrent();
+            drawable->setFade(curTime,curTime+shapeInfo.fade);
+        }
     }
-    drawMbr.expand(mbr);
+    
+    WhirlyKitShapeInfo *shapeInfo;
+    bool setColor;
+};
+    
+ShapeDrawableBuilder::ShapeDrawableBuilder(CoordSystemDisplayAdapter *coordAdapter,WhirlyKitShapeInfo *shapeInfo,bool linesOrPoints)
+        : coordAdapter(coordAdapter), shapeInfo(shapeInfo)
+{
+    primType = (linesOrPoints ? GL_LINES : GL_POINTS);
+    chunkBuilder = new ShapeChunkBuilder(shapeInfo,primType,false);
+}
+    
+ShapeDrawableBuilder::~ShapeDrawableBuilder()
+{
+    for (unsigned int ii=0;ii<drawables.size();ii++)
+        delete drawables[ii];
+    delete chunkBuilder;
+}
+
+void ShapeDrawableBuilder::addPoints(std::vector<Point3f> &pts,RGBAColor color,Mbr mbr,float lineWidth,bool closed)
+{
+    // Line width is per drawable, so we have to finish up the ones we've got
+    if (chunkBuilder->getNumPoints() > 0 && chunkBuilder->lineWidth != lineWidth)
+        flush();
+    chunkBuilder->lineWidth = lineWidth;
+    chunkBuilder->startGroup(mbr);
     
     Point3f prevPt,prevNorm,firstPt,firstNorm;
     for (unsigned int jj=0;jj<pts.size();jj++)
@@ -125,17 +147,12 @@ void ShapeDrawableBuilder::addPoints(std::vector<Point3f> &pts,RGBAColor color,M
         // Depending on the type, we do this differently
         if (primType == GL_POINTS)
         {
-            drawable->addPoint(pt);
-            drawable->addNormal(norm);
+            chunkBuilder->addPoint(pt,norm,color);
         } else {
             if (jj > 0)
             {
-                drawable->addPoint(prevPt);
-                drawable->addNormal(prevNorm);
-                drawable->addColor(color);
-                drawable->addPoint(pt);
-                drawable->addNormal(norm);
-                drawable->addColor(color);
+                chunkBuilder->addPoint(prevPt,prevNorm,color);
+                chunkBuilder->addPoint(pt,norm,color);
             } else {
                 firstPt = pt;
                 firstNorm = norm;
@@ -148,33 +165,14 @@ void ShapeDrawableBuilder::addPoints(std::vector<Point3f> &pts,RGBAColor color,M
     // Close the loop
     if (closed && primType == GL_LINES)
     {
-        drawable->addPoint(prevPt);
-        drawable->addNormal(prevNorm);
-        drawable->addColor(color);
-        drawable->addPoint(firstPt);
-        drawable->addNormal(firstNorm);
-        drawable->addColor(color);
+        chunkBuilder->addPoint(prevPt,prevNorm,color);
+        chunkBuilder->addPoint(firstPt,firstNorm,color);
     }
 }
 
 void ShapeDrawableBuilder::flush()
 {
-    if (drawable)
-    {
-        if (drawable->getNumPoints() > 0)
-        {
-            drawable->setLocalMbr(drawMbr);
-            
-            if (shapeInfo.fade > 0.0)
-            {
-                NSTimeInterval curTime = CFAbsoluteTimeGetCurrent();
-                drawable->setFade(curTime,curTime+shapeInfo.fade);
-            }
-            drawables.push_back(drawable);
-        } else
-            delete drawable;
-        drawable = NULL;
-    }
+    chunkBuilder->buildDrawables(drawables);
 }
 
 void ShapeDrawableBuilder::getChanges(ChangeSet &changeRequests,SimpleIDSet &drawIDs)
@@ -191,89 +189,40 @@ void ShapeDrawableBuilder::getChanges(ChangeSet &changeRequests,SimpleIDSet &dra
 
 
 ShapeDrawableBuilderTri::ShapeDrawableBuilderTri(WhirlyKit::CoordSystemDisplayAdapter *coordAdapter,WhirlyKitShapeInfo *shapeInfo)
-: coordAdapter(coordAdapter), shapeInfo(shapeInfo), drawable(NULL)
+: coordAdapter(coordAdapter), shapeInfo(shapeInfo)
 {
+    chunkBuilder = new ShapeChunkBuilder(shapeInfo,GL_TRIANGLES,true);
+    chunkBuilder->setOptimizeMeshes(shapeInfo.optimizeMesh);
 }
     
 ShapeDrawableBuilderTri::~ShapeDrawableBuilderTri()
 {
     for (unsigned int ii=0;ii<drawables.size();ii++)
         delete drawables[ii];
-}
-    
-void ShapeDrawableBuilderTri::setupNewDrawable()
-{
-    drawable = new BasicDrawable("Shape Layer");
-    drawMbr.reset();
-    drawable->setType(GL_TRIANGLES);
-    // Adjust according to the vector info
-    drawable->setDrawOffset(shapeInfo.drawOffset);
-    drawable->setColor([shapeInfo.color asRGBAColor]);
-    drawable->setDrawPriority(shapeInfo.drawPriority);
-    drawable->setVisibleRange(shapeInfo.minVis,shapeInfo.maxVis);
-    drawable->setRequestZBuffer(shapeInfo.zBufferRead);
-    drawable->setWriteZBuffer(shapeInfo.zBufferWrite);
-    drawable->setOnOff(shapeInfo.enable);
-    drawable->setProgram(shapeInfo.shaderID);
+    delete chunkBuilder;
 }
     
 // Add a triangle with normals
 void ShapeDrawableBuilderTri::addTriangle(Point3f p0,Point3f n0,RGBAColor c0,Point3f p1,Point3f n1,RGBAColor c1,Point3f p2,Point3f n2,RGBAColor c2,Mbr shapeMbr)
 {
-    if (!drawable ||
-        (drawable->getNumPoints()+3 > MaxDrawablePoints) ||
-        (drawable->getNumTris()+1 > MaxDrawableTriangles))
-    {
-        // We're done with it, toss it to the scene
-        if (drawable)
-            flush();
-        
-        setupNewDrawable();
-    }
-    Mbr mbr = drawable->getLocalMbr();
-    mbr.expand(shapeMbr);
-    drawable->setLocalMbr(mbr);
-    int baseVert = drawable->getNumPoints();
-    drawable->addPoint(p0);
-    drawable->addNormal(n0);
-    drawable->addColor(c0);
-    drawable->addPoint(p1);
-    drawable->addNormal(n1);
-    drawable->addColor(c1);
-    drawable->addPoint(p2);
-    drawable->addNormal(n2);
-    drawable->addColor(c2);
+    chunkBuilder->startGroup(shapeMbr);
+    chunkBuilder->addPoint(p0,n0,c0);
+    chunkBuilder->addPoint(p1,n1,c1);
+    chunkBuilder->addPoint(p2,n2,c2);
     
-    drawable->addTriangle(BasicDrawable::Triangle(0+baseVert,2+baseVert,1+baseVert));
-    drawMbr.expand(shapeMbr);
+    chunkBuilder->addTriangle(0,2,1);
 }
     
 // Add a group of pre-build triangles
 void ShapeDrawableBuilderTri::addTriangles(std::vector<Point3f> &pts,std::vector<Point3f> &norms,std::vector<RGBAColor> &colors,std::vector<BasicDrawable::Triangle> &tris)
 {
-    if (!drawable ||
-        (drawable->getNumPoints()+pts.size() > MaxDrawablePoints) ||
-        (drawable->getNumTris()+tris.size() > MaxDrawableTriangles))
-    {
-        if (drawable)
-            flush();
-        
-        setupNewDrawable();
-    }
-    
-    int baseVert = drawable->getNumPoints();
+    chunkBuilder->startGroup(Mbr());
     for (unsigned int ii=0;ii<pts.size();ii++)
-    {
-        drawable->addPoint(pts[ii]);
-        drawable->addNormal(norms[ii]);
-        drawable->addColor(colors[ii]);
-    }
+        chunkBuilder->addPoint(pts[ii],norms[ii],colors[ii]);
     for (unsigned int ii=0;ii<tris.size();ii++)
     {
-        BasicDrawable::Triangle tri = tris[ii];
-        for (unsigned int jj=0;jj<3;jj++)
-            tri.verts[jj] += baseVert;
-        drawable->addTriangle(tri);
+        BasicDrawable::Triangle &tri = tris[ii];
+        chunkBuilder->addTriangle(tri.verts[0],tri.verts[1],tri.verts[2]);
     }
 }
     
@@ -281,28 +230,16 @@ void ShapeDrawableBuilderTri::addTriangles(std::vector<Point3f> &pts,std::vector
 void ShapeDrawableBuilderTri::addConvexOutline(std::vector<Point3f> &pts,Point3f norm,RGBAColor color,Mbr shapeMbr)
 {
     // It's convex, so we'll just triangulate it dumb style
+    chunkBuilder->startGroup(shapeMbr);
+    for (unsigned int ii=0;ii<pts.size();ii++)
+        chunkBuilder->addPoint(pts[ii],norm,color);
     for (unsigned int ii = 2;ii<pts.size();ii++)
-        addTriangle(pts[0], norm, color, pts[ii-1], norm, color, pts[ii], norm, color, shapeMbr);
+        chunkBuilder->addTriangle(0, ii, ii-1);
 }
     
 void ShapeDrawableBuilderTri::flush()
 {
-    if (drawable)
-    {
-        if (drawable->getNumPoints() > 0)
-        {
-            drawable->setLocalMbr(drawMbr);
-            
-            if (shapeInfo.fade > 0.0)
-            {
-                NSTimeInterval curTime = CFAbsoluteTimeGetCurrent();
-                drawable->setFade(curTime,curTime+shapeInfo.fade);
-            }
-            drawables.push_back(drawable);
-        } else
-            delete drawable;
-        drawable = NULL;
-    }
+    chunkBuilder->buildDrawables(drawables);
 }
     
 void ShapeDrawableBuilderTri::getChanges(ChangeSet &changeRequests,SimpleIDSet &drawIDs)
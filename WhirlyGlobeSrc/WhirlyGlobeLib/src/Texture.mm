@@ -213,21 +213,21 @@ bool Texture::createInGL(OpenGLMemManager *memManager)
     glId = memManager->getTexID();
     CheckGLError("Texture::createInGL() glGenTextures()");
 
-	glBindTexture(GL_TEXTURE_2D, glId);
+	GetGLBackend()->bindTexture(GL_TEXTURE_2D, glId);
     CheckGLError("Texture::createInGL() glBindTexture()");
 	
 	// Set the texture parameters to use a minifying filter and a linear filter (weighted average)
     if (usesMipmaps)
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
+        GetGLBackend()->texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
     else
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        GetGLBackend()->texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	GetGLBackend()->texParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
     CheckGLError("Texture::createInGL() glTexParameteri()");
 	
 	// Configure textures
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, (wrapU ? GL_REPEAT : GL_CLAMP_TO_EDGE));
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, (wrapV ? GL_REPEAT : GL_CLAMP_TO_EDGE));
+    GetGLBackend()->texParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, (wrapU ? GL_REPEAT : GL_CLAMP_TO_EDGE));
+    GetGLBackend()->texParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, (wrapV ? GL_REPEAT : GL_CLAMP_TO_EDGE));
 
     CheckGLError("Texture::createInGL() glTexParameteri()");
     
@@ -237,7 +237,7 @@ bool Texture::createInGL(OpenGLMemManager *memManager)
 	if (isPVRTC)
 	{
 		// Will always be 4 bits per pixel and RGB
-		glCompressedTexImage2D(GL_TEXTURE_2D, 0, GL_COMPRESSED_RGB_PVRTC_4BPPV1_IMG, width, height, 0, [convertedData length], [convertedData bytes]);
+		GetGLBackend()->compressedTexImage2D(GL_TEXTURE_2D, 0, GL_COMPRESSED_RGB_PVRTC_4BPPV1_IMG, width, height, 0, [convertedData length], [convertedData bytes]);
         CheckGLError("Texture::createInGL() glCompressedTexImage2D()");
 	} else {
         // Depending on the format, we may need to mess around with the bytes
@@ -245,26 +245,26 @@ bool Texture::createInGL(OpenGLMemManager *memManager)
         {
             case GL_UNSIGNED_BYTE:
             default:
-                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, [convertedData bytes]);
+                GetGLBackend()->texImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, [convertedData bytes]);
                 break;
             case GL_UNSIGNED_SHORT_5_6_5:
-                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, [convertedData bytes]);
+                GetGLBackend()->texImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, [convertedData bytes]);
                 break;
             case GL_UNSIGNED_SHORT_4_4_4_4:
-                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_SHORT_4_4_4_4, [convertedData bytes]);
+                GetGLBackend()->texImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_SHORT_4_4_4_4, [convertedData bytes]);
                 break;
             case GL_UNSIGNED_SHORT_5_5_5_1:
-                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_SHORT_5_5_5_1, [convertedData bytes]);
+                GetGLBackend()->texImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_SHORT_5_5_5_1, [convertedData bytes]);
                 break;
             case GL_ALPHA:
-                glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, width, height, 0, GL_ALPHA, GL_UNSIGNED_BYTE, [convertedData bytes]);
+                GetGLBackend()->texImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, width, height, 0, GL_ALPHA, GL_UNSIGNED_BYTE, [convertedData bytes]);
                 break;
         }
         CheckGLError("Texture::createInGL() glTexImage2D()");
 	}	
     
     if (usesMipmaps)
-        glGenerateMipmap(GL_TEXTURE_2D);
+        GetGLBackend()->generateMipmap(GL_TEXTURE_2D);
 	
     // Once we've moved it over to OpenGL, let's get rid of this copy
     texData = nil;
@@ -21,6 +21,7 @@
 #import "TextureAtlas.h"
 #import "WhirlyGeometry.h"
 #import "GlobeMath.h"
+#import "BakedAtlas.h"
 
 using namespace Eigen;
 using namespace WhirlyKit;
@@ -317,3 +318,81 @@ void SubTexture::processTexCoords(std::vector<TexCoord> &coords)
 }
 
 @end
+
+@implementation BakedTextureAtlas
+{
+    /// The whole file, mapped in
+    NSData *fileData;
+    /// Page offsets and the entries
+    BakedAtlas atlas;
+    /// Texture IDs we'll use for the pages
+    std::vector<SimpleIdentity> texIds;
+    /// Sub textures, in the same order as the entries
+    std::vector<SubTexture> mappings;
+    /// Sub texture IDs by name
+    NSMutableDictionary *subTexIds;
+}
+
+- (id)initWithFile:(NSString *)fileName
+{
+    self = [super init];
+    if (self)
+    {
+        fileData = [NSData dataWithContentsOfFile:fileName options:NSDataReadingMappedIfSafe error:nil];
+        if (!fileData || !atlas.parse((const unsigned char *)[fileData bytes], [fileData length]))
+            return nil;
+        
+        for (unsigned int ii=0;ii<atlas.pageOffsets.size();ii++)
+            texIds.push_back(Identifiable::genId());
+        
+        // Same texture coordinates the runtime atlases would use
+        subTexIds = [NSMutableDictionary dictionary];
+        float texSize = atlas.texSize;
+        Point2f halfPix(0.5/texSize,0.5/texSize);
+        for (unsigned int ii=0;ii<atlas.entries.size();ii++)
+        {
+            const BakedAtlasEntry &entry = atlas.entries[ii];
+            TexCoord org(entry.x / texSize + halfPix.x(), entry.y / texSize + halfPix.y());
+            TexCoord dest((entry.x + entry.width) / texSize - 2*halfPix.x(), (entry.y + entry.height) / texSize - 2*halfPix.y());
+            SubTexture subTex;
+            subTex.texId = texIds[entry.page];
+            subTex.setFromTex(org, dest);
+            mappings.push_back(subTex);
+            subTexIds[[NSString stringWithUTF8String:entry.name.c_str()]] = @(subTex.getId());
+        }
+    }
+    
+    return self;
+}
+
+- (SimpleIdentity)subTextureForName:(NSString *)name
+{
+    NSNumber *subTexId = subTexIds[name];
+    if (!subTexId)
+        return EmptyIdentity;
+    return [subTexId unsignedLongLongValue];
+}
+
+- (void)processIntoScene:(Scene *)scene layerThread:(WhirlyKitLayerThread *)layerThread texIDs:(std::set<SimpleIdentity> *)texIDs
+{
+    // The pages are already RGBA, so they just need copying out of the mapped file
+    size_t pageSize = (size_t)atlas.texSize * atlas.texSize * 4;
+    for (unsigned int ii=0;ii<atlas.pageOffsets.size();ii++)
+    {
+        NSData *pageData = [fileData subdataWithRange:NSMakeRange(atlas.pageOffsets[ii], pageSize)];
+        Texture *tex = new Texture("Baked Texture Atlas",pageData,false);
+        tex->setId(texIds[ii]);
+        tex->setWidth(atlas.texSize);
+        tex->setHeight(atlas.texSize);
+        tex->setUsesMipmaps(false);
+        if (texIDs)
+            texIDs->insert(tex->getId());
+        [layerThread addChangeRequest:(new AddTextureReq(tex))];
+    }
+    
+    scene->addSubTextures(mappings);
+    mappings.clear();
+    fileData = nil;
+}
+
+@end
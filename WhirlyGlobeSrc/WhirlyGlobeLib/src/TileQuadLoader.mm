@@ -25,10 +25,21 @@
 #import "TileQuadLoader.h"
 #import "DynamicTextureAtlas.h"
 #import "DynamicDrawableAtlas.h"
+#import "Profiler.h"
+#import "LatencyHistogram.h"
 
 using namespace Eigen;
 using namespace WhirlyKit;
 
+static ProfileZone BuildTileZone("QuadTileLoader::buildTile");
+static ProfileZone TileLoadedZone("QuadTileLoader::loadedImage");
+static ProfileZone FetchesCount("Tile fetches outstanding");
+static LatencyMetric TileFetchLatency("Tile fetch");
+static LatencyMetric TileBuildLatency("Tile build");
+
+// Seconds between texture atlas defragmenting passes
+static const NSTimeInterval TexAtlasDefragInterval = 2.0;
+
 @interface WhirlyKitQuadTileLoader()
 {
 @public
@@ -39,11 +50,14 @@ using namespace WhirlyKit;
     // Number of border texels we need in an image
     int borderTexel;
     int texelBinSize;
+    // Last time we defragmented the texture atlas
+    NSTimeInterval lastDefrag;
 }
 
 - (void)buildTile:(Quadtree::NodeInfo *)nodeInfo draw:(BasicDrawable **)draw skirtDraw:(BasicDrawable **)skirtDraw tex:(Texture **)tex texScale:(Point2f)texScale texOffset:(Point2f)texOffset lines:(bool)buildLines layer:(WhirlyKitQuadDisplayLayer *)layer imageData:(WhirlyKitLoadedImage *)imageData elevData:(WhirlyKitElevationChunk *)elevData;
 - (LoadedTile *)getTile:(Quadtree::Identifier)ident;
 - (void)flushUpdates:(WhirlyKitLayerThread *)layerThread;
+- (void)defragTextureAtlas;
 @end
 
 @implementation WhirlyKitLoadedTile
@@ -170,6 +184,7 @@ namespace WhirlyKit
 LoadedTile::LoadedTile()
 {
     isLoading = false;
+    fetchStart = 0;
     placeholder = false;
     drawId = EmptyIdentity;
     skirtDrawId = EmptyIdentity;
@@ -185,6 +200,7 @@ LoadedTile::LoadedTile(const WhirlyKit::Quadtree::Identifier &ident)
 {
     nodeInfo.ident = ident;
     isLoading = false;
+    fetchStart = 0;
     placeholder = false;
     drawId = EmptyIdentity;
     skirtDrawId = EmptyIdentity;
@@ -480,6 +496,36 @@ void LoadedTile::updateContents(WhirlyKitQuadTileLoader *loader,WhirlyKitQuadDis
     //    tree->Print();
 }
 
+// Tear down all our geometry and build it again with the new texture coordinates
+void LoadedTile::moveSubTexture(WhirlyKitQuadTileLoader *loader,WhirlyKitQuadDisplayLayer *layer,Quadtree *tree,const SubTexture &newSubTex,ChangeSet &changeRequests)
+{
+    subTex = newSubTex;
+    
+    std::vector<SimpleIdentity> drawIds;
+    drawIds.push_back(drawId);
+    drawIds.push_back(skirtDrawId);
+    for (unsigned int ii=0;ii<4;ii++)
+    {
+        drawIds.push_back(childDrawIds[ii]);
+        drawIds.push_back(childSkirtDrawIds[ii]);
+        childDrawIds[ii] = EmptyIdentity;
+        childSkirtDrawIds[ii] = EmptyIdentity;
+    }
+    drawId = EmptyIdentity;
+    skirtDrawId = EmptyIdentity;
+    for (unsigned int ii=0;ii<drawIds.size();ii++)
+    {
+        if (drawIds[ii] == EmptyIdentity)
+            continue;
+        if (loader->drawAtlas)
+            loader->drawAtlas->removeDrawable(drawIds[ii], changeRequests);
+        else
+            changeRequests.push_back(new RemDrawableReq(drawIds[ii]));
+    }
+    
+    // This builds whatever we should be showing, now that there's nothing
+    updateContents(loader, layer, tree, changeRequests);
+}
 
 void LoadedTile::Print(Quadtree *tree)
 {
@@ -543,6 +589,9 @@ void LoadedTile::Print(Quadtree *tree)
         _fixedTileSize = 256;
         texelBinSize = 64;
         _textureAtlasSize = 2048;
+        _textureAtlasMemoryTarget = 0;
+        lastDefrag = 0;
+        _optimizeMeshes = false;
     }
     
     return self;
@@ -726,6 +775,9 @@ void LoadedTile::Print(Quadtree *tree)
 
 - (void)buildTile:(Quadtree::NodeInfo *)nodeInfo draw:(BasicDrawable **)draw skirtDraw:(BasicDrawable **)skirtDraw tex:(Texture **)tex texScale:(Point2f)texScale texOffset:(Point2f)texOffset lines:(bool)buildLines layer:(WhirlyKitQuadDisplayLayer *)layer imageData:(WhirlyKitLoadedImage *)loadImage elevData:(WhirlyKitElevationChunk *)elevData
 {
+    ProfileScope profile(BuildTileZone);
+    LatencyScope latency(TileBuildLatency);
+    
     Mbr theMbr = nodeInfo->mbr;
     
     // Make sure this overlaps the area we care about
@@ -810,6 +862,11 @@ void LoadedTile::Print(Quadtree *tree)
         chunk->setColor(_color);
         chunk->setLocalMbr(Mbr(Point2f(geoLL.x(),geoLL.y()),Point2f(geoUR.x(),geoUR.y())));
         chunk->setProgram(_programId);
+        // Compact vertices.  The drawable atlas needs float positions and only
+        //  the default shaders know how to decode octahedral normals.
+        BDPositionFormat posFormat = drawAtlas ? BDPositionFloat3 : BDPositionShort4;
+        BDAttributePacking normPacking = (_programId == EmptyIdentity) ? BDPackOctahedral : BDPackNone;
+        chunk->setVertexFormat(posFormat, normPacking, BDPackNormShort);
         int elevEntry = 0;
         if (_includeElev)
             elevEntry = chunk->addAttribute(BDFloatType, "a_elev");
@@ -1005,6 +1062,7 @@ void LoadedTile::Print(Quadtree *tree)
                 // We need the skirts rendered with the z buffer on, even if we're doing (mostly) pure sorting
                 skirtChunk->setRequestZBuffer(true);
                 skirtChunk->setProgram(_programId);
+                skirtChunk->setVertexFormat(posFormat, normPacking, BDPackNormShort);
                 
                 // We'll vary the skirt size a bit.  Otherwise the fill gets ridiculous when we're looking
                 //  at the very highest levels.  On the other hand, this doesn't fix a really big large/small
@@ -1137,6 +1195,9 @@ void LoadedTile::Print(Quadtree *tree)
                 chunk->setTexId((*tex)->getId());
         }
         
+        if (_optimizeMeshes)
+            chunk->optimizeMesh();
+        
         *draw = chunk;
     }
 }
@@ -1177,9 +1238,46 @@ void LoadedTile::Print(Quadtree *tree)
 {
 }
 
+// Move tiles out of sparse atlas textures, a bit at a time, and rebuild their geometry
+- (void)defragTextureAtlas
+{
+    if (!texAtlas || !drawAtlas || !texAtlas->canDefragment() || drawAtlas->waitingOnSwap())
+        return;
+    NSTimeInterval now = CFAbsoluteTimeGetCurrent();
+    if (now - lastDefrag < TexAtlasDefragInterval)
+        return;
+    lastDefrag = now;
+    
+    DynamicTextureDefragParams params;
+    if (_textureAtlasMemoryTarget > 0)
+        params.targetPages = std::max(1,_textureAtlasMemoryTarget / texAtlas->getTextureBytes());
+    ChangeSet defragChanges;
+    std::vector<DynamicTextureAtlas::SubTextureMove> moves;
+    texAtlas->defragment(params, defragChanges, moves);
+    if (moves.empty() && defragChanges.empty())
+        return;
+    
+    std::map<SimpleIdentity,SubTexture> newSubTexes;
+    for (unsigned int ii=0;ii<moves.size();ii++)
+        newSubTexes[moves[ii].newSubTex.getId()] = moves[ii].newSubTex;
+    for (LoadedTileSet::iterator it = tileSet.begin(); it != tileSet.end(); ++it)
+    {
+        LoadedTile *tile = *it;
+        if (tile->isLoading || tile->subTex.texId == EmptyIdentity)
+            continue;
+        std::map<SimpleIdentity,SubTexture>::iterator sit = newSubTexes.find(tile->subTex.getId());
+        if (sit != newSubTexes.end())
+            tile->moveSubTexture(self, _quadLayer, _quadLayer.quadtree, sit->second, changeRequests);
+    }
+    
+    // The copies and texture removals have to land with the swap that shows the rebuilt geometry
+    drawAtlas->addSwapChanges(defragChanges);
+}
+
 // Flush out any outstanding updates saved in the changeRequests
 - (void)flushUpdates:(WhirlyKitLayerThread *)layerThread
 {
+    [self defragTextureAtlas];
     if (drawAtlas)
     {
         if (drawAtlas->hasUpdates() && !drawAtlas->waitingOnSwap())
@@ -1230,6 +1328,7 @@ void LoadedTile::Print(Quadtree *tree)
     LoadedTile *newTile = new LoadedTile();
     newTile->nodeInfo = tileInfo;
     newTile->isLoading = true;
+    newTile->fetchStart = LatencyMetrics::startTime();
 
     tileSet.insert(newTile);
     numFetches++;
@@ -1270,11 +1369,14 @@ static const int SingleElementSize = sizeof(GLushort);
 
 - (void)dataSource:(NSObject<WhirlyKitQuadTileImageDataSource> *)dataSource loadedImage:(id)loadTile forLevel:(int)level col:(int)col row:(int)row
 {
+    ProfileScope profile(TileLoadedZone);
+    
     // Look for the tile
     // If it's not here, just drop this on the floor
     LoadedTile dummyTile(Quadtree::Identifier(col,row,level));
     LoadedTileSet::iterator it = tileSet.find(&dummyTile);
     numFetches--;
+    Profiler::count(FetchesCount, numFetches);
     if (it == tileSet.end())
         return;
     
@@ -1309,6 +1411,8 @@ static const int SingleElementSize = sizeof(GLushort);
             int texSortSize = (_tileScale == WKTileScaleFixed ? _fixedTileSize : texelBinSize);
             texAtlas = new DynamicTextureAtlas(_textureAtlasSize,texSortSize,[self glFormat]);
             drawAtlas = new DynamicDrawableAtlas("Tile Quad Loader",SingleElementSize,DrawBufferSize,ElementBufferSize,_quadLayer.scene->getMemManager(),NULL,_programId);
+            // Tiles come and go all the time, so keep the big drawables from fragmenting
+            drawAtlas->setCompaction(true);
             
             // We want some room around these
             borderTexel = 1;
@@ -1317,6 +1421,8 @@ static const int SingleElementSize = sizeof(GLushort);
     
     LoadedTile *tile = *it;
     tile->isLoading = false;
+    if (tile->fetchStart)
+        LatencyMetrics::recordSince(TileFetchLatency, tile->fetchStart);
     if (loadImage || loadElev)
     {
         tile->elevData = loadElev;
@@ -23,6 +23,7 @@
 #import "NSDictionary+Stuff.h"
 #import "UIColor+Stuff.h"
 #import "Tesselator.h"
+#import "DrawableBuilder.h"
 
 using namespace Eigen;
 using namespace WhirlyKit;
@@ -102,14 +103,15 @@ void VectorSceneRep::clear(ChangeSet &changes)
 
 /* Drawable Builder
  Used to construct drawables with multiple shapes in them.
- Eventually, we'll move this out to be a more generic object.
+ Shapes are gathered up and then sorted spatially into drawables on flush.
  */
-class VectorDrawableBuilder
+class VectorDrawableBuilder : public ChunkedDrawableBuilder
 {
 public:
     VectorDrawableBuilder(Scene *scene,ChangeSet &changeRequests,VectorSceneRep *sceneRep,
                           VectorInfo *vecInfo,bool linesOrPoints)
-    : changeRequests(changeRequests), scene(scene), sceneRep(sceneRep), vecInfo(vecInfo), drawable(NULL)
+    : ChunkedDrawableBuilder("Vector Layer",(linesOrPoints ? GL_LINES : GL_POINTS)),
+      changeRequests(changeRequests), scene(scene), sceneRep(sceneRep), vecInfo(vecInfo)
     {
         primType = (linesOrPoints ? GL_LINES : GL_POINTS);
     }
@@ -123,27 +125,9 @@ public:
     {
         CoordSystemDisplayAdapter *coordAdapter = scene->getCoordAdapter();
         
-        // Decide if we'll appending to an existing drawable or
-        //  create a new one
-        int ptCount = 2*(pts.size()+1);
-        if (!drawable || (drawable->getNumPoints()+ptCount > MaxDrawablePoints))
-        {
-            // We're done with it, toss it to the scene
-            if (drawable)
-                flush();
-            
-            drawable = new BasicDrawable("Vector Layer");
-            drawMbr.reset();
-            drawable->setType(primType);
-            // Adjust according to the vector info
-            drawable->setOnOff(vecInfo->enable);
-            drawable->setDrawOffset(vecInfo->drawOffset);
-            drawable->setColor([vecInfo.color asRGBAColor]);
-            drawable->setLineWidth(vecInfo.lineWidth);
-            drawable->setDrawPriority(vecInfo->priority);
-            drawable->setVisibleRange(vecInfo->minVis,vecInfo->maxVis);
-        }
+        Mbr drawMbr;
         drawMbr.addPoints(pts);
+        startGroup(drawMbr);
         
         Point3f prevPt,prevNorm,firstPt,firstNorm;
         for (unsigned int jj=0;jj<pts.size();jj++)
@@ -159,15 +143,12 @@ public:
             // Depending on the type, we do this differently
             if (primType == GL_POINTS)
             {
-                drawable->addPoint(pt);
-                drawable->addNormal(norm);
+                addPoint(pt,norm);
             } else {
                 if (jj > 0)
                 {
-                    drawable->addPoint(prevPt);
-                    drawable->addPoint(pt);
-                    drawable->addNormal(prevNorm);
-                    drawable->addNormal(norm);
+                    addPoint(prevPt,prevNorm);
+                    addPoint(pt,norm);
                 } else {
                     firstPt = pt;
                     firstNorm = norm;
@@ -180,54 +161,61 @@ public:
         // Close the loop
         if (closed && primType == GL_LINES)
         {
-            drawable->addPoint(prevPt);
-            drawable->addPoint(firstPt);
-            drawable->addNormal(prevNorm);
-            drawable->addNormal(firstNorm);
+            addPoint(prevPt,prevNorm);
+            addPoint(firstPt,firstNorm);
         }
     }
     
     void flush()
     {
-        if (drawable)
+        std::vector<BasicDrawable *> drawables;
+        buildDrawables(drawables);
+        for (unsigned int ii=0;ii<drawables.size();ii++)
         {
-            if (drawable->getNumPoints() > 0)
-            {
-                drawable->setLocalMbr(drawMbr);
-                sceneRep->drawIDs.insert(drawable->getId());
-                
-                if (vecInfo.fade > 0.0)
-                {
-                    NSTimeInterval curTime = CFAbsoluteTimeGetCurrent();
-                    drawable->setFade(curTime,curTime+vecInfo.fade);
-                }
-                changeRequests.push_back(new AddDrawableReq(drawable));
-            } else
-                delete drawable;
-            drawable = NULL;
+            BasicDrawable *drawable = drawables[ii];
+            sceneRep->drawIDs.insert(drawable->getId());
+            changeRequests.push_back(new AddDrawableReq(drawable));
         }
     }
     
 protected:
+    // Adjust according to the vector info
+    void setupDrawable(BasicDrawable *drawable)
+    {
+        drawable->setOnOff(vecInfo->enable);
+        drawable->setDrawOffset(vecInfo->drawOffset);
+        drawable->setColor([vecInfo.color asRGBAColor]);
+        drawable->setLineWidth(vecInfo.lineWidth);
+        drawable->setDrawPriority(vecInfo->priority);
+        drawable->setVisibleRange(vecInfo->minVis,vecInfo->maxVis);
+        // Vectors can span the globe, so positions stay as floats
+        drawable->setVertexFormat(BDPositionFloat3,BDPackOctahedral,BDPackNone);
+        
+        if (vecInfo.fade > 0.0)
+        {
+            NSTimeInterval curTime = CFAbsoluteTimeGetCurrent();
+            drawable->setFade(curTime,curTime+vecInfo.fade);
+        }
+    }
+    
     Scene *scene;
     ChangeSet &changeRequests;
     VectorSceneRep *sceneRep;
-    Mbr drawMbr;
-    BasicDrawable *drawable;
     VectorInfo *vecInfo;
     GLenum primType;
 };
 
 /* Drawable Builder (Triangle version)
  Used to construct drawables with multiple shapes in them.
- Eventually, we'll move this out to be a more generic object.
+ Shapes are gathered up and then sorted spatially into drawables on flush.
  */
-class VectorDrawableBuilderTri
+class VectorDrawableBuilderTri : public ChunkedDrawableBuilder
 {
 public:
     VectorDrawableBuilderTri(Scene *scene,ChangeSet &changeRequests,VectorSceneRep *sceneRep,
                              VectorInfo *vecInfo)
-    : changeRequests(changeRequests), scene(scene), sceneRep(sceneRep), vecInfo(vecInfo), drawable(NULL)
+    : ChunkedDrawableBuilder("Vector Layer",GL_TRIANGLES),
+      changeRequests(changeRequests), scene(scene), sceneRep(sceneRep), vecInfo(vecInfo)
     {
     }
     
@@ -246,36 +234,20 @@ public:
         std::vector<VectorRing> rings;
         TesselateRing(inRing,rings);
         
+        // The whole ring goes in as one group so it stays together
+        Mbr drawMbr;
+        drawMbr.addPoints(inRing);
+        startGroup(drawMbr);
+        
         for (unsigned int ir=0;ir<rings.size();ir++)
         {
             VectorRing &pts = rings[ir];
-            // Decide if we'll appending to an existing drawable or
-            //  create a new one
-            int ptCount = pts.size();
-            int triCount = pts.size()-2;
-            if (!drawable ||
-                (drawable->getNumPoints()+ptCount > MaxDrawablePoints) ||
-                (drawable->getNumTris()+triCount > MaxDrawableTriangles))
-            {
-                // We're done with it, toss it to the scene
-                if (drawable)
-                    flush();
-                
-                drawable = new BasicDrawable("Vector Layer");
-                drawMbr.reset();
-                drawable->setType(GL_TRIANGLES);
-                // Adjust according to the vector info
-                drawable->setOnOff(vecInfo->enable);
-                drawable->setDrawOffset(vecInfo->drawOffset);
-                drawable->setColor([vecInfo.color asRGBAColor]);
-                drawable->setDrawPriority(vecInfo->priority);
-                drawable->setVisibleRange(vecInfo->minVis,vecInfo->maxVis);
-                //                drawable->setForceZBufferOn(true);
-            }
-            int baseVert = drawable->getNumPoints();
-            drawMbr.addPoints(pts);
+            // Note: Should be reusing vertex indices
+            if (pts.size() != 3)
+                continue;
             
             // Add the points
+            GLuint baseVert = 0;
             for (unsigned int jj=0;jj<pts.size();jj++)
             {
                 // Convert to real world coordinates and offset from the globe
@@ -285,44 +257,50 @@ public:
                 Point3f norm = coordAdapter->normalForLocal(localPt);
                 Point3f pt = coordAdapter->localToDisplay(localPt);
                 
-                drawable->addPoint(pt);
-                drawable->addNormal(norm);
+                GLuint which = addPoint(pt,norm);
+                if (jj == 0)
+                    baseVert = which;
             }
             
             // Add the triangles
-            // Note: Should be reusing vertex indices
-            if (pts.size() == 3)
-                drawable->addTriangle(BasicDrawable::Triangle(0+baseVert,2+baseVert,1+baseVert));
+            addTriangle(0+baseVert,2+baseVert,1+baseVert);
         }
     }
     
     void flush()
     {
-        if (drawable)
-        {            
-            if (drawable->getNumPoints() > 0)
-            {
-                drawable->setLocalMbr(drawMbr);
-                sceneRep->drawIDs.insert(drawable->getId());
-                
-                if (vecInfo.fade > 0.0)
-                {
-                    NSTimeInterval curTime = CFAbsoluteTimeGetCurrent();
-                    drawable->setFade(curTime,curTime+vecInfo.fade);
-                }
-                changeRequests.push_back(new AddDrawableReq(drawable));
-            } else
-                delete drawable;
-            drawable = NULL;
+        std::vector<BasicDrawable *> drawables;
+        buildDrawables(drawables);
+        for (unsigned int ii=0;ii<drawables.size();ii++)
+        {
+            BasicDrawable *drawable = drawables[ii];
+            sceneRep->drawIDs.insert(drawable->getId());
+            changeRequests.push_back(new AddDrawableReq(drawable));
+        }
+    }
+    
+protected:
+    // Adjust according to the vector info
+    void setupDrawable(BasicDrawable *drawable)
+    {
+        drawable->setOnOff(vecInfo->enable);
+        drawable->setDrawOffset(vecInfo->drawOffset);
+        drawable->setColor([vecInfo.color asRGBAColor]);
+        drawable->setDrawPriority(vecInfo->priority);
+        drawable->setVisibleRange(vecInfo->minVis,vecInfo->maxVis);
+        // Vectors can span the globe, so positions stay as floats
+        drawable->setVertexFormat(BDPositionFloat3,BDPackOctahedral,BDPackNone);
+        
+        if (vecInfo.fade > 0.0)
+        {
+            NSTimeInterval curTime = CFAbsoluteTimeGetCurrent();
+            drawable->setFade(curTime,curTime+vecInfo.fade);
         }
     }
     
-protected:   
     Scene *scene;
     ChangeSet &changeRequests;
     VectorSceneRep *sceneRep;
-    Mbr drawMbr;
-    BasicDrawable *drawable;
     VectorInfo *vecInfo;
 };
 
@@ -0,0 +1,394 @@
+/*
+ *  VertexAttribute.mm
+ *  WhirlyGlobeLib
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import "VertexAttribute.h"
+#import "VertexPacking.h"
+#import "GLBackend.h"
+
+using namespace Eigen;
+
+namespace WhirlyKit
+{
+    
+VertexAttribute::VertexAttribute(BDAttributeDataType dataType,const std::string &name)
+    : dataType(dataType), packing(BDPackNone), name(name), data(NULL), buffer(0)
+{
+    defaultData.vec3[0] = 0.0;
+    defaultData.vec3[1] = 0.0;
+    defaultData.vec3[2] = 0.0;
+}
+    
+VertexAttribute::~VertexAttribute()
+{
+    clear();
+}
+    
+VertexAttribute::VertexAttribute(const VertexAttribute &that)
+    : dataType(that.dataType), packing(that.packing), name(that.name), defaultData(that.defaultData), data(NULL), buffer(that.buffer)
+{
+}
+    
+VertexAttribute VertexAttribute::templateCopy() const
+{
+    VertexAttribute newAttr(*this);
+    return newAttr;
+}
+    
+BDAttributeDataType VertexAttribute::getDataType() const
+{
+    return dataType;
+}
+    
+bool VertexAttribute::setPacking(BDAttributePacking newPacking)
+{
+    switch (newPacking)
+    {
+        case BDPackNone:
+            break;
+        case BDPackHalfFloat:
+        case BDPackNormShort:
+            if (dataType != BDFloat2Type)
+                return false;
+            break;
+        case BDPackOctahedral:
+            if (dataType != BDFloat3Type)
+                return false;
+            break;
+    }
+    
+    packing = newPacking;
+    return true;
+}
+
+BDAttributePacking VertexAttribute::getPacking() const
+{
+    return packing;
+}
+    
+std::string VertexAttribute::glName() const
+{
+    if (packing == BDPackOctahedral)
+        return name + "Oct";
+    
+    return name;
+}
+    
+void VertexAttribute::setDefaultColor(const RGBAColor &color)
+{
+    defaultData.color[0] = color.r;
+    defaultData.color[1] = color.g;
+    defaultData.color[2] = color.b;
+    defaultData.color[3] = color.a;
+}
+
+void VertexAttribute::setDefaultVector2f(const Eigen::Vector2f &vec)
+{
+    defaultData.vec2[0] = vec.x();
+    defaultData.vec2[1] = vec.y();
+}
+
+void VertexAttribute::setDefaultVector3f(const Eigen::Vector3f &vec)
+{
+    defaultData.vec3[0] = vec.x();
+    defaultData.vec3[1] = vec.y();
+    defaultData.vec3[2] = vec.z();
+}
+
+void VertexAttribute::setDefaultFloat(float val)
+{
+    defaultData.floatVal = val;
+}
+
+void VertexAttribute::addColor(const RGBAColor &color)
+{
+    TypedVertexAttributeData<RGBAColor> *colors = typedData<RGBAColor>();
+    if (colors)
+        colors->add(color);
+}
+
+void VertexAttribute::addVector2f(const Eigen::Vector2f &vec)
+{
+    TypedVertexAttributeData<Vector2f> *vecs = typedData<Vector2f>();
+    if (vecs)
+        vecs->add(vec);
+}
+
+void VertexAttribute::addVector3f(const Eigen::Vector3f &vec)
+{
+    TypedVertexAttributeData<Vector3f> *vecs = typedData<Vector3f>();
+    if (vecs)
+        vecs->add(vec);
+}
+
+void VertexAttribute::addFloat(float val)
+{
+    TypedVertexAttributeData<float> *floats = typedData<float>();
+    if (floats)
+        floats->add(val);
+}
+    
+/// Reserve size in the data array
+void VertexAttribute::reserve(int size)
+{
+    // Note: Only place we need to care about the type at run time
+    if (!data)
+    {
+        switch (dataType)
+        {
+            case BDFloat3Type:
+                data = new TypedVertexAttributeData<Vector3f>();
+                break;
+            case BDFloat2Type:
+                data = new TypedVertexAttributeData<Vector2f>();
+                break;
+            case BDChar4Type:
+                data = new TypedVertexAttributeData<RGBAColor>();
+                break;
+            case BDFloatType:
+                data = new TypedVertexAttributeData<float>();
+                break;
+        }
+    }
+    data->reserve(size);
+}
+
+/// Number of elements in our array
+int VertexAttribute::numElements() const
+{
+    if (!data)
+        return 0;
+    
+    return data->numElements();
+}
+
+/// Return the size of a single element
+int VertexAttribute::size() const
+{
+    switch (packing)
+    {
+        case BDPackNone:
+            break;
+        case BDPackHalfFloat:
+        case BDPackNormShort:
+            return sizeof(GLushort)*2;
+            break;
+        case BDPackOctahedral:
+            // Only two bytes used, but we keep the attributes 4 byte aligned
+            return sizeof(GLbyte)*4;
+            break;
+    }
+    
+    switch (dataType)
+    {
+        case BDFloat3Type:
+            return sizeof(GLfloat)*3;
+            break;
+        case BDFloat2Type:
+            return sizeof(GLfloat)*2;
+            break;
+        case BDChar4Type:
+            return sizeof(unsigned char)*4;
+            break;
+        case BDFloatType:
+            return sizeof(GLfloat);
+            break;
+    }
+    
+    return 0;
+}
+
+/// Clean out the data array
+void VertexAttribute::clear()
+{
+    if (data)
+        delete data;
+    data = NULL;    
+}
+
+/// Return a pointer to the given element
+void *VertexAttribute::addressForElement(int which)
+{
+    if (!data)
+        return NULL;
+    
+    return data->addressForElement(which);
+}
+    
+void VertexAttribute::interleave(unsigned char *basePtr,int stride,int start,int count) const
+{
+    if (!data)
+        return;
+    
+    basePtr += buffer;
+    switch (packing)
+    {
+        case BDPackNone:
+            data->interleave(basePtr,stride,start,count);
+            break;
+        case BDPackHalfFloat:
+        {
+            const std::vector<Vector2f> &vecs = ((TypedVertexAttributeData<Vector2f> *)data)->vals;
+            for (int ii=0;ii<count;ii++,basePtr+=stride)
+            {
+                const Vector2f &vec = vecs[start+ii];
+                GLushort vals[2] = {FloatToHalf(vec.x()),FloatToHalf(vec.y())};
+                memcpy(basePtr, vals, sizeof(vals));
+            }
+        }
+            break;
+        case BDPackNormShort:
+        {
+            const std::vector<Vector2f> &vecs = ((TypedVertexAttributeData<Vector2f> *)data)->vals;
+            for (int ii=0;ii<count;ii++,basePtr+=stride)
+            {
+                const Vector2f &vec = vecs[start+ii];
+                GLushort vals[2] = {PackNormUShort(vec.x()),PackNormUShort(vec.y())};
+                memcpy(basePtr, vals, sizeof(vals));
+            }
+        }
+            break;
+        case BDPackOctahedral:
+        {
+            const std::vector<Vector3f> &vecs = ((TypedVertexAttributeData<Vector3f> *)data)->vals;
+            for (int ii=0;ii<count;ii++,basePtr+=stride)
+            {
+                signed char vals[4] = {0,0,0,0};
+                PackOctNormal(vecs[start+ii], vals);
+                memcpy(basePtr, vals, sizeof(vals));
+            }
+        }
+            break;
+    }
+}
+
+void VertexAttribute::remap(const std::vector<GLuint> &newToOld)
+{
+    if (data)
+        data->remap(newToOld);
+}
+
+/// Return the number of components as needed by glVertexAttribPointer
+GLuint VertexAttribute::glEntryComponents(bool packed) const
+{
+    if (packed && packing != BDPackNone)
+        return 2;
+    
+    switch (dataType)
+    {
+        case BDFloat3Type:
+            return 3;
+            break;
+        case BDFloat2Type:
+            return 2;
+            break;
+        case BDChar4Type:
+            return 4;
+            break;
+        case BDFloatType:
+            return 1;
+            break;
+    }
+    
+    return 0;
+}
+
+/// Return the data type as required by glVertexAttribPointer
+GLenum VertexAttribute::glType(bool packed) const
+{
+    switch (packed ? packing : BDPackNone)
+    {
+        case BDPackNone:
+            break;
+        case BDPackHalfFloat:
+            return GL_HALF_FLOAT_OES;
+            break;
+        case BDPackNormShort:
+            return GL_UNSIGNED_SHORT;
+            break;
+        case BDPackOctahedral:
+            return GL_BYTE;
+            break;
+    }
+    
+    switch (dataType)
+    {
+        case BDFloat3Type:
+        case BDFloat2Type:
+        case BDFloatType:
+            return GL_FLOAT;
+            break;
+        case BDChar4Type:
+            return GL_UNSIGNED_BYTE;
+            break;
+    }
+    return GL_UNSIGNED_BYTE;
+}
+
+/// Whether or not glVertexAttribPointer will normalize the data
+GLboolean VertexAttribute::glNormalize(bool packed) const
+{
+    switch (packed ? packing : BDPackNone)
+    {
+        case BDPackNone:
+            break;
+        case BDPackHalfFloat:
+            return GL_FALSE;
+            break;
+        case BDPackNormShort:
+        case BDPackOctahedral:
+            return GL_TRUE;
+            break;
+    }
+    
+    switch (dataType)
+    {
+        case BDFloat3Type:
+        case BDFloat2Type:
+        case BDFloatType:
+            return GL_FALSE;
+            break;
+        case BDChar4Type:
+            return GL_TRUE;
+            break;
+    }
+    
+    return GL_FALSE;
+}
+    
+void VertexAttribute::glSetDefault(int index) const
+{
+    switch (dataType)
+    {
+        case BDFloat3Type:
+            GetGLBackend()->vertexAttrib3f(index, defaultData.vec3[0], defaultData.vec3[1], defaultData.vec3[2]);
+            break;
+        case BDFloat2Type:
+            GetGLBackend()->vertexAttrib2f(index, defaultData.vec2[0], defaultData.vec2[1]);
+            break;
+        case BDFloatType:
+            GetGLBackend()->vertexAttrib1f(index, defaultData.floatVal);
+            break;
+        case BDChar4Type:
+            GetGLBackend()->vertexAttrib4f(index, defaultData.color[0] / 255.0, defaultData.color[1] / 255.0, defaultData.color[2] / 255.0, defaultData.color[3] / 255.0);
+            break;
+    }
+}
+
+}
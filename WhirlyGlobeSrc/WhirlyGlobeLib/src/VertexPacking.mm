@@ -0,0 +1,233 @@
+/*
+ *  VertexPacking.mm
+ *  WhirlyGlobeLib
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <string.h>
+#import <math.h>
+#import "VertexPacking.h"
+
+using namespace Eigen;
+
+namespace WhirlyKit
+{
+    
+unsigned short FloatToHalf(float val)
+{
+    unsigned int bits;
+    memcpy(&bits, &val, sizeof(bits));
+    
+    unsigned int sign = (bits >> 16) & 0x8000;
+    int exp = (int)((bits >> 23) & 0xff) - 127 + 15;
+    unsigned int mant = bits & 0x7fffff;
+    
+    // NaN and infinity
+    if (((bits >> 23) & 0xff) == 0xff)
+        return sign | 0x7c00 | (mant ? 0x200 : 0);
+    // Too big, so clamp to infinity
+    if (exp >= 31)
+        return sign | 0x7c00;
+    // Denormal or zero
+    if (exp <= 0)
+    {
+        if (exp < -10)
+            return sign;
+        mant |= 0x800000;
+        int shift = 14 - exp;
+        unsigned int half = mant >> shift;
+        // Round to nearest
+        if ((mant >> (shift-1)) & 1)
+            half++;
+        return sign | half;
+    }
+    
+    unsigned int half = sign | (exp << 10) | (mant >> 13);
+    // Round to nearest.  Carrying into the exponent is what we want.
+    if (mant & 0x1000)
+        half++;
+    return half;
+}
+
+float HalfToFloat(unsigned short val)
+{
+    unsigned int sign = (val & 0x8000) << 16;
+    unsigned int exp = (val >> 10) & 0x1f;
+    unsigned int mant = val & 0x3ff;
+    
+    unsigned int bits;
+    if (exp == 0)
+    {
+        if (mant == 0)
+            bits = sign;
+        else {
+            // Denormal, so normalize it
+            exp = 127 - 15 + 1;
+            while (!(mant & 0x400))
+            {
+                mant <<= 1;
+                exp--;
+            }
+            mant &= 0x3ff;
+            bits = sign | (exp << 23) | (mant << 13);
+        }
+    } else if (exp == 31)
+        bits = sign | 0x7f800000 | (mant << 13);
+    else
+        bits = sign | ((exp - 15 + 127) << 23) | (mant << 13);
+    
+    float ret;
+    memcpy(&ret, &bits, sizeof(ret));
+    return ret;
+}
+
+// OpenGL ES 2.0 unpacks signed normalized values as (2c+1)/(2^b-1)
+short PackNormShort(float val)
+{
+    float cVal = roundf((val * 65535.0f - 1.0f) / 2.0f);
+    if (cVal < -32768.0f)  cVal = -32768.0f;
+    if (cVal > 32767.0f)  cVal = 32767.0f;
+    return (short)cVal;
+}
+
+float UnpackNormShort(short val)
+{
+    return (2.0f * val + 1.0f) / 65535.0f;
+}
+    
+unsigned short PackNormUShort(float val)
+{
+    float cVal = roundf(val * 65535.0f);
+    if (cVal < 0.0f)  cVal = 0.0f;
+    if (cVal > 65535.0f)  cVal = 65535.0f;
+    return (unsigned short)cVal;
+}
+
+float UnpackNormUShort(unsigned short val)
+{
+    return val / 65535.0f;
+}
+    
+signed char PackNormByte(float val)
+{
+    float cVal = roundf((val * 255.0f - 1.0f) / 2.0f);
+    if (cVal < -128.0f)  cVal = -128.0f;
+    if (cVal > 127.0f)  cVal = 127.0f;
+    return (signed char)cVal;
+}
+
+float UnpackNormByte(signed char val)
+{
+    return (2.0f * val + 1.0f) / 255.0f;
+}
+
+// Sign, but never zero
+static inline float signNotZero(float val)
+{
+    return (val >= 0.0f) ? 1.0f : -1.0f;
+}
+
+void PackOctNormal(const Vector3f &norm,signed char *ret)
+{
+    float len = fabsf(norm.x()) + fabsf(norm.y()) + fabsf(norm.z());
+    if (len == 0.0)
+    {
+        ret[0] = PackNormByte(0.0);  ret[1] = PackNormByte(0.0);
+        return;
+    }
+    float x = norm.x() / len, y = norm.y() / len;
+    if (norm.z() < 0.0)
+    {
+        float ox = x;
+        x = (1.0f - fabsf(y)) * signNotZero(ox);
+        y = (1.0f - fabsf(ox)) * signNotZero(y);
+    }
+
+    // Try the neighboring values and keep the one that decodes best
+    signed char best[2] = {PackNormByte(x),PackNormByte(y)};
+    float bestDot = -2.0;
+    Vector3f unitNorm = norm.normalized();
+    for (int dx=-1;dx<=1;dx++)
+        for (int dy=-1;dy<=1;dy++)
+        {
+            int cx = best[0] + dx, cy = best[1] + dy;
+            if (cx < -128 || cx > 127 || cy < -128 || cy > 127)
+                continue;
+            signed char test[2] = {(signed char)cx,(signed char)cy};
+            float thisDot = UnpackOctNormal(test).dot(unitNorm);
+            if (thisDot > bestDot)
+            {
+                bestDot = thisDot;
+                ret[0] = test[0];  ret[1] = test[1];
+            }
+        }
+}
+
+Vector3f UnpackOctNormal(const signed char *vals)
+{
+    float x = UnpackNormByte(vals[0]), y = UnpackNormByte(vals[1]);
+    float z = 1.0f - fabsf(x) - fabsf(y);
+    if (z < 0.0f)
+    {
+        float ox = x;
+        x = (1.0f - fabsf(y)) * signNotZero(ox);
+        y = (1.0f - fabsf(ox)) * signNotZero(y);
+    }
+    
+    return Vector3f(x,y,z).normalized();
+}
+    
+PositionQuantizer::PositionQuantizer(const Vector3f &center,float scale)
+    : center(center), scale(scale)
+{
+}
+    
+PositionQuantizer::PositionQuantizer(const Vector3f *pts,int numPts)
+    : center(0,0,0), scale(1.0)
+{
+    if (numPts <= 0)
+        return;
+    
+    Vector3f ll = pts[0], ur = pts[0];
+    for (int ii=1;ii<numPts;ii++)
+    {
+        ll = ll.cwiseMin(pts[ii]);
+        ur = ur.cwiseMax(pts[ii]);
+    }
+    center = (ll + ur) / 2.0;
+    scale = ((ur - ll) / 2.0).maxCoeff();
+    // All the points are in the same place.  There's no exact zero in the
+    //  normalized format, so keep the scale small to land on top of them.
+    if (scale <= 0.0)
+        scale = 1e-6;
+}
+
+void PositionQuantizer::pack(const Vector3f &pt,short *ret) const
+{
+    Vector3f norm = (pt - center) / scale;
+    ret[0] = PackNormShort(norm.x());
+    ret[1] = PackNormShort(norm.y());
+    ret[2] = PackNormShort(norm.z());
+    ret[3] = 0;
+}
+
+Vector3f PositionQuantizer::unpack(const short *vals) const
+{
+    return center + scale * Vector3f(UnpackNormShort(vals[0]),UnpackNormShort(vals[1]),UnpackNormShort(vals[2]));
+}
+
+}
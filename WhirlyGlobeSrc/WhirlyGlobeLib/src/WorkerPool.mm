@@ -0,0 +1,164 @@
+/*
+ *  WorkerPool.mm
+ *  WhirlyGlobeLib
+ *
+ *  Created by agent on 10/19/26.
+ *  Copyright 2011-2013 mousebird consulting
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ */
+
+#import <unistd.h>
+#import <stdio.h>
+#import <algorithm>
+#import "WorkerPool.h"
+#import "Profiler.h"
+
+namespace WhirlyKit
+{
+
+// Passed to a new thread so it knows which one it is
+class WorkerThreadInfo
+{
+public:
+    WorkerPool *pool;
+    int thread;
+};
+    
+WorkerPool::WorkerPool(int numExtraThreads)
+    : shutdown(false), generation(0), numBusy(0), task(NULL), numPieces(0), nextPiece(0)
+{
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&startCond, NULL);
+    pthread_cond_init(&doneCond, NULL);
+    
+    for (int ii=0;ii<numExtraThreads;ii++)
+    {
+        WorkerThreadInfo *info = new WorkerThreadInfo();
+        info->pool = this;
+        info->thread = ii+1;
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, &WorkerPool::threadMain, info) != 0)
+        {
+            delete info;
+            break;
+        }
+        threads.push_back(thread);
+    }
+}
+    
+WorkerPool::~WorkerPool()
+{
+    pthread_mutex_lock(&lock);
+    shutdown = true;
+    pthread_cond_broadcast(&startCond);
+    pthread_mutex_unlock(&lock);
+    
+    for (unsigned int ii=0;ii<threads.size();ii++)
+        pthread_join(threads[ii], NULL);
+    
+    pthread_cond_destroy(&doneCond);
+    pthread_cond_destroy(&startCond);
+    pthread_mutex_destroy(&lock);
+}
+    
+int WorkerPool::defaultNumThreads(int maxThreads)
+{
+    int numCores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    
+    return std::max(0,std::min(numCores-2,maxThreads));
+}
+    
+void *WorkerPool::threadMain(void *arg)
+{
+    WorkerThreadInfo *info = (WorkerThreadInfo *)arg;
+    WorkerPool *pool = info->pool;
+    int thread = info->thread;
+    delete info;
+    
+    pool->workerLoop(thread);
+    
+    return NULL;
+}
+    
+static ProfileZone WorkerTaskZone("WorkerPool task");
+
+void WorkerPool::workerLoop(int thread)
+{
+    int lastGeneration = 0;
+    
+    char name[64];
+    snprintf(name, sizeof(name), "Worker %d", thread);
+    Profiler::setThreadName(name);
+    
+    pthread_mutex_lock(&lock);
+    while (true)
+    {
+        while (!shutdown && generation == lastGeneration)
+            pthread_cond_wait(&startCond, &lock);
+        if (shutdown)
+            break;
+        lastGeneration = generation;
+        pthread_mutex_unlock(&lock);
+        
+        runPieces(thread);
+        
+        pthread_mutex_lock(&lock);
+        if (--numBusy == 0)
+            pthread_cond_signal(&doneCond);
+    }
+    pthread_mutex_unlock(&lock);
+}
+    
+void WorkerPool::runPieces(int thread)
+{
+    ProfileScope profile(WorkerTaskZone);
+    
+    int which;
+    while ((which = __sync_fetch_and_add(&nextPiece,1)) < numPieces)
+        task->runPiece(which, thread);
+}
+    
+void WorkerPool::run(WorkerTask *inTask,int inNumPieces)
+{
+    if (inNumPieces <= 0)
+        return;
+    
+    // Not worth waking anyone up for
+    if (threads.empty() || inNumPieces == 1)
+    {
+        for (int ii=0;ii<inNumPieces;ii++)
+            inTask->runPiece(ii, 0);
+        return;
+    }
+    
+    pthread_mutex_lock(&lock);
+    task = inTask;
+    numPieces = inNumPieces;
+    nextPiece = 0;
+    numBusy = (int)threads.size();
+    generation++;
+    pthread_cond_broadcast(&startCond);
+    pthread_mutex_unlock(&lock);
+    
+    // We work too
+    runPieces(0);
+    
+    pthread_mutex_lock(&lock);
+    while (numBusy > 0)
+        pthread_cond_wait(&doneCond, &lock);
+    task = NULL;
+    pthread_mutex_unlock(&lock);
+}
+    
+}